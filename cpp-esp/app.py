@@ -11,7 +11,11 @@ import hashlib
 import base64
 import json
 import os
+import secrets
+import zlib
 from pathlib import Path
+import ingest_native
+import profile_trace
 
 app = Flask(__name__)
 CORS(app)  # Enable CORS for all routes
@@ -88,9 +92,15 @@ def load_config_history():
         CONFIG_HISTORY = []
 
 # -------- Command Execution Management --------
-PENDING_COMMANDS = {}  # device_id -> {nonce, command}
+PENDING_COMMANDS = {}  # device_id -> [command entry, ...] awaiting a result
 COMMAND_RESULTS = []   # List of all command execution results
 COMMAND_HISTORY = []   # Full history of commands
+# Random start per server run: the device remembers the last 64 IDs it ran and would take
+# a restarted counter's 1, 2, 3... for commands it already executed
+COMMAND_ID_COUNTER = secrets.randbelow(1 << 31)
+MAX_COMMANDS_PER_POLL = 16  # half the device queue (CommandQueue::MAX_PENDING)
+COMMAND_REDELIVER_S = 120   # resend a delivered command that produced no result
+COMMAND_MAX_DELIVERIES = 3  # then give up; the device answers a known ID with its stored outcome
 
 # -------- FOTA Management --------
 FIRMWARE_MANIFEST = None
@@ -103,6 +113,7 @@ SECURITY_ENABLED = True  # Security enabled with proper envelope wrapping
 PRE_SHARED_KEY = bytes.fromhex("c41716a134168f52fbd4be3302fa5a88127ddde749501a199607b4c286ad29b3")
 PSK = bytes.fromhex("c41716a134168f52fbd4be3302fa5a88127ddde749501a199607b4c286ad29b3")  # 256-bit PSK
 NONCE_STORE = {}  # device_id -> {'nonce': last_nonce, 'timestamp': last_seen_time}
+NATIVE_INGEST = ingest_native.load(PSK)  # C++ envelope/batch decoder; None -> Python path below
 NONCE_WINDOW = 100  # Allow nonces within this window
 NONCE_EXPIRY_SECONDS = 75  # Clear nonces older than 75 seconds (allows device reboots during testing)
 SERVER_NONCE_COUNTER = 300  # Server nonce counter - start ahead of device's current ~204
@@ -215,6 +226,11 @@ def verify_request_security(device_id):
     log_security_event(device_id, 'hmac_verified', f"Nonce: {nonce_int}")
     return True, None
 
+def _last_nonce(device_id):
+    """Last nonce accepted from a device (NONCE_STORE holds an int or a {'nonce', 'timestamp'} dict)."""
+    entry = NONCE_STORE.get(device_id, 0)
+    return entry['nonce'] if isinstance(entry, dict) else entry
+
 # -------- Logging --------
 SECURITY_LOGS = []  # Security events (HMAC failures, replay attacks, etc.)
 FOTA_LOGS = []      # FOTA operations (upload, download, verify, rollback)
@@ -227,6 +243,7 @@ FLUSH_INTERVAL_SEC = 15
 #   "reg_values": { reg_addr: [values...] },
 #   "received_bytes": int,
 #   "last_seen": float (epoch seconds)  # when we last received data for this device
+#   "fidelity": str  # worst batch fidelity received since the last flush (full/lossy/aggregate/heartbeat)
 # }
 BUFFERS = {}
 BUFF_LOCK = threading.Lock()
@@ -277,6 +294,7 @@ def _flush_device_unlocked(device_id: str):
         "timestamp": flush_dt,
         "device_id": device_id,
         "bytes": received_bytes,
+        "fidelity": buf.get("fidelity", "full"),
         "samples": averaged_samples
     }
     UPLOADS.append(upload_record)
@@ -349,8 +367,211 @@ def _flusher_loop():
         except Exception as e:
             print(f"[ERROR] flusher loop: {e}")
 
+# ---------------- Flow control (server-directed upload pacing) ----------------
+# Device-facing polling paths are counted per second. Above FLOW_MAX_RPS the server
+# sheds with 503 + Retry-After; when FLOW_NEXT_INTERVAL is set every response on these
+# paths carries X-Next-Interval so devices adopt the new period on their next request.
+FLOW_PATHS = ('/api/upload', '/api/inverter/config/simple', '/api/inverter/config')
+FLOW_MAX_RPS = 0          # 0 = never shed
+FLOW_RETRY_AFTER = 30     # seconds
+FLOW_NEXT_INTERVAL = None # seconds, or None to leave devices on their own interval
+FLOW_STATS = {'window': 0, 'count': 0, 'peak_rps': 0, 'shed': 0, 'by_second': {}}
+FLOW_LOCK = threading.Lock()
+
+def _is_flow_path(path):
+    return any(path == p or path.startswith(p + '/') for p in FLOW_PATHS)
+
+@app.before_request
+def flow_control_admit():
+    if not _is_flow_path(request.path):
+        return None
+    second = int(time.time())
+    with FLOW_LOCK:
+        if FLOW_STATS['window'] != second:
+            FLOW_STATS['window'] = second
+            FLOW_STATS['count'] = 0
+        FLOW_STATS['count'] += 1
+        count = FLOW_STATS['count']
+        FLOW_STATS['peak_rps'] = max(FLOW_STATS['peak_rps'], count)
+        by_second = FLOW_STATS['by_second']
+        by_second[second] = count
+        for old in [k for k in by_second if k < second - 300]:
+            del by_second[old]
+        if FLOW_MAX_RPS and count > FLOW_MAX_RPS:
+            FLOW_STATS['shed'] += 1
+            resp = jsonify({'status': 'busy', 'retry_after': FLOW_RETRY_AFTER})
+            resp.status_code = 503
+            resp.headers['Retry-After'] = str(FLOW_RETRY_AFTER)
+            return resp
+    return None
+
+@app.after_request
+def flow_control_hints(response):
+    if FLOW_NEXT_INTERVAL and _is_flow_path(request.path):
+        response.headers['X-Next-Interval'] = str(FLOW_NEXT_INTERVAL)
+    return response
+
+@app.route('/api/security/resync', methods=['POST'])
+def security_resync():
+    """
+    Nonce resync after a device reboot (see include/nonce_resync.hpp).
+    Request {"device", "challenge", "mac": HMAC("resync" device challenge)}; the reply
+    carries the last nonce accepted from the device, MAC'd over the same challenge.
+    """
+    body = request.get_json(force=True, silent=True) or {}
+    device_id = body.get('device')
+    challenge = body.get('challenge')
+    received_mac = body.get('mac')
+    if not isinstance(device_id, str) or not isinstance(challenge, str) or not isinstance(received_mac, str):
+        return jsonify({'error': 'device, challenge and mac required'}), 400
+
+    expected = hmac.new(PSK, f"resync{device_id}{challenge}".encode(), hashlib.sha256).hexdigest()
+    if not hmac.compare_digest(expected, received_mac):
+        log_security_event(device_id, 'hmac_failed', 'Nonce resync HMAC mismatch')
+        return jsonify({'error': 'Unauthorized', 'details': 'HMAC verification failed'}), 401
+
+    last_nonce = _last_nonce(device_id)
+    mac = hmac.new(PSK, f"resync-ack{device_id}{challenge}{last_nonce}".encode(), hashlib.sha256).hexdigest()
+    log_security_event(device_id, 'nonce_resync', f"Last nonce: {last_nonce}")
+    return jsonify({'challenge': challenge, 'last_nonce': last_nonce, 'mac': mac})
+
+@app.route('/api/cloud/flow', methods=['GET', 'POST'])
+def flow_settings():
+    """
+    GET: request-rate statistics for the device polling paths.
+    POST: {"max_rps": 20, "retry_after": 30, "next_interval": 60} (next_interval null clears it)
+    """
+    global FLOW_MAX_RPS, FLOW_RETRY_AFTER, FLOW_NEXT_INTERVAL
+    if request.method == 'POST':
+        body = request.get_json(force=True, silent=True) or {}
+        if 'max_rps' in body:
+            FLOW_MAX_RPS = max(0, int(body['max_rps']))
+        if 'retry_after' in body:
+            FLOW_RETRY_AFTER = max(1, int(body['retry_after']))
+        if 'next_interval' in body:
+            FLOW_NEXT_INTERVAL = body['next_interval'] or None
+    with FLOW_LOCK:
+        recent = sorted(FLOW_STATS['by_second'].items())[-60:]
+        return jsonify({
+            'max_rps': FLOW_MAX_RPS,
+            'retry_after': FLOW_RETRY_AFTER,
+            'next_interval': FLOW_NEXT_INTERVAL,
+            'peak_rps': FLOW_STATS['peak_rps'],
+            'shed': FLOW_STATS['shed'],
+            'last_60s': [{'t': t, 'requests': c} for t, c in recent]
+        })
+
 # ---------------- Existing endpoints (unchanged signatures) ----------------
 
+# -------- CPU accounting (cpu_accounting.hpp) --------
+# Each metadata upload carries cumulative per-subsystem time and per-task run time over
+# the interval since the previous one.
+CPU_REPORTS = {}  # device_id -> {'received': epoch, 'subsystems': {...}, 'tasks': [...]}
+
+def record_cpu_report(device_id, cpu):
+    subsystems = cpu.get('subsystems') or {}
+    tasks = cpu.get('tasks') or []
+    CPU_REPORTS[device_id] = {'received': int(_now_epoch()), 'subsystems': subsystems, 'tasks': tasks}
+    busiest = sorted(subsystems.items(), key=lambda kv: kv[1].get('us', 0), reverse=True)[:3]
+    print("[CPU] " + ", ".join(f"{name} {v.get('us', 0) / 1000:.0f} ms/{v.get('calls', 0)} calls"
+                               for name, v in busiest))
+    if tasks:
+        print("[CPU] tasks: " + ", ".join(f"{t.get('task')} {t.get('pct')}%" for t in tasks[:4]))
+
+@app.route('/api/cloud/cpu', methods=['GET'])
+def get_cpu_reports():
+    return jsonify({'devices': CPU_REPORTS})
+
+# -------- Stall detector (stall_detector.hpp) --------
+# Each metadata upload carries per-subsystem stall counts since boot and the device's
+# most recent stalls, including one a watchdog/panic reset cut short.
+STALL_REPORTS = {}  # device_id -> {'received': epoch, 'total': n, 'subsystems': {...}, 'recent': [...]}
+
+def record_stall_report(device_id, stalls):
+    previous = STALL_REPORTS.get(device_id, {})
+    STALL_REPORTS[device_id] = {'received': int(_now_epoch()), 'threshold_ms': stalls.get('threshold_ms'),
+                                'total': stalls.get('total', 0), 'subsystems': stalls.get('subsystems') or {},
+                                'recent': stalls.get('recent') or []}
+    new = stalls.get('total', 0) - previous.get('total', 0)
+    if new < 0:
+        new = stalls.get('total', 0)  # the device lost power and started counting again
+    for s in (stalls.get('recent') or [])[:min(new, 3)]:
+        ended = f"ended by a {s['reset']} reset" if s.get('reset') else ('still blocked' if s.get('open') else 'returned')
+        print(f"[STALL] {device_id}: {s.get('subsystem')}/{s.get('op')} {s.get('ms')} ms, {ended}")
+
+@app.route('/api/cloud/stalls', methods=['GET'])
+def get_stall_reports():
+    device_id = request.args.get('device_id')
+    if device_id:
+        return jsonify({'device_id': device_id, 'stalls': STALL_REPORTS.get(device_id)})
+    return jsonify({'devices': STALL_REPORTS})
+
+# -------- Device shadow (device_shadow.hpp) --------
+# The device reports its state as versioned deltas riding on the events lane; the cloud
+# merges them and answers "shadow_ack": <v> so the device stops resending those fields.
+DEVICE_SHADOWS = {}  # device_id -> {'version': v, 'state': {...}, 'deltas': n, 'bytes': n, 'updated': epoch}
+SHADOW_KEYS = {'fw': 'firmware', 'cfg': 'config_version', 'fota': 'fota_state', 'fch': 'fota_chunks',
+               'ferr': 'fota_error', 'boot': 'boot_status', 'bcnt': 'boot_count', 'sec': 'security',
+               'fid': 'fidelity', 'hmin': 'heap_min_kb', 'rssi': 'rssi_dbm', 'stl': 'stalls'}
+
+def _apply_shadow_delta(device_id, ev):
+    shadow = DEVICE_SHADOWS.setdefault(device_id, {'version': 0, 'state': {}, 'deltas': 0, 'bytes': 0})
+    v = int(ev.get('v', 0))
+    shadow['deltas'] += 1
+    shadow['bytes'] += len(json.dumps(ev, separators=(',', ':')))
+    if ev.get('full'):
+        shadow['state'] = {}  # the device rebooted: its version starts over
+    elif v <= shadow['version']:
+        return v  # a resend of something already merged
+    changed = {SHADOW_KEYS.get(k, k): val for k, val in (ev.get('s') or {}).items()}
+    shadow['state'].update(changed)
+    shadow['version'] = v
+    shadow['updated'] = int(_now_epoch())
+    _shadow_to_fota_status(device_id, shadow['state'], changed)
+    return v
+
+def _shadow_to_fota_status(device_id, state, changed):
+    fota_keys = ('fota_state', 'fota_chunks', 'fota_error', 'boot_status')
+    if not any(k in changed for k in fota_keys):
+        return
+    fota_state = state.get('fota_state')
+    chunks = changed.get('fota_chunks')
+    _record_fota_status(device_id,
+                        chunk_received=chunks[0] if chunks and fota_state == 'downloading' else None,
+                        verified=True if changed.get('fota_state') in ('rebooting', 'completed') else None,
+                        boot_status=changed.get('boot_status'),
+                        rollback=changed.get('fota_state') == 'rollback',
+                        error=state.get('fota_error') or None)
+
+@app.route('/api/cloud/shadow', methods=['GET'])
+def get_device_shadow():
+    device_id = request.args.get('device_id')
+    if device_id:
+        return jsonify({'device_id': device_id, 'shadow': DEVICE_SHADOWS.get(device_id)})
+    return jsonify({'devices': DEVICE_SHADOWS})
+
+# -------- Request timeouts (rtt_estimator.hpp) --------
+# Per-endpoint smoothed RTT, variance and the timeout the device currently uses, for
+# the cloud client and the inverter client.
+RTT_REPORTS = {}  # device_id -> {'received': epoch, 'cloud': {endpoint: {...}}, 'inverter': {...}}
+
+def record_rtt_report(device_id, rtt):
+    previous = RTT_REPORTS.get(device_id, {})
+    RTT_REPORTS[device_id] = dict(rtt, received=int(_now_epoch()))
+    for client, endpoints in rtt.items():
+        for endpoint, est in (endpoints or {}).items():
+            before = (previous.get(client) or {}).get(endpoint, {}).get('timeouts', 0)
+            if est.get('timeouts', 0) > before:
+                print(f"[RTT] {device_id} {client} {endpoint}: {est['timeouts'] - before} timeouts, "
+                      f"srtt {est.get('srtt')} ms, rto now {est.get('rto')} ms")
+
+@app.route('/api/cloud/rtt', methods=['GET'])
+def get_rtt_reports():
+    device_id = request.args.get('device_id')
+    if device_id:
+        return jsonify({'device_id': device_id, 'rtt': RTT_REPORTS.get(device_id)})
+    return jsonify({'devices': RTT_REPORTS})
+
 @app.route('/api/upload/meta', methods=['POST'])
 def upload_meta():
     try:
@@ -363,6 +584,23 @@ def upload_meta():
         print(f"[BENCHMARK] CPU Time (ms): {meta.get('cpu_time_ms')}")
         print(f"[BENCHMARK] Lossless Recovery Verification: {meta.get('lossless')}")
         print(f"[BENCHMARK] Aggregation min/avg/max: {meta.get('min')}, {meta.get('avg')}, {meta.get('max')}")
+        cpu = meta.get('cpu')
+        if cpu:
+            record_cpu_report(request.headers.get('Device-ID', 'unknown'), cpu)
+        stalls = meta.get('stalls')
+        if stalls:
+            record_stall_report(request.headers.get('Device-ID', 'unknown'), stalls)
+        hedge = meta.get('hedge')
+        if hedge:
+            print(f"[BENCHMARK] Hedged reads: {hedge.get('hedges')}/{hedge.get('reads')} hedged, "
+                  f"{hedge.get('wins')} won, p99 {hedge.get('p99_us')} us")
+        fec = meta.get('fec')
+        if fec:
+            print(f"[BENCHMARK] Upload FEC: {fec.get('groups')} groups ({fec.get('failed')} failed), "
+                  f"{fec.get('parity')} parity for {fec.get('data')} chunks, loss {fec.get('loss_permille')}/1000")
+        rtt = meta.get('rtt')
+        if rtt:
+            record_rtt_report(request.headers.get('Device-ID', 'unknown'), rtt)
         BENCHMARKS.append(meta)
         return jsonify({'status': 'success', 'benchmark': meta})
     except Exception as e:
@@ -388,20 +626,214 @@ def decompress_delta_payload(data: bytes):
     idx = 0
     while offset + sample_size <= len(data):
         ts, reg_addr, value = struct.unpack('<IBf', data[offset:offset+sample_size])
-        print(f"[DEBUG] decompress_delta_payload: sample {idx}: ts={ts}, reg_addr={reg_addr}, value={value}")
         samples.append({'timestamp': int(ts), 'reg_addr': reg_addr, 'value': round(float(value), 3)})
         offset += sample_size
         idx += 1
     print(f"[DEBUG] decompress_delta_payload: total samples={len(samples)}")
     return samples
 
+# -------- Uplink batch format (see cpp-esp/include/uplink_codec.hpp) --------
+FIDELITY_NAMES = ['full', 'lossy', 'aggregate', 'heartbeat']
+HEARTBEATS = {}  # device_id -> last heartbeat batch
+
+def _read_varint(data, pos):
+    value, shift = 0, 0
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        if not b & 0x80:
+            return value, pos
+        shift += 7
+
+def _unzigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+def decode_uplink_batches(data: bytes):
+    """
+    Decode concatenated 'EW' batches. Returns a list of dicts:
+      {codec, fidelity, samples: [...], aggregates: [...], ...}
+    """
+    batches = []
+    pos = 0
+    while pos + 8 <= len(data):
+        if data[pos:pos + 2] != b'EW':
+            raise ValueError(f'bad batch magic at offset {pos}')
+        version, codec, fidelity, _flags, count = struct.unpack_from('<BBBBH', data, pos + 2)
+        if version != 1:
+            raise ValueError(f'unsupported batch version {version}')
+        pos += 8
+        batch = {'codec': codec, 'fidelity': FIDELITY_NAMES[fidelity] if fidelity < 4 else 'unknown',
+                 'samples': [], 'aggregates': []}
+        if codec == 0:  # RAW
+            for _ in range(count):
+                ts, reg, val = struct.unpack_from('<IBf', data, pos)
+                pos += 9
+                batch['samples'].append({'timestamp': ts, 'reg_addr': reg, 'value': round(val, 3)})
+        elif codec == 1:  # DELTA_Q
+            step, ts = struct.unpack_from('<fI', data, pos)
+            pos += 8
+            prev_q = {}
+            for _ in range(count):
+                dts, pos = _read_varint(data, pos)
+                reg = data[pos]
+                pos += 1
+                dq, pos = _read_varint(data, pos)
+                ts = (ts + _unzigzag(dts)) & 0xFFFFFFFF
+                slot = reg % 16
+                prev_q[slot] = prev_q.get(slot, 0) + _unzigzag(dq)
+                batch['samples'].append({'timestamp': ts, 'reg_addr': reg, 'value': round(prev_q[slot] * step, 3)})
+        elif codec == 2:  # AGGREGATE
+            batch['start_ts'], batch['end_ts'] = struct.unpack_from('<II', data, pos)
+            pos += 8
+            for _ in range(count):
+                reg, n, mn, mx, mean = struct.unpack_from('<BHfff', data, pos)
+                pos += 15
+                batch['aggregates'].append({'reg_addr': reg, 'count': n, 'min': round(mn, 3),
+                                            'max': round(mx, 3), 'mean': round(mean, 3)})
+        elif codec == 3:  # HEARTBEAT
+            batch['ts'], batch['backlog'], batch['lost'] = struct.unpack_from('<III', data, pos)
+            pos += 12
+        elif codec == 4:  # FRAME: one timestamp and presence bitmap per polling cycle
+            for _ in range(count):
+                ts, present = struct.unpack_from('<IH', data, pos)
+                pos += 6
+                if not present:
+                    raise ValueError(f'empty frame at offset {pos - 6}')
+                for reg in range(16):
+                    if present & (1 << reg):
+                        val, = struct.unpack_from('<f', data, pos)
+                        pos += 4
+                        batch['samples'].append({'timestamp': ts, 'reg_addr': reg, 'value': round(val, 3)})
+        else:
+            raise ValueError(f'unknown codec {codec}')
+        batches.append(batch)
+    return batches
+
+# -------- Upload FEC shards (see cpp-esp/include/uplink_fec.hpp) --------
+FEC_GROUPS = {}       # (device_id, group) -> {'k', 'len', 'shards': {index: bytes}, 'done'}
+FEC_GROUPS_KEEP = 256 # oldest groups are forgotten past this
+
+def _gf_tables():
+    exp, log = [0] * 512, [0] * 256
+    x = 1
+    for i in range(255):
+        exp[i] = x
+        log[x] = i
+        x <<= 1
+        if x & 0x100:
+            x ^= 0x11D
+    for i in range(255, 512):
+        exp[i] = exp[i - 255]
+    return exp, log
+
+GF_EXP, GF_LOG = _gf_tables()
+# GF_MUL[c] maps every byte b to c * b, for bytes.translate
+GF_MUL = [bytes(0 if not c or not b else GF_EXP[GF_LOG[c] + GF_LOG[b]] for b in range(256)) for c in range(256)]
+
+def _gf_inv(a):
+    return GF_EXP[255 - GF_LOG[a]]
+
+def _rs_rebuild(k, shards, length):
+    """Missing data shards {index: bytes} from any k of the shards (Cauchy rows, as on the device)."""
+    used = sorted(shards)[:k]
+    m = [[(1 if used[r] == c else 0) if used[r] < k else _gf_inv((used[r]) ^ c) for c in range(k)] for r in range(k)]
+    inv = [[1 if r == c else 0 for c in range(k)] for r in range(k)]
+    for c in range(k):
+        p = next(r for r in range(c, k) if m[r][c])
+        m[c], m[p], inv[c], inv[p] = m[p], m[c], inv[p], inv[c]
+        f = _gf_inv(m[c][c])
+        m[c] = [GF_MUL[f][v] for v in m[c]]
+        inv[c] = [GF_MUL[f][v] for v in inv[c]]
+        for r in range(k):
+            e = m[r][c]
+            if r != c and e:
+                m[r] = [a ^ GF_MUL[e][b] for a, b in zip(m[r], m[c])]
+                inv[r] = [a ^ GF_MUL[e][b] for a, b in zip(inv[r], inv[c])]
+    rebuilt = {}
+    for i in range(k):
+        if i in shards:
+            continue
+        acc = 0
+        for r in range(k):
+            if inv[i][r]:
+                acc ^= int.from_bytes(shards[used[r]].translate(GF_MUL[inv[i][r]]), 'little')
+        rebuilt[i] = acc.to_bytes(length, 'little')
+    return rebuilt
+
+def fec_accept(device_id, payload):
+    """
+    Take one FEC shard. Returns (chunks, status): the data chunks to ingest now (a
+    data shard on arrival, the rebuilt ones when the group completes) and the
+    {"group","have","complete"} status for the reply.
+    """
+    if len(payload) < 12 or payload[2] != 1:
+        raise ValueError('bad FEC shard header')
+    k, index = payload[3], payload[4]
+    shard_len, group = struct.unpack_from('<HI', payload, 6)
+    body = payload[12:]
+    key = (device_id, group)
+    g = FEC_GROUPS.get(key)
+    if g is None or g['k'] != k or g['len'] != shard_len:
+        g = {'k': k, 'len': shard_len, 'shards': {}, 'have': 0, 'done': False}
+        FEC_GROUPS[key] = g
+        while len(FEC_GROUPS) > FEC_GROUPS_KEEP:
+            FEC_GROUPS.pop(next(iter(FEC_GROUPS)))
+
+    def unframe(shard):
+        n = struct.unpack_from('<H', shard, 0)[0]
+        return shard[2:2 + n]
+
+    chunks = []
+    if not g['done'] and index not in g['shards']:
+        g['shards'][index] = body.ljust(shard_len, b'\0')
+        g['have'] += 1
+        if index < k:
+            chunks.append(unframe(g['shards'][index]))
+        if len(g['shards']) >= k:
+            rebuilt = _rs_rebuild(k, g['shards'], shard_len)
+            chunks.extend(unframe(rebuilt[i]) for i in sorted(rebuilt))
+            if rebuilt:
+                print(f"[FEC] {device_id}: group {group} rebuilt {len(rebuilt)} of {k} chunks")
+            g['done'] = True
+            g['shards'] = {}
+    return chunks, {'group': group, 'have': g['have'], 'complete': g['done']}
+
+def _ingest_native_envelope(device_id):
+    """
+    Verify and decode a secured upload with the native decoder.
+    Returns (upload, None), (None, error_response), or (None, None) when the body is
+    not an envelope it handles, so the Python path below reports it as before.
+    """
+    upload = NATIVE_INGEST.decode_envelope(request.get_data())
+    if upload.status == ingest_native.BAD_MAC:
+        log_security_event(device_id, 'hmac_failed', f"Upload HMAC mismatch")
+        return None, (jsonify({'error': 'Unauthorized', 'details': 'HMAC verification failed'}), 401)
+    if not upload.ok:
+        return None, None
+    last_nonce = NONCE_STORE.get(device_id, 0)
+    if upload.nonce <= last_nonce:
+        log_security_event(device_id, 'replay_attack', f'Upload nonce {upload.nonce} <= {last_nonce}')
+        return None, (jsonify({'error': 'Unauthorized', 'details': 'Replay attack detected'}), 401)
+    NONCE_STORE[device_id] = upload.nonce
+    log_security_event(device_id, 'hmac_verified', f"Upload authenticated, nonce: {upload.nonce}")
+    return upload, None
+
 @app.route('/api/upload', methods=['POST'])
 def upload():
     device_id = request.headers.get('device-id') or request.headers.get('Device-ID') or 'Unknown-Device'
     
     # Check if this is a secured request (JSON envelope)
     content_type = request.headers.get('Content-Type', '')
-    if 'application/json' in content_type and SECURITY_ENABLED:
+    native = None
+    if 'application/json' in content_type and SECURITY_ENABLED and NATIVE_INGEST:
+        native, error = _ingest_native_envelope(device_id)
+        if error:
+            return error
+
+    if native:
+        payload_len = native.payload_bytes
+    elif 'application/json' in content_type and SECURITY_ENABLED:
         try:
             # Parse secured envelope
             envelope = request.get_json(force=True)
@@ -445,12 +877,42 @@ def upload():
     else:
         # Plain binary upload (legacy)
         compressed_payload = request.data
+    if not native:
+        payload_len = len(compressed_payload)
     
-    print(f"[DEBUG] /api/upload called: device_id={device_id}, payload_bytes={len(compressed_payload)}")
+    print(f"[DEBUG] /api/upload called: device_id={device_id}, payload_bytes={payload_len}")
 
+    fidelity = 'full'
+    fec_status = None
     try:
-        samples = decompress_delta_payload(compressed_payload)
-        print(f"[DEBUG] /api/upload: decompressed {len(samples)} samples")
+        if native:
+            # Already verified and decoded in C++; samples are (ts, value, reg, kind)
+            fidelity = native.fidelity
+            samples = [{'reg_addr': reg, 'value': round(value, 3)} for _ts, value, reg, _kind in native.samples]
+            if native.heartbeat:
+                HEARTBEATS[device_id] = dict(native.heartbeat, codec=3, fidelity='heartbeat', samples=[],
+                                             aggregates=[], received_at=datetime.datetime.now().isoformat())
+        elif compressed_payload[:2] in (b'EW', b'FC'):
+            samples = []
+            batches = []
+            if compressed_payload[:2] == b'FC':
+                chunks, fec_status = fec_accept(device_id, compressed_payload)
+                for chunk in chunks:
+                    batches.extend(decode_uplink_batches(chunk))
+            else:
+                batches = decode_uplink_batches(compressed_payload)
+            for batch in batches:
+                samples.extend(batch['samples'])
+                # Aggregates stand in for the raw samples the device could not send
+                for agg in batch['aggregates']:
+                    samples.append({'timestamp': batch['end_ts'], 'reg_addr': agg['reg_addr'], 'value': agg['mean']})
+                if batch['fidelity'] == 'heartbeat':
+                    HEARTBEATS[device_id] = dict(batch, received_at=datetime.datetime.now().isoformat())
+                if FIDELITY_NAMES.index(batch['fidelity']) > FIDELITY_NAMES.index(fidelity):
+                    fidelity = batch['fidelity']
+        else:
+            samples = decompress_delta_payload(compressed_payload)
+        print(f"[DEBUG] /api/upload: decompressed {len(samples)} samples (fidelity={fidelity})")
     except Exception as e:
         print(f"[ERROR] /api/upload: decompression failed: {e}")
         samples = []
@@ -470,17 +932,222 @@ def upload():
                 continue
             buf["reg_values"].setdefault(reg, []).append(float(val))
 
-        buf["received_bytes"] += int(len(compressed_payload))
+        buf["received_bytes"] += int(payload_len)
         buf["last_seen"] = now  # debounce: reset the inactivity timer on every upload
+        if FIDELITY_NAMES.index(fidelity) > FIDELITY_NAMES.index(buf.get("fidelity", "full")):
+            buf["fidelity"] = fidelity
 
     # Immediate ACK; flush occurs after 15s of inactivity
-    return jsonify({'status': 'success', 'received': len(compressed_payload)})
+    reply = {'status': 'success', 'received': payload_len, 'fidelity': fidelity}
+    if fec_status:
+        reply['fec'] = fec_status
+    return jsonify(reply)
 
 @app.route('/api/uploads', methods=['GET'])
 def get_uploads():
     # Expose flushed records and benchmark meta
     return jsonify({'uploads': UPLOADS, 'benchmarks': BENCHMARKS})
 
+# -------- Uplink priority lanes --------
+EVENTS = []  # urgent / event / background lane items received from devices
+
+def _unwrap_secured_payload(device_id):
+    """
+    Verify a secured envelope {nonce, timestamp, encrypted, payload, mac} and return
+    (payload_bytes, None) or (None, error_response).
+    """
+    envelope = request.get_json(force=True, silent=True)
+    if not envelope or 'payload' not in envelope or 'mac' not in envelope:
+        return None, (jsonify({'error': 'invalid envelope'}), 400)
+
+    payload_str = envelope['payload']
+    nonce = envelope.get('nonce', 0)
+    timestamp = envelope.get('timestamp', 0)
+    encrypted_flag = envelope.get('encrypted', False)
+    hmac_input = f"{nonce}{timestamp}{'1' if encrypted_flag else '0'}{payload_str}"
+    calculated_mac = hmac.new(PSK, hmac_input.encode(), hashlib.sha256).hexdigest()
+    if not hmac.compare_digest(calculated_mac, envelope['mac']):
+        log_security_event(device_id, 'hmac_failed', 'Envelope HMAC mismatch')
+        return None, (jsonify({'error': 'Unauthorized', 'details': 'HMAC verification failed'}), 401)
+
+    try:
+        return base64.b64decode(payload_str), None
+    except Exception:
+        return payload_str.encode(), None
+
+@app.route('/api/upload/events', methods=['POST'])
+def upload_events():
+    """Batched lane items: {"events": [{...}, ...]} inside a secured envelope."""
+    device_id = request.headers.get('Device-ID') or request.headers.get('device-id') or 'Unknown-Device'
+    if SECURITY_ENABLED:
+        payload, err = _unwrap_secured_payload(device_id)
+        if err:
+            return err
+    else:
+        payload = request.data
+    try:
+        events = json.loads(payload).get('events', [])
+    except Exception as e:
+        return jsonify({'error': f'invalid events payload: {e}'}), 400
+
+    received_at = datetime.datetime.now().isoformat()
+    shadow_ack = None
+    for ev in events:
+        if isinstance(ev, dict) and ev.get('type') == 'shadow':
+            shadow_ack = _apply_shadow_delta(device_id, ev)
+            continue
+        if isinstance(ev, dict) and ev.get('type') == 'log_block':
+            _store_log_block(device_id, ev)
+            continue
+        if isinstance(ev, dict) and ev.get('type') == 'profile_chunk':
+            _store_profile_chunk(device_id, ev)
+            continue
+        if isinstance(ev, dict):
+            ev['device_id'] = device_id
+            ev['received_at'] = received_at
+            EVENTS.append(ev)
+    del EVENTS[:-500]  # keep the last 500
+    print(f"[EVENTS] {len(events)} events from {device_id}")
+    response = {'status': 'success', 'received': len(events)}
+    if shadow_ack is not None:
+        response['shadow_ack'] = shadow_ack
+    return jsonify(response)
+
+@app.route('/api/cloud/events', methods=['GET'])
+def get_events():
+    return jsonify({'events': EVENTS})
+
+# -------- Device log segments (fetch_logs command) --------
+# Blocks arrive base64-encoded on the background lane; see log_segment.hpp for the format.
+DEVICE_LOGS = {}  # device_id -> {(boot, seq): {...block info, 'lines': [...]}}
+LOG_LEVELS = ['DEBUG', 'INFO', 'WARN', 'ERROR']
+
+def lzss_decompress(data: bytes, out_len: int) -> bytes:
+    out = bytearray()
+    ip = 0
+    while len(out) < out_len:
+        flags = data[ip]
+        ip += 1
+        for t in range(8):
+            if len(out) >= out_len:
+                break
+            if flags & (1 << t):
+                off = data[ip] | ((data[ip + 1] >> 4) << 8)
+                n = (data[ip + 1] & 0x0F) + 3
+                ip += 2
+                if off == 0 or off > len(out):
+                    raise ValueError('bad LZSS offset')
+                for _ in range(n):
+                    out.append(out[-off])
+            else:
+                out.append(data[ip])
+                ip += 1
+    return bytes(out)
+
+def decode_log_block(block: bytes):
+    if len(block) < 32 or block[:2] != b'LG':
+        raise ValueError('not a log block')
+    version, flags, boot, seq, first_ms, last_ms, raw_len, data_len, lines, _, crc = \
+        struct.unpack_from('<BBIIIIHHHHI', block, 2)
+    body = block[32:32 + data_len]
+    if len(body) != data_len or (zlib.crc32(body) & 0xFFFFFFFF) != crc:
+        raise ValueError('log block CRC mismatch')
+    raw = lzss_decompress(body, raw_len) if flags & 1 else body
+    records = []
+    pos = 0
+    while pos + 6 <= len(raw):
+        ms, level, n = struct.unpack_from('<IBB', raw, pos)
+        text = raw[pos + 6:pos + 6 + n].decode('utf-8', errors='replace')
+        records.append({'ms': ms, 'level': LOG_LEVELS[level] if level < len(LOG_LEVELS) else str(level), 'text': text})
+        pos += 6 + n
+    return {'boot': boot, 'seq': seq, 'first_ms': first_ms, 'last_ms': last_ms,
+            'raw_len': raw_len, 'data_len': data_len, 'lines': records}
+
+def _store_log_block(device_id, ev):
+    try:
+        block = decode_log_block(base64.b64decode(ev.get('data', '')))
+    except Exception as e:
+        print(f"[LOGS] Bad log block from {device_id}: {e}")
+        return
+    block['command_id'] = ev.get('command_id')
+    DEVICE_LOGS.setdefault(device_id, {})[(block['boot'], block['seq'])] = block
+    print(f"[LOGS] {device_id}: boot {block['boot']} block {block['seq']} ({len(block['lines'])} lines)")
+
+@app.route('/api/cloud/logs/device', methods=['GET'])
+def get_device_logs():
+    """Lines pulled with fetch_logs: ?device_id=EcoWatt001[&boot=N]"""
+    device_id = request.args.get('device_id', 'EcoWatt001')
+    boot = request.args.get('boot', type=int)
+    lines = []
+    for (b, seq), block in sorted(DEVICE_LOGS.get(device_id, {}).items()):
+        if boot is not None and b != boot:
+            continue
+        for rec in block['lines']:
+            lines.append(dict(rec, boot=b))
+    return jsonify({'device_id': device_id, 'count': len(lines), 'lines': lines})
+
+# -------- Profiling captures (profile command) --------
+# 4 KB pieces of the serialized capture arrive on the background lane, each LZSS-packed
+# on its own; see profiler.hpp for the capture and profile_trace.py for the conversion.
+PROFILES = {}  # device_id -> {command_id: {'chunks': {seq: bytes}, 'total': n, 'capture': bytes|None}}
+
+def _store_profile_chunk(device_id, ev):
+    try:
+        data = base64.b64decode(ev.get('data', ''))
+        raw_len = int(ev['raw_len'])
+        if ev.get('lzss'):
+            data = lzss_decompress(data, raw_len)
+        if len(data) != raw_len:
+            raise ValueError(f'chunk is {len(data)} bytes, expected {raw_len}')
+        command_id, seq, total = int(ev['command_id']), int(ev['seq']), int(ev['chunks'])
+    except Exception as e:
+        print(f"[PROFILE] Bad profile chunk from {device_id}: {e}")
+        return
+    entry = PROFILES.setdefault(device_id, {}).setdefault(command_id, {'chunks': {}, 'total': total, 'capture': None})
+    entry['chunks'][seq] = data
+    if len(entry['chunks']) == total and entry['capture'] is None:
+        entry['capture'] = b''.join(entry['chunks'][i] for i in range(total))
+        entry['chunks'] = {}
+        _update_command_history(device_id, command_id, profile_bytes=len(entry['capture']))
+        print(f"[PROFILE] {device_id}: capture {command_id} complete ({len(entry['capture'])} bytes)")
+
+@app.route('/api/cloud/profiles', methods=['GET'])
+def get_profiles():
+    """Captures received per device: ?device_id=EcoWatt001"""
+    device_id = request.args.get('device_id', 'EcoWatt001')
+    out = []
+    for command_id, entry in sorted(PROFILES.get(device_id, {}).items()):
+        item = {'command_id': command_id, 'chunks': entry['total'], 'complete': entry['capture'] is not None}
+        if entry['capture'] is None:
+            item['received'] = len(entry['chunks'])
+        else:
+            try:
+                profile = profile_trace.decode_profile(entry['capture'])
+                item.update(length_us=profile['length_us'], events=len(profile['events']),
+                            truncated=profile['truncated'], tasks=profile['threads'])
+            except ValueError as e:
+                item['error'] = str(e)
+        out.append(item)
+    return jsonify({'device_id': device_id, 'profiles': out})
+
+@app.route('/api/cloud/profile/<int:command_id>/trace', methods=['GET'])
+def get_profile_trace(command_id):
+    """Chrome trace JSON of one capture (?format=raw for the capture bytes)"""
+    device_id = request.args.get('device_id', 'EcoWatt001')
+    entry = PROFILES.get(device_id, {}).get(command_id)
+    if not entry or entry['capture'] is None:
+        return jsonify({'error': 'capture not complete'}), 404
+    name = f'{device_id}-profile-{command_id}'
+    if request.args.get('format') == 'raw':
+        return app.response_class(entry['capture'], mimetype='application/octet-stream',
+                                  headers={'Content-Disposition': f'attachment; filename={name}.bin'})
+    try:
+        trace = profile_trace.to_chrome_trace(profile_trace.decode_profile(entry['capture']))
+    except ValueError as e:
+        return jsonify({'error': str(e)}), 422
+    return app.response_class(json.dumps(trace), mimetype='application/json',
+                              headers={'Content-Disposition': f'attachment; filename={name}.json'})
+
 # ----------------- Modbus simulator (unchanged) -----------------
 
 def compute_crc(data: bytes) -> int:
@@ -511,52 +1178,16 @@ def inverter_read():
     slave = data[0]
     func = data[1]
 
-    if func == 0x03:
+    if func in (0x03, 0x04):
         num_regs = (data[4] << 8) | data[5]
         start_addr = (data[2] << 8) | data[3]
         if start_addr in SIM_EXCEPTIONS:
-            payload = bytearray()
-            payload.append(slave)
-            payload.append(0x83)
-            payload.append(0x02)
-            crc = compute_crc(payload)
-            payload.append(crc & 0xFF)
-            payload.append((crc >> 8) & 0xFF)
-            return jsonify({'frame': payload.hex().upper()})
-        byte_count = num_regs * 2
+            return jsonify({'frame': sim_exception_frame(slave, func, 0x02)})
         payload = bytearray()
         payload.append(slave)
-        payload.append(0x03)
-        payload.append(byte_count)
-        for i in range(num_regs):
-            addr = start_addr + i
-            if addr in SIM_REGISTERS:
-                val = SIM_REGISTERS[addr]
-            else:
-                if addr == 0:
-                    val = 2300
-                elif addr == 1:
-                    val = 25
-                elif addr == 2:
-                    val = 5000
-                elif addr == 3:
-                    val = 3200
-                elif addr == 4:
-                    val = 3150
-                elif addr == 5:
-                    val = 85
-                elif addr == 6:
-                    val = 82
-                elif addr == 7:
-                    val = 350
-                elif addr == 8:
-                    val = 75
-                elif addr == 9:
-                    val = 1850
-                else:
-                    val = (i + 1) * 10
-            payload.append((val >> 8) & 0xFF)
-            payload.append(val & 0xFF)
+        payload.append(func)
+        payload.append(num_regs * 2)
+        payload += sim_register_block(start_addr, num_regs)
         crc = compute_crc(payload)
         payload.append(crc & 0xFF)
         payload.append((crc >> 8) & 0xFF)
@@ -564,6 +1195,27 @@ def inverter_read():
     else:
         return jsonify({'error': 'unsupported function in sim'}), 400
 
+def sim_register_value(addr, i):
+    if addr in SIM_REGISTERS:
+        return SIM_REGISTERS[addr]
+    defaults = {0: 2300, 1: 25, 2: 5000, 3: 3200, 4: 3150, 5: 85, 6: 82, 7: 350, 8: 75, 9: 1850}
+    return defaults.get(addr, (i + 1) * 10)
+
+def sim_register_block(start_addr, num_regs):
+    out = bytearray()
+    for i in range(num_regs):
+        val = sim_register_value(start_addr + i, i)
+        out.append((val >> 8) & 0xFF)
+        out.append(val & 0xFF)
+    return out
+
+def sim_exception_frame(slave, func, code):
+    payload = bytearray([slave, func | 0x80, code])
+    crc = compute_crc(payload)
+    payload.append(crc & 0xFF)
+    payload.append((crc >> 8) & 0xFF)
+    return payload.hex().upper()
+
 @app.route('/api/inverter/write', methods=['POST'])
 def inverter_write():
     j = request.get_json(silent=True)
@@ -575,8 +1227,33 @@ def inverter_write():
     except Exception:
         return jsonify({'error': 'invalid hex'}), 400
 
+    if len(data) >= 2 and data[1] == 0x17:
+        # Read/Write Multiple Registers: apply the write, then answer with the read block
+        if len(data) < 13:
+            return jsonify({'error': 'frame too short'}), 400
+        slave = data[0]
+        read_start = (data[2] << 8) | data[3]
+        read_qty = (data[4] << 8) | data[5]
+        write_start = (data[6] << 8) | data[7]
+        write_qty = (data[8] << 8) | data[9]
+        byte_count = data[10]
+        if byte_count != write_qty * 2 or len(data) < 11 + byte_count + 2:
+            return jsonify({'frame': sim_exception_frame(slave, 0x17, 0x03)})
+        if write_start in SIM_EXCEPTIONS or read_start in SIM_EXCEPTIONS:
+            return jsonify({'frame': sim_exception_frame(slave, 0x17, 0x02)})
+        for i in range(write_qty):
+            SIM_REGISTERS[write_start + i] = (data[11 + 2 * i] << 8) | data[12 + 2 * i]
+        payload = bytearray([slave, 0x17, read_qty * 2])
+        payload += sim_register_block(read_start, read_qty)
+        crc = compute_crc(payload)
+        payload.append(crc & 0xFF)
+        payload.append((crc >> 8) & 0xFF)
+        return jsonify({'frame': payload.hex().upper()})
+
     if len(data) >= 6:
         core = data[:-2]
+        if core[1] == 0x06 and len(core) == 6:
+            SIM_REGISTERS[(core[2] << 8) | core[3]] = (core[4] << 8) | core[5]
         crc = compute_crc(core)
         resp = bytearray(core)
         resp.append(crc & 0xFF)
@@ -627,14 +1304,14 @@ def get_device_config_simple():
     pending = PENDING_CONFIGS.get(device_id)
     if pending:
         print(f"[CONFIG-SIMPLE] Sending pending config to {device_id}: {pending}")
-        return jsonify(pending)
+        return jsonify(attach_command_batch(dict(pending), device_id))
     
     # No pending config
     print(f"[CONFIG-SIMPLE] No pending config for {device_id}")
-    return jsonify({
+    return jsonify(attach_command_batch({
         "status": "no_config",
         "message": "No pending configuration updates"
-    })
+    }, device_id))
 
 @app.route('/api/inverter/config', methods=['GET'])
 def get_device_config():
@@ -657,6 +1334,7 @@ def get_device_config():
     if pending:
         print(f"[CONFIG] Sending pending config to {device_id}: {pending}")
         
+        pending = attach_command_batch(dict(pending), device_id)
         # Wrap in secured envelope if security enabled
         if SECURITY_ENABLED:
             response = create_secured_response(pending, device_id)
@@ -676,11 +1354,13 @@ def get_device_config():
             "nonce": SERVER_NONCE_COUNTER,
             "message": "No pending configuration updates"
         }
+        attach_command_batch(empty_payload, device_id)
         response = create_secured_response(empty_payload, device_id)
         print(f"[DEBUG] Empty secured response: {response}")
         return jsonify(response)
     else:
-        return jsonify({"status": "no_config", "message": "No pending configuration updates"})
+        return jsonify(attach_command_batch({"status": "no_config", "message": "No pending configuration updates"},
+                                            device_id))
 
 @app.route('/api/inverter/config/ack', methods=['POST'])
 def receive_config_ack():
@@ -756,12 +1436,14 @@ def receive_config_ack():
 def send_config_update():
     """
     Cloud admin endpoint to send configuration update to device.
-    Request: {device_id, sampling_interval (seconds), registers: [list]}
+    Request: {device_id, sampling_interval (seconds), registers: [list],
+              uplink_batch: {target_bytes, max_age (seconds)}}
     """
     req = request.get_json(force=True)
     device_id = req.get('device_id', 'EcoWatt001')
     sampling_interval = req.get('sampling_interval')
     registers = req.get('registers', [])
+    uplink_batch = req.get('uplink_batch')
     
     # Generate nonce - use device-compatible range
     global SERVER_NONCE_COUNTER
@@ -774,6 +1456,9 @@ def send_config_update():
         config_update['sampling_interval'] = int(sampling_interval)
     if registers:
         config_update['registers'] = registers
+    if uplink_batch:
+        config_update['uplink_batch'] = {k: int(uplink_batch[k]) for k in ('target_bytes', 'max_age')
+                                         if uplink_batch.get(k) is not None}
     
     pending_config = {
         'nonce': nonce,
@@ -827,140 +1512,236 @@ def get_config_history():
 @app.route('/api/cloud/command/send', methods=['POST'])
 def send_command():
     """
-    Cloud admin endpoint to send command to device.
-    Request: {device_id, action, target_register, value, encrypted (optional)}
+    Cloud admin endpoint to send commands to a device.
+    Request: {device_id, action, target_register, value, params (optional), priority (optional),
+              ttl_s (optional), encrypted (optional)}
+    or {device_id, commands: [{action, target_register, value, priority, ttl_s, params}, ...]}
+    to queue a whole schedule at once. Higher priority runs first; commands of equal
+    priority run in the order given. A command still waiting ttl_s seconds after it was
+    queued is dropped (here if undelivered, on the device otherwise).
     """
+    global COMMAND_ID_COUNTER
     req = request.get_json(force=True)
     device_id = req.get('device_id', 'EcoWatt001')
-    action = req.get('action', 'write_register')
-    target_register = req.get('target_register')
-    value = req.get('value')
     use_encryption = req.get('encrypted', False)
-    
-    # Generate nonce
-    nonce = int(time.time() * 1000)
-    
-    # Build command message
-    command_data = {
-        'action': action,
-        'target_register': target_register,
-        'value': value
-    }
-    
-    # Encrypt payload if requested
-    command_json = json.dumps(command_data)
-    if use_encryption:
-        encrypted_payload = encrypt_payload(command_json)
-        command = {
-            'nonce': nonce,
-            'encrypted': True,
-            'payload': encrypted_payload
+    specs = req.get('commands') or [req]
+    
+    queued = []
+    for spec in specs:
+        COMMAND_ID_COUNTER += 1
+        command_id = COMMAND_ID_COUNTER
+        action = spec.get('action', 'write_register')
+        target_register = spec.get('target_register')
+        value = spec.get('value')
+        priority = max(0, min(255, int(spec.get('priority', 0))))
+        ttl_s = int(spec.get('ttl_s', 0))
+        nonce = int(time.time() * 1000) + len(queued)
+        
+        # Build command message
+        command_data = {
+            'command_id': command_id,
+            'action': action,
+            'target_register': target_register,
+            'value': value,
+            'priority': priority
         }
-        log_security_event(device_id, 'command_encrypted', f'Command encrypted for nonce {nonce}')
-    else:
-        command = {
+        # e.g. fetch_logs: {"boots_ago": 1, "from_s": 0, "to_s": 600}
+        if spec.get('params'):
+            command_data['params'] = spec['params']
+        
+        # Encrypt payload if requested
+        command_json = json.dumps(command_data)
+        if use_encryption:
+            command = {
+                'command_id': command_id,
+                'priority': priority,
+                'encrypted': True,
+                'payload': encrypt_payload(command_json)
+            }
+            log_security_event(device_id, 'command_encrypted', f'Command encrypted for nonce {nonce}')
+        else:
+            command = dict(command_data)
+        command['nonce'] = nonce
+        
+        # Add HMAC for security
+        command['mac'] = hmac.new(PRE_SHARED_KEY, command_json.encode(), hashlib.sha256).hexdigest()
+        
+        PENDING_COMMANDS.setdefault(device_id, []).append({
+            'command': command,
+            'priority': priority,
+            'expires_at': time.time() + ttl_s if ttl_s > 0 else None,
+            'delivered_at': None,
+            'deliveries': 0
+        })
+        
+        # Log to history
+        COMMAND_HISTORY.append({
+            'device_id': device_id,
+            'timestamp': datetime.datetime.now().isoformat(),
+            'command_id': command_id,
             'nonce': nonce,
-            'command': command_data
-        }
-    
-    # Add HMAC for security
-    mac = hmac.new(PRE_SHARED_KEY, command_json.encode(), hashlib.sha256).hexdigest()
-    command['mac'] = mac
-    
-    # Store pending command
-    PENDING_COMMANDS[device_id] = command
-    
-    # Log to history
-    COMMAND_HISTORY.append({
-        'device_id': device_id,
-        'timestamp': datetime.datetime.now().isoformat(),
-        'nonce': nonce,
-        'action': action,
-        'target_register': target_register,
-        'value': value,
-        'status': 'pending',
-        'encrypted': use_encryption
-    })
-    
-    # Log command event
-    log_command_event(device_id, 'command_queued', 
-                     f'Action: {action}, Register: {target_register}, Value: {value}, Encrypted: {use_encryption}')
+            'action': action,
+            'target_register': target_register,
+            'value': value,
+            'priority': priority,
+            'ttl_s': ttl_s,
+            'status': 'pending',
+            'encrypted': use_encryption
+        })
+        
+        # Log command event
+        log_command_event(device_id, 'command_queued', 
+                         f'Id: {command_id}, Action: {action}, Register: {target_register}, Value: {value}, '
+                         f'Priority: {priority}, Encrypted: {use_encryption}')
+        queued.append(command_id)
     
-    print(f"[COMMAND] Queued command for {device_id}: {action} on {target_register} = {value} (encrypted={use_encryption})")
+    print(f"[COMMAND] Queued {len(queued)} commands for {device_id} (encrypted={use_encryption})")
     
     return jsonify({
         'status': 'success',
-        'message': f'Command queued for {device_id}',
-        'nonce': nonce,
+        'message': f'{len(queued)} commands queued for {device_id}',
+        'command_ids': queued,
         'encrypted': use_encryption
     })
 
+def _update_command_history(device_id, command_id, **fields):
+    for entry in COMMAND_HISTORY:
+        if entry.get('device_id') == device_id and entry.get('command_id') == command_id:
+            entry.update(fields)
+            break
+
+def take_command_batch(device_id):
+    """
+    Commands to deliver on this poll, highest priority first, and how many more are
+    waiting. Expired commands are dropped; delivered ones stay queued until their result
+    arrives and are resent if it does not come within COMMAND_REDELIVER_S, up to
+    COMMAND_MAX_DELIVERIES times.
+    """
+    queue = PENDING_COMMANDS.get(device_id)
+    if not queue:
+        return [], 0
+    now = time.time()
+    for entry in list(queue):
+        command_id = entry['command']['command_id']
+        if entry['expires_at'] is not None and entry['expires_at'] <= now:
+            queue.remove(entry)
+            _update_command_history(device_id, command_id, status='expired')
+            log_command_event(device_id, 'command_expired', f'Id: {command_id} (not delivered in time)')
+        elif entry['deliveries'] >= COMMAND_MAX_DELIVERIES and now - entry['delivered_at'] >= COMMAND_REDELIVER_S:
+            queue.remove(entry)
+            _update_command_history(device_id, command_id, status='no_result')
+            log_command_event(device_id, 'command_no_result', f'Id: {command_id} after {entry["deliveries"]} deliveries')
+
+    due = [e for e in queue if e['delivered_at'] is None or now - e['delivered_at'] >= COMMAND_REDELIVER_S]
+    due.sort(key=lambda e: (-e['priority'], e['command']['command_id']))
+    batch = due[:MAX_COMMANDS_PER_POLL]
+    commands = []
+    for entry in batch:
+        entry['delivered_at'] = now
+        entry['deliveries'] += 1
+        command = dict(entry['command'])
+        if entry['expires_at'] is not None:
+            command['ttl_s'] = max(1, int(entry['expires_at'] - now))
+        commands.append(command)
+    if commands:
+        print(f"[COMMAND] Delivering {len(commands)} commands to {device_id}")
+    return commands, len(due) - len(batch)
+
+def attach_command_batch(response, device_id):
+    """Adds {commands, commands_remaining} to a poll response when commands are due."""
+    commands, remaining = take_command_batch(device_id)
+    if commands:
+        response['commands'] = commands
+    if remaining:
+        response['commands_remaining'] = remaining
+    return response
+
 @app.route('/api/inverter/command', methods=['GET'])
 def get_pending_command():
     """
     Device polls this endpoint for pending commands.
     """
     device_id = request.headers.get('Device-ID') or request.args.get('device_id') or 'EcoWatt001'
-    
-    pending = PENDING_COMMANDS.get(device_id)
-    if pending:
-        print(f"[COMMAND] Sending pending command to {device_id}")
-        return jsonify(pending)
-    
-    return jsonify({})
+    return jsonify(attach_command_batch({}, device_id))
 
 @app.route('/api/inverter/command/result', methods=['POST'])
+@app.route('/api/inverter/config/command/result', methods=['POST'])
 def receive_command_result():
     """
-    Device sends command execution result.
-    Format: {nonce, command_result: {status, executed_at, modbus_response (optional)}}
+    Device sends command execution results, one report per executed batch:
+    {timestamp, result_count, command_results: [{command_id, status, status_message,
+     executed_at, actual_value (optional), error_details (optional)}, ...]}
+    Single results in the form {nonce, command_result: {status, executed_at, ...}} are
+    still accepted.
     """
-    result = request.get_json(force=True)
     device_id = request.headers.get('Device-ID') or 'EcoWatt001'
+    body = request.get_json(force=True, silent=True) or {}
+    if SECURITY_ENABLED and 'payload' in body and 'mac' in body:
+        payload, err = _unwrap_secured_payload(device_id)
+        if err:
+            return err
+        try:
+            body = json.loads(payload)
+        except Exception as e:
+            return jsonify({'status': 'error', 'message': f'invalid result payload: {e}'}), 400
     
-    # Verify nonce (anti-replay)
-    nonce = result.get('nonce')
-    if nonce and not check_nonce(device_id, nonce):
-        log_security_event(device_id, 'replay_attack_command_result', f'Nonce: {nonce}')
-        return jsonify({'status': 'error', 'message': 'Invalid nonce (replay attack)'}), 403
-    
-    # Store result
-    result['device_id'] = device_id
-    result['received_at'] = datetime.datetime.now().isoformat()
-    COMMAND_RESULTS.append(result)
-    
-    # Extract command result details
-    cmd_result = result.get('command_result', {})
-    status = cmd_result.get('status', 'unknown')
-    executed_at = cmd_result.get('executed_at')
-    modbus_response = cmd_result.get('modbus_response', 'N/A')
-    modbus_frame = cmd_result.get('modbus_frame', 'N/A')
-    
-    # Update history
-    for entry in COMMAND_HISTORY:
-        if entry.get('device_id') == device_id and entry.get('nonce') == nonce:
-            entry['status'] = status
-            entry['executed_at'] = executed_at
-            entry['modbus_response'] = modbus_response
-            break
-    
-    # Log command execution details
-    log_command_event(device_id, f'command_result_{status}', 
-                     f'Nonce: {nonce}, Executed: {executed_at}, Modbus Response: {modbus_response}')
-    
-    # If Modbus frame is provided, log it
-    if modbus_frame != 'N/A':
-        log_command_event(device_id, 'modbus_frame_sent', f'Frame: {modbus_frame}')
+    received_at = datetime.datetime.now().isoformat()
+    if 'command_results' in body:
+        results = body.get('command_results') or []
+    else:
+        # Verify nonce (anti-replay)
+        nonce = body.get('nonce')
+        if nonce and not check_nonce(device_id, nonce):
+            log_security_event(device_id, 'replay_attack_command_result', f'Nonce: {nonce}')
+            return jsonify({'status': 'error', 'message': 'Invalid nonce (replay attack)'}), 403
+        single = dict(body.get('command_result', {}))
+        single['nonce'] = nonce
+        results = [single]
+    
+    queue = PENDING_COMMANDS.get(device_id, [])
+    for result in results:
+        # Store result
+        result['device_id'] = device_id
+        result['received_at'] = received_at
+        COMMAND_RESULTS.append(result)
+        
+        command_id = result.get('command_id')
+        nonce = result.get('nonce')
+        status = result.get('status', 'unknown')
+        executed_at = result.get('executed_at')
+        modbus_response = result.get('modbus_response', 'N/A')
+        modbus_frame = result.get('modbus_frame', 'N/A')
+        
+        # Update history and clear the pending command it answers
+        for entry in COMMAND_HISTORY:
+            if entry.get('device_id') == device_id and \
+                    (entry.get('command_id') == command_id if command_id is not None else entry.get('nonce') == nonce):
+                entry['status'] = status
+                entry['executed_at'] = executed_at
+                entry['modbus_response'] = modbus_response
+                break
+        for entry in queue:
+            command = entry['command']
+            if (command_id is not None and command.get('command_id') == command_id) or \
+                    (command_id is None and nonce is not None and command.get('nonce') == nonce):
+                queue.remove(entry)
+                log_command_event(device_id, 'command_completed', f'Id: {command.get("command_id")}, Status: {status}')
+                break
+        
+        # Log command execution details
+        log_command_event(device_id, f'command_result_{status}', 
+                         f'Id: {command_id}, Nonce: {nonce}, Executed: {executed_at}, Modbus Response: {modbus_response}')
+        
+        # If Modbus frame is provided, log it
+        if modbus_frame != 'N/A':
+            log_command_event(device_id, 'modbus_frame_sent', f'Frame: {modbus_frame}')
     
-    # Clear pending command if nonce matches
-    pending = PENDING_COMMANDS.get(device_id)
-    if pending and pending.get('nonce') == nonce:
-        PENDING_COMMANDS.pop(device_id)
-        log_command_event(device_id, 'command_completed', f'Nonce: {nonce}, Status: {status}')
+    if not queue:
+        PENDING_COMMANDS.pop(device_id, None)
     
-    print(f"[COMMAND RESULT] Received from {device_id}: status={status}, modbus={modbus_response}")
+    print(f"[COMMAND RESULT] Received {len(results)} results from {device_id}")
     
-    return jsonify({'status': 'success', 'message': 'Command result received'})
+    return jsonify({'status': 'success', 'message': 'Command results received', 'received': len(results)})
 
 @app.route('/api/cloud/command/history', methods=['GET'])
 def get_command_history():
@@ -1091,12 +1872,15 @@ def receive_fota_status():
     device_id = request.headers.get('Device-ID') or 'EcoWatt001'
     
     fota_status = status.get('fota_status', {})
-    chunk_received = fota_status.get('chunk_received')
-    verified = fota_status.get('verified')
-    boot_status = fota_status.get('boot_status')
-    rollback = fota_status.get('rollback', False)
-    error = fota_status.get('error')
-    
+    _record_fota_status(device_id,
+                        chunk_received=fota_status.get('chunk_received'),
+                        verified=fota_status.get('verified'),
+                        boot_status=fota_status.get('boot_status'),
+                        rollback=fota_status.get('rollback', False),
+                        error=fota_status.get('error'))
+    return jsonify({'status': 'success'})
+
+def _record_fota_status(device_id, chunk_received, verified, boot_status, rollback, error):
     # Update device FOTA status
     FOTA_STATUS[device_id] = {
         'chunk_received': chunk_received,
@@ -1132,8 +1916,6 @@ def receive_fota_status():
             log_fota_event(device_id, 'boot_failed', f'Boot failed, rollback initiated')
     
     print(f"[FOTA STATUS] Device {device_id}: chunk {chunk_received}, verified={verified}, boot={boot_status}, rollback={rollback}")
-    
-    return jsonify({'status': 'success'})
 
 @app.route('/api/cloud/fota/status', methods=['GET'])
 def get_fota_status():
@@ -1305,9 +2087,8 @@ def device_status():
     if device_id in PENDING_CONFIGS:
         response['config_update'] = PENDING_CONFIGS[device_id]
     
-    # Check for pending command
-    if device_id in PENDING_COMMANDS:
-        response['command'] = PENDING_COMMANDS[device_id]
+    # Check for pending commands
+    attach_command_batch(response, device_id)
     
     # Check for FOTA
     if FIRMWARE_MANIFEST:
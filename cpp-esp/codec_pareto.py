@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+Pareto charts for the uplink codec evaluation.
+
+Reads the CSV written by tests/codec_eval (--csv) and, for every corpus and batch
+size, finds the codec configurations that are not beaten on both compression ratio
+and encode speed. With matplotlib installed it writes one chart per batch size
+(ratio vs encode MB/s, frontier highlighted); without it the frontier is printed.
+
+--max-err filters out lossy configurations whose worst reconstruction error is above
+the tolerance, and the smallest-ratio survivor per batch size is suggested as the
+default (AGGREGATE rows are summaries and only included with --allow-summary).
+
+Usage:
+    ./codec_eval --csv codecs.csv samples.csv
+    python codec_pareto.py codecs.csv --max-err 0.05 --out charts/
+"""
+import argparse
+import csv
+import os
+from collections import defaultdict
+
+
+def load(path):
+    rows = []
+    with open(path, newline='') as f:
+        for r in csv.DictReader(f):
+            if r['ok'] != '1':
+                continue
+            for key in ('ratio', 'encode_mbps', 'decode_mbps', 'max_abs_err', 'bytes_per_sample'):
+                r[key] = float(r[key])
+            for key in ('batch', 'enc_ram', 'dec_ram', 'summary'):
+                r[key] = int(r[key])
+            rows.append(r)
+    return rows
+
+
+def pareto(rows):
+    """Rows not dominated on (lower ratio, higher encode speed), sorted by ratio."""
+    front = []
+    for r in rows:
+        dominated = any(
+            o['ratio'] <= r['ratio'] and o['encode_mbps'] >= r['encode_mbps'] and
+            (o['ratio'] < r['ratio'] or o['encode_mbps'] > r['encode_mbps'])
+            for o in rows)
+        if not dominated:
+            front.append(r)
+    return sorted(front, key=lambda r: r['ratio'])
+
+
+def plot(corpus, batch, rows, front, out_dir):
+    import matplotlib
+    matplotlib.use('Agg')
+    import matplotlib.pyplot as plt
+
+    fig, ax = plt.subplots(figsize=(7, 4.5))
+    ax.scatter([r['encode_mbps'] for r in rows], [r['ratio'] for r in rows], color='0.6', s=18)
+    ax.plot([r['encode_mbps'] for r in front], [r['ratio'] for r in front], 'o-', color='tab:blue')
+    for r in front:
+        ax.annotate(r['codec'], (r['encode_mbps'], r['ratio']), fontsize=7,
+                    xytext=(4, 3), textcoords='offset points')
+    ax.set_xscale('log')
+    ax.set_xlabel('encode MB/s (host)')
+    ax.set_ylabel('encoded / raw bytes')
+    ax.set_title('%s, batch %d' % (os.path.basename(corpus), batch))
+    ax.grid(True, alpha=0.3)
+    name = '%s_batch%d.png' % (os.path.splitext(os.path.basename(corpus))[0], batch)
+    path = os.path.join(out_dir, name)
+    fig.tight_layout()
+    fig.savefig(path, dpi=120)
+    plt.close(fig)
+    return path
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Pareto frontier of uplink codecs per batch size")
+    ap.add_argument('csv', help="output of codec_eval --csv")
+    ap.add_argument('--max-err', type=float, default=None, help="worst acceptable absolute error")
+    ap.add_argument('--allow-summary', action='store_true', help="consider AGGREGATE rows")
+    ap.add_argument('--out', default='.', help="directory for the charts")
+    args = ap.parse_args()
+
+    try:
+        import matplotlib  # noqa: F401
+        have_plot = True
+    except ImportError:
+        have_plot = False
+        print("matplotlib not installed, printing frontiers only")
+
+    groups = defaultdict(list)
+    for r in load(args.csv):
+        if r['summary'] and not args.allow_summary:
+            continue
+        if args.max_err is not None and not r['summary'] and r['max_abs_err'] > args.max_err:
+            continue
+        groups[(r['corpus'], r['batch'])].append(r)
+
+    if have_plot:
+        os.makedirs(args.out, exist_ok=True)
+    for (corpus, batch), rows in sorted(groups.items()):
+        front = pareto(rows)
+        print("\n%s, batch %d: %d configurations, %d on the frontier" % (corpus, batch, len(rows), len(front)))
+        print("  %-20s %7s %9s %9s %8s %10s" % ('codec', 'ratio', 'enc MB/s', 'dec MB/s', 'enc RAM', 'max err'))
+        for r in front:
+            print("  %-20s %7.3f %9.1f %9.1f %8d %10.4g" % (
+                r['codec'], r['ratio'], r['encode_mbps'], r['decode_mbps'], r['enc_ram'], r['max_abs_err']))
+        print("  suggested default: %s" % front[0]['codec'])
+        if have_plot:
+            print("  chart: %s" % plot(corpus, batch, rows, front, args.out))
+
+
+if __name__ == '__main__':
+    main()
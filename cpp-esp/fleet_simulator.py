@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+Fleet upload simulator.
+
+Models N devices that power up together (site power restored) and compares the
+request rate the cloud sees under:
+
+  sync     fixed tickers started at boot (the old firmware behaviour)
+  phased   per-device phase offset = FNV-1a(device_id) % interval
+  hinted   phased + server flow control (503 Retry-After above capacity,
+           X-Next-Interval stretching the period while the fleet is over budget)
+
+The device-side maths mirror flow_control.cpp so the numbers match the firmware.
+
+Usage:
+    python fleet_simulator.py --devices 500 --interval 15 --capacity 25
+"""
+import argparse
+import random
+
+
+def fnv1a32(text):
+    h = 2166136261
+    for b in text.encode():
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def phase_offset_ms(device_id, interval_ms):
+    return fnv1a32(device_id) % interval_ms if interval_ms else 0
+
+
+class Device:
+    def __init__(self, device_id, boot_ms, interval_ms, phased):
+        self.id = device_id
+        self.seed = fnv1a32(device_id)
+        self.interval_ms = interval_ms
+        # Ticker.start() fires one interval after boot; startWithPhase() after the phase
+        first = phase_offset_ms(device_id, interval_ms) if phased else interval_ms
+        self.next_ms = boot_ms + first
+        self.defer_until_ms = 0
+
+    def on_response(self, now_ms, status, retry_after_s, next_interval_s, min_ms=5000, max_ms=3600000):
+        if retry_after_s is not None:
+            ms = retry_after_s * 1000
+            jitter = self.seed % (ms // 4 + 1) if ms else 0
+            self.defer_until_ms = now_ms + ms + jitter
+        if next_interval_s is not None:
+            self.interval_ms = min(max(int(next_interval_s * 1000), min_ms), max_ms)
+
+
+class Server:
+    def __init__(self, capacity_rps, hints, retry_after_s, fleet_size, target_rps):
+        self.capacity = capacity_rps
+        self.hints = hints
+        self.retry_after_s = retry_after_s
+        self.fleet_size = fleet_size
+        self.target_rps = target_rps
+        self.per_second = {}
+        self.shed = 0
+
+    def handle(self, now_ms):
+        second = now_ms // 1000
+        count = self.per_second.get(second, 0) + 1
+        self.per_second[second] = count
+        if not self.hints:
+            return 200, None, None
+        # Period that keeps the whole fleet at target_rps on average
+        next_interval = max(1, -(-self.fleet_size // self.target_rps))
+        if self.capacity and count > self.capacity:
+            self.shed += 1
+            return 503, self.retry_after_s, next_interval
+        return 200, None, next_interval
+
+
+def simulate(mode, args):
+    rng = random.Random(args.seed)
+    interval_ms = args.interval * 1000
+    devices = [Device(f"EcoWatt{i:04d}", rng.randint(0, args.boot_spread_ms), interval_ms, mode != 'sync')
+               for i in range(args.devices)]
+    server = Server(args.capacity, mode == 'hinted', args.retry_after, args.devices, args.target_rps)
+
+    end_ms = args.duration * 1000
+    step_ms = args.step_ms
+    now = 0
+    while now < end_ms:
+        for d in devices:
+            if now < d.next_ms:
+                continue
+            # A deferred device skips the tick but keeps its schedule
+            if now >= d.defer_until_ms:
+                status, retry_after, next_interval = server.handle(now)
+                d.on_response(now, status, retry_after, next_interval)
+            d.next_ms = now + d.interval_ms
+        now += step_ms
+
+    seconds = end_ms // 1000
+    rates = sorted(server.per_second.get(s, 0) for s in range(seconds))
+    total = sum(rates)
+    p99 = rates[min(len(rates) - 1, int(len(rates) * 0.99))]
+    return {
+        'mode': mode,
+        'requests': total,
+        'mean_rps': total / seconds,
+        'peak_rps': rates[-1],
+        'p99_rps': p99,
+        'shed': server.shed,
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Compare fleet upload scheduling strategies")
+    ap.add_argument('--devices', type=int, default=500)
+    ap.add_argument('--interval', type=int, default=15, help="upload interval in seconds")
+    ap.add_argument('--duration', type=int, default=900, help="simulated seconds")
+    ap.add_argument('--boot-spread-ms', type=int, default=2000, help="devices boot within this window")
+    ap.add_argument('--capacity', type=int, default=25, help="server requests/s before shedding (hinted mode)")
+    ap.add_argument('--target-rps', type=int, default=20, help="fleet rate the server steers towards")
+    ap.add_argument('--retry-after', type=int, default=10, help="Retry-After seconds on 503")
+    ap.add_argument('--step-ms', type=int, default=50, help="device loop granularity")
+    ap.add_argument('--seed', type=int, default=1)
+    args = ap.parse_args()
+
+    print(f"{args.devices} devices, {args.interval}s interval, boot spread {args.boot_spread_ms} ms, "
+          f"{args.duration}s simulated")
+    print(f"{'mode':<8} {'requests':>9} {'mean/s':>8} {'p99/s':>7} {'peak/s':>7} {'shed':>6}")
+    results = [simulate(mode, args) for mode in ('sync', 'phased', 'hinted')]
+    for r in results:
+        print(f"{r['mode']:<8} {r['requests']:>9} {r['mean_rps']:>8.1f} {r['p99_rps']:>7} "
+              f"{r['peak_rps']:>7} {r['shed']:>6}")
+    base = results[0]['peak_rps']
+    for r in results[1:]:
+        print(f"{r['mode']}: peak request rate {base} -> {r['peak_rps']} req/s "
+              f"({100.0 * (base - r['peak_rps']) / base:.0f}% lower)")
+
+
+if __name__ == '__main__':
+    main()
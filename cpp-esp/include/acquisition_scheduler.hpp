@@ -3,6 +3,7 @@
 
 #include "ticker_fallback.hpp"
 #include "types.hpp"
+#include "modbus_tcp.hpp"
 #include <Arduino.h>
 class ProtocolAdapter;
 class DataStorage;
@@ -26,6 +27,7 @@ private:
     uint32_t printInterval_ = 15000; // 15 seconds like cpp
     std::vector<uint8_t> regList_;
     std::vector<Sample> recentSamples_;
+    ModbusRegisterBatch batch_;        // reused every cycle
     bool running_ = false;
     ProtocolAdapter* adapter_ = nullptr;
     DataStorage* storage_ = nullptr;
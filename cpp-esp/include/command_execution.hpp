@@ -11,6 +11,13 @@ struct CommandRequest {
     float value;                      // Value to write
     uint32_t timestamp;               // When command was issued
     uint32_t nonce;                   // For security and deduplication
+    // fetch_logs: which boot (0 = current, 1 = the one before) and uptime range in seconds
+    uint32_t boots_ago = 0;
+    uint32_t from_s = 0;
+    uint32_t to_s = 0;                // 0 = up to now
+    uint32_t duration_s = 0;          // profile: capture length
+    uint8_t priority = 0;             // higher runs first within a batch
+    uint32_t ttl_s = 0;               // drop if not run this long after arrival; 0 = never
 };
 
 // Command execution result from device to cloud
@@ -21,6 +28,7 @@ enum class CommandStatus {
     INVALID_VALUE,                    // Value out of range
     TIMEOUT,                          // Communication timeout with Inverter SIM
     PENDING,                          // Command queued but not executed yet
+    EXPIRED,                          // TTL ran out before it could run
     UNKNOWN                           // Unknown error
 };
 
@@ -51,6 +59,7 @@ inline const char* commandStatusToString(CommandStatus status) {
         case CommandStatus::INVALID_VALUE: return "invalid_value";
         case CommandStatus::TIMEOUT: return "timeout";
         case CommandStatus::PENDING: return "pending";
+        case CommandStatus::EXPIRED: return "expired";
         case CommandStatus::UNKNOWN: return "unknown";
         default: return "unknown";
     }
@@ -64,5 +73,6 @@ inline CommandStatus stringToCommandStatus(const char* str) {
     if (strcmp(str, "invalid_value") == 0) return CommandStatus::INVALID_VALUE;
     if (strcmp(str, "timeout") == 0) return CommandStatus::TIMEOUT;
     if (strcmp(str, "pending") == 0) return CommandStatus::PENDING;
+    if (strcmp(str, "expired") == 0) return CommandStatus::EXPIRED;
     return CommandStatus::UNKNOWN;
 }
@@ -1,8 +1,11 @@
 #pragma once
 #include "command_execution.hpp"
+#include "command_queue.hpp"
 #include "protocol_adapter.hpp"
 #include "config_manager.hpp"
 #include "http_client.hpp"
+#include "data_storage.hpp"
+#include "log_store.hpp"
 #include <vector>
 #include <functional>
 
@@ -13,8 +16,11 @@ public:
     
     // Queue a command for execution
     bool queueCommand(const CommandRequest& command);
+
+    // Queue every command of a poll response; returns how many were queued
+    size_t queueCommands(const std::vector<CommandRequest>& commands);
     
-    // Execute all pending commands
+    // Execute all pending commands, highest priority first; expired ones are reported
     void executePendingCommands();
     
     // Get results of executed commands
@@ -25,18 +31,28 @@ public:
     
     // Check if command with ID already processed (idempotency)
     bool isCommandProcessed(uint32_t command_id) const;
+
+    // Commands that can still be queued before the queue rejects new ones
+    size_t queueSpace() const { return queue_.space(); }
     
     // Callback when command is executed
     void onCommandExecuted(std::function<void(const CommandResult&)> callback);
+
+    // Optional: readback values from 0x17 writes are published to the latest-value table
+    void setDataStorage(DataStorage* storage) { storage_ = storage; }
+
+    // Optional: enables the fetch_logs action
+    void setLogStore(LogStore* logs) { logs_ = logs; }
     
 private:
     ProtocolAdapter* adapter_;
     ConfigManager* config_;
     EcoHttpClient* http_;
+    DataStorage* storage_ = nullptr;
+    LogStore* logs_ = nullptr;
     
-    std::vector<QueuedCommand> command_queue_;
+    CommandQueue queue_;
     std::vector<CommandResult> executed_results_;
-    std::vector<uint32_t> processed_command_ids_;
     
     std::function<void(const CommandResult&)> onExecutedCallback_;
     
@@ -48,8 +64,11 @@ private:
     
     // Convert register name to address
     bool resolveRegisterAddress(const std::string& register_name, uint8_t& address);
+
+    // Write via 0x17, reading back the written register with status and power in that
+    // transaction (see ModbusReadback); false if the inverter does not report the written value
+    bool writeWithReadback(uint8_t reg_addr, uint16_t raw_value, float gain, float& confirmed_value);
     
-    const size_t MAX_QUEUE_SIZE = 10;
-    const size_t MAX_RESULTS_SIZE = 20;
-    const size_t MAX_PROCESSED_IDS = 50;
+    // Results wait here until the next report; a full queue's worth must fit
+    const size_t MAX_RESULTS_SIZE = CommandQueue::MAX_PENDING + 8;
 };
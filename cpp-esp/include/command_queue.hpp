@@ -0,0 +1,65 @@
+#pragma once
+#include "command_execution.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pending cloud commands, in execution order.
+//
+// A poll response carries a whole batch of commands; all of them are admitted here in
+// one pass and CommandExecutor drains the queue on the next loop(). Order is priority
+// first (higher runs first), then arrival, so a 20-step setpoint schedule sent at one
+// priority runs in the order it was written. A command with a TTL gets a deadline when
+// it arrives; if it is still waiting when the deadline passes it is handed out marked
+// expired and reported instead of executed.
+//
+// IDs of queued and recently finished commands are remembered, with how they finished,
+// so a batch that is redelivered (the result upload was lost) does not run twice and the
+// cloud can be answered with the stored outcome instead.
+
+enum class CommandAdmit : uint8_t {
+    QUEUED = 0,
+    DUPLICATE = 1,   // queued already, or finished recently
+    FULL = 2
+};
+
+class CommandQueue {
+public:
+    static constexpr size_t MAX_PENDING = 32;
+    static constexpr size_t MAX_RECENT_IDS = 64;
+
+    CommandAdmit push(const CommandRequest& command, uint32_t now_ms);
+
+    // Removes the next command in execution order. expired is set when its deadline
+    // passed while it waited. False when the queue is empty. The ID is remembered as
+    // PENDING until markDone() records the outcome.
+    bool pop(uint32_t now_ms, CommandRequest& command, bool& expired);
+
+    // Remembers how a command finished; also for one rejected on arrival
+    void markDone(uint32_t command_id, CommandStatus status = CommandStatus::UNKNOWN);
+
+    bool seen(uint32_t command_id) const;
+    // True, and status set, for a recently finished (or running) command
+    bool finished(uint32_t command_id, CommandStatus& status) const;
+    size_t size() const { return pending_.size(); }
+    size_t space() const { return MAX_PENDING - pending_.size(); }
+    bool empty() const { return pending_.empty(); }
+    uint32_t expired() const { return expired_; }
+
+private:
+    struct Entry {
+        CommandRequest request;
+        uint32_t deadline_ms;   // meaningful only when request.ttl_s != 0
+        uint32_t arrival;
+    };
+
+    struct Done {
+        uint32_t command_id;
+        CommandStatus status;
+    };
+
+    std::vector<Entry> pending_;
+    std::vector<Done> recent_;       // oldest first
+    uint32_t arrivals_ = 0;
+    uint32_t expired_ = 0;
+};
@@ -16,6 +16,10 @@ struct ModbusConfig {
     uint32_t timeout_ms;
     uint8_t max_retries;
     uint32_t retry_delay_ms;
+    std::string tcp_host;       // Modbus TCP unit or gateway; empty = HTTP SIM
+    uint16_t tcp_port;
+    uint8_t max_in_flight;      // Modbus TCP requests outstanding at once
+    bool hedge_reads;           // duplicate slow Modbus TCP reads on a second connection
 };
 
 struct ApiConfig {
@@ -36,6 +40,13 @@ struct RegisterConfig {
     std::string access;
 };
 
+// When the uplink flushes (see FlushTrigger)
+struct UplinkBatchConfig {
+    uint32_t target_bytes;
+    uint32_t max_age_ms;
+    uint8_t fec_group;          // chunks per FEC group; 0 = retry each chunk instead
+};
+
 struct AcquisitionConfig {
     uint32_t polling_interval_ms;
     std::vector<uint8_t> minimum_registers;
@@ -51,12 +62,16 @@ public:
     ModbusConfig getModbusConfig() const;
     ApiConfig getApiConfig() const;
     RegisterConfig getRegisterConfig(uint8_t addr) const;
+    // Gain alone, without copying the register's strings; 0 for an unknown register
+    float getRegisterGain(uint8_t addr) const;
     AcquisitionConfig getAcquisitionConfig() const;
+    UplinkBatchConfig getUplinkBatchConfig() const;
     LoggingConfig getLoggingConfig() const;
     
     // Runtime configuration update methods
     bool validateSamplingInterval(uint32_t interval_ms, std::string& reason) const;
     bool validateRegisters(const std::vector<uint8_t>& registers, std::string& reason) const;
+    bool validateUplinkBatch(uint32_t target_bytes, uint32_t max_age_ms, std::string& reason) const;
     ConfigUpdateAck applyConfigUpdate(const ConfigUpdateRequest& request);
     
     // Persistence methods
@@ -82,6 +97,7 @@ private:
     ApiConfig api_config_;
     std::vector<RegisterConfig> register_configs_;
     AcquisitionConfig acquisition_config_;
+    UplinkBatchConfig uplink_batch_config_;
     LoggingConfig logging_config_;
     ConfigValidationRules validation_rules_;
     PersistentConfig persistent_config_;
@@ -9,6 +9,9 @@ struct ConfigUpdateRequest {
     std::vector<uint8_t> registers; // New register list (empty = no change)
     bool has_sampling_interval;     // Flag indicating if sampling interval is in request
     bool has_registers;             // Flag indicating if registers are in request
+    uint32_t uplink_target_bytes;   // Uplink flush size target (0 = no change)
+    uint32_t uplink_max_age_ms;     // Uplink latency bound (0 = no change)
+    bool has_uplink_batch;          // Flag indicating if uplink_batch is in request
     uint32_t nonce;                 // For idempotency and deduplication
     uint32_t timestamp;             // Request timestamp
 };
@@ -51,6 +54,12 @@ struct ConfigValidationRules {
     uint8_t max_register_addr = 9;
     size_t min_register_count = 1;
     size_t max_register_count = 10;
+
+    // Uplink batching constraints
+    uint32_t min_uplink_target_bytes = 256;
+    uint32_t max_uplink_target_bytes = 16384;
+    uint32_t min_uplink_max_age_ms = 1000;       // 1 second
+    uint32_t max_uplink_max_age_ms = 3600000;    // 1 hour
     
     // General constraints
     uint32_t max_nonce_age_ms = 300000;  // 5 minutes max age for deduplication
@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Where the CPU goes.
+//
+// Two views, both reported in the uplink metadata:
+//   subsystems  cumulative time and call counts for the cooperative work inside loop()
+//               and the Ticker callbacks, charged through CpuScope. Scopes nest and
+//               charge exclusive time: an upload that secures and posts its payload
+//               shows up as uplink + security + network, not three times the upload.
+//   tasks       FreeRTOS run-time counters per task over the last report interval
+//               (needs configGENERATE_RUN_TIME_STATS; empty when the core lacks it).
+//
+// Clock: on the host, CPU time of the calling thread (CLOCK_THREAD_CPUTIME_ID) and
+// threads registered with TaskRuntimeMonitor::registerThread stand in for tasks. On the
+// device, esp_timer time in the calling task, so a scope that blocks (network) measures
+// the wait; the task counters give the true CPU split.
+
+enum class CpuSubsystem : uint8_t {
+    ACQUISITION = 0,   // Modbus polling
+    UPLINK = 1,        // batch encoding and packetizing
+    SECURITY = 2,      // HMAC, envelopes, nonce checks
+    JSON = 3,          // config / command parsing
+    FLASH = 4,         // sample log, CSV, log store commits
+    NETWORK = 5,       // HTTP requests
+    FOTA = 6,
+    COUNT = 7
+};
+
+const char* cpuSubsystemToString(CpuSubsystem s);
+
+// Monotonic microseconds charged to the calling thread (see above)
+uint64_t cpuClockUs();
+
+struct CpuCounter {
+    uint64_t us = 0;
+    uint32_t calls = 0;
+    uint32_t max_us = 0;
+};
+
+class CpuAccounting {
+public:
+    static void record(CpuSubsystem s, uint64_t us);
+    static CpuCounter get(CpuSubsystem s);
+    static void reset();
+    // {"acquisition":{"us":..,"calls":..,"max_us":..},...}
+    static std::string subsystemsJson();
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> us{0};
+        std::atomic<uint32_t> calls{0};
+        std::atomic<uint32_t> max_us{0};
+    };
+    static Slot slots_[(size_t)CpuSubsystem::COUNT];
+};
+
+// Charges the time until it goes out of scope to a subsystem, minus nested scopes.
+// Also a span in a profiling capture when one is running (profiler.hpp).
+class CpuScope {
+public:
+    explicit CpuScope(CpuSubsystem s);
+    ~CpuScope();
+    CpuScope(const CpuScope&) = delete;
+    CpuScope& operator=(const CpuScope&) = delete;
+
+private:
+    CpuSubsystem s_;
+    uint64_t start_;
+    uint64_t child_us_ = 0;
+    CpuScope* parent_;
+    static thread_local CpuScope* current_;
+};
+
+struct TaskRuntime {
+    char name[16] = {0};
+    uint32_t runtime = 0;   // cumulative us; wraps (FreeRTOS counters are 32-bit), so
+                            // snapshots must be less than ~71 min apart
+};
+
+// Per-task run time between two snapshots
+class TaskRuntimeMonitor {
+public:
+    static constexpr size_t MAX_TASKS = 24;
+
+    // Takes a snapshot of every task (every registered thread on the host) and updates
+    // the per-interval figures. Returns the number of tasks seen.
+    size_t sample();
+
+    // Feeds a snapshot directly; interval_us is the wall time since the previous one.
+    // Shares are of interval_us x cores: all cores on the device, one on the host.
+    void update(const TaskRuntime* tasks, size_t count, uint32_t interval_us, unsigned cores);
+
+    size_t tasks() const { return count_; }
+    const TaskRuntime& task(size_t i) const { return cur_[i]; }
+    uint32_t deltaOf(size_t i) const { return delta_[i]; }
+    // Share of the interval, in hundredths of a percent
+    uint32_t shareOf(size_t i) const;
+
+    // [{"task":..,"us":..,"pct":..},...] for the last interval, busiest first
+    std::string json() const;
+
+    // Host only: report the calling thread under name (no-op on the device)
+    static void registerThread(const char* name);
+
+private:
+    TaskRuntime cur_[MAX_TASKS];
+    uint32_t delta_[MAX_TASKS] = {0};
+    size_t count_ = 0;
+    uint32_t interval_us_ = 0;
+    unsigned cores_ = 1;
+    uint32_t last_total_ = 0;   // wall clock of the previous snapshot
+};
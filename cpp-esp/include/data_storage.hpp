@@ -2,51 +2,65 @@
 #pragma once
 #include "ticker_fallback.hpp"
 #include "types.hpp"
+#include "frame_ring.hpp"
+#include <string>
 #include <cstdint>
 
-class SampleBuffer {
-public:
-    SampleBuffer(size_t max_samples = 512);
-    ~SampleBuffer();
-    bool append(const Sample& s);
-    int queryByTime(uint32_t start_ts, uint32_t end_ts, Sample* outBuf, size_t outBufSize);
-    void clear();
-    size_t size() const;
-    // Public accessors for buffer internals
-    const Sample* getBuffer() const { return buffer_; }
-    size_t getTail() const { return tail_; }
-    size_t getHead() const { return head_; }
-    size_t getMaxSamples() const { return max_samples_; }
-private:
-    Sample* buffer_;
-    size_t max_samples_;
-    size_t head_;
-    size_t tail_;
-    bool full_;
-    friend class DataStorage; // Allow DataStorage to access lock/unlock
-    void lock(); 
-    void unlock(); 
-};
+class SampleLog;
 
 class DataStorage {
 public:
     DataStorage(const char* filename = "/data/samples.csv");
     ~DataStorage();
 
+    // One polling cycle stored as a single frame record (one timestamp for all registers)
+    bool appendFrame(const SampleFrame& frame);
+    // A lone reading is a one-value frame. Registers >= 16 are not stored.
     bool appendSample(uint32_t timestamp, uint8_t reg_addr, float value);    
     int readLastSamples(int n, Sample* outBuf, size_t outBufSize);
     bool clearStorage();
     int querySamplesByTime(uint32_t start_ts, uint32_t end_ts, char* outBuf, size_t outBufSize);    
     void loop();
-    size_t getBufferCapacity() const { return sample_buffer_.getMaxSamples(); }
+    size_t getBufferCapacity() const { return frame_ring_.sampleCapacity(); }
     void clearSamples();
 
+    // Sequence-numbered access for the uplink cursor. Every appended sample gets the
+    // next sequence number; readers keep the sequence they have consumed up to.
+    uint32_t nextSequence() const { return frame_ring_.nextSequence(); }
+    uint32_t pendingFrom(uint32_t from_seq);
+    // Oldest-first samples with sequence >= from_seq. first_seq receives the sequence of
+    // outBuf[0]; it is ahead of from_seq when older samples were overwritten unread.
+    int readFromSequence(uint32_t from_seq, Sample* outBuf, size_t outBufSize, uint32_t& first_seq);
+
+    // Latest known value per register, fed by acquisition and by command readback
+    void updateLatest(uint32_t timestamp, uint8_t reg_addr, float value);
+    bool getLatest(uint8_t reg_addr, Sample& out) const;
+
+    static constexpr uint8_t MAX_LATEST_REGISTERS = 16;
+
+    // Persist to a raw-partition log instead of the LittleFS CSV. Flushes then append only
+    // new samples, and time queries read the mapped partition. Refills an empty RAM ring
+    // from the log's newest records.
+    void attachSampleLog(SampleLog* log);
+    bool usingSampleLog() const { return sample_log_ != nullptr; }
+    std::string storageStatsJson() const;
+
+    static constexpr size_t RING_BYTES = 6144;  // ~1300 samples at 10 registers per frame
+
 private:
     const char* filename;
-    SampleBuffer sample_buffer_;
+    FrameRing frame_ring_;
+    SampleLog* sample_log_ = nullptr;
+    uint32_t logged_seq_ = 0;   // samples before this sequence are in the log
+    Sample latest_[MAX_LATEST_REGISTERS];
+    bool latest_valid_[MAX_LATEST_REGISTERS];
     Ticker flushTicker_;
     void flushTask();
     void flushBufferToFile();
+    void flushToSampleLog();
+    void restoreSamples(const Sample* samples, size_t count);
+    static void lock();
+    static void unlock();
     static void flushTaskWrapper();
     static DataStorage* instance_;
 };
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Device shadow: the device's reported state as one versioned document.
+//
+// Firmware version, active config, FOTA progress, boot status, security counters and a
+// few health figures are set here as they change instead of each being POSTed as a full
+// document. Every change that alters a value bumps the version and marks the field
+// dirty. The uplink appends a delta of the dirty fields to the next event batch it
+// sends:
+//   {"type":"shadow","v":12,"full":true,"s":{"fota":"downloading","fch":[40,212]}}
+// ("full" only until the first ack after boot: the cloud replaces its copy instead of
+// merging). The cloud answers with "shadow_ack":<v>; fields last changed at or before v
+// are clean. A delta that is not acknowledged goes again after RESEND_MS, carrying
+// everything still dirty, so the newest delta always supersedes older ones.
+//
+// Values are stored JSON-encoded; set() with an unchanged value is free of traffic.
+// Callers quantize noisy figures (RSSI, heap) before setting them.
+
+enum class ShadowField : uint8_t {
+    FIRMWARE = 0,        // "fw": running firmware version
+    CONFIG_VERSION = 1,  // "cfg": nonce of the last applied config update
+    FOTA_STATE = 2,      // "fota": idle, downloading, verifying, ...
+    FOTA_CHUNKS = 3,     // "fch": [received, total]
+    FOTA_ERROR = 4,      // "ferr"
+    BOOT_STATUS = 5,     // "boot": success, failed, pending_reboot
+    BOOT_COUNT = 6,      // "bcnt": failed boot attempts of new firmware
+    SECURITY = 7,        // "sec": [replay attempts, MAC failures]
+    FIDELITY = 8,        // "fid": uplink fidelity
+    HEAP_MIN_KB = 9,     // "hmin": lowest free heap since boot
+    RSSI_DBM = 10,       // "rssi"
+    STALLS = 11,         // "stl": stalls recorded (stall_detector.hpp)
+    COUNT = 12
+};
+
+const char* shadowFieldKey(ShadowField f);
+
+class DeviceShadow {
+public:
+    static constexpr uint32_t RESEND_MS = 60000;
+
+    // True when the value changed (and the field became dirty)
+    bool set(ShadowField f, const std::string& value);
+    bool set(ShadowField f, int64_t value);
+    bool set(ShadowField f, int64_t a, int64_t b);
+
+    uint32_t version() const { return version_; }
+    uint32_t ackedVersion() const { return acked_; }
+    uint32_t dirtyMask() const { return dirty_; }
+
+    // A delta should go out: something is dirty and nothing is in flight (or the last
+    // send went unacknowledged for RESEND_MS)
+    bool due(uint32_t now_ms) const;
+
+    // The delta of all dirty fields, marked in flight at now_ms; empty when nothing is dirty
+    std::string delta(uint32_t now_ms);
+
+    // The batch carrying the delta failed; it may go again at once
+    void sendFailed() { inflight_ = false; }
+
+    // Cloud acknowledgement: everything up to version is clean
+    void ack(uint32_t version);
+
+    // Reads "shadow_ack":<v> from a response body
+    static bool parseAck(const std::string& body, uint32_t& version);
+
+    // Every field with a value, as the cloud should hold it: {"v":..,"s":{...}}
+    std::string document() const;
+
+    // {"version":..,"acked":..,"dirty":..,"deltas":..,"bytes":..}
+    std::string statsJson() const;
+    uint32_t deltasSent() const { return deltas_; }
+    uint64_t bytesSent() const { return bytes_; }
+
+private:
+    std::string values_[(size_t)ShadowField::COUNT];
+    uint32_t changed_[(size_t)ShadowField::COUNT] = {0};   // version of the last change
+    uint32_t version_ = 0;
+    uint32_t acked_ = 0;
+    uint32_t dirty_ = 0;
+    bool full_ = true;                  // no ack since boot
+    bool inflight_ = false;
+    uint32_t sent_version_ = 0;         // version of the delta in flight
+    uint32_t sent_ms_ = 0;
+    uint32_t deltas_ = 0;
+    uint64_t bytes_ = 0;
+};
@@ -12,6 +12,12 @@
 #include "security_layer.hpp"
 #include "secure_http_client.hpp"
 #include "fota_manager.hpp"
+#include "log_store.hpp"
+#include "sample_log.hpp"
+#include "serial_tap.hpp"
+#include "profiler.hpp"
+#include "stall_detector.hpp"
+#include "device_shadow.hpp"
 #include <LittleFS.h>
 #include <stdint.h>
 
@@ -35,9 +41,17 @@ public:
     // Callback for command received
     void onCommandReceived(const CommandRequest& command);
 
+    // Binary telemetry tap on the serial port (see serial_tap.hpp). Starting it switches
+    // the port to baud and mutes the text log; stopping restores 115200 and the log.
+    bool startSerialTap(uint32_t baud = SerialTap::DEFAULT_BAUD);
+    void stopSerialTap();
+    bool serialTapActive() const { return serial_tap_.active(); }
+
 private:
     AcquisitionScheduler* scheduler_ = nullptr;
     ProtocolAdapter* adapter_ = nullptr;
+    ModbusTcpClient* modbus_tcp_ = nullptr;   // only when the Modbus config names a TCP host
+    ModbusTcpClient* modbus_tcp_hedge_ = nullptr;   // second connection for hedged reads
     DataStorage* storage_ = nullptr;
     UplinkPacketizer* uplink_packetizer_ = nullptr;
     ConfigManager* config_ = nullptr;
@@ -48,4 +62,24 @@ private:
     SecurityLayer* security_ = nullptr;
     SecureHttpClient* secure_http_ = nullptr;
     FOTAManager* fota_ = nullptr;
+    LogStore* log_store_ = nullptr;
+    EspPartitionRegion* sample_region_ = nullptr;   // only when partitions.csv has "samplelog"
+    SampleLog* sample_log_ = nullptr;
+    SerialTap serial_tap_;
+    // Finished profiling capture being sent on the BACKGROUND lane
+    std::vector<uint8_t> profile_blob_;
+    size_t profile_offset_ = 0;
+    uint32_t profile_session_ = 0;
+    LzssEncoder* profile_lzss_ = nullptr;   // 10 KB, only while a capture is being sent
+    uint32_t stalls_logged_ = 0;
+    // Reported state, sent as deltas with the uplink's event batches
+    DeviceShadow shadow_;
+    uint32_t shadow_updated_ms_ = 0;
+    uint32_t nonce_resync_ms_ = 0;   // last resync attempt
+
+    void pumpSerialTap_();
+    void pumpProfile_();
+    void logStalls_();
+    void updateShadow_();
+    void retryNonceResync_();
 };
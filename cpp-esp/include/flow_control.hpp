@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Fleet-aware scheduling and server-directed flow control.
+//
+// Devices that power up together would otherwise fire their upload and config-poll
+// tickers in lock step. Each device derives a stable phase offset from its ID, and
+// the server can push back with Retry-After (defer the next request) or
+// X-Next-Interval (change the request period).
+
+// 32-bit FNV-1a
+uint32_t fnv1a32(const char* data, size_t len);
+
+// Stable per-device offset in [0, interval_ms)
+uint32_t fleetPhaseOffsetMs(const std::string& device_id, uint32_t interval_ms);
+
+// Retry-After in delta-seconds ("120"), capped at RETRY_AFTER_MAX_S. The HTTP-date form
+// needs wall-clock time the device does not have, so it is rejected.
+constexpr uint32_t RETRY_AFTER_MAX_S = 86400;
+bool parseRetryAfterMs(const std::string& value, uint32_t& out_ms);
+
+// X-Next-Interval in seconds, integer or decimal ("30", "7.5")
+bool parseNextIntervalMs(const std::string& value, uint32_t& out_ms);
+
+class FlowControl {
+public:
+    FlowControl(uint32_t min_interval_ms = 5000, uint32_t max_interval_ms = 3600000);
+
+    // Spreads devices that receive the same Retry-After; use the device ID hash
+    void setJitterSeed(uint32_t seed) { jitter_seed_ = seed; }
+
+    // Apply the hints from one server response. Returns true if the interval changed.
+    bool applyHints(const std::string& retry_after, const std::string& next_interval, uint32_t now_ms);
+
+    // False while a Retry-After deferral is in force
+    bool canSend(uint32_t now_ms) const;
+    uint32_t deferRemainingMs(uint32_t now_ms) const;
+
+    bool hasIntervalOverride() const { return interval_ms_ != 0; }
+    uint32_t intervalMs() const { return interval_ms_; }
+
+    uint32_t deferrals() const { return deferrals_; }
+
+private:
+    uint32_t min_interval_ms_;
+    uint32_t max_interval_ms_;
+    uint32_t jitter_seed_ = 0;
+    uint32_t interval_ms_ = 0;     // 0: no server override
+    uint32_t defer_until_ms_ = 0;
+    bool deferred_ = false;
+    uint32_t deferrals_ = 0;
+};
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// When the uplink flushes.
+//
+// Instead of uploading on a fixed period, the packetizer checks these triggers every
+// second and flushes as soon as one fires:
+//   SIZE    pending telemetry (estimated encoded bytes) plus queued events reach
+//           target_bytes, or the sample ring is half full
+//   AGE     the oldest unsent sample is max_age_ms old
+//   URGENT  an URGENT lane item is waiting; bulk telemetry rides along
+// At low data rates a flush waits for the age bound and carries everything pending in
+// one request; at high rates the size target keeps requests full and latency short.
+// A failed flush backs off (doubling from min_gap_ms up to max_age_ms) before SIZE or
+// AGE may fire again.
+//
+// Devices that boot together take their first samples together, so the age bound
+// alone would have a whole fleet flush in the same second. Until its first flush a
+// device uses its fleet phase offset (flow_control.hpp) as the age bound instead; the
+// flushes after that keep the stagger.
+
+enum class FlushReason : uint8_t {
+    NONE = 0,
+    SIZE = 1,
+    AGE = 2,
+    URGENT = 3
+};
+
+const char* flushReasonToString(FlushReason reason);
+
+struct FlushTargets {
+    uint32_t target_bytes = 4096;   // flush once this much is pending
+    uint32_t max_age_ms = 60000;    // latency bound for the oldest unsent sample
+    uint32_t min_gap_ms = 2000;     // SIZE flushes no closer together than this
+};
+
+struct FlushInputs {
+    uint32_t pending_samples = 0;
+    uint32_t sample_capacity = 0;   // ring size in samples; 0 = unknown
+    uint32_t oldest_age_ms = 0;     // 0 when nothing is pending
+    uint32_t queued_bytes = 0;      // EVENT / BACKGROUND lane bytes
+    bool urgent = false;
+};
+
+class FlushTrigger {
+public:
+    static constexpr uint32_t MIN_TARGET_BYTES = 256;
+    static constexpr uint32_t MAX_TARGET_BYTES = 16384;
+    static constexpr uint32_t MIN_MAX_AGE_MS = 1000;
+    static constexpr uint32_t MAX_MAX_AGE_MS = 3600000;
+
+    explicit FlushTrigger(const FlushTargets& targets = FlushTargets());
+
+    // Out-of-range values are clamped to the limits above
+    void setTargets(const FlushTargets& targets);
+    const FlushTargets& targets() const { return t_; }
+
+    // Age bound before the first flush, in (0, max_age_ms]; 0 = max_age_ms
+    void setPhase(uint32_t phase_ms) { phase_ms_ = phase_ms; }
+
+    FlushReason evaluate(const FlushInputs& in, uint32_t now_ms) const;
+
+    // Report a flush and its outcome; delivered samples/bytes refine the size estimate
+    void onFlush(FlushReason reason, bool success, uint32_t now_ms);
+    void observeEncoded(uint32_t samples, uint32_t bytes);
+
+    // Encoded bytes expected for this many samples at the recent rate
+    uint32_t estimateBytes(uint32_t samples) const;
+    uint32_t backoffMs() const { return backoff_ms_; }
+    uint32_t flushes(FlushReason reason) const { return counts_[(size_t)reason]; }
+
+    // {"target_bytes":..,"max_age_ms":..,"size":..,"age":..,"urgent":..,"failed":..,"backoff_ms":..}
+    std::string statsJson() const;
+
+private:
+    FlushTargets t_;
+    uint32_t milli_bytes_per_sample_ = 5000;   // FRAME batches at ~10 registers: ~4.6
+    bool flushed_ = false;
+    uint32_t last_flush_ms_ = 0;
+    uint32_t phase_ms_ = 0;
+    uint32_t backoff_ms_ = 0;                  // after failures; 0 when healthy
+    uint32_t counts_[4] = {0, 0, 0, 0};
+    uint32_t failed_ = 0;
+};
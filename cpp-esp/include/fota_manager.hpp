@@ -4,12 +4,12 @@
 #include <Update.h>
 #include <FS.h>
 #include <LittleFS.h>
-#include <Crypto.h>
-#include <SHA256.h>
 #include <string>
 #include <functional>
 #include "http_client.hpp"
 #include "security_layer.hpp"
+#include "sha256_engine.hpp"
+#include "device_shadow.hpp"
 
 /**
  * @brief FOTA (Firmware Over-The-Air) Manager
@@ -52,6 +52,8 @@ enum class FOTAState {
     FAILED
 };
 
+const char* fotaStateToString(FOTAState state);
+
 // FOTA manifest structure
 struct FOTAManifest {
     std::string version;
@@ -141,6 +143,13 @@ public:
      */
     bool rollback(const std::string& reason);
 
+    /**
+     * @brief Report state through the device shadow instead of POSTing it
+     * With a shadow, reportProgress and reportBootStatus only update it; progress is
+     * still POSTed directly right before a restart, when no uplink would carry it.
+     */
+    void setShadow(DeviceShadow* shadow) { shadow_ = shadow; }
+
     /**
      * @brief Report progress to cloud
      * @param force Force report even if not at reporting interval
@@ -199,6 +208,8 @@ private:
     // Cloud API base URL
     std::string cloud_base_url_;
     
+    DeviceShadow* shadow_ = nullptr;
+    
     // FOTA manifest
     FOTAManifest manifest_;
     
@@ -208,11 +219,14 @@ private:
     // Downloaded chunks tracking
     std::vector<bool> chunks_downloaded_;
     
-    // SHA-256 for integrity
-    SHA256 sha256_;
-    
-    // Firmware buffer for hash calculation
-    static constexpr size_t HASH_BUFFER_SIZE = 4096;
+    // Running SHA-256 of the image, fed as chunks are written; checked against
+    // manifest_.hash before the boot partition is switched
+    Sha256 image_hash_;
+    uint32_t image_hashed_bytes_ = 0;
+
+    // Decoded chunk, held for the whole download instead of allocated per chunk
+    std::vector<uint8_t> chunk_buf_;
+    static constexpr size_t MAX_CHUNK_BYTES = 20480;
     
     // State persistence file
     static constexpr const char* STATE_FILE = "/fota_state.json";
@@ -234,7 +248,8 @@ private:
     bool saveFirmwareChunk(uint32_t chunk_number, const uint8_t* data, size_t size);
     // REMOVED: loadFirmwareForVerification() and clearFirmwareFile() - no longer needed
     void setState(FOTAState state, const std::string& error = "");
-    bool verifyChunkHMAC(const uint8_t* data, size_t size, const std::string& mac);
+    void updateShadow();
+    bool verifyChunkHMAC(const uint8_t* data, size_t size, const char* mac_hex);
     int getBootCount();
     void incrementBootCount();
     void clearBootCount();
@@ -0,0 +1,78 @@
+#pragma once
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// One polling cycle: a single timestamp, which registers were read, and their values.
+// values[] is indexed by register address; only the slots set in present are valid.
+struct SampleFrame {
+    static constexpr uint8_t MAX_REGISTERS = 16;
+
+    uint32_t timestamp = 0;
+    uint16_t present = 0;
+    float values[MAX_REGISTERS] = {};
+
+    void set(uint8_t reg, float value) {
+        if (reg >= MAX_REGISTERS) return;
+        values[reg] = value;
+        present |= (uint16_t)(1u << reg);
+    }
+    size_t count() const;
+};
+
+// Byte ring of packed frame records:
+//   [ts u32][present u16][value f32 per set bit, in register order]
+// i.e. 6 bytes of overhead per cycle instead of 8 per value with one Sample per
+// reading. Full rings drop their oldest frames. Samples keep the sequence numbers
+// DataStorage hands the uplink: every stored value takes the next one.
+class FrameRing {
+public:
+    static constexpr size_t RECORD_HEADER = 6;
+
+    explicit FrameRing(size_t bytes);
+    ~FrameRing();
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    // False for an empty frame
+    bool append(const SampleFrame& frame);
+    // Groups runs of samples sharing a timestamp (registers ascending) into frames, the
+    // same grouping the FRAME uplink codec uses. Registers >= 16 are skipped.
+    size_t appendSamples(const Sample* samples, size_t count);
+    void clear();
+
+    size_t frames() const { return frames_; }
+    size_t samples() const { return next_seq_ - first_seq_; }
+    size_t bytesUsed() const { return used_; }
+    size_t capacityBytes() const { return cap_; }
+    // Samples the ring holds when every frame looks like the newest one
+    size_t sampleCapacity() const;
+
+    uint32_t firstSequence() const { return first_seq_; }
+    uint32_t nextSequence() const { return next_seq_; }
+    // Restart numbering (empty ring only), e.g. to continue a previous boot's sequence
+    void setNextSequence(uint32_t seq);
+
+    // Oldest-first samples with sequence >= from_seq (clamped to what is stored);
+    // first_seq receives the sequence of out[0]
+    size_t readFromSequence(uint32_t from_seq, Sample* out, size_t max, uint32_t& first_seq) const;
+    // The n newest samples, oldest first
+    size_t readLast(size_t n, Sample* out, size_t max) const;
+
+private:
+    uint8_t* buf_;
+    size_t cap_;
+    size_t tail_ = 0;        // oldest record
+    size_t head_ = 0;        // next write
+    size_t end_ = 0;         // end of the records before the wrap (wrapped_ only)
+    bool wrapped_ = false;   // records run [tail_, end_) then [0, head_)
+    size_t frames_ = 0;
+    size_t used_ = 0;
+    uint8_t last_count_ = 0; // values in the newest frame
+    uint32_t first_seq_ = 0;
+    uint32_t next_seq_ = 0;
+
+    void dropOldest();
+    size_t nextRecord(size_t pos) const;
+    size_t expand(size_t pos, uint32_t seq, uint32_t from_seq, Sample* out, size_t max) const;
+};
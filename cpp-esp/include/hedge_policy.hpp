@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// When to hedge an inverter read, and how often it may happen.
+//
+// A hedged read sends a duplicate of an idempotent request on a second connection
+// when the first has not answered by the endpoint's p95 latency, and uses whichever
+// reply comes first. The p95 is taken over the last WINDOW reads (the latency the
+// caller saw, from the first send). Hedging starts once min_samples reads have been
+// seen and never fires earlier than min_delay_us.
+//
+// Every read earns budget_pct/100 of a hedge, up to burst saved hedges, and every
+// hedge spends one, so duplicates stay at about budget_pct percent of the reads even
+// when the whole link gets slow (when hedging would only add load).
+
+struct HedgeConfig {
+    uint8_t budget_pct = 5;
+    uint8_t burst = 10;
+    uint32_t min_delay_us = 2000;
+    uint16_t min_samples = 20;
+};
+
+class HedgePolicy {
+public:
+    static constexpr size_t WINDOW = 64;
+
+    explicit HedgePolicy(const HedgeConfig& config = HedgeConfig()) : config_(config) {}
+
+    // Delay after which the read should be hedged; 0 = do not hedge this one
+    uint32_t delayUs() const;
+
+    // A read is starting: earns its share of the budget
+    void onRead();
+
+    // Spends one hedge; false (and counted as denied) when the budget is empty
+    bool takeHedge();
+
+    // The read finished after latency_us (either reply); hedge_won when the duplicate
+    // answered first
+    void onComplete(uint32_t latency_us, bool hedge_won);
+
+    // pct-th percentile of the window (0 while it is empty)
+    uint32_t percentileUs(uint8_t pct) const;
+
+    uint32_t reads() const { return reads_; }
+    uint32_t hedges() const { return hedges_; }
+    uint32_t hedgeWins() const { return hedge_wins_; }
+    uint32_t denied() const { return denied_; }
+
+    // {"reads":..,"hedges":..,"wins":..,"denied":..,"p50_us":..,"p95_us":..,"p99_us":..}
+    std::string json() const;
+
+private:
+    HedgeConfig config_;
+    uint32_t window_[WINDOW] = {0};
+    size_t head_ = 0;
+    size_t filled_ = 0;
+    uint32_t credits_ = 0;   // hundredths of a hedge
+    uint32_t reads_ = 0;
+    uint32_t hedges_ = 0;
+    uint32_t hedge_wins_ = 0;
+    uint32_t denied_ = 0;
+};
@@ -1,6 +1,10 @@
 #pragma once
 #include <stdint.h>
 #include <string>
+#include "io_buf.hpp"
+#include "rtt_estimator.hpp"
+
+class Stream;
 
 struct EcoHttpResponse {
     int status_code = 0;
@@ -9,6 +13,9 @@ struct EcoHttpResponse {
     std::string header_keys[10];
     std::string header_values[10];
     int header_count = 0;
+    // Server flow-control hints (empty when absent)
+    std::string retry_after;
+    std::string next_interval;
     bool isSuccess() const { return status_code >= 200 && status_code < 300; }
 };
 
@@ -20,14 +27,28 @@ public:
     EcoHttpResponse post(const char* endpoint, const char* data, size_t len,
                      const char* content_type = nullptr,
                      const char* header_keys[] = nullptr, const char* header_values[] = nullptr, int header_count = 0);
+    // Body sent straight from the chain: a single slice goes out as is, several are
+    // streamed slice by slice (counted as copied in the chain's pool)
+    EcoHttpResponse post(const char* endpoint, const IoChain& body, const char* content_type = nullptr);
     EcoHttpResponse get(const char* endpoint,
                     const char* header_keys[] = nullptr, const char* header_values[] = nullptr, int header_count = 0);
 
     void setDefaultHeaders(const char* keys[], const char* values[], int count);
 
+    // Per-endpoint round-trip estimators that set each request's timeout (rtt_estimator.hpp);
+    // the constructor's timeout_ms applies until an endpoint has answered once
+    const EndpointRtt& rtt() const { return rtt_; }
+    std::string rttJson() const { return rtt_.json(); }
+
 private:
+    EcoHttpResponse postImpl(const char* endpoint, const char* data, size_t len, Stream* stream,
+                             const char* content_type,
+                             const char* header_keys[], const char* header_values[], int header_count);
+    void recordRtt_(const char* endpoint, int http_code, uint32_t elapsed_ms, uint32_t timeout_ms);
+
     std::string base_url_;
     uint32_t timeout_ms_;
+    EndpointRtt rtt_;
     std::string default_header_keys[10];
     std::string default_header_values[10];
     int default_header_count = 0;
@@ -0,0 +1,140 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Refcounted buffer chain for the uplink path (compress -> secure -> transport).
+//
+// Blocks come from a fixed pool and are shared between slices, so stages hand data on
+// by reference: cutting a chunk out of an encoded payload, writing an envelope header
+// into headroom reserved in front of the data, or appending a MAC into the tailroom
+// behind it copies nothing. The transport walks the slices (scatter/gather) instead of
+// flattening them. Every byte a stage does write into the pool is counted, so the
+// uplink can report bytes copied per byte sent.
+
+class IoBufPool;
+
+struct IoBufBlock {
+    uint8_t* data;
+    uint32_t size;
+    uint32_t low;        // first written byte; only a slice starting here may grow in front
+    uint32_t high;       // end of written bytes; only a slice ending here may grow behind
+    uint32_t refs;
+    bool pooled;         // false: overflow block from the heap, freed on release
+    IoBufPool* pool;
+    IoBufBlock* next_free;
+};
+
+struct IoBufStats {
+    uint32_t allocations = 0;
+    uint32_t overflow = 0;       // pool was empty; block came from the heap
+    uint32_t in_use = 0;
+    uint32_t peak_in_use = 0;
+    uint64_t bytes_copied = 0;   // written into blocks by any stage
+    uint64_t bytes_sent = 0;     // handed to the transport
+};
+
+// One slice [data, data + length) of a block. Copies share the block.
+class IoBuf {
+public:
+    IoBuf() {}
+    IoBuf(const IoBuf& other);
+    IoBuf(IoBuf&& other) noexcept;
+    IoBuf& operator=(const IoBuf& other);
+    IoBuf& operator=(IoBuf&& other) noexcept;
+    ~IoBuf();
+
+    // Refers to memory the caller owns (an encoded payload); never written to, and
+    // it must outlive every chain the slice is added to
+    static IoBuf wrap(const uint8_t* data, size_t len);
+
+    const uint8_t* data() const { return data_; }
+    size_t length() const { return len_; }
+    bool empty() const { return len_ == 0; }
+
+    // Room this slice may grow into (0 for wrapped memory or when another slice
+    // already wrote there)
+    size_t headroom() const;
+    size_t tailroom() const;
+
+    // Grow by n bytes in front / behind and return where to write them; nullptr if
+    // there is no room
+    uint8_t* prepend(size_t n);
+    uint8_t* append(size_t n);
+
+    IoBuf slice(size_t offset, size_t len) const;
+
+private:
+    friend class IoBufPool;
+    IoBuf(IoBufBlock* block, uint8_t* data, size_t len);
+    void release();
+
+    IoBufBlock* block_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t len_ = 0;
+};
+
+class IoBufPool {
+public:
+    IoBufPool(size_t block_size = 2048, size_t block_count = 4);
+    ~IoBufPool();
+    IoBufPool(const IoBufPool&) = delete;
+    IoBufPool& operator=(const IoBufPool&) = delete;
+
+    // Empty slice at the start of a fresh block, with headroom bytes kept free in front
+    IoBuf allocate(size_t headroom = 0);
+
+    size_t blockSize() const { return block_size_; }
+    void countCopy(size_t n) { stats_.bytes_copied += n; }
+    void countSent(size_t n) { stats_.bytes_sent += n; }
+    const IoBufStats& stats() const { return stats_; }
+
+private:
+    friend class IoBuf;
+    void release(IoBufBlock* block);
+
+    size_t block_size_;
+    std::vector<uint8_t> storage_;
+    std::vector<IoBufBlock> blocks_;
+    IoBufBlock* free_ = nullptr;
+    IoBufStats stats_;
+};
+
+// Ordered slices forming one message
+class IoChain {
+public:
+    explicit IoChain(IoBufPool* pool = nullptr) : pool_(pool) {}
+
+    void append(const IoBuf& buf);
+    void append(const IoChain& other);
+
+    // Copy bytes in: into the last slice's tailroom first, then fresh blocks
+    bool appendCopy(const void* src, size_t len);
+    // Copy bytes in front: into the first slice's headroom if it fits, else a new slice
+    bool prependCopy(const void* src, size_t len);
+
+    // Writable space at the end (opens a block when the tail is full); commit() what
+    // was written. Returns nullptr only when the chain has no pool.
+    uint8_t* tailSpace(size_t& avail, size_t headroom = 0);
+    void commit(size_t n);
+
+    // Shares the underlying blocks
+    IoChain slice(size_t offset, size_t len) const;
+
+    size_t length() const { return len_; }
+    size_t count() const { return bufs_.size(); }
+    const IoBuf& operator[](size_t i) const { return bufs_[i]; }
+    IoBufPool* pool() const { return pool_; }
+
+    // Gather len bytes from offset into dst (for transports that need contiguous
+    // pieces); returns bytes written
+    size_t copyOut(size_t offset, void* dst, size_t len) const;
+    std::string toString() const;
+    void clear();
+
+private:
+    IoBufPool* pool_;
+    std::vector<IoBuf> bufs_;
+    size_t len_ = 0;
+};
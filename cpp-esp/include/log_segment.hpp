@@ -0,0 +1,164 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Compressed, crash-persistent log segments.
+//
+// Log lines are staged in RAM as records and committed to flash a block at a time, so
+// a line costs a memcpy, not a flash write. On the device the staging area lives in
+// RTC memory, which survives a panic or watchdog reset; lines staged before a crash are
+// committed on the next boot.
+//
+// Record (staging and decompressed block body):
+//   [ms u32][level u8][len u8][text: len bytes]
+//
+// Block (little-endian, 32-byte header):
+//   'L' 'G' | version u8 | flags u8 | boot u32 | seq u32 | first_ms u32 | last_ms u32
+//   raw_len u16 | data_len u16 | lines u16 | reserved u16 | crc32 u32 (over data)
+//   data: LZSS stream when flags & LOG_BLOCK_COMPRESSED, raw records otherwise
+//
+// LZSS stream: a flag byte precedes every 8 tokens (bit i set = token i is a match).
+// Literal = 1 byte. Match = 2 bytes: offset low 8 bits, then offset high 4 bits << 4 |
+// (length - 3); offset 1..4095 back into the output, length 3..18.
+
+constexpr uint8_t LOG_BLOCK_VERSION = 1;
+constexpr uint8_t LOG_BLOCK_COMPRESSED = 0x01;
+constexpr size_t LOG_BLOCK_HEADER_SIZE = 32;
+constexpr size_t LOG_RECORD_OVERHEAD = 6;
+constexpr size_t LOG_STAGING_BYTES = 2048;
+constexpr size_t LOG_MAX_LINE = 255;
+
+uint32_t logCrc32(const uint8_t* data, size_t len);
+
+// LZSS with a hash-chain match finder. Holds its tables so the device allocates them once.
+class LzssEncoder {
+public:
+    static constexpr size_t MAX_INPUT = 4096;
+
+    // Returns the compressed length, or 0 if the input is too long or the output
+    // would not fit in out_cap
+    size_t compress(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap);
+
+private:
+    static constexpr size_t HASH_SIZE = 1024;
+    static constexpr int MAX_CHAIN = 32;
+    uint16_t head_[HASH_SIZE];
+    uint16_t prev_[MAX_INPUT];
+};
+
+// Decompresses exactly out_len bytes; false on a malformed stream
+bool lzssDecompress(const uint8_t* in, size_t len, uint8_t* out, size_t out_len);
+
+// Staging area layout. Plain data so it can be placed in RTC_NOINIT memory.
+struct LogStagingArea {
+    uint32_t magic;
+    uint32_t boot;
+    uint16_t used;
+    uint16_t lines;
+    uint32_t first_ms;
+    uint32_t last_ms;
+    uint8_t max_level;
+    uint8_t reserved[3];
+    uint8_t data[LOG_STAGING_BYTES];
+};
+
+// Lines offered to a LogStaging since it was constructed
+struct LogStagingCounters {
+    uint32_t lines = 0;
+    uint32_t dropped = 0;       // no room left
+    uint64_t text_bytes = 0;
+};
+
+// Staged records, shared between every task that logs and the one that commits.
+// append, snapshot and consume take a short lock (a critical section on the device)
+// that never covers a flash write: the committer copies the area out with snapshot(),
+// writes the copy, then consume()s exactly what it wrote while later lines stay staged.
+class LogStaging {
+public:
+    explicit LogStaging(LogStagingArea* area) : area_(area) {}
+
+    // True if the area holds lines from an earlier boot (survived a reset); boot is set
+    bool recover(uint32_t& boot) const;
+
+    // Empty the area and tag it with the current boot
+    void reset(uint32_t boot);
+
+    // Stage one line (truncated to LOG_MAX_LINE). False, and the line counted as dropped,
+    // when there is no room; the committer makes room, never the caller.
+    bool append(uint32_t ms, uint8_t level, const char* text, size_t len);
+
+    // Copy of the staged lines; false when there are none
+    bool snapshot(LogStagingArea& out) const;
+
+    // Drop the lines a snapshot() returned, keeping the ones staged after it
+    void consume(const LogStagingArea& snap);
+
+    // Commit when nearly full, when the oldest line is older than max_age_ms, or as soon
+    // as a line at or above severe_level is staged
+    bool due(uint32_t now_ms, uint32_t max_age_ms, uint8_t severe_level) const;
+
+    bool empty() const { return area_->used == 0; }
+    size_t used() const { return area_->used; }
+    const LogStagingArea& area() const { return *area_; }
+    LogStagingCounters counters() const;
+
+private:
+    static constexpr uint32_t MAGIC = 0x4C4F4753;   // "LOGS"
+    LogStagingArea* area_;
+    LogStagingCounters counters_;
+};
+
+struct LogBlockHeader {
+    uint8_t version = LOG_BLOCK_VERSION;
+    uint8_t flags = 0;
+    uint32_t boot = 0;
+    uint32_t seq = 0;
+    uint32_t first_ms = 0;
+    uint32_t last_ms = 0;
+    uint16_t raw_len = 0;
+    uint16_t data_len = 0;
+    uint16_t lines = 0;
+    uint32_t crc = 0;
+
+    size_t blockSize() const { return LOG_BLOCK_HEADER_SIZE + data_len; }
+    bool overlaps(uint32_t from_ms, uint32_t to_ms) const { return first_ms <= to_ms && last_ms >= from_ms; }
+};
+
+// Appends one block holding the staged records to out (stored raw if LZSS does not help)
+bool encodeLogBlock(const LogStagingArea& area, uint32_t seq, LzssEncoder& encoder, std::vector<uint8_t>& out);
+
+// Header only; checks magic, version and that data_len fits in len
+bool parseLogBlockHeader(const uint8_t* data, size_t len, LogBlockHeader& out);
+
+// Full decode: header, CRC and decompression into raw records
+bool decodeLogBlock(const uint8_t* data, size_t len, LogBlockHeader& header, std::vector<uint8_t>& raw);
+
+struct LogRecord {
+    uint32_t ms;
+    uint8_t level;
+    std::string text;
+};
+
+bool parseLogRecords(const uint8_t* raw, size_t len, std::vector<LogRecord>& out);
+
+// Write accounting. Flash cost is the page-programmed estimate: every append rounds
+// up to whole 256-byte pages plus one page of filesystem metadata.
+struct LogStoreStats {
+    uint32_t lines = 0;
+    uint32_t dropped_lines = 0;       // staging full, or the commit failed
+    uint32_t recovered_lines = 0;     // staged before a reset, committed on this boot
+    uint64_t text_bytes = 0;          // what the application logged
+    uint64_t block_bytes = 0;         // blocks written (header + compressed data)
+    uint64_t flash_bytes = 0;         // page-rounded estimate of flash programmed
+    uint32_t blocks = 0;
+    uint32_t segments_erased = 0;
+
+    float compressionRatio() const { return text_bytes ? (float)block_bytes / (float)text_bytes : 0.0f; }
+    float writeAmplification() const { return text_bytes ? (float)flash_bytes / (float)text_bytes : 0.0f; }
+    float flashBytesPerLine() const { return lines ? (float)flash_bytes / (float)lines : 0.0f; }
+
+    void recordAppend(size_t bytes, size_t page_size = 256);
+    std::string toJson() const;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include "log_segment.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+
+class UplinkPacketizer;
+
+// Persistent device log.
+//
+// Logger hands every line to append(), from whichever task logged it; append() only
+// copies it into the RTC staging area and never touches the filesystem. loop() commits
+// the staging area as one compressed block when it is due; blocks are
+// packed into sector-sized segment files (/logs/seg<N>.bin) used as a ring, so flash
+// use is fixed and the oldest segment is the one rewritten.
+//
+// fetch_logs commands stream the matching blocks to the cloud on the BACKGROUND lane,
+// one block per loop and only while that lane is nearly empty.
+class LogStore {
+public:
+    static constexpr size_t SEGMENT_SIZE = 4096;      // one flash sector
+    static constexpr uint8_t SEGMENT_COUNT = 8;       // 32 KB of flash in total
+    static constexpr uint32_t MAX_STAGE_AGE_MS = 60000;
+    static constexpr uint8_t SEVERE_LEVEL = 3;        // Logger::ERROR commits at once
+
+    LogStore();
+
+    // Call once LittleFS is mounted. Scans the ring and commits lines that were staged
+    // before the last reset.
+    bool begin();
+
+    // Stage one line; no flash access, a line that does not fit is dropped and counted
+    void append(uint8_t level, uint32_t ms, const char* text, size_t len);
+
+    void loop();
+
+    // Write the staged lines now. Safe from any task; false if another commit is running.
+    bool commit();
+
+    void setUplink(UplinkPacketizer* uplink) { uplink_ = uplink; }
+
+    // Queue blocks overlapping [from_s, to_s] (uptime seconds, to_s 0 = open ended) of the
+    // boot boots_ago before this one. Returns the number of blocks that will be sent.
+    uint32_t startExport(uint32_t command_id, uint32_t boots_ago, uint32_t from_s, uint32_t to_s);
+    bool exporting() const { return export_.active; }
+
+    uint32_t bootId() const { return boot_; }
+    LogStoreStats stats() const;
+
+private:
+    struct Export {
+        bool active = false;
+        uint32_t command_id = 0;
+        uint32_t boot = 0;
+        uint32_t from_ms = 0;
+        uint32_t to_ms = 0;
+        uint8_t first_slot = 0;  // oldest segment when the export started
+        uint8_t step = 0;        // segments visited, oldest first
+        size_t offset = 0;       // within the current segment
+        uint32_t sent = 0;
+    };
+
+    LogStaging staging_;
+    LzssEncoder* encoder_ = nullptr;   // 10 KB of match tables, allocated in begin()
+    UplinkPacketizer* uplink_ = nullptr;
+    LogStoreStats stats_;              // flash side; line counts come from staging_
+    LogStagingArea snapshot_;          // what commit() is writing
+    uint32_t commit_dropped_ = 0;
+    Export export_;
+    std::vector<uint8_t> block_;
+    bool ready_ = false;
+    std::atomic<bool> busy_{false};
+    uint32_t boot_ = 1;
+    uint32_t seq_ = 0;
+    uint8_t slot_ = 0;
+    size_t slot_used_ = 0;
+
+    static std::string segmentPath(uint8_t slot);
+    bool writeBlock(const LogStagingArea& area);
+    bool readSegment(uint8_t slot, std::vector<uint8_t>& out) const;
+    bool matchesExport(const LogBlockHeader& h) const;
+    void exportStep();
+};
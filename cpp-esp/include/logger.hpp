@@ -6,6 +6,8 @@
 #include <Arduino.h>
 #include "config_manager.hpp"
 
+class LogStore;
+
 class Logger {
 public:
     enum Level { DEBUG, INFO, WARN, ERROR };
@@ -17,9 +19,16 @@ public:
     static void error(const char* fmt, ...);
     static void flush();
     static void shutdown();
+    // Persist lines through a LogStore (staged in RAM, committed in compressed blocks)
+    static void attachStore(LogStore* store);
+    // Stop printing to the serial console (lines still reach the store), e.g. while the
+    // port carries the binary telemetry tap
+    static void setConsole(bool enabled);
 private:
     static Level min_level_;
     static std::string log_file_;
     static bool flush_on_write_;
+    static bool console_;
+    static LogStore* store_;
     static void write_log(Level level, const char* fmt, va_list args);
 };
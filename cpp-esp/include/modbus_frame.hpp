@@ -1,8 +1,68 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 // CRC utility for Modbus (returns 16-bit CRC as specified by Modbus RTU)
 // data: pointer to bytes
 // length: number of bytes to include in CRC calculation
 uint16_t modbus_crc16(const uint8_t *data, uint16_t length);
+
+// Read/Write Multiple Registers (0x17) request PDU, function code first. pdu needs room
+// for 10 + 2 * write_count bytes. Returns the PDU length, 0 when a count is out of range.
+size_t modbus_read_write_pdu(uint8_t *pdu, uint16_t read_start, uint16_t read_count,
+                             uint16_t write_start, uint16_t write_count, const uint16_t *write_values);
+
+// Register values from a 0x03 / 0x04 / 0x17 reply PDU (function code first); false when
+// the byte count does not match count or the PDU is short
+bool modbus_read_values(const uint8_t *pdu, size_t len, uint16_t count, uint16_t *values);
+
+// Registers a confirmed command write reads back in its 0x17 transaction: one contiguous
+// block covering the written register plus status (export power %) and output power, so
+// the latest-value table gets all three from the round trip. A register too far from
+// them for one read gets only itself read back.
+struct ModbusReadback {
+    static constexpr uint16_t STATUS_REG = 8;
+    static constexpr uint16_t POWER_REG = 9;
+    static constexpr uint16_t MAX_COUNT = 125;
+
+    uint16_t start = 0;
+    uint16_t count = 0;
+
+    static ModbusReadback around(uint16_t written);
+    bool covers(uint16_t reg) const { return reg >= start && reg - start < count; }
+
+    static float scaled(uint16_t raw, float gain) { return gain > 0 ? raw / gain : (float)raw; }
+
+    // Hands each value of the block to publish(reg, value), scaled by gain(reg) (0 = raw)
+    template <typename Gain, typename Publish>
+    void publish(const uint16_t *values, Gain gain, Publish publish) const {
+        for (uint16_t i = 0; i < count; ++i) {
+            uint16_t reg = (uint16_t)(start + i);
+            publish(reg, scaled(values[i], gain(reg)));
+        }
+    }
+};
+
+// Whether 0x17 is worth trying. Only an answer that says the function does not exist
+// turns it off: exception 0x01 from the inverter, or the SIM refusing the frame as a bad
+// or unknown request (400, 404, 405, 501). Timeouts, 401, 429 and 5xx say nothing about
+// support. Firmware updates and gateway swaps can add 0x17, so it is tried again after
+// REPROBE_MS.
+class ModbusReadWriteSupport {
+public:
+    static constexpr uint32_t REPROBE_MS = 10 * 60 * 1000;
+
+    bool usable(uint32_t now_ms) const { return !disabled_ || now_ms - disabled_at_ms_ >= REPROBE_MS; }
+    bool disabled() const { return disabled_; }
+
+    void onSuccess() { disabled_ = false; }
+    // Returns true when this failure turned 0x17 off
+    bool onFailure(uint8_t exception_code, int http_status, uint32_t now_ms);
+
+    static bool meansUnsupported(uint8_t exception_code, int http_status);
+
+private:
+    bool disabled_ = false;
+    uint32_t disabled_at_ms_ = 0;
+};
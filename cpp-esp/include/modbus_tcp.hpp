@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "hedge_policy.hpp"
+
+// Modbus TCP client with several transactions in flight.
+//
+// Frames carry the 7-byte MBAP header instead of the RTU address and CRC:
+//   transaction id u16 | protocol id u16 (0) | length u16 | unit id u8 | PDU
+// (all big-endian; length counts the unit id and the PDU). Requests are written
+// back to back on one persistent socket, up to max_in_flight before the first reply
+// is back, and replies are matched to requests by transaction id, so a unit or
+// gateway that answers out of order is handled, and a reply that arrives after its
+// request timed out is discarded instead of being taken for the next one.
+
+// One register read in a batch (0x03 holding / 0x04 input)
+struct ModbusRead {
+    uint8_t function = 0x03;
+    uint16_t start = 0;
+    uint16_t count = 1;
+    uint16_t* values = nullptr;   // count entries, filled when ok
+    bool ok = false;
+    uint8_t exception = 0;        // Modbus exception code from the unit, 0 if none
+};
+
+// One single-register read per entry of a register list. Kept from poll to poll: the
+// storage only grows when the list does, so a steady-state cycle allocates nothing.
+class ModbusRegisterBatch {
+public:
+    void assign(const uint8_t* regs, size_t count);
+    void clear() { count_ = 0; }
+
+    ModbusRead* reads() { return reads_.data(); }
+    size_t size() const { return count_; }
+    // Value read for entry i; false when that read failed or there is no entry i
+    bool value(size_t i, uint16_t& out) const;
+
+private:
+    std::vector<ModbusRead> reads_;
+    std::vector<uint16_t> values_;
+    size_t count_ = 0;
+};
+
+struct ModbusTcpStats {
+    uint32_t requests = 0;
+    uint32_t responses = 0;
+    uint32_t timeouts = 0;
+    uint32_t stray = 0;           // replies with no matching request (late or unknown id)
+    uint32_t connects = 0;
+    uint32_t disconnects = 0;     // socket errors, EOF or a framing error
+    uint32_t max_in_flight_seen = 0;
+};
+
+
+class ModbusTcpClient {
+public:
+    static constexpr size_t MBAP_SIZE = 7;
+    static constexpr size_t MAX_PDU = 253;
+    static constexpr uint16_t MAX_READ_REGISTERS = 125;
+
+    ModbusTcpClient(const std::string& host, uint16_t port, uint8_t unit_id,
+                    uint32_t timeout_ms = 1000, uint8_t max_in_flight = 4);
+    ~ModbusTcpClient();
+
+    bool connect();
+    void close();
+    bool connected() const { return fd_ >= 0; }
+
+    // 1 = strictly one request at a time
+    void setMaxInFlight(uint8_t n) { max_in_flight_ = n ? n : 1; }
+    uint8_t maxInFlight() const { return max_in_flight_; }
+    void setTimeoutMs(uint32_t ms) { timeout_ms_ = ms; }
+    uint32_t timeoutMs() const { return timeout_ms_; }
+
+    // One request PDU (function code first), waits for its reply PDU. An exception
+    // reply is returned like any other; the caller checks the function code.
+    bool transact(const uint8_t* pdu, size_t len, uint8_t* response, size_t response_size, size_t& response_len);
+
+    // The same request, duplicated on hedge (a second connection to the same unit) when
+    // no reply has arrived after policy.delayUs() and the policy's budget allows; the
+    // first reply wins and the other is discarded as stray when it turns up. Only for
+    // idempotent requests (reads).
+    bool hedgedTransact(ModbusTcpClient& hedge, HedgePolicy& policy, const uint8_t* pdu, size_t len,
+                        uint8_t* response, size_t response_size, size_t& response_len);
+
+    // Split request/reply, for waiting on more than one connection. sendRequest() writes one
+    // request (connecting first if needed); pollReply() takes the reply to txid once it is in,
+    // reading for up to wait_ms: 1 = reply copied, 0 = not yet, -1 = connection lost.
+    bool sendRequest(const uint8_t* pdu, size_t len, uint16_t& txid);
+    int pollReply(uint16_t txid, uint32_t wait_ms, uint8_t* response, size_t response_size, size_t& response_len);
+
+    // Waits until one of the connected clients has data to read, or wait_ms
+    static void waitAny(ModbusTcpClient* const* clients, size_t count, uint32_t wait_ms);
+
+    // Pipelined reads; each entry gets ok/exception set. Returns the number that succeeded.
+    size_t readBatch(ModbusRead* reads, size_t count);
+
+    // The same batch with hedging: a read still unanswered policy.delayUs() after it went
+    // out is sent again on hedge, budget permitting, and whichever reply comes first
+    // completes it. The rest of the window keeps moving meanwhile.
+    size_t hedgedReadBatch(ModbusTcpClient& hedge, HedgePolicy& policy, ModbusRead* reads, size_t count);
+
+    // A register range of any length, split into 125-register requests and pipelined
+    bool readRange(uint8_t function, uint16_t start, uint32_t count, uint16_t* values);
+
+    const ModbusTcpStats& stats() const { return stats_; }
+    const std::string& lastError() const { return last_error_; }
+
+private:
+    // build(i, pdu) writes request i's PDU and returns its length; done(i, pdu, len)
+    // gets the reply PDU, or nullptr when the request failed (timeout, socket error).
+    // With a hedge, build may be called a second time for a request being duplicated.
+    using BuildFn = std::function<size_t(size_t, uint8_t*)>;
+    using DoneFn = std::function<void(size_t, const uint8_t*, size_t)>;
+    void run(size_t count, const BuildFn& build, const DoneFn& done, ModbusTcpClient* hedge = nullptr,
+             HedgePolicy* policy = nullptr);
+    size_t readAll(ModbusRead* reads, size_t count, ModbusTcpClient* hedge, HedgePolicy* policy);
+
+    struct Slot {
+        bool busy = false;
+        uint16_t txid = 0;
+        size_t index = 0;
+        uint64_t deadline_ms = 0;
+        uint64_t sent_us = 0;
+        uint64_t hedge_at_us = 0;   // 0 = no hedge due
+        bool hedged = false;        // a duplicate is out on the hedge connection
+        uint16_t hedge_txid = 0;
+    };
+
+    bool sendAll(const uint8_t* data, size_t len);
+    // Writes the MBAP header for pdu_len bytes of PDU at out + MBAP_SIZE; returns the txid
+    uint16_t frame(uint8_t* out, size_t pdu_len);
+    // Reads whatever is available into rx_, waiting up to wait_ms. False on error or EOF.
+    bool receive(uint32_t wait_ms);
+    // Hands every whole frame in rx_ to take(txid, unit, pdu, pdu_len) and drops it from
+    // the buffer. False, with the connection failed, when the framing is lost.
+    template <typename Take>
+    bool takeFrames(Take take);
+    void fail(const char* what);
+
+    std::string host_;
+    uint16_t port_;
+    uint8_t unit_id_;
+    uint32_t timeout_ms_;
+    uint8_t max_in_flight_;
+    int fd_ = -1;
+    uint16_t next_txid_ = 1;
+    std::vector<Slot> slots_;
+    std::vector<uint8_t> tx_;
+    uint8_t rx_[4 * (MBAP_SIZE + MAX_PDU)];
+    size_t rx_len_ = 0;
+    ModbusTcpStats stats_;
+    std::string last_error_;
+};
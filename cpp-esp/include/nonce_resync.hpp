@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "sha256_engine.hpp"
+
+// Nonce resynchronization with the server after a reboot.
+//
+// The nonce state on flash is saved every tenth nonce and is gone with the filesystem,
+// so after a reboot the next outgoing nonce can be at or below the last one the server
+// accepted, and every secured request is rejected as a replay until it passes that.
+// Rather than guess, the device asks once at boot:
+//   POST /api/security/resync
+//     {"device":"<id>","challenge":"<32 hex>","mac":HMAC("resync" id challenge)}
+//   -> {"challenge":"<32 hex>","last_nonce":N,"mac":HMAC("resync-ack" id challenge N)}
+// and continues from N + 1. The request carries no nonce (that is what it repairs); the
+// fresh random challenge, covered by the reply's MAC, keeps a recorded or forged reply
+// from moving the nonce. Both MACs are lowercase hex HMAC-SHA256 with the PSK.
+
+class NonceResync {
+public:
+    static constexpr size_t CHALLENGE_SIZE = 16;
+
+    NonceResync(const std::string& device_id, const uint8_t challenge[CHALLENGE_SIZE]);
+
+    const std::string& challengeHex() const { return challenge_; }
+
+    // Signed request body
+    std::string request(HmacSha256& hmac) const;
+
+    // Checks the reply's challenge and MAC; true and last_nonce set when both match
+    bool parseReply(const std::string& body, HmacSha256& hmac, uint32_t& last_nonce) const;
+
+    // First nonce to use once the server has seen last_nonce; never goes backwards
+    static uint32_t nextNonce(uint32_t current, uint32_t last_nonce) {
+        return last_nonce >= current ? last_nonce + 1 : current;
+    }
+
+    // MAC inputs, shared with the server
+    static std::string requestMacInput(const std::string& device_id, const std::string& challenge_hex);
+    static std::string replyMacInput(const std::string& device_id, const std::string& challenge_hex,
+                                     uint32_t last_nonce);
+
+private:
+    std::string device_id_;
+    std::string challenge_;   // hex
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Remote-triggered profiling capture.
+//
+// A "profile" command starts a session of a few seconds to minutes. While it runs, the
+// device records into a buffer allocated once at start():
+//   spans     every CpuScope (acquisition, uplink, security, ...) as begin/end pairs,
+//             per task
+//   counters  free heap, minimum free heap and the loop task's free stack, sampled
+//             from loop()
+//   overruns  loop() passes longer than LOOP_BUDGET_US
+//   requests  each HTTP request with its status and duration
+// The session ends after its duration or when the buffer is full; the capture is then
+// serialized (serialize()), compressed and sent on the BACKGROUND lane, and app.py turns
+// it into a Chrome trace (chrome://tracing, Perfetto).
+//
+// Disabled, every hook is one relaxed atomic load. Enabled, a record is a few atomic
+// operations and a 12-byte store; memory is bounded by the event count given to start().
+// stop() waits for records already past the active() check, so a serialized capture
+// has no half-written events and release() never frees the buffer under a writer.
+//
+// Off the device threads are named thread0, thread1, ... and sampleCounters() records
+// nothing, having no heap or stack figures to read.
+
+enum class ProfileEventKind : uint8_t {
+    SPAN_BEGIN = 1,     // id = CpuSubsystem
+    SPAN_END = 2,
+    COUNTER = 3,        // id = ProfileCounter, value = bytes
+    LOOP_OVERRUN = 4,   // t = loop start, value = duration us
+    REQUEST = 5         // t = request start, value = duration us, id = HTTP status (int16)
+};
+
+enum class ProfileCounter : uint8_t {
+    HEAP_FREE = 0,
+    HEAP_MIN_FREE = 1,
+    STACK_FREE = 2
+};
+
+struct ProfileEvent {
+    uint32_t t_us;     // since the session started
+    uint32_t value;
+    uint8_t kind;
+    uint8_t tid;       // index into the session's task names
+    uint16_t id;
+};
+
+enum class ProfileState : uint8_t {
+    IDLE = 0,
+    CAPTURING = 1,
+    CAPTURED = 2    // finished, waiting to be serialized and released
+};
+
+// Monotonic wall-clock microseconds used for profile timestamps
+uint64_t profileClockUs();
+
+class Profiler {
+public:
+    static constexpr size_t DEFAULT_EVENTS = 2048;   // 24 KB
+    static constexpr uint32_t MAX_DURATION_MS = 300000;
+    static constexpr uint32_t LOOP_BUDGET_US = 50000;
+    static constexpr uint32_t COUNTER_PERIOD_US = 250000;
+    static constexpr size_t MAX_THREADS = 8;
+    static constexpr uint8_t FORMAT_VERSION = 1;
+
+    // Starts a session; false if one is running or waiting to be sent, or the buffer
+    // cannot be allocated
+    static bool start(uint32_t duration_ms, uint32_t session_id, size_t max_events = DEFAULT_EVENTS);
+
+    static bool active() { return active_.load(std::memory_order_relaxed); }
+    static ProfileState state() { return state_.load(std::memory_order_acquire); }
+    static uint32_t sessionId() { return session_id_; }
+
+    // Hooks; no-ops unless a session is capturing
+    static void spanBegin(uint8_t id) {
+        if (active()) record(ProfileEventKind::SPAN_BEGIN, id, 0, profileClockUs());
+    }
+    static void spanEnd(uint8_t id) {
+        if (active()) record(ProfileEventKind::SPAN_END, id, 0, profileClockUs());
+    }
+    static void request(uint64_t start_us, int status);
+
+    // Once per loop() while CAPTURING: start_us is the clock at the top of the pass (0 if
+    // the session started during it). Records an overrun if the pass ran long, samples
+    // the counters every COUNTER_PERIOD_US and ends the session when its time is up or
+    // the buffer is full.
+    static void loopDone(uint64_t start_us);
+
+    // One counter sample (loopDone takes the heap and stack ones on the device)
+    static void counter(ProfileCounter c, uint32_t value);
+
+    // Ends the session early (or on time; loopDone calls this). Returns once no other
+    // task is inside a record.
+    static void stop();
+
+    // Capture as bytes (see profiler.cpp for the layout); only in CAPTURED state
+    static bool serialize(std::vector<uint8_t>& out);
+
+    // Frees the buffer and returns to IDLE
+    static void release();
+
+    static size_t events();
+    static bool truncated() { return truncated_.load(std::memory_order_relaxed); }
+
+private:
+    static void record(ProfileEventKind kind, uint16_t id, uint32_t value, uint64_t t_us);
+    static uint8_t threadSlot();
+    static void sampleCounters();
+
+    static std::atomic<bool> active_;
+    static std::atomic<ProfileState> state_;
+    static std::atomic<uint32_t> next_;
+    static std::atomic<bool> truncated_;
+    static std::atomic<uint32_t> generation_;
+    static std::atomic<uint32_t> writers_;   // tasks inside record()
+    static ProfileEvent* events_;
+    static size_t capacity_;
+    static uint64_t start_us_;
+    static uint64_t end_us_;
+    static uint64_t last_counters_us_;
+    static uint32_t duration_us_;
+    static uint32_t session_id_;
+    static std::atomic<uint8_t> thread_count_;
+    static char thread_names_[MAX_THREADS][16];
+};
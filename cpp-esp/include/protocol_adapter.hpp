@@ -2,6 +2,7 @@
 #include "config_manager.hpp"
 #include "http_client.hpp"
 #include "modbus_frame.hpp"
+#include "modbus_tcp.hpp"
 #include <stdint.h>
 
 class ProtocolAdapter {
@@ -9,16 +10,65 @@ public:
     ProtocolAdapter(ConfigManager* config, EcoHttpClient* http_client);
     ~ProtocolAdapter() = default;
 
-    // Read holding registers from inverter
+    // Read holding registers from inverter (function 0x03)
     bool readRegisters(uint16_t start_address, uint16_t num_registers, uint16_t *values);
 
+    // Read input registers from inverter (function 0x04)
+    bool readInputRegisters(uint16_t start_address, uint16_t num_registers, uint16_t *values);
+
     // Write single register to inverter
     bool writeRegister(uint16_t register_address, uint16_t value);
 
+    // Write a block of registers and read back a block in one transaction (function 0x17).
+    // The inverter performs the write before the read, so the readback reflects the new values.
+    bool readWriteRegisters(uint16_t read_start, uint16_t read_count, uint16_t *read_values,
+                            uint16_t write_start, uint16_t write_count, const uint16_t *write_values);
+
+    // False while the inverter (or SIM) has said it has no 0x17; callers fall back to
+    // write + read. Tried again every ModbusReadWriteSupport::REPROBE_MS.
+    bool supportsReadWrite() const;
+
+    // Several reads in one go: pipelined over Modbus TCP, one after another over HTTP.
+    // Returns the number that succeeded; each entry's ok flag says which.
+    size_t readBatch(ModbusRead* reads, size_t count);
+
+    // Route every transaction over Modbus TCP instead of the HTTP SIM (nullptr: back to HTTP).
+    // The client is owned by the caller.
+    void setTcpClient(ModbusTcpClient* tcp) { tcp_ = tcp; }
+    bool usesTcp() const { return tcp_ != nullptr; }
+
+    // Hedged reads over Modbus TCP (hedge_policy.hpp): a 0x03/0x04 read that is slower
+    // than its p95 is duplicated on this second connection to the same unit, within the
+    // policy's budget, both for single reads and inside readBatch's pipelined window.
+    // Writes are never hedged. nullptr turns it off; owned by the caller.
+    void setHedgeClient(ModbusTcpClient* hedge) { hedge_tcp_ = hedge; }
+    const HedgePolicy& hedgePolicy() const { return hedge_policy_; }
+
     // Test communication with inverter
     bool testCommunication();
 
+    static constexpr uint16_t MAX_READ_REGISTERS = 125;
+    static constexpr uint16_t MAX_RW_WRITE_REGISTERS = 16;
+
 private:
     ConfigManager* config_;
     EcoHttpClient* http_client_;
+    ModbusTcpClient* tcp_ = nullptr;
+    ModbusTcpClient* hedge_tcp_ = nullptr;
+    HedgePolicy hedge_policy_;
+    ModbusReadWriteSupport rw_support_;
+
+    // Shared read path for 0x03 / 0x04
+    bool readBlock(uint8_t function, uint16_t start_address, uint16_t num_registers, uint16_t *values);
+
+    // Appends CRC to frame[0..len), sends it to endpoint and validates the response frame
+    // (CRC, slave address, exception, function code). frame must have room for 2 more bytes.
+    // Over Modbus TCP the PDU goes out with an MBAP header instead and the reply is
+    // returned in the same RTU layout, so callers don't care which transport ran.
+    // exception_code is set to the Modbus exception code when the inverter returned one.
+    bool transact(const char* endpoint, uint8_t* frame, size_t len,
+                  uint8_t* response, int& response_len, uint8_t& exception_code, int& http_status);
+
+    // Slave address, exception and function code checks shared by both transports
+    bool validateResponse(const uint8_t* frame, const uint8_t* response, uint8_t& exception_code);
 };
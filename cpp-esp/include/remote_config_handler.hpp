@@ -4,18 +4,22 @@
 #include "secure_http_client.hpp"
 #include "config_update.hpp"
 #include "command_executor.hpp"
+#include "flow_control.hpp"
 
 class SecureHttpClient;
 class CommandExecutor;
+class UplinkPacketizer;
 #include "ticker_fallback.hpp"
 #include <cstdint>
 #include <functional>
+#include <vector>
 
 class RemoteConfigHandler {
 public:
     RemoteConfigHandler(ConfigManager* config, SecureHttpClient* secure_http, CommandExecutor* cmd_executor = nullptr);
     ~RemoteConfigHandler();
 
+    // The first poll is offset by a phase derived from the device ID (see setDeviceId)
     void begin(uint32_t interval_ms = 60000);
     void end();
     void loop();
@@ -23,6 +27,15 @@ public:
     void sendConfigAck(const ConfigUpdateAck& ack);
     void onConfigUpdate(std::function<void()> callback);
     void onCommand(std::function<void(const CommandRequest&)> callback);
+
+    // Seeds the fleet phase offset and Retry-After jitter
+    void setDeviceId(const std::string& device_id) { deviceId_ = device_id; }
+
+    // Optional: route acks and command results through the uplink's urgent lane
+    void setUplink(UplinkPacketizer* uplink) { uplink_ = uplink; }
+
+    // Nonce of the last config update that changed something (0 before the first)
+    uint32_t configVersion() const { return configVersion_; }
     
     // Command execution methods
     void checkForCommands();
@@ -31,8 +44,9 @@ public:
     // Parse config update request from JSON
     bool parseConfigUpdateRequest(const char* json, ConfigUpdateRequest& request);
     
-    // Parse command request from JSON
-    bool parseCommandRequest(const char* json, CommandRequest& command);
+    // Parse the command batch ({"commands": [...]}, or a single "command") from JSON;
+    // appends to commands and returns how many were parsed
+    size_t parseCommandRequests(const char* json, std::vector<CommandRequest>& commands);
     
     // Generate acknowledgment JSON
     std::string generateAckJson(const ConfigUpdateAck& ack);
@@ -44,9 +58,14 @@ private:
     Ticker pollTicker_;
     uint32_t pollInterval_ = 60000;
     bool running_ = false;
+    size_t repollWanted_ = 0;  // queue slots to wait for before polling for the rest of a batch
+    uint32_t configVersion_ = 0;
     ConfigManager* config_ = nullptr;
     SecureHttpClient* secure_http_ = nullptr;
     CommandExecutor* cmd_executor_ = nullptr;
+    UplinkPacketizer* uplink_ = nullptr;
+    std::string deviceId_;
+    FlowControl flow_;
     std::function<void(const CommandRequest&)> onCommandCallback_ = nullptr;
     std::function<void()> onUpdateCallback_ = nullptr;
     void pollTask();
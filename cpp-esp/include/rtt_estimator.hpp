@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Adaptive request timeouts from measured round-trip times (RFC 6298).
+//
+// Every endpoint gets its own estimator: inverter reads answer in tens of milliseconds,
+// FOTA chunks in seconds, and one fixed timeout is wrong for both. Each completed
+// request feeds its time to the status line into
+//   RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|,  SRTT = 7/8 SRTT + 1/8 R
+// (the first sample sets SRTT = R, RTTVAR = R/2) and the next request on that endpoint
+// waits RTO = SRTT + max(G, 4 RTTVAR), clamped to [min_ms, max_ms]. A timeout doubles
+// the RTO until the next sample (exponential backoff), so a link that got slower
+// still gets its answer through instead of timing out forever. Before the first
+// sample the configured fixed timeout is used.
+//
+// Values are kept scaled (SRTT x8, RTTVAR x4) so the update is integer-only.
+
+struct RttLimits {
+    uint32_t initial_ms = 5000;    // before the first sample
+    uint32_t min_ms = 250;
+    uint32_t max_ms = 30000;
+    uint32_t granularity_ms = 10;  // G: clock granularity and scheduling noise
+};
+
+class RttEstimator {
+public:
+    explicit RttEstimator(const RttLimits& limits = RttLimits()) : limits_(limits) {}
+
+    // Timeout for the next request, including any backoff
+    uint32_t timeoutMs() const;
+
+    // A request completed after rtt_ms; clears the backoff
+    void onSample(uint32_t rtt_ms);
+
+    // A request waited timeoutMs() without an answer
+    void onTimeout();
+
+    bool hasSample() const { return samples_ > 0; }
+    uint32_t srttMs() const { return srtt8_ >> 3; }
+    uint32_t rttvarMs() const { return rttvar4_ >> 2; }
+    uint32_t samples() const { return samples_; }
+    uint32_t timeouts() const { return timeouts_; }
+    uint8_t backoff() const { return backoff_; }
+
+private:
+    uint32_t clamp(uint32_t ms) const;
+
+    RttLimits limits_;
+    uint32_t srtt8_ = 0;     // SRTT << 3
+    uint32_t rttvar4_ = 0;   // RTTVAR << 2
+    uint8_t backoff_ = 0;    // timeouts since the last sample
+    uint32_t samples_ = 0;
+    uint32_t timeouts_ = 0;
+};
+
+// Estimators by endpoint path. The query string is not part of the key
+// ("/fota/chunk?chunk_number=7" shares "/fota/chunk"), nor is the scheme and host of a
+// full URL. When all slots are taken, the least recently used one is reused.
+class EndpointRtt {
+public:
+    static constexpr size_t SLOTS = 8;
+    static constexpr size_t KEY_LEN = 48;
+
+    explicit EndpointRtt(const RttLimits& limits = RttLimits()) : limits_(limits) {}
+
+    uint32_t timeoutMs(const char* endpoint);
+    void onSample(const char* endpoint, uint32_t rtt_ms);
+    void onTimeout(const char* endpoint);
+
+    // Null when the endpoint has no estimator yet
+    const RttEstimator* find(const char* endpoint) const;
+
+    // {"/api/read":{"srtt":48,"rttvar":9,"rto":250,"samples":120,"timeouts":1},...}
+    std::string json() const;
+
+    static std::string keyFor(const char* endpoint);
+
+private:
+    struct Slot {
+        char key[KEY_LEN] = {0};
+        RttEstimator est;
+        uint32_t used = 0;   // tick of the last use; 0 = free
+    };
+
+    Slot& slotFor(const char* endpoint);
+
+    RttLimits limits_;
+    Slot slots_[SLOTS];
+    uint32_t tick_ = 0;
+};
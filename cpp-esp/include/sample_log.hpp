@@ -0,0 +1,238 @@
+#pragma once
+#include "types.hpp"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifdef ESP32
+#include <esp_partition.h>
+#endif
+
+// Append-only sample log on a raw flash region (no filesystem).
+//
+// The region is split into 4 KB sectors used as a ring. Each sector starts with a
+// 16-byte header written right after the erase:
+//   magic u32 | seq u32 | first_ts u32 | version u8 | rsv u8 | crc16 u16
+// followed by 340 fixed 12-byte records written in place (NOR flash: erased bytes
+// are 0xFF and a write only clears bits):
+//   ts u32 | value f32 | reg u8 | flags u8 (0 = written) | crc16 u16
+//
+// Recovery is a header scan: the sector with the highest valid seq is the head, the
+// live ring is the run of sectors before it with consecutive seqs, and the head's
+// write position is its first erased record. A record torn by power loss fails its
+// CRC and closes the sector; appends continue in the next one.
+//
+// Reads go through the region's memory-mapped view, so scans hand out references
+// into flash instead of copying.
+//
+// query() and summarize() keep a zone map in RAM for every live sector: its timestamp
+// range and, per register, the count, min, max and sum of the values. The sector layout
+// has no spare bytes for it, so the first query builds the maps from the records and
+// append() keeps them current from then on (about 270 bytes per sector). A log that is
+// never queried spends no RAM on them. Queries use them to skip sectors that cannot
+// match and decode only the candidates.
+
+struct SampleLogRecord {
+    uint32_t ts;
+    float value;
+    uint8_t reg;
+    uint8_t flags;
+    uint16_t crc;
+};
+static_assert(sizeof(SampleLogRecord) == 12, "SampleLogRecord must stay packed");
+
+// Flash region the log lives in. data() is a read-only mapping of the whole region
+// that reflects completed writes.
+class SampleLogRegion {
+public:
+    virtual ~SampleLogRegion() {}
+    virtual size_t size() const = 0;
+    virtual const uint8_t* data() const = 0;
+    virtual bool erase(size_t offset, size_t len) = 0;      // sector aligned, sets 0xFF
+    virtual bool write(size_t offset, const void* src, size_t len) = 0;
+};
+
+// Summary of one register's values in a sector (or a query result)
+struct SampleLogZone {
+    uint32_t count = 0;
+    float min = INFINITY;
+    float max = -INFINITY;
+    float sum = 0.0f;   // NaN values are left out, as no query matches them
+
+    void add(float value);
+    void merge(const SampleLogZone& other);
+    float mean() const { return count ? sum / count : 0.0f; }
+};
+
+struct SampleLogZoneMap {
+    static constexpr uint8_t REGS = 16;   // DataStorage stores registers 0..15
+    uint32_t ts_min = 0xFFFFFFFFu;
+    uint32_t ts_max = 0;
+    uint16_t records = 0;
+    bool other_regs = false;   // a record for reg >= REGS (never ruled out)
+    SampleLogZone regs[REGS];
+
+    void add(const SampleLogRecord& r);
+};
+
+// Records of one register with min_value <= value <= max_value and
+// start_ts <= ts <= end_ts. Thresholds are ranges open at one end.
+struct SampleLogQuery {
+    uint8_t reg = 0;
+    float min_value = -INFINITY;
+    float max_value = INFINITY;
+    uint32_t start_ts = 0;
+    uint32_t end_ts = 0xFFFFFFFFu;
+
+    static SampleLogQuery between(uint8_t reg, float lo, float hi);
+    static SampleLogQuery above(uint8_t reg, float threshold);   // value > threshold
+    static SampleLogQuery below(uint8_t reg, float threshold);   // value < threshold
+    SampleLogQuery& during(uint32_t start, uint32_t end) {
+        start_ts = start;
+        end_ts = end;
+        return *this;
+    }
+    bool matches(const SampleLogRecord& r) const {
+        return r.reg == reg && r.ts >= start_ts && r.ts <= end_ts && r.value >= min_value && r.value <= max_value;
+    }
+};
+
+struct SampleLogQueryStats {
+    uint32_t sectors_skipped = 0;   // ruled out by the zone map
+    uint32_t sectors_scanned = 0;   // records decoded
+    uint32_t sectors_summarized = 0;   // answered from the zone map alone (summarize)
+    uint32_t records_decoded = 0;
+    uint32_t matches = 0;
+};
+
+struct SampleLogStats {
+    uint32_t records_written = 0;
+    uint32_t bytes_written = 0;     // including sector headers
+    uint32_t sectors_erased = 0;
+    uint32_t records_dropped = 0;   // lost to ring wrap
+    uint32_t torn_records = 0;      // found during recovery
+    uint32_t write_errors = 0;
+};
+
+class SampleLog {
+public:
+    static constexpr size_t SECTOR_SIZE = 4096;
+    static constexpr size_t HEADER_SIZE = 16;
+    static constexpr size_t RECORDS_PER_SECTOR = (SECTOR_SIZE - HEADER_SIZE) / sizeof(SampleLogRecord);
+    static constexpr uint32_t MAGIC = 0x31474C53;   // "SLG1"
+    static constexpr uint8_t VERSION = 1;
+
+    // Called oldest-first with a reference into the mapped region; return false to stop
+    using Visitor = std::function<bool(const SampleLogRecord&)>;
+
+    explicit SampleLog(SampleLogRegion* region);
+
+    // Scan sector headers and find the write position. Needs at least two sectors.
+    bool begin();
+
+    // One flash write per 64 records (fewer at sector boundaries)
+    bool append(const Sample* samples, size_t count);
+
+    // Records with start_ts <= ts <= end_ts, oldest first (timestamps restart with
+    // millis() after a reboot, so every live record is checked). Returns records visited.
+    size_t scan(uint32_t start_ts, uint32_t end_ts, const Visitor& fn) const;
+
+    // Records matching q, oldest first, decoding only the sectors whose zone maps
+    // allow a match. Returns matches visited.
+    size_t query(const SampleLogQuery& q, const Visitor& fn, SampleLogQueryStats* stats = nullptr) const;
+
+    // Count, min, max and sum of reg over start_ts <= ts <= end_ts. Sectors wholly
+    // inside the range are taken from their zone maps; only the edges are decoded.
+    SampleLogZone summarize(uint8_t reg, uint32_t start_ts, uint32_t end_ts,
+                            SampleLogQueryStats* stats = nullptr) const;
+
+    // Newest n records in chronological order
+    size_t readLast(size_t n, Sample* out, size_t out_size) const;
+
+    // Erase every sector and start again
+    bool clear();
+
+    size_t records() const { return records_; }
+    size_t capacity() const { return sector_count_ * RECORDS_PER_SECTOR; }
+    size_t sectorCount() const { return sector_count_; }
+    uint32_t headSeq() const { return head_seq_; }
+    const SampleLogStats& stats() const { return stats_; }
+    bool zonesBuilt() const { return !zones_.empty(); }
+    std::string statsJson() const;
+
+    static uint16_t crc16(const uint8_t* data, size_t len);
+
+private:
+    SampleLogRegion* region_;
+    size_t sector_count_ = 0;
+    bool ready_ = false;
+    bool empty_ = true;
+    size_t head_ = 0;             // sector being written
+    size_t tail_ = 0;             // oldest live sector
+    uint32_t head_seq_ = 0;
+    size_t head_used_ = 0;        // records in the head sector
+    bool head_closed_ = false;    // torn record: no more writes in this sector
+    size_t records_ = 0;
+    std::vector<uint16_t> used_;  // valid records per sector, counted once at begin()
+    mutable std::vector<SampleLogZoneMap> zones_;   // per sector, empty until the first query
+    SampleLogStats stats_;
+
+    const uint8_t* sectorPtr(size_t sector) const { return region_->data() + sector * SECTOR_SIZE; }
+    const SampleLogRecord* recordsOf(size_t sector) const {
+        return reinterpret_cast<const SampleLogRecord*>(sectorPtr(sector) + HEADER_SIZE);
+    }
+    bool readHeader(size_t sector, uint32_t& seq, uint32_t& first_ts) const;
+    size_t countRecords(size_t sector, bool& torn) const;
+    size_t usedIn(size_t sector) const { return used_[sector]; }
+    void buildZones() const;
+    // Skips sectors the zone map rules out; returns false when fn stopped the walk
+    bool querySector(size_t sector, const SampleLogQuery& q, const Visitor& fn, SampleLogQueryStats& st) const;
+    bool openSector(size_t sector, uint32_t seq, uint32_t first_ts);
+};
+
+#ifdef ESP32
+// Dedicated data partition (partitions.csv: label "samplelog", subtype 0x40), read
+// through esp_partition_mmap. Flash writes invalidate the cache for the written
+// range, so the mapping always shows committed records.
+class EspPartitionRegion : public SampleLogRegion {
+public:
+    static constexpr const char* LABEL = "samplelog";
+    static constexpr uint8_t SUBTYPE = 0x40;
+
+    EspPartitionRegion() {}
+    ~EspPartitionRegion() override;
+    bool begin();
+
+    size_t size() const override { return part_ ? part_->size : 0; }
+    const uint8_t* data() const override { return map_; }
+    bool erase(size_t offset, size_t len) override;
+    bool write(size_t offset, const void* src, size_t len) override;
+
+private:
+    const esp_partition_t* part_ = nullptr;
+    const uint8_t* map_ = nullptr;
+    spi_flash_mmap_handle_t handle_ = 0;
+};
+#else
+// Host stand-in for a flash partition: a file mapped with mmap, written with NOR
+// semantics (writes clear bits, erase sets 0xFF). Used by tests and bench_sample_log.
+class MappedFileRegion : public SampleLogRegion {
+public:
+    MappedFileRegion(const std::string& path, size_t size);
+    ~MappedFileRegion() override;
+    bool ok() const { return map_ != nullptr; }
+
+    size_t size() const override { return size_; }
+    const uint8_t* data() const override { return map_; }
+    bool erase(size_t offset, size_t len) override;
+    bool write(size_t offset, const void* src, size_t len) override;
+
+private:
+    int fd_ = -1;
+    size_t size_;
+    uint8_t* map_ = nullptr;
+};
+#endif
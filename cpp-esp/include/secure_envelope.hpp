@@ -0,0 +1,32 @@
+#pragma once
+#include "io_buf.hpp"
+#include "sha256_engine.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Secured-message envelope built on an IoChain.
+//
+// Produces byte for byte what SecurityLayer::generateSecuredEnvelope serializes:
+//   {"nonce":N,"timestamp":T,"encrypted":false,"payload":"<base64>","mac":"<hex>"}
+// The base64 text is written once, straight into pooled blocks that keep headroom for
+// the JSON prefix. The MAC covers nonce | timestamp | flag | base64 text, the same
+// input SecurityLayer::secureMessage uses, and is streamed over those blocks rather
+// than over a concatenated copy; its hex lands in the tailroom.
+
+// Enough for the longest prefix: {"nonce":4294967295,"timestamp":4294967295,"encrypted":false,"payload":"
+static constexpr size_t ENVELOPE_HEADROOM = 80;
+
+// Base64 of in appended to out (one write per output byte); returns characters written
+size_t base64AppendChain(const IoChain& in, IoChain& out, size_t headroom = 0);
+
+// Base64 of a contiguous buffer, for JSON bodies built as strings
+std::string base64Encode(const uint8_t* data, size_t len);
+
+// Base64 text into at most out_cap bytes; stops at '=' and skips characters outside the
+// alphabet (line breaks). Returns bytes written, 0 if the output would not fit.
+size_t base64Decode(const char* in, size_t len, uint8_t* out, size_t out_cap);
+
+// encrypted is the envelope flag only; payload is taken as already processed
+bool sealEnvelope(const IoChain& payload, uint32_t nonce, uint32_t timestamp, bool encrypted,
+                  HmacSha256& hmac, IoChain& out);
@@ -47,6 +47,20 @@ public:
                                const std::string& payload,
                                std::string& plain_response);
     
+    /**
+     * @brief Perform secure POST request without flattening the payload
+     *
+     * The envelope is built in the payload chain's pool around the base64 text and
+     * handed to the transport slice by slice.
+     * @param endpoint API endpoint
+     * @param payload Payload slices (e.g. an upload chunk wrapped in place)
+     * @param plain_response Output plain response
+     * @return HTTP response
+     */
+    EcoHttpResponse securePost(const char* endpoint,
+                               const IoChain& payload,
+                               std::string& plain_response);
+    
     /**
      * @brief Perform secure GET request
      * @param endpoint API endpoint
@@ -56,6 +70,24 @@ public:
     EcoHttpResponse secureGet(const char* endpoint,
                               std::string& plain_response);
     
+    /**
+     * @brief Resynchronize the outgoing nonce with the server
+     *
+     * One signed POST to /api/security/resync; the nonce continues past the last one
+     * the server accepted from this device (see nonce_resync.hpp). Called at boot so
+     * the first secured request is not rejected as a replay. A secured request the
+     * server rejects as a replay triggers another resync with the same device ID.
+     * @param device_id Device ID sent in the Device-ID header
+     * @return true if the server answered and its reply verified
+     */
+    bool resyncNonce(const std::string& device_id);
+    
+    /**
+     * @brief Check whether a resync has succeeded since boot
+     * @return True once the nonce is known to be past the server's
+     */
+    bool nonceSynced() const { return nonce_synced_; }
+    
     /**
      * @brief Get underlying HTTP client
      * @return Pointer to EcoHttpClient
@@ -81,8 +113,13 @@ public:
     bool isSecurityEnabled() const { return security_enabled_; }
     
 private:
+    void verifyResponse(const EcoHttpResponse& response, std::string& plain_response);
+    void resyncIfReplay(const EcoHttpResponse& response);
+
     EcoHttpClient* http_client_;
     SecurityLayer* security_;
     bool security_enabled_;
     bool owns_http_client_;
+    std::string device_id_;       // from the last resyncNonce() call
+    bool nonce_synced_ = false;
 };
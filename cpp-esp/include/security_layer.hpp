@@ -1,8 +1,12 @@
 #pragma once
 
 #include <stdint.h>
+#include <memory>
 #include <string>
 #include <vector>
+#include "sha256_engine.hpp"
+#include "io_buf.hpp"
+#include "nonce_resync.hpp"
 
 /**
  * @file security_layer.hpp
@@ -99,6 +103,19 @@ public:
      */
     std::string generateSecuredEnvelope(const SecuredMessage& secured_msg);
     
+    /**
+     * @brief Secure a payload chain straight into its JSON envelope
+     *
+     * Same envelope as secureMessage + generateSecuredEnvelope, but the base64 text is
+     * written once into envelope's pool and the MAC is streamed over it (see
+     * secure_envelope.hpp). AES needs the whole plaintext, so with real encryption the
+     * payload is flattened and the string path is used.
+     * @param payload Plain payload slices
+     * @param envelope Output envelope (uses envelope.pool())
+     * @return Security operation result
+     */
+    SecurityResult secureMessage(const IoChain& payload, IoChain& envelope);
+    
     // ========== Incoming Message Verification ==========
     
     /**
@@ -152,6 +169,20 @@ public:
      */
     bool saveNonceState();
     
+    /**
+     * @brief Start a nonce resync with the server (see nonce_resync.hpp)
+     * @param device_id Device ID the server keys its nonces by
+     * @return Signed request body for /api/security/resync, empty on key error
+     */
+    std::string beginNonceResync(const std::string& device_id);
+    
+    /**
+     * @brief Verify the server's resync reply and continue past its last nonce
+     * @param reply Reply body
+     * @return true if the reply matched the pending request; the nonce is saved
+     */
+    bool finishNonceResync(const std::string& reply);
+    
     // ========== Cryptographic Operations ==========
     
     /**
@@ -162,6 +193,15 @@ public:
      */
     std::string computeHMAC(const std::string& data, const std::string& key);
     
+    /**
+     * @brief Compute HMAC-SHA256 over a raw buffer (no copy into a string)
+     * @param data Input bytes
+     * @param len Input length
+     * @param key HMAC key (hex)
+     * @return HMAC tag (hex string), empty if the key is invalid
+     */
+    std::string computeHMAC(const uint8_t* data, size_t len, const std::string& key);
+    
     /**
      * @brief Verify HMAC
      * @param data Input data
@@ -171,6 +211,15 @@ public:
      */
     bool verifyHMAC(const std::string& data, const std::string& mac, 
                    const std::string& key);
+
+    /**
+     * @brief Verify an HMAC-SHA256 over a raw buffer with the configured PSK
+     * @param data Input bytes
+     * @param len Input length
+     * @param mac_hex Expected MAC (64 hex characters)
+     * @return true if MAC is valid; nothing is allocated
+     */
+    bool verifyHMAC(const uint8_t* data, size_t len, const char* mac_hex);
     
     /**
      * @brief Encrypt data using AES-CBC
@@ -231,6 +280,12 @@ public:
      */
     std::string getSecurityStats() const;
     
+    /**
+     * @brief Rejected messages, for the device shadow
+     */
+    uint32_t replayAttempts() const { return replay_attempts_; }
+    uint32_t macFailures() const { return mac_failures_; }
+    
     /**
      * @brief Reset statistics
      */
@@ -249,11 +304,20 @@ private:
     uint32_t messages_verified_;
     uint32_t replay_attempts_;
     uint32_t mac_failures_;
+    uint32_t nonce_resyncs_;
+    
+    // Pending resync request, until its reply arrives
+    std::unique_ptr<NonceResync> resync_;
+    
+    // HMAC with the key pads pre-absorbed; rebuilt when the key changes
+    std::unique_ptr<HmacSha256> hmac_;
+    std::string hmac_key_;
     
     // Internal helpers
+    bool ensureHmacKey(const std::string& key);
     bool initializeCrypto();
     void cleanupCrypto();
-    uint32_t estimateRecoveryNonce(); // Smart nonce recovery when state loading fails
+    uint32_t estimateRecoveryNonce(); // Fallback when state loading fails and resync is not possible
     std::string bytesToHex(const uint8_t* bytes, size_t len) const;
     bool hexToBytes(const std::string& hex, uint8_t* bytes, size_t max_len) const;
     std::string base64Encode(const uint8_t* data, size_t len) const;
@@ -0,0 +1,68 @@
+#pragma once
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary telemetry tap for the local serial/USB port.
+//
+// While the tap is on, every sample that lands in the sample ring is streamed out as
+// COBS-framed packets, each terminated by a 0x00 byte:
+//   COBS( [seq u32] [uplink FRAME batch] [crc16 u16] )
+// seq is the ring sequence of the first sample in the batch, so the host sees a gap
+// when the ring overtook the tap; the batch is the same FRAME encoding the uplink uses
+// (one record per polling cycle); crc16 is the Modbus CRC over seq + batch.
+//
+// The tap never reads ahead of what the port can take: the caller feeds it samples
+// only once the previous packet is fully written and writes at most the free space in
+// the UART buffer each pass, so acquisition is never held up by the port.
+
+// Worst-case COBS output for len input bytes (without the 0x00 delimiter)
+constexpr size_t cobsMaxEncoded(size_t len) { return len + len / 254 + 1; }
+
+// Returns the encoded length; out must hold cobsMaxEncoded(len) bytes
+size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out);
+// Decodes one frame (delimiter stripped). False on a zero byte or a truncated block.
+bool cobsDecode(const uint8_t* in, size_t len, std::vector<uint8_t>& out);
+
+class SerialTap {
+public:
+    static constexpr size_t MAX_BATCH_BYTES = 240;    // keeps a packet under 256 bytes
+    static constexpr size_t READ_SAMPLES = 64;        // more than one batch can carry
+    static constexpr uint32_t DEFAULT_BAUD = 921600;
+
+    void start(uint32_t from_seq);
+    void stop();
+    bool active() const { return active_; }
+
+    // Ring sequence of the next sample to stream
+    uint32_t cursor() const { return cursor_; }
+    // True when the previous packet is out and the tap can take more samples
+    bool wantsSamples() const { return active_ && sent_ == packet_.size(); }
+
+    // Frames samples read from the ring at first_seq into the next packet.
+    // Returns the samples consumed; the rest are read again on the next pass.
+    size_t feed(const Sample* samples, size_t count, uint32_t first_seq);
+
+    // Unsent bytes of the current packet; consume() after writing some of them
+    const uint8_t* pending(size_t& len) const;
+    void consume(size_t n);
+
+    uint32_t packets() const { return packets_; }
+    uint32_t dropped() const { return dropped_; }
+
+    // {"active":..,"packets":..,"samples":..,"bytes":..,"dropped":..}
+    std::string statsJson() const;
+
+private:
+    bool active_ = false;
+    uint32_t cursor_ = 0;
+    std::vector<uint8_t> payload_;
+    std::vector<uint8_t> packet_;
+    size_t sent_ = 0;
+    uint32_t packets_ = 0;
+    uint32_t samples_ = 0;
+    uint32_t bytes_ = 0;
+    uint32_t dropped_ = 0;   // samples the ring overwrote before the tap read them
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ESP32
+#include <mbedtls/sha256.h>
+#endif
+
+// SHA-256 engine shared by HMAC (secured messages, FOTA chunks) and the FOTA image hash.
+//
+// Backends:
+//   ESP32_HW  mbedtls' ESP32 port: the SHA accelerator (DMA-driven on S2/S3/C3; the
+//             original ESP32 engine has no DMA), software when the engine is busy
+//   SHA_NI    x86 SHA extensions, single stream
+//   AVX2_MB   8 independent messages per pass (sha256Multi only)
+//   PORTABLE  plain C++, always available
+//
+// Off the device ESP32_HW is never available. sha256BestBackend() picks SHA-NI when the
+// CPU has it, else PORTABLE; sha256MultiBackend() also considers AVX2.
+
+constexpr size_t SHA256_DIGEST_SIZE = 32;
+constexpr size_t SHA256_BLOCK_SIZE = 64;
+
+enum class Sha256Backend : uint8_t {
+    PORTABLE = 0,
+    SHA_NI = 1,
+    AVX2_MB = 2,
+    ESP32_HW = 3
+};
+
+const char* sha256BackendName(Sha256Backend backend);
+bool sha256BackendAvailable(Sha256Backend backend);
+
+// Fastest single-stream backend on this machine: ESP32_HW on the device, SHA_NI or
+// PORTABLE on the host
+Sha256Backend sha256BestBackend();
+
+// Fastest backend for sha256Multi: AVX2_MB on x86 hosts with AVX2 but no SHA-NI,
+// otherwise sha256BestBackend()
+Sha256Backend sha256MultiBackend();
+
+// Incremental hash. Copyable, so a partially absorbed state (e.g. an HMAC key pad) can
+// be saved and resumed.
+class Sha256 {
+public:
+    explicit Sha256(Sha256Backend backend = sha256BestBackend());
+    Sha256(const Sha256& other);
+    Sha256& operator=(const Sha256& other);
+    ~Sha256();
+
+    void reset();
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t digest[SHA256_DIGEST_SIZE]);   // call reset() before reusing
+
+    Sha256Backend backend() const { return backend_; }
+
+    static void hash(const uint8_t* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE],
+                     Sha256Backend backend = sha256BestBackend());
+
+private:
+    Sha256Backend backend_;
+#ifdef ESP32
+    mbedtls_sha256_context ctx_;
+#endif
+    uint32_t state_[8];
+    uint64_t total_;
+    uint8_t buf_[SHA256_BLOCK_SIZE];
+    size_t buf_len_;
+};
+
+// HMAC-SHA256 with the key pads absorbed once, so each message costs only its own blocks
+// plus two finishing compressions.
+class HmacSha256 {
+public:
+    HmacSha256(const uint8_t* key, size_t key_len, Sha256Backend backend = sha256BestBackend());
+
+    void begin();
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t mac[SHA256_DIGEST_SIZE]);
+
+    void compute(const uint8_t* data, size_t len, uint8_t mac[SHA256_DIGEST_SIZE]);
+    // Constant-time check against a 64-character hex MAC (either case)
+    bool verifyHex(const uint8_t* data, size_t len, const char* mac_hex);
+
+private:
+    uint8_t ipad_[SHA256_BLOCK_SIZE];
+    uint8_t opad_[SHA256_BLOCK_SIZE];
+    Sha256 inner_;   // after key ^ ipad
+    Sha256 outer_;   // after key ^ opad
+    Sha256 work_;
+    bool cached_;    // false on the accelerator, which cannot resume a saved midstate
+};
+
+// Hashes count independent messages. On x86-64 hosts with AVX2 and no SHA-NI, equal-length
+// messages are hashed eight at a time; elsewhere this loops over the single-stream backend.
+void sha256Multi(const uint8_t* const* data, const size_t* len, size_t count,
+                 uint8_t (*digests)[SHA256_DIGEST_SIZE], Sha256Backend backend = sha256MultiBackend());
+
+// Throughput in MB/s over iterations x buffer_bytes. now_us supplies the clock
+// (esp_timer_get_time on the device, steady_clock on the host).
+double sha256BenchmarkMBps(Sha256Backend backend, size_t buffer_bytes, uint32_t iterations,
+                           uint64_t (*now_us)());
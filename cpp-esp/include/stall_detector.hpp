@@ -0,0 +1,121 @@
+#pragma once
+#include "cpu_accounting.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Stall detector: which blocking call held up loop() and for how long.
+//
+// Blocking regions of the loop task (HTTP requests, Modbus polls, flash commits, the
+// FOTA finalize and reboot waits) are wrapped in a StallScope naming the subsystem and
+// the operation. A monitor samples the region the loop task is in: on the device an
+// esp_timer callback every SAMPLE_PERIOD_MS, running in the high-priority esp_timer task
+// so it keeps going while loop() is stuck. Once a region has run past the threshold it
+// gets a record, kept up to date until the region exits.
+//
+// Records live in RTC_NOINIT memory. If a watchdog or panic reset hits in the middle of
+// a stall, the record is still open at the next boot; begin() closes it with the reset
+// reason, so the stall that caused the reset is reported after it.
+//
+// Regions nest; the innermost one is blamed, and an outer region's clock restarts when
+// an inner one exits. Regions entered from other tasks are ignored.
+//
+// Off the device there is no timer: the area is ordinary memory (or the one passed to
+// begin()) and tests call sample() themselves. The watched task is the thread that
+// called begin().
+
+struct StallRecord {
+    static constexpr uint8_t OPEN = 0x01;    // region had not exited at the last sample
+    static constexpr uint8_t RESET = 0x02;   // a reset ended it; reset_reason says which
+    static constexpr size_t OP_LEN = 20;
+
+    uint32_t boot;          // StallDetector boot counter when it happened
+    uint32_t start_ms;
+    uint32_t duration_ms;   // so far, while OPEN
+    uint8_t subsystem;      // CpuSubsystem
+    uint8_t flags;
+    uint8_t reset_reason;   // esp_reset_reason_t on the device
+    uint8_t reserved;
+    char op[OP_LEN];        // NUL-terminated
+};
+
+// Ring of the most recent records. Plain data so it can be placed in RTC_NOINIT memory.
+struct StallArea {
+    static constexpr size_t RECORDS = 8;
+
+    uint32_t magic;
+    uint32_t boot;
+    uint32_t total;         // stalls recorded since the area was last initialized
+    uint8_t head;           // next slot to write
+    uint8_t count;
+    uint8_t reserved[2];
+    StallRecord records[RECORDS];
+};
+
+// Milliseconds on the clock regions are timed with (millis() on the device)
+uint32_t stallClockMs();
+
+class StallDetector {
+public:
+    static constexpr uint32_t DEFAULT_THRESHOLD_MS = 1000;
+    static constexpr uint32_t SAMPLE_PERIOD_MS = 100;
+    static constexpr size_t MAX_DEPTH = 4;
+
+    // Takes the area (validated, or initialized after a power loss), closes records a
+    // reset left open, starts a new boot and watches the calling task. On the device
+    // it also starts the monitor timer. Returns the number of stalls that ended in a
+    // reset.
+    static size_t begin(uint32_t threshold_ms = DEFAULT_THRESHOLD_MS, StallArea* area = nullptr);
+
+    // Region bookkeeping; StallScope calls these. op must outlive the region (a literal).
+    static void enter(CpuSubsystem s, const char* op);
+    static void exit();
+
+    // Monitor: opens or updates the record of the current region once it is over the
+    // threshold. Safe to call from any task.
+    static void sample();
+
+    static uint32_t thresholdMs() { return threshold_ms_; }
+    static uint32_t boot();
+    static uint32_t total();
+    // Stalls per subsystem since begin()
+    static uint32_t count(CpuSubsystem s);
+    static uint32_t maxMs(CpuSubsystem s);
+
+    // Records in the ring, newest first; false past the end
+    static bool record(size_t i, StallRecord& out);
+
+    // {"threshold_ms":..,"total":..,"subsystems":{"network":{"count":..,"max_ms":..},...},
+    //  "recent":[{"subsystem":..,"op":..,"ms":..,"boots_ago":..,"open":..,"reset":..},...]}
+    static std::string json();
+
+private:
+    static size_t begin_(uint32_t threshold_ms, StallArea* area);
+    static void openRecord(uint8_t s, const char* op, uint32_t start_ms, uint32_t duration_ms, uint8_t flags);
+    static void closeRecord(uint32_t duration_ms);
+
+    struct Region {
+        uint8_t subsystem;
+        const char* op;
+        uint32_t start_ms;
+    };
+
+    static StallArea* area_;
+    static uint32_t threshold_ms_;
+    static Region stack_[MAX_DEPTH];
+    static size_t depth_;           // may exceed MAX_DEPTH; deeper regions are not tracked
+    static int open_slot_;          // record of the current region, -1 if none
+    static uint32_t counts_[(size_t)CpuSubsystem::COUNT];
+    static uint32_t max_ms_[(size_t)CpuSubsystem::COUNT];
+};
+
+// Marks the enclosing block as a blocking region of the loop task.
+class StallScope {
+public:
+    StallScope(CpuSubsystem s, const char* op) { StallDetector::enter(s, op); }
+    ~StallScope() { StallDetector::exit(); }
+    StallScope(const StallScope&) = delete;
+    StallScope& operator=(const StallScope&) = delete;
+};
+
+const char* resetReasonToString(uint8_t reason);
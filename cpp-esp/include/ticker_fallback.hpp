@@ -1,7 +1,7 @@
 #pragma once
 
 // Minimal millis()-based fallback for Ticker if sstaub/Ticker is not available.
-// Provides a tiny subset: constructor, interval(), start(), stop(), update().
+// Provides a tiny subset: constructor, interval(), start(), startWithPhase(), stop(), update().
 
 #ifndef HAS_TICKER_LIB
 #include <Arduino.h>
@@ -16,6 +16,8 @@ public:
     void attach(callback_t cb) { cb_ = cb; }
     void interval(uint32_t ms) { interval_ = ms; }
     void start() { running_ = true; last_ms_ = millis(); }
+    // First callback after phase_ms instead of a full interval, then every interval
+    void startWithPhase(uint32_t phase_ms) { running_ = true; last_ms_ = millis() + phase_ms - interval_; }
     void stop() { running_ = false; }
     void update() { if (!running_ || !cb_) return; uint32_t now = millis(); if ((uint32_t)(now - last_ms_) >= interval_) { last_ms_ = now; cb_(); } }
 
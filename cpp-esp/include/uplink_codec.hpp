@@ -0,0 +1,146 @@
+#pragma once
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Uplink batch format shared by the device and the cloud decoder (app.py).
+//
+// Every batch starts with an 8-byte header (little-endian):
+//   'E' 'W' | version | codec | fidelity | flags | count (u16)
+// followed by a codec-specific body:
+//   RAW        count x [ts u32][reg u8][value f32]
+//   DELTA_Q    [step f32][base_ts u32] then count x [zigzag varint dts][reg u8][zigzag varint dq]
+//              where q = round(value / step), deltas per register
+//   AGGREGATE  [start_ts u32][end_ts u32] then count x [reg u8][n u16][min f32][max f32][mean f32]
+//   HEARTBEAT  [ts u32][backlog u32][lost u32], count = 0
+//   FRAME      count x [ts u32][present u16][value f32 per set bit], count = frames
+//              one polling cycle per frame; bit r of present = register r was read,
+//              values follow in register order (registers 0..15)
+
+enum class UplinkCodec : uint8_t {
+    RAW = 0,
+    DELTA_Q = 1,
+    AGGREGATE = 2,
+    HEARTBEAT = 3,
+    FRAME = 4
+};
+
+// What the cloud received, from best to worst
+enum class Fidelity : uint8_t {
+    FULL = 0,
+    LOSSY = 1,
+    AGGREGATE = 2,
+    HEARTBEAT = 3
+};
+
+const char* fidelityToString(Fidelity fidelity);
+
+constexpr uint8_t UPLINK_BATCH_VERSION = 1;
+constexpr size_t UPLINK_BATCH_HEADER_SIZE = 8;
+constexpr size_t UPLINK_RAW_SAMPLE_SIZE = 9;
+constexpr size_t UPLINK_AGG_ENTRY_SIZE = 15;
+constexpr size_t UPLINK_FRAME_HEADER_SIZE = 6;   // ts + presence bitmap
+constexpr uint8_t UPLINK_FRAME_MAX_REGISTERS = 16;
+
+struct BatchHeader {
+    uint8_t version = UPLINK_BATCH_VERSION;
+    UplinkCodec codec = UplinkCodec::RAW;
+    Fidelity fidelity = Fidelity::FULL;
+    uint8_t flags = 0;
+    uint16_t count = 0;
+};
+
+struct AggregateEntry {
+    uint8_t reg_addr = 0;
+    uint16_t count = 0;
+    float min = 0.0f;
+    float max = 0.0f;
+    float mean = 0.0f;
+};
+
+// Per-register running min/max/mean over a window. Bounded: one slot per register.
+class SampleAggregate {
+public:
+    static constexpr uint8_t MAX_REGISTERS = 16;
+
+    SampleAggregate() { clear(); }
+    void add(const Sample& s);
+    void clear();
+    bool empty() const { return total_ == 0; }
+    uint32_t totalSamples() const { return total_; }
+    uint32_t startTs() const { return start_ts_; }
+    uint32_t endTs() const { return end_ts_; }
+    size_t entries(AggregateEntry* out, size_t max) const;
+
+private:
+    struct Slot { uint32_t n; float min; float max; double sum; };
+    Slot slots_[MAX_REGISTERS];
+    uint32_t total_;
+    uint32_t start_ts_;
+    uint32_t end_ts_;
+};
+
+// Encoders append one complete batch (header + body) to out
+void encodeRawBatch(const Sample* samples, size_t count, std::vector<uint8_t>& out);
+void encodeDeltaQBatch(const Sample* samples, size_t count, float step, std::vector<uint8_t>& out);
+void encodeAggregateBatch(const SampleAggregate& agg, std::vector<uint8_t>& out);
+void encodeHeartbeatBatch(uint32_t ts, uint32_t backlog, uint32_t lost, std::vector<uint8_t>& out);
+// Groups runs of samples that share a timestamp (registers ascending, all < 16) into
+// frames, stopping before the batch would exceed max_bytes. Returns the samples
+// consumed; 0 when the first sample cannot go in a frame or nothing fits.
+size_t encodeFrameBatch(const Sample* samples, size_t count, size_t max_bytes, std::vector<uint8_t>& out);
+
+struct DecodedBatch {
+    BatchHeader header;
+    std::vector<Sample> samples;          // RAW / DELTA_Q / FRAME (expanded in register order)
+    std::vector<AggregateEntry> aggregates;
+    uint32_t start_ts = 0;                // AGGREGATE window, HEARTBEAT ts
+    uint32_t end_ts = 0;
+    uint32_t backlog = 0;                 // HEARTBEAT
+    uint32_t lost = 0;
+};
+
+// Decodes one batch starting at data; consumed is set to its length. False on malformed input.
+bool decodeBatch(const uint8_t* data, size_t len, DecodedBatch& out, size_t& consumed);
+
+// Backlog-driven degradation with hysteresis.
+//
+// Steps down (FULL -> LOSSY -> AGGREGATE -> HEARTBEAT) as soon as the backlog or the
+// run of failed uploads crosses a level's entry threshold, and steps back up one level
+// at a time after recover_successes consecutive good uploads with the backlog below
+// the lower level's exit threshold.
+struct DegradationThresholds {
+    uint32_t lossy_backlog = 128;       // enter LOSSY at this many pending samples
+    uint32_t aggregate_backlog = 384;   // enter AGGREGATE
+    uint32_t aggregate_failures = 3;    // or after this many consecutive failures
+    uint32_t heartbeat_failures = 6;    // enter HEARTBEAT
+    uint32_t recover_successes = 2;     // good uploads before stepping up one level
+    float exit_ratio = 0.5f;            // step up only once backlog < entry threshold * exit_ratio
+};
+
+class DegradationPolicy {
+public:
+    explicit DegradationPolicy(const DegradationThresholds& t = DegradationThresholds());
+
+    Fidelity level() const { return level_; }
+
+    // Re-evaluate with the current backlog (pending samples) before building a batch
+    Fidelity evaluate(uint32_t backlog);
+
+    // Report the outcome of an upload attempt
+    void onUploadResult(bool success);
+
+    uint32_t consecutiveFailures() const { return failures_; }
+    uint32_t transitions() const { return transitions_; }
+
+private:
+    DegradationThresholds t_;
+    Fidelity level_ = Fidelity::FULL;
+    uint32_t failures_ = 0;
+    uint32_t successes_ = 0;
+    uint32_t transitions_ = 0;
+
+    Fidelity targetFor(uint32_t backlog) const;
+    bool canRecoverTo(Fidelity better, uint32_t backlog) const;
+};
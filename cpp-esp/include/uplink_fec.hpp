@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Forward error correction for bulk upload chunks.
+//
+// Consecutive chunks of a cycle form a group of k data shards. Parity shards are
+// Reed-Solomon over GF(2^8) with a Cauchy matrix (systematic: data shards go out as
+// they are), so the server can rebuild the group from any k of its shards. Each shard
+// is one secured POST whose payload starts with a 12-byte header:
+//   "FC" | version u8 | k u8 | index u8 | rsv u8 | shard_len u16 | group u32
+// index < k is data shard index, otherwise parity row index - k. A data shard is
+// its length (u16) followed by the chunk; shard_len is the longest of these in the
+// group, and shorter ones count as zero-padded when parity is computed. Data shards
+// are sent unpadded.
+//
+// The uplink is stop-and-wait, so parity is sent after the data, one shard at a time,
+// until a reply reports the group complete. parityFor() caps how many: enough that
+// the group fails with probability under target_permille at the loss rate measured
+// over recent sends. A lost chunk is repaired by whichever parity shard arrives next.
+// A lost reply costs nothing, because the next reply carries the server's count.
+//
+// A group that is not confirmed is kept as it was sent. The next cycle resends it
+// under the same group ID, k and shard_len, so the server's state for the group
+// absorbs the shards it already has. A new ID would make it ingest them again.
+
+namespace gf256 {
+uint8_t mul(uint8_t a, uint8_t b);
+uint8_t inv(uint8_t a);   // a != 0
+// dst[i] ^= c * src[i]
+void mulAdd(uint8_t* dst, uint8_t c, const uint8_t* src, size_t len);
+}
+
+class ReedSolomon {
+public:
+    static constexpr size_t MAX_SHARDS = 255;
+
+    // Coefficient of data shard i in parity row j
+    static uint8_t coefficient(size_t k, size_t row, size_t i);
+
+    // Parity row `row` of k data shards of len bytes each
+    static void encode(const uint8_t* const* data, size_t k, size_t len, size_t row, uint8_t* parity);
+
+    // shards[0..total) of len bytes, present[i] marks the ones received. Missing data
+    // shards are rebuilt in place; false when fewer than k are present.
+    static bool reconstruct(uint8_t* const* shards, const bool* present, size_t k, size_t total, size_t len);
+};
+
+struct FecShardHeader {
+    static constexpr size_t SIZE = 12;
+    static constexpr uint8_t VERSION = 1;
+    uint32_t group = 0;
+    uint8_t k = 0;
+    uint8_t index = 0;
+    uint16_t shard_len = 0;
+
+    void write(uint8_t* out) const;
+    static bool parse(const uint8_t* data, size_t len, FecShardHeader& out);
+};
+
+struct FecConfig {
+    uint8_t group = 8;              // data shards per group; 0 = FEC off
+    uint8_t min_parity = 1;
+    uint8_t max_parity = 8;
+    uint16_t target_permille = 10;  // acceptable chance that a group is not rebuilt
+};
+
+// What one POST of a shard came back with
+struct FecReply {
+    bool answered = false;   // any reply from the server (the shard got there)
+    bool complete = false;   // server has the whole group
+    bool stop = false;       // server asked the sender to back off; give up the group
+    uint8_t have = 0;
+};
+
+struct FecStats {
+    uint32_t groups = 0;
+    uint32_t groups_failed = 0;   // parity budget ran out
+    uint32_t groups_resent = 0;   // held groups sent again
+    uint32_t data_sent = 0;
+    uint32_t parity_sent = 0;
+    uint32_t unanswered = 0;
+};
+
+class UplinkFec {
+public:
+    static constexpr size_t MAX_GROUP = 32;
+    static constexpr size_t LEN_SIZE = 2;   // data shard length prefix
+
+    // head is the shard header (and length prefix for data); body follows it
+    using SendFn = std::function<FecReply(const uint8_t* head, size_t head_len, const uint8_t* body, size_t body_len)>;
+
+    explicit UplinkFec(const FecConfig& config = FecConfig(), uint32_t first_group = 1);
+
+    const FecConfig& config() const { return config_; }
+    void setConfig(const FecConfig& config) { config_ = config; }
+    bool enabled() const { return config_.group > 0; }
+
+    // Sends chunks[0..k) as one group, then parity until the server reports it
+    // complete. True once it has; false when the parity budget ran out first or a
+    // reply said stop; the group is then held for resendHeld().
+    bool sendGroup(const uint8_t* const* chunks, const size_t* lens, size_t k, const SendFn& send);
+
+    // The last unconfirmed group, sent again with the same ID: data shards, then parity
+    // rows after the ones already tried. True once complete, which releases it.
+    bool held() const { return held_k_ > 0; }
+    bool resendHeld(const SendFn& send);
+    // Forget the held group (its data went out some other way or not at all)
+    void dropHeld();
+
+    // Parity budget for a group of k at the measured loss rate
+    uint8_t parityFor(size_t k) const;
+
+    // Share of recent sends that got no reply, in per mille
+    uint16_t lossPermille() const { return (uint16_t)(loss_ppm_ / 1000); }
+    void onSend(bool answered);
+
+    const FecStats& stats() const { return stats_; }
+    // {"loss_permille":..,"groups":..,"failed":..,"resent":..,"data":..,"parity":..,"unanswered":..}
+    std::string json() const;
+
+    // "fec":{"group":..,"have":..,"complete":true} in a server reply; false when absent
+    // or for another group
+    static bool parseReply(const std::string& body, uint32_t group, FecReply& out);
+
+private:
+    // Shards of one group, parity from row first_row on; *next_row gets the row after
+    // the last one sent
+    bool sendShards(uint32_t group, const uint8_t* const* chunks, const size_t* lens, size_t k, uint8_t first_row,
+                    uint8_t* next_row, const SendFn& send);
+
+    FecConfig config_;
+    uint32_t next_group_;
+    uint32_t held_group_ = 0;
+    uint8_t held_k_ = 0;
+    uint8_t held_row_ = 0;            // first parity row not yet tried
+    size_t held_lens_[MAX_GROUP];
+    std::vector<uint8_t> held_data_;  // the chunks back to back
+    uint32_t loss_ppm_ = 50000;   // 5 % until measured
+    FecStats stats_;
+    std::vector<uint8_t> parity_;
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Uplink priority lanes.
+//
+// URGENT     alarms, command results, config acks - sent as soon as the uplink loop runs
+// EVENT      burst captures and other events - piggy-backed on the next outgoing request
+// BULK       periodic telemetry - not queued here, fills whatever budget is left per cycle
+// BACKGROUND diagnostics - weighted against EVENT so it is never starved
+
+enum class UplinkLane : uint8_t {
+    URGENT = 0,
+    EVENT = 1,
+    BULK = 2,
+    BACKGROUND = 3
+};
+
+constexpr size_t UPLINK_LANE_COUNT = 4;
+
+const char* uplinkLaneToString(UplinkLane lane);
+
+struct UplinkItem {
+    UplinkLane lane = UplinkLane::EVENT;
+    std::string endpoint;   // empty: batched into the shared events endpoint
+    std::string body;       // JSON document
+    uint32_t enqueued_ms = 0;
+    uint8_t attempts = 0;
+};
+
+struct UplinkLaneStats {
+    uint32_t enqueued = 0;
+    uint32_t sent = 0;
+    uint32_t dropped = 0;      // lane full, or retries exhausted
+    uint32_t requeued = 0;
+    uint32_t last_delay_ms = 0;
+    uint32_t max_delay_ms = 0;
+    uint64_t total_delay_ms = 0;
+
+    uint32_t avgDelayMs() const { return sent ? (uint32_t)(total_delay_ms / sent) : 0; }
+};
+
+class UplinkLanes {
+public:
+    UplinkLanes(size_t urgent_capacity = 8, size_t event_capacity = 16, size_t background_capacity = 16);
+
+    // Queue an item. When a lane is full the oldest item is dropped to make room
+    // (newest alarm/state wins). BULK cannot be queued.
+    bool enqueue(UplinkLane lane, const std::string& endpoint, const std::string& body, uint32_t now_ms);
+
+    // Pop the next item at or above lowest_lane. URGENT is strict priority; EVENT and
+    // BACKGROUND share by weight (one BACKGROUND item per background_weight EVENT items).
+    bool pop(UplinkItem& out, UplinkLane lowest_lane = UplinkLane::BACKGROUND);
+
+    // Put a failed item back at the head of its lane; dropped after max_attempts
+    void requeue(const UplinkItem& item);
+
+    // Record queueing delay for a delivered item
+    void recordSent(const UplinkItem& item, uint32_t now_ms);
+
+    // Bulk telemetry is not queued here; the packetizer reports age of the oldest sample it sent
+    void recordBulk(uint32_t delay_ms);
+
+    bool hasPending(UplinkLane lane) const;
+    size_t pending(UplinkLane lane) const;
+    size_t pendingBytes(UplinkLane lane) const;
+
+    void setBackgroundWeight(uint8_t weight) { background_weight_ = weight ? weight : 1; }
+    void setMaxAttempts(uint8_t attempts) { max_attempts_ = attempts ? attempts : 1; }
+
+    const UplinkLaneStats& stats(UplinkLane lane) const { return stats_[(size_t)lane]; }
+
+    // {"urgent":{"sent":..,"dropped":..,"avg_delay_ms":..,"max_delay_ms":..,"pending":..},...}
+    std::string statsJson() const;
+
+private:
+    std::deque<UplinkItem> queues_[UPLINK_LANE_COUNT];
+    size_t capacity_[UPLINK_LANE_COUNT];
+    UplinkLaneStats stats_[UPLINK_LANE_COUNT];
+    uint8_t background_weight_ = 4;
+    uint8_t events_since_background_ = 0;
+    uint8_t max_attempts_ = 5;
+
+    bool popFrom(UplinkLane lane, UplinkItem& out);
+    void recordDelay(UplinkLane lane, uint32_t delay_ms);
+};
@@ -3,6 +3,16 @@
 #include "data_storage.hpp"
 #include "http_client.hpp"
 #include "secure_http_client.hpp"
+#include "uplink_lanes.hpp"
+#include "uplink_codec.hpp"
+#include "flow_control.hpp"
+#include "flush_trigger.hpp"
+#include "cpu_accounting.hpp"
+#include "io_buf.hpp"
+#include "device_shadow.hpp"
+#include "hedge_policy.hpp"
+#include "uplink_fec.hpp"
+#include <vector>
 
 class EcoHttpClient;
 class SecureHttpClient;
@@ -14,24 +24,101 @@ public:
     UplinkPacketizer(DataStorage* storage, SecureHttpClient* secure_http);
     ~UplinkPacketizer();
 
+    // Uploads when a FlushTrigger fires; interval_ms is the latency bound (max age of
+    // the oldest unsent sample). The first check is offset by a phase derived from the
+    // device ID (see setDeviceId).
     void begin(uint32_t interval_ms = 60000);
     void end();
          void setCloudEndpoint(const std::string& url);
     void loop();
 
+    // Seeds the fleet phase offset and Retry-After jitter
+    void setDeviceId(const std::string& device_id) { deviceId_ = device_id; }
+
+    // Queue a message on a priority lane. Items without an endpoint are batched
+    // into one envelope for <cloud>/events; others keep their own endpoint.
+    bool enqueue(UplinkLane lane, const std::string& body, const std::string& endpoint = "");
+
+    // Bytes per upload cycle shared by queued lanes and bulk telemetry
+    void setUplinkBudget(size_t bytes) { uplinkBudget_ = bytes; }
+    const UplinkLanes& lanes() const { return lanes_; }
+
+    // Device shadow whose delta rides on the event batches (see device_shadow.hpp)
+    void setShadow(DeviceShadow* shadow) { shadow_ = shadow; }
+
+    // Inverter client whose round-trip estimators are reported with the cloud client's
+    void setInverterHttp(const EcoHttpClient* http) { inverter_http_ = http; }
+
+    // Hedged Modbus TCP reads, reported when on (see hedge_policy.hpp)
+    void setHedgePolicy(const HedgePolicy* policy) { hedge_policy_ = policy; }
+
+    // Send bulk chunks in Reed-Solomon groups instead of retrying each one (see
+    // uplink_fec.hpp); config.group = 0 turns it off. The server must know the shards.
+    void setFec(const FecConfig& config);
+    const UplinkFec& fec() const { return fec_; }
+
+    // Graceful degradation under backlog (see DegradationPolicy)
+    Fidelity fidelity() const { return policy_.level(); }
+    uint32_t lostSamples() const { return lost_; }
+    void setLossyStep(float step) { lossyStep_ = step; }
+
+    // Size / age targets for flushing, adjustable at runtime (remote config)
+    void setFlushTargets(const FlushTargets& targets);
+    const FlushTrigger& flushTrigger() const { return trigger_; }
+
 private:
-    bool drainOutbox_();
-    Ticker uploadTicker_;
-    uint32_t uploadInterval_ = 60000;
+    size_t drainOutbox_(UplinkLane lowest_lane, size_t budget_bytes);
+    size_t flushEventBatch_(std::vector<UplinkItem>& batch);
+    UplinkLanes lanes_;
+    size_t uplinkBudget_ = 1024 * 9;   // 1024 raw samples when no events are queued
+    uint32_t drainBackoffUntil_ = 0;   // after a failed send, urgent retries wait until this time
+    Ticker uploadTicker_;              // trigger checks, every TRIGGER_CHECK_MS
+    static constexpr uint32_t TRIGGER_CHECK_MS = 1000;
+    FlushTrigger trigger_;
+    TaskRuntimeMonitor cpuTasks_;      // per-task run time between metadata uploads
          std::string cloudUrl_;
     bool running_ = false;
     DataStorage* storage_ = nullptr;
     SecureHttpClient* secure_http_ = nullptr;
-    void uploadTask();
+    DeviceShadow* shadow_ = nullptr;
+    const EcoHttpClient* inverter_http_ = nullptr;
+    const HedgePolicy* hedge_policy_ = nullptr;
+    void flushIfDue_(bool urgent);
+    bool uploadTask();
     static void uploadTaskWrapper();
     static UplinkPacketizer* instance_;
-    void compressData(const Sample* samples, size_t sampleCount, char* outBuf, size_t outBufSize, size_t& outLen);
-    void encryptData(const char* inBuf, size_t inLen, char* outBuf, size_t outBufSize, size_t& outLen);
-    void computeMAC(const char* inBuf, size_t inLen, char* outBuf, size_t outBufSize, size_t& outLen);
-    bool chunkAndUpload(const char* data, size_t len);
+
+    // One encoded batch within a cycle's payload
+    struct PendingBatch {
+        size_t offset;
+        size_t len;
+        uint32_t end_seq;   // cursor after this batch is delivered
+        bool aggregate;     // carries outage_; cleared on delivery
+    };
+    static constexpr size_t CHUNK = 1024;
+    static constexpr size_t DELTA_SAMPLES_PER_BATCH = 80;  // worst case 11 bytes/sample
+
+    DegradationPolicy policy_;
+    Fidelity lastLevel_ = Fidelity::FULL;
+    SampleAggregate outage_;     // samples folded out of the ring while the link is behind
+    uint32_t cursor_ = 0;        // DataStorage sequence delivered up to; advances only on delivery
+    uint32_t lost_ = 0;          // samples overwritten before they could be folded or sent
+    float lossyStep_ = 0.5f;
+
+    std::string deviceId_;
+    FlowControl flow_;           // server Retry-After / X-Next-Interval hints
+    IoBufPool bufPool_{2048, 4}; // envelope blocks; a 1 KB chunk's envelope fits in one
+    void applyFlowHints_(const EcoHttpResponse& resp);
+    UplinkFec fec_;              // off until setFec()
+    // Sequence range of the group fec_ holds after a failure, resent before anything else
+    uint32_t fecHeldFrom_ = 0;
+    uint32_t fecHeldTo_ = 0;
+    bool fecHeldAggregate_ = false;
+    uint32_t fecHeldOutage_ = 0; // outage_ samples the held aggregate covers
+    bool chunkAndUploadFec_(const uint8_t* data, const std::vector<PendingBatch>& batches);
+    static size_t packChunk_(const std::vector<PendingBatch>& batches, size_t first);
+    void delivered_(const std::vector<PendingBatch>& batches, size_t first, size_t end);
+
+    void foldBacklog_(uint32_t keep);
+    bool chunkAndUpload(const uint8_t* data, const std::vector<PendingBatch>& batches);
 };
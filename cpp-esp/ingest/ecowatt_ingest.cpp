@@ -0,0 +1,79 @@
+#include "ecowatt_ingest.h"
+#include "ingest_decoder.hpp"
+#include <cstring>
+#include <new>
+
+struct ew_ingest {
+    IngestDecoder decoder;
+    ew_ingest(const uint8_t* key, size_t key_len, unsigned threads) : decoder(key, key_len, threads) {}
+};
+
+// Copies one upload's samples out, or marks it NO_ROOM
+static int deliver(const std::vector<ew_sample>& decoded, ew_sample* samples, size_t capacity,
+                   ew_ingest_result* result) {
+    if (result->status != EW_INGEST_OK) return result->status;
+    if (decoded.size() > capacity) {
+        result->sample_count = 0;
+        return result->status = EW_INGEST_NO_ROOM;
+    }
+    if (!decoded.empty()) memcpy(samples, decoded.data(), decoded.size() * sizeof(ew_sample));
+    result->sample_offset = 0;
+    return EW_INGEST_OK;
+}
+
+extern "C" {
+
+ew_ingest* ew_ingest_create(const uint8_t* key, size_t key_len, unsigned threads) {
+    if (!key || key_len == 0) return nullptr;
+    return new (std::nothrow) ew_ingest(key, key_len, threads);
+}
+
+void ew_ingest_destroy(ew_ingest* ingest) { delete ingest; }
+
+unsigned ew_ingest_threads(const ew_ingest* ingest) { return ingest ? ingest->decoder.threads() : 0; }
+
+size_t ew_ingest_sample_bound(size_t body_len) {
+    // The smallest record is a DELTA_Q sample: one-byte varint, register, one-byte varint
+    return body_len / 3 + 1;
+}
+
+int ew_ingest_envelope(ew_ingest* ingest, const char* body, size_t len,
+                       ew_sample* samples, size_t capacity, ew_ingest_result* result) {
+    if (!ingest || !body || !result) return EW_INGEST_BAD_ENVELOPE;
+    std::vector<ew_sample> decoded;
+    ingest->decoder.decodeEnvelope(body, len, decoded, *result);
+    return deliver(decoded, samples, capacity, result);
+}
+
+int ew_ingest_payload(ew_ingest* ingest, const uint8_t* data, size_t len,
+                      ew_sample* samples, size_t capacity, ew_ingest_result* result) {
+    if (!ingest || !data || !result) return EW_INGEST_BAD_BATCH;
+    std::vector<ew_sample> decoded;
+    ingest->decoder.decodePayload(data, len, decoded, *result);
+    return deliver(decoded, samples, capacity, result);
+}
+
+size_t ew_ingest_envelopes(ew_ingest* ingest, const char* const* bodies, const size_t* lens, size_t count,
+                           ew_sample* samples, size_t capacity, ew_ingest_result* results) {
+    if (!ingest || !bodies || !lens || !results) return 0;
+    std::vector<ew_sample> decoded;
+    ingest->decoder.decodeEnvelopes(bodies, lens, count, decoded, results);
+
+    // Whole uploads only: one that does not fit is marked and skipped
+    size_t written = 0;
+    for (size_t i = 0; i < count; ++i) {
+        ew_ingest_result& r = results[i];
+        if (r.status != EW_INGEST_OK) continue;
+        if (written + r.sample_count > capacity) {
+            r.status = EW_INGEST_NO_ROOM;
+            r.sample_count = 0;
+            continue;
+        }
+        if (r.sample_count) memcpy(samples + written, decoded.data() + r.sample_offset, r.sample_count * sizeof(ew_sample));
+        r.sample_offset = (uint32_t)written;
+        written += r.sample_count;
+    }
+    return written;
+}
+
+}
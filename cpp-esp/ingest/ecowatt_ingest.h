@@ -0,0 +1,83 @@
+#ifndef ECOWATT_INGEST_H
+#define ECOWATT_INGEST_H
+
+/*
+ * C ABI of the native upload decoder, for the cloud ingest (app.py loads it through
+ * ctypes, see ingest_native.py). One call verifies a secured envelope, base64-decodes
+ * its payload and decodes the 'EW' batches in it; ew_ingest_envelopes() spreads many
+ * envelopes over the decoder's thread pool.
+ *
+ * Every function is safe to call from several threads on the same handle.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EW_INGEST_OK            0
+#define EW_INGEST_BAD_ENVELOPE  1   /* not a flat {"nonce","timestamp","encrypted","payload","mac"} object */
+#define EW_INGEST_BAD_MAC       2
+#define EW_INGEST_BAD_BASE64    3
+#define EW_INGEST_BAD_BATCH     4
+#define EW_INGEST_NO_ROOM       5   /* sample buffer too small; nothing written for this upload */
+
+#define EW_SAMPLE_READING       0
+#define EW_SAMPLE_AGGREGATE     1   /* window mean at the window end, standing in for unsent samples */
+
+/* 12 bytes, Python struct format '<IfBB2x' */
+typedef struct {
+    uint32_t timestamp;
+    float value;
+    uint8_t reg_addr;
+    uint8_t kind;
+    uint16_t reserved;
+} ew_sample;
+
+typedef struct {
+    int32_t status;
+    uint32_t nonce;           /* envelope fields (0 for bare payloads) */
+    uint32_t timestamp;
+    uint8_t encrypted;
+    uint8_t fidelity;         /* worst Fidelity over the batches (0 full .. 3 heartbeat) */
+    uint8_t has_heartbeat;
+    uint8_t legacy;           /* bare 9-byte samples without a batch header */
+    uint32_t heartbeat_ts;    /* last HEARTBEAT batch */
+    uint32_t backlog;
+    uint32_t lost;
+    uint32_t batches;
+    uint32_t payload_bytes;   /* decoded binary payload */
+    uint32_t sample_offset;   /* first sample of this upload in the caller's buffer */
+    uint32_t sample_count;
+} ew_ingest_result;
+
+typedef struct ew_ingest ew_ingest;
+
+/* threads: 0 = one per core, 1 = no pool (ew_ingest_envelopes runs on the caller) */
+ew_ingest* ew_ingest_create(const uint8_t* key, size_t key_len, unsigned threads);
+void ew_ingest_destroy(ew_ingest* ingest);
+unsigned ew_ingest_threads(const ew_ingest* ingest);
+
+/* Upper bound on the samples a body of body_len bytes (envelope or bare payload) can hold */
+size_t ew_ingest_sample_bound(size_t body_len);
+
+/* One secured envelope; returns result->status */
+int ew_ingest_envelope(ew_ingest* ingest, const char* body, size_t len,
+                       ew_sample* samples, size_t capacity, ew_ingest_result* result);
+
+/* One binary payload that arrived without an envelope */
+int ew_ingest_payload(ew_ingest* ingest, const uint8_t* data, size_t len,
+                      ew_sample* samples, size_t capacity, ew_ingest_result* result);
+
+/* count envelopes in parallel; samples are written in envelope order and results[i]
+ * says where each upload's samples are. Returns the number of samples written. */
+size_t ew_ingest_envelopes(ew_ingest* ingest, const char* const* bodies, const size_t* lens, size_t count,
+                           ew_sample* samples, size_t capacity, ew_ingest_result* results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
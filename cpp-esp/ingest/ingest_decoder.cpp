@@ -0,0 +1,309 @@
+#include "ingest_decoder.hpp"
+#include "uplink_codec.hpp"
+#include <cstring>
+
+// ---------- IngestPool ----------
+
+IngestPool::IngestPool(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+    for (unsigned i = 1; i < threads; ++i) workers_.emplace_back(&IngestPool::worker, this);
+}
+
+IngestPool::~IngestPool() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) t.join();
+}
+
+void IngestPool::drain() {
+    for (size_t i = next_.fetch_add(1); i < count_; i = next_.fetch_add(1)) (*job_)(i);
+}
+
+void IngestPool::worker() {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+        }
+        drain();
+        std::lock_guard<std::mutex> lock(mu_);
+        if (--active_ == 0) done_.notify_one();
+    }
+}
+
+void IngestPool::run(size_t count, const std::function<void(size_t)>& fn) {
+    std::lock_guard<std::mutex> serial(run_mu_);
+    if (workers_.empty() || count < 2) {
+        for (size_t i = 0; i < count; ++i) fn(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        job_ = &fn;
+        count_ = count;
+        next_ = 0;
+        active_ = workers_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+    drain();
+    // Workers still hold job_ until they check in
+    std::unique_lock<std::mutex> lock(mu_);
+    done_.wait(lock, [&] { return active_ == 0; });
+    job_ = nullptr;
+}
+
+// ---------- Envelope ----------
+
+namespace {
+
+struct Field {
+    const char* text = nullptr;
+    size_t len = 0;
+};
+
+// The flat object SecurityLayer / sealEnvelope produce. Strings may not contain
+// escapes (base64 and hex never need them); anything nested is rejected.
+struct Envelope {
+    Field nonce, timestamp, payload, mac;
+    bool encrypted = false;
+};
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+bool parseEnvelope(const char* p, size_t len, Envelope& env) {
+    const char* end = p + len;
+    auto skip = [&] { while (p < end && isSpace(*p)) ++p; };
+    auto string = [&](Field& f) {
+        if (p >= end || *p != '"') return false;
+        const char* s = ++p;
+        while (p < end && *p != '"') {
+            if (*p == '\\') return false;
+            ++p;
+        }
+        if (p >= end) return false;
+        f.text = s;
+        f.len = (size_t)(p++ - s);
+        return true;
+    };
+    auto literal = [&](const char* word) {
+        size_t n = strlen(word);
+        if ((size_t)(end - p) < n || memcmp(p, word, n) != 0) return false;
+        p += n;
+        return true;
+    };
+    auto key = [](const Field& f, const char* name) { return f.len == strlen(name) && memcmp(f.text, name, f.len) == 0; };
+
+    bool seen_nonce = false, seen_payload = false, seen_mac = false;
+    skip();
+    if (p >= end || *p++ != '{') return false;
+    skip();
+    if (p < end && *p == '}') return false;
+    for (;;) {
+        Field name;
+        skip();
+        if (!string(name)) return false;
+        skip();
+        if (p >= end || *p++ != ':') return false;
+        skip();
+        if (p >= end) return false;
+        if (key(name, "payload")) {
+            if (!string(env.payload)) return false;
+            seen_payload = true;
+        } else if (key(name, "mac")) {
+            if (!string(env.mac)) return false;
+            seen_mac = true;
+        } else if (key(name, "encrypted")) {
+            if (literal("true")) env.encrypted = true;
+            else if (literal("false")) env.encrypted = false;
+            else return false;
+        } else if (key(name, "nonce") || key(name, "timestamp")) {
+            // Unsigned integers only: the MAC covers their decimal text
+            bool is_nonce = key(name, "nonce");
+            Field& f = is_nonce ? env.nonce : env.timestamp;
+            f.text = p;
+            while (p < end && *p >= '0' && *p <= '9') ++p;
+            f.len = (size_t)(p - f.text);
+            if (f.len == 0 || f.len > 10) return false;
+            if (is_nonce) seen_nonce = true;
+        } else if (*p == '"') {
+            Field ignored;
+            if (!string(ignored)) return false;
+        } else if (!literal("true") && !literal("false") && !literal("null")) {
+            const char* s = p;
+            while (p < end && *p && strchr("0123456789+-.eE", *p)) ++p;
+            if (p == s) return false;
+        }
+        skip();
+        if (p >= end) return false;
+        if (*p == ',') {
+            ++p;
+            continue;
+        }
+        if (*p++ != '}') return false;
+        break;
+    }
+    skip();
+    return p == end && seen_nonce && seen_payload && seen_mac;
+}
+
+bool parseU32(const Field& f, uint32_t& out) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < f.len; ++i) v = v * 10 + (uint64_t)(f.text[i] - '0');
+    if (v > 0xFFFFFFFFull) return false;
+    out = (uint32_t)v;
+    return true;
+}
+
+// Appends the upload's samples; on failure the samples vector is left as it was
+int decodeInto(const uint8_t* data, size_t len, std::vector<ew_sample>& samples, ew_ingest_result& result) {
+    size_t start = samples.size();
+    result.payload_bytes = (uint32_t)len;
+    if (len >= 2 && data[0] == 'E' && data[1] == 'W') {
+        DecodedBatch batch;
+        size_t pos = 0;
+        while (pos + UPLINK_BATCH_HEADER_SIZE <= len) {
+            size_t consumed = 0;
+            if (!decodeBatch(data + pos, len - pos, batch, consumed)) {
+                samples.resize(start);
+                return result.status = EW_INGEST_BAD_BATCH;
+            }
+            pos += consumed;
+            result.batches++;
+            if ((uint8_t)batch.header.fidelity > result.fidelity) result.fidelity = (uint8_t)batch.header.fidelity;
+            for (const Sample& s : batch.samples) {
+                samples.push_back(ew_sample{s.timestamp, s.value, s.reg_addr, EW_SAMPLE_READING, 0});
+            }
+            for (const AggregateEntry& a : batch.aggregates) {
+                samples.push_back(ew_sample{batch.end_ts, a.mean, a.reg_addr, EW_SAMPLE_AGGREGATE, 0});
+            }
+            if (batch.header.codec == UplinkCodec::HEARTBEAT) {
+                result.has_heartbeat = 1;
+                result.heartbeat_ts = batch.start_ts;
+                result.backlog = batch.backlog;
+                result.lost = batch.lost;
+            }
+        }
+    } else {
+        // Firmware before the batch format: bare [ts u32][reg u8][value f32] records
+        result.legacy = 1;
+        for (size_t pos = 0; pos + UPLINK_RAW_SAMPLE_SIZE <= len; pos += UPLINK_RAW_SAMPLE_SIZE) {
+            ew_sample s{0, 0.0f, data[pos + 4], EW_SAMPLE_READING, 0};
+            memcpy(&s.timestamp, data + pos, 4);   // little-endian host
+            memcpy(&s.value, data + pos + 5, 4);
+            samples.push_back(s);
+        }
+    }
+    result.sample_offset = (uint32_t)start;
+    result.sample_count = (uint32_t)(samples.size() - start);
+    return result.status = EW_INGEST_OK;
+}
+
+const int8_t* base64Table() {
+    static int8_t table[256];
+    static bool built = [] {
+        memset(table, -1, sizeof(table));
+        const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; ++i) table[(uint8_t)alphabet[i]] = (int8_t)i;
+        return true;
+    }();
+    (void)built;
+    return table;
+}
+
+}  // namespace
+
+bool base64DecodeTo(const char* text, size_t len, std::vector<uint8_t>& out) {
+    out.clear();
+    if (len % 4 != 0) return false;
+    const int8_t* t = base64Table();
+    out.reserve(len / 4 * 3);
+    for (size_t i = 0; i < len; i += 4) {
+        const uint8_t* q = (const uint8_t*)text + i;
+        int8_t a = t[q[0]], b = t[q[1]], c = t[q[2]], d = t[q[3]];
+        bool last = i + 4 == len;
+        if (a < 0 || b < 0) return false;
+        if (last && q[2] == '=' && q[3] == '=') {
+            out.push_back((uint8_t)(a << 2 | b >> 4));
+            return true;
+        }
+        if (c < 0) return false;
+        if (last && q[3] == '=') {
+            out.push_back((uint8_t)(a << 2 | b >> 4));
+            out.push_back((uint8_t)(b << 4 | c >> 2));
+            return true;
+        }
+        if (d < 0) return false;
+        out.push_back((uint8_t)(a << 2 | b >> 4));
+        out.push_back((uint8_t)(b << 4 | c >> 2));
+        out.push_back((uint8_t)(c << 6 | d));
+    }
+    return true;
+}
+
+// ---------- IngestDecoder ----------
+
+IngestDecoder::IngestDecoder(const uint8_t* key, size_t key_len, unsigned threads)
+    : hmac_(key, key_len), pool_(threads) {}
+
+int IngestDecoder::decodePayload(const uint8_t* data, size_t len, std::vector<ew_sample>& samples,
+                                 ew_ingest_result& result) const {
+    result = ew_ingest_result();
+    return decodeInto(data, len, samples, result);
+}
+
+int IngestDecoder::decodeEnvelope(const char* body, size_t len, std::vector<ew_sample>& samples,
+                                  ew_ingest_result& result) const {
+    result = ew_ingest_result();
+    Envelope env;
+    if (!parseEnvelope(body, len, env) || !parseU32(env.nonce, result.nonce) ||
+        (env.timestamp.len && !parseU32(env.timestamp, result.timestamp))) {
+        return result.status = EW_INGEST_BAD_ENVELOPE;
+    }
+    result.encrypted = env.encrypted ? 1 : 0;
+
+    // Same input as the device: nonce | timestamp | flag | base64 text (timestamp defaults to 0)
+    HmacSha256 hmac = hmac_;
+    hmac.begin();
+    hmac.update((const uint8_t*)env.nonce.text, env.nonce.len);
+    if (env.timestamp.len) hmac.update((const uint8_t*)env.timestamp.text, env.timestamp.len);
+    else hmac.update((const uint8_t*)"0", 1);
+    hmac.update((const uint8_t*)(env.encrypted ? "1" : "0"), 1);
+    hmac.update((const uint8_t*)env.payload.text, env.payload.len);
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    hmac.finish(mac);
+
+    static const char hex[] = "0123456789abcdef";
+    if (env.mac.len != 2 * SHA256_DIGEST_SIZE) return result.status = EW_INGEST_BAD_MAC;
+    uint8_t diff = 0;   // constant time, like hmac.compare_digest
+    for (size_t k = 0; k < SHA256_DIGEST_SIZE; ++k) {
+        diff |= (uint8_t)(env.mac.text[2 * k] ^ hex[mac[k] >> 4]);
+        diff |= (uint8_t)(env.mac.text[2 * k + 1] ^ hex[mac[k] & 0x0F]);
+    }
+    if (diff) return result.status = EW_INGEST_BAD_MAC;
+
+    static thread_local std::vector<uint8_t> payload;
+    if (!base64DecodeTo(env.payload.text, env.payload.len, payload)) return result.status = EW_INGEST_BAD_BASE64;
+    return decodeInto(payload.data(), payload.size(), samples, result);
+}
+
+void IngestDecoder::decodeEnvelopes(const char* const* bodies, const size_t* lens, size_t count,
+                                    std::vector<ew_sample>& samples, ew_ingest_result* results) {
+    std::vector<std::vector<ew_sample>> per(count);
+    pool_.run(count, [&](size_t i) { decodeEnvelope(bodies[i], lens[i], per[i], results[i]); });
+
+    size_t total = samples.size();
+    for (const auto& v : per) total += v.size();
+    samples.reserve(total);
+    for (size_t i = 0; i < count; ++i) {
+        results[i].sample_offset = (uint32_t)samples.size();
+        samples.insert(samples.end(), per[i].begin(), per[i].end());
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "ecowatt_ingest.h"
+#include "sha256_engine.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Cloud-side decoder for device uploads.
+//
+// Undoes what the device does on the way out, with the same code: the envelope MAC is
+// checked with sha256_engine (nonce | timestamp | flag | base64 text, as in
+// secure_envelope.hpp) and the batches are decoded with uplink_codec's decodeBatch.
+// Host only (threads); it is not part of the firmware image.
+
+// Fixed set of workers; run() hands out indices until count is reached. The caller
+// works too, so a pool of N threads has N - 1 workers.
+class IngestPool {
+public:
+    explicit IngestPool(unsigned threads);
+    ~IngestPool();
+    IngestPool(const IngestPool&) = delete;
+    IngestPool& operator=(const IngestPool&) = delete;
+
+    void run(size_t count, const std::function<void(size_t)>& fn);
+    unsigned threads() const { return (unsigned)workers_.size() + 1; }
+
+private:
+    void worker();
+    void drain();
+
+    std::vector<std::thread> workers_;
+    std::mutex run_mu_;   // one run() at a time
+    std::mutex mu_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(size_t)>* job_ = nullptr;
+    size_t count_ = 0;
+    std::atomic<size_t> next_{0};
+    size_t active_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
+
+class IngestDecoder {
+public:
+    // threads: 0 = one per core, 1 = no pool
+    IngestDecoder(const uint8_t* key, size_t key_len, unsigned threads = 0);
+
+    // Verify one envelope and append its samples; returns result.status
+    int decodeEnvelope(const char* body, size_t len, std::vector<ew_sample>& samples,
+                       ew_ingest_result& result) const;
+    // Payload already out of its envelope (or sent without one)
+    int decodePayload(const uint8_t* data, size_t len, std::vector<ew_sample>& samples,
+                      ew_ingest_result& result) const;
+
+    // Many envelopes across the pool; samples are in envelope order and
+    // results[i].sample_offset / sample_count index into them
+    void decodeEnvelopes(const char* const* bodies, const size_t* lens, size_t count,
+                         std::vector<ew_sample>& samples, ew_ingest_result* results);
+
+    unsigned threads() const { return pool_.threads(); }
+
+private:
+    HmacSha256 hmac_;     // key pads absorbed; copied per call
+    IngestPool pool_;
+};
+
+// Strict RFC 4648 base64 (padding required); false on anything else
+bool base64DecodeTo(const char* text, size_t len, std::vector<uint8_t>& out);
@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""
+ctypes binding for the native upload decoder (ingest/ecowatt_ingest.h).
+
+The library verifies the secured envelope, base64-decodes the payload and decodes
+the uplink batches with the same C++ the firmware uses, outside the GIL. app.py uses
+it when it is built and falls back to its Python decoder otherwise.
+
+Build:
+    cmake -S ingest -B ingest/build && cmake --build ingest/build
+
+The library is looked up in $ECOWATT_INGEST_LIB, then ingest/build/.
+
+Usage (quick check against a recorded envelope):
+    python ingest_native.py envelope.json
+"""
+import argparse
+import ctypes
+import os
+import struct
+import sys
+from pathlib import Path
+
+OK, BAD_ENVELOPE, BAD_MAC, BAD_BASE64, BAD_BATCH, NO_ROOM = range(6)
+STATUS_NAMES = ['ok', 'bad_envelope', 'bad_mac', 'bad_base64', 'bad_batch', 'no_room']
+FIDELITY_NAMES = ['full', 'lossy', 'aggregate', 'heartbeat']
+SAMPLE_AGGREGATE = 1
+
+SAMPLE_FORMAT = struct.Struct('<IfBB2x')  # ew_sample: (timestamp, value, reg_addr, kind)
+
+
+class Result(ctypes.Structure):
+    _fields_ = [
+        ('status', ctypes.c_int32),
+        ('nonce', ctypes.c_uint32),
+        ('timestamp', ctypes.c_uint32),
+        ('encrypted', ctypes.c_uint8),
+        ('fidelity', ctypes.c_uint8),
+        ('has_heartbeat', ctypes.c_uint8),
+        ('legacy', ctypes.c_uint8),
+        ('heartbeat_ts', ctypes.c_uint32),
+        ('backlog', ctypes.c_uint32),
+        ('lost', ctypes.c_uint32),
+        ('batches', ctypes.c_uint32),
+        ('payload_bytes', ctypes.c_uint32),
+        ('sample_offset', ctypes.c_uint32),
+        ('sample_count', ctypes.c_uint32),
+    ]
+
+
+class Upload:
+    """One decoded upload: status, envelope fields and (timestamp, value, reg_addr, kind) samples."""
+
+    def __init__(self, result, samples):
+        self.status = result.status
+        self.nonce = result.nonce
+        self.timestamp = result.timestamp
+        self.encrypted = bool(result.encrypted)
+        self.fidelity = FIDELITY_NAMES[result.fidelity] if result.fidelity < 4 else 'unknown'
+        self.heartbeat = None
+        if result.has_heartbeat:
+            self.heartbeat = {'ts': result.heartbeat_ts, 'backlog': result.backlog, 'lost': result.lost}
+        self.legacy = bool(result.legacy)
+        self.batches = result.batches
+        self.payload_bytes = result.payload_bytes
+        self.samples = samples
+
+    @property
+    def ok(self):
+        return self.status == OK
+
+
+def _library_path(path=None):
+    if path:
+        return Path(path)
+    if os.environ.get('ECOWATT_INGEST_LIB'):
+        return Path(os.environ['ECOWATT_INGEST_LIB'])
+    build = Path(__file__).resolve().parent / 'ingest' / 'build'
+    for name in ('libecowatt_ingest.so', 'libecowatt_ingest.dylib', 'ecowatt_ingest.dll',
+                 'Release/ecowatt_ingest.dll'):
+        if (build / name).exists():
+            return build / name
+    return None
+
+
+class NativeIngest:
+    def __init__(self, key: bytes, threads=0, lib_path=None):
+        path = _library_path(lib_path)
+        if path is None:
+            raise OSError('ecowatt_ingest library not built (see ingest/CMakeLists.txt)')
+        lib = ctypes.CDLL(str(path))
+        lib.ew_ingest_create.restype = ctypes.c_void_p
+        lib.ew_ingest_create.argtypes = [ctypes.c_char_p, ctypes.c_size_t, ctypes.c_uint]
+        lib.ew_ingest_destroy.argtypes = [ctypes.c_void_p]
+        lib.ew_ingest_threads.restype = ctypes.c_uint
+        lib.ew_ingest_threads.argtypes = [ctypes.c_void_p]
+        lib.ew_ingest_sample_bound.restype = ctypes.c_size_t
+        lib.ew_ingest_sample_bound.argtypes = [ctypes.c_size_t]
+        for fn in (lib.ew_ingest_envelope, lib.ew_ingest_payload):
+            fn.restype = ctypes.c_int
+            fn.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t,
+                           ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(Result)]
+        lib.ew_ingest_envelopes.restype = ctypes.c_size_t
+        lib.ew_ingest_envelopes.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_char_p),
+                                            ctypes.POINTER(ctypes.c_size_t), ctypes.c_size_t,
+                                            ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(Result)]
+        self._lib = lib
+        self._handle = lib.ew_ingest_create(key, len(key), threads)
+        if not self._handle:
+            raise OSError('ew_ingest_create failed')
+
+    def __del__(self):
+        if getattr(self, '_handle', None):
+            self._lib.ew_ingest_destroy(self._handle)
+            self._handle = None
+
+    @property
+    def threads(self):
+        return self._lib.ew_ingest_threads(self._handle)
+
+    @staticmethod
+    def _samples(buf, offset, count):
+        return list(SAMPLE_FORMAT.iter_unpack(
+            memoryview(buf)[offset * SAMPLE_FORMAT.size:(offset + count) * SAMPLE_FORMAT.size]))
+
+    def _call(self, fn, data: bytes):
+        capacity = self._lib.ew_ingest_sample_bound(len(data))
+        buf = ctypes.create_string_buffer(capacity * SAMPLE_FORMAT.size)
+        result = Result()
+        fn(self._handle, data, len(data), buf, capacity, ctypes.byref(result))
+        return Upload(result, self._samples(buf, 0, result.sample_count) if result.status == OK else [])
+
+    def decode_envelope(self, body: bytes) -> Upload:
+        """Secured envelope (JSON body of /api/upload) -> Upload."""
+        return self._call(self._lib.ew_ingest_envelope, body)
+
+    def decode_payload(self, data: bytes) -> Upload:
+        """Binary payload sent without an envelope -> Upload."""
+        return self._call(self._lib.ew_ingest_payload, data)
+
+    def decode_envelopes(self, bodies) -> list:
+        """Many envelopes at once, spread over the library's thread pool."""
+        n = len(bodies)
+        arr = (ctypes.c_char_p * n)(*bodies)
+        lens = (ctypes.c_size_t * n)(*[len(b) for b in bodies])
+        capacity = self._lib.ew_ingest_sample_bound(sum(lens))
+        buf = ctypes.create_string_buffer(capacity * SAMPLE_FORMAT.size)
+        results = (Result * n)()
+        self._lib.ew_ingest_envelopes(self._handle, arr, lens, n, buf, capacity, results)
+        return [Upload(r, self._samples(buf, r.sample_offset, r.sample_count) if r.status == OK else [])
+                for r in results]
+
+
+def load(key: bytes, threads=0, lib_path=None):
+    """NativeIngest, or None when the library is not built or cannot be loaded."""
+    try:
+        return NativeIngest(key, threads, lib_path)
+    except OSError as e:
+        print(f"[INGEST] native decoder unavailable ({e}); using the Python decoder")
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('envelope', help='file holding one secured upload envelope (JSON)')
+    parser.add_argument('--psk', default='c41716a134168f52fbd4be3302fa5a88127ddde749501a199607b4c286ad29b3',
+                        help='pre-shared key, hex')
+    parser.add_argument('--lib', help='path to the ecowatt_ingest library')
+    args = parser.parse_args()
+
+    ingest = NativeIngest(bytes.fromhex(args.psk), lib_path=args.lib)
+    upload = ingest.decode_envelope(Path(args.envelope).read_bytes())
+    print(f"status={STATUS_NAMES[upload.status]} nonce={upload.nonce} fidelity={upload.fidelity} "
+          f"batches={upload.batches} samples={len(upload.samples)}")
+    for ts, value, reg, kind in upload.samples[:20]:
+        print(f"  ts={ts} reg={reg} value={value:.3f}{' (aggregate)' if kind == SAMPLE_AGGREGATE else ''}")
+    return 0 if upload.ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
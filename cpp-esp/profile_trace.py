@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""
+Converts a device profiling capture (include/profiler.hpp) to Chrome trace JSON.
+
+A "profile" command makes the device record CpuScope spans per task, heap and stack
+counters, loop() overruns and HTTP request timings for a few seconds, then send the
+capture on the background lane. app.py reassembles it and serves the trace at
+/api/cloud/profile/<command_id>/trace; this module does the conversion, and converts
+a raw capture saved from there (?format=raw) on the command line.
+
+Open the JSON in chrome://tracing or https://ui.perfetto.dev.
+
+Usage:
+    python profile_trace.py capture.bin -o trace.json
+"""
+import argparse
+import json
+import struct
+import sys
+
+HEADER = struct.Struct('<4sBBBBIII')   # 'EWPF', version, threads, flags, reserved, session, length us, events
+EVENT = struct.Struct('<IIBBH')        # t_us, value, kind, tid, id
+THREAD_NAME_LEN = 16
+
+SPAN_BEGIN, SPAN_END, COUNTER, LOOP_OVERRUN, REQUEST = 1, 2, 3, 4, 5
+SUBSYSTEMS = ['acquisition', 'uplink', 'security', 'json', 'flash', 'network', 'fota']
+COUNTERS = ['heap_free', 'heap_min_free', 'stack_free']
+
+
+def decode_profile(blob: bytes) -> dict:
+    if len(blob) < HEADER.size:
+        raise ValueError('capture too short')
+    magic, version, threads, flags, _, session, length_us, count = HEADER.unpack_from(blob, 0)
+    if magic != b'EWPF' or version != 1:
+        raise ValueError('not a version 1 profile capture')
+    pos = HEADER.size
+    names = []
+    for _ in range(threads):
+        names.append(blob[pos:pos + THREAD_NAME_LEN].split(b'\0', 1)[0].decode('utf-8', errors='replace'))
+        pos += THREAD_NAME_LEN
+    if len(blob) < pos + count * EVENT.size:
+        raise ValueError('capture truncated in transit')
+    events = [EVENT.unpack_from(blob, pos + i * EVENT.size) for i in range(count)]
+    return {'session': session, 'length_us': length_us, 'truncated': bool(flags & 1),
+            'threads': names, 'events': events}
+
+
+def to_chrome_trace(profile: dict, pid: int = 1) -> dict:
+    """Spans become complete ("X") events per task; scopes already open when the
+    capture started are skipped and ones still open at the end run to its end."""
+    threads = profile['threads']
+    trace = [{'ph': 'M', 'name': 'process_name', 'pid': pid, 'tid': 0,
+              'args': {'name': f"EcoWatt profile {profile['session']}"}}]
+    for tid, name in enumerate(threads):
+        trace.append({'ph': 'M', 'name': 'thread_name', 'pid': pid, 'tid': tid, 'args': {'name': name or f'task{tid}'}})
+
+    open_spans = {}   # tid -> [(id, t_us), ...]
+    for t_us, value, kind, tid, ev_id in profile['events']:
+        if kind == SPAN_BEGIN:
+            open_spans.setdefault(tid, []).append((ev_id, t_us))
+        elif kind == SPAN_END:
+            stack = open_spans.get(tid)
+            if not stack or stack[-1][0] != ev_id:
+                continue
+            _, begin = stack.pop()
+            trace.append(_span(pid, tid, ev_id, begin, t_us))
+        elif kind == COUNTER:
+            name = COUNTERS[ev_id] if ev_id < len(COUNTERS) else f'counter{ev_id}'
+            track = 'stack' if name.startswith('stack') else 'heap'
+            trace.append({'ph': 'C', 'name': track, 'pid': pid, 'tid': tid, 'ts': t_us, 'args': {name: value}})
+        elif kind == LOOP_OVERRUN:
+            trace.append({'ph': 'X', 'name': 'loop overrun', 'cat': 'loop', 'pid': pid, 'tid': tid,
+                          'ts': t_us, 'dur': value, 'args': {'duration_ms': round(value / 1000, 3)}})
+        elif kind == REQUEST:
+            status = ev_id - 0x10000 if ev_id & 0x8000 else ev_id
+            trace.append({'ph': 'X', 'name': f'HTTP {status}', 'cat': 'request', 'pid': pid, 'tid': tid,
+                          'ts': t_us, 'dur': value, 'args': {'status': status}})
+    for tid, stack in open_spans.items():
+        for ev_id, begin in stack:
+            trace.append(_span(pid, tid, ev_id, begin, profile['length_us']))
+
+    return {'traceEvents': trace, 'displayTimeUnit': 'ms',
+            'otherData': {'session': profile['session'], 'length_us': profile['length_us'],
+                          'truncated': profile['truncated'], 'events': len(profile['events'])}}
+
+
+def _span(pid, tid, ev_id, begin, end):
+    name = SUBSYSTEMS[ev_id] if ev_id < len(SUBSYSTEMS) else f'span{ev_id}'
+    return {'ph': 'X', 'name': name, 'cat': 'cpu', 'pid': pid, 'tid': tid, 'ts': begin, 'dur': max(0, end - begin)}
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('capture', help='raw capture (serialized Profiler buffer)')
+    ap.add_argument('-o', '--output', help='trace JSON (default: stdout)')
+    args = ap.parse_args()
+    with open(args.capture, 'rb') as f:
+        profile = decode_profile(f.read())
+    text = json.dumps(to_chrome_trace(profile))
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text)
+        print(f"{len(profile['events'])} events, {profile['length_us'] / 1e6:.1f} s -> {args.output}", file=sys.stderr)
+    else:
+        print(text)
+
+
+if __name__ == '__main__':
+    main()
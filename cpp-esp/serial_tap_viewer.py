@@ -0,0 +1,214 @@
+#!/usr/bin/env python3
+"""
+Live viewer for the binary telemetry tap (include/serial_tap.hpp).
+
+Switches the device's serial port into tap mode ("tap on <baud>"), decodes the
+COBS-framed packets - [seq u32][uplink FRAME batch][crc16] - and plots every register
+live. Sequence gaps (samples the device ring overwrote before the port caught up) and
+CRC failures are counted. "tap off" is sent on exit.
+
+Needs pyserial; matplotlib for the plot (--no-plot prints samples instead).
+
+Usage:
+    python serial_tap_viewer.py --port COM5
+    python serial_tap_viewer.py --port /dev/ttyUSB0 --baud 921600 --no-plot
+    python serial_tap_viewer.py --file capture.bin --no-plot     # decode a raw capture
+"""
+import argparse
+import struct
+import sys
+import time
+from collections import defaultdict, deque
+
+CONSOLE_BAUD = 115200
+BATCH_HEADER = struct.Struct('<2sBBBBH')   # 'EW', version, codec, fidelity, flags, count
+CODEC_FRAME = 4
+
+
+def modbus_crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(frame):
+            return None
+        out += frame[i:i + code - 1]
+        i += code - 1
+        if code != 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_frame_batch(data):
+    """Samples (ts, reg, value) of one FRAME batch, or None if malformed."""
+    if len(data) < BATCH_HEADER.size:
+        return None
+    magic, _version, codec, _fidelity, _flags, count = BATCH_HEADER.unpack_from(data)
+    if magic != b'EW' or codec != CODEC_FRAME:
+        return None
+    samples = []
+    off = BATCH_HEADER.size
+    for _ in range(count):
+        if off + 6 > len(data):
+            return None
+        ts, present = struct.unpack_from('<IH', data, off)
+        off += 6
+        for reg in range(16):
+            if not present & (1 << reg):
+                continue
+            if off + 4 > len(data):
+                return None
+            samples.append((ts, reg, struct.unpack_from('<f', data, off)[0]))
+            off += 4
+    return samples
+
+
+class TapDecoder:
+    """Feeds raw port bytes; yields decoded samples and keeps link statistics."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.expected_seq = None
+        self.packets = 0
+        self.samples = 0
+        self.bad = 0
+        self.lost = 0
+
+    def feed(self, data):
+        self.buf += data
+        out = []
+        while True:
+            end = self.buf.find(b'\x00')
+            if end < 0:
+                return out
+            frame = bytes(self.buf[:end])
+            del self.buf[:end + 1]
+            if frame:
+                out.extend(self._packet(frame))
+
+    def _packet(self, frame):
+        payload = cobs_decode(frame)
+        if payload is None or len(payload) < 4 + BATCH_HEADER.size + 2:
+            self.bad += 1   # text that slipped onto the port, or a damaged packet
+            return []
+        crc = struct.unpack_from('<H', payload, len(payload) - 2)[0]
+        if crc != modbus_crc16(payload[:-2]):
+            self.bad += 1
+            return []
+        seq = struct.unpack_from('<I', payload)[0]
+        samples = decode_frame_batch(payload[4:-2])
+        if samples is None:
+            self.bad += 1
+            return []
+        if self.expected_seq is not None and seq != self.expected_seq:
+            self.lost += (seq - self.expected_seq) & 0xFFFFFFFF
+        self.expected_seq = (seq + len(samples)) & 0xFFFFFFFF
+        self.packets += 1
+        self.samples += len(samples)
+        return samples
+
+    def summary(self):
+        return (f"{self.packets} packets, {self.samples} samples, "
+                f"{self.lost} lost on the device, {self.bad} bad packets")
+
+
+def open_tap(port, baud):
+    import serial
+    ser = serial.Serial(port, CONSOLE_BAUD, timeout=0.05)
+    ser.write(f"tap on {baud}\n".encode())
+    ser.flush()
+    time.sleep(0.2)
+    ser.baudrate = baud
+    ser.reset_input_buffer()
+    return ser
+
+
+def close_tap(ser):
+    ser.write(b"tap off\n")
+    ser.flush()
+    time.sleep(0.2)
+    ser.baudrate = CONSOLE_BAUD
+    ser.close()
+
+
+def print_samples(samples):
+    for ts, reg, value in samples:
+        print(f"{ts:>10} reg {reg:>2} {value:>12.3f}")
+
+
+def run_plot(read, decoder, window):
+    import matplotlib.pyplot as plt
+    from matplotlib.animation import FuncAnimation
+
+    series = defaultdict(lambda: deque(maxlen=window))
+    lines = {}
+    fig, ax = plt.subplots()
+    ax.set_xlabel("device time (s)")
+    ax.set_ylabel("value")
+
+    def update(_):
+        for ts, reg, value in decoder.feed(read()):
+            series[reg].append((ts / 1000.0, value))
+        for reg, points in series.items():
+            if reg not in lines:
+                lines[reg], = ax.plot([], [], label=f"reg {reg}")
+                ax.legend(loc='upper left', fontsize='small')
+            xs, ys = zip(*points)
+            lines[reg].set_data(xs, ys)
+        ax.relim()
+        ax.autoscale_view()
+        ax.set_title(decoder.summary(), fontsize='small')
+        return list(lines.values())
+
+    anim = FuncAnimation(fig, update, interval=100, cache_frame_data=False)
+    plt.show()
+    return anim
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Decode and plot the device's binary telemetry tap")
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument('--port', help="serial port of the device")
+    src.add_argument('--file', help="decode a raw capture of the tap instead")
+    ap.add_argument('--baud', type=int, default=921600, help="tap baud rate")
+    ap.add_argument('--window', type=int, default=600, help="points kept per register in the plot")
+    ap.add_argument('--no-plot', action='store_true', help="print samples instead of plotting")
+    args = ap.parse_args()
+
+    decoder = TapDecoder()
+    if args.file:
+        with open(args.file, 'rb') as f:
+            samples = decoder.feed(f.read())
+        if args.no_plot:
+            print_samples(samples)
+        print(decoder.summary())
+        return 0 if decoder.bad == 0 else 1
+
+    ser = open_tap(args.port, args.baud)
+    try:
+        read = lambda: ser.read(ser.in_waiting or 1)
+        if args.no_plot:
+            while True:
+                print_samples(decoder.feed(read()))
+        else:
+            run_plot(read, decoder, args.window)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        close_tap(ser)
+        print(decoder.summary())
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -6,6 +6,8 @@
 #include "../include/data_storage.hpp"
 #include "../include/config_manager.hpp"
 #include "../include/logger.hpp"
+#include "../include/cpu_accounting.hpp"
+#include "../include/stall_detector.hpp"
 // --- Heap/Stack debug print helper ---
 static void printMemoryStats(const char* tag) {
     // Temporarily disabled to prevent stack overflow during demo
@@ -60,44 +62,58 @@ void AcquisitionScheduler::loop() {
 
 void AcquisitionScheduler::pollTask() {
     if (!running_ || regList_.empty()) return;
+    CpuScope cpu(CpuSubsystem::ACQUISITION);
+    StallScope stall(CpuSubsystem::ACQUISITION, "modbus_poll");
     printMemoryStats("AcqPollTask");
-    // Clear sample buffer before each acquisition cycle to avoid accumulation
-    storage_->clearSamples();
     Logger::info("Acquisition loop: regList_ size=%u", (unsigned)regList_.size());
-    for (uint8_t reg : regList_) {
+
+    // Over Modbus TCP every register goes out in one pipelined batch; registers that
+    // fail there drop into the per-register retry loop below
+    if (adapter_ && adapter_->usesTcp()) {
+        batch_.assign(regList_.data(), regList_.size());
+        adapter_->readBatch(batch_.reads(), batch_.size());
+    } else {
+        batch_.clear();
+    }
+
+    // The whole cycle is one frame under one timestamp
+    SampleFrame frame;
+    frame.timestamp = millis();
+    for (size_t idx = 0; idx < regList_.size(); ++idx) {
+        uint8_t reg = regList_[idx];
         Logger::info("Acquisition loop: reg=%d", reg);
         uint16_t raw_value = 0;
-        ModbusConfig mb = config_->getModbusConfig();
-        int tries = mb.max_retries ? mb.max_retries : 3;
-        int attempt = 0;
-        bool ok = false;
-        while (attempt < tries && !ok) {
-            if (adapter_ && adapter_->readRegisters(reg, 1, &raw_value)) {
-                ok = true;
-                break;
-            }
-            attempt++;
-            if (mb.retry_delay_ms) delay(mb.retry_delay_ms);
-        }
+        bool ok = batch_.value(idx, raw_value);
         if (!ok) {
-            Logger::warn("Acquisition: Failed to read register %d after %d attempts. Skipping.", reg, tries);
-            continue;
+            ModbusConfig mb = config_->getModbusConfig();
+            int tries = mb.max_retries ? mb.max_retries : 3;
+            for (int attempt = 0; attempt < tries && !ok; ++attempt) {
+                ok = adapter_ && adapter_->readRegisters(reg, 1, &raw_value);
+                if (!ok && mb.retry_delay_ms) delay(mb.retry_delay_ms);
+            }
+            if (!ok) {
+                Logger::warn("Acquisition: Failed to read register %d after %d attempts. Skipping.", reg, tries);
+                continue;
+            }
         }
-        uint32_t ts = millis();
-        RegisterConfig reg_config = config_->getRegisterConfig(reg);
-        float gain = reg_config.gain;
+        float gain = config_->getRegisterGain(reg);
         if (gain <= 0.0f) {
             Logger::warn("Acquisition: register %d has invalid gain %f, using 1.0", reg, gain);
             gain = 1.0f;
         }
         float final_value = (float)raw_value / gain;
-        storage_->appendSample(ts, reg, final_value);
+        if (reg < SampleFrame::MAX_REGISTERS) {
+            frame.set(reg, final_value);
+        } else {
+            Logger::warn("Acquisition: register %d is outside the frame map, not stored", reg);
+        }
         Logger::debug("Acquisition: Register %d value: %f", reg, final_value);
-        recentSamples_.push_back({ts, reg, final_value});
+        recentSamples_.push_back({frame.timestamp, reg, final_value});
         if (recentSamples_.size() > 10) {
             recentSamples_.erase(recentSamples_.begin());
         }
     }
+    if (frame.present) storage_->appendFrame(frame);
 }
 
 void AcquisitionScheduler::printTaskWrapper() {
@@ -1,5 +1,8 @@
 #include "../include/command_executor.hpp"
 #include "../include/logger.hpp"
+#include "../include/modbus_frame.hpp"
+#include "../include/profiler.hpp"
+#include "../include/stall_detector.hpp"
 #include <Arduino.h>
 #include <cstring>
 
@@ -11,16 +14,26 @@ CommandExecutor::~CommandExecutor() {
 }
 
 bool CommandExecutor::queueCommand(const CommandRequest& command) {
-    // Check if already processed (idempotency)
-    if (isCommandProcessed(command.command_id)) {
-        Logger::warn("[CmdExec] Command %u already processed, ignoring duplicate", command.command_id);
+    // Check if already queued or processed (idempotency). A finished one is answered
+    // again with its stored outcome: the cloud redelivers because the result never
+    // reached it, and would otherwise keep resending until it gives up.
+    CommandStatus done_status;
+    if (queue_.finished(command.command_id, done_status)) {
+        Logger::warn("[CmdExec] Command %u already processed (%s), reporting it again",
+                     command.command_id, commandStatusToString(done_status));
+        if (done_status != CommandStatus::PENDING) {
+            CommandResult result;
+            result.command_id = command.command_id;
+            result.status = done_status;
+            result.status_message = "Duplicate: already executed";
+            result.executed_at = millis();
+            result.actual_value = 0.0f;
+            executed_results_.push_back(result);
+        }
         return false;
     }
-    
-    // Check queue size
-    if (command_queue_.size() >= MAX_QUEUE_SIZE) {
-        Logger::error("[CmdExec] Command queue full (%u commands), cannot queue new command", 
-                      (unsigned)command_queue_.size());
+    if (queue_.seen(command.command_id)) {
+        Logger::warn("[CmdExec] Command %u already queued, ignoring duplicate", command.command_id);
         return false;
     }
     
@@ -39,58 +52,60 @@ bool CommandExecutor::queueCommand(const CommandRequest& command) {
         result.actual_value = 0.0f;
         
         executed_results_.push_back(result);
-        processed_command_ids_.push_back(command.command_id);
+        queue_.markDone(command.command_id, result.status);
         
         return false;
     }
     
     // Queue the command
-    QueuedCommand queued;
-    queued.request = command;
-    queued.executed = false;
-    queued.queued_at = millis();
-    queued.retry_count = 0;
-    
-    command_queue_.push_back(queued);
-    Logger::info("[CmdExec] Queued command %u: action=%s, target=%s, value=%.2f", 
+    if (queue_.push(command, millis()) == CommandAdmit::FULL) {
+        Logger::error("[CmdExec] Command queue full (%u commands), cannot queue new command", 
+                      (unsigned)queue_.size());
+        return false;
+    }
+    Logger::info("[CmdExec] Queued command %u: action=%s, target=%s, value=%.2f, priority=%u", 
                  command.command_id, command.action.c_str(), 
-                 command.target_register.c_str(), command.value);
+                 command.target_register.c_str(), command.value, (unsigned)command.priority);
     
     return true;
 }
 
+size_t CommandExecutor::queueCommands(const std::vector<CommandRequest>& commands) {
+    size_t queued = 0;
+    for (const CommandRequest& command : commands) {
+        if (queueCommand(command)) queued++;
+    }
+    if (commands.size() > 1) {
+        Logger::info("[CmdExec] Batch of %u commands: %u queued", (unsigned)commands.size(), (unsigned)queued);
+    }
+    return queued;
+}
+
 void CommandExecutor::executePendingCommands() {
-    if (command_queue_.empty()) {
+    if (queue_.empty()) {
         return;
     }
     
-    Logger::info("[CmdExec] Executing %u pending commands", (unsigned)command_queue_.size());
-    
-    std::vector<QueuedCommand> remaining;
+    Logger::info("[CmdExec] Executing %u pending commands", (unsigned)queue_.size());
     
-    for (auto& queued : command_queue_) {
-        if (queued.executed) {
-            continue; // Already executed, skip
+    CommandRequest command;
+    bool expired = false;
+    while (queue_.pop(millis(), command, expired)) {
+        CommandResult result;
+        if (expired) {
+            result.command_id = command.command_id;
+            result.status = CommandStatus::EXPIRED;
+            result.status_message = "Expired before execution";
+            result.executed_at = millis();
+            result.actual_value = 0.0f;
+        } else {
+            result = executeCommand(command);
         }
-        
-        // Execute the command
-        CommandResult result = executeCommand(queued.request);
-        
-        // Store result
-        queued.result = result;
-        queued.executed = true;
+        queue_.markDone(command.command_id, result.status);
         
         // Add to executed results
         executed_results_.push_back(result);
         
-        // Mark as processed
-        processed_command_ids_.push_back(queued.request.command_id);
-        
-        // Maintain processed IDs size
-        if (processed_command_ids_.size() > MAX_PROCESSED_IDS) {
-            processed_command_ids_.erase(processed_command_ids_.begin());
-        }
-        
         // Trigger callback if set
         if (onExecutedCallback_) {
             onExecutedCallback_(result);
@@ -100,9 +115,6 @@ void CommandExecutor::executePendingCommands() {
                      result.command_id, commandStatusToString(result.status));
     }
     
-    // Clear executed commands from queue
-    command_queue_.clear();
-    
     // Maintain results size
     while (executed_results_.size() > MAX_RESULTS_SIZE) {
         executed_results_.erase(executed_results_.begin());
@@ -119,12 +131,7 @@ void CommandExecutor::clearExecutedResults() {
 }
 
 bool CommandExecutor::isCommandProcessed(uint32_t command_id) const {
-    for (uint32_t id : processed_command_ids_) {
-        if (id == command_id) {
-            return true;
-        }
-    }
-    return false;
+    return queue_.seen(command_id);
 }
 
 void CommandExecutor::onCommandExecuted(std::function<void(const CommandResult&)> callback) {
@@ -141,11 +148,36 @@ CommandResult CommandExecutor::executeCommand(const CommandRequest& command) {
                  command.command_id, command.action.c_str(), 
                  command.target_register.c_str(), command.value);
     
+    if (command.action == "fetch_logs") {
+        if (!logs_) {
+            result.status = CommandStatus::FAILED;
+            result.status_message = "Log store not available";
+            return result;
+        }
+        uint32_t blocks = logs_->startExport(command.command_id, command.boots_ago, command.from_s, command.to_s);
+        result.status = CommandStatus::SUCCESS;
+        result.status_message = "Log export started";
+        result.actual_value = (float)blocks;   // blocks that will follow on the background lane
+        return result;
+    }
+    
+    if (command.action == "profile") {
+        if (!Profiler::start(command.duration_s * 1000, command.command_id)) {
+            result.status = CommandStatus::FAILED;
+            result.status_message = "Profiler busy or out of memory";
+            return result;
+        }
+        result.status = CommandStatus::SUCCESS;
+        result.status_message = "Profiling started";
+        result.actual_value = (float)command.duration_s;   // capture follows on the background lane
+        return result;
+    }
+    
     // Check if action is write_register
     if (command.action != "write_register") {
         result.status = CommandStatus::FAILED;
         result.status_message = "Unsupported action";
-        result.error_details = "Only 'write_register' action is supported";
+        result.error_details = "Only 'write_register', 'fetch_logs' and 'profile' actions are supported";
         Logger::error("[CmdExec] Unsupported action: %s", command.action.c_str());
         return result;
     }
@@ -188,8 +220,18 @@ CommandResult CommandExecutor::executeCommand(const CommandRequest& command) {
     int max_retries = mb_config.max_retries > 0 ? mb_config.max_retries : 3;
     bool success = false;
     
+    float confirmed_value = command.value;
+    StallScope stall(CpuSubsystem::ACQUISITION, "modbus_write");
+    
     for (int attempt = 0; attempt < max_retries && !success; attempt++) {
-        if (adapter_->writeRegister(reg_addr, raw_value)) {
+        // Prefer 0x17: the write and its confirming read share one round trip.
+        // Fall back to a plain 0x06 write once the inverter has rejected 0x17.
+        if (adapter_->supportsReadWrite()) {
+            if (writeWithReadback(reg_addr, raw_value, reg_config.gain, confirmed_value)) {
+                success = true;
+                break;
+            }
+        } else if (adapter_->writeRegister(reg_addr, raw_value)) {
             success = true;
             break;
         }
@@ -205,7 +247,7 @@ CommandResult CommandExecutor::executeCommand(const CommandRequest& command) {
     if (success) {
         result.status = CommandStatus::SUCCESS;
         result.status_message = "Command executed successfully";
-        result.actual_value = command.value;
+        result.actual_value = confirmed_value;
         result.error_details = "";
         Logger::info("[CmdExec] Command %u executed successfully: reg=%u, value=%.2f", 
                      command.command_id, reg_addr, command.value);
@@ -221,8 +263,50 @@ CommandResult CommandExecutor::executeCommand(const CommandRequest& command) {
     return result;
 }
 
+bool CommandExecutor::writeWithReadback(uint8_t reg_addr, uint16_t raw_value, float gain, float& confirmed_value) {
+    ModbusReadback block = ModbusReadback::around(reg_addr);
+    uint16_t values[ModbusReadback::MAX_COUNT];
+    if (!adapter_->readWriteRegisters(block.start, block.count, values, reg_addr, 1, &raw_value)) {
+        return false;
+    }
+
+    // Status and power are fresh whether or not the write took
+    if (storage_) {
+        uint32_t now = millis();
+        block.publish(values,
+                      [this](uint16_t reg) { return config_->getRegisterGain((uint8_t)reg); },
+                      [this, now](uint16_t reg, float value) { storage_->updateLatest(now, (uint8_t)reg, value); });
+    }
+
+    uint16_t readback = values[reg_addr - block.start];
+    if (readback != raw_value) {
+        Logger::warn("[CmdExec] Readback mismatch on register %u: wrote %u, read %u", 
+                     reg_addr, raw_value, readback);
+        return false;
+    }
+    confirmed_value = ModbusReadback::scaled(readback, gain);
+    
+    Logger::debug("[CmdExec] Register %u confirmed by 0x17 readback of %u-%u", reg_addr,
+                  block.start, block.start + block.count - 1);
+    return true;
+}
+
 bool CommandExecutor::validateCommand(const CommandRequest& command, std::string& error_reason) {
     // Validate action
+    if (command.action == "fetch_logs") {
+        if (command.to_s != 0 && command.to_s < command.from_s) {
+            error_reason = "Invalid log range";
+            return false;
+        }
+        return true;
+    }
+    if (command.action == "profile") {
+        if (command.duration_s == 0 || command.duration_s > Profiler::MAX_DURATION_MS / 1000) {
+            error_reason = "Profile duration must be 1.." + std::to_string(Profiler::MAX_DURATION_MS / 1000) + " s";
+            return false;
+        }
+        return true;
+    }
     if (command.action != "write_register") {
         error_reason = "Unsupported action: " + command.action;
         return false;
@@ -0,0 +1,61 @@
+#include "../include/command_queue.hpp"
+
+CommandAdmit CommandQueue::push(const CommandRequest& command, uint32_t now_ms) {
+    if (seen(command.command_id)) return CommandAdmit::DUPLICATE;
+    if (pending_.size() >= MAX_PENDING) return CommandAdmit::FULL;
+    Entry e;
+    e.request = command;
+    e.deadline_ms = now_ms + command.ttl_s * 1000;
+    e.arrival = arrivals_++;
+    pending_.push_back(e);
+    return CommandAdmit::QUEUED;
+}
+
+bool CommandQueue::pop(uint32_t now_ms, CommandRequest& command, bool& expired) {
+    if (pending_.empty()) return false;
+    size_t best = 0;
+    for (size_t i = 1; i < pending_.size(); ++i) {
+        const Entry& a = pending_[i];
+        const Entry& b = pending_[best];
+        if (a.request.priority > b.request.priority ||
+            (a.request.priority == b.request.priority && (int32_t)(a.arrival - b.arrival) < 0)) {
+            best = i;
+        }
+    }
+    const Entry& e = pending_[best];
+    command = e.request;
+    expired = e.request.ttl_s != 0 && (int32_t)(now_ms - e.deadline_ms) >= 0;
+    if (expired) expired_++;
+    pending_.erase(pending_.begin() + best);
+    markDone(command.command_id, CommandStatus::PENDING);
+    return true;
+}
+
+void CommandQueue::markDone(uint32_t command_id, CommandStatus status) {
+    for (Done& d : recent_) {
+        if (d.command_id == command_id) {
+            d.status = status;
+            return;
+        }
+    }
+    if (recent_.size() >= MAX_RECENT_IDS) recent_.erase(recent_.begin());
+    recent_.push_back({command_id, status});
+}
+
+bool CommandQueue::seen(uint32_t command_id) const {
+    for (const Entry& e : pending_) {
+        if (e.request.command_id == command_id) return true;
+    }
+    CommandStatus status;
+    return finished(command_id, status);
+}
+
+bool CommandQueue::finished(uint32_t command_id, CommandStatus& status) const {
+    for (const Done& d : recent_) {
+        if (d.command_id == command_id) {
+            status = d.status;
+            return true;
+        }
+    }
+    return false;
+}
@@ -37,6 +37,10 @@ void ConfigManager::initializeDefaults() {
     modbus_config_.timeout_ms = 5000;
     modbus_config_.max_retries = 3;
     modbus_config_.retry_delay_ms = 1000;
+    modbus_config_.tcp_host = "";
+    modbus_config_.tcp_port = 502;
+    modbus_config_.max_in_flight = 4;
+    modbus_config_.hedge_reads = false;
 
     // Hardcoded API config (inverter data accessed via api_key only)
     api_config_.inverter_base_url = "http://20.15.114.131:8080";
@@ -66,6 +70,11 @@ void ConfigManager::initializeDefaults() {
     acquisition_config_.minimum_registers = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
     acquisition_config_.background_polling = true;
 
+    // Uplink flushes at 4 KB pending or when the oldest sample is 60 s old
+    uplink_batch_config_.target_bytes = 4096;
+    uplink_batch_config_.max_age_ms = 60000;
+    uplink_batch_config_.fec_group = 0;
+
     // Hardcoded logging config
     logging_config_.log_level = "DEBUG";
     logging_config_.log_file = "/logs/main.log";
@@ -78,6 +87,10 @@ void ConfigManager::initializeDefaults() {
     validation_rules_.max_register_addr = 9;
     validation_rules_.min_register_count = 1;
     validation_rules_.max_register_count = 10;
+    validation_rules_.min_uplink_target_bytes = 256;
+    validation_rules_.max_uplink_target_bytes = 16384;
+    validation_rules_.min_uplink_max_age_ms = 1000;       // 1 second
+    validation_rules_.max_uplink_max_age_ms = 3600000;    // 1 hour
     validation_rules_.max_nonce_age_ms = 300000;  // 5 minutes
 }
 
@@ -94,7 +107,15 @@ RegisterConfig ConfigManager::getRegisterConfig(uint8_t addr) const {
     return RegisterConfig{};
 }
 
+float ConfigManager::getRegisterGain(uint8_t addr) const {
+    for (const auto& config : register_configs_) {
+        if (config.addr == addr) return config.gain;
+    }
+    return 0.0f;
+}
+
 AcquisitionConfig ConfigManager::getAcquisitionConfig() const { return acquisition_config_; }
+UplinkBatchConfig ConfigManager::getUplinkBatchConfig() const { return uplink_batch_config_; }
 
 LoggingConfig ConfigManager::getLoggingConfig() const { return logging_config_; }
 
@@ -161,6 +182,22 @@ bool ConfigManager::validateRegisters(const std::vector<uint8_t>& registers, std
     return true;
 }
 
+bool ConfigManager::validateUplinkBatch(uint32_t target_bytes, uint32_t max_age_ms, std::string& reason) const {
+    if (target_bytes < validation_rules_.min_uplink_target_bytes ||
+        target_bytes > validation_rules_.max_uplink_target_bytes) {
+        reason = "Uplink target out of range (" + std::to_string(validation_rules_.min_uplink_target_bytes) +
+                 "-" + std::to_string(validation_rules_.max_uplink_target_bytes) + " bytes)";
+        return false;
+    }
+    if (max_age_ms < validation_rules_.min_uplink_max_age_ms ||
+        max_age_ms > validation_rules_.max_uplink_max_age_ms) {
+        reason = "Uplink max age out of range (" + std::to_string(validation_rules_.min_uplink_max_age_ms / 1000) +
+                 "-" + std::to_string(validation_rules_.max_uplink_max_age_ms / 1000) + " s)";
+        return false;
+    }
+    return true;
+}
+
 ConfigUpdateAck ConfigManager::applyConfigUpdate(const ConfigUpdateRequest& request) {
     ConfigUpdateAck ack;
     ack.nonce = request.nonce;
@@ -253,6 +290,39 @@ ConfigUpdateAck ConfigManager::applyConfigUpdate(const ConfigUpdateRequest& requ
         }
     }
     
+    // Process uplink batching targets (runtime only, not persisted)
+    if (request.has_uplink_batch) {
+        UplinkBatchConfig next = uplink_batch_config_;
+        if (request.uplink_target_bytes) next.target_bytes = request.uplink_target_bytes;
+        if (request.uplink_max_age_ms) next.max_age_ms = request.uplink_max_age_ms;
+
+        ParameterAck param_ack;
+        param_ack.parameter_name = "uplink_batch";
+        param_ack.old_value = std::to_string(uplink_batch_config_.target_bytes) + "B/" +
+                              std::to_string(uplink_batch_config_.max_age_ms) + "ms";
+        param_ack.new_value = std::to_string(next.target_bytes) + "B/" + std::to_string(next.max_age_ms) + "ms";
+
+        std::string reason;
+        if (next.target_bytes == uplink_batch_config_.target_bytes && next.max_age_ms == uplink_batch_config_.max_age_ms) {
+            param_ack.result = ConfigUpdateResult::UNCHANGED;
+            param_ack.reason = "Value unchanged";
+            ack.unchanged.push_back(param_ack);
+        } else if (validateUplinkBatch(next.target_bytes, next.max_age_ms, reason)) {
+            uplink_batch_config_ = next;
+            param_ack.result = ConfigUpdateResult::ACCEPTED;
+            param_ack.reason = "Applied successfully";
+            ack.accepted.push_back(param_ack);
+            Logger::info("[ConfigMgr] Uplink batching updated: %s -> %s",
+                         param_ack.old_value.c_str(), param_ack.new_value.c_str());
+        } else {
+            param_ack.result = ConfigUpdateResult::REJECTED;
+            param_ack.reason = reason;
+            ack.rejected.push_back(param_ack);
+            ack.all_success = false;
+            Logger::warn("[ConfigMgr] Uplink batching rejected: %s", reason.c_str());
+        }
+    }
+
     // If any parameters were accepted, save to persistent storage
     if (!ack.accepted.empty()) {
         persistent_config_.last_update_timestamp = ack.timestamp;
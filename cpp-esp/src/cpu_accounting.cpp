@@ -0,0 +1,214 @@
+#include "../include/cpu_accounting.hpp"
+#include "../include/profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef ESP32
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <mutex>
+#include <pthread.h>
+#include <ctime>
+#endif
+
+const char* cpuSubsystemToString(CpuSubsystem s) {
+    switch (s) {
+        case CpuSubsystem::ACQUISITION: return "acquisition";
+        case CpuSubsystem::UPLINK: return "uplink";
+        case CpuSubsystem::SECURITY: return "security";
+        case CpuSubsystem::JSON: return "json";
+        case CpuSubsystem::FLASH: return "flash";
+        case CpuSubsystem::NETWORK: return "network";
+        case CpuSubsystem::FOTA: return "fota";
+        default: return "unknown";
+    }
+}
+
+uint64_t cpuClockUs() {
+#ifdef ESP32
+    return (uint64_t)esp_timer_get_time();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000;
+#endif
+}
+
+static uint32_t wallClockUs() {
+#ifdef ESP32
+    return (uint32_t)esp_timer_get_time();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+CpuAccounting::Slot CpuAccounting::slots_[(size_t)CpuSubsystem::COUNT];
+
+void CpuAccounting::record(CpuSubsystem s, uint64_t us) {
+    if (s >= CpuSubsystem::COUNT) return;
+    Slot& slot = slots_[(size_t)s];
+    slot.us.fetch_add(us, std::memory_order_relaxed);
+    slot.calls.fetch_add(1, std::memory_order_relaxed);
+    uint32_t v = us > 0xFFFFFFFFull ? 0xFFFFFFFFu : (uint32_t)us;
+    uint32_t prev = slot.max_us.load(std::memory_order_relaxed);
+    while (v > prev && !slot.max_us.compare_exchange_weak(prev, v, std::memory_order_relaxed)) {
+    }
+}
+
+CpuCounter CpuAccounting::get(CpuSubsystem s) {
+    CpuCounter c;
+    if (s >= CpuSubsystem::COUNT) return c;
+    const Slot& slot = slots_[(size_t)s];
+    c.us = slot.us.load(std::memory_order_relaxed);
+    c.calls = slot.calls.load(std::memory_order_relaxed);
+    c.max_us = slot.max_us.load(std::memory_order_relaxed);
+    return c;
+}
+
+void CpuAccounting::reset() {
+    for (Slot& slot : slots_) {
+        slot.us.store(0);
+        slot.calls.store(0);
+        slot.max_us.store(0);
+    }
+}
+
+std::string CpuAccounting::subsystemsJson() {
+    std::string json = "{";
+    for (size_t i = 0; i < (size_t)CpuSubsystem::COUNT; ++i) {
+        CpuCounter c = get((CpuSubsystem)i);
+        if (i) json += ",";
+        json += "\"" + std::string(cpuSubsystemToString((CpuSubsystem)i)) + "\":{\"us\":" +
+                std::to_string(c.us) + ",\"calls\":" + std::to_string(c.calls) +
+                ",\"max_us\":" + std::to_string(c.max_us) + "}";
+    }
+    return json + "}";
+}
+
+thread_local CpuScope* CpuScope::current_ = nullptr;
+
+CpuScope::CpuScope(CpuSubsystem s) : s_(s), start_(cpuClockUs()), parent_(current_) {
+    current_ = this;
+    Profiler::spanBegin((uint8_t)s);
+}
+
+CpuScope::~CpuScope() {
+    Profiler::spanEnd((uint8_t)s_);
+    uint64_t elapsed = cpuClockUs() - start_;
+    CpuAccounting::record(s_, elapsed > child_us_ ? elapsed - child_us_ : 0);
+    if (parent_) parent_->child_us_ += elapsed;
+    current_ = parent_;
+}
+
+#ifndef ESP32
+namespace {
+struct HostThread {
+    char name[16];
+    clockid_t clock;
+};
+std::mutex g_threads_mutex;
+HostThread g_threads[TaskRuntimeMonitor::MAX_TASKS];
+size_t g_thread_count = 0;
+}
+#endif
+
+void TaskRuntimeMonitor::registerThread(const char* name) {
+#ifndef ESP32
+    clockid_t clock;
+    if (pthread_getcpuclockid(pthread_self(), &clock) != 0) return;
+    std::lock_guard<std::mutex> lock(g_threads_mutex);
+    if (g_thread_count >= MAX_TASKS) return;
+    HostThread& t = g_threads[g_thread_count++];
+    strncpy(t.name, name, sizeof(t.name) - 1);
+    t.name[sizeof(t.name) - 1] = '\0';
+    t.clock = clock;
+#else
+    (void)name;
+#endif
+}
+
+size_t TaskRuntimeMonitor::sample() {
+    TaskRuntime snap[MAX_TASKS];
+    size_t n = 0;
+    uint32_t now = wallClockUs();
+    unsigned cores = 1;
+#ifdef ESP32
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+    // Only called from loop(); static keeps ~1 KB of task records off the stack
+    static TaskStatus_t status[MAX_TASKS];
+    uint32_t total = 0;
+    n = uxTaskGetSystemState(status, MAX_TASKS, &total);
+    for (size_t i = 0; i < n; ++i) {
+        strncpy(snap[i].name, status[i].pcTaskName, sizeof(snap[i].name) - 1);
+        snap[i].runtime = (uint32_t)status[i].ulRunTimeCounter;
+    }
+    now = (uint32_t)total;
+    cores = portNUM_PROCESSORS;
+#endif
+#else
+    {
+        std::lock_guard<std::mutex> lock(g_threads_mutex);
+        for (size_t i = 0; i < g_thread_count; ++i) {
+            timespec ts;
+            if (clock_gettime(g_threads[i].clock, &ts) != 0) continue;   // thread has exited
+            memcpy(snap[n].name, g_threads[i].name, sizeof(snap[n].name));
+            snap[n].runtime = (uint32_t)((uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000);
+            n++;
+        }
+    }
+#endif
+    update(snap, n, now - last_total_, cores);
+    last_total_ = now;
+    return n;
+}
+
+void TaskRuntimeMonitor::update(const TaskRuntime* tasks, size_t count, uint32_t interval_us, unsigned cores) {
+    if (count > MAX_TASKS) count = MAX_TASKS;
+    TaskRuntime prev[MAX_TASKS];
+    size_t prev_count = count_;
+    std::copy(cur_, cur_ + prev_count, prev);
+
+    for (size_t i = 0; i < count; ++i) {
+        cur_[i] = tasks[i];
+        // A task seen for the first time is charged everything it has run so far
+        delta_[i] = tasks[i].runtime;
+        for (size_t j = 0; j < prev_count; ++j) {
+            if (strncmp(prev[j].name, tasks[i].name, sizeof(prev[j].name)) == 0) {
+                delta_[i] = tasks[i].runtime - prev[j].runtime;
+                break;
+            }
+        }
+    }
+    count_ = count;
+    interval_us_ = interval_us;
+    cores_ = cores ? cores : 1;
+}
+
+uint32_t TaskRuntimeMonitor::shareOf(size_t i) const {
+    if (i >= count_ || interval_us_ == 0) return 0;
+    uint64_t share = (uint64_t)delta_[i] * 10000 / ((uint64_t)interval_us_ * cores_);
+    return share > 10000 ? 10000 : (uint32_t)share;
+}
+
+std::string TaskRuntimeMonitor::json() const {
+    size_t order[MAX_TASKS];
+    for (size_t i = 0; i < count_; ++i) order[i] = i;
+    std::sort(order, order + count_, [this](size_t a, size_t b) { return delta_[a] > delta_[b]; });
+
+    std::string json = "[";
+    for (size_t k = 0; k < count_; ++k) {
+        size_t i = order[k];
+        uint32_t share = shareOf(i);
+        char pct[16];
+        snprintf(pct, sizeof(pct), "%u.%02u", (unsigned)(share / 100), (unsigned)(share % 100));
+        if (k) json += ",";
+        json += "{\"task\":\"" + std::string(cur_[i].name) + "\",\"us\":" + std::to_string(delta_[i]) +
+                ",\"pct\":" + pct + "}";
+    }
+    return json + "]";
+}
@@ -4,64 +4,28 @@
 #include <FS.h>
 #include <LittleFS.h>
 #include "../include/data_storage.hpp"
+#include "../include/sample_log.hpp"
+#include "../include/cpu_accounting.hpp"
+#include "../include/stall_detector.hpp"
 #include <string.h>
 #include <cstdio>
 
 // Public method to clear sample buffer
 void DataStorage::clearSamples() {
-    sample_buffer_.clear();
-}
-
-SampleBuffer::SampleBuffer(size_t max_samples) : max_samples_(max_samples), head_(0), tail_(0), full_(false) {
-    buffer_ = new Sample[max_samples_];
-}
-
-SampleBuffer::~SampleBuffer() {
-    delete[] buffer_;
-}
-
-bool SampleBuffer::append(const Sample& s) {
     lock();
-    buffer_[head_] = s;
-    if (full_) tail_ = (tail_ + 1) % max_samples_;
-    head_ = (head_ + 1) % max_samples_;
-    full_ = head_ == tail_;
+    frame_ring_.clear();
     unlock();
-    return true;
-}
-
-int SampleBuffer::queryByTime(uint32_t start_ts, uint32_t end_ts, Sample* outBuf, size_t outBufSize) {
-    lock();
-    size_t entries = size();
-    size_t count = 0;
-    for (size_t i = 0; i < entries; ++i) {
-        const Sample& s = buffer_[(tail_ + i) % max_samples_];
-        if (s.timestamp >= start_ts && s.timestamp <= end_ts) {
-            if (count < outBufSize) outBuf[count++] = s;
-        }
-    }
-    unlock();
-    return (int)count;
-}
-
-void SampleBuffer::clear() {
-    lock(); head_ = tail_ = 0; full_ = false; unlock();
-}
-
-size_t SampleBuffer::size() const {
-    if (full_) return max_samples_;
-    if (head_ >= tail_) return head_ - tail_;
-    return max_samples_ - tail_ + head_;
 }
 
-void SampleBuffer::lock() { noInterrupts(); }
-void SampleBuffer::unlock() { interrupts(); }
+void DataStorage::lock() { noInterrupts(); }
+void DataStorage::unlock() { interrupts(); }
 
 DataStorage* DataStorage::instance_ = nullptr;
 
-DataStorage::DataStorage(const char* fname) : filename(fname), sample_buffer_(512), flushTicker_(flushTaskWrapper, 60000) {
+DataStorage::DataStorage(const char* fname) : filename(fname), frame_ring_(RING_BYTES), flushTicker_(flushTaskWrapper, 60000) {
     // Ensure instance is set before any callbacks
     instance_ = this;
+    memset(latest_valid_, 0, sizeof(latest_valid_));
     // LittleFS should already be mounted in setup(); attempt mount but allow formatting
     LittleFS.begin(true);
     // Start periodic flushes
@@ -69,6 +33,9 @@ DataStorage::DataStorage(const char* fname) : filename(fname), sample_buffer_(51
     // Restore buffer from file
     File file = LittleFS.open(filename, "r");
     if (file) {
+        const size_t chunk = 64;
+        Sample restored[chunk];
+        size_t n = 0;
         while (file.available()) {
             String line = file.readStringUntil('\n');
             int idx1 = line.indexOf(',');
@@ -79,9 +46,13 @@ DataStorage::DataStorage(const char* fname) : filename(fname), sample_buffer_(51
             uint32_t ts = line.substring(0, idx1).toInt();
             uint8_t reg_addr = line.substring(idx1+1, idx2).toInt();
             float value = line.substring(idx2+1).toFloat();
-            Sample s = {ts, reg_addr, value};
-            sample_buffer_.append(s);
+            restored[n++] = {ts, reg_addr, value};
+            if (n == chunk) {
+                restoreSamples(restored, n);
+                n = 0;
+            }
         }
+        restoreSamples(restored, n);
         file.close();
     }
 }
@@ -89,10 +60,64 @@ DataStorage::DataStorage(const char* fname) : filename(fname), sample_buffer_(51
 // DataStorage destructor is implemented at end of file
 
 bool DataStorage::clearStorage() {
+    if (sample_log_) return sample_log_->clear();
     return LittleFS.remove(filename);
 }
 
+void DataStorage::attachSampleLog(SampleLog* log) {
+    sample_log_ = log;
+    logged_seq_ = frame_ring_.nextSequence();
+    if (!log || frame_ring_.samples() > 0) return;
+    // Same role as the CSV restore in the constructor: the newest records refill the ring
+    // (each value takes at least 4 bytes, so older ones would only be evicted again)
+    size_t cap = frame_ring_.capacityBytes() / 4;
+    size_t skip = log->records() > cap ? log->records() - cap : 0;
+    const size_t chunk = 64;
+    Sample restored[chunk];
+    size_t n = 0;
+    log->scan(0, 0xFFFFFFFFu, [&](const SampleLogRecord& r) {
+        if (skip > 0) {
+            skip--;
+            return true;
+        }
+        restored[n++] = Sample{r.ts, r.reg, r.value};
+        if (n == chunk) {
+            restoreSamples(restored, n);
+            n = 0;
+        }
+        return true;
+    });
+    restoreSamples(restored, n);
+}
+
+// Restored samples are regrouped into frames but keep sequences below the current one,
+// so the uplink does not send them again and the log does not re-append them
+void DataStorage::restoreSamples(const Sample* samples, size_t count) {
+    if (count == 0) return;
+    lock();
+    uint32_t next = frame_ring_.nextSequence();
+    frame_ring_.appendSamples(samples, count);
+    frame_ring_.setNextSequence(next);
+    unlock();
+}
+
 int DataStorage::querySamplesByTime(uint32_t start_ts, uint32_t end_ts, char* outBuf, size_t outBufSize) {
+    if (sample_log_) {
+        // Straight from the mapped partition, no file reads
+        int count = 0;
+        size_t outLen = 0;
+        sample_log_->scan(start_ts, end_ts, [&](const SampleLogRecord& r) {
+            char line[48];
+            int len = snprintf(line, sizeof(line), "%lu,%u,%.3f\n", (unsigned long)r.ts, r.reg, r.value);
+            if (len <= 0 || outLen + (size_t)len + 1 >= outBufSize) return false;
+            memcpy(outBuf + outLen, line, (size_t)len);
+            outLen += (size_t)len;
+            count++;
+            return true;
+        });
+        if (outLen > 0) outBuf[outLen] = '\0';
+        return count;
+    }
     File file = LittleFS.open(filename, "r");
     if (!file) return 0;
     int count = 0;
@@ -116,56 +141,118 @@ int DataStorage::querySamplesByTime(uint32_t start_ts, uint32_t end_ts, char* ou
 }
 
 void DataStorage::flushTask() {
-    flushBufferToFile();
+    if (sample_log_) {
+        flushToSampleLog();
+    } else {
+        flushBufferToFile();
+    }
 }
 
 void DataStorage::loop() {
     flushTicker_.update();
 }
 
+bool DataStorage::appendFrame(const SampleFrame& frame) {
+    lock();
+    bool ok = frame_ring_.append(frame);
+    unlock();
+    if (!ok) return false;
+    for (uint8_t reg = 0; reg < SampleFrame::MAX_REGISTERS; ++reg) {
+        if (frame.present & (1u << reg)) updateLatest(frame.timestamp, reg, frame.values[reg]);
+    }
+    return true;
+}
+
 bool DataStorage::appendSample(uint32_t timestamp, uint8_t reg_addr, float value) {
-    Sample s = {timestamp, reg_addr, value};
-    sample_buffer_.append(s);
+    if (reg_addr >= SampleFrame::MAX_REGISTERS) return false;
+    SampleFrame frame;
+    frame.timestamp = timestamp;
+    frame.set(reg_addr, value);
+    return appendFrame(frame);
+}
+
+uint32_t DataStorage::pendingFrom(uint32_t from_seq) {
+    lock();
+    uint32_t oldest = frame_ring_.firstSequence();
+    uint32_t next = frame_ring_.nextSequence();
+    if ((int32_t)(from_seq - oldest) < 0) from_seq = oldest;
+    uint32_t pending = ((int32_t)(next - from_seq) > 0) ? next - from_seq : 0;
+    unlock();
+    return pending;
+}
+
+int DataStorage::readFromSequence(uint32_t from_seq, Sample* outBuf, size_t outBufSize, uint32_t& first_seq) {
+    lock();
+    size_t count = frame_ring_.readFromSequence(from_seq, outBuf, outBufSize, first_seq);
+    unlock();
+    return (int)count;
+}
+
+void DataStorage::updateLatest(uint32_t timestamp, uint8_t reg_addr, float value) {
+    if (reg_addr >= MAX_LATEST_REGISTERS) return;
+    latest_[reg_addr] = {timestamp, reg_addr, value};
+    latest_valid_[reg_addr] = true;
+}
+
+bool DataStorage::getLatest(uint8_t reg_addr, Sample& out) const {
+    if (reg_addr >= MAX_LATEST_REGISTERS || !latest_valid_[reg_addr]) return false;
+    out = latest_[reg_addr];
     return true;
 }
 
 int DataStorage::readLastSamples(int n, Sample* outBuf, size_t outBufSize) {
-    sample_buffer_.lock();
-    int total = (int)sample_buffer_.size();
-    int count = (total < n) ? total : n;
-    if ((size_t)count > outBufSize) count = (int)outBufSize;
-
-    const Sample* buf = sample_buffer_.getBuffer();
-    size_t head = sample_buffer_.getHead();
-    size_t max_samples = sample_buffer_.getMaxSamples();
-
-    // Read 'count' most recent entries in chronological order
-    for (int i = 0; i < count; ++i) {
-        // index of the (count - i)-th most recent element
-        size_t idx = (head + max_samples - (size_t)(count - i)) % max_samples;
-        outBuf[i] = buf[idx];
-    }
-    sample_buffer_.unlock();
-    return count;
+    if (n <= 0) return 0;
+    lock();
+    size_t count = frame_ring_.readLast((size_t)n, outBuf, outBufSize);
+    unlock();
+    return (int)count;
 }
 
 // Periodic flush to SPIFFS
 void DataStorage::flushBufferToFile() {
+    CpuScope cpu(CpuSubsystem::FLASH);
+    StallScope stall(CpuSubsystem::FLASH, "csv_flush");
     File file = LittleFS.open(filename, "w");
     if (!file) return;
-    const Sample* buf = sample_buffer_.getBuffer();
-    size_t tail = sample_buffer_.getTail();
-    size_t max_samples = sample_buffer_.getMaxSamples();
-    size_t entries = sample_buffer_.size();
-    for (size_t i = 0; i < entries; ++i) {
-        const Sample& s = buf[(tail + i) % max_samples];
-        char linebuf[64];
-        snprintf(linebuf, sizeof(linebuf), "%lu,%u,%.3f\n", (unsigned long)s.timestamp, s.reg_addr, s.value);
-        file.print(linebuf);
+    // Frames are written out one sample per line; the restore regroups them
+    const size_t chunk = 64;
+    Sample buf[chunk];
+    uint32_t seq = frame_ring_.firstSequence();
+    for (;;) {
+        uint32_t first_seq = seq;
+        int n = readFromSequence(seq, buf, chunk, first_seq);
+        if (n <= 0) break;
+        for (int i = 0; i < n; ++i) {
+            const Sample& s = buf[i];
+            char linebuf[64];
+            snprintf(linebuf, sizeof(linebuf), "%lu,%u,%.3f\n", (unsigned long)s.timestamp, s.reg_addr, s.value);
+            file.print(linebuf);
+        }
+        seq = first_seq + (uint32_t)n;
     }
     file.close();
 }
 
+// Append-only: samples not yet logged go out in one batch, nothing is rewritten
+void DataStorage::flushToSampleLog() {
+    CpuScope cpu(CpuSubsystem::FLASH);
+    StallScope stall(CpuSubsystem::FLASH, "sample_log_append");
+    const size_t chunk = 64;
+    Sample buf[chunk];
+    while ((int32_t)(frame_ring_.nextSequence() - logged_seq_) > 0) {
+        uint32_t first_seq = logged_seq_;
+        int n = readFromSequence(logged_seq_, buf, chunk, first_seq);
+        if (n <= 0) break;
+        if (!sample_log_->append(buf, (size_t)n)) return;   // retried on the next flush
+        logged_seq_ = first_seq + (uint32_t)n;
+    }
+}
+
+std::string DataStorage::storageStatsJson() const {
+    if (sample_log_) return "{\"backend\":\"partition\",\"log\":" + sample_log_->statsJson() + "}";
+    return "{\"backend\":\"littlefs\"}";
+}
+
 void DataStorage::flushTaskWrapper() {
     if (instance_) {
         instance_->flushTask();
@@ -175,6 +262,6 @@ void DataStorage::flushTaskWrapper() {
 DataStorage::~DataStorage() {
     // Stop periodic flushing and attempt a final flush
     flushTicker_.stop();
-    flushBufferToFile();
+    flushTask();
     instance_ = nullptr;
 }
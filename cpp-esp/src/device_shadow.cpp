@@ -0,0 +1,140 @@
+#include "../include/device_shadow.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const char* shadowFieldKey(ShadowField f) {
+    switch (f) {
+        case ShadowField::FIRMWARE: return "fw";
+        case ShadowField::CONFIG_VERSION: return "cfg";
+        case ShadowField::FOTA_STATE: return "fota";
+        case ShadowField::FOTA_CHUNKS: return "fch";
+        case ShadowField::FOTA_ERROR: return "ferr";
+        case ShadowField::BOOT_STATUS: return "boot";
+        case ShadowField::BOOT_COUNT: return "bcnt";
+        case ShadowField::SECURITY: return "sec";
+        case ShadowField::FIDELITY: return "fid";
+        case ShadowField::HEAP_MIN_KB: return "hmin";
+        case ShadowField::RSSI_DBM: return "rssi";
+        case ShadowField::STALLS: return "stl";
+        default: return "unknown";
+    }
+}
+
+static std::string jsonString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)(unsigned char)c);
+            out += esc;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static bool store(std::string& slot, std::string&& encoded) {
+    if (slot == encoded) return false;
+    slot = std::move(encoded);
+    return true;
+}
+
+bool DeviceShadow::set(ShadowField f, const std::string& value) {
+    if (f >= ShadowField::COUNT) return false;
+    if (!store(values_[(size_t)f], jsonString(value))) return false;
+    changed_[(size_t)f] = ++version_;
+    dirty_ |= 1u << (unsigned)f;
+    return true;
+}
+
+bool DeviceShadow::set(ShadowField f, int64_t value) {
+    if (f >= ShadowField::COUNT) return false;
+    if (!store(values_[(size_t)f], std::to_string(value))) return false;
+    changed_[(size_t)f] = ++version_;
+    dirty_ |= 1u << (unsigned)f;
+    return true;
+}
+
+bool DeviceShadow::set(ShadowField f, int64_t a, int64_t b) {
+    if (f >= ShadowField::COUNT) return false;
+    if (!store(values_[(size_t)f], "[" + std::to_string(a) + "," + std::to_string(b) + "]")) return false;
+    changed_[(size_t)f] = ++version_;
+    dirty_ |= 1u << (unsigned)f;
+    return true;
+}
+
+bool DeviceShadow::due(uint32_t now_ms) const {
+    if (!dirty_) return false;
+    return !inflight_ || now_ms - sent_ms_ >= RESEND_MS;
+}
+
+std::string DeviceShadow::delta(uint32_t now_ms) {
+    if (!dirty_) return std::string();
+    std::string out = "{\"type\":\"shadow\",\"v\":" + std::to_string(version_);
+    if (full_) out += ",\"full\":true";
+    out += ",\"s\":{";
+    bool first = true;
+    for (size_t i = 0; i < (size_t)ShadowField::COUNT; ++i) {
+        if (!(dirty_ & (1u << i))) continue;
+        if (!first) out += ",";
+        first = false;
+        out += "\"";
+        out += shadowFieldKey((ShadowField)i);
+        out += "\":" + values_[i];
+    }
+    out += "}}";
+    inflight_ = true;
+    sent_version_ = version_;
+    sent_ms_ = now_ms;
+    deltas_++;
+    bytes_ += out.size();
+    return out;
+}
+
+void DeviceShadow::ack(uint32_t version) {
+    if (version > version_ || version <= acked_) return;   // stale or not ours
+    acked_ = version;
+    full_ = false;
+    for (size_t i = 0; i < (size_t)ShadowField::COUNT; ++i) {
+        if (changed_[i] <= version) dirty_ &= ~(1u << i);
+    }
+    if (version >= sent_version_) inflight_ = false;
+}
+
+bool DeviceShadow::parseAck(const std::string& body, uint32_t& version) {
+    static const char KEY[] = "\"shadow_ack\"";
+    size_t pos = body.find(KEY);
+    if (pos == std::string::npos) return false;
+    pos += sizeof(KEY) - 1;
+    while (pos < body.size() && (body[pos] == ' ' || body[pos] == ':')) ++pos;
+    if (pos >= body.size() || body[pos] < '0' || body[pos] > '9') return false;
+    version = (uint32_t)strtoul(body.c_str() + pos, nullptr, 10);
+    return true;
+}
+
+std::string DeviceShadow::document() const {
+    std::string out = "{\"v\":" + std::to_string(version_) + ",\"s\":{";
+    bool first = true;
+    for (size_t i = 0; i < (size_t)ShadowField::COUNT; ++i) {
+        if (values_[i].empty()) continue;
+        if (!first) out += ",";
+        first = false;
+        out += "\"";
+        out += shadowFieldKey((ShadowField)i);
+        out += "\":" + values_[i];
+    }
+    return out + "}}";
+}
+
+std::string DeviceShadow::statsJson() const {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "{\"version\":%u,\"acked\":%u,\"dirty\":%u,\"deltas\":%u,\"bytes\":%llu}",
+             (unsigned)version_, (unsigned)acked_, (unsigned)dirty_, (unsigned)deltas_,
+             (unsigned long long)bytes_);
+    return std::string(buf);
+}
@@ -17,7 +17,12 @@
 #include "../include/command_executor.hpp"
 #include "../include/http_client.hpp"
 #include "../include/logger.hpp"
+#include "../include/log_store.hpp"
 #include "../include/wifi_connector.hpp"
+#include "../include/sha256_engine.hpp"
+#include "../include/secure_envelope.hpp"
+#include "../include/profiler.hpp"
+#include "../include/stall_detector.hpp"
 // --- Heap/Stack debug print helper ---
 #ifdef ESP32
 #include <Arduino.h>
@@ -31,11 +36,27 @@ static void printMemoryStats(const char* tag) {
     //     char dummy;
     //     Logger::info("[MEM] %s | Stack ptr: %p", tag, &dummy);
 }
+static uint64_t micros64() { return (uint64_t)micros(); }
+
+// One pass per backend (64 KB in 4 KB buffers, a few ms) so boot logs show what HMAC/FOTA hashing costs
+static void logShaThroughput() {
+    for (Sha256Backend b : {Sha256Backend::ESP32_HW, Sha256Backend::PORTABLE}) {
+        if (!sha256BackendAvailable(b)) continue;
+        Logger::info("[SHA] %s: %.2f MB/s", sha256BackendName(b), sha256BenchmarkMBps(b, 4096, 16, micros64));
+    }
+}
+
 EcoWattDevice::EcoWattDevice() {}
 EcoWattDevice::~EcoWattDevice() {
     delete scheduler_;
     delete adapter_;
+    delete modbus_tcp_;
+    delete modbus_tcp_hedge_;
     delete storage_;
+    delete sample_log_;
+    delete sample_region_;
+    Logger::attachStore(nullptr);
+    delete log_store_;
     delete uplink_packetizer_;
     delete remote_config_handler_;
     delete command_executor_;
@@ -155,6 +176,14 @@ void EcoWattDevice::onConfigUpdated() {
     } else {
         Logger::warn("[EcoWattDevice] Scheduler not initialized, cannot apply config");
     }
+
+    if (uplink_packetizer_) {
+        UplinkBatchConfig batch = config_->getUplinkBatchConfig();
+        FlushTargets targets = uplink_packetizer_->flushTrigger().targets();
+        targets.target_bytes = batch.target_bytes;
+        targets.max_age_ms = batch.max_age_ms;
+        uplink_packetizer_->setFlushTargets(targets);
+    }
 }
 
 void EcoWattDevice::onCommandReceived(const CommandRequest& command) {
@@ -168,6 +197,8 @@ void EcoWattDevice::onCommandReceived(const CommandRequest& command) {
 
 void EcoWattDevice::setup() {
     Logger::info("EcoWatt Device initializing...");
+    // First, so blocking calls during setup are covered too
+    size_t reset_stalls = StallDetector::begin();
     
     // Initialize WiFi, SPIFFS, config, etc.
     if (!config_) {
@@ -177,7 +208,34 @@ void EcoWattDevice::setup() {
     if (!storage_) {
         storage_ = new DataStorage();
         Logger::info("DataStorage initialized");
+
+        // Raw-partition sample log when the partition table has one; LittleFS otherwise
+        sample_region_ = new EspPartitionRegion();
+        if (sample_region_->begin()) {
+            sample_log_ = new SampleLog(sample_region_);
+            if (sample_log_->begin()) {
+                storage_->attachSampleLog(sample_log_);
+                Logger::info("[SampleLog] %u/%u records in %u sectors, head seq %u",
+                             (unsigned)sample_log_->records(), (unsigned)sample_log_->capacity(),
+                             (unsigned)sample_log_->sectorCount(), (unsigned)sample_log_->headSeq());
+            }
+        } else {
+            Logger::info("[SampleLog] No '%s' partition, samples persist to LittleFS", EspPartitionRegion::LABEL);
+        }
+    }
+    if (!log_store_) {
+        log_store_ = new LogStore();
+        if (log_store_->begin()) Logger::attachStore(log_store_);
     }
+    if (reset_stalls) {
+        StallRecord r;
+        if (StallDetector::record(0, r) && (r.flags & StallRecord::RESET)) {
+            Logger::error("[Stall] %s/%s had blocked for %u ms when a %s reset hit",
+                          cpuSubsystemToString((CpuSubsystem)r.subsystem), r.op, (unsigned)r.duration_ms,
+                          resetReasonToString(r.reset_reason));
+        }
+    }
+    stalls_logged_ = StallDetector::total();
 
     // Initialize Security Layer (if enabled in config)
     // Note: SecurityConfig needs to be retrieved from config
@@ -230,6 +288,7 @@ void EcoWattDevice::setup() {
         security_ = new SecurityLayer(sec_config);
         if (security_->begin()) {
             Logger::info("Security Layer initialized successfully");
+            logShaThroughput();
             
             // Create SEPARATE HTTP client for CLOUD operations (config/upload at 10.52.180.183)
             EcoHttpClient* cloud_http_client = new EcoHttpClient(api_conf.upload_base_url, mbc.timeout_ms);
@@ -246,6 +305,12 @@ void EcoWattDevice::setup() {
                 secure_http_ = new SecureHttpClient(cloud_http_client, security_);
                 Logger::info("Secure HTTP Client initialized for CLOUD operations");
             }
+            
+            // Flash nonce state lags or is lost across reboots; ask the server where it is
+            nonce_resync_ms_ = millis();
+            if (!secure_http_->resyncNonce(device_id)) {
+                Logger::warn("Nonce resync failed, continuing from the saved/estimated nonce until a retry succeeds");
+            }
         } else {
             Logger::error("Failed to initialize Security Layer");
         }
@@ -261,19 +326,49 @@ void EcoWattDevice::setup() {
     if (!adapter_) {
         adapter_ = new ProtocolAdapter(config_, http_client_);
         Logger::info("ProtocolAdapter initialized with slave address %d", mbc.slave_address);
+        if (!mbc.tcp_host.empty()) {
+            modbus_tcp_ = new ModbusTcpClient(mbc.tcp_host, mbc.tcp_port, mbc.slave_address,
+                                              mbc.timeout_ms, mbc.max_in_flight);
+            if (modbus_tcp_->connect()) {
+                Logger::info("[ModbusTCP] Connected to %s:%u, up to %u requests in flight",
+                             mbc.tcp_host.c_str(), mbc.tcp_port, mbc.max_in_flight);
+            } else {
+                // Keep the transport anyway; the next poll reconnects
+                Logger::warn("[ModbusTCP] Connect to %s:%u failed (%s), will retry on the next poll",
+                             mbc.tcp_host.c_str(), mbc.tcp_port, modbus_tcp_->lastError().c_str());
+            }
+            adapter_->setTcpClient(modbus_tcp_);
+            if (mbc.hedge_reads) {
+                modbus_tcp_hedge_ = new ModbusTcpClient(mbc.tcp_host, mbc.tcp_port, mbc.slave_address,
+                                                        mbc.timeout_ms, 1);
+                modbus_tcp_hedge_->connect();   // or on the first hedge
+                adapter_->setHedgeClient(modbus_tcp_hedge_);
+                Logger::info("[ModbusTCP] Hedged reads on, duplicates on a second connection");
+            }
+        }
     }
 
-    // TEMPORARILY DISABLED FOR FOTA TESTING
-    /*
     if (!uplink_packetizer_) {
         uplink_packetizer_ = new UplinkPacketizer(storage_, secure_http_);
         // Use the upload endpoint directly (should be a full URL)
         uplink_packetizer_->setCloudEndpoint(api_conf.upload_endpoint);
-        uplink_packetizer_->begin(15 * 1000); // Upload every 15 seconds for demo
-        Logger::info("UplinkPacketizer initialized with security enabled, upload interval: 15 seconds");
+        uplink_packetizer_->setDeviceId(config_->getDeviceId());
+        UplinkBatchConfig batch = config_->getUplinkBatchConfig();
+        FlushTargets targets;
+        targets.target_bytes = batch.target_bytes;
+        uplink_packetizer_->setFlushTargets(targets);
+        uplink_packetizer_->setShadow(&shadow_);
+        uplink_packetizer_->setInverterHttp(http_client_);
+        if (modbus_tcp_hedge_) uplink_packetizer_->setHedgePolicy(&adapter_->hedgePolicy());
+        if (batch.fec_group) {
+            FecConfig fec;
+            fec.group = batch.fec_group;
+            uplink_packetizer_->setFec(fec);
+        }
+        uplink_packetizer_->begin(batch.max_age_ms);
+        Logger::info("UplinkPacketizer initialized with security enabled, flush at %u bytes or %u ms",
+                     (unsigned)batch.target_bytes, (unsigned)batch.max_age_ms);
     }
-    */
-    Logger::info("UplinkPacketizer TEMPORARILY DISABLED for FOTA testing");
 
     if (!scheduler_) {
         scheduler_ = new AcquisitionScheduler(adapter_, storage_, config_);
@@ -285,12 +380,17 @@ void EcoWattDevice::setup() {
 
     if (!command_executor_) {
         command_executor_ = new CommandExecutor(adapter_, config_, http_client_);
+        command_executor_->setDataStorage(storage_);
+        command_executor_->setLogStore(log_store_);
         Logger::info("CommandExecutor initialized");
     }
 
     // RemoteConfigHandler RE-ENABLED after increasing loop stack to 16KB
     if (!remote_config_handler_) {
         remote_config_handler_ = new RemoteConfigHandler(config_, secure_http_, command_executor_);
+        remote_config_handler_->setUplink(uplink_packetizer_);
+        log_store_->setUplink(uplink_packetizer_);
+        remote_config_handler_->setDeviceId(config_->getDeviceId());
         using namespace std::placeholders;
         remote_config_handler_->onConfigUpdate([this]() { onConfigUpdated(); });
         remote_config_handler_->onCommand([this](const CommandRequest& cmd) { onCommandReceived(cmd); });
@@ -321,7 +421,8 @@ void EcoWattDevice::setup() {
         if (fota_->begin()) {
             Logger::info("FOTA Manager initialized successfully");
 
-            // Report boot status to cloud
+            // Report boot status to cloud (through the shadow)
+            fota_->setShadow(&shadow_);
             fota_->reportBootStatus();
 
             // Check for firmware updates and start download immediately
@@ -352,11 +453,12 @@ void EcoWattDevice::setup() {
 
 void EcoWattDevice::loop() {
     // Main polling, control, and data acquisition loop
+    uint64_t loop_start = Profiler::active() ? profileClockUs() : 0;
     printMemoryStats("MainLoop");
     if (storage_) storage_->loop();
+    if (log_store_) log_store_->loop();
     if (scheduler_) scheduler_->loop();
-    // TEMPORARILY DISABLED FOR FOTA TESTING
-    // if (uplink_packetizer_) uplink_packetizer_->loop();
+    if (uplink_packetizer_) uplink_packetizer_->loop();
     if (remote_config_handler_) {
         remote_config_handler_->loop();
         // Also check for and execute commands
@@ -366,5 +468,136 @@ void EcoWattDevice::loop() {
         fota_->loop(); // Process FOTA chunk downloads
     }
     if (wifi_) wifi_->loop();
+    retryNonceResync_();
+    pumpSerialTap_();
+    if (Profiler::state() == ProfileState::CAPTURING) Profiler::loopDone(loop_start);
+    pumpProfile_();
+    logStalls_();
+    updateShadow_();
     // Other device logic...
 }
+
+bool EcoWattDevice::startSerialTap(uint32_t baud) {
+    if (!storage_ || baud == 0) return false;
+    Logger::info("[Tap] Streaming telemetry at %lu baud; text log muted", (unsigned long)baud);
+    Serial.flush();
+    Logger::setConsole(false);
+    Serial.updateBaudRate(baud);
+    serial_tap_.start(storage_->nextSequence());
+    return true;
+}
+
+void EcoWattDevice::stopSerialTap() {
+    if (!serial_tap_.active()) return;
+    serial_tap_.stop();
+    Serial.flush();
+    Serial.updateBaudRate(115200);
+    Logger::setConsole(true);
+    Logger::info("[Tap] Stopped: %s", serial_tap_.statsJson().c_str());
+}
+
+void EcoWattDevice::pumpSerialTap_() {
+    if (!serial_tap_.active() || !storage_) return;
+    // Only ever write what the UART buffer takes right now; the rest waits for the next pass
+    for (;;) {
+        if (serial_tap_.wantsSamples()) {
+            Sample buf[SerialTap::READ_SAMPLES];
+            uint32_t first_seq = 0;
+            int n = storage_->readFromSequence(serial_tap_.cursor(), buf, SerialTap::READ_SAMPLES, first_seq);
+            if (n <= 0 || serial_tap_.feed(buf, (size_t)n, first_seq) == 0) return;
+        }
+        size_t len = 0;
+        const uint8_t* data = serial_tap_.pending(len);
+        int room = Serial.availableForWrite();
+        if (room <= 0) return;
+        size_t written = Serial.write(data, len < (size_t)room ? len : (size_t)room);
+        serial_tap_.consume(written);
+        if (written < len) return;
+    }
+}
+
+void EcoWattDevice::logStalls_() {
+    uint32_t total = StallDetector::total();
+    if (total == stalls_logged_) return;
+    StallRecord r;
+    if (StallDetector::record(0, r)) {
+        Logger::warn("[Stall] %s/%s blocked loop() for %u ms (%u since last report)",
+                     cpuSubsystemToString((CpuSubsystem)r.subsystem), r.op, (unsigned)r.duration_ms,
+                     (unsigned)(total - stalls_logged_));
+    }
+    stalls_logged_ = total;
+}
+
+void EcoWattDevice::retryNonceResync_() {
+    // The boot-time resync fails when WiFi or the server is not up yet; keep trying
+    // while online until one succeeds
+    static const uint32_t NONCE_RESYNC_RETRY_MS = 30000;
+    if (!secure_http_ || secure_http_->nonceSynced() || !secure_http_->isSecurityEnabled() || !isOnline()) return;
+    uint32_t now = millis();
+    if (now - nonce_resync_ms_ < NONCE_RESYNC_RETRY_MS) return;
+    nonce_resync_ms_ = now;
+    if (secure_http_->resyncNonce(config_->getDeviceId())) Logger::info("Nonce resynced with the server");
+}
+
+void EcoWattDevice::updateShadow_() {
+    static const uint32_t SHADOW_UPDATE_MS = 5000;
+    uint32_t now = millis();
+    if (now - shadow_updated_ms_ < SHADOW_UPDATE_MS) return;
+    shadow_updated_ms_ = now;
+    // Quantized so that noise does not turn into deltas
+    int rssi = WiFi.status() == WL_CONNECTED ? WiFi.RSSI() : 0;
+    shadow_.set(ShadowField::RSSI_DBM, (int64_t)((rssi - 2) / 5 * 5));
+    shadow_.set(ShadowField::HEAP_MIN_KB, (int64_t)(ESP.getMinFreeHeap() / 1024));
+    shadow_.set(ShadowField::STALLS, (int64_t)StallDetector::total());
+    if (security_) {
+        shadow_.set(ShadowField::SECURITY, (int64_t)security_->replayAttempts(), (int64_t)security_->macFailures());
+    }
+    if (uplink_packetizer_) shadow_.set(ShadowField::FIDELITY, fidelityToString(uplink_packetizer_->fidelity()));
+    if (remote_config_handler_) shadow_.set(ShadowField::CONFIG_VERSION, (int64_t)remote_config_handler_->configVersion());
+}
+
+void EcoWattDevice::pumpProfile_() {
+    if (profile_blob_.empty()) {
+        if (Profiler::state() != ProfileState::CAPTURED) return;
+        profile_session_ = Profiler::sessionId();
+        size_t events = Profiler::events();
+        bool ok = uplink_packetizer_ && Profiler::serialize(profile_blob_);
+        Profiler::release();
+        if (!ok) {
+            std::vector<uint8_t>().swap(profile_blob_);
+            return;
+        }
+        profile_offset_ = 0;
+        Logger::info("[Profile] Capture %u done: %u events, %u bytes to send",
+                     (unsigned)profile_session_, (unsigned)events, (unsigned)profile_blob_.size());
+        return;
+    }
+
+    // Low priority: only top up the background lane, never fill it
+    if (uplink_packetizer_->lanes().pending(UplinkLane::BACKGROUND) >= 2) return;
+    if (!profile_lzss_) profile_lzss_ = new (std::nothrow) LzssEncoder();
+
+    // One LZSS window per chunk; a chunk LZSS does not shrink goes raw
+    const size_t CHUNK = LzssEncoder::MAX_INPUT;
+    const uint8_t* data = profile_blob_.data() + profile_offset_;
+    size_t len = profile_blob_.size() - profile_offset_;
+    if (len > CHUNK) len = CHUNK;
+    std::vector<uint8_t> packed(len);
+    size_t packed_len = profile_lzss_ ? profile_lzss_->compress(data, len, packed.data(), packed.size()) : 0;
+
+    char head[160];
+    snprintf(head, sizeof(head),
+             "{\"type\":\"profile_chunk\",\"command_id\":%u,\"seq\":%u,\"chunks\":%u,\"raw_len\":%u,"
+             "\"lzss\":%s,\"data\":\"",
+             (unsigned)profile_session_, (unsigned)(profile_offset_ / CHUNK),
+             (unsigned)((profile_blob_.size() + CHUNK - 1) / CHUNK), (unsigned)len, packed_len ? "true" : "false");
+    std::string body = head + (packed_len ? base64Encode(packed.data(), packed_len) : base64Encode(data, len)) + "\"}";
+    if (!uplink_packetizer_->enqueue(UplinkLane::BACKGROUND, body)) return;   // retried next pass
+
+    profile_offset_ += len;
+    if (profile_offset_ < profile_blob_.size()) return;
+    Logger::info("[Profile] Capture %u sent (%u bytes raw)", (unsigned)profile_session_, (unsigned)profile_blob_.size());
+    std::vector<uint8_t>().swap(profile_blob_);
+    delete profile_lzss_;
+    profile_lzss_ = nullptr;
+}
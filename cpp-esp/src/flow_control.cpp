@@ -0,0 +1,86 @@
+#include "../include/flow_control.hpp"
+#include <cctype>
+#include <cstdlib>
+
+uint32_t fnv1a32(const char* data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t fleetPhaseOffsetMs(const std::string& device_id, uint32_t interval_ms) {
+    if (interval_ms == 0) return 0;
+    return fnv1a32(device_id.data(), device_id.size()) % interval_ms;
+}
+
+static std::string trim(const std::string& s) {
+    size_t a = 0, b = s.size();
+    while (a < b && isspace((unsigned char)s[a])) ++a;
+    while (b > a && isspace((unsigned char)s[b - 1])) --b;
+    return s.substr(a, b - a);
+}
+
+bool parseRetryAfterMs(const std::string& value, uint32_t& out_ms) {
+    std::string v = trim(value);
+    if (v.empty()) return false;
+    for (char c : v) {
+        if (!isdigit((unsigned char)c)) return false;
+    }
+    // Capped before the multiply; more than 9 significant digits is over the cap anyway
+    size_t first = v.find_first_not_of('0');
+    unsigned long seconds = 0;
+    if (first != std::string::npos) {
+        seconds = v.size() - first > 9 ? RETRY_AFTER_MAX_S : strtoul(v.c_str() + first, nullptr, 10);
+    }
+    if (seconds > RETRY_AFTER_MAX_S) seconds = RETRY_AFTER_MAX_S;
+    out_ms = (uint32_t)seconds * 1000u;
+    return true;
+}
+
+bool parseNextIntervalMs(const std::string& value, uint32_t& out_ms) {
+    std::string v = trim(value);
+    if (v.empty()) return false;
+    char* end = nullptr;
+    double seconds = strtod(v.c_str(), &end);
+    if (end == v.c_str() || *end != '\0' || seconds <= 0.0 || seconds > 86400.0) return false;
+    out_ms = (uint32_t)(seconds * 1000.0 + 0.5);
+    return true;
+}
+
+FlowControl::FlowControl(uint32_t min_interval_ms, uint32_t max_interval_ms)
+    : min_interval_ms_(min_interval_ms), max_interval_ms_(max_interval_ms) {}
+
+bool FlowControl::applyHints(const std::string& retry_after, const std::string& next_interval, uint32_t now_ms) {
+    uint32_t ms = 0;
+    if (!retry_after.empty() && parseRetryAfterMs(retry_after, ms)) {
+        // Never wait longer than the longest upload interval; this also keeps the deadline
+        // well inside the signed-difference range canSend relies on
+        if (ms > max_interval_ms_) ms = max_interval_ms_;
+        // Up to +25% per-device jitter so a fleet told "retry in 30s" does not return as one
+        uint32_t jitter = ms ? jitter_seed_ % (ms / 4 + 1) : 0;
+        defer_until_ms_ = now_ms + ms + jitter;
+        deferred_ = true;
+        deferrals_++;
+    }
+
+    if (!next_interval.empty() && parseNextIntervalMs(next_interval, ms)) {
+        if (ms < min_interval_ms_) ms = min_interval_ms_;
+        if (ms > max_interval_ms_) ms = max_interval_ms_;
+        if (ms != interval_ms_) {
+            interval_ms_ = ms;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FlowControl::canSend(uint32_t now_ms) const {
+    return !deferred_ || (int32_t)(now_ms - defer_until_ms_) >= 0;
+}
+
+uint32_t FlowControl::deferRemainingMs(uint32_t now_ms) const {
+    return canSend(now_ms) ? 0 : defer_until_ms_ - now_ms;
+}
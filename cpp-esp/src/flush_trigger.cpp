@@ -0,0 +1,78 @@
+#include "../include/flush_trigger.hpp"
+
+const char* flushReasonToString(FlushReason reason) {
+    switch (reason) {
+        case FlushReason::NONE: return "none";
+        case FlushReason::SIZE: return "size";
+        case FlushReason::AGE: return "age";
+        case FlushReason::URGENT: return "urgent";
+        default: return "unknown";
+    }
+}
+
+static uint32_t clampU32(uint32_t v, uint32_t lo, uint32_t hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+FlushTrigger::FlushTrigger(const FlushTargets& targets) { setTargets(targets); }
+
+void FlushTrigger::setTargets(const FlushTargets& targets) {
+    t_.target_bytes = clampU32(targets.target_bytes, MIN_TARGET_BYTES, MAX_TARGET_BYTES);
+    t_.max_age_ms = clampU32(targets.max_age_ms, MIN_MAX_AGE_MS, MAX_MAX_AGE_MS);
+    t_.min_gap_ms = targets.min_gap_ms < t_.max_age_ms ? targets.min_gap_ms : t_.max_age_ms;
+}
+
+uint32_t FlushTrigger::estimateBytes(uint32_t samples) const {
+    return (uint32_t)(((uint64_t)samples * milli_bytes_per_sample_ + 999) / 1000);
+}
+
+void FlushTrigger::observeEncoded(uint32_t samples, uint32_t bytes) {
+    if (samples == 0) return;
+    uint32_t rate = (uint32_t)((uint64_t)bytes * 1000 / samples);
+    // EWMA with weight 1/4 so one odd cycle (e.g. a lone RAW fallback) does not swing it
+    milli_bytes_per_sample_ = (milli_bytes_per_sample_ * 3 + rate) / 4;
+    if (milli_bytes_per_sample_ == 0) milli_bytes_per_sample_ = 1;
+}
+
+FlushReason FlushTrigger::evaluate(const FlushInputs& in, uint32_t now_ms) const {
+    if (in.urgent) return FlushReason::URGENT;
+    bool pending = in.pending_samples > 0 || in.queued_bytes > 0;
+    if (!pending) return FlushReason::NONE;
+
+    uint32_t since = flushed_ ? now_ms - last_flush_ms_ : 0xFFFFFFFFu;
+    if (since < backoff_ms_) return FlushReason::NONE;
+
+    uint32_t max_age = t_.max_age_ms;
+    if (!flushed_ && phase_ms_ && phase_ms_ < max_age) max_age = phase_ms_;
+    if (in.pending_samples > 0 && in.oldest_age_ms >= max_age) return FlushReason::AGE;
+    if (since < t_.min_gap_ms) return FlushReason::NONE;
+    uint32_t bytes = estimateBytes(in.pending_samples) + in.queued_bytes;
+    bool ring_half_full = in.sample_capacity > 0 && in.pending_samples * 2 >= in.sample_capacity;
+    if (bytes >= t_.target_bytes || ring_half_full) return FlushReason::SIZE;
+    return FlushReason::NONE;
+}
+
+void FlushTrigger::onFlush(FlushReason reason, bool success, uint32_t now_ms) {
+    if (reason == FlushReason::NONE) return;
+    counts_[(size_t)reason]++;
+    flushed_ = true;
+    last_flush_ms_ = now_ms;
+    if (success) {
+        backoff_ms_ = 0;
+        return;
+    }
+    failed_++;
+    uint32_t base = t_.min_gap_ms ? t_.min_gap_ms : 1000;
+    backoff_ms_ = backoff_ms_ ? backoff_ms_ * 2 : base;
+    if (backoff_ms_ > t_.max_age_ms) backoff_ms_ = t_.max_age_ms;
+}
+
+std::string FlushTrigger::statsJson() const {
+    return "{\"target_bytes\":" + std::to_string(t_.target_bytes) +
+           ",\"max_age_ms\":" + std::to_string(t_.max_age_ms) +
+           ",\"size\":" + std::to_string(counts_[(size_t)FlushReason::SIZE]) +
+           ",\"age\":" + std::to_string(counts_[(size_t)FlushReason::AGE]) +
+           ",\"urgent\":" + std::to_string(counts_[(size_t)FlushReason::URGENT]) +
+           ",\"failed\":" + std::to_string(failed_) +
+           ",\"backoff_ms\":" + std::to_string(backoff_ms_) + "}";
+}
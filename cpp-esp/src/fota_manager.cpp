@@ -1,11 +1,12 @@
 #include "../include/fota_manager.hpp"
 #include "../include/logger.hpp"
+#include "../include/cpu_accounting.hpp"
+#include "../include/stall_detector.hpp"
+#include "../include/secure_envelope.hpp"
 #include <esp_ota_ops.h>
 #include <esp_partition.h>
 #include <ArduinoJson.h>
-
-// Forward declaration of base64_decode
-static size_t base64_decode(char* output, const char* input, size_t inputLen);
+#include <algorithm>
 
 FOTAManager::FOTAManager(EcoHttpClient* http, SecurityLayer* security, const std::string& cloud_base_url)
     : http_(http)
@@ -153,6 +154,9 @@ bool FOTAManager::startDownload() {
     chunks_downloaded_.clear();
     chunks_downloaded_.resize(manifest_.total_chunks, false);
     
+    image_hash_.reset();
+    image_hashed_bytes_ = 0;
+    
     progress_.chunks_received = 0;
     progress_.bytes_received = 0;
     
@@ -210,7 +214,10 @@ bool FOTAManager::processChunk() {
         setState(FOTAState::WRITING);
         
         // Small delay before reboot for demo visibility
-        delay(2000);
+        {
+            StallScope stall(CpuSubsystem::FOTA, "apply_delay");
+            delay(2000);
+        }
         
         return applyUpdate();
     }
@@ -241,9 +248,40 @@ bool FOTAManager::verifyFirmware() {
     
     Logger::info("[FOTA] All %u chunks written to OTA partition (%u bytes)", 
                 progress_.chunks_received, progress_.bytes_received);
+    
+    // Integrity: the image must hash to the manifest value before it becomes bootable
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    image_hash_.finish(digest);
+    static const char* hex_chars = "0123456789abcdef";
+    std::string computed_hash;
+    computed_hash.reserve(SHA256_DIGEST_SIZE * 2);
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        computed_hash += hex_chars[digest[i] >> 4];
+        computed_hash += hex_chars[digest[i] & 0x0F];
+    }
+    std::string expected_hash = manifest_.hash;
+    std::transform(expected_hash.begin(), expected_hash.end(), expected_hash.begin(), ::tolower);
+    
+    if (image_hashed_bytes_ != manifest_.size || computed_hash != expected_hash) {
+        std::string error_msg = "SHA-256 mismatch: expected " + expected_hash.substr(0, 16) +
+                                "..., got " + computed_hash.substr(0, 16) + "... over " +
+                                std::to_string(image_hashed_bytes_) + " bytes";
+        Logger::error("[FOTA] %s", error_msg.c_str());
+        Update.abort();
+        setState(FOTAState::FAILED, error_msg);
+        logFOTAEvent("verification_failed", error_msg);
+        return false;
+    }
+    Logger::info("[FOTA] ✓ SHA-256 matches manifest (%s)", sha256BackendName(image_hash_.backend()));
+    
     Logger::info("[FOTA] Finalizing OTA update...");
     
-    if (!Update.end(true)) {  // true = set boot partition
+    bool ended;
+    {
+        StallScope stall(CpuSubsystem::FOTA, "update_end");
+        ended = Update.end(true);  // true = set boot partition
+    }
+    if (!ended) {
         String error_msg = "OTA end failed: " + String(Update.getError());
         Logger::error("[FOTA] %s", error_msg.c_str());
         setState(FOTAState::FAILED, error_msg.c_str());
@@ -296,6 +334,7 @@ bool FOTAManager::applyUpdate() {
     }
     
     Logger::info("[FOTA] Rebooting in 3 seconds...");
+    StallScope stall(CpuSubsystem::FOTA, "reboot_wait");
     delay(3000);
     
     ESP.restart();
@@ -340,6 +379,7 @@ bool FOTAManager::rollback(const std::string& reason) {
     reset();
     
     Logger::info("[FOTA] Rebooting for rollback in 3 seconds...");
+    StallScope stall(CpuSubsystem::FOTA, "rollback_wait");
     delay(3000);
     
     ESP.restart();
@@ -348,6 +388,12 @@ bool FOTAManager::rollback(const std::string& reason) {
 }
 
 bool FOTAManager::reportProgress(bool force) {
+    if (shadow_) {
+        updateShadow();
+        // A restart follows: the next uplink would never carry it
+        if (progress_.state != FOTAState::REBOOTING && progress_.state != FOTAState::ROLLBACK) return true;
+    }
+    
     if (!force) {
         unsigned long now = millis();
         if (now - last_report_ms_ < REPORT_INTERVAL_MS) {
@@ -463,6 +509,13 @@ bool FOTAManager::reportBootStatus() {
         Logger::warn("[FOTA] Boot count: %d", boot_count);
     }
     
+    if (shadow_) {
+        shadow_->set(ShadowField::BOOT_STATUS, boot_success ? "success" : "failed");
+        shadow_->set(ShadowField::BOOT_COUNT, boot_count);
+        updateShadow();
+        return true;
+    }
+    
     std::string json_str;
     serializeJson(doc, json_str);
     
@@ -501,6 +554,7 @@ void FOTAManager::loop() {
     if (progress_.state != FOTAState::DOWNLOADING) {
         return;
     }
+    CpuScope cpu(CpuSubsystem::FOTA);
     
     // Add significant throttling to prevent crashes
     static unsigned long last_chunk_time = 0;
@@ -522,7 +576,11 @@ void FOTAManager::loop() {
     
     // Process one chunk with extensive safety
     Logger::info("[FOTA] Auto-processing next chunk (2s interval)");
-    bool success = processChunk();
+    bool success;
+    {
+        StallScope stall(CpuSubsystem::FOTA, "process_chunk");
+        success = processChunk();
+    }
     last_chunk_time = now;
     
     // Give the system time to breathe
@@ -658,26 +716,23 @@ bool FOTAManager::fetchChunk(uint32_t chunk_number) {
     size_t decoded_len = (b64_len * 3) / 4;
     
     // Safety check for decoded length (16KB max)
-    if (decoded_len == 0 || decoded_len > 20480) {
+    if (decoded_len == 0 || decoded_len > MAX_CHUNK_BYTES) {
         Logger::error("[FOTA] Invalid decoded length: %u (from b64_len=%u)", decoded_len, b64_len);
         return false;
     }
     
-    uint8_t* decoded = new uint8_t[decoded_len + 1];
-    
-    // Simple base64 decode (using Arduino's base64 or manual implementation)
-    size_t actual_len = base64_decode((char*)decoded, data_b64, b64_len);
+    if (chunk_buf_.size() < MAX_CHUNK_BYTES) chunk_buf_.resize(MAX_CHUNK_BYTES);
+    uint8_t* decoded = chunk_buf_.data();
+    size_t actual_len = base64Decode(data_b64, b64_len, decoded, chunk_buf_.size());
     
     if (actual_len == 0) {
         Logger::error("[FOTA] Failed to decode base64 chunk data");
-        delete[] decoded;
         return false;
     }
     
     // Verify HMAC
-    if (!verifyChunkHMAC(decoded, actual_len, std::string(mac_hex))) {
+    if (!verifyChunkHMAC(decoded, actual_len, mac_hex)) {
         Logger::error("[FOTA] Chunk %u HMAC verification failed", chunk_number);
-        delete[] decoded;
         logFOTAEvent("chunk_hmac_failed", "Chunk: " + std::to_string(chunk_number));
         return false;
     }
@@ -685,12 +740,9 @@ bool FOTAManager::fetchChunk(uint32_t chunk_number) {
     // Save chunk to file
     if (!saveFirmwareChunk(chunk_number, decoded, actual_len)) {
         Logger::error("[FOTA] Failed to save chunk %u", chunk_number);
-        delete[] decoded;
         return false;
     }
     
-    delete[] decoded;
-    
     // Mark chunk as downloaded
     chunks_downloaded_[chunk_number] = true;
     progress_.chunks_received++;
@@ -838,6 +890,10 @@ bool FOTAManager::saveFirmwareChunk(uint32_t chunk_number, const uint8_t* data,
         return false;
     }
     
+    // Chunks are written strictly in order, so the image hash can be built incrementally
+    image_hash_.update(data, size);
+    image_hashed_bytes_ += size;
+    
     Logger::info("[FOTA] ✓ Chunk %u written to OTA partition (%u bytes)", chunk_number, written);
     
     return true;
@@ -846,9 +902,35 @@ bool FOTAManager::saveFirmwareChunk(uint32_t chunk_number, const uint8_t* data,
 // REMOVED: clearFirmwareFile() - no longer needed since we write directly to OTA partition
 // No temporary firmware file is created anymore
 
+const char* fotaStateToString(FOTAState state) {
+    switch (state) {
+        case FOTAState::IDLE: return "idle";
+        case FOTAState::CHECKING_MANIFEST: return "checking_manifest";
+        case FOTAState::DOWNLOADING: return "downloading";
+        case FOTAState::VERIFYING: return "verifying";
+        case FOTAState::WRITING: return "writing";
+        case FOTAState::REBOOTING: return "rebooting";
+        case FOTAState::BOOT_VERIFICATION: return "boot_verification";
+        case FOTAState::ROLLBACK: return "rollback";
+        case FOTAState::COMPLETED: return "completed";
+        case FOTAState::FAILED: return "failed";
+        default: return "unknown";
+    }
+}
+
+void FOTAManager::updateShadow() {
+    if (!shadow_) return;
+    if (!progress_.current_version.empty()) shadow_->set(ShadowField::FIRMWARE, progress_.current_version);
+    shadow_->set(ShadowField::FOTA_STATE, fotaStateToString(progress_.state));
+    shadow_->set(ShadowField::FOTA_CHUNKS, progress_.chunks_received, progress_.total_chunks);
+    shadow_->set(ShadowField::FOTA_ERROR, progress_.error_message);
+}
+
 void FOTAManager::setState(FOTAState state, const std::string& error) {
     progress_.state = state;
     progress_.error_message = error;
+    if (state != FOTAState::DOWNLOADING) std::vector<uint8_t>().swap(chunk_buf_);
+    updateShadow();
     
     if (!error.empty()) {
         Logger::error("[FOTA] State changed to %d: %s", (int)state, error.c_str());
@@ -857,17 +939,14 @@ void FOTAManager::setState(FOTAState state, const std::string& error) {
     }
 }
 
-bool FOTAManager::verifyChunkHMAC(const uint8_t* data, size_t size, const std::string& mac_hex) {
+bool FOTAManager::verifyChunkHMAC(const uint8_t* data, size_t size, const char* mac_hex) {
     if (!security_) {
         Logger::warn("[FOTA] Security layer not available, skipping HMAC verification");
         return true;
     }
     
-    // Compute HMAC
-    std::string data_str((char*)data, size);
-    std::string computed_mac = security_->computeHMAC(data_str, security_->getConfig().psk);
-    
-    return computed_mac == mac_hex;
+    // Straight from the decoded buffer, compared against the hex without building strings
+    return security_->verifyHMAC(data, size, mac_hex);
 }
 
 int FOTAManager::getBootCount() {
@@ -926,32 +1005,3 @@ void FOTAManager::logFOTAEvent(const std::string& event_type, const std::string&
     // Optionally send to cloud as well
     // This could be integrated into reportProgress or sent separately
 }
-
-// ========== Base64 Decode Helper ==========
-// Simple base64 decode implementation
-size_t base64_decode(char* output, const char* input, size_t inputLen) {
-    static const char base64_table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    
-    size_t out_len = 0;
-    uint32_t bits = 0;
-    int bits_collected = 0;
-    
-    for (size_t i = 0; i < inputLen; i++) {
-        char c = input[i];
-        if (c == '=') break;
-        
-        const char* p = strchr(base64_table, c);
-        if (!p) continue;
-        
-        bits = (bits << 6) | (p - base64_table);
-        bits_collected += 6;
-        
-        if (bits_collected >= 8) {
-            bits_collected -= 8;
-            output[out_len++] = (bits >> bits_collected) & 0xFF;
-            bits &= (1 << bits_collected) - 1;
-        }
-    }
-    
-    return out_len;
-}
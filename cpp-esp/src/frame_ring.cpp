@@ -0,0 +1,167 @@
+#include "../include/frame_ring.hpp"
+#include <cstring>
+
+static size_t popcount16(uint16_t v) {
+    size_t n = 0;
+    for (; v; v &= (uint16_t)(v - 1)) n++;
+    return n;
+}
+
+size_t SampleFrame::count() const { return popcount16(present); }
+
+FrameRing::FrameRing(size_t bytes) : cap_(bytes) {
+    // Must hold at least one full frame
+    size_t min_bytes = RECORD_HEADER + 4 * SampleFrame::MAX_REGISTERS;
+    if (cap_ < min_bytes) cap_ = min_bytes;
+    buf_ = new uint8_t[cap_];
+}
+
+FrameRing::~FrameRing() { delete[] buf_; }
+
+static uint16_t presentAt(const uint8_t* rec) {
+    uint16_t present;
+    memcpy(&present, rec + 4, sizeof(present));
+    return present;
+}
+
+size_t FrameRing::nextRecord(size_t pos) const {
+    pos += RECORD_HEADER + 4 * popcount16(presentAt(buf_ + pos));
+    if (wrapped_ && pos == end_) pos = 0;
+    return pos;
+}
+
+void FrameRing::dropOldest() {
+    size_t n = popcount16(presentAt(buf_ + tail_));
+    size_t len = RECORD_HEADER + 4 * n;
+    first_seq_ += (uint32_t)n;
+    used_ -= len;
+    frames_--;
+    tail_ += len;
+    if (wrapped_ && tail_ == end_) {
+        tail_ = 0;
+        wrapped_ = false;
+    }
+    if (frames_ == 0) {
+        tail_ = head_ = 0;
+        wrapped_ = false;
+    }
+}
+
+bool FrameRing::append(const SampleFrame& frame) {
+    size_t n = frame.count();
+    if (n == 0) return false;
+    size_t len = RECORD_HEADER + 4 * n;
+
+    // Records never straddle the end of the buffer: a record that does not fit after
+    // head_ goes to the start, evicting the oldest frames until it has room
+    for (;;) {
+        if (!wrapped_) {
+            if (head_ + len <= cap_) break;
+            end_ = head_;
+            head_ = 0;
+            wrapped_ = true;
+        }
+        if (head_ + len <= tail_) break;
+        dropOldest();
+    }
+
+    uint8_t* rec = buf_ + head_;
+    memcpy(rec, &frame.timestamp, 4);
+    memcpy(rec + 4, &frame.present, 2);
+    size_t off = RECORD_HEADER;
+    for (uint8_t reg = 0; reg < SampleFrame::MAX_REGISTERS; ++reg) {
+        if (!(frame.present & (1u << reg))) continue;
+        memcpy(rec + off, &frame.values[reg], 4);
+        off += 4;
+    }
+    head_ += len;
+    used_ += len;
+    frames_++;
+    next_seq_ += (uint32_t)n;
+    last_count_ = (uint8_t)n;
+    return true;
+}
+
+size_t FrameRing::appendSamples(const Sample* samples, size_t count) {
+    size_t appended = 0;
+    SampleFrame frame;
+    int last_reg = -1;
+    for (size_t i = 0; i < count; ++i) {
+        const Sample& s = samples[i];
+        if (s.reg_addr >= SampleFrame::MAX_REGISTERS) continue;
+        if (frame.present && (s.timestamp != frame.timestamp || (int)s.reg_addr <= last_reg)) {
+            if (append(frame)) appended++;
+            frame = SampleFrame();
+        }
+        frame.timestamp = s.timestamp;
+        frame.set(s.reg_addr, s.value);
+        last_reg = s.reg_addr;
+    }
+    if (append(frame)) appended++;
+    return appended;
+}
+
+void FrameRing::clear() {
+    tail_ = head_ = end_ = 0;
+    wrapped_ = false;
+    frames_ = 0;
+    used_ = 0;
+    first_seq_ = next_seq_;
+}
+
+size_t FrameRing::sampleCapacity() const {
+    size_t k = last_count_ ? last_count_ : 1;
+    return cap_ / (RECORD_HEADER + 4 * k) * k;
+}
+
+void FrameRing::setNextSequence(uint32_t seq) {
+    first_seq_ = seq - (uint32_t)samples();
+    next_seq_ = seq;
+}
+
+size_t FrameRing::expand(size_t pos, uint32_t seq, uint32_t from_seq, Sample* out, size_t max) const {
+    const uint8_t* rec = buf_ + pos;
+    uint32_t ts;
+    memcpy(&ts, rec, 4);
+    uint16_t present = presentAt(rec);
+    size_t off = RECORD_HEADER;
+    size_t n = 0;
+    for (uint8_t reg = 0; reg < SampleFrame::MAX_REGISTERS && n < max; ++reg) {
+        if (!(present & (1u << reg))) continue;
+        if ((int32_t)(seq - from_seq) >= 0) {
+            out[n].timestamp = ts;
+            out[n].reg_addr = reg;
+            memcpy(&out[n].value, rec + off, 4);
+            n++;
+        }
+        seq++;
+        off += 4;
+    }
+    return n;
+}
+
+size_t FrameRing::readFromSequence(uint32_t from_seq, Sample* out, size_t max, uint32_t& first_seq) const {
+    uint32_t start = from_seq;
+    if ((int32_t)(start - first_seq_) < 0) start = first_seq_;   // overwritten before it was read
+    if ((int32_t)(next_seq_ - start) < 0) start = next_seq_;     // cursor from a previous boot
+    first_seq = start;
+
+    size_t got = 0;
+    uint32_t seq = first_seq_;
+    size_t pos = tail_;
+    for (size_t f = 0; f < frames_ && got < max; ++f) {
+        uint32_t n = (uint32_t)popcount16(presentAt(buf_ + pos));
+        if ((int32_t)(seq + n - start) > 0) got += expand(pos, seq, start, out + got, max - got);
+        seq += n;
+        pos = nextRecord(pos);
+    }
+    return got;
+}
+
+size_t FrameRing::readLast(size_t n, Sample* out, size_t max) const {
+    size_t k = samples();
+    if (k > n) k = n;
+    if (k > max) k = max;
+    uint32_t first_seq;
+    return readFromSequence(next_seq_ - (uint32_t)k, out, k, first_seq);
+}
@@ -0,0 +1,52 @@
+#include "../include/hedge_policy.hpp"
+#include <algorithm>
+#include <cstdio>
+
+uint32_t HedgePolicy::percentileUs(uint8_t pct) const {
+    if (filled_ == 0) return 0;
+    uint32_t sorted[WINDOW];
+    std::copy(window_, window_ + filled_, sorted);
+    size_t rank = (filled_ * (pct > 100 ? 100 : pct) + 99) / 100;   // nearest rank
+    if (rank == 0) rank = 1;
+    std::nth_element(sorted, sorted + rank - 1, sorted + filled_);
+    return sorted[rank - 1];
+}
+
+uint32_t HedgePolicy::delayUs() const {
+    if (filled_ < config_.min_samples || filled_ == 0) return 0;
+    uint32_t p95 = percentileUs(95);
+    return p95 > config_.min_delay_us ? p95 : config_.min_delay_us;
+}
+
+void HedgePolicy::onRead() {
+    reads_++;
+    credits_ += config_.budget_pct;
+    uint32_t cap = (uint32_t)config_.burst * 100;
+    if (credits_ > cap) credits_ = cap;
+}
+
+bool HedgePolicy::takeHedge() {
+    if (credits_ < 100) {
+        denied_++;
+        return false;
+    }
+    credits_ -= 100;
+    hedges_++;
+    return true;
+}
+
+void HedgePolicy::onComplete(uint32_t latency_us, bool hedge_won) {
+    window_[head_] = latency_us;
+    head_ = (head_ + 1) % WINDOW;
+    if (filled_ < WINDOW) filled_++;
+    if (hedge_won) hedge_wins_++;
+}
+
+std::string HedgePolicy::json() const {
+    char buf[192];
+    snprintf(buf, sizeof(buf),
+             "{\"reads\":%u,\"hedges\":%u,\"wins\":%u,\"denied\":%u,\"p50_us\":%u,\"p95_us\":%u,\"p99_us\":%u}",
+             (unsigned)reads_, (unsigned)hedges_, (unsigned)hedge_wins_, (unsigned)denied_,
+             (unsigned)percentileUs(50), (unsigned)percentileUs(95), (unsigned)percentileUs(99));
+    return std::string(buf);
+}
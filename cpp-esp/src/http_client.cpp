@@ -3,9 +3,27 @@
 #include <HTTPClient.h>
 #endif
 #include "../include/http_client.hpp"
+#include "../include/cpu_accounting.hpp"
+#include "../include/profiler.hpp"
+#include "../include/stall_detector.hpp"
+
+// Response headers the server uses to shape fleet load
+static const char* kFlowHeaders[] = {"Retry-After", "X-Next-Interval"};
+
+static void readFlowHeaders(HTTPClient& http, EcoHttpResponse& response) {
+    if (http.hasHeader("Retry-After")) response.retry_after = http.header("Retry-After").c_str();
+    if (http.hasHeader("X-Next-Interval")) response.next_interval = http.header("X-Next-Interval").c_str();
+}
+
+static RttLimits rttLimitsFor(uint32_t timeout_ms) {
+    RttLimits limits;
+    if (timeout_ms) limits.initial_ms = timeout_ms;
+    if (limits.max_ms < limits.initial_ms) limits.max_ms = limits.initial_ms;
+    return limits;
+}
 
 EcoHttpClient::EcoHttpClient(const std::string& base_url, uint32_t timeout_ms)
-    : base_url_(base_url), timeout_ms_(timeout_ms) {}
+    : base_url_(base_url), timeout_ms_(timeout_ms), rtt_(rttLimitsFor(timeout_ms)) {}
 
 EcoHttpClient::~EcoHttpClient() {}
 
@@ -17,9 +35,64 @@ void EcoHttpClient::setDefaultHeaders(const char* keys[], const char* values[],
     }
 }
 
+void EcoHttpClient::recordRtt_(const char* endpoint, int http_code, uint32_t elapsed_ms, uint32_t timeout_ms) {
+    if (http_code > 0) {
+        rtt_.onSample(endpoint, elapsed_ms);
+    } else if (http_code == HTTPC_ERROR_READ_TIMEOUT || elapsed_ms >= timeout_ms) {
+        // A refused connection fails at once and says nothing about the round trip
+        rtt_.onTimeout(endpoint);
+    }
+}
+
+// Feeds a multi-slice chain to HTTPClient, which pulls it through its send buffer
+class IoChainStream : public Stream {
+public:
+    explicit IoChainStream(const IoChain& chain) : chain_(chain) {}
+    int available() override { return (int)(chain_.length() - pos_); }
+    int read() override {
+        int c = peek();
+        if (c >= 0) ++pos_;
+        return c;
+    }
+    int peek() override {
+        uint8_t c;
+        return chain_.copyOut(pos_, &c, 1) ? c : -1;
+    }
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t n = chain_.copyOut(pos_, buffer, length);
+        pos_ += n;
+        if (chain_.pool()) chain_.pool()->countCopy(n);
+        return n;
+    }
+    size_t write(uint8_t) override { return 0; }
+
+private:
+    const IoChain& chain_;
+    size_t pos_ = 0;
+};
+
 EcoHttpResponse EcoHttpClient::post(const char* endpoint, const char* data, size_t len,
                               const char* content_type,
                               const char* header_keys[], const char* header_values[], int header_count) {
+    return postImpl(endpoint, data, len, nullptr, content_type, header_keys, header_values, header_count);
+}
+
+EcoHttpResponse EcoHttpClient::post(const char* endpoint, const IoChain& body, const char* content_type) {
+    if (body.pool()) body.pool()->countSent(body.length());
+    if (body.count() <= 1) {
+        const char* data = body.count() ? (const char*)body[0].data() : "";
+        return postImpl(endpoint, data, body.length(), nullptr, content_type, nullptr, nullptr, 0);
+    }
+    IoChainStream stream(body);
+    return postImpl(endpoint, nullptr, body.length(), &stream, content_type, nullptr, nullptr, 0);
+}
+
+EcoHttpResponse EcoHttpClient::postImpl(const char* endpoint, const char* data, size_t len, Stream* stream,
+                                        const char* content_type,
+                                        const char* header_keys[], const char* header_values[], int header_count) {
+    CpuScope cpu(CpuSubsystem::NETWORK);
+    StallScope stall(CpuSubsystem::NETWORK, "http_post");
+    uint64_t started = Profiler::active() ? profileClockUs() : 0;
     EcoHttpResponse response;
     char url[256];
     // If endpoint starts with "http", treat it as a full URL
@@ -28,14 +101,17 @@ EcoHttpResponse EcoHttpClient::post(const char* endpoint, const char* data, size
     } else {
         snprintf(url, sizeof(url), "%s%s", base_url_.c_str(), endpoint);
     }
+    uint32_t timeout_ms = rtt_.timeoutMs(endpoint);
     HTTPClient http;
     #if defined(ESP8266)
         WiFiClient client;
         http.begin(client, url);
-        uint32_t to_sec = timeout_ms_ ? ((timeout_ms_ + 999) / 1000) : 5;
+        uint32_t to_sec = (timeout_ms + 999) / 1000;
         http.setTimeout((int)to_sec);
     #elif defined(ESP32)
         http.begin(url);
+        http.setConnectTimeout((int32_t)timeout_ms);
+        http.setTimeout((uint16_t)(timeout_ms < 65535 ? timeout_ms : 65535));
     #endif
     if (content_type && strlen(content_type) > 0) {
         http.addHeader("Content-Type", content_type);
@@ -56,8 +132,13 @@ EcoHttpResponse EcoHttpClient::post(const char* endpoint, const char* data, size
         response.header_values[total_headers] = header_values[i];
     }
     response.header_count = total_headers;
-    int httpCode = http.POST((uint8_t*)data, len);
+    http.collectHeaders(kFlowHeaders, 2);
+    uint32_t sent_ms = millis();
+    int httpCode = stream ? http.sendRequest("POST", stream, len) : http.POST((uint8_t*)data, len);
+    recordRtt_(endpoint, httpCode, millis() - sent_ms, timeout_ms);
     response.status_code = httpCode;
+    if (started) Profiler::request(started, httpCode);
+    readFlowHeaders(http, response);
     {
         String s = http.getString();
         response.body = std::string(s.c_str());
@@ -68,6 +149,9 @@ EcoHttpResponse EcoHttpClient::post(const char* endpoint, const char* data, size
 
 EcoHttpResponse EcoHttpClient::get(const char* endpoint,
                              const char* header_keys[], const char* header_values[], int header_count) {
+    CpuScope cpu(CpuSubsystem::NETWORK);
+    StallScope stall(CpuSubsystem::NETWORK, "http_get");
+    uint64_t started = Profiler::active() ? profileClockUs() : 0;
     EcoHttpResponse response;
     char url[256];
     // If endpoint starts with "http", treat it as a full URL
@@ -76,14 +160,17 @@ EcoHttpResponse EcoHttpClient::get(const char* endpoint,
     } else {
         snprintf(url, sizeof(url), "%s%s", base_url_.c_str(), endpoint);
     }
+    uint32_t timeout_ms = rtt_.timeoutMs(endpoint);
     HTTPClient http;
     #if defined(ESP8266)
         WiFiClient client;
         http.begin(client, url);
-        uint32_t to_sec = timeout_ms_ ? ((timeout_ms_ + 999) / 1000) : 5;
+        uint32_t to_sec = (timeout_ms + 999) / 1000;
         http.setTimeout((int)to_sec);
     #elif defined(ESP32)
         http.begin(url);
+        http.setConnectTimeout((int32_t)timeout_ms);
+        http.setTimeout((uint16_t)(timeout_ms < 65535 ? timeout_ms : 65535));
     #endif
     // Add default headers
     for (int i = 0; i < default_header_count; ++i) {
@@ -99,8 +186,13 @@ EcoHttpResponse EcoHttpClient::get(const char* endpoint,
         response.header_values[total_headers] = header_values[i];
     }
     response.header_count = total_headers;
+    http.collectHeaders(kFlowHeaders, 2);
+    uint32_t sent_ms = millis();
     int httpCode = http.GET();
+    recordRtt_(endpoint, httpCode, millis() - sent_ms, timeout_ms);
     response.status_code = httpCode;
+    if (started) Profiler::request(started, httpCode);
+    readFlowHeaders(http, response);
     {
         String s = http.getString();
         response.body = std::string(s.c_str());
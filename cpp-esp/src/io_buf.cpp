@@ -0,0 +1,254 @@
+#include "../include/io_buf.hpp"
+#include <cstring>
+
+// ---------- IoBuf ----------
+
+IoBuf::IoBuf(IoBufBlock* block, uint8_t* data, size_t len) : block_(block), data_(data), len_(len) {
+    if (block_) block_->refs++;
+}
+
+IoBuf::IoBuf(const IoBuf& other) : block_(other.block_), data_(other.data_), len_(other.len_) {
+    if (block_) block_->refs++;
+}
+
+IoBuf::IoBuf(IoBuf&& other) noexcept : block_(other.block_), data_(other.data_), len_(other.len_) {
+    other.block_ = nullptr;
+    other.data_ = nullptr;
+    other.len_ = 0;
+}
+
+IoBuf& IoBuf::operator=(const IoBuf& other) {
+    if (this != &other) {
+        if (other.block_) other.block_->refs++;
+        release();
+        block_ = other.block_;
+        data_ = other.data_;
+        len_ = other.len_;
+    }
+    return *this;
+}
+
+IoBuf& IoBuf::operator=(IoBuf&& other) noexcept {
+    if (this != &other) {
+        release();
+        block_ = other.block_;
+        data_ = other.data_;
+        len_ = other.len_;
+        other.block_ = nullptr;
+        other.data_ = nullptr;
+        other.len_ = 0;
+    }
+    return *this;
+}
+
+IoBuf::~IoBuf() { release(); }
+
+void IoBuf::release() {
+    if (block_ && --block_->refs == 0) block_->pool->release(block_);
+    block_ = nullptr;
+}
+
+IoBuf IoBuf::wrap(const uint8_t* data, size_t len) {
+    return IoBuf(nullptr, const_cast<uint8_t*>(data), len);
+}
+
+size_t IoBuf::headroom() const {
+    if (!block_) return 0;
+    size_t start = (size_t)(data_ - block_->data);
+    return start == block_->low ? start : 0;
+}
+
+size_t IoBuf::tailroom() const {
+    if (!block_) return 0;
+    size_t end = (size_t)(data_ - block_->data) + len_;
+    return end == block_->high ? block_->size - end : 0;
+}
+
+uint8_t* IoBuf::prepend(size_t n) {
+    if (n > headroom()) return nullptr;
+    data_ -= n;
+    len_ += n;
+    block_->low -= (uint32_t)n;
+    return data_;
+}
+
+uint8_t* IoBuf::append(size_t n) {
+    if (n > tailroom()) return nullptr;
+    uint8_t* at = data_ + len_;
+    len_ += n;
+    block_->high += (uint32_t)n;
+    return at;
+}
+
+IoBuf IoBuf::slice(size_t offset, size_t len) const {
+    if (offset > len_) offset = len_;
+    if (len > len_ - offset) len = len_ - offset;
+    return IoBuf(block_, data_ + offset, len);
+}
+
+// ---------- IoBufPool ----------
+
+IoBufPool::IoBufPool(size_t block_size, size_t block_count)
+    : block_size_(block_size), storage_(block_size * block_count), blocks_(block_count) {
+    for (size_t i = 0; i < block_count; ++i) {
+        IoBufBlock& b = blocks_[i];
+        b.data = storage_.data() + i * block_size;
+        b.size = (uint32_t)block_size;
+        b.pooled = true;
+        b.pool = this;
+        b.next_free = free_;
+        free_ = &b;
+    }
+}
+
+IoBufPool::~IoBufPool() {}
+
+IoBuf IoBufPool::allocate(size_t headroom) {
+    if (headroom > block_size_) headroom = block_size_;
+    IoBufBlock* b = free_;
+    if (b) {
+        free_ = b->next_free;
+    } else {
+        // Pool exhausted: keep going on the heap rather than fail the upload
+        b = new IoBufBlock();
+        b->data = new uint8_t[block_size_];
+        b->size = (uint32_t)block_size_;
+        b->pooled = false;
+        b->pool = this;
+        stats_.overflow++;
+    }
+    b->refs = 0;
+    b->low = b->high = (uint32_t)headroom;
+    b->next_free = nullptr;
+    stats_.allocations++;
+    if (++stats_.in_use > stats_.peak_in_use) stats_.peak_in_use = stats_.in_use;
+    return IoBuf(b, b->data + headroom, 0);
+}
+
+void IoBufPool::release(IoBufBlock* block) {
+    stats_.in_use--;
+    if (!block->pooled) {
+        delete[] block->data;
+        delete block;
+        return;
+    }
+    block->next_free = free_;
+    free_ = block;
+}
+
+// ---------- IoChain ----------
+
+void IoChain::append(const IoBuf& buf) {
+    if (buf.empty()) return;
+    bufs_.push_back(buf);
+    len_ += buf.length();
+}
+
+void IoChain::append(const IoChain& other) {
+    for (const IoBuf& b : other.bufs_) append(b);
+}
+
+uint8_t* IoChain::tailSpace(size_t& avail, size_t headroom) {
+    avail = 0;
+    if (!bufs_.empty() && bufs_.back().tailroom() > 0) {
+        avail = bufs_.back().tailroom();
+        return const_cast<uint8_t*>(bufs_.back().data()) + bufs_.back().length();
+    }
+    if (!pool_) return nullptr;
+    // The empty slice is kept so commit() has something to grow
+    bufs_.push_back(pool_->allocate(headroom));
+    avail = bufs_.back().tailroom();
+    return const_cast<uint8_t*>(bufs_.back().data());
+}
+
+void IoChain::commit(size_t n) {
+    if (bufs_.empty()) return;
+    if (n == 0) {
+        if (bufs_.back().empty()) bufs_.pop_back();
+        return;
+    }
+    if (bufs_.back().append(n)) {
+        len_ += n;
+        if (pool_) pool_->countCopy(n);
+    }
+}
+
+bool IoChain::appendCopy(const void* src, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(src);
+    while (len > 0) {
+        size_t avail = 0;
+        uint8_t* dst = tailSpace(avail);
+        if (!dst || avail == 0) return false;
+        size_t n = len < avail ? len : avail;
+        memcpy(dst, p, n);
+        commit(n);
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool IoChain::prependCopy(const void* src, size_t len) {
+    if (len == 0) return true;
+    if (!bufs_.empty()) {
+        uint8_t* dst = bufs_.front().prepend(len);
+        if (dst) {
+            memcpy(dst, src, len);
+            len_ += len;
+            if (pool_) pool_->countCopy(len);
+            return true;
+        }
+    }
+    IoChain head(pool_);
+    if (!head.appendCopy(src, len)) return false;
+    bufs_.insert(bufs_.begin(), head.bufs_.begin(), head.bufs_.end());
+    len_ += len;
+    return true;
+}
+
+IoChain IoChain::slice(size_t offset, size_t len) const {
+    IoChain out(pool_);
+    for (const IoBuf& b : bufs_) {
+        if (len == 0) break;
+        if (offset >= b.length()) {
+            offset -= b.length();
+            continue;
+        }
+        size_t n = b.length() - offset;
+        if (n > len) n = len;
+        out.append(b.slice(offset, n));
+        offset = 0;
+        len -= n;
+    }
+    return out;
+}
+
+size_t IoChain::copyOut(size_t offset, void* dst, size_t len) const {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    size_t done = 0;
+    for (const IoBuf& b : bufs_) {
+        if (done == len) break;
+        if (offset >= b.length()) {
+            offset -= b.length();
+            continue;
+        }
+        size_t n = b.length() - offset;
+        if (n > len - done) n = len - done;
+        memcpy(out + done, b.data() + offset, n);
+        done += n;
+        offset = 0;
+    }
+    return done;
+}
+
+std::string IoChain::toString() const {
+    std::string s;
+    s.reserve(len_);
+    for (const IoBuf& b : bufs_) s.append(reinterpret_cast<const char*>(b.data()), b.length());
+    return s;
+}
+
+void IoChain::clear() {
+    bufs_.clear();
+    len_ = 0;
+}
@@ -0,0 +1,344 @@
+#include "../include/log_segment.hpp"
+#include <cstdio>
+#include <cstring>
+
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <mutex>
+#endif
+
+// ---------- CRC-32 (IEEE, reflected) ----------
+
+uint32_t logCrc32(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; ++b) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+// ---------- LZSS ----------
+
+static constexpr size_t LZSS_MIN_MATCH = 3;
+static constexpr size_t LZSS_MAX_MATCH = 18;
+static constexpr size_t LZSS_MAX_OFFSET = 4095;
+static constexpr uint16_t LZSS_NONE = 0xFFFF;
+
+static inline uint32_t lzssHash(const uint8_t* p) {
+    return ((uint32_t)p[0] << 6 ^ (uint32_t)p[1] << 3 ^ p[2]) & 1023u;
+}
+
+size_t LzssEncoder::compress(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap) {
+    if (len > MAX_INPUT) return 0;
+    for (size_t i = 0; i < HASH_SIZE; ++i) head_[i] = LZSS_NONE;
+
+    size_t op = 0;
+    size_t flag_pos = 0;
+    int token = 8;
+    size_t pos = 0;
+    while (pos < len) {
+        if (token == 8) {
+            if (op >= out_cap) return 0;
+            flag_pos = op;
+            out[op++] = 0;
+            token = 0;
+        }
+
+        size_t best_len = 0, best_off = 0;
+        if (pos + LZSS_MIN_MATCH <= len) {
+            size_t max_len = len - pos < LZSS_MAX_MATCH ? len - pos : LZSS_MAX_MATCH;
+            uint16_t cand = head_[lzssHash(in + pos)];
+            for (int chain = 0; cand != LZSS_NONE && chain < MAX_CHAIN; ++chain) {
+                size_t off = pos - cand;
+                if (off > LZSS_MAX_OFFSET) break;
+                size_t n = 0;
+                while (n < max_len && in[cand + n] == in[pos + n]) ++n;
+                if (n > best_len) {
+                    best_len = n;
+                    best_off = off;
+                    if (n == max_len) break;
+                }
+                cand = prev_[cand];
+            }
+        }
+
+        size_t advance = 1;
+        if (best_len >= LZSS_MIN_MATCH) {
+            if (op + 2 > out_cap) return 0;
+            out[flag_pos] |= (uint8_t)(1u << token);
+            out[op++] = (uint8_t)(best_off & 0xFF);
+            out[op++] = (uint8_t)(((best_off >> 8) & 0x0F) << 4 | (best_len - LZSS_MIN_MATCH));
+            advance = best_len;
+        } else {
+            if (op + 1 > out_cap) return 0;
+            out[op++] = in[pos];
+        }
+        ++token;
+
+        // Index every position covered by this token
+        for (size_t k = 0; k < advance; ++k, ++pos) {
+            if (pos + LZSS_MIN_MATCH <= len) {
+                uint32_t h = lzssHash(in + pos);
+                prev_[pos] = head_[h];
+                head_[h] = (uint16_t)pos;
+            }
+        }
+    }
+    return op;
+}
+
+bool lzssDecompress(const uint8_t* in, size_t len, uint8_t* out, size_t out_len) {
+    size_t ip = 0, op = 0;
+    while (op < out_len) {
+        if (ip >= len) return false;
+        uint8_t flags = in[ip++];
+        for (int t = 0; t < 8 && op < out_len; ++t) {
+            if (flags & (1u << t)) {
+                if (ip + 2 > len) return false;
+                size_t off = in[ip] | ((size_t)(in[ip + 1] >> 4) << 8);
+                size_t n = (in[ip + 1] & 0x0F) + LZSS_MIN_MATCH;
+                ip += 2;
+                if (off == 0 || off > op || op + n > out_len) return false;
+                for (size_t k = 0; k < n; ++k, ++op) out[op] = out[op - off];
+            } else {
+                if (ip >= len) return false;
+                out[op++] = in[ip++];
+            }
+        }
+    }
+    return ip == len;
+}
+
+// ---------- Staging ----------
+
+bool LogStaging::recover(uint32_t& boot) const {
+    if (area_->magic != MAGIC || area_->used == 0 || area_->used > LOG_STAGING_BYTES) return false;
+    // Lines are only counted once fully written, so a torn record cannot be half-visible
+    std::vector<LogRecord> records;
+    if (!parseLogRecords(area_->data, area_->used, records) || records.size() != area_->lines) return false;
+    boot = area_->boot;
+    return true;
+}
+
+#ifdef ESP32
+// Logger runs on every task, on both cores
+static portMUX_TYPE s_staging_mux = portMUX_INITIALIZER_UNLOCKED;
+
+struct StagingLock {
+    StagingLock() { portENTER_CRITICAL(&s_staging_mux); }
+    ~StagingLock() { portEXIT_CRITICAL(&s_staging_mux); }
+};
+#else
+static std::mutex s_staging_mutex;
+
+struct StagingLock {
+    StagingLock() { s_staging_mutex.lock(); }
+    ~StagingLock() { s_staging_mutex.unlock(); }
+};
+#endif
+
+void LogStaging::reset(uint32_t boot) {
+    StagingLock lock;
+    area_->magic = MAGIC;
+    area_->boot = boot;
+    area_->used = 0;
+    area_->lines = 0;
+    area_->first_ms = 0;
+    area_->last_ms = 0;
+    area_->max_level = 0;
+}
+
+bool LogStaging::append(uint32_t ms, uint8_t level, const char* text, size_t len) {
+    if (len > LOG_MAX_LINE) len = LOG_MAX_LINE;
+    size_t need = LOG_RECORD_OVERHEAD + len;
+    StagingLock lock;
+    counters_.lines++;
+    counters_.text_bytes += len;
+    if (area_->used + need > LOG_STAGING_BYTES) {
+        counters_.dropped++;
+        return false;
+    }
+
+    uint8_t* p = area_->data + area_->used;
+    p[0] = (uint8_t)(ms & 0xFF);
+    p[1] = (uint8_t)((ms >> 8) & 0xFF);
+    p[2] = (uint8_t)((ms >> 16) & 0xFF);
+    p[3] = (uint8_t)((ms >> 24) & 0xFF);
+    p[4] = level;
+    p[5] = (uint8_t)len;
+    memcpy(p + LOG_RECORD_OVERHEAD, text, len);
+
+    if (area_->lines == 0) area_->first_ms = ms;
+    area_->last_ms = ms;
+    if (level > area_->max_level) area_->max_level = level;
+    // Publish the record last
+    area_->used = (uint16_t)(area_->used + need);
+    area_->lines++;
+    return true;
+}
+
+bool LogStaging::snapshot(LogStagingArea& out) const {
+    StagingLock lock;
+    if (area_->used == 0) return false;
+    // Header fields, then only the bytes in use
+    memcpy(&out, area_, offsetof(LogStagingArea, data));
+    memcpy(out.data, area_->data, area_->used);
+    return true;
+}
+
+void LogStaging::consume(const LogStagingArea& snap) {
+    StagingLock lock;
+    // Lines are only ever added at the end, so the snapshot is a prefix of the area
+    if (snap.used > area_->used || snap.lines > area_->lines) return;
+    size_t rest = area_->used - snap.used;
+    memmove(area_->data, area_->data + snap.used, rest);
+    area_->used = (uint16_t)rest;
+    area_->lines = (uint16_t)(area_->lines - snap.lines);
+
+    area_->max_level = 0;
+    area_->first_ms = 0;
+    if (area_->lines == 0) {
+        area_->last_ms = 0;
+        return;
+    }
+    const uint8_t* p = area_->data;
+    area_->first_ms = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    for (size_t pos = 0; pos + LOG_RECORD_OVERHEAD <= rest; pos += LOG_RECORD_OVERHEAD + p[pos + 5]) {
+        if (p[pos + 4] > area_->max_level) area_->max_level = p[pos + 4];
+    }
+}
+
+bool LogStaging::due(uint32_t now_ms, uint32_t max_age_ms, uint8_t severe_level) const {
+    StagingLock lock;
+    if (area_->used == 0) return false;
+    if (area_->used >= LOG_STAGING_BYTES * 3 / 4) return true;
+    if (area_->max_level >= severe_level) return true;
+    return (uint32_t)(now_ms - area_->first_ms) >= max_age_ms;
+}
+
+LogStagingCounters LogStaging::counters() const {
+    StagingLock lock;
+    return counters_;
+}
+
+// ---------- Blocks ----------
+
+static void putU16(uint8_t* p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool encodeLogBlock(const LogStagingArea& area, uint32_t seq, LzssEncoder& encoder, std::vector<uint8_t>& out) {
+    if (area.used == 0 || area.used > LOG_STAGING_BYTES) return false;
+    size_t start = out.size();
+    out.resize(start + LOG_BLOCK_HEADER_SIZE + area.used);
+    uint8_t* h = out.data() + start;
+    uint8_t* body = h + LOG_BLOCK_HEADER_SIZE;
+
+    // Anything that does not shrink is stored as-is
+    size_t n = encoder.compress(area.data, area.used, body, area.used - 1);
+    uint8_t flags = LOG_BLOCK_COMPRESSED;
+    if (n == 0) {
+        memcpy(body, area.data, area.used);
+        n = area.used;
+        flags = 0;
+    }
+    out.resize(start + LOG_BLOCK_HEADER_SIZE + n);
+    h = out.data() + start;
+
+    h[0] = 'L';
+    h[1] = 'G';
+    h[2] = LOG_BLOCK_VERSION;
+    h[3] = flags;
+    putU32(h + 4, area.boot);
+    putU32(h + 8, seq);
+    putU32(h + 12, area.first_ms);
+    putU32(h + 16, area.last_ms);
+    putU16(h + 20, area.used);
+    putU16(h + 22, (uint16_t)n);
+    putU16(h + 24, area.lines);
+    putU16(h + 26, 0);
+    putU32(h + 28, logCrc32(h + LOG_BLOCK_HEADER_SIZE, n));
+    return true;
+}
+
+bool parseLogBlockHeader(const uint8_t* data, size_t len, LogBlockHeader& out) {
+    if (!data || len < LOG_BLOCK_HEADER_SIZE || data[0] != 'L' || data[1] != 'G') return false;
+    out.version = data[2];
+    out.flags = data[3];
+    out.boot = getU32(data + 4);
+    out.seq = getU32(data + 8);
+    out.first_ms = getU32(data + 12);
+    out.last_ms = getU32(data + 16);
+    out.raw_len = getU16(data + 20);
+    out.data_len = getU16(data + 22);
+    out.lines = getU16(data + 24);
+    out.crc = getU32(data + 28);
+    if (out.version != LOG_BLOCK_VERSION) return false;
+    return out.blockSize() <= len;
+}
+
+bool decodeLogBlock(const uint8_t* data, size_t len, LogBlockHeader& header, std::vector<uint8_t>& raw) {
+    if (!parseLogBlockHeader(data, len, header)) return false;
+    const uint8_t* body = data + LOG_BLOCK_HEADER_SIZE;
+    if (logCrc32(body, header.data_len) != header.crc) return false;
+    raw.resize(header.raw_len);
+    if (header.flags & LOG_BLOCK_COMPRESSED) {
+        return lzssDecompress(body, header.data_len, raw.data(), header.raw_len);
+    }
+    if (header.data_len != header.raw_len) return false;
+    memcpy(raw.data(), body, header.raw_len);
+    return true;
+}
+
+bool parseLogRecords(const uint8_t* raw, size_t len, std::vector<LogRecord>& out) {
+    size_t pos = 0;
+    while (pos < len) {
+        if (pos + LOG_RECORD_OVERHEAD > len) return false;
+        size_t n = raw[pos + 5];
+        if (pos + LOG_RECORD_OVERHEAD + n > len) return false;
+        LogRecord r;
+        r.ms = getU32(raw + pos);
+        r.level = raw[pos + 4];
+        r.text.assign((const char*)raw + pos + LOG_RECORD_OVERHEAD, n);
+        out.push_back(r);
+        pos += LOG_RECORD_OVERHEAD + n;
+    }
+    return true;
+}
+
+// ---------- Stats ----------
+
+void LogStoreStats::recordAppend(size_t bytes, size_t page_size) {
+    block_bytes += bytes;
+    flash_bytes += ((bytes + page_size - 1) / page_size + 1) * page_size;
+    blocks++;
+}
+
+std::string LogStoreStats::toJson() const {
+    char buf[320];
+    snprintf(buf, sizeof(buf),
+             "{\"lines\":%u,\"dropped\":%u,\"recovered\":%u,\"text_bytes\":%llu,\"block_bytes\":%llu,"
+             "\"flash_bytes\":%llu,\"blocks\":%u,\"segments_erased\":%u,\"compression_ratio\":%.3f,"
+             "\"write_amplification\":%.3f,\"flash_bytes_per_line\":%.2f}",
+             (unsigned)lines, (unsigned)dropped_lines, (unsigned)recovered_lines,
+             (unsigned long long)text_bytes, (unsigned long long)block_bytes,
+             (unsigned long long)flash_bytes, (unsigned)blocks, (unsigned)segments_erased,
+             compressionRatio(), writeAmplification(), flashBytesPerLine());
+    return std::string(buf);
+}
@@ -0,0 +1,211 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+
+#include "../include/log_store.hpp"
+#include "../include/logger.hpp"
+#include "../include/uplink_packetizer.hpp"
+#include "../include/cpu_accounting.hpp"
+#include "../include/stall_detector.hpp"
+#include "../include/secure_envelope.hpp"
+#include <cstdio>
+
+// Survives panic and watchdog resets (not power loss); validated by LogStaging::recover
+RTC_NOINIT_ATTR static LogStagingArea s_staging;
+
+LogStore::LogStore() : staging_(&s_staging) {}
+
+std::string LogStore::segmentPath(uint8_t slot) {
+    return "/logs/seg" + std::to_string(slot) + ".bin";
+}
+
+bool LogStore::readSegment(uint8_t slot, std::vector<uint8_t>& out) const {
+    out.clear();
+    std::string path = segmentPath(slot);
+    if (!LittleFS.exists(path.c_str())) return false;
+    File f = LittleFS.open(path.c_str(), "r");
+    if (!f) return false;
+    size_t size = f.size();
+    if (size > SEGMENT_SIZE) size = SEGMENT_SIZE;
+    out.resize(size);
+    size_t got = f.read(out.data(), size);
+    f.close();
+    out.resize(got);
+    return true;
+}
+
+bool LogStore::begin() {
+    if (!LittleFS.exists("/logs")) LittleFS.mkdir("/logs");
+    if (!encoder_) encoder_ = new LzssEncoder();
+    block_.reserve(LOG_BLOCK_HEADER_SIZE + LOG_STAGING_BYTES);
+
+    // Find the newest block to continue the ring and the boot/sequence counters
+    uint32_t max_boot = 0;
+    bool found = false;
+    std::vector<uint8_t> seg;
+    for (uint8_t slot = 0; slot < SEGMENT_COUNT; ++slot) {
+        if (!readSegment(slot, seg)) continue;
+        size_t pos = 0;
+        LogBlockHeader h;
+        while (parseLogBlockHeader(seg.data() + pos, seg.size() - pos, h)) {
+            if (h.boot > max_boot) max_boot = h.boot;
+            if (!found || h.seq >= seq_) {
+                seq_ = h.seq + 1;
+                slot_ = slot;
+                found = true;
+            }
+            pos += h.blockSize();
+        }
+        // A torn block at the tail is overwritten by the next append
+        if (found && slot_ == slot) slot_used_ = pos;
+    }
+
+    uint32_t staged_boot = 0;
+    uint32_t recovered = 0;
+    if (staging_.recover(staged_boot)) {
+        recovered = staging_.area().lines;
+        if (staged_boot > max_boot) max_boot = staged_boot;
+        if (writeBlock(staging_.area())) stats_.recovered_lines += recovered;
+    }
+    boot_ = max_boot + 1;
+    staging_.reset(boot_);
+    ready_ = true;
+
+    Logger::info("[LogStore] boot=%u next_seq=%u segment=%u used=%u recovered_lines=%u",
+                 (unsigned)boot_, (unsigned)seq_, (unsigned)slot_, (unsigned)slot_used_, (unsigned)recovered);
+    return true;
+}
+
+void LogStore::append(uint8_t level, uint32_t ms, const char* text, size_t len) {
+    if (!ready_) return;   // begin() has not adopted the RTC area yet
+    // When full the line is dropped and counted; loop() commits at 3/4 full, so this
+    // only happens when the log task is held up
+    staging_.append(ms, level, text, len);
+}
+
+bool LogStore::commit() {
+    if (!ready_ || busy_.exchange(true)) return false;
+    bool ok = false;
+    if (staging_.snapshot(snapshot_)) {
+        CpuScope cpu(CpuSubsystem::FLASH);
+        StallScope stall(CpuSubsystem::FLASH, "log_commit");
+        // Other tasks keep staging lines while the block is written
+        ok = writeBlock(snapshot_);
+        if (!ok) commit_dropped_ += snapshot_.lines;
+        staging_.consume(snapshot_);
+    }
+    busy_ = false;
+    return ok;
+}
+
+LogStoreStats LogStore::stats() const {
+    LogStoreStats s = stats_;
+    LogStagingCounters c = staging_.counters();
+    s.lines = c.lines;
+    s.text_bytes = c.text_bytes;
+    s.dropped_lines = c.dropped + commit_dropped_;
+    return s;
+}
+
+bool LogStore::writeBlock(const LogStagingArea& area) {
+    block_.clear();
+    if (!encoder_ || !encodeLogBlock(area, seq_, *encoder_, block_)) return false;
+
+    bool fresh = false;
+    if (slot_used_ + block_.size() > SEGMENT_SIZE) {
+        slot_ = (uint8_t)((slot_ + 1) % SEGMENT_COUNT);
+        slot_used_ = 0;
+        fresh = true;
+    }
+    std::string path = segmentPath(slot_);
+    File f;
+    if (slot_used_ == 0) {
+        f = LittleFS.open(path.c_str(), "w");   // truncates the oldest segment
+        if (fresh) stats_.segments_erased++;
+    } else {
+        f = LittleFS.open(path.c_str(), "r+");
+        if (f) f.seek(slot_used_);
+    }
+    if (!f) return false;
+    size_t written = f.write(block_.data(), block_.size());
+    f.close();
+    if (written != block_.size()) return false;
+
+    slot_used_ += written;
+    seq_++;
+    stats_.recordAppend(written);
+    return true;
+}
+
+void LogStore::loop() {
+    if (!ready_) return;
+    if (staging_.due(millis(), MAX_STAGE_AGE_MS, SEVERE_LEVEL)) commit();
+    if (export_.active) exportStep();
+}
+
+bool LogStore::matchesExport(const LogBlockHeader& h) const {
+    return h.boot == export_.boot && h.overlaps(export_.from_ms, export_.to_ms);
+}
+
+uint32_t LogStore::startExport(uint32_t command_id, uint32_t boots_ago, uint32_t from_s, uint32_t to_s) {
+    commit();
+    export_ = Export();
+    export_.command_id = command_id;
+    export_.boot = boots_ago < boot_ ? boot_ - boots_ago : 0;
+    export_.from_ms = from_s * 1000;
+    export_.to_ms = to_s ? to_s * 1000 : 0xFFFFFFFFu;
+    export_.first_slot = (uint8_t)((slot_ + 1) % SEGMENT_COUNT);   // oldest segment first
+
+    uint32_t matching = 0;
+    std::vector<uint8_t> seg;
+    for (uint8_t slot = 0; slot < SEGMENT_COUNT; ++slot) {
+        if (!readSegment(slot, seg)) continue;
+        size_t pos = 0;
+        LogBlockHeader h;
+        while (parseLogBlockHeader(seg.data() + pos, seg.size() - pos, h)) {
+            if (matchesExport(h)) matching++;
+            pos += h.blockSize();
+        }
+    }
+    export_.active = uplink_ != nullptr;
+    Logger::info("[LogStore] Export %u: boot=%u range=%u..%u s, %u blocks",
+                 (unsigned)command_id, (unsigned)export_.boot, (unsigned)from_s, (unsigned)to_s, (unsigned)matching);
+    return matching;
+}
+
+void LogStore::exportStep() {
+    // Low priority: only top up the background lane, never fill it
+    if (uplink_->lanes().pending(UplinkLane::BACKGROUND) >= 2) return;
+
+    std::vector<uint8_t> seg;
+    while (export_.step < SEGMENT_COUNT) {
+        uint8_t slot = (uint8_t)((export_.first_slot + export_.step) % SEGMENT_COUNT);
+        if (readSegment(slot, seg)) {
+            LogBlockHeader h;
+            // The offset can be past the end if the ring wrapped onto this segment meanwhile
+            while (export_.offset < seg.size() && parseLogBlockHeader(seg.data() + export_.offset, seg.size() - export_.offset, h)) {
+                size_t at = export_.offset;
+                export_.offset += h.blockSize();
+                if (!matchesExport(h)) continue;
+
+                char head[160];
+                snprintf(head, sizeof(head),
+                         "{\"type\":\"log_block\",\"command_id\":%u,\"boot\":%u,\"seq\":%u,\"first_ms\":%u,"
+                         "\"last_ms\":%u,\"lines\":%u,\"data\":\"",
+                         (unsigned)export_.command_id, (unsigned)h.boot, (unsigned)h.seq,
+                         (unsigned)h.first_ms, (unsigned)h.last_ms, (unsigned)h.lines);
+                std::string body = head + base64Encode(seg.data() + at, h.blockSize()) + "\"}";
+                if (uplink_->enqueue(UplinkLane::BACKGROUND, body)) export_.sent++;
+                return;   // one block per loop
+            }
+        }
+        export_.step++;
+        export_.offset = 0;
+    }
+
+    std::string done = "{\"type\":\"log_export_done\",\"command_id\":" + std::to_string(export_.command_id) +
+                       ",\"blocks\":" + std::to_string(export_.sent) + ",\"stats\":" + stats().toJson() + "}";
+    uplink_->enqueue(UplinkLane::BACKGROUND, done);
+    export_.active = false;
+    Logger::info("[LogStore] Export %u complete: %u blocks", (unsigned)export_.command_id, (unsigned)export_.sent);
+}
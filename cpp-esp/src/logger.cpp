@@ -3,6 +3,7 @@
 #include <LittleFS.h>
 
 #include "../include/logger.hpp"
+#include "../include/log_store.hpp"
 #include <stdarg.h>
 #include <string.h>
 #include <cstdio>
@@ -11,6 +12,8 @@
 Logger::Level Logger::min_level_ = Logger::INFO;
 std::string Logger::log_file_ = "/logs/main.log";
 bool Logger::flush_on_write_ = true;
+bool Logger::console_ = true;
+LogStore* Logger::store_ = nullptr;
 
 void Logger::begin(const LoggingConfig& cfg) {
     // Try to mount LittleFS; auto-format if mount fails (safer for fresh flash)
@@ -48,17 +51,11 @@ void Logger::write_log(Level level, const char* fmt, va_list args) {
     snprintf(time_buf, sizeof(time_buf), "%04lu-%02lu-%02lu %02lu:%02lu:%02lu.%03lu",
              2025UL, 9UL, 22UL + days, hours % 24, minutes % 60, seconds % 60, ms % 1000);
     
-    // Print to serial only (disable LittleFS logging to avoid boot issues)
-    printf("[%s] [%s] %s\n", time_buf, level_str, buf);
-    
-    /* DISABLED: LittleFS logging causing boot crashes
-    File fh = LittleFS.open(log_file_.c_str(), "a+");
-    if (fh) {
-        fh.printf("[%s] [%s] %s\n", time_buf, level_str, buf);
-        if (flush_on_write_) fh.flush();
-        fh.close();
-    }
-    */
+    if (console_) printf("[%s] [%s] %s\n", time_buf, level_str, buf);
+
+    // Per-line flash writes caused boot crashes; the store only copies the line into
+    // its staging area and writes whole blocks from its own loop
+    if (store_) store_->append((uint8_t)level, (uint32_t)ms, buf, strlen(buf));
 }
 
 void Logger::log(Level level, const char* fmt, ...) {
@@ -97,13 +94,17 @@ void Logger::error(const char* fmt, ...) {
 }
 
 void Logger::flush() {
-    File fh = LittleFS.open(log_file_.c_str(), "a"); // Open in append mode to flush
-    if (fh) {
-        fh.flush();
-        fh.close();
-    }
+    if (store_) store_->commit();
 }
 
 void Logger::shutdown() {
-    // No persistent file handle to close
+    if (store_) store_->commit();
+}
+
+void Logger::attachStore(LogStore* store) {
+    store_ = store;
+}
+
+void Logger::setConsole(bool enabled) {
+    console_ = enabled;
 }
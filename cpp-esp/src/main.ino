@@ -7,7 +7,30 @@
 
 EcoWattDevice device;
 
+// Serial console commands:
+//   tap on [baud]   stream binary telemetry (serial_tap.hpp), default 921600 baud
+//   tap off         back to the 115200 text console
+static void handleSerialLine(String line) {
+    line.trim();
+    if (line.startsWith("tap on")) {
+        long baud = line.length() > 6 ? line.substring(6).toInt() : 0;
+        device.startSerialTap(baud > 0 ? (uint32_t)baud : SerialTap::DEFAULT_BAUD);
+        return;
+    }
+    if (line == "tap off") {
+        device.stopSerialTap();
+        return;
+    }
+    if (device.serialTapActive()) return;   // no text on the binary stream
+    Serial.print("[SERIAL DATA] ");
+    Serial.println(line);
+}
+
 void setup() {
+#if defined(ESP32)
+    // Room for a few tap packets so the loop writes without waiting on the FIFO
+    Serial.setTxBufferSize(1024);
+#endif
     Serial.begin(115200);
 #if defined(ESP32)
     if (!LittleFS.begin(true)) { // true = format if mount fails
@@ -40,10 +63,7 @@ void setup() {
 
 void loop() {
     device.loop();
-    // Print any available serial data to the monitor
     while (Serial.available()) {
-        String data = Serial.readStringUntil('\n');
-        Serial.print("[SERIAL DATA] ");
-        Serial.println(data);
+        handleSerialLine(Serial.readStringUntil('\n'));
     }
 }
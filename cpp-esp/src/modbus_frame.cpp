@@ -15,3 +15,59 @@ uint16_t modbus_crc16(const uint8_t *data, uint16_t length) {
     }
     return crc;
 }
+
+size_t modbus_read_write_pdu(uint8_t *pdu, uint16_t read_start, uint16_t read_count,
+                             uint16_t write_start, uint16_t write_count, const uint16_t *write_values) {
+    // Spec limits: 125 registers read, 121 written
+    if (read_count == 0 || read_count > 125 || write_count == 0 || write_count > 121 || !write_values) return 0;
+    pdu[0] = 0x17;
+    pdu[1] = (read_start >> 8) & 0xFF;
+    pdu[2] = read_start & 0xFF;
+    pdu[3] = (read_count >> 8) & 0xFF;
+    pdu[4] = read_count & 0xFF;
+    pdu[5] = (write_start >> 8) & 0xFF;
+    pdu[6] = write_start & 0xFF;
+    pdu[7] = (write_count >> 8) & 0xFF;
+    pdu[8] = write_count & 0xFF;
+    pdu[9] = (uint8_t)(write_count * 2);
+    size_t len = 10;
+    for (uint16_t i = 0; i < write_count; ++i) {
+        pdu[len++] = (write_values[i] >> 8) & 0xFF;
+        pdu[len++] = write_values[i] & 0xFF;
+    }
+    return len;
+}
+
+bool modbus_read_values(const uint8_t *pdu, size_t len, uint16_t count, uint16_t *values) {
+    if (len < 2 || pdu[1] != count * 2 || len < 2u + pdu[1]) return false;
+    for (uint16_t i = 0; i < count; ++i) {
+        values[i] = (uint16_t)((pdu[2 + 2 * i] << 8) | pdu[3 + 2 * i]);
+    }
+    return true;
+}
+
+ModbusReadback ModbusReadback::around(uint16_t written) {
+    uint16_t start = written < STATUS_REG ? written : STATUS_REG;
+    uint16_t end = written > POWER_REG ? written : POWER_REG;
+    ModbusReadback block;
+    if (end - start + 1 > MAX_COUNT) {
+        block.start = written;
+        block.count = 1;
+    } else {
+        block.start = start;
+        block.count = (uint16_t)(end - start + 1);
+    }
+    return block;
+}
+
+bool ModbusReadWriteSupport::meansUnsupported(uint8_t exception_code, int http_status) {
+    return exception_code == 0x01 || http_status == 400 || http_status == 404 || http_status == 405 ||
+           http_status == 501;
+}
+
+bool ModbusReadWriteSupport::onFailure(uint8_t exception_code, int http_status, uint32_t now_ms) {
+    if (!meansUnsupported(exception_code, http_status)) return false;
+    disabled_ = true;
+    disabled_at_ms_ = now_ms;
+    return true;
+}
@@ -0,0 +1,509 @@
+#include "../include/modbus_tcp.hpp"
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef ESP32
+#include <lwip/netdb.h>
+#include <lwip/sockets.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static uint64_t nowMs() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t nowUs() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static timeval toTimeval(uint32_t ms) {
+    timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    return tv;
+}
+
+ModbusTcpClient::ModbusTcpClient(const std::string& host, uint16_t port, uint8_t unit_id,
+                                 uint32_t timeout_ms, uint8_t max_in_flight)
+    : host_(host), port_(port), unit_id_(unit_id), timeout_ms_(timeout_ms),
+      max_in_flight_(max_in_flight ? max_in_flight : 1) {}
+
+ModbusTcpClient::~ModbusTcpClient() { close(); }
+
+bool ModbusTcpClient::connect() {
+    close();
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)port_);
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host_.c_str(), port, &hints, &res) != 0 || !res) {
+        last_error_ = "resolve failed";
+        return false;
+    }
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        last_error_ = "socket failed";
+        return false;
+    }
+
+    // Non-blocking connect so an unreachable unit costs timeout_ms, not the TCP default
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int rc = ::connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        last_error_ = "connect failed";
+        return false;
+    }
+    if (rc != 0) {
+        fd_set wfds;
+        FD_ZERO(&wfds);
+        FD_SET(fd, &wfds);
+        timeval tv = toTimeval(timeout_ms_);
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (select(fd + 1, nullptr, &wfds, nullptr, &tv) <= 0 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0 || err != 0) {
+            ::close(fd);
+            last_error_ = "connect timed out";
+            return false;
+        }
+    }
+    fcntl(fd, F_SETFL, flags);
+
+    // Requests are small and written back to back; don't let Nagle hold them
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    timeval tv = toTimeval(timeout_ms_);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    fd_ = fd;
+    rx_len_ = 0;
+    stats_.connects++;
+    last_error_.clear();
+    return true;
+}
+
+void ModbusTcpClient::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    rx_len_ = 0;
+}
+
+void ModbusTcpClient::fail(const char* what) {
+    last_error_ = what;
+    stats_.disconnects++;
+    close();
+}
+
+bool ModbusTcpClient::sendAll(const uint8_t* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd_, data, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+bool ModbusTcpClient::receive(uint32_t wait_ms) {
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(fd_, &rfds);
+    timeval tv = toTimeval(wait_ms);
+    int rc = select(fd_ + 1, &rfds, nullptr, nullptr, &tv);
+    if (rc < 0) return errno == EINTR;
+    if (rc == 0) return true;
+    ssize_t n = recv(fd_, rx_ + rx_len_, sizeof(rx_) - rx_len_, 0);
+    if (n <= 0) return n < 0 && (errno == EINTR || errno == EAGAIN);
+    rx_len_ += (size_t)n;
+    return true;
+}
+
+uint16_t ModbusTcpClient::frame(uint8_t* out, size_t pdu_len) {
+    uint16_t txid = next_txid_++;
+    uint16_t length = (uint16_t)(pdu_len + 1);
+    out[0] = txid >> 8;
+    out[1] = txid & 0xFF;
+    out[2] = 0;
+    out[3] = 0;
+    out[4] = length >> 8;
+    out[5] = length & 0xFF;
+    out[6] = unit_id_;
+    return txid;
+}
+
+template <typename Take>
+bool ModbusTcpClient::takeFrames(Take take) {
+    size_t pos = 0;
+    bool ok = true;
+    while (rx_len_ - pos >= MBAP_SIZE) {
+        const uint8_t* f = rx_ + pos;
+        uint16_t txid = (uint16_t)((f[0] << 8) | f[1]);
+        uint16_t proto = (uint16_t)((f[2] << 8) | f[3]);
+        uint16_t length = (uint16_t)((f[4] << 8) | f[5]);
+        if (proto != 0 || length < 2 || length > MAX_PDU + 1) {
+            ok = false;
+            break;
+        }
+        if (rx_len_ - pos < 6u + length) break;
+        take(txid, f[6], f + MBAP_SIZE, length - 1u);
+        pos += 6u + length;
+    }
+    if (!ok) {
+        // Lost framing; nothing after this point can be trusted
+        fail("bad MBAP header");
+        return false;
+    }
+    if (pos > 0) {
+        memmove(rx_, rx_ + pos, rx_len_ - pos);
+        rx_len_ -= pos;
+    }
+    return true;
+}
+
+void ModbusTcpClient::run(size_t count, const BuildFn& build, const DoneFn& done, ModbusTcpClient* hedge,
+                          HedgePolicy* policy) {
+    if (!policy) hedge = nullptr;
+    slots_.assign(max_in_flight_, Slot());
+    size_t next = 0, completed = 0;
+    bool reconnected = false;
+    if (!connected() && !connect()) {
+        for (size_t i = 0; i < count; ++i) done(i, nullptr, 0);
+        return;
+    }
+    auto finish = [&](Slot& slot, const uint8_t* reply, size_t reply_len, bool hedge_won) {
+        slot.busy = false;
+        completed++;
+        if (hedge && reply) policy->onComplete((uint32_t)(nowUs() - slot.sent_us), hedge_won);
+        done(slot.index, reply, reply_len);
+    };
+
+    while (completed < count) {
+        bool lost = false;
+
+        // Fill the window; everything queued goes out in one write
+        tx_.clear();
+        uint64_t now = nowMs();
+        for (Slot& slot : slots_) {
+            if (slot.busy || next >= count) continue;
+            size_t at = tx_.size();
+            tx_.resize(at + MBAP_SIZE + MAX_PDU);
+            size_t pdu_len = build(next, &tx_[at + MBAP_SIZE]);
+            uint16_t txid = frame(&tx_[at], pdu_len);
+            tx_.resize(at + MBAP_SIZE + pdu_len);
+            slot = Slot();
+            slot.busy = true;
+            slot.txid = txid;
+            slot.index = next++;
+            slot.deadline_ms = now + timeout_ms_;
+            stats_.requests++;
+            if (hedge) {
+                uint32_t delay_us = policy->delayUs();
+                policy->onRead();
+                slot.sent_us = nowUs();
+                if (delay_us) slot.hedge_at_us = slot.sent_us + delay_us;
+            }
+        }
+        uint32_t in_flight = 0;
+        uint64_t earliest = 0;
+        for (const Slot& slot : slots_) {
+            if (!slot.busy) continue;
+            if (in_flight++ == 0 || slot.deadline_ms < earliest) earliest = slot.deadline_ms;
+        }
+        if (in_flight > stats_.max_in_flight_seen) stats_.max_in_flight_seen = in_flight;
+        if (!tx_.empty() && !sendAll(tx_.data(), tx_.size())) {
+            fail("send failed");
+            lost = true;
+        }
+
+        uint32_t wait_ms = earliest > now ? (uint32_t)(earliest - now) : 0;
+        if (!lost && hedge) {
+            // Wake up for the next hedge as well, and listen on both connections
+            uint64_t now_us = nowUs();
+            for (const Slot& slot : slots_) {
+                if (!slot.busy || !slot.hedge_at_us) continue;
+                uint32_t ms = slot.hedge_at_us > now_us ? (uint32_t)((slot.hedge_at_us - now_us + 999) / 1000) : 0;
+                if (ms < wait_ms) wait_ms = ms;
+            }
+            if (hedge->connected()) {
+                ModbusTcpClient* conns[2] = {this, hedge};
+                waitAny(conns, 2, wait_ms);
+                wait_ms = 0;
+                if (!hedge->receive(0)) hedge->fail("connection closed");
+            }
+        }
+        if (!lost && !receive(wait_ms)) {
+            fail("connection closed");
+            lost = true;
+        }
+
+        // Complete every whole frame in the buffer
+        if (!lost) {
+            lost = !takeFrames([&](uint16_t txid, uint8_t unit, const uint8_t* pdu, size_t pdu_len) {
+                for (Slot& slot : slots_) {
+                    if (slot.busy && slot.txid == txid && unit == unit_id_) {
+                        stats_.responses++;
+                        finish(slot, pdu, pdu_len, false);
+                        return;
+                    }
+                }
+                stats_.stray++;
+            });
+        }
+        if (hedge && hedge->connected()) {
+            // The loser's reply turns up later on the other connection and is counted as stray
+            hedge->takeFrames([&](uint16_t txid, uint8_t unit, const uint8_t* pdu, size_t pdu_len) {
+                for (Slot& slot : slots_) {
+                    if (slot.busy && slot.hedged && slot.hedge_txid == txid && unit == hedge->unit_id_) {
+                        hedge->stats_.responses++;
+                        finish(slot, pdu, pdu_len, true);
+                        return;
+                    }
+                }
+                hedge->stats_.stray++;
+            });
+        }
+
+        now = nowMs();
+        for (Slot& slot : slots_) {
+            if (!slot.busy) continue;
+            if (!lost && slot.deadline_ms > now) continue;
+            // A late reply for this id will be counted as stray
+            if (!lost) stats_.timeouts++;
+            if (slot.hedged) hedge->stats_.timeouts++;
+            finish(slot, nullptr, 0, false);
+        }
+
+        // Duplicate the reads that are past their hedge delay
+        if (hedge) {
+            uint64_t now_us = nowUs();
+            for (Slot& slot : slots_) {
+                if (!slot.busy || !slot.hedge_at_us || now_us < slot.hedge_at_us) continue;
+                slot.hedge_at_us = 0;
+                if (!policy->takeHedge()) continue;
+                uint8_t pdu[MAX_PDU];
+                size_t pdu_len = build(slot.index, pdu);
+                slot.hedged = hedge->sendRequest(pdu, pdu_len, slot.hedge_txid);
+            }
+        }
+
+        if (lost && next < count) {
+            // One reconnect per batch; after that the rest of the batch fails
+            if (!reconnected && connect()) {
+                reconnected = true;
+            } else {
+                for (; next < count; ++next, ++completed) done(next, nullptr, 0);
+            }
+        }
+    }
+}
+
+bool ModbusTcpClient::transact(const uint8_t* pdu, size_t len, uint8_t* response, size_t response_size,
+                               size_t& response_len) {
+    response_len = 0;
+    if (len == 0 || len > MAX_PDU) return false;
+    bool ok = false;
+    run(1,
+        [&](size_t, uint8_t* out) {
+            memcpy(out, pdu, len);
+            return len;
+        },
+        [&](size_t, const uint8_t* reply, size_t reply_len) {
+            if (!reply || reply_len > response_size) return;
+            memcpy(response, reply, reply_len);
+            response_len = reply_len;
+            ok = true;
+        });
+    return ok;
+}
+
+bool ModbusTcpClient::sendRequest(const uint8_t* pdu, size_t len, uint16_t& txid) {
+    if (len == 0 || len > MAX_PDU) return false;
+    if (!connected() && !connect()) return false;
+    uint8_t out[MBAP_SIZE + MAX_PDU];
+    memcpy(out + MBAP_SIZE, pdu, len);
+    txid = frame(out, len);
+    if (!sendAll(out, MBAP_SIZE + len)) {
+        fail("send failed");
+        return false;
+    }
+    stats_.requests++;
+    return true;
+}
+
+int ModbusTcpClient::pollReply(uint16_t txid, uint32_t wait_ms, uint8_t* response, size_t response_size,
+                          size_t& response_len) {
+    if (!connected()) return -1;
+    if (!receive(wait_ms)) {
+        fail("connection closed");
+        return -1;
+    }
+    int found = 0;
+    bool framed = takeFrames([&](uint16_t id, uint8_t unit, const uint8_t* pdu, size_t pdu_len) {
+        if (!found && id == txid && unit == unit_id_ && pdu_len <= response_size) {
+            memcpy(response, pdu, pdu_len);
+            response_len = pdu_len;
+            stats_.responses++;
+            found = 1;
+        } else {
+            stats_.stray++;
+        }
+    });
+    return framed ? found : -1;
+}
+
+void ModbusTcpClient::waitAny(ModbusTcpClient* const* clients, size_t count, uint32_t wait_ms) {
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    int max_fd = -1;
+    for (size_t i = 0; i < count; ++i) {
+        if (!clients[i] || clients[i]->fd_ < 0) continue;
+        // Bytes already buffered count as readable
+        if (clients[i]->rx_len_ >= MBAP_SIZE) return;
+        FD_SET(clients[i]->fd_, &rfds);
+        if (clients[i]->fd_ > max_fd) max_fd = clients[i]->fd_;
+    }
+    timeval tv = toTimeval(wait_ms);
+    select(max_fd + 1, max_fd >= 0 ? &rfds : nullptr, nullptr, nullptr, &tv);
+}
+
+bool ModbusTcpClient::hedgedTransact(ModbusTcpClient& hedge, HedgePolicy& policy, const uint8_t* pdu, size_t len,
+                                     uint8_t* response, size_t response_size, size_t& response_len) {
+    response_len = 0;
+    uint64_t start = nowUs();
+    uint64_t deadline = start + (uint64_t)timeout_ms_ * 1000;
+    uint32_t delay_us = policy.delayUs();
+    policy.onRead();
+
+    ModbusTcpClient* conns[2] = {this, &hedge};
+    uint16_t txids[2] = {0, 0};
+    bool live[2] = {false, false};
+    live[0] = sendRequest(pdu, len, txids[0]);
+    // A primary that cannot even send is hedged at once
+    bool hedge_due = !live[0] || delay_us > 0;
+    uint64_t hedge_at = live[0] ? start + delay_us : start;
+
+    for (;;) {
+        uint64_t now = nowUs();
+        if (hedge_due && now >= hedge_at) {
+            hedge_due = false;
+            if (policy.takeHedge()) live[1] = hedge.sendRequest(pdu, len, txids[1]);
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (!live[i]) continue;
+            int r = conns[i]->pollReply(txids[i], 0, response, response_size, response_len);
+            if (r > 0) {
+                policy.onComplete((uint32_t)(nowUs() - start), i == 1);
+                return true;
+            }
+            if (r < 0) live[i] = false;
+        }
+        now = nowUs();
+        if (now >= deadline || (!live[0] && !live[1] && !hedge_due)) break;
+        uint64_t until = hedge_due && hedge_at < deadline ? hedge_at : deadline;
+        uint32_t wait_ms = until > now ? (uint32_t)((until - now + 999) / 1000) : 0;
+        waitAny(conns, 2, wait_ms);
+    }
+    if (live[0]) stats_.timeouts++;
+    if (live[1]) hedge.stats_.timeouts++;
+    return false;
+}
+
+void ModbusRegisterBatch::assign(const uint8_t* regs, size_t count) {
+    if (reads_.size() < count) {
+        reads_.resize(count);
+        values_.resize(count);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        reads_[i] = ModbusRead();
+        reads_[i].start = regs[i];
+        reads_[i].values = &values_[i];
+    }
+    count_ = count;
+}
+
+bool ModbusRegisterBatch::value(size_t i, uint16_t& out) const {
+    if (i >= count_ || !reads_[i].ok) return false;
+    out = values_[i];
+    return true;
+}
+
+size_t ModbusTcpClient::readBatch(ModbusRead* reads, size_t count) {
+    return readAll(reads, count, nullptr, nullptr);
+}
+
+size_t ModbusTcpClient::hedgedReadBatch(ModbusTcpClient& hedge, HedgePolicy& policy, ModbusRead* reads, size_t count) {
+    return readAll(reads, count, &hedge, &policy);
+}
+
+size_t ModbusTcpClient::readAll(ModbusRead* reads, size_t count, ModbusTcpClient* hedge, HedgePolicy* policy) {
+    size_t ok = 0;
+    for (size_t i = 0; i < count; ++i) {
+        reads[i].ok = false;
+        reads[i].exception = 0;
+    }
+    run(count,
+        [&](size_t i, uint8_t* out) {
+            const ModbusRead& r = reads[i];
+            out[0] = r.function;
+            out[1] = r.start >> 8;
+            out[2] = r.start & 0xFF;
+            out[3] = r.count >> 8;
+            out[4] = r.count & 0xFF;
+            return (size_t)5;
+        },
+        [&](size_t i, const uint8_t* reply, size_t reply_len) {
+            ModbusRead& r = reads[i];
+            if (!reply || reply_len < 2) return;
+            if (reply[0] == (r.function | 0x80)) {
+                r.exception = reply[1];
+                return;
+            }
+            if (reply[0] != r.function || reply[1] != r.count * 2 || reply_len < 2u + r.count * 2u) return;
+            for (uint16_t k = 0; k < r.count; ++k) {
+                r.values[k] = (uint16_t)((reply[2 + 2 * k] << 8) | reply[3 + 2 * k]);
+            }
+            r.ok = true;
+            ok++;
+        },
+        hedge, policy);
+    return ok;
+}
+
+bool ModbusTcpClient::readRange(uint8_t function, uint16_t start, uint32_t count, uint16_t* values) {
+    if (count == 0 || start + count > 0x10000u) return false;
+    std::vector<ModbusRead> reads((count + MAX_READ_REGISTERS - 1) / MAX_READ_REGISTERS);
+    for (size_t i = 0; i < reads.size(); ++i) {
+        uint32_t offset = (uint32_t)i * MAX_READ_REGISTERS;
+        reads[i].function = function;
+        reads[i].start = (uint16_t)(start + offset);
+        reads[i].count = (uint16_t)(count - offset < MAX_READ_REGISTERS ? count - offset : MAX_READ_REGISTERS);
+        reads[i].values = values + offset;
+    }
+    return readBatch(reads.data(), reads.size()) == reads.size();
+}
@@ -0,0 +1,85 @@
+#include "../include/nonce_resync.hpp"
+#include <cstdlib>
+
+namespace {
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+std::string toHex(const uint8_t* bytes, size_t len) {
+    std::string out(len * 2, '0');
+    for (size_t i = 0; i < len; ++i) {
+        out[2 * i] = HEX_DIGITS[bytes[i] >> 4];
+        out[2 * i + 1] = HEX_DIGITS[bytes[i] & 0x0F];
+    }
+    return out;
+}
+
+std::string macHex(HmacSha256& hmac, const std::string& input) {
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    hmac.compute((const uint8_t*)input.data(), input.size(), mac);
+    return toHex(mac, sizeof(mac));
+}
+
+// Start of the value after "key": in a flat JSON object, npos when absent
+size_t valueAt(const std::string& body, const char* key) {
+    std::string quoted = std::string("\"") + key + "\"";
+    size_t at = body.find(quoted);
+    if (at == std::string::npos) return at;
+    at += quoted.size();
+    while (at < body.size() && (body[at] == ' ' || body[at] == ':')) ++at;
+    return at < body.size() ? at : std::string::npos;
+}
+
+bool stringField(const std::string& body, const char* key, std::string& out) {
+    size_t at = valueAt(body, key);
+    if (at == std::string::npos || body[at] != '"') return false;
+    size_t end = body.find('"', at + 1);
+    if (end == std::string::npos) return false;
+    out = body.substr(at + 1, end - at - 1);
+    return true;
+}
+
+bool numberField(const std::string& body, const char* key, uint32_t& out) {
+    size_t at = valueAt(body, key);
+    if (at == std::string::npos || body[at] < '0' || body[at] > '9') return false;
+    char* end = nullptr;
+    unsigned long long v = strtoull(body.c_str() + at, &end, 10);
+    if (v > 0xFFFFFFFFull) return false;
+    out = (uint32_t)v;
+    return true;
+}
+}
+
+NonceResync::NonceResync(const std::string& device_id, const uint8_t challenge[CHALLENGE_SIZE])
+    : device_id_(device_id), challenge_(toHex(challenge, CHALLENGE_SIZE)) {}
+
+std::string NonceResync::requestMacInput(const std::string& device_id, const std::string& challenge_hex) {
+    return "resync" + device_id + challenge_hex;
+}
+
+std::string NonceResync::replyMacInput(const std::string& device_id, const std::string& challenge_hex,
+                                       uint32_t last_nonce) {
+    return "resync-ack" + device_id + challenge_hex + std::to_string(last_nonce);
+}
+
+std::string NonceResync::request(HmacSha256& hmac) const {
+    std::string device;
+    device.reserve(device_id_.size());
+    for (char c : device_id_) {
+        if (c == '"' || c == '\\') device += '\\';
+        device += c;
+    }
+    return "{\"device\":\"" + device + "\",\"challenge\":\"" + challenge_ + "\",\"mac\":\"" +
+           macHex(hmac, requestMacInput(device_id_, challenge_)) + "\"}";
+}
+
+bool NonceResync::parseReply(const std::string& body, HmacSha256& hmac, uint32_t& last_nonce) const {
+    std::string challenge, mac;
+    uint32_t nonce = 0;
+    if (!stringField(body, "challenge", challenge) || challenge != challenge_) return false;
+    if (!numberField(body, "last_nonce", nonce)) return false;
+    if (!stringField(body, "mac", mac) || mac.size() != 2 * SHA256_DIGEST_SIZE) return false;
+    std::string input = replyMacInput(device_id_, challenge_, nonce);
+    if (!hmac.verifyHex((const uint8_t*)input.data(), input.size(), mac.c_str())) return false;
+    last_nonce = nonce;
+    return true;
+}
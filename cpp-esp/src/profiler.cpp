@@ -0,0 +1,209 @@
+#include "../include/profiler.hpp"
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#ifdef ESP32
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+// Serialized capture, little endian:
+//   [0]  "EWPF"
+//   [4]  u8 version, u8 thread count, u8 flags (bit 0: buffer filled before the end),
+//        u8 reserved
+//   [8]  u32 session id (the command_id that started it)
+//   [12] u32 captured length in us
+//   [16] u32 event count
+//   [20] thread count x 16-byte NUL-padded task names
+//   then event count x 12-byte events: u32 t_us, u32 value, u8 kind, u8 tid, u16 id
+static constexpr size_t PROFILE_HEADER_SIZE = 20;
+static constexpr size_t PROFILE_EVENT_SIZE = 12;
+
+uint64_t profileClockUs() {
+#ifdef ESP32
+    return (uint64_t)esp_timer_get_time();
+#else
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+std::atomic<bool> Profiler::active_{false};
+std::atomic<ProfileState> Profiler::state_{ProfileState::IDLE};
+std::atomic<uint32_t> Profiler::next_{0};
+std::atomic<bool> Profiler::truncated_{false};
+std::atomic<uint32_t> Profiler::generation_{0};
+std::atomic<uint32_t> Profiler::writers_{0};
+ProfileEvent* Profiler::events_ = nullptr;
+size_t Profiler::capacity_ = 0;
+uint64_t Profiler::start_us_ = 0;
+uint64_t Profiler::end_us_ = 0;
+uint64_t Profiler::last_counters_us_ = 0;
+uint32_t Profiler::duration_us_ = 0;
+uint32_t Profiler::session_id_ = 0;
+std::atomic<uint8_t> Profiler::thread_count_{0};
+char Profiler::thread_names_[Profiler::MAX_THREADS][16];
+
+bool Profiler::start(uint32_t duration_ms, uint32_t session_id, size_t max_events) {
+    if (state() != ProfileState::IDLE || max_events == 0) return false;
+    events_ = new (std::nothrow) ProfileEvent[max_events];
+    if (!events_) return false;
+    capacity_ = max_events;
+    next_.store(0);
+    truncated_.store(false);
+    thread_count_.store(0);
+    memset(thread_names_, 0, sizeof(thread_names_));
+    generation_.fetch_add(1);
+    if (duration_ms == 0) duration_ms = 1;
+    if (duration_ms > MAX_DURATION_MS) duration_ms = MAX_DURATION_MS;
+    duration_us_ = duration_ms * 1000;
+    session_id_ = session_id;
+    last_counters_us_ = 0;
+    start_us_ = profileClockUs();
+    end_us_ = start_us_;
+    state_.store(ProfileState::CAPTURING, std::memory_order_release);
+    active_.store(true, std::memory_order_release);
+    return true;
+}
+
+uint8_t Profiler::threadSlot() {
+    // Slots are handed out per session, the first time a task records
+    thread_local uint32_t gen = 0;
+    thread_local uint8_t slot = 0;
+    uint32_t current = generation_.load(std::memory_order_relaxed);
+    if (gen == current) return slot;
+    uint8_t n = thread_count_.fetch_add(1);
+    if (n >= MAX_THREADS) {
+        thread_count_.store(MAX_THREADS);
+        slot = MAX_THREADS - 1;   // tasks past the limit share the last slot
+    } else {
+        slot = n;
+#ifdef ESP32
+        strncpy(thread_names_[n], pcTaskGetName(nullptr), sizeof(thread_names_[n]) - 1);
+#else
+        snprintf(thread_names_[n], sizeof(thread_names_[n]), "thread%u", (unsigned)n);
+#endif
+    }
+    gen = current;
+    return slot;
+}
+
+void Profiler::record(ProfileEventKind kind, uint16_t id, uint32_t value, uint64_t t_us) {
+    // Announce the write before checking active_ again: stop() clears active_ and then
+    // waits for writers_, so either this sees the session over or stop() sees this write
+    writers_.fetch_add(1);
+    if (!active_.load()) {
+        writers_.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    uint32_t i = next_.fetch_add(1, std::memory_order_relaxed);
+    if (i >= capacity_) {
+        truncated_.store(true, std::memory_order_relaxed);
+        active_.store(false, std::memory_order_relaxed);   // loopDone() ends the session
+    } else {
+        ProfileEvent& e = events_[i];
+        e.t_us = t_us > start_us_ ? (uint32_t)(t_us - start_us_) : 0;
+        e.value = value;
+        e.kind = (uint8_t)kind;
+        e.tid = threadSlot();
+        e.id = id;
+    }
+    writers_.fetch_sub(1, std::memory_order_release);
+}
+
+void Profiler::request(uint64_t start_us, int status) {
+    if (!active()) return;
+    uint64_t now = profileClockUs();
+    record(ProfileEventKind::REQUEST, (uint16_t)(int16_t)status, (uint32_t)(now - start_us), start_us);
+}
+
+void Profiler::counter(ProfileCounter c, uint32_t value) {
+    if (active()) record(ProfileEventKind::COUNTER, (uint16_t)c, value, profileClockUs());
+}
+
+void Profiler::sampleCounters() {
+#ifdef ESP32
+    counter(ProfileCounter::HEAP_FREE, (uint32_t)heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    counter(ProfileCounter::HEAP_MIN_FREE, (uint32_t)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT));
+    // High water mark of the calling (loop) task, in bytes on the ESP32 port
+    counter(ProfileCounter::STACK_FREE, (uint32_t)uxTaskGetStackHighWaterMark(nullptr));
+#endif
+}
+
+void Profiler::loopDone(uint64_t start_us) {
+    if (state() != ProfileState::CAPTURING) return;
+    uint64_t now = profileClockUs();
+    if (active()) {
+        if (start_us && now - start_us > LOOP_BUDGET_US) {
+            record(ProfileEventKind::LOOP_OVERRUN, 0, (uint32_t)(now - start_us), start_us);
+        }
+        if (last_counters_us_ == 0 || now - last_counters_us_ >= COUNTER_PERIOD_US) {
+            sampleCounters();
+            last_counters_us_ = now;
+        }
+    }
+    if (!active() || now - start_us_ >= duration_us_) stop();
+}
+
+void Profiler::stop() {
+    if (state() != ProfileState::CAPTURING) return;
+    active_.store(false);
+    end_us_ = profileClockUs();
+    // A record is a handful of stores, but its task may have been preempted in the middle
+    while (writers_.load(std::memory_order_acquire) != 0) {
+#ifdef ESP32
+        vTaskDelay(1);
+#else
+        std::this_thread::yield();
+#endif
+    }
+    state_.store(ProfileState::CAPTURED, std::memory_order_release);
+}
+
+size_t Profiler::events() {
+    uint32_t n = next_.load(std::memory_order_relaxed);
+    return n < capacity_ ? n : capacity_;
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+bool Profiler::serialize(std::vector<uint8_t>& out) {
+    if (state() != ProfileState::CAPTURED) return false;
+    size_t n = events();
+    uint8_t threads = thread_count_.load();
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    out.clear();
+    out.reserve(PROFILE_HEADER_SIZE + threads * 16 + n * PROFILE_EVENT_SIZE);
+    out.insert(out.end(), {'E', 'W', 'P', 'F', FORMAT_VERSION, threads, (uint8_t)(truncated() ? 1 : 0), 0});
+    putU32(out, session_id_);
+    putU32(out, (uint32_t)(end_us_ - start_us_));
+    putU32(out, (uint32_t)n);
+    for (uint8_t t = 0; t < threads; ++t) out.insert(out.end(), thread_names_[t], thread_names_[t] + 16);
+    for (size_t i = 0; i < n; ++i) {
+        const ProfileEvent& e = events_[i];
+        putU32(out, e.t_us);
+        putU32(out, e.value);
+        out.push_back(e.kind);
+        out.push_back(e.tid);
+        out.push_back((uint8_t)e.id);
+        out.push_back((uint8_t)(e.id >> 8));
+    }
+    return true;
+}
+
+void Profiler::release() {
+    stop();
+    delete[] events_;
+    events_ = nullptr;
+    capacity_ = 0;
+    next_.store(0);
+    state_.store(ProfileState::IDLE, std::memory_order_release);
+}
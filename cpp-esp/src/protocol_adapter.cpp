@@ -57,26 +57,44 @@ static bool extractJsonStringField(const char* json, const char* key, char* outB
 ProtocolAdapter::ProtocolAdapter(ConfigManager* config, EcoHttpClient* http_client)
     : config_(config), http_client_(http_client) {}
 
-bool ProtocolAdapter::readRegisters(uint16_t start_address, uint16_t num_registers, uint16_t *values) {
-    Logger::debug("Reading %d registers starting from address %d", num_registers, start_address);
-    
-    // Create Modbus frame for read
-    uint8_t frame[8];
-    frame[0] = config_->getModbusConfig().slave_address;
-    frame[1] = 0x03; // Function code: Read Holding Registers
-    frame[2] = (start_address >> 8) & 0xFF; // Start Address Hi
-    frame[3] = start_address & 0xFF;        // Start Address Lo
-    frame[4] = (num_registers >> 8) & 0xFF; // Quantity Hi
-    frame[5] = num_registers & 0xFF;        // Quantity Lo
-    uint16_t crc = modbus_crc16(frame, 6);
-    frame[6] = crc & 0xFF;
-    frame[7] = (crc >> 8) & 0xFF;
-    ApiConfig api = config_->getApiConfig();
-    
-    char hex_frame_str[17]; // 8 bytes * 2 chars/byte + 1 null terminator
-    for (int i = 0; i < 8; ++i) sprintf(hex_frame_str + i*2, "%02X", frame[i]);
+bool ProtocolAdapter::transact(const char* endpoint, uint8_t* frame, size_t len,
+                               uint8_t* response, int& response_len, uint8_t& exception_code, int& http_status) {
+    exception_code = 0;
+    http_status = 0;
+    response_len = 0;
 
-    char json_payload[64];
+    if (tcp_) {
+        size_t pdu_len = 0;
+        bool idempotent = frame[1] == 0x03 || frame[1] == 0x04;
+        bool sent = hedge_tcp_ && idempotent
+                        ? tcp_->hedgedTransact(*hedge_tcp_, hedge_policy_, frame + 1, len - 1, response + 1,
+                                               ModbusTcpClient::MAX_PDU, pdu_len)
+                        : tcp_->transact(frame + 1, len - 1, response + 1, ModbusTcpClient::MAX_PDU, pdu_len);
+        if (!sent || pdu_len < 2) {
+            Logger::warn("ProtocolAdapter: Modbus TCP request failed for function 0x%02X (%s).",
+                         frame[1], tcp_->lastError().c_str());
+            return false;
+        }
+        // Rebuild the RTU layout so validation and the callers' offsets are shared
+        response[0] = frame[0];
+        uint16_t rsp_crc = modbus_crc16(response, pdu_len + 1);
+        response[pdu_len + 1] = rsp_crc & 0xFF;
+        response[pdu_len + 2] = (rsp_crc >> 8) & 0xFF;
+        response_len = (int)pdu_len + 3;
+        return validateResponse(frame, response, exception_code);
+    }
+
+    uint16_t crc = modbus_crc16(frame, len);
+    frame[len] = crc & 0xFF;
+    frame[len + 1] = (crc >> 8) & 0xFF;
+    len += 2;
+
+    // Largest request is a 0x17 frame with MAX_RW_WRITE_REGISTERS values
+    char hex_frame_str[2 * (13 + 2 * MAX_RW_WRITE_REGISTERS) + 1];
+    if (len * 2 + 1 > sizeof(hex_frame_str)) return false;
+    for (size_t i = 0; i < len; ++i) sprintf(hex_frame_str + i*2, "%02X", frame[i]);
+
+    char json_payload[sizeof(hex_frame_str) + 16];
     snprintf(json_payload, sizeof(json_payload), "{\"frame\": \"%s\"}", hex_frame_str);
 
     ModbusConfig mb_cfg = config_->getModbusConfig();
@@ -85,13 +103,17 @@ bool ProtocolAdapter::readRegisters(uint16_t start_address, uint16_t num_registe
     EcoHttpResponse resp;
     bool success = false;
     while (attempt < maxRetries && !success) {
-    resp = http_client_->post(api.read_endpoint.c_str(), json_payload, strlen(json_payload), nullptr);
+        resp = http_client_->post(endpoint, json_payload, strlen(json_payload), nullptr);
         success = resp.isSuccess();
         attempt++;
+        // A 4xx means the SIM rejected the frame itself; resending it will not help
+        if (!success && resp.status_code >= 400 && resp.status_code < 500) break;
         if (!success && mb_cfg.retry_delay_ms) delay(mb_cfg.retry_delay_ms);
     }
+    http_status = resp.status_code;
     if (!success) {
-        Logger::warn("ProtocolAdapter: HTTP request failed for readRegisters after %d retries.", maxRetries);
+        Logger::warn("ProtocolAdapter: HTTP request failed for function 0x%02X after %d attempts (status %d).",
+                     frame[1], attempt, resp.status_code);
         return false;
     }
 
@@ -103,9 +125,7 @@ bool ProtocolAdapter::readRegisters(uint16_t start_address, uint16_t num_registe
     }
 
     // --- Full Modbus response frame validation ---
-    uint8_t response_bytes[256];
-    int response_len = hexToBytes(response_frame_hex, response_bytes, sizeof(response_bytes));
-
+    response_len = hexToBytes(response_frame_hex, response, 256);
     if (response_len < 5) {
         Logger::warn("ProtocolAdapter: Response frame too short (%d bytes).", response_len);
         return false; // Must have at least slave addr, func, byte count, and 2-byte CRC
@@ -113,30 +133,59 @@ bool ProtocolAdapter::readRegisters(uint16_t start_address, uint16_t num_registe
 
     // 1. Validate CRC
     // CRC in Modbus frames is little-endian: low byte first, high byte second
-    uint16_t received_crc = (uint16_t)response_bytes[response_len - 2] | ((uint16_t)response_bytes[response_len - 1] << 8);
-    uint16_t calculated_crc = modbus_crc16(response_bytes, response_len - 2);
+    uint16_t received_crc = (uint16_t)response[response_len - 2] | ((uint16_t)response[response_len - 1] << 8);
+    uint16_t calculated_crc = modbus_crc16(response, response_len - 2);
     if (received_crc != calculated_crc) {
         Logger::warn("ProtocolAdapter: CRC mismatch. Got 0x%04X, expected 0x%04X.", received_crc, calculated_crc);
         return false;
     }
 
+    return validateResponse(frame, response, exception_code);
+}
+
+bool ProtocolAdapter::validateResponse(const uint8_t* frame, const uint8_t* response, uint8_t& exception_code) {
     // 2. Validate Slave Address and Function Code
-    if (response_bytes[0] != config_->getModbusConfig().slave_address) {
-        Logger::warn("ProtocolAdapter: Slave address mismatch. Got %d, expected %d.", response_bytes[0], config_->getModbusConfig().slave_address);
+    if (response[0] != frame[0]) {
+        Logger::warn("ProtocolAdapter: Slave address mismatch. Got %d, expected %d.", response[0], frame[0]);
         return false;
     }
-    if (response_bytes[1] == (0x03 | 0x80)) { // Check for exception response
-        Logger::warn("ProtocolAdapter: Inverter returned exception code 0x%02X.", response_bytes[2]);
+    if (response[1] == (frame[1] | 0x80)) { // Check for exception response
+        exception_code = response[2];
+        Logger::warn("ProtocolAdapter: Inverter returned exception code 0x%02X for function 0x%02X.", response[2], frame[1]);
         return false;
     }
-    if (response_bytes[1] != 0x03) {
-        Logger::warn("ProtocolAdapter: Function code mismatch. Got 0x%02X, expected 0x03.", response_bytes[1]);
+    if (response[1] != frame[1]) {
+        Logger::warn("ProtocolAdapter: Function code mismatch. Got 0x%02X, expected 0x%02X.", response[1], frame[1]);
+        return false;
+    }
+    return true;
+}
+
+bool ProtocolAdapter::readBlock(uint8_t function, uint16_t start_address, uint16_t num_registers, uint16_t *values) {
+    Logger::debug("Reading %d registers starting from address %d (function 0x%02X)", num_registers, start_address, function);
+    if (num_registers == 0 || num_registers > MAX_READ_REGISTERS) return false;
+
+    // Create Modbus frame for read
+    uint8_t frame[8];
+    frame[0] = config_->getModbusConfig().slave_address;
+    frame[1] = function;                    // 0x03 Holding / 0x04 Input
+    frame[2] = (start_address >> 8) & 0xFF; // Start Address Hi
+    frame[3] = start_address & 0xFF;        // Start Address Lo
+    frame[4] = (num_registers >> 8) & 0xFF; // Quantity Hi
+    frame[5] = num_registers & 0xFF;        // Quantity Lo
+    ApiConfig api = config_->getApiConfig();
+
+    uint8_t response_bytes[256];
+    int response_len = 0;
+    uint8_t exception_code = 0;
+    int http_status = 0;
+    if (!transact(api.read_endpoint.c_str(), frame, 6, response_bytes, response_len, exception_code, http_status)) {
         return false;
     }
 
     // 3. Validate Byte Count
     uint8_t byte_count = response_bytes[2];
-    if (byte_count != num_registers * 2) {
+    if (byte_count != num_registers * 2 || response_len < 5 + byte_count) {
         Logger::warn("ProtocolAdapter: Byte count mismatch. Got %d, expected %d.", byte_count, num_registers * 2);
         return false;
     }
@@ -147,14 +196,22 @@ bool ProtocolAdapter::readRegisters(uint16_t start_address, uint16_t num_registe
         int offset = 3 + (i * 2); // Data starts at byte 3
         values[i] = (response_bytes[offset] << 8) | response_bytes[offset + 1];
     }
-    
+
     Logger::debug("Successfully read %d registers", num_registers);
     return true;
 }
 
+bool ProtocolAdapter::readRegisters(uint16_t start_address, uint16_t num_registers, uint16_t *values) {
+    return readBlock(0x03, start_address, num_registers, values);
+}
+
+bool ProtocolAdapter::readInputRegisters(uint16_t start_address, uint16_t num_registers, uint16_t *values) {
+    return readBlock(0x04, start_address, num_registers, values);
+}
+
 bool ProtocolAdapter::writeRegister(uint16_t register_address, uint16_t value) {
     Logger::debug("Writing value %d to register %d", value, register_address);
-    
+
     // Create Modbus frame for write
     uint8_t frame[8];
     frame[0] = config_->getModbusConfig().slave_address;
@@ -163,75 +220,84 @@ bool ProtocolAdapter::writeRegister(uint16_t register_address, uint16_t value) {
     frame[3] = register_address & 0xFF;        // Register Address Lo
     frame[4] = (value >> 8) & 0xFF;            // Value Hi
     frame[5] = value & 0xFF;                   // Value Lo
-    uint16_t crc = modbus_crc16(frame, 6);
-    frame[6] = crc & 0xFF;
-    frame[7] = (crc >> 8) & 0xFF;
     ApiConfig api = config_->getApiConfig();
 
-    char hex_frame_str[17];
-    for (int i = 0; i < 8; ++i) sprintf(hex_frame_str + i*2, "%02X", frame[i]);
-
-    char json_payload[64];
-    snprintf(json_payload, sizeof(json_payload), "{\"frame\": \"%s\"}", hex_frame_str);
-
-    ModbusConfig mb_cfg = config_->getModbusConfig();
-    int maxRetries = mb_cfg.max_retries ? mb_cfg.max_retries : 3;
-    int attempt = 0;
-    EcoHttpResponse resp;
-    bool success = false;
-    while (attempt < maxRetries && !success) {
-    resp = http_client_->post(api.write_endpoint.c_str(), json_payload, strlen(json_payload), nullptr);
-        success = resp.isSuccess();
-        attempt++;
-        if (!success && mb_cfg.retry_delay_ms) delay(mb_cfg.retry_delay_ms);
-    }
-    if (!success) {
-        Logger::warn("ProtocolAdapter: HTTP request failed for writeRegister after %d retries.", maxRetries);
+    uint8_t response_bytes[256];
+    int response_len = 0;
+    uint8_t exception_code = 0;
+    int http_status = 0;
+    if (!transact(api.write_endpoint.c_str(), frame, 6, response_bytes, response_len, exception_code, http_status)) {
         return false;
     }
 
-    // For a write, the response should be an echo of the request.
-    char response_frame_hex[512];
-    if (!extractJsonStringField(resp.body.c_str(), "frame", response_frame_hex, sizeof(response_frame_hex))) {
-        Logger::warn("ProtocolAdapter: No 'frame' in JSON response for write operation.");
-        return false;
+    // For a write, the response should be an echo of the request (same length and same bytes)
+    if (response_len == 8 && memcmp(frame, response_bytes, 8) == 0) {
+        Logger::debug("Successfully wrote value %d to register %d", value, register_address);
+        return true;
     }
+    Logger::warn("ProtocolAdapter: Write response is not an echo of the request.");
+    return false;
+}
+
+bool ProtocolAdapter::supportsReadWrite() const {
+    return rw_support_.usable(millis());
+}
+
+bool ProtocolAdapter::readWriteRegisters(uint16_t read_start, uint16_t read_count, uint16_t *read_values,
+                                         uint16_t write_start, uint16_t write_count, const uint16_t *write_values) {
+    if (!supportsReadWrite()) return false;
+    if (read_count == 0 || read_count > MAX_READ_REGISTERS) return false;
+    if (write_count == 0 || write_count > MAX_RW_WRITE_REGISTERS || !write_values) return false;
+    Logger::debug("Read/Write: writing %d registers at %d, reading %d registers at %d",
+                  write_count, write_start, read_count, read_start);
+
+    // Create Modbus frame for Read/Write Multiple Registers
+    uint8_t frame[13 + 2 * MAX_RW_WRITE_REGISTERS];
+    frame[0] = config_->getModbusConfig().slave_address;
+    size_t len = 1 + modbus_read_write_pdu(frame + 1, read_start, read_count, write_start, write_count, write_values);
+    ApiConfig api = config_->getApiConfig();
 
-    // Convert response hex to bytes and validate similarly to readRegisters
     uint8_t response_bytes[256];
-    int response_len = hexToBytes(response_frame_hex, response_bytes, sizeof(response_bytes));
-    if (response_len < 5) {
-        Logger::warn("ProtocolAdapter: Response frame too short (%d bytes) on write.", response_len);
-        return false;
-    }
-    uint16_t received_crc = (uint16_t)response_bytes[response_len - 2] | ((uint16_t)response_bytes[response_len - 1] << 8);
-    uint16_t calculated_crc = modbus_crc16(response_bytes, response_len - 2);
-    if (received_crc != calculated_crc) {
-        Logger::warn("ProtocolAdapter: CRC mismatch on write. Got 0x%04X, expected 0x%04X.", received_crc, calculated_crc);
-        return false;
-    }
-    // Validate slave address and function
-    if (response_bytes[0] != config_->getModbusConfig().slave_address) {
-        Logger::warn("ProtocolAdapter: Slave address mismatch on write. Got %d, expected %d.", response_bytes[0], config_->getModbusConfig().slave_address);
+    int response_len = 0;
+    uint8_t exception_code = 0;
+    int http_status = 0;
+    if (!transact(api.write_endpoint.c_str(), frame, len, response_bytes, response_len, exception_code, http_status)) {
+        if (rw_support_.onFailure(exception_code, http_status, millis())) {
+            Logger::warn("ProtocolAdapter: Function 0x17 not supported (exception 0x%02X, status %d), "
+                         "using 0x06 + 0x03 for %u s.", exception_code, http_status,
+                         (unsigned)(ModbusReadWriteSupport::REPROBE_MS / 1000));
+        }
         return false;
     }
-    if (response_bytes[1] == (0x06 | 0x80)) {
-        Logger::warn("ProtocolAdapter: Inverter returned exception on write operation.");
+    rw_support_.onSuccess();
+
+    if (!modbus_read_values(response_bytes + 1, response_len - 3, read_count, read_values)) {
+        Logger::warn("ProtocolAdapter: Read/Write byte count mismatch. Got %d, expected %d.",
+                     response_bytes[2], read_count * 2);
         return false;
     }
-    // Success if response echoes request (same length and same bytes)
-    if (response_len == 8) {
-        bool match = true;
-        for (int i = 0; i < 8; ++i) {
-            uint8_t sent_byte = (uint8_t)strtol(hex_frame_str + i*2, nullptr, 16);
-            if (sent_byte != response_bytes[i]) { match = false; break; }
-        }
-        if (match) {
-            Logger::debug("Successfully wrote value %d to register %d", value, register_address);
-            return true;
+
+    Logger::debug("Successfully wrote %d and read back %d registers", write_count, read_count);
+    return true;
+}
+
+size_t ProtocolAdapter::readBatch(ModbusRead* reads, size_t count) {
+    if (tcp_) {
+        size_t ok = hedge_tcp_ ? tcp_->hedgedReadBatch(*hedge_tcp_, hedge_policy_, reads, count)
+                               : tcp_->readBatch(reads, count);
+        if (ok < count) {
+            Logger::warn("ProtocolAdapter: %u of %u pipelined reads failed (%s).",
+                         (unsigned)(count - ok), (unsigned)count, tcp_->lastError().c_str());
         }
+        return ok;
     }
-    return false;
+    size_t ok = 0;
+    for (size_t i = 0; i < count; ++i) {
+        reads[i].exception = 0;
+        reads[i].ok = readBlock(reads[i].function, reads[i].start, reads[i].count, reads[i].values);
+        if (reads[i].ok) ok++;
+    }
+    return ok;
 }
 
 bool ProtocolAdapter::testCommunication() {
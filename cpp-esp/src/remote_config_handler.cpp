@@ -2,12 +2,19 @@
 #include <ArduinoJson.h>
 #include <vector>
 #include <string>
+#include <cstring>
 #include "../include/ticker_fallback.hpp"
 #include "../include/remote_config_handler.hpp"
+#include "../include/uplink_packetizer.hpp"
 #include "../include/logger.hpp"
+#include "../include/cpu_accounting.hpp"
 
 RemoteConfigHandler* RemoteConfigHandler::instance_ = nullptr;
 
+static size_t responseDocCapacity(size_t json_len);
+static bool readConfigUpdate(JsonDocument& doc, ConfigUpdateRequest& request);
+static size_t readCommands(JsonDocument& doc, std::vector<CommandRequest>& commands);
+
 RemoteConfigHandler::RemoteConfigHandler(ConfigManager* config, SecureHttpClient* secure_http, CommandExecutor* cmd_executor)
     : pollTicker_(pollTaskWrapper, 60000), config_(config), secure_http_(secure_http), cmd_executor_(cmd_executor) {
     instance_ = this;
@@ -18,7 +25,11 @@ void RemoteConfigHandler::begin(uint32_t interval_ms) {
     pollInterval_ = interval_ms;
     pollTicker_.interval(pollInterval_);
     running_ = true;
-    pollTicker_.start();
+    // Spread a fleet that boots together across the whole interval
+    uint32_t phase = fleetPhaseOffsetMs(deviceId_, pollInterval_);
+    flow_.setJitterSeed(fnv1a32(deviceId_.data(), deviceId_.size()));
+    pollTicker_.startWithPhase(phase);
+    Logger::info("[RemoteCfg] Poll interval %u ms, phase offset %u ms", (unsigned)pollInterval_, (unsigned)phase);
 }
 
 void RemoteConfigHandler::end() {
@@ -29,10 +40,20 @@ void RemoteConfigHandler::end() {
 void RemoteConfigHandler::loop() {
     if (running_) {
         pollTicker_.update();
+        // Only once the queue can take a full batch; commands it rejects as full
+        // still count as delivered on the server
+        if (repollWanted_ > 0 && (!cmd_executor_ || cmd_executor_->queueSpace() >= repollWanted_)) {
+            repollWanted_ = 0;
+            pollTask();
+        }
     }
 }
 
 void RemoteConfigHandler::pollTask() {
+    if (!flow_.canSend(millis())) {
+        Logger::info("[RemoteCfg] Deferred by server for another %u ms", (unsigned)flow_.deferRemainingMs(millis()));
+        return;
+    }
     checkForConfigUpdate();
 }
 
@@ -61,6 +82,11 @@ void RemoteConfigHandler::checkForConfigUpdate() {
     plain_response = resp.body;
     
     Logger::info("[RemoteCfg] Response status: %d", resp.status_code);
+    if (flow_.applyHints(resp.retry_after, resp.next_interval, millis())) {
+        pollInterval_ = flow_.intervalMs();
+        pollTicker_.interval(pollInterval_);
+        Logger::info("[RemoteCfg] Server set poll interval to %u ms", (unsigned)pollInterval_);
+    }
     Logger::info("[RemoteCfg] Response body length: %u bytes", (unsigned)plain_response.length());
     
     if (!resp.isSuccess()) {
@@ -68,11 +94,22 @@ void RemoteConfigHandler::checkForConfigUpdate() {
         return;
     }
     
-    // Parse the response for config updates (use plain_response instead of resp.body)
+    // One parse serves both the config update and the command batch
+    DynamicJsonDocument doc(responseDocCapacity(plain_response.length()));
+    {
+        CpuScope cpu(CpuSubsystem::JSON);
+        DeserializationError error = deserializeJson(doc, plain_response);
+        if (error) {
+            Logger::error("[RemoteCfg] JSON parse error: %s", error.c_str());
+            return;
+        }
+    }
+    
     ConfigUpdateRequest request;
-    if (parseConfigUpdateRequest(plain_response.c_str(), request)) {
+    if (readConfigUpdate(doc, request)) {
         // Apply the configuration update
         ConfigUpdateAck ack = config_->applyConfigUpdate(request);
+        if (!ack.accepted.empty()) configVersion_ = ack.nonce;
         
         // Send acknowledgment back to cloud
         sendConfigAck(ack);
@@ -83,23 +120,30 @@ void RemoteConfigHandler::checkForConfigUpdate() {
         }
     }
     
-    // Parse the response for commands (use plain_response)
-    CommandRequest command;
-    if (parseCommandRequest(plain_response.c_str(), command)) {
-        Logger::info("[RemoteCfg] Received command: id=%u, action=%s, target=%s, value=%.2f",
-                     command.command_id, command.action.c_str(), 
-                     command.target_register.c_str(), command.value);
+    std::vector<CommandRequest> commands;
+    if (readCommands(doc, commands)) {
+        Logger::info("[RemoteCfg] Received %u commands", (unsigned)commands.size());
         
-        // Queue command for execution if executor is available
+        // Queue the whole batch for execution if executor is available
         if (cmd_executor_) {
-            cmd_executor_->queueCommand(command);
+            cmd_executor_->queueCommands(commands);
         }
         
         // Trigger callback if set
         if (onCommandCallback_) {
-            onCommandCallback_(command);
+            for (const CommandRequest& command : commands) onCommandCallback_(command);
         }
     }
+    
+    // The server had more than fits in one response: fetch the rest without waiting
+    // for the next poll, as soon as there is room for the next batch (at most half the
+    // queue, see MAX_COMMANDS_PER_POLL in app.py)
+    uint32_t remaining = doc["commands_remaining"] | 0u;
+    repollWanted_ = remaining < CommandQueue::MAX_PENDING / 2 ? remaining : CommandQueue::MAX_PENDING / 2;
+    if (remaining > 0) {
+        Logger::info("[RemoteCfg] %u more commands pending, polling again once %u fit",
+                     (unsigned)remaining, (unsigned)repollWanted_);
+    }
 }
 
 void RemoteConfigHandler::checkForCommands() {
@@ -118,18 +162,19 @@ void RemoteConfigHandler::checkForCommands() {
     }
 }
 
-bool RemoteConfigHandler::parseConfigUpdateRequest(const char* json, ConfigUpdateRequest& request) {
-    DynamicJsonDocument doc(1024);  // Allocate on heap instead of stack
-    DeserializationError error = deserializeJson(doc, json);
-    
-    if (error) {
-        Logger::error("[RemoteCfg] JSON parse error: %s", error.c_str());
-        return false;
-    }
-    
+// Room for a poll response: ArduinoJson copies the strings of a const input and needs a
+// slot per value, roughly twice the text for a batch of small command objects
+static size_t responseDocCapacity(size_t json_len) {
+    return 1024 + 2 * json_len;
+}
+
+static bool readConfigUpdate(JsonDocument& doc, ConfigUpdateRequest& request) {
     // Initialize request
     request.has_sampling_interval = false;
     request.has_registers = false;
+    request.has_uplink_batch = false;
+    request.uplink_target_bytes = 0;
+    request.uplink_max_age_ms = 0;
     request.nonce = 0;
     request.timestamp = millis();
     
@@ -202,7 +247,29 @@ bool RemoteConfigHandler::parseConfigUpdateRequest(const char* json, ConfigUpdat
         }
     }
     
-    return request.has_sampling_interval || request.has_registers;
+    // Parse uplink batching targets: {"target_bytes": N, "max_age": seconds}
+    if (config_update.containsKey("uplink_batch")) {
+        JsonObject batch = config_update["uplink_batch"];
+        request.uplink_target_bytes = batch["target_bytes"] | 0u;
+        request.uplink_max_age_ms = (batch["max_age"] | 0u) * 1000;
+        request.has_uplink_batch = request.uplink_target_bytes || request.uplink_max_age_ms;
+        Logger::debug("[RemoteCfg] Parsed uplink_batch: %u bytes, %u ms",
+                      request.uplink_target_bytes, request.uplink_max_age_ms);
+    }
+
+    return request.has_sampling_interval || request.has_registers || request.has_uplink_batch;
+}
+
+bool RemoteConfigHandler::parseConfigUpdateRequest(const char* json, ConfigUpdateRequest& request) {
+    CpuScope cpu(CpuSubsystem::JSON);
+    DynamicJsonDocument doc(responseDocCapacity(strlen(json)));
+    DeserializationError error = deserializeJson(doc, json);
+    
+    if (error) {
+        Logger::error("[RemoteCfg] JSON parse error: %s", error.c_str());
+        return false;
+    }
+    return readConfigUpdate(doc, request);
 }
 
 void RemoteConfigHandler::sendConfigAck(const ConfigUpdateAck& ack) {
@@ -213,6 +280,10 @@ void RemoteConfigHandler::sendConfigAck(const ConfigUpdateAck& ack) {
     
     // Send ACK to cloud using secured POST
     std::string ack_endpoint = config_->getApiConfig().config_endpoint + "/ack";
+    if (uplink_ && uplink_->enqueue(UplinkLane::URGENT, ackJson, ack_endpoint)) {
+        Logger::info("[RemoteCfg] Config acknowledgment queued on urgent lane");
+        return;
+    }
     std::string plain_response;
     EcoHttpResponse resp = secure_http_->securePost(ack_endpoint.c_str(), ackJson, plain_response);
     
@@ -273,34 +344,31 @@ void RemoteConfigHandler::pollTaskWrapper() {
     }
 }
 
-bool RemoteConfigHandler::parseCommandRequest(const char* json, CommandRequest& command) {
-    DynamicJsonDocument doc(1024);  // Allocate on heap instead of stack
-    DeserializationError error = deserializeJson(doc, json);
-    
-    if (error) {
-        Logger::error("[RemoteCfg] JSON parse error for command: %s", error.c_str());
-        return false;
-    }
-    
-    // Check if there's a command object
-    if (!doc.containsKey("command")) {
-        Logger::debug("[RemoteCfg] No command in response");
+static bool readCommand(JsonObject cmd, CommandRequest& command) {
+    // Parse command fields (register and value only matter for register writes)
+    if (!cmd.containsKey("command_id") || !cmd.containsKey("action")) {
+        Logger::warn("[RemoteCfg] Command missing required fields");
         return false;
     }
-    
-    JsonObject cmd = doc["command"];
-    
-    // Parse command fields
-    if (!cmd.containsKey("command_id") || !cmd.containsKey("action") || 
-        !cmd.containsKey("target_register") || !cmd.containsKey("value")) {
+    command.action = cmd["action"].as<const char*>();
+    if (command.action == "write_register" &&
+        (!cmd.containsKey("target_register") || !cmd.containsKey("value"))) {
         Logger::warn("[RemoteCfg] Command missing required fields");
         return false;
     }
     
     command.command_id = cmd["command_id"].as<uint32_t>();
-    command.action = cmd["action"].as<const char*>();
-    command.target_register = cmd["target_register"].as<const char*>();
-    command.value = cmd["value"].as<float>();
+    command.target_register = cmd["target_register"] | "";
+    command.value = cmd["value"] | 0.0f;
+    if (cmd.containsKey("params")) {
+        JsonObject params = cmd["params"];
+        command.boots_ago = params["boots_ago"] | 0;
+        command.from_s = params["from_s"] | 0;
+        command.to_s = params["to_s"] | 0;
+        command.duration_s = params["duration_s"] | 0;
+    }
+    command.priority = cmd["priority"] | 0;
+    command.ttl_s = cmd["ttl_s"] | 0u;
     command.timestamp = cmd.containsKey("timestamp") ? cmd["timestamp"].as<uint32_t>() : millis();
     command.nonce = cmd.containsKey("nonce") ? cmd["nonce"].as<uint32_t>() : command.timestamp;
     
@@ -311,6 +379,35 @@ bool RemoteConfigHandler::parseCommandRequest(const char* json, CommandRequest&
     return true;
 }
 
+// {"commands": [{...}, ...]}, or a single {"command": {...}}
+static size_t readCommands(JsonDocument& doc, std::vector<CommandRequest>& commands) {
+    size_t before = commands.size();
+    if (doc.containsKey("commands")) {
+        for (JsonObject cmd : doc["commands"].as<JsonArray>()) {
+            CommandRequest command;
+            if (readCommand(cmd, command)) commands.push_back(command);
+        }
+    } else if (doc.containsKey("command")) {
+        CommandRequest command;
+        if (readCommand(doc["command"], command)) commands.push_back(command);
+    } else {
+        Logger::debug("[RemoteCfg] No command in response");
+    }
+    return commands.size() - before;
+}
+
+size_t RemoteConfigHandler::parseCommandRequests(const char* json, std::vector<CommandRequest>& commands) {
+    CpuScope cpu(CpuSubsystem::JSON);
+    DynamicJsonDocument doc(responseDocCapacity(strlen(json)));
+    DeserializationError error = deserializeJson(doc, json);
+    
+    if (error) {
+        Logger::error("[RemoteCfg] JSON parse error for command: %s", error.c_str());
+        return 0;
+    }
+    return readCommands(doc, commands);
+}
+
 void RemoteConfigHandler::sendCommandResults(const std::vector<CommandResult>& results) {
     if (results.empty()) {
         return;
@@ -323,6 +420,10 @@ void RemoteConfigHandler::sendCommandResults(const std::vector<CommandResult>& r
     
     // Send results to cloud using secured POST
     std::string result_endpoint = config_->getApiConfig().config_endpoint + "/command/result";
+    if (uplink_ && uplink_->enqueue(UplinkLane::URGENT, resultsJson, result_endpoint)) {
+        Logger::info("[RemoteCfg] Command results queued on urgent lane");
+        return;
+    }
     std::string plain_response;
     EcoHttpResponse resp = secure_http_->securePost(result_endpoint.c_str(), resultsJson, plain_response);
     
@@ -334,7 +435,8 @@ void RemoteConfigHandler::sendCommandResults(const std::vector<CommandResult>& r
 }
 
 std::string RemoteConfigHandler::generateCommandResultsJson(const std::vector<CommandResult>& results) {
-    DynamicJsonDocument doc(2048);  // Allocate on heap instead of stack
+    // One report carries the whole batch; ~200 bytes per result with its messages
+    DynamicJsonDocument doc(512 + 256 * results.size());
     
     doc["timestamp"] = millis();
     doc["result_count"] = results.size();
@@ -0,0 +1,111 @@
+#include "../include/rtt_estimator.hpp"
+#include <cstdio>
+#include <cstring>
+
+static constexpr uint8_t MAX_BACKOFF = 16;   // far past max_ms from any min_ms
+
+uint32_t RttEstimator::clamp(uint32_t ms) const {
+    if (ms < limits_.min_ms) return limits_.min_ms;
+    if (ms > limits_.max_ms) return limits_.max_ms;
+    return ms;
+}
+
+uint32_t RttEstimator::timeoutMs() const {
+    uint32_t rto = limits_.initial_ms;
+    if (samples_) {
+        uint32_t var = rttvar4_ > limits_.granularity_ms ? rttvar4_ : limits_.granularity_ms;
+        rto = srttMs() + var;
+    }
+    rto = clamp(rto);
+    for (uint8_t i = 0; i < backoff_ && rto < limits_.max_ms; ++i) rto *= 2;
+    return clamp(rto);
+}
+
+void RttEstimator::onSample(uint32_t rtt_ms) {
+    if (rtt_ms > limits_.max_ms) rtt_ms = limits_.max_ms;
+    if (!samples_) {
+        srtt8_ = rtt_ms << 3;
+        rttvar4_ = rtt_ms << 1;   // RTTVAR = R/2
+    } else {
+        uint32_t srtt = srttMs();
+        uint32_t err = rtt_ms > srtt ? rtt_ms - srtt : srtt - rtt_ms;
+        rttvar4_ = rttvar4_ - (rttvar4_ >> 2) + err;
+        srtt8_ = srtt8_ - (srtt8_ >> 3) + rtt_ms;
+    }
+    samples_++;
+    backoff_ = 0;
+}
+
+void RttEstimator::onTimeout() {
+    timeouts_++;
+    if (backoff_ < MAX_BACKOFF) backoff_++;
+}
+
+std::string EndpointRtt::keyFor(const char* endpoint) {
+    const char* p = endpoint ? endpoint : "";
+    // Full URL: drop the scheme and host
+    const char* scheme = strstr(p, "://");
+    if (scheme) {
+        const char* path = strchr(scheme + 3, '/');
+        p = path ? path : "/";
+    }
+    size_t len = strcspn(p, "?#");
+    if (len > KEY_LEN - 1) len = KEY_LEN - 1;
+    return std::string(p, len);
+}
+
+EndpointRtt::Slot& EndpointRtt::slotFor(const char* endpoint) {
+    std::string key = keyFor(endpoint);
+    ++tick_;
+    Slot* lru = &slots_[0];
+    for (Slot& s : slots_) {
+        if (s.used && key == s.key) {
+            s.used = tick_;
+            return s;
+        }
+        if (s.used < lru->used) lru = &s;
+    }
+    memset(lru->key, 0, sizeof(lru->key));
+    memcpy(lru->key, key.data(), key.size());
+    lru->est = RttEstimator(limits_);
+    lru->used = tick_;
+    return *lru;
+}
+
+uint32_t EndpointRtt::timeoutMs(const char* endpoint) {
+    return slotFor(endpoint).est.timeoutMs();
+}
+
+void EndpointRtt::onSample(const char* endpoint, uint32_t rtt_ms) {
+    slotFor(endpoint).est.onSample(rtt_ms);
+}
+
+void EndpointRtt::onTimeout(const char* endpoint) {
+    slotFor(endpoint).est.onTimeout();
+}
+
+const RttEstimator* EndpointRtt::find(const char* endpoint) const {
+    std::string key = keyFor(endpoint);
+    for (const Slot& s : slots_) {
+        if (s.used && key == s.key) return &s.est;
+    }
+    return nullptr;
+}
+
+std::string EndpointRtt::json() const {
+    std::string out = "{";
+    bool first = true;
+    for (const Slot& s : slots_) {
+        if (!s.used) continue;
+        if (!first) out += ",";
+        out += "\"";
+        out.append(s.key, strnlen(s.key, KEY_LEN));
+        char buf[112];
+        snprintf(buf, sizeof(buf), "\":{\"srtt\":%u,\"rttvar\":%u,\"rto\":%u,\"samples\":%u,\"timeouts\":%u}",
+                 (unsigned)s.est.srttMs(), (unsigned)s.est.rttvarMs(), (unsigned)s.est.timeoutMs(),
+                 (unsigned)s.est.samples(), (unsigned)s.est.timeouts());
+        out += buf;
+        first = false;
+    }
+    return out + "}";
+}
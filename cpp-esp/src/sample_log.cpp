@@ -0,0 +1,446 @@
+#include "../include/sample_log.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#ifndef ESP32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// CRC-16/CCITT-FALSE
+uint16_t SampleLog::crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; ++b) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+static void putU32(uint8_t* p, uint32_t v) {
+    for (int i = 0; i < 4; ++i) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool isErased(const SampleLogRecord& r) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&r);
+    for (size_t i = 0; i < sizeof(r); ++i) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static bool recordValid(const SampleLogRecord& r) {
+    return r.flags == 0 && r.crc == SampleLog::crc16(reinterpret_cast<const uint8_t*>(&r), 10);
+}
+
+void SampleLogZone::add(float value) {
+    if (std::isnan(value)) return;
+    count++;
+    if (value < min) min = value;
+    if (value > max) max = value;
+    sum += value;
+}
+
+void SampleLogZone::merge(const SampleLogZone& other) {
+    count += other.count;
+    if (other.min < min) min = other.min;
+    if (other.max > max) max = other.max;
+    sum += other.sum;
+}
+
+void SampleLogZoneMap::add(const SampleLogRecord& r) {
+    if (r.ts < ts_min) ts_min = r.ts;
+    if (r.ts > ts_max) ts_max = r.ts;
+    records++;
+    if (r.reg < REGS) {
+        regs[r.reg].add(r.value);
+    } else {
+        other_regs = true;
+    }
+}
+
+SampleLogQuery SampleLogQuery::between(uint8_t reg, float lo, float hi) {
+    SampleLogQuery q;
+    q.reg = reg;
+    q.min_value = lo;
+    q.max_value = hi;
+    return q;
+}
+
+SampleLogQuery SampleLogQuery::above(uint8_t reg, float threshold) {
+    return between(reg, std::nextafter(threshold, INFINITY), INFINITY);
+}
+
+SampleLogQuery SampleLogQuery::below(uint8_t reg, float threshold) {
+    return between(reg, -INFINITY, std::nextafter(threshold, -INFINITY));
+}
+
+SampleLog::SampleLog(SampleLogRegion* region) : region_(region) {}
+
+bool SampleLog::readHeader(size_t sector, uint32_t& seq, uint32_t& first_ts) const {
+    const uint8_t* h = sectorPtr(sector);
+    if (getU32(h) != MAGIC || h[12] != VERSION) return false;
+    if ((uint16_t)(h[14] | (h[15] << 8)) != crc16(h, 14)) return false;
+    seq = getU32(h + 4);
+    first_ts = getU32(h + 8);
+    return true;
+}
+
+size_t SampleLog::countRecords(size_t sector, bool& torn) const {
+    torn = false;
+    const SampleLogRecord* recs = recordsOf(sector);
+    for (size_t i = 0; i < RECORDS_PER_SECTOR; ++i) {
+        if (isErased(recs[i])) return i;
+        if (!recordValid(recs[i])) {
+            torn = true;
+            return i;
+        }
+    }
+    return RECORDS_PER_SECTOR;
+}
+
+bool SampleLog::begin() {
+    ready_ = false;
+    if (!region_ || !region_->data()) return false;
+    sector_count_ = region_->size() / SECTOR_SIZE;
+    if (sector_count_ < 2) return false;
+
+    // Head = newest valid header (serial comparison, so seq may wrap)
+    bool found = false;
+    uint32_t seq = 0, first_ts = 0;
+    for (size_t s = 0; s < sector_count_; ++s) {
+        if (!readHeader(s, seq, first_ts)) continue;
+        if (!found || (int32_t)(seq - head_seq_) > 0) {
+            head_ = s;
+            head_seq_ = seq;
+            found = true;
+        }
+    }
+    empty_ = !found;
+    records_ = 0;
+    used_.assign(sector_count_, 0);
+    zones_.clear();
+    zones_.shrink_to_fit();
+    if (empty_) {
+        head_ = tail_ = 0;
+        head_seq_ = 0;
+        head_used_ = 0;
+        head_closed_ = false;
+        ready_ = true;
+        return true;
+    }
+
+    // Live ring: walk back while the previous sector continues the sequence
+    tail_ = head_;
+    uint32_t expect = head_seq_;
+    for (size_t steps = 1; steps < sector_count_; ++steps) {
+        size_t prev = (tail_ + sector_count_ - 1) % sector_count_;
+        if (!readHeader(prev, seq, first_ts) || seq != expect - 1) break;
+        tail_ = prev;
+        expect = seq;
+    }
+
+    for (size_t s = tail_;; s = (s + 1) % sector_count_) {
+        bool torn = false;
+        used_[s] = (uint16_t)countRecords(s, torn);
+        if (torn) stats_.torn_records++;
+        if (s == head_) head_closed_ = torn;
+        records_ += used_[s];
+        if (s == head_) break;
+    }
+    head_used_ = used_[head_];
+    ready_ = true;
+    return true;
+}
+
+bool SampleLog::openSector(size_t sector, uint32_t seq, uint32_t first_ts) {
+    if (!region_->erase(sector * SECTOR_SIZE, SECTOR_SIZE)) return false;
+    stats_.sectors_erased++;
+    uint8_t h[HEADER_SIZE];
+    putU32(h, MAGIC);
+    putU32(h + 4, seq);
+    putU32(h + 8, first_ts);
+    h[12] = VERSION;
+    h[13] = 0;
+    uint16_t crc = crc16(h, 14);
+    h[14] = crc & 0xFF;
+    h[15] = crc >> 8;
+    if (!region_->write(sector * SECTOR_SIZE, h, sizeof(h))) return false;
+    stats_.bytes_written += sizeof(h);
+    return true;
+}
+
+bool SampleLog::append(const Sample* samples, size_t count) {
+    if (!ready_) return false;
+    // Staged on the stack so a flash write covers up to this many records
+    constexpr size_t STAGE = 64;
+    SampleLogRecord stage[STAGE];
+
+    while (count > 0) {
+        if (empty_ || head_closed_ || head_used_ == RECORDS_PER_SECTOR) {
+            size_t next = empty_ ? 0 : (head_ + 1) % sector_count_;
+            uint32_t next_seq = empty_ ? 1 : head_seq_ + 1;
+            if (!empty_ && next == tail_) {
+                // Ring full: the oldest sector is the one erased
+                size_t dropped = used_[tail_];
+                records_ -= dropped;
+                stats_.records_dropped += (uint32_t)dropped;
+                used_[tail_] = 0;
+                if (!zones_.empty()) zones_[tail_] = SampleLogZoneMap();
+                tail_ = (tail_ + 1) % sector_count_;
+            }
+            if (!openSector(next, next_seq, samples[0].timestamp)) {
+                stats_.write_errors++;
+                if (!empty_) head_closed_ = true;
+                return false;
+            }
+            if (empty_) tail_ = next;
+            empty_ = false;
+            head_ = next;
+            head_seq_ = next_seq;
+            head_used_ = 0;
+            head_closed_ = false;
+            used_[head_] = 0;
+            if (!zones_.empty()) zones_[head_] = SampleLogZoneMap();
+        }
+
+        size_t n = RECORDS_PER_SECTOR - head_used_;
+        if (n > count) n = count;
+        if (n > STAGE) n = STAGE;
+        for (size_t i = 0; i < n; ++i) {
+            SampleLogRecord& r = stage[i];
+            r.ts = samples[i].timestamp;
+            r.value = samples[i].value;
+            r.reg = samples[i].reg_addr;
+            r.flags = 0;
+            r.crc = crc16(reinterpret_cast<const uint8_t*>(&r), 10);
+        }
+        size_t offset = head_ * SECTOR_SIZE + HEADER_SIZE + head_used_ * sizeof(SampleLogRecord);
+        if (!region_->write(offset, stage, n * sizeof(SampleLogRecord))) {
+            // Part of the range may be programmed; never write over it again
+            stats_.write_errors++;
+            head_closed_ = true;
+            return false;
+        }
+        if (!zones_.empty()) {
+            for (size_t i = 0; i < n; ++i) zones_[head_].add(stage[i]);
+        }
+        head_used_ += n;
+        used_[head_] = (uint16_t)head_used_;
+        records_ += n;
+        stats_.records_written += (uint32_t)n;
+        stats_.bytes_written += (uint32_t)(n * sizeof(SampleLogRecord));
+        samples += n;
+        count -= n;
+    }
+    return true;
+}
+
+size_t SampleLog::scan(uint32_t start_ts, uint32_t end_ts, const Visitor& fn) const {
+    if (!ready_ || empty_) return 0;
+    size_t visited = 0;
+    for (size_t s = tail_;; s = (s + 1) % sector_count_) {
+        const SampleLogRecord* recs = recordsOf(s);
+        size_t used = usedIn(s);
+        for (size_t i = 0; i < used; ++i) {
+            if (recs[i].ts < start_ts || recs[i].ts > end_ts) continue;
+            ++visited;
+            if (!fn(recs[i])) return visited;
+        }
+        if (s == head_) break;
+    }
+    return visited;
+}
+
+void SampleLog::buildZones() const {
+    if (!ready_ || !zones_.empty()) return;
+    zones_.assign(sector_count_, SampleLogZoneMap());
+    for (size_t s = tail_; !empty_; s = (s + 1) % sector_count_) {
+        const SampleLogRecord* recs = recordsOf(s);
+        for (size_t i = 0; i < usedIn(s); ++i) zones_[s].add(recs[i]);
+        if (s == head_) break;
+    }
+}
+
+bool SampleLog::querySector(size_t sector, const SampleLogQuery& q, const Visitor& fn,
+                            SampleLogQueryStats& st) const {
+    const SampleLogZoneMap& zone = zones_[sector];
+    bool possible = zone.records > 0 && zone.ts_max >= q.start_ts && zone.ts_min <= q.end_ts;
+    if (possible && q.reg < SampleLogZoneMap::REGS) {
+        const SampleLogZone& z = zone.regs[q.reg];
+        possible = z.count > 0 && z.max >= q.min_value && z.min <= q.max_value;
+    } else if (possible) {
+        possible = zone.other_regs;
+    }
+    if (!possible) {
+        st.sectors_skipped++;
+        return true;
+    }
+    st.sectors_scanned++;
+    const SampleLogRecord* recs = recordsOf(sector);
+    size_t used = usedIn(sector);
+    st.records_decoded += (uint32_t)used;
+    for (size_t i = 0; i < used; ++i) {
+        if (!q.matches(recs[i])) continue;
+        st.matches++;
+        if (!fn(recs[i])) return false;
+    }
+    return true;
+}
+
+size_t SampleLog::query(const SampleLogQuery& q, const Visitor& fn, SampleLogQueryStats* stats) const {
+    SampleLogQueryStats st;
+    buildZones();
+    if (ready_ && !empty_) {
+        for (size_t s = tail_;; s = (s + 1) % sector_count_) {
+            if (!querySector(s, q, fn, st)) break;
+            if (s == head_) break;
+        }
+    }
+    if (stats) *stats = st;
+    return st.matches;
+}
+
+SampleLogZone SampleLog::summarize(uint8_t reg, uint32_t start_ts, uint32_t end_ts,
+                                   SampleLogQueryStats* stats) const {
+    SampleLogZone out;
+    SampleLogQueryStats st;
+    SampleLogQuery q;
+    q.reg = reg;
+    q.during(start_ts, end_ts);
+    auto fold = [&](const SampleLogRecord& r) {
+        out.add(r.value);
+        return true;
+    };
+    buildZones();
+    for (size_t s = tail_; ready_ && !empty_; s = (s + 1) % sector_count_) {
+        const SampleLogZoneMap& zone = zones_[s];
+        if (reg < SampleLogZoneMap::REGS && zone.records > 0 && zone.ts_min >= start_ts && zone.ts_max <= end_ts) {
+            st.sectors_summarized++;
+            out.merge(zone.regs[reg]);
+        } else {
+            querySector(s, q, fold, st);
+        }
+        if (s == head_) break;
+    }
+    if (stats) *stats = st;
+    return out;
+}
+
+size_t SampleLog::readLast(size_t n, Sample* out, size_t out_size) const {
+    if (n > out_size) n = out_size;
+    if (n > records_) n = records_;
+    if (!ready_ || empty_ || n == 0) return 0;
+    size_t skip = records_ - n;
+    size_t got = 0;
+    for (size_t s = tail_; got < n; s = (s + 1) % sector_count_) {
+        const SampleLogRecord* recs = recordsOf(s);
+        size_t used = usedIn(s);
+        if (skip >= used) {
+            skip -= used;
+        } else {
+            for (size_t i = skip; i < used && got < n; ++i) {
+                out[got++] = Sample{recs[i].ts, recs[i].reg, recs[i].value};
+            }
+            skip = 0;
+        }
+        if (s == head_) break;
+    }
+    return got;
+}
+
+bool SampleLog::clear() {
+    if (!region_) return false;
+    bool ok = true;
+    for (size_t s = 0; s < sector_count_; ++s) {
+        if (!region_->erase(s * SECTOR_SIZE, SECTOR_SIZE)) ok = false;
+        stats_.sectors_erased++;
+    }
+    empty_ = true;
+    head_ = tail_ = 0;
+    head_used_ = 0;
+    head_closed_ = false;
+    records_ = 0;
+    used_.assign(sector_count_, 0);
+    if (!zones_.empty()) zones_.assign(sector_count_, SampleLogZoneMap());
+    return ok;
+}
+
+std::string SampleLog::statsJson() const {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "{\"records\":%u,\"capacity\":%u,\"sectors\":%u,\"head_seq\":%u,\"records_written\":%u,"
+             "\"bytes_written\":%u,\"sectors_erased\":%u,\"records_dropped\":%u,\"torn_records\":%u,"
+             "\"write_errors\":%u}",
+             (unsigned)records_, (unsigned)capacity(), (unsigned)sector_count_, (unsigned)head_seq_,
+             (unsigned)stats_.records_written, (unsigned)stats_.bytes_written, (unsigned)stats_.sectors_erased,
+             (unsigned)stats_.records_dropped, (unsigned)stats_.torn_records, (unsigned)stats_.write_errors);
+    return std::string(buf);
+}
+
+#ifdef ESP32
+EspPartitionRegion::~EspPartitionRegion() {
+    if (map_) spi_flash_munmap(handle_);
+}
+
+bool EspPartitionRegion::begin() {
+    part_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)SUBTYPE, LABEL);
+    if (!part_) return false;
+    const void* ptr = nullptr;
+    if (esp_partition_mmap(part_, 0, part_->size, SPI_FLASH_MMAP_DATA, &ptr, &handle_) != ESP_OK) {
+        part_ = nullptr;
+        return false;
+    }
+    map_ = static_cast<const uint8_t*>(ptr);
+    return true;
+}
+
+bool EspPartitionRegion::erase(size_t offset, size_t len) {
+    return part_ && esp_partition_erase_range(part_, offset, len) == ESP_OK;
+}
+
+bool EspPartitionRegion::write(size_t offset, const void* src, size_t len) {
+    return part_ && esp_partition_write(part_, offset, src, len) == ESP_OK;
+}
+#else
+MappedFileRegion::MappedFileRegion(const std::string& path, size_t size) : size_(size) {
+    fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) return;
+    struct stat st;
+    size_t old_size = fstat(fd_, &st) == 0 ? (size_t)st.st_size : 0;
+    if (old_size != size && ftruncate(fd_, (off_t)size) != 0) return;
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) return;
+    map_ = static_cast<uint8_t*>(p);
+    // Fresh flash reads as erased
+    if (old_size < size) memset(map_ + old_size, 0xFF, size - old_size);
+}
+
+MappedFileRegion::~MappedFileRegion() {
+    if (map_) {
+        msync(map_, size_, MS_SYNC);
+        munmap(map_, size_);
+    }
+    if (fd_ >= 0) close(fd_);
+}
+
+bool MappedFileRegion::erase(size_t offset, size_t len) {
+    if (!map_ || offset % SampleLog::SECTOR_SIZE || len % SampleLog::SECTOR_SIZE || offset + len > size_) return false;
+    memset(map_ + offset, 0xFF, len);
+    return true;
+}
+
+bool MappedFileRegion::write(size_t offset, const void* src, size_t len) {
+    if (!map_ || offset + len > size_) return false;
+    const uint8_t* s = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < len; ++i) map_[offset + i] &= s[i];   // NOR: bits only go 1 -> 0
+    return true;
+}
+#endif
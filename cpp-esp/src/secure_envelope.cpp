@@ -0,0 +1,150 @@
+#include "../include/secure_envelope.hpp"
+#include <cstdio>
+#include <cstring>
+
+static const char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Buffered writer over IoChain::tailSpace so each output byte is written once
+namespace {
+class TailWriter {
+public:
+    TailWriter(IoChain& out, size_t headroom) : out_(out), headroom_(headroom) {}
+    ~TailWriter() { flush(); }
+    bool put(char c) {
+        if (used_ == avail_) {
+            flush();
+            dst_ = out_.tailSpace(avail_, headroom_);
+            headroom_ = 0;
+            if (!dst_ || avail_ == 0) return false;
+        }
+        dst_[used_++] = (uint8_t)c;
+        written_++;
+        return true;
+    }
+    void flush() {
+        if (dst_) out_.commit(used_);
+        dst_ = nullptr;
+        used_ = avail_ = 0;
+    }
+    size_t written() const { return written_; }
+
+private:
+    IoChain& out_;
+    size_t headroom_;
+    uint8_t* dst_ = nullptr;
+    size_t avail_ = 0;
+    size_t used_ = 0;
+    size_t written_ = 0;
+};
+}
+
+namespace {
+struct Base64Reverse {
+    int8_t v[256];
+    Base64Reverse() {
+        memset(v, -1, sizeof(v));
+        for (int i = 0; i < 64; ++i) v[(uint8_t)kBase64[i]] = (int8_t)i;
+    }
+};
+}
+
+std::string base64Encode(const uint8_t* data, size_t len) {
+    std::string out;
+    out.reserve((len + 2) / 3 * 4);
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)data[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len) v |= data[i + 2];
+        out += kBase64[(v >> 18) & 0x3F];
+        out += kBase64[(v >> 12) & 0x3F];
+        out += i + 1 < len ? kBase64[(v >> 6) & 0x3F] : '=';
+        out += i + 2 < len ? kBase64[v & 0x3F] : '=';
+    }
+    return out;
+}
+
+size_t base64Decode(const char* in, size_t len, uint8_t* out, size_t out_cap) {
+    static const Base64Reverse reverse;
+    const int8_t* table = reverse.v;
+    size_t n = 0;
+    uint32_t bits = 0;
+    int nbits = 0;
+    for (size_t i = 0; i < len && in[i] != '='; ++i) {
+        int8_t v = table[(uint8_t)in[i]];
+        if (v < 0) continue;
+        bits = (bits << 6) | (uint32_t)v;
+        nbits += 6;
+        if (nbits >= 8) {
+            nbits -= 8;
+            if (n == out_cap) return 0;
+            out[n++] = (uint8_t)(bits >> nbits);
+            bits &= (1u << nbits) - 1;
+        }
+    }
+    return n;
+}
+
+size_t base64AppendChain(const IoChain& in, IoChain& out, size_t headroom) {
+    TailWriter w(out, headroom);
+    uint8_t group[3];
+    size_t n = 0;
+    bool ok = true;
+    for (size_t s = 0; s < in.count() && ok; ++s) {
+        const uint8_t* p = in[s].data();
+        for (size_t i = 0; i < in[s].length() && ok; ++i) {
+            group[n++] = p[i];
+            if (n < 3) continue;
+            ok = w.put(kBase64[group[0] >> 2]) && w.put(kBase64[((group[0] & 0x03) << 4) | (group[1] >> 4)]) &&
+                 w.put(kBase64[((group[1] & 0x0F) << 2) | (group[2] >> 6)]) && w.put(kBase64[group[2] & 0x3F]);
+            n = 0;
+        }
+    }
+    if (ok && n > 0) {
+        if (n == 1) group[1] = 0;
+        w.put(kBase64[group[0] >> 2]);
+        w.put(kBase64[((group[0] & 0x03) << 4) | (group[1] >> 4)]);
+        w.put(n == 2 ? kBase64[(group[1] & 0x0F) << 2] : '=');
+        w.put('=');
+    }
+    w.flush();
+    return w.written();
+}
+
+bool sealEnvelope(const IoChain& payload, uint32_t nonce, uint32_t timestamp, bool encrypted,
+                  HmacSha256& hmac, IoChain& out) {
+    out.clear();
+    size_t text_len = base64AppendChain(payload, out, ENVELOPE_HEADROOM);
+    if (text_len != (payload.length() + 2) / 3 * 4) return false;
+
+    char nonce_str[12], ts_str[12];
+    int nonce_len = snprintf(nonce_str, sizeof(nonce_str), "%u", (unsigned)nonce);
+    int ts_len = snprintf(ts_str, sizeof(ts_str), "%u", (unsigned)timestamp);
+    const char* flag = encrypted ? "1" : "0";
+
+    hmac.begin();
+    hmac.update((const uint8_t*)nonce_str, (size_t)nonce_len);
+    hmac.update((const uint8_t*)ts_str, (size_t)ts_len);
+    hmac.update((const uint8_t*)flag, 1);
+    for (size_t i = 0; i < out.count(); ++i) hmac.update(out[i].data(), out[i].length());
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    hmac.finish(mac);
+
+    char prefix[ENVELOPE_HEADROOM];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "{\"nonce\":%s,\"timestamp\":%s,\"encrypted\":%s,\"payload\":\"",
+                              nonce_str, ts_str, encrypted ? "true" : "false");
+    if (prefix_len <= 0 || (size_t)prefix_len >= sizeof(prefix)) return false;
+
+    static const char hex[] = "0123456789abcdef";
+    char suffix[10 + 2 * SHA256_DIGEST_SIZE + 3];
+    size_t k = 0;
+    memcpy(suffix, "\",\"mac\":\"", 9);
+    k = 9;
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; ++i) {
+        suffix[k++] = hex[mac[i] >> 4];
+        suffix[k++] = hex[mac[i] & 0x0F];
+    }
+    suffix[k++] = '"';
+    suffix[k++] = '}';
+
+    return out.prependCopy(prefix, (size_t)prefix_len) && out.appendCopy(suffix, k);
+}
@@ -73,11 +73,86 @@ EcoHttpResponse SecureHttpClient::securePost(const char* endpoint,
     
     if (!response.isSuccess()) {
         Logger::warn("[SecureHttp] HTTP POST failed: status=%d", response.status_code);
+        resyncIfReplay(response);
         return response;
     }
     
     // Verify and extract response
-    sec_result = security_->verifyMessage(response.body, plain_response);
+    verifyResponse(response, plain_response);
+    
+    // Logger::debug("[SecureHttp] POST completed: status=%d, response=%u bytes",
+    //              response.status_code, (unsigned)plain_response.length());
+    
+    return response;
+}
+
+EcoHttpResponse SecureHttpClient::securePost(const char* endpoint,
+                                            const IoChain& payload,
+                                            std::string& plain_response) {
+    EcoHttpResponse response;
+    
+    if (!http_client_) {
+        Logger::error("[SecureHttp] HTTP client not initialized");
+        response.status_code = 0;
+        return response;
+    }
+    
+    if (!security_enabled_ || !security_) {
+        Logger::debug("[SecureHttp] Security disabled, using plain HTTP POST");
+        response = http_client_->post(endpoint, payload);
+        plain_response = response.body;
+        return response;
+    }
+    
+    IoChain envelope(payload.pool());
+    SecurityResult sec_result = security_->secureMessage(payload, envelope);
+    if (!sec_result.is_success()) {
+        Logger::error("[SecureHttp] Failed to secure message: %s",
+                     sec_result.error_message.c_str());
+        response.status_code = 0;
+        return response;
+    }
+    
+    response = http_client_->post(endpoint, envelope, "application/json");
+    if (!response.isSuccess()) {
+        Logger::warn("[SecureHttp] HTTP POST failed: status=%d", response.status_code);
+        resyncIfReplay(response);
+        return response;
+    }
+    
+    verifyResponse(response, plain_response);
+    return response;
+}
+
+bool SecureHttpClient::resyncNonce(const std::string& device_id) {
+    if (!http_client_ || !security_enabled_ || !security_) return false;
+    device_id_ = device_id;
+    
+    std::string body = security_->beginNonceResync(device_id);
+    if (body.empty()) return false;
+    
+    EcoHttpResponse response = http_client_->post("/api/security/resync", body.c_str(),
+                                                  body.length(), "application/json");
+    if (!response.isSuccess()) {
+        Logger::warn("[SecureHttp] Nonce resync failed: status=%d", response.status_code);
+        return false;
+    }
+    if (!security_->finishNonceResync(response.body)) return false;
+    nonce_synced_ = true;
+    return true;
+}
+
+void SecureHttpClient::resyncIfReplay(const EcoHttpResponse& response) {
+    // The server answers a nonce at or below the last one it accepted with 401/403
+    // and "Replay attack detected" / "Invalid nonce (replay attack)"
+    if (response.status_code != 401 && response.status_code != 403) return;
+    if (response.body.find("eplay") == std::string::npos || device_id_.empty()) return;
+    Logger::warn("[SecureHttp] Request rejected as a replay, resyncing nonce");
+    resyncNonce(device_id_);
+}
+
+void SecureHttpClient::verifyResponse(const EcoHttpResponse& response, std::string& plain_response) {
+    SecurityResult sec_result = security_->verifyMessage(response.body, plain_response);
     
     if (!sec_result.is_success()) {
         Logger::error("[SecureHttp] Failed to verify response: %s",
@@ -88,11 +163,6 @@ EcoHttpResponse SecureHttpClient::securePost(const char* endpoint,
         Logger::warn("[SecureHttp] Treating response as plain text");
         plain_response = response.body;
     }
-    
-    // Logger::debug("[SecureHttp] POST completed: status=%d, response=%u bytes",
-    //              response.status_code, (unsigned)plain_response.length());
-    
-    return response;
 }
 
 EcoHttpResponse SecureHttpClient::secureGet(const char* endpoint,
@@ -151,6 +221,7 @@ EcoHttpResponse SecureHttpClient::secureGet(const char* endpoint,
     
     if (!response.isSuccess()) {
         Logger::warn("[SecureHttp] HTTP GET failed: status=%d", response.status_code);
+        resyncIfReplay(response);
         return response;
     }
     
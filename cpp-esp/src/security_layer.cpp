@@ -1,12 +1,13 @@
 #include "../include/security_layer.hpp"
 #include "../include/logger.hpp"
+#include "../include/secure_envelope.hpp"
+#include "../include/cpu_accounting.hpp"
 #include <Arduino.h>
 #include <FS.h>
 #include <LittleFS.h>
 
 // Include cryptographic libraries
 #ifdef ESP32
-    #include <mbedtls/md.h>
     #include <mbedtls/aes.h>
     #include <mbedtls/base64.h>
 #else
@@ -16,7 +17,6 @@
     #include <Crypto.h>
     #include <AES.h>
     #include <CBC.h>
-    #include <SHA256.h>
 #endif
 
 #include <ArduinoJson.h>
@@ -35,6 +35,7 @@ SecurityLayer::SecurityLayer(const SecurityConfig& config)
     , messages_verified_(0)
     , replay_attempts_(0)
     , mac_failures_(0)
+    , nonce_resyncs_(0)
     , mutex_initialized_(false) {
     
     // Reserve space for nonce history
@@ -77,7 +78,7 @@ bool SecurityLayer::begin() {
         last_received_nonce_ = 0;
         recent_nonces_.clear();
         
-        Logger::warn("[Security] Using recovery mode - ready for server sync");
+        Logger::warn("[Security] Using recovery mode until the nonce is resynced");
     }
     
     Logger::info("[Security] Security layer initialized");
@@ -115,6 +116,7 @@ void SecurityLayer::end() {
 
 SecurityResult SecurityLayer::secureMessage(const std::string& plain_payload,
                                            SecuredMessage& secured_msg) {
+    CpuScope cpu(CpuSubsystem::SECURITY);
     SecurityResult result;
     result.status = SecurityStatus::SUCCESS;
     
@@ -196,12 +198,51 @@ std::string SecurityLayer::generateSecuredEnvelope(const SecuredMessage& secured
     return result;
 }
 
+SecurityResult SecurityLayer::secureMessage(const IoChain& payload, IoChain& envelope) {
+    CpuScope cpu(CpuSubsystem::SECURITY);
+    SecurityResult result;
+    result.status = SecurityStatus::SUCCESS;
+    
+    if (config_.encryption_enabled && config_.use_real_encryption) {
+        // AES-CBC works on the whole plaintext; keep the string pipeline for it
+        SecuredMessage secured_msg;
+        result = secureMessage(payload.toString(), secured_msg);
+        if (!result.is_success()) return result;
+        std::string json = generateSecuredEnvelope(secured_msg);
+        envelope.clear();
+        envelope.appendCopy(json.data(), json.length());
+        return result;
+    }
+    
+    if (!ensureHmacKey(config_.psk)) {
+        result.status = SecurityStatus::KEY_ERROR;
+        result.error_message = "HMAC computation failed";
+        Logger::error("[Security] %s", result.error_message.c_str());
+        return result;
+    }
+    
+    uint32_t nonce = getNextNonce();
+    if (!sealEnvelope(payload, nonce, millis(), config_.encryption_enabled, *hmac_, envelope)) {
+        result.status = SecurityStatus::INVALID_FORMAT;
+        result.error_message = "Envelope buffer allocation failed";
+        Logger::error("[Security] %s", result.error_message.c_str());
+        return result;
+    }
+    
+    messages_secured_++;
+    Logger::debug("[Security] Message secured: nonce=%u, %u -> %u bytes in %u slices",
+                 nonce, (unsigned)payload.length(), (unsigned)envelope.length(), (unsigned)envelope.count());
+    
+    return result;
+}
+
 // ============================================================================
 // Incoming Message Verification
 // ============================================================================
 
 SecurityResult SecurityLayer::verifyMessage(const std::string& secured_json,
                                            std::string& plain_payload) {
+    CpuScope cpu(CpuSubsystem::SECURITY);
     SecurityResult result;
     result.status = SecurityStatus::SUCCESS;
     
@@ -512,6 +553,38 @@ bool SecurityLayer::saveNonceState() {
     return true;
 }
 
+std::string SecurityLayer::beginNonceResync(const std::string& device_id) {
+    if (!ensureHmacKey(config_.psk)) return "";
+    uint8_t challenge[NonceResync::CHALLENGE_SIZE];
+    for (size_t i = 0; i < sizeof(challenge); i += 4) {
+        uint32_t r = esp_random();
+        memcpy(challenge + i, &r, 4);
+    }
+    resync_.reset(new NonceResync(device_id, challenge));
+    return resync_->request(*hmac_);
+}
+
+bool SecurityLayer::finishNonceResync(const std::string& reply) {
+    if (!resync_ || !ensureHmacKey(config_.psk)) return false;
+    uint32_t last_nonce = 0;
+    if (!resync_->parseReply(reply, *hmac_, last_nonce)) {
+        Logger::warn("[Security] Nonce resync reply rejected");
+        return false;
+    }
+    resync_.reset();
+    
+    lock();
+    uint32_t before = current_nonce_;
+    current_nonce_ = NonceResync::nextNonce(current_nonce_, last_nonce);
+    nonce_resyncs_++;
+    unlock();
+    
+    Logger::info("[Security] Nonce resynced: server last=%u, current %u -> %u",
+                last_nonce, before, current_nonce_);
+    saveNonceState();
+    return true;
+}
+
 uint32_t SecurityLayer::estimateRecoveryNonce() {
     // Smart recovery strategy: estimate a safe nonce value when state loading fails
     
@@ -547,45 +620,28 @@ uint32_t SecurityLayer::estimateRecoveryNonce() {
 // ============================================================================
 
 std::string SecurityLayer::computeHMAC(const std::string& data, const std::string& key) {
-    uint8_t hmac_result[HMAC_SIZE];
-    
-#ifdef ESP32
-    // Use mbedtls for ESP32
-    mbedtls_md_context_t ctx;
-    mbedtls_md_type_t md_type = MBEDTLS_MD_SHA256;
-    
-    mbedtls_md_init(&ctx);
-    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(md_type), 1);
-    
-    // Convert hex key to bytes
-    uint8_t key_bytes[PSK_SIZE];
-    if (!hexToBytes(key, key_bytes, PSK_SIZE)) {
-        Logger::error("[Security] Failed to convert key from hex");
-        mbedtls_md_free(&ctx);
-        return "";
-    }
-    
-    mbedtls_md_hmac_starts(&ctx, key_bytes, PSK_SIZE);
-    mbedtls_md_hmac_update(&ctx, (const uint8_t*)data.c_str(), data.length());
-    mbedtls_md_hmac_finish(&ctx, hmac_result);
-    
-    mbedtls_md_free(&ctx);
-    
-#else
-    // Use BearSSL/Crypto for ESP8266
+    return computeHMAC((const uint8_t*)data.data(), data.length(), key);
+}
+
+bool SecurityLayer::ensureHmacKey(const std::string& key) {
+    // The key is decoded and its pads hashed once, not on every message
+    if (hmac_ && hmac_key_ == key) return true;
     uint8_t key_bytes[PSK_SIZE];
     if (!hexToBytes(key, key_bytes, PSK_SIZE)) {
         Logger::error("[Security] Failed to convert key from hex");
-        return "";
+        return false;
     }
+    hmac_.reset(new HmacSha256(key_bytes, PSK_SIZE));
+    hmac_key_ = key;
+    memset(key_bytes, 0, sizeof(key_bytes));
+    return true;
+}
+
+std::string SecurityLayer::computeHMAC(const uint8_t* data, size_t len, const std::string& key) {
+    if (!ensureHmacKey(key)) return "";
     
-    // Use SHA256 HMAC
-    SHA256 sha256;
-    sha256.resetHMAC(key_bytes, PSK_SIZE);
-    sha256.update((const uint8_t*)data.c_str(), data.length());
-    sha256.finalizeHMAC(key_bytes, PSK_SIZE, hmac_result, HMAC_SIZE);
-#endif
-    
+    uint8_t hmac_result[HMAC_SIZE];
+    hmac_->compute(data, len, hmac_result);
     return bytesToHex(hmac_result, HMAC_SIZE);
 }
 
@@ -610,6 +666,11 @@ bool SecurityLayer::verifyHMAC(const std::string& data, const std::string& mac,
     return diff == 0;
 }
 
+bool SecurityLayer::verifyHMAC(const uint8_t* data, size_t len, const char* mac_hex) {
+    if (!ensureHmacKey(config_.psk)) return false;
+    return hmac_->verifyHex(data, len, mac_hex);
+}
+
 bool SecurityLayer::encryptAES(const std::string& plain_data, std::string& encrypted_data) {
     // Derive AES key and IV from PSK
     uint8_t key[AES_KEY_SIZE];
@@ -746,6 +807,7 @@ std::string SecurityLayer::getSecurityStats() const {
     doc["messages_verified"] = messages_verified_;
     doc["replay_attempts"] = replay_attempts_;
     doc["mac_failures"] = mac_failures_;
+    doc["nonce_resyncs"] = nonce_resyncs_;
     doc["current_nonce"] = current_nonce_;
     doc["last_received_nonce"] = last_received_nonce_;
     doc["nonce_history_size"] = recent_nonces_.size();
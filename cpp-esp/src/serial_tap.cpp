@@ -0,0 +1,100 @@
+#include "../include/serial_tap.hpp"
+#include "../include/modbus_frame.hpp"
+#include "../include/uplink_codec.hpp"
+
+size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t code_pos = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; ++i) {
+        if (in[i] != 0) {
+            out[o++] = in[i];
+            code++;
+        }
+        if (in[i] == 0 || code == 0xFF) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    return o;
+}
+
+bool cobsDecode(const uint8_t* in, size_t len, std::vector<uint8_t>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) return false;
+        for (uint8_t k = 1; k < code; ++k) {
+            if (in[i] == 0) return false;
+            out.push_back(in[i++]);
+        }
+        // A block shorter than 254 data bytes stands for a zero, except at the end
+        if (code != 0xFF && i < len) out.push_back(0);
+    }
+    return true;
+}
+
+void SerialTap::start(uint32_t from_seq) {
+    active_ = true;
+    cursor_ = from_seq;
+    packet_.clear();
+    sent_ = 0;
+}
+
+void SerialTap::stop() {
+    active_ = false;
+    packet_.clear();
+    sent_ = 0;
+}
+
+size_t SerialTap::feed(const Sample* samples, size_t count, uint32_t first_seq) {
+    if (!wantsSamples() || count == 0) return 0;
+    if ((int32_t)(first_seq - cursor_) > 0) dropped_ += first_seq - cursor_;
+
+    payload_.clear();
+    for (int i = 0; i < 4; ++i) payload_.push_back((uint8_t)(first_seq >> (8 * i)));
+    size_t used = encodeFrameBatch(samples, count, MAX_BATCH_BYTES, payload_);
+    if (used == 0) {
+        // Not frameable (register outside the frame map); skip it rather than stall
+        cursor_ = first_seq + 1;
+        dropped_++;
+        return 1;
+    }
+    uint16_t crc = modbus_crc16(payload_.data(), (uint16_t)payload_.size());
+    payload_.push_back((uint8_t)(crc & 0xFF));
+    payload_.push_back((uint8_t)(crc >> 8));
+
+    packet_.resize(cobsMaxEncoded(payload_.size()) + 1);
+    size_t n = cobsEncode(payload_.data(), payload_.size(), packet_.data());
+    packet_[n] = 0;
+    packet_.resize(n + 1);
+    sent_ = 0;
+
+    cursor_ = first_seq + (uint32_t)used;
+    packets_++;
+    samples_ += (uint32_t)used;
+    return used;
+}
+
+const uint8_t* SerialTap::pending(size_t& len) const {
+    len = packet_.size() - sent_;
+    return packet_.data() + sent_;
+}
+
+void SerialTap::consume(size_t n) {
+    size_t left = packet_.size() - sent_;
+    if (n > left) n = left;
+    sent_ += n;
+    bytes_ += (uint32_t)n;
+}
+
+std::string SerialTap::statsJson() const {
+    return std::string("{\"active\":") + (active_ ? "true" : "false") +
+           ",\"packets\":" + std::to_string(packets_) +
+           ",\"samples\":" + std::to_string(samples_) +
+           ",\"bytes\":" + std::to_string(bytes_) +
+           ",\"dropped\":" + std::to_string(dropped_) + "}";
+}
@@ -0,0 +1,526 @@
+#include "../include/sha256_engine.hpp"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if !defined(ESP32) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#ifdef ESP32
+#include <mbedtls/version.h>
+// mbedtls 2.x only has the int-returning calls under the _ret names
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+#define SHA256_STARTS mbedtls_sha256_starts_ret
+#define SHA256_UPDATE mbedtls_sha256_update_ret
+#define SHA256_FINISH mbedtls_sha256_finish_ret
+#else
+#define SHA256_STARTS mbedtls_sha256_starts
+#define SHA256_UPDATE mbedtls_sha256_update
+#define SHA256_FINISH mbedtls_sha256_finish
+#endif
+#endif
+
+static const uint32_t K256[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t H256[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+static inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+static inline uint32_t loadBE32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void storeBE32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+// ---------- Portable ----------
+
+static void compressPortable(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    uint32_t w[64];
+    for (; blocks; --blocks, data += SHA256_BLOCK_SIZE) {
+        for (int i = 0; i < 16; ++i) w[i] = loadBE32(data + 4 * i);
+        for (int i = 16; i < 64; ++i) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K256[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+// ---------- x86 SHA extensions ----------
+
+#ifdef SHA256_X86
+__attribute__((target("sha,sse4.1")))
+static void compressShaNi(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The rounds instruction wants the state as ABEF / CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks; --blocks, data += SHA256_BLOCK_SIZE) {
+        const __m128i abef = state0;
+        const __m128i cdgh = state1;
+        __m128i w[4];
+        for (int g = 0; g < 16; ++g) {
+            __m128i cur;
+            if (g < 4) {
+                cur = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * g)), bswap);
+            } else {
+                // w[t-16] + s0(w[t-15]) + w[t-7] + s1(w[t-2]), four words at a time
+                cur = _mm_sha256msg1_epu32(w[g & 3], w[(g + 1) & 3]);
+                cur = _mm_add_epi32(cur, _mm_alignr_epi8(w[(g + 3) & 3], w[(g + 2) & 3], 4));
+                cur = _mm_sha256msg2_epu32(cur, w[(g + 3) & 3]);
+            }
+            w[g & 3] = cur;
+            __m128i msg = _mm_add_epi32(cur, _mm_loadu_si128((const __m128i*)&K256[4 * g]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+// ---------- AVX2, eight messages per pass ----------
+
+namespace {
+constexpr int LANES = 8;
+
+struct LaneJob {
+    const uint8_t* data = nullptr;
+    size_t full_blocks = 0;
+    size_t blocks = 0;                        // including padding
+    uint8_t tail[2 * SHA256_BLOCK_SIZE];
+    uint8_t* digest = nullptr;
+};
+}  // namespace
+
+__attribute__((target("avx2"))) static inline __m256i rotr8(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+__attribute__((target("avx2")))
+static void compressAvx2x8(LaneJob* jobs, int used) {
+    static const uint8_t zero_block[SHA256_BLOCK_SIZE] = {0};
+    size_t max_blocks = 0;
+    for (int l = 0; l < used; ++l) max_blocks = std::max(max_blocks, jobs[l].blocks);
+
+    __m256i s[8];
+    for (int i = 0; i < 8; ++i) s[i] = _mm256_set1_epi32((int)H256[i]);
+
+    alignas(32) uint32_t words[LANES];
+    __m256i w[64];
+    for (size_t blk = 0; blk < max_blocks; ++blk) {
+        const uint8_t* src[LANES];
+        for (int l = 0; l < LANES; ++l) {
+            const LaneJob* j = l < used ? &jobs[l] : nullptr;
+            if (!j || blk >= j->blocks) src[l] = zero_block;   // idle lane
+            else if (blk < j->full_blocks) src[l] = j->data + blk * SHA256_BLOCK_SIZE;
+            else src[l] = j->tail + (blk - j->full_blocks) * SHA256_BLOCK_SIZE;
+        }
+        for (int i = 0; i < 16; ++i) {
+            for (int l = 0; l < LANES; ++l) words[l] = loadBE32(src[l] + 4 * i);
+            w[i] = _mm256_load_si256((const __m256i*)words);
+        }
+        for (int i = 16; i < 64; ++i) {
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w[i - 15], 7), rotr8(w[i - 15], 18)),
+                                          _mm256_srli_epi32(w[i - 15], 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w[i - 2], 17), rotr8(w[i - 2], 19)),
+                                          _mm256_srli_epi32(w[i - 2], 10));
+            w[i] = _mm256_add_epi32(_mm256_add_epi32(w[i - 16], s0), _mm256_add_epi32(w[i - 7], s1));
+        }
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int i = 0; i < 64; ++i) {
+            __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(e, 6), rotr8(e, 11)), rotr8(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1),
+                                          _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32((int)K256[i])), w[i]));
+            __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(a, 2), rotr8(a, 13)), rotr8(a, 22));
+            __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)),
+                                           _mm256_and_si256(b, c));
+            __m256i t2 = _mm256_add_epi32(S0, maj);
+            h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+            d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+        }
+        s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+        s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+        s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+        s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+
+        // Lanes whose last block this was take their digest out now
+        for (int l = 0; l < used; ++l) {
+            if (jobs[l].blocks != blk + 1) continue;
+            for (int i = 0; i < 8; ++i) {
+                _mm256_store_si256((__m256i*)words, s[i]);
+                storeBE32(jobs[l].digest + 4 * i, words[l]);
+            }
+        }
+    }
+}
+
+static bool cpuHasShaNi() {
+    static const bool has = [] {
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+        return (ebx & (1u << 29)) != 0 && __builtin_cpu_supports("sse4.1");
+    }();
+    return has;
+}
+
+static bool cpuHasAvx2() {
+    static const bool has = __builtin_cpu_supports("avx2");
+    return has;
+}
+#endif  // SHA256_X86
+
+// ---------- Backend selection ----------
+
+typedef void (*CompressFn)(uint32_t*, const uint8_t*, size_t);
+
+static CompressFn compressFor(Sha256Backend backend) {
+#ifdef SHA256_X86
+    if (backend == Sha256Backend::SHA_NI && cpuHasShaNi()) return compressShaNi;
+#else
+    (void)backend;
+#endif
+    return compressPortable;
+}
+
+const char* sha256BackendName(Sha256Backend backend) {
+    switch (backend) {
+        case Sha256Backend::PORTABLE: return "portable";
+        case Sha256Backend::SHA_NI: return "sha-ni";
+        case Sha256Backend::AVX2_MB: return "avx2-x8";
+        case Sha256Backend::ESP32_HW: return "esp32-hw";
+    }
+    return "unknown";
+}
+
+bool sha256BackendAvailable(Sha256Backend backend) {
+    switch (backend) {
+        case Sha256Backend::PORTABLE: return true;
+#ifdef SHA256_X86
+        case Sha256Backend::SHA_NI: return cpuHasShaNi();
+        case Sha256Backend::AVX2_MB: return cpuHasAvx2();
+#endif
+#ifdef ESP32
+        case Sha256Backend::ESP32_HW: return true;
+#endif
+        default: return false;
+    }
+}
+
+Sha256Backend sha256BestBackend() {
+#ifdef ESP32
+    return Sha256Backend::ESP32_HW;
+#elif defined(SHA256_X86)
+    return cpuHasShaNi() ? Sha256Backend::SHA_NI : Sha256Backend::PORTABLE;
+#else
+    return Sha256Backend::PORTABLE;
+#endif
+}
+
+Sha256Backend sha256MultiBackend() {
+#ifdef SHA256_X86
+    if (!cpuHasShaNi() && cpuHasAvx2()) return Sha256Backend::AVX2_MB;
+#endif
+    return sha256BestBackend();
+}
+
+// ---------- Sha256 ----------
+
+Sha256::Sha256(Sha256Backend backend) : backend_(backend) {
+    if (!sha256BackendAvailable(backend_)) backend_ = Sha256Backend::PORTABLE;
+#ifdef ESP32
+    mbedtls_sha256_init(&ctx_);
+#endif
+    reset();
+}
+
+Sha256::Sha256(const Sha256& other)
+    : backend_(other.backend_), total_(other.total_), buf_len_(other.buf_len_) {
+    memcpy(state_, other.state_, sizeof(state_));
+    memcpy(buf_, other.buf_, sizeof(buf_));
+#ifdef ESP32
+    mbedtls_sha256_init(&ctx_);
+    mbedtls_sha256_clone(&ctx_, &other.ctx_);
+#endif
+}
+
+Sha256& Sha256::operator=(const Sha256& other) {
+    if (this == &other) return *this;
+    backend_ = other.backend_;
+    total_ = other.total_;
+    buf_len_ = other.buf_len_;
+    memcpy(state_, other.state_, sizeof(state_));
+    memcpy(buf_, other.buf_, sizeof(buf_));
+#ifdef ESP32
+    mbedtls_sha256_free(&ctx_);
+    mbedtls_sha256_init(&ctx_);
+    mbedtls_sha256_clone(&ctx_, &other.ctx_);
+#endif
+    return *this;
+}
+
+Sha256::~Sha256() {
+#ifdef ESP32
+    mbedtls_sha256_free(&ctx_);   // releases the accelerator if this context holds it
+#endif
+}
+
+void Sha256::reset() {
+#ifdef ESP32
+    if (backend_ == Sha256Backend::ESP32_HW) {
+        SHA256_STARTS(&ctx_, 0);
+        return;
+    }
+#endif
+    memcpy(state_, H256, sizeof(state_));
+    total_ = 0;
+    buf_len_ = 0;
+}
+
+void Sha256::update(const uint8_t* data, size_t len) {
+#ifdef ESP32
+    if (backend_ == Sha256Backend::ESP32_HW) {
+        SHA256_UPDATE(&ctx_, data, len);
+        return;
+    }
+#endif
+    if (len == 0) return;
+    CompressFn compress = compressFor(backend_);
+    total_ += len;
+    if (buf_len_) {
+        size_t take = std::min(len, SHA256_BLOCK_SIZE - buf_len_);
+        memcpy(buf_ + buf_len_, data, take);
+        buf_len_ += take;
+        data += take;
+        len -= take;
+        if (buf_len_ < SHA256_BLOCK_SIZE) return;
+        compress(state_, buf_, 1);
+        buf_len_ = 0;
+    }
+    // Whole blocks straight from the caller's buffer
+    size_t blocks = len / SHA256_BLOCK_SIZE;
+    if (blocks) {
+        compress(state_, data, blocks);
+        data += blocks * SHA256_BLOCK_SIZE;
+        len -= blocks * SHA256_BLOCK_SIZE;
+    }
+    if (len) {
+        memcpy(buf_, data, len);
+        buf_len_ = len;
+    }
+}
+
+void Sha256::finish(uint8_t digest[SHA256_DIGEST_SIZE]) {
+#ifdef ESP32
+    if (backend_ == Sha256Backend::ESP32_HW) {
+        SHA256_FINISH(&ctx_, digest);
+        return;
+    }
+#endif
+    CompressFn compress = compressFor(backend_);
+    uint64_t bits = total_ * 8;
+    buf_[buf_len_++] = 0x80;
+    if (buf_len_ > SHA256_BLOCK_SIZE - 8) {
+        memset(buf_ + buf_len_, 0, SHA256_BLOCK_SIZE - buf_len_);
+        compress(state_, buf_, 1);
+        buf_len_ = 0;
+    }
+    memset(buf_ + buf_len_, 0, SHA256_BLOCK_SIZE - 8 - buf_len_);
+    for (int i = 0; i < 8; ++i) buf_[SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(bits >> (8 * i));
+    compress(state_, buf_, 1);
+    buf_len_ = 0;
+    for (int i = 0; i < 8; ++i) storeBE32(digest + 4 * i, state_[i]);
+}
+
+void Sha256::hash(const uint8_t* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE], Sha256Backend backend) {
+    Sha256 h(backend);
+    h.update(data, len);
+    h.finish(digest);
+}
+
+// ---------- HMAC ----------
+
+HmacSha256::HmacSha256(const uint8_t* key, size_t key_len, Sha256Backend backend)
+    : inner_(backend), outer_(backend), work_(backend) {
+    uint8_t k[SHA256_BLOCK_SIZE] = {0};
+    if (key_len > SHA256_BLOCK_SIZE) {
+        Sha256::hash(key, key_len, k, backend);
+    } else if (key_len) {
+        memcpy(k, key, key_len);
+    }
+    for (size_t i = 0; i < SHA256_BLOCK_SIZE; ++i) {
+        ipad_[i] = k[i] ^ 0x36;
+        opad_[i] = k[i] ^ 0x5c;
+    }
+    // The accelerator cannot resume from an exported midstate, and a context parked
+    // mid-hash would keep the engine locked, so the device replays the pad block instead
+    cached_ = inner_.backend() != Sha256Backend::ESP32_HW;
+    if (cached_) {
+        inner_.update(ipad_, SHA256_BLOCK_SIZE);
+        outer_.update(opad_, SHA256_BLOCK_SIZE);
+    }
+}
+
+void HmacSha256::begin() {
+    if (cached_) {
+        work_ = inner_;
+    } else {
+        work_.reset();
+        work_.update(ipad_, SHA256_BLOCK_SIZE);
+    }
+}
+
+void HmacSha256::update(const uint8_t* data, size_t len) {
+    work_.update(data, len);
+}
+
+void HmacSha256::finish(uint8_t mac[SHA256_DIGEST_SIZE]) {
+    uint8_t inner_digest[SHA256_DIGEST_SIZE];
+    work_.finish(inner_digest);
+    if (cached_) {
+        work_ = outer_;
+    } else {
+        work_.reset();
+        work_.update(opad_, SHA256_BLOCK_SIZE);
+    }
+    work_.update(inner_digest, SHA256_DIGEST_SIZE);
+    work_.finish(mac);
+}
+
+void HmacSha256::compute(const uint8_t* data, size_t len, uint8_t mac[SHA256_DIGEST_SIZE]) {
+    begin();
+    update(data, len);
+    finish(mac);
+}
+
+bool HmacSha256::verifyHex(const uint8_t* data, size_t len, const char* mac_hex) {
+    if (!mac_hex || strlen(mac_hex) != 2 * SHA256_DIGEST_SIZE) return false;
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    compute(data, len, mac);
+    static const char kHex[] = "0123456789abcdef";
+    auto lower = [](char c) { return (c >= 'A' && c <= 'F') ? (char)(c | 0x20) : c; };
+    uint8_t diff = 0;
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; ++i) {
+        diff |= (uint8_t)(kHex[mac[i] >> 4] ^ lower(mac_hex[2 * i]));
+        diff |= (uint8_t)(kHex[mac[i] & 0x0F] ^ lower(mac_hex[2 * i + 1]));
+    }
+    return diff == 0;
+}
+
+// ---------- Multi-message ----------
+
+void sha256Multi(const uint8_t* const* data, const size_t* len, size_t count,
+                 uint8_t (*digests)[SHA256_DIGEST_SIZE], Sha256Backend backend) {
+#ifdef SHA256_X86
+    if (backend == Sha256Backend::AVX2_MB && cpuHasAvx2() && count > 1) {
+        // Similar lengths share a pass, so sort by size and take eight at a time
+        std::vector<size_t> order(count);
+        for (size_t i = 0; i < count; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [len](size_t a, size_t b) { return len[a] < len[b]; });
+
+        LaneJob jobs[LANES];
+        for (size_t base = 0; base < count; base += LANES) {
+            int used = (int)std::min<size_t>(LANES, count - base);
+            for (int l = 0; l < used; ++l) {
+                size_t idx = order[base + l];
+                LaneJob& j = jobs[l];
+                size_t n = len[idx];
+                j.data = data[idx];
+                j.digest = digests[idx];
+                j.full_blocks = n / SHA256_BLOCK_SIZE;
+                size_t rem = n % SHA256_BLOCK_SIZE;
+                size_t tail_blocks = rem + 9 > SHA256_BLOCK_SIZE ? 2 : 1;
+                j.blocks = j.full_blocks + tail_blocks;
+                memset(j.tail, 0, sizeof(j.tail));
+                if (rem) memcpy(j.tail, j.data + j.full_blocks * SHA256_BLOCK_SIZE, rem);
+                j.tail[rem] = 0x80;
+                uint64_t bits = (uint64_t)n * 8;
+                uint8_t* end = j.tail + tail_blocks * SHA256_BLOCK_SIZE;
+                for (int i = 0; i < 8; ++i) end[-1 - i] = (uint8_t)(bits >> (8 * i));
+            }
+            compressAvx2x8(jobs, used);
+        }
+        return;
+    }
+#endif
+    Sha256Backend single = backend == Sha256Backend::AVX2_MB ? Sha256Backend::PORTABLE : backend;
+    Sha256 h(single);
+    for (size_t i = 0; i < count; ++i) {
+        h.reset();
+        h.update(data[i], len[i]);
+        h.finish(digests[i]);
+    }
+}
+
+// ---------- Benchmark ----------
+
+double sha256BenchmarkMBps(Sha256Backend backend, size_t buffer_bytes, uint32_t iterations,
+                           uint64_t (*now_us)()) {
+    if (!now_us || buffer_bytes == 0 || iterations == 0) return 0.0;
+    std::vector<uint8_t> buf(buffer_bytes);
+    for (size_t i = 0; i < buffer_bytes; ++i) buf[i] = (uint8_t)(i * 31 + 7);
+    uint8_t digest[8][SHA256_DIGEST_SIZE];
+
+    // The multi-buffer backend splits the buffer into eight equal messages
+    const size_t part = buffer_bytes / 8;
+    const uint8_t* parts[8];
+    size_t lens[8];
+    for (int i = 0; i < 8; ++i) {
+        parts[i] = buf.data() + i * part;
+        lens[i] = part;
+    }
+
+    uint64_t start = now_us();
+    for (uint32_t it = 0; it < iterations; ++it) {
+        if (backend == Sha256Backend::AVX2_MB) {
+            sha256Multi(parts, lens, 8, digest, backend);
+        } else {
+            Sha256::hash(buf.data(), buf.size(), digest[0], backend);
+        }
+        buf[it % buffer_bytes] ^= digest[0][0];   // keep the work observable
+    }
+    uint64_t elapsed = now_us() - start;
+    if (elapsed == 0) elapsed = 1;
+    double bytes = backend == Sha256Backend::AVX2_MB ? (double)part * 8 : (double)buffer_bytes;
+    return bytes * iterations / (double)elapsed;   // bytes per microsecond == MB/s
+}
@@ -0,0 +1,258 @@
+#include "../include/stall_detector.hpp"
+#include <cstdio>
+#include <cstring>
+
+#ifdef ESP32
+#include <Arduino.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <mutex>
+#include <thread>
+#endif
+
+static constexpr uint32_t STALL_MAGIC = 0x5354414C;   // "STAL"
+
+#ifdef ESP32
+// Survives panic and watchdog resets (not power loss); validated by begin()
+RTC_NOINIT_ATTR static StallArea s_area;
+// The monitor runs in the esp_timer task, possibly on the other core
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t s_watched = nullptr;
+static esp_timer_handle_t s_timer = nullptr;
+
+struct StallLock {
+    StallLock() { portENTER_CRITICAL(&s_mux); }
+    ~StallLock() { portEXIT_CRITICAL(&s_mux); }
+};
+
+static bool onWatchedTask() { return xTaskGetCurrentTaskHandle() == s_watched; }
+#else
+static StallArea s_area;
+static std::mutex s_mutex;
+static std::thread::id s_watched;
+
+struct StallLock {
+    StallLock() { s_mutex.lock(); }
+    ~StallLock() { s_mutex.unlock(); }
+};
+
+static bool onWatchedTask() { return std::this_thread::get_id() == s_watched; }
+#endif
+
+uint32_t stallClockMs() {
+#ifdef ESP32
+    return millis();
+#else
+    using namespace std::chrono;
+    return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+const char* resetReasonToString(uint8_t reason) {
+    // esp_reset_reason_t
+    switch (reason) {
+        case 1: return "power_on";
+        case 2: return "external";
+        case 3: return "software";
+        case 4: return "panic";
+        case 5: return "int_wdt";
+        case 6: return "task_wdt";
+        case 7: return "wdt";
+        case 8: return "deep_sleep";
+        case 9: return "brownout";
+        case 10: return "sdio";
+        default: return "unknown";
+    }
+}
+
+StallArea* StallDetector::area_ = nullptr;
+uint32_t StallDetector::threshold_ms_ = DEFAULT_THRESHOLD_MS;
+StallDetector::Region StallDetector::stack_[StallDetector::MAX_DEPTH];
+size_t StallDetector::depth_ = 0;
+int StallDetector::open_slot_ = -1;
+uint32_t StallDetector::counts_[(size_t)CpuSubsystem::COUNT];
+uint32_t StallDetector::max_ms_[(size_t)CpuSubsystem::COUNT];
+
+size_t StallDetector::begin(uint32_t threshold_ms, StallArea* area) {
+    size_t closed = begin_(threshold_ms, area ? area : &s_area);
+#ifdef ESP32
+    // Not under the lock: esp_timer_create may block
+    if (!s_timer) {
+        esp_timer_create_args_t args = {};
+        args.callback = [](void*) { StallDetector::sample(); };
+        args.name = "stall_mon";
+        if (esp_timer_create(&args, &s_timer) == ESP_OK) {
+            esp_timer_start_periodic(s_timer, (uint64_t)SAMPLE_PERIOD_MS * 1000);
+        }
+    }
+#endif
+    return closed;
+}
+
+size_t StallDetector::begin_(uint32_t threshold_ms, StallArea* area) {
+    StallLock lock;
+    area_ = area;
+    threshold_ms_ = threshold_ms ? threshold_ms : 1;
+    if (area_->magic != STALL_MAGIC || area_->head >= StallArea::RECORDS || area_->count > StallArea::RECORDS) {
+        memset(area_, 0, sizeof(*area_));
+        area_->magic = STALL_MAGIC;
+    }
+
+    uint8_t reason = 0;
+#ifdef ESP32
+    reason = (uint8_t)esp_reset_reason();
+#endif
+    size_t closed = 0;
+    for (size_t i = 0; i < StallArea::RECORDS; ++i) {
+        StallRecord& r = area_->records[i];
+        if (!(r.flags & StallRecord::OPEN)) continue;
+        r.flags = (uint8_t)((r.flags & ~StallRecord::OPEN) | StallRecord::RESET);
+        r.reset_reason = reason;
+        closed++;
+    }
+    area_->boot++;
+
+    depth_ = 0;
+    open_slot_ = -1;
+    memset(counts_, 0, sizeof(counts_));
+    memset(max_ms_, 0, sizeof(max_ms_));
+#ifdef ESP32
+    s_watched = xTaskGetCurrentTaskHandle();
+#else
+    s_watched = std::this_thread::get_id();
+#endif
+    return closed;
+}
+
+void StallDetector::openRecord(uint8_t s, const char* op, uint32_t start_ms, uint32_t duration_ms, uint8_t flags) {
+    uint8_t slot = area_->head;
+    StallRecord& r = area_->records[slot];
+    r.boot = area_->boot;
+    r.start_ms = start_ms;
+    r.duration_ms = duration_ms;
+    r.subsystem = s;
+    r.flags = flags;
+    r.reset_reason = 0;
+    r.reserved = 0;
+    strncpy(r.op, op ? op : "", sizeof(r.op) - 1);
+    r.op[sizeof(r.op) - 1] = '\0';
+    area_->head = (uint8_t)((slot + 1) % StallArea::RECORDS);
+    if (area_->count < StallArea::RECORDS) area_->count++;
+    area_->total++;
+    if (s < (uint8_t)CpuSubsystem::COUNT) {
+        counts_[s]++;
+        if (duration_ms > max_ms_[s]) max_ms_[s] = duration_ms;
+    }
+    open_slot_ = (flags & StallRecord::OPEN) ? slot : -1;
+}
+
+void StallDetector::closeRecord(uint32_t duration_ms) {
+    if (open_slot_ < 0) return;
+    StallRecord& r = area_->records[open_slot_];
+    r.duration_ms = duration_ms;
+    r.flags &= (uint8_t)~StallRecord::OPEN;
+    if (r.subsystem < (uint8_t)CpuSubsystem::COUNT && duration_ms > max_ms_[r.subsystem]) {
+        max_ms_[r.subsystem] = duration_ms;
+    }
+    open_slot_ = -1;
+}
+
+void StallDetector::enter(CpuSubsystem s, const char* op) {
+    if (!area_ || !onWatchedTask()) return;
+    StallLock lock;
+    uint32_t now = stallClockMs();
+    if (depth_ < MAX_DEPTH) {
+        // The outer region's record (if any) ends where the inner one starts
+        if (depth_ > 0) closeRecord(now - stack_[depth_ - 1].start_ms);
+        stack_[depth_] = Region{(uint8_t)s, op, now};
+    }
+    depth_++;
+}
+
+void StallDetector::exit() {
+    if (!area_ || !onWatchedTask() || depth_ == 0) return;
+    StallLock lock;
+    if (depth_ > MAX_DEPTH) {
+        depth_--;
+        return;
+    }
+    uint32_t now = stallClockMs();
+    Region& r = stack_[depth_ - 1];
+    uint32_t elapsed = now - r.start_ms;
+    if (open_slot_ >= 0) {
+        closeRecord(elapsed);
+    } else if (elapsed >= threshold_ms_) {
+        // Over the threshold between two samples (or no monitor running)
+        openRecord(r.subsystem, r.op, r.start_ms, elapsed, 0);
+    }
+    depth_--;
+    if (depth_ > 0) stack_[depth_ - 1].start_ms = now;
+}
+
+void StallDetector::sample() {
+    if (!area_) return;
+    StallLock lock;
+    if (depth_ == 0) return;
+    const Region& r = stack_[(depth_ < MAX_DEPTH ? depth_ : MAX_DEPTH) - 1];
+    uint32_t elapsed = stallClockMs() - r.start_ms;
+    if (elapsed < threshold_ms_) return;
+    if (open_slot_ < 0) {
+        openRecord(r.subsystem, r.op, r.start_ms, elapsed, StallRecord::OPEN);
+    } else {
+        area_->records[open_slot_].duration_ms = elapsed;
+    }
+}
+
+uint32_t StallDetector::boot() {
+    return area_ ? area_->boot : 0;
+}
+
+uint32_t StallDetector::total() {
+    return area_ ? area_->total : 0;
+}
+
+uint32_t StallDetector::count(CpuSubsystem s) {
+    return s < CpuSubsystem::COUNT ? counts_[(size_t)s] : 0;
+}
+
+uint32_t StallDetector::maxMs(CpuSubsystem s) {
+    return s < CpuSubsystem::COUNT ? max_ms_[(size_t)s] : 0;
+}
+
+bool StallDetector::record(size_t i, StallRecord& out) {
+    if (!area_) return false;
+    StallLock lock;
+    if (i >= area_->count) return false;
+    out = area_->records[(area_->head + StallArea::RECORDS - 1 - i) % StallArea::RECORDS];
+    return true;
+}
+
+std::string StallDetector::json() {
+    std::string json = "{\"threshold_ms\":" + std::to_string(threshold_ms_) + ",\"total\":" +
+                       std::to_string(total()) + ",\"subsystems\":{";
+    bool first = true;
+    for (size_t i = 0; i < (size_t)CpuSubsystem::COUNT; ++i) {
+        if (!counts_[i]) continue;
+        if (!first) json += ",";
+        first = false;
+        json += "\"" + std::string(cpuSubsystemToString((CpuSubsystem)i)) + "\":{\"count\":" +
+                std::to_string(counts_[i]) + ",\"max_ms\":" + std::to_string(max_ms_[i]) + "}";
+    }
+    json += "},\"recent\":[";
+    StallRecord r;
+    for (size_t i = 0; record(i, r); ++i) {
+        char buf[192];
+        snprintf(buf, sizeof(buf),
+                 "%s{\"subsystem\":\"%s\",\"op\":\"%s\",\"ms\":%u,\"boots_ago\":%u,\"open\":%s,\"reset\":",
+                 i ? "," : "", cpuSubsystemToString((CpuSubsystem)r.subsystem), r.op, (unsigned)r.duration_ms,
+                 (unsigned)(boot() - r.boot), (r.flags & StallRecord::OPEN) ? "true" : "false");
+        json += buf;
+        json += (r.flags & StallRecord::RESET) ? "\"" + std::string(resetReasonToString(r.reset_reason)) + "\"}"
+                                               : std::string("null}");
+    }
+    return json + "]}";
+}
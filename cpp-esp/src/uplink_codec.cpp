@@ -0,0 +1,373 @@
+#include "../include/uplink_codec.hpp"
+#include <cmath>
+#include <cstring>
+
+const char* fidelityToString(Fidelity fidelity) {
+    switch (fidelity) {
+        case Fidelity::FULL: return "full";
+        case Fidelity::LOSSY: return "lossy";
+        case Fidelity::AGGREGATE: return "aggregate";
+        case Fidelity::HEARTBEAT: return "heartbeat";
+        default: return "unknown";
+    }
+}
+
+// ---------- Byte helpers (little-endian) ----------
+
+static void putU16(std::vector<uint8_t>& out, uint16_t v) {
+    out.push_back(v & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back((v >> (8 * i)) & 0xFF);
+}
+
+static void putF32(std::vector<uint8_t>& out, float f) {
+    uint32_t v;
+    memcpy(&v, &f, sizeof(v));
+    putU32(out, v);
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+// Reader with bounds checking; every get returns false once the input is exhausted
+struct ByteReader {
+    const uint8_t* p;
+    size_t len;
+    size_t pos = 0;
+
+    bool getU8(uint8_t& v) {
+        if (pos + 1 > len) return false;
+        v = p[pos++];
+        return true;
+    }
+    bool getU16(uint16_t& v) {
+        if (pos + 2 > len) return false;
+        v = (uint16_t)(p[pos] | (p[pos + 1] << 8));
+        pos += 2;
+        return true;
+    }
+    bool getU32(uint32_t& v) {
+        if (pos + 4 > len) return false;
+        v = (uint32_t)p[pos] | ((uint32_t)p[pos + 1] << 8) | ((uint32_t)p[pos + 2] << 16) | ((uint32_t)p[pos + 3] << 24);
+        pos += 4;
+        return true;
+    }
+    bool getF32(float& f) {
+        uint32_t v;
+        if (!getU32(v)) return false;
+        memcpy(&f, &v, sizeof(f));
+        return true;
+    }
+    bool getVarint(uint32_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t b;
+            if (!getU8(b)) return false;
+            v |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+};
+
+static void putHeader(std::vector<uint8_t>& out, UplinkCodec codec, Fidelity fidelity, uint16_t count) {
+    out.push_back('E');
+    out.push_back('W');
+    out.push_back(UPLINK_BATCH_VERSION);
+    out.push_back((uint8_t)codec);
+    out.push_back((uint8_t)fidelity);
+    out.push_back(0);
+    putU16(out, count);
+}
+
+// ---------- SampleAggregate ----------
+
+void SampleAggregate::clear() {
+    memset(slots_, 0, sizeof(slots_));
+    total_ = 0;
+    start_ts_ = 0;
+    end_ts_ = 0;
+}
+
+void SampleAggregate::add(const Sample& s) {
+    if (s.reg_addr >= MAX_REGISTERS) return;
+    Slot& slot = slots_[s.reg_addr];
+    if (slot.n == 0) {
+        slot.min = s.value;
+        slot.max = s.value;
+    } else {
+        if (s.value < slot.min) slot.min = s.value;
+        if (s.value > slot.max) slot.max = s.value;
+    }
+    if (slot.n < 0xFFFF) {
+        slot.n++;
+        slot.sum += s.value;
+    }
+    if (total_ == 0 || s.timestamp < start_ts_) start_ts_ = s.timestamp;
+    if (total_ == 0 || s.timestamp > end_ts_) end_ts_ = s.timestamp;
+    total_++;
+}
+
+size_t SampleAggregate::entries(AggregateEntry* out, size_t max) const {
+    size_t n = 0;
+    for (uint8_t reg = 0; reg < MAX_REGISTERS && n < max; ++reg) {
+        const Slot& slot = slots_[reg];
+        if (slot.n == 0) continue;
+        out[n].reg_addr = reg;
+        out[n].count = (uint16_t)slot.n;
+        out[n].min = slot.min;
+        out[n].max = slot.max;
+        out[n].mean = (float)(slot.sum / slot.n);
+        n++;
+    }
+    return n;
+}
+
+// ---------- Encoders ----------
+
+void encodeRawBatch(const Sample* samples, size_t count, std::vector<uint8_t>& out) {
+    if (count > 0xFFFF) count = 0xFFFF;
+    out.reserve(out.size() + UPLINK_BATCH_HEADER_SIZE + count * UPLINK_RAW_SAMPLE_SIZE);
+    putHeader(out, UplinkCodec::RAW, Fidelity::FULL, (uint16_t)count);
+    for (size_t i = 0; i < count; ++i) {
+        putU32(out, samples[i].timestamp);
+        out.push_back(samples[i].reg_addr);
+        putF32(out, samples[i].value);
+    }
+}
+
+void encodeDeltaQBatch(const Sample* samples, size_t count, float step, std::vector<uint8_t>& out) {
+    if (count > 0xFFFF) count = 0xFFFF;
+    if (step <= 0.0f) step = 1.0f;
+    putHeader(out, UplinkCodec::DELTA_Q, Fidelity::LOSSY, (uint16_t)count);
+    putF32(out, step);
+    uint32_t base_ts = count ? samples[0].timestamp : 0;
+    putU32(out, base_ts);
+
+    int32_t prev_q[SampleAggregate::MAX_REGISTERS] = {0};
+    uint32_t prev_ts = base_ts;
+    for (size_t i = 0; i < count; ++i) {
+        const Sample& s = samples[i];
+        uint8_t slot = s.reg_addr % SampleAggregate::MAX_REGISTERS;
+        int32_t q = (int32_t)lroundf(s.value / step);
+        putVarint(out, zigzag((int32_t)(s.timestamp - prev_ts)));
+        out.push_back(s.reg_addr);
+        putVarint(out, zigzag(q - prev_q[slot]));
+        prev_ts = s.timestamp;
+        prev_q[slot] = q;
+    }
+}
+
+void encodeAggregateBatch(const SampleAggregate& agg, std::vector<uint8_t>& out) {
+    AggregateEntry entries[SampleAggregate::MAX_REGISTERS];
+    size_t n = agg.entries(entries, SampleAggregate::MAX_REGISTERS);
+    putHeader(out, UplinkCodec::AGGREGATE, Fidelity::AGGREGATE, (uint16_t)n);
+    putU32(out, agg.startTs());
+    putU32(out, agg.endTs());
+    for (size_t i = 0; i < n; ++i) {
+        out.push_back(entries[i].reg_addr);
+        putU16(out, entries[i].count);
+        putF32(out, entries[i].min);
+        putF32(out, entries[i].max);
+        putF32(out, entries[i].mean);
+    }
+}
+
+void encodeHeartbeatBatch(uint32_t ts, uint32_t backlog, uint32_t lost, std::vector<uint8_t>& out) {
+    putHeader(out, UplinkCodec::HEARTBEAT, Fidelity::HEARTBEAT, 0);
+    putU32(out, ts);
+    putU32(out, backlog);
+    putU32(out, lost);
+}
+
+// A sample extends the current frame when it shares the timestamp and comes after the
+// frame's highest register; anything else starts a new frame, so decoding gives the
+// input back in its original order
+static size_t frameRun(const Sample* samples, size_t count, uint16_t& present) {
+    present = 0;
+    size_t n = 0;
+    int last_reg = -1;
+    while (n < count && samples[n].timestamp == samples[0].timestamp &&
+           samples[n].reg_addr < UPLINK_FRAME_MAX_REGISTERS && (int)samples[n].reg_addr > last_reg) {
+        last_reg = samples[n].reg_addr;
+        present |= (uint16_t)(1u << last_reg);
+        n++;
+    }
+    return n;
+}
+
+size_t encodeFrameBatch(const Sample* samples, size_t count, size_t max_bytes, std::vector<uint8_t>& out) {
+    size_t start = out.size();
+    if (max_bytes < UPLINK_BATCH_HEADER_SIZE) return 0;
+    putHeader(out, UplinkCodec::FRAME, Fidelity::FULL, 0);
+    size_t used = 0;
+    uint16_t frames = 0;
+    while (used < count && frames < 0xFFFF) {
+        uint16_t present;
+        size_t n = frameRun(samples + used, count - used, present);
+        if (n == 0) break;
+        if (out.size() - start + UPLINK_FRAME_HEADER_SIZE + n * 4 > max_bytes) break;
+        putU32(out, samples[used].timestamp);
+        putU16(out, present);
+        for (size_t i = 0; i < n; ++i) putF32(out, samples[used + i].value);
+        used += n;
+        frames++;
+    }
+    if (frames == 0) {
+        out.resize(start);
+        return 0;
+    }
+    out[start + 6] = frames & 0xFF;
+    out[start + 7] = (frames >> 8) & 0xFF;
+    return used;
+}
+
+// ---------- Decoder ----------
+
+bool decodeBatch(const uint8_t* data, size_t len, DecodedBatch& out, size_t& consumed) {
+    out = DecodedBatch();
+    consumed = 0;
+    if (!data || len < UPLINK_BATCH_HEADER_SIZE || data[0] != 'E' || data[1] != 'W') return false;
+
+    ByteReader r{data, len, 2};
+    uint8_t codec, fidelity;
+    r.getU8(out.header.version);
+    r.getU8(codec);
+    r.getU8(fidelity);
+    r.getU8(out.header.flags);
+    r.getU16(out.header.count);
+    if (out.header.version != UPLINK_BATCH_VERSION) return false;
+    out.header.codec = (UplinkCodec)codec;
+    out.header.fidelity = (Fidelity)fidelity;
+    uint16_t count = out.header.count;
+
+    switch (out.header.codec) {
+        case UplinkCodec::RAW: {
+            out.samples.reserve(count);
+            for (uint16_t i = 0; i < count; ++i) {
+                Sample s;
+                if (!r.getU32(s.timestamp) || !r.getU8(s.reg_addr) || !r.getF32(s.value)) return false;
+                out.samples.push_back(s);
+            }
+            break;
+        }
+        case UplinkCodec::DELTA_Q: {
+            float step;
+            uint32_t ts;
+            if (!r.getF32(step) || !r.getU32(ts)) return false;
+            int32_t prev_q[SampleAggregate::MAX_REGISTERS] = {0};
+            out.samples.reserve(count);
+            for (uint16_t i = 0; i < count; ++i) {
+                uint32_t dts, dq;
+                Sample s;
+                if (!r.getVarint(dts) || !r.getU8(s.reg_addr) || !r.getVarint(dq)) return false;
+                ts += (uint32_t)unzigzag(dts);
+                uint8_t slot = s.reg_addr % SampleAggregate::MAX_REGISTERS;
+                prev_q[slot] += unzigzag(dq);
+                s.timestamp = ts;
+                s.value = prev_q[slot] * step;
+                out.samples.push_back(s);
+            }
+            break;
+        }
+        case UplinkCodec::AGGREGATE: {
+            if (!r.getU32(out.start_ts) || !r.getU32(out.end_ts)) return false;
+            for (uint16_t i = 0; i < count; ++i) {
+                AggregateEntry e;
+                if (!r.getU8(e.reg_addr) || !r.getU16(e.count) || !r.getF32(e.min) ||
+                    !r.getF32(e.max) || !r.getF32(e.mean)) return false;
+                out.aggregates.push_back(e);
+            }
+            break;
+        }
+        case UplinkCodec::FRAME: {
+            out.samples.reserve(count);
+            for (uint16_t i = 0; i < count; ++i) {
+                uint32_t ts;
+                uint16_t present;
+                if (!r.getU32(ts) || !r.getU16(present) || present == 0) return false;
+                for (uint8_t reg = 0; reg < UPLINK_FRAME_MAX_REGISTERS; ++reg) {
+                    if (!(present & (1u << reg))) continue;
+                    Sample s;
+                    s.timestamp = ts;
+                    s.reg_addr = reg;
+                    if (!r.getF32(s.value)) return false;
+                    out.samples.push_back(s);
+                }
+            }
+            break;
+        }
+        case UplinkCodec::HEARTBEAT:
+            if (!r.getU32(out.start_ts) || !r.getU32(out.backlog) || !r.getU32(out.lost)) return false;
+            out.end_ts = out.start_ts;
+            break;
+        default:
+            return false;
+    }
+    consumed = r.pos;
+    return true;
+}
+
+// ---------- DegradationPolicy ----------
+
+DegradationPolicy::DegradationPolicy(const DegradationThresholds& t) : t_(t) {}
+
+Fidelity DegradationPolicy::targetFor(uint32_t backlog) const {
+    if (failures_ >= t_.heartbeat_failures) return Fidelity::HEARTBEAT;
+    if (failures_ >= t_.aggregate_failures || backlog >= t_.aggregate_backlog) return Fidelity::AGGREGATE;
+    if (backlog >= t_.lossy_backlog) return Fidelity::LOSSY;
+    return Fidelity::FULL;
+}
+
+bool DegradationPolicy::canRecoverTo(Fidelity better, uint32_t backlog) const {
+    if (failures_ != 0 || successes_ < t_.recover_successes) return false;
+    switch (better) {
+        case Fidelity::FULL: return backlog < t_.lossy_backlog * t_.exit_ratio;
+        case Fidelity::LOSSY: return backlog < t_.aggregate_backlog * t_.exit_ratio;
+        case Fidelity::AGGREGATE: return true;
+        default: return false;
+    }
+}
+
+Fidelity DegradationPolicy::evaluate(uint32_t backlog) {
+    Fidelity target = targetFor(backlog);
+    if ((uint8_t)target > (uint8_t)level_) {
+        level_ = target;
+        successes_ = 0;
+        transitions_++;
+    } else if (level_ != Fidelity::FULL) {
+        Fidelity better = (Fidelity)((uint8_t)level_ - 1);
+        if (canRecoverTo(better, backlog)) {
+            level_ = better;
+            successes_ = 0;
+            transitions_++;
+        }
+    }
+    return level_;
+}
+
+void DegradationPolicy::onUploadResult(bool success) {
+    if (success) {
+        failures_ = 0;
+        successes_++;
+    } else {
+        failures_++;
+        successes_ = 0;
+    }
+}
@@ -0,0 +1,297 @@
+#include "../include/uplink_fec.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+struct Tables {
+    uint8_t exp[512];
+    uint8_t log[256];
+    Tables() {
+        unsigned x = 1;
+        for (int i = 0; i < 255; ++i) {
+            exp[i] = (uint8_t)x;
+            log[x] = (uint8_t)i;
+            x <<= 1;
+            if (x & 0x100) x ^= 0x11D;   // x^8 + x^4 + x^3 + x^2 + 1
+        }
+        for (int i = 255; i < 512; ++i) exp[i] = exp[i - 255];
+        log[0] = 0;
+    }
+};
+
+const Tables& tables() {
+    static const Tables t;
+    return t;
+}
+}
+
+namespace gf256 {
+uint8_t mul(uint8_t a, uint8_t b) {
+    if (!a || !b) return 0;
+    const Tables& t = tables();
+    return t.exp[t.log[a] + t.log[b]];
+}
+
+uint8_t inv(uint8_t a) {
+    const Tables& t = tables();
+    return t.exp[255 - t.log[a]];
+}
+
+void mulAdd(uint8_t* dst, uint8_t c, const uint8_t* src, size_t len) {
+    if (c == 0) return;
+    const Tables& t = tables();
+    unsigned lc = t.log[c];
+    for (size_t i = 0; i < len; ++i) {
+        if (src[i]) dst[i] ^= t.exp[lc + t.log[src[i]]];
+    }
+}
+}
+
+// Cauchy matrix 1 / (x_row + y_i) with x_row = k + row and y_i = i: every square
+// submatrix of [I; C] is invertible, so any k shards rebuild the group.
+uint8_t ReedSolomon::coefficient(size_t k, size_t row, size_t i) {
+    return gf256::inv((uint8_t)((k + row) ^ i));
+}
+
+void ReedSolomon::encode(const uint8_t* const* data, size_t k, size_t len, size_t row, uint8_t* parity) {
+    memset(parity, 0, len);
+    for (size_t i = 0; i < k; ++i) gf256::mulAdd(parity, coefficient(k, row, i), data[i], len);
+}
+
+bool ReedSolomon::reconstruct(uint8_t* const* shards, const bool* present, size_t k, size_t total, size_t len) {
+    if (k == 0 || total > MAX_SHARDS) return false;
+    // Rows of the generator matrix for the first k shards received
+    std::vector<size_t> used;
+    for (size_t s = 0; s < total && used.size() < k; ++s) {
+        if (present[s]) used.push_back(s);
+    }
+    if (used.size() < k) return false;
+    bool missing = false;
+    for (size_t i = 0; i < k; ++i) missing |= !present[i];
+    if (!missing) return true;
+
+    std::vector<uint8_t> m(k * k, 0), inv(k * k, 0);
+    for (size_t r = 0; r < k; ++r) {
+        for (size_t c = 0; c < k; ++c) {
+            m[r * k + c] = used[r] < k ? (used[r] == c) : coefficient(k, used[r] - k, c);
+        }
+        inv[r * k + r] = 1;
+    }
+    // Gauss-Jordan
+    for (size_t c = 0; c < k; ++c) {
+        size_t p = c;
+        while (p < k && m[p * k + c] == 0) ++p;
+        if (p == k) return false;
+        if (p != c) {
+            for (size_t j = 0; j < k; ++j) {
+                std::swap(m[p * k + j], m[c * k + j]);
+                std::swap(inv[p * k + j], inv[c * k + j]);
+            }
+        }
+        uint8_t f = gf256::inv(m[c * k + c]);
+        for (size_t j = 0; j < k; ++j) {
+            m[c * k + j] = gf256::mul(m[c * k + j], f);
+            inv[c * k + j] = gf256::mul(inv[c * k + j], f);
+        }
+        for (size_t r = 0; r < k; ++r) {
+            uint8_t e = m[r * k + c];
+            if (r == c || e == 0) continue;
+            gf256::mulAdd(&m[r * k], e, &m[c * k], k);
+            gf256::mulAdd(&inv[r * k], e, &inv[c * k], k);
+        }
+    }
+    for (size_t i = 0; i < k; ++i) {
+        if (present[i]) continue;
+        memset(shards[i], 0, len);
+        for (size_t r = 0; r < k; ++r) gf256::mulAdd(shards[i], inv[i * k + r], shards[used[r]], len);
+    }
+    return true;
+}
+
+void FecShardHeader::write(uint8_t* out) const {
+    out[0] = 'F';
+    out[1] = 'C';
+    out[2] = VERSION;
+    out[3] = k;
+    out[4] = index;
+    out[5] = 0;
+    out[6] = shard_len & 0xFF;
+    out[7] = shard_len >> 8;
+    for (int i = 0; i < 4; ++i) out[8 + i] = (group >> (8 * i)) & 0xFF;
+}
+
+bool FecShardHeader::parse(const uint8_t* data, size_t len, FecShardHeader& out) {
+    if (len < SIZE || data[0] != 'F' || data[1] != 'C' || data[2] != VERSION) return false;
+    out.k = data[3];
+    out.index = data[4];
+    out.shard_len = (uint16_t)(data[6] | (data[7] << 8));
+    out.group = (uint32_t)data[8] | ((uint32_t)data[9] << 8) | ((uint32_t)data[10] << 16) | ((uint32_t)data[11] << 24);
+    return out.k > 0 && out.shard_len >= UplinkFec::LEN_SIZE;
+}
+
+UplinkFec::UplinkFec(const FecConfig& config, uint32_t first_group) : config_(config), next_group_(first_group) {}
+
+void UplinkFec::onSend(bool answered) {
+    int64_t target = answered ? 0 : 1000000;
+    loss_ppm_ = (uint32_t)((int64_t)loss_ppm_ + (target - (int64_t)loss_ppm_) / 16);
+    if (!answered) stats_.unanswered++;
+}
+
+// Smallest budget r with P[more than r of the k + r shards lost] under the target
+uint8_t UplinkFec::parityFor(size_t k) const {
+    double p = loss_ppm_ / 1e6;
+    double target = config_.target_permille / 1000.0;
+    uint8_t r = config_.min_parity;
+    for (; r < config_.max_parity; ++r) {
+        size_t n = k + r;
+        double term = pow(1 - p, (double)n);   // P[X = 0]
+        double cdf = term;
+        for (size_t x = 1; x <= r; ++x) {
+            term *= (double)(n - x + 1) / x * p / (1 - p);
+            cdf += term;
+        }
+        if (1 - cdf <= target) break;
+    }
+    return r;
+}
+
+bool UplinkFec::sendGroup(const uint8_t* const* chunks, const size_t* lens, size_t k, const SendFn& send) {
+    if (k == 0 || k > MAX_GROUP) return false;
+    for (size_t i = 0; i < k; ++i) {
+        if (lens[i] + LEN_SIZE > 0xFFFF) return false;
+    }
+    uint32_t group = next_group_++;
+    stats_.groups++;
+    uint8_t next_row = 0;
+    if (sendShards(group, chunks, lens, k, 0, &next_row, send)) return true;
+
+    size_t total = 0;
+    for (size_t i = 0; i < k; ++i) total += lens[i];
+    held_data_.resize(total);
+    size_t at = 0;
+    for (size_t i = 0; i < k; ++i) {
+        memcpy(held_data_.data() + at, chunks[i], lens[i]);
+        held_lens_[i] = lens[i];
+        at += lens[i];
+    }
+    held_group_ = group;
+    held_k_ = (uint8_t)k;
+    held_row_ = next_row;
+    return false;
+}
+
+bool UplinkFec::resendHeld(const SendFn& send) {
+    if (!held()) return false;
+    const uint8_t* chunks[MAX_GROUP];
+    size_t at = 0;
+    for (size_t i = 0; i < held_k_; ++i) {
+        chunks[i] = held_data_.data() + at;
+        at += held_lens_[i];
+    }
+    stats_.groups_resent++;
+    if (!sendShards(held_group_, chunks, held_lens_, held_k_, held_row_, &held_row_, send)) return false;
+    dropHeld();
+    return true;
+}
+
+void UplinkFec::dropHeld() {
+    held_k_ = 0;
+    held_row_ = 0;
+    held_data_.clear();
+    held_data_.shrink_to_fit();
+}
+
+bool UplinkFec::sendShards(uint32_t group, const uint8_t* const* chunks, const size_t* lens, size_t k,
+                           uint8_t first_row, uint8_t* next_row, const SendFn& send) {
+    FecShardHeader h;
+    h.group = group;
+    h.k = (uint8_t)k;
+    size_t shard_len = 0;
+    for (size_t i = 0; i < k; ++i) {
+        if (lens[i] + LEN_SIZE > shard_len) shard_len = lens[i] + LEN_SIZE;
+    }
+    h.shard_len = (uint16_t)shard_len;
+
+    // Shards acknowledged; k of them are a complete group even if no reply said so
+    // (the server counts a shard once, and each index goes out once per call)
+    size_t answered = 0;
+    uint8_t head[FecShardHeader::SIZE + LEN_SIZE];
+    bool stop = false;
+    auto attempt = [&](size_t head_len, const uint8_t* body, size_t body_len) {
+        FecReply reply = send(head, head_len, body, body_len);
+        onSend(reply.answered);
+        if (reply.answered) answered++;
+        stop = reply.stop;
+        return reply.complete || answered >= k;
+    };
+
+    for (size_t i = 0; i < k && !stop; ++i) {
+        h.index = (uint8_t)i;
+        h.write(head);
+        head[FecShardHeader::SIZE] = lens[i] & 0xFF;
+        head[FecShardHeader::SIZE + 1] = (uint8_t)(lens[i] >> 8);
+        stats_.data_sent++;
+        if (attempt(sizeof(head), chunks[i], lens[i])) return true;
+    }
+
+    // Parity rows are computed only when the data shards left the group incomplete
+    size_t end_row = (size_t)first_row + parityFor(k);
+    if (end_row > ReedSolomon::MAX_SHARDS - k) end_row = ReedSolomon::MAX_SHARDS - k;
+    parity_.resize(shard_len);
+    size_t row = first_row;
+    for (; row < end_row && !stop; ++row) {
+        memset(parity_.data(), 0, shard_len);
+        for (size_t i = 0; i < k; ++i) {
+            uint8_t c = ReedSolomon::coefficient(k, row, i);
+            const uint8_t len_bytes[LEN_SIZE] = {(uint8_t)(lens[i] & 0xFF), (uint8_t)(lens[i] >> 8)};
+            gf256::mulAdd(parity_.data(), c, len_bytes, LEN_SIZE);
+            gf256::mulAdd(parity_.data() + LEN_SIZE, c, chunks[i], lens[i]);
+        }
+        h.index = (uint8_t)(k + row);
+        h.write(head);
+        stats_.parity_sent++;
+        if (attempt(FecShardHeader::SIZE, parity_.data(), shard_len)) return true;
+    }
+    *next_row = (uint8_t)row;
+    stats_.groups_failed++;
+    return false;
+}
+
+bool UplinkFec::parseReply(const std::string& body, uint32_t group, FecReply& out) {
+    size_t pos = body.find("\"fec\"");
+    if (pos == std::string::npos) return false;
+    size_t end = body.find('}', pos);
+    if (end == std::string::npos) return false;
+    std::string obj = body.substr(pos, end - pos);
+    auto number = [&](const char* key, unsigned long& v) {
+        size_t at = obj.find(key);
+        if (at == std::string::npos) return false;
+        at += strlen(key);
+        while (at < obj.size() && (obj[at] == ' ' || obj[at] == ':')) ++at;
+        if (at >= obj.size() || obj[at] < '0' || obj[at] > '9') return false;
+        v = strtoul(obj.c_str() + at, nullptr, 10);
+        return true;
+    };
+    unsigned long g = 0, have = 0;
+    if (!number("\"group\"", g) || g != group) return false;
+    if (number("\"have\"", have)) out.have = (uint8_t)(have > 255 ? 255 : have);
+    size_t at = obj.find("\"complete\"");
+    if (at != std::string::npos) {
+        at += 10;
+        while (at < obj.size() && (obj[at] == ' ' || obj[at] == ':')) ++at;
+        out.complete = obj.compare(at, 4, "true") == 0;
+    }
+    return true;
+}
+
+std::string UplinkFec::json() const {
+    char buf[160];
+    snprintf(buf, sizeof(buf),
+             "{\"loss_permille\":%u,\"groups\":%u,\"failed\":%u,\"resent\":%u,\"data\":%u,\"parity\":%u,"
+             "\"unanswered\":%u}",
+             (unsigned)lossPermille(), (unsigned)stats_.groups, (unsigned)stats_.groups_failed,
+             (unsigned)stats_.groups_resent, (unsigned)stats_.data_sent, (unsigned)stats_.parity_sent, (unsigned)stats_.unanswered);
+    return std::string(buf);
+}
@@ -0,0 +1,131 @@
+#include "../include/uplink_lanes.hpp"
+#include <cstdio>
+
+const char* uplinkLaneToString(UplinkLane lane) {
+    switch (lane) {
+        case UplinkLane::URGENT: return "urgent";
+        case UplinkLane::EVENT: return "event";
+        case UplinkLane::BULK: return "bulk";
+        case UplinkLane::BACKGROUND: return "background";
+        default: return "unknown";
+    }
+}
+
+UplinkLanes::UplinkLanes(size_t urgent_capacity, size_t event_capacity, size_t background_capacity) {
+    capacity_[(size_t)UplinkLane::URGENT] = urgent_capacity;
+    capacity_[(size_t)UplinkLane::EVENT] = event_capacity;
+    capacity_[(size_t)UplinkLane::BULK] = 0;
+    capacity_[(size_t)UplinkLane::BACKGROUND] = background_capacity;
+}
+
+bool UplinkLanes::enqueue(UplinkLane lane, const std::string& endpoint, const std::string& body, uint32_t now_ms) {
+    size_t idx = (size_t)lane;
+    if (idx >= UPLINK_LANE_COUNT || capacity_[idx] == 0) return false;
+
+    std::deque<UplinkItem>& q = queues_[idx];
+    if (q.size() >= capacity_[idx]) {
+        q.pop_front();
+        stats_[idx].dropped++;
+    }
+
+    UplinkItem item;
+    item.lane = lane;
+    item.endpoint = endpoint;
+    item.body = body;
+    item.enqueued_ms = now_ms;
+    q.push_back(item);
+    stats_[idx].enqueued++;
+    return true;
+}
+
+bool UplinkLanes::popFrom(UplinkLane lane, UplinkItem& out) {
+    std::deque<UplinkItem>& q = queues_[(size_t)lane];
+    if (q.empty()) return false;
+    out = q.front();
+    q.pop_front();
+    return true;
+}
+
+bool UplinkLanes::pop(UplinkItem& out, UplinkLane lowest_lane) {
+    if (popFrom(UplinkLane::URGENT, out)) return true;
+    if (lowest_lane == UplinkLane::URGENT) return false;
+
+    bool allow_background = lowest_lane == UplinkLane::BACKGROUND || lowest_lane == UplinkLane::BULK;
+    bool background_due = events_since_background_ >= background_weight_;
+
+    if (allow_background && background_due && popFrom(UplinkLane::BACKGROUND, out)) {
+        events_since_background_ = 0;
+        return true;
+    }
+    if (popFrom(UplinkLane::EVENT, out)) {
+        if (events_since_background_ < 255) events_since_background_++;
+        return true;
+    }
+    if (allow_background && popFrom(UplinkLane::BACKGROUND, out)) {
+        events_since_background_ = 0;
+        return true;
+    }
+    return false;
+}
+
+void UplinkLanes::requeue(const UplinkItem& item) {
+    size_t idx = (size_t)item.lane;
+    if (idx >= UPLINK_LANE_COUNT) return;
+
+    UplinkItem retry = item;
+    retry.attempts++;
+    if (retry.attempts >= max_attempts_ || queues_[idx].size() >= capacity_[idx]) {
+        stats_[idx].dropped++;
+        return;
+    }
+    queues_[idx].push_front(retry);
+    stats_[idx].requeued++;
+}
+
+void UplinkLanes::recordDelay(UplinkLane lane, uint32_t delay_ms) {
+    UplinkLaneStats& s = stats_[(size_t)lane];
+    s.sent++;
+    s.last_delay_ms = delay_ms;
+    s.total_delay_ms += delay_ms;
+    if (delay_ms > s.max_delay_ms) s.max_delay_ms = delay_ms;
+}
+
+void UplinkLanes::recordSent(const UplinkItem& item, uint32_t now_ms) {
+    recordDelay(item.lane, now_ms - item.enqueued_ms);
+}
+
+void UplinkLanes::recordBulk(uint32_t delay_ms) {
+    recordDelay(UplinkLane::BULK, delay_ms);
+}
+
+bool UplinkLanes::hasPending(UplinkLane lane) const {
+    return !queues_[(size_t)lane].empty();
+}
+
+size_t UplinkLanes::pending(UplinkLane lane) const {
+    return queues_[(size_t)lane].size();
+}
+
+size_t UplinkLanes::pendingBytes(UplinkLane lane) const {
+    size_t total = 0;
+    for (const UplinkItem& item : queues_[(size_t)lane]) total += item.body.size();
+    return total;
+}
+
+std::string UplinkLanes::statsJson() const {
+    std::string json = "{";
+    for (size_t i = 0; i < UPLINK_LANE_COUNT; ++i) {
+        const UplinkLaneStats& s = stats_[i];
+        char buf[192];
+        snprintf(buf, sizeof(buf),
+                 "%s\"%s\":{\"sent\":%lu,\"dropped\":%lu,\"requeued\":%lu,\"avg_delay_ms\":%lu,"
+                 "\"max_delay_ms\":%lu,\"pending\":%u}",
+                 i ? "," : "", uplinkLaneToString((UplinkLane)i),
+                 (unsigned long)s.sent, (unsigned long)s.dropped, (unsigned long)s.requeued,
+                 (unsigned long)s.avgDelayMs(), (unsigned long)s.max_delay_ms,
+                 (unsigned)queues_[i].size());
+        json += buf;
+    }
+    json += "}";
+    return json;
+}
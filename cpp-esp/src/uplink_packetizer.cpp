@@ -15,19 +15,7 @@
 #include "../include/ticker_fallback.hpp"
 #include "../include/uplink_packetizer.hpp"
 #include "../include/logger.hpp"
-
-// ---------- File-local helpers ----------
-
-static std::string bufToHex(const char* buf, size_t len) {
-    static const char HEX_DIGITS[] = "0123456789ABCDEF";
-    std::string out;
-    for (size_t i = 0; i < len; ++i) {
-        const unsigned char b = static_cast<unsigned char>(buf[i]);
-        out.push_back(HEX_DIGITS[(b >> 4) & 0x0F]);
-        out.push_back(HEX_DIGITS[b & 0x0F]);
-    }
-    return out;
-}
+#include "../include/stall_detector.hpp"
 
 // Prefer pdMS_TO_TICKS(ms) for sleeps; don't redefine portTICK_PERIOD_MS.
 
@@ -40,6 +28,18 @@ UplinkPacketizer::UplinkPacketizer(DataStorage* storage, SecureHttpClient* secur
       storage_(storage),
       secure_http_(secure_http) {
     instance_ = this;
+    FecConfig off;
+    off.group = 0;
+    fec_.setConfig(off);
+}
+
+void UplinkPacketizer::setFec(const FecConfig& config) {
+    // Random first group so a rebooted device does not reuse ids the server still holds
+    fec_ = UplinkFec(config, esp_random());
+    if (config.group) {
+        Logger::info("[Uplink] FEC on: groups of %u chunks, %u-%u parity", (unsigned)config.group,
+                     (unsigned)config.min_parity, (unsigned)config.max_parity);
+    }
 }
 
 UplinkPacketizer::~UplinkPacketizer() {
@@ -47,10 +47,40 @@ UplinkPacketizer::~UplinkPacketizer() {
 }
 
 void UplinkPacketizer::begin(uint32_t interval_ms) {
-    uploadInterval_ = interval_ms;
-    uploadTicker_.interval(uploadInterval_);
+    FlushTargets targets = trigger_.targets();
+    targets.max_age_ms = interval_ms;
+    trigger_.setTargets(targets);
+    uploadTicker_.interval(TRIGGER_CHECK_MS);
     running_ = true;
+    // Spread a fleet that boots together across the whole age bound; the check ticker
+    // itself runs every second on every device
+    uint32_t phase = fleetPhaseOffsetMs(deviceId_, trigger_.targets().max_age_ms);
+    trigger_.setPhase(phase);
+    flow_.setJitterSeed(fnv1a32(deviceId_.data(), deviceId_.size()));
     uploadTicker_.start();
+    Logger::info("[Uplink] Flush at %u bytes or %u ms age, phase offset %u ms",
+                 (unsigned)trigger_.targets().target_bytes, (unsigned)trigger_.targets().max_age_ms, (unsigned)phase);
+}
+
+void UplinkPacketizer::setFlushTargets(const FlushTargets& targets) {
+    trigger_.setTargets(targets);
+    Logger::info("[Uplink] Flush targets: %u bytes, %u ms max age",
+                 (unsigned)trigger_.targets().target_bytes, (unsigned)trigger_.targets().max_age_ms);
+}
+
+void UplinkPacketizer::applyFlowHints_(const EcoHttpResponse& resp) {
+    if (resp.retry_after.empty() && resp.next_interval.empty()) return;
+    uint32_t now = millis();
+    if (flow_.applyHints(resp.retry_after, resp.next_interval, now)) {
+        // The server's interval becomes the latency bound; size flushes still go early
+        FlushTargets targets = trigger_.targets();
+        targets.max_age_ms = flow_.intervalMs();
+        trigger_.setTargets(targets);
+        Logger::info("[Uplink] Server set upload interval to %u ms", (unsigned)trigger_.targets().max_age_ms);
+    }
+    if (!flow_.canSend(now)) {
+        Logger::warn("[Uplink] Server asked to back off for %u ms", (unsigned)flow_.deferRemainingMs(now));
+    }
 }
 
 void UplinkPacketizer::end() {
@@ -62,104 +92,273 @@ void UplinkPacketizer::setCloudEndpoint(const std::string& url) {
     cloudUrl_ = url;
 }
 
-// If you keep RAM-only uploads, this can just return true.
-bool UplinkPacketizer::drainOutbox_() {
+bool UplinkPacketizer::enqueue(UplinkLane lane, const std::string& body, const std::string& endpoint) {
+    if (!lanes_.enqueue(lane, endpoint, body, millis())) {
+        Logger::warn("[Uplink] Cannot queue on %s lane", uplinkLaneToString(lane));
+        return false;
+    }
+    Logger::debug("[Uplink] Queued %u bytes on %s lane (%u pending)",
+                  (unsigned)body.size(), uplinkLaneToString(lane), (unsigned)lanes_.pending(lane));
     return true;
 }
 
+// Send queued lane items in priority order until the byte budget is used.
+// Returns the number of payload bytes delivered.
+size_t UplinkPacketizer::drainOutbox_(UplinkLane lowest_lane, size_t budget_bytes) {
+    if (!secure_http_ || cloudUrl_.empty()) return 0;
+
+    constexpr size_t EVENT_BATCH_BYTES = 1024;
+    std::vector<UplinkItem> batch;
+    size_t batch_bytes = 0;
+    size_t sent_bytes = 0;
+    UplinkItem item;
+
+    while (sent_bytes + batch_bytes < budget_bytes && lanes_.pop(item, lowest_lane)) {
+        if (item.endpoint.empty()) {
+            batch_bytes += item.body.size() + 1;
+            batch.push_back(item);
+            if (batch_bytes >= EVENT_BATCH_BYTES) {
+                sent_bytes += flushEventBatch_(batch);
+                batch_bytes = 0;
+            }
+            continue;
+        }
+
+        // Items with their own endpoint (acks, command results) go out in their own small envelope
+        std::string plain_response;
+        EcoHttpResponse resp = secure_http_->securePost(item.endpoint.c_str(), item.body, plain_response);
+        applyFlowHints_(resp);
+        if (!resp.isSuccess()) {
+            Logger::warn("[Uplink] %s item to %s failed: status=%d",
+                         uplinkLaneToString(item.lane), item.endpoint.c_str(), resp.status_code);
+            lanes_.requeue(item);
+            drainBackoffUntil_ = millis() + 2000;
+            break;
+        }
+        lanes_.recordSent(item, millis());
+        sent_bytes += item.body.size();
+    }
+
+    // A due shadow delta goes out with this cycle even when no events are queued
+    if (!batch.empty() || (shadow_ && shadow_->due(millis()))) sent_bytes += flushEventBatch_(batch);
+    return sent_bytes;
+}
+
+size_t UplinkPacketizer::flushEventBatch_(std::vector<UplinkItem>& batch) {
+    std::string shadow_delta;
+    if (shadow_ && shadow_->due(millis())) shadow_delta = shadow_->delta(millis());
+    std::string body = "{\"events\":[";
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (i) body += ",";
+        body += batch[i].body;
+    }
+    if (!shadow_delta.empty()) {
+        if (!batch.empty()) body += ",";
+        body += shadow_delta;
+    }
+    body += "]}";
+
+    std::string plain_response;
+    EcoHttpResponse resp = secure_http_->securePost((cloudUrl_ + "/events").c_str(), body, plain_response);
+    applyFlowHints_(resp);
+    size_t sent = 0;
+    if (resp.isSuccess()) {
+        uint32_t now = millis();
+        for (const UplinkItem& it : batch) {
+            lanes_.recordSent(it, now);
+            sent += it.body.size();
+        }
+        uint32_t acked = 0;
+        if (shadow_ && DeviceShadow::parseAck(plain_response, acked)) shadow_->ack(acked);
+        Logger::info("[Uplink] Sent %u events%s (%u bytes)", (unsigned)batch.size(),
+                     shadow_delta.empty() ? "" : " + shadow delta", (unsigned)body.size());
+    } else {
+        if (!shadow_delta.empty()) shadow_->sendFailed();
+        Logger::warn("[Uplink] Event batch failed: status=%d, requeueing %u events",
+                     resp.status_code, (unsigned)batch.size());
+        // requeue() pushes to the front, so walk backwards to keep the original order
+        for (size_t i = batch.size(); i > 0; --i) lanes_.requeue(batch[i - 1]);
+        drainBackoffUntil_ = millis() + 2000;
+    }
+    batch.clear();
+    return sent;
+}
+
 void UplinkPacketizer::uploadTaskWrapper() {
     if (instance_) {
-        instance_->uploadTask();
+        instance_->flushIfDue_(false);
     }
 }
 
-void UplinkPacketizer::uploadTask() {
-    // 1) Pull recent samples from the ring buffer
-    size_t cap = storage_ ? storage_->getBufferCapacity() : 0;
-    if (cap == 0) return;
+// Runs an upload cycle when a size, age or urgent trigger fires
+void UplinkPacketizer::flushIfDue_(bool urgent) {
+    if (!storage_) return;
+    uint32_t now = millis();
+    if (!flow_.canSend(now)) return;   // Retry-After in force; the backlog waits
+
+    FlushInputs in;
+    in.pending_samples = storage_->pendingFrom(cursor_);
+    in.sample_capacity = (uint32_t)storage_->getBufferCapacity();
+    if (in.pending_samples > 0) {
+        Sample oldest;
+        uint32_t first_seq = cursor_;
+        if (storage_->readFromSequence(cursor_, &oldest, 1, first_seq) == 1 &&
+            (int32_t)(now - oldest.timestamp) > 0) {
+            in.oldest_age_ms = now - oldest.timestamp;
+        }
+    }
+    in.queued_bytes = (uint32_t)(lanes_.pendingBytes(UplinkLane::EVENT) + lanes_.pendingBytes(UplinkLane::BACKGROUND));
+    in.urgent = urgent;
+
+    FlushReason reason = trigger_.evaluate(in, now);
+    if (reason == FlushReason::NONE) return;
+    Logger::info("[Uplink] Flush (%s): %u samples pending, oldest %u ms, ~%u bytes",
+                 flushReasonToString(reason), (unsigned)in.pending_samples, (unsigned)in.oldest_age_ms,
+                 (unsigned)(trigger_.estimateBytes(in.pending_samples) + in.queued_bytes));
+    bool ok = uploadTask();
+    trigger_.onFlush(reason, ok, millis());
+}
 
-    constexpr size_t MAX_SAFE = 1024; // keep allocations bounded
-    size_t toRead = (cap > MAX_SAFE) ? MAX_SAFE : cap;
+// Fold the oldest pending samples into the outage aggregate until at most `keep` remain
+// unsent, so the ring never overwrites data the cloud has not seen in some form.
+void UplinkPacketizer::foldBacklog_(uint32_t keep) {
+    uint32_t pending = storage_->pendingFrom(cursor_);
+    if (pending <= keep) return;
+    uint32_t toFold = pending - keep;
+
+    constexpr size_t FOLD_CHUNK = 64;
+    Sample chunk[FOLD_CHUNK];
+    while (toFold > 0) {
+        uint32_t first_seq = cursor_;
+        size_t want = (toFold < FOLD_CHUNK) ? toFold : FOLD_CHUNK;
+        int got = storage_->readFromSequence(cursor_, chunk, want, first_seq);
+        if (got <= 0) break;
+        lost_ += first_seq - cursor_;
+        for (int i = 0; i < got; ++i) outage_.add(chunk[i]);
+        cursor_ = first_seq + (uint32_t)got;
+        toFold -= (uint32_t)got;
+    }
+}
 
-    Sample* sampleBuf = static_cast<Sample*>(malloc(sizeof(Sample) * toRead));
-    if (!sampleBuf) {
-        Logger::warn("UplinkPacketizer: failed to allocate sampleBuf");
-        return;
+// One upload cycle. False when something could not be delivered.
+bool UplinkPacketizer::uploadTask() {
+    if (!storage_) return false;
+    CpuScope cpu(CpuSubsystem::UPLINK);
+    size_t cap = storage_->getBufferCapacity();
+    if (cap == 0) return false;
+    if (!flow_.canSend(millis())) {
+        Logger::info("[Uplink] Deferred by server for another %u ms; backlog kept",
+                     (unsigned)flow_.deferRemainingMs(millis()));
+        return false;
     }
 
-    size_t sampleCount = storage_->readLastSamples(static_cast<int>(toRead), sampleBuf, toRead);
-    Logger::info("[Uplink] sampleCount=%u", (unsigned)sampleCount);
-    if (sampleCount == 0) {
-        Logger::warn("[Uplink] No samples available for upload.");
-        free(sampleBuf);
-        return;
+    // 0) Queued events go first; bulk telemetry fills what is left of the budget
+    size_t laneBytes = drainOutbox_(UplinkLane::BACKGROUND, uplinkBudget_);
+    bool lanesOk = (int32_t)(millis() - drainBackoffUntil_) >= 0;   // a failed send sets the backoff
+    size_t bulkBudget = (laneBytes < uplinkBudget_) ? uplinkBudget_ - laneBytes : 0;
+
+    // 1) Pick this cycle's fidelity from the backlog and the recent upload history
+    uint32_t backlog = storage_->pendingFrom(cursor_);
+    Fidelity level = policy_.evaluate(backlog);
+    if (level != lastLevel_) {
+        Logger::warn("[Uplink] Fidelity %s -> %s (backlog=%u, failures=%u)",
+                     fidelityToString(lastLevel_), fidelityToString(level),
+                     (unsigned)backlog, (unsigned)policy_.consecutiveFailures());
+        lastLevel_ = level;
     }
 
-    // --- Benchmarking ---
-    // CPU time measurement not available; set to 0
+    // 2) Bound the backlog. Aggregate/heartbeat modes fold everything pending; the
+    //    others only fold what is about to be overwritten in the ring.
+    if (level == Fidelity::AGGREGATE || level == Fidelity::HEARTBEAT) {
+        foldBacklog_(0);
+    } else {
+        foldBacklog_((uint32_t)(cap * 3 / 4));
+    }
 
-    // 2) Compress samples: encode [timestamp, reg_addr, value] for every sample
-    size_t outBufSize = sampleCount * (sizeof(uint32_t) + sizeof(uint8_t) + sizeof(float));
-    Logger::debug("compressData called: sampleCount=%u, outBufSize=%u",
-                  (unsigned)sampleCount, (unsigned)outBufSize);
+    // 3) Encode the cycle's batches. Each batch fits one chunk so the cloud can decode
+    //    every POST on its own and a failed chunk never splits a batch.
+    uint64_t encodeStartUs = cpuClockUs();
+    std::vector<uint8_t> payload;
+    std::vector<PendingBatch> batches;
 
-    char* compressed = static_cast<char*>(malloc(outBufSize));
-    if (!compressed) {
-        Logger::warn("UplinkPacketizer: failed to allocate compressed buffer");
-        free(sampleBuf);
-        return;
+    if (level != Fidelity::HEARTBEAT && !outage_.empty()) {
+        size_t off = payload.size();
+        encodeAggregateBatch(outage_, payload);
+        batches.push_back({off, payload.size() - off, cursor_, true});
     }
 
-    size_t outIdx = 0;
-    auto write = [&](const void* data, size_t len) -> bool {
-        if (outIdx + len > outBufSize) return false;
-        memcpy(compressed + outIdx, data, len);
-        outIdx += len;
-        return true;
-    };
-
-    for (size_t i = 0; i < sampleCount; ++i) {
-        if (!write(&sampleBuf[i].timestamp, sizeof(uint32_t)) ||
-            !write(&sampleBuf[i].reg_addr,  sizeof(uint8_t))  ||
-            !write(&sampleBuf[i].value,     sizeof(float))) {
-            Logger::warn("UplinkPacketizer: failed to write sample %u", static_cast<unsigned>(i));
-            free(sampleBuf);
-            free(compressed);
-            return;
+    Sample* sampleBuf = nullptr;
+    size_t sampleCount = 0;
+    size_t bulkBytes = 0;
+    if (level == Fidelity::FULL || level == Fidelity::LOSSY) {
+        constexpr size_t MAX_SAFE = 1024; // keep allocations bounded
+        size_t toRead = (cap > MAX_SAFE) ? MAX_SAFE : cap;
+        if (toRead > bulkBudget / UPLINK_RAW_SAMPLE_SIZE) toRead = bulkBudget / UPLINK_RAW_SAMPLE_SIZE;
+
+        if (toRead > 0) {
+            sampleBuf = static_cast<Sample*>(malloc(sizeof(Sample) * toRead));
+            if (!sampleBuf) {
+                Logger::warn("UplinkPacketizer: failed to allocate sampleBuf");
+                return false;
+            }
+            uint32_t first_seq = cursor_;
+            sampleCount = storage_->readFromSequence(cursor_, sampleBuf, toRead, first_seq);
+            lost_ += first_seq - cursor_;
+
+            for (size_t i = 0; i < sampleCount;) {
+                size_t off = payload.size();
+                size_t n;
+                if (level == Fidelity::FULL) {
+                    // One frame per polling cycle, as many as fit the chunk; a sample
+                    // that cannot be framed goes out as RAW
+                    n = encodeFrameBatch(sampleBuf + i, sampleCount - i, CHUNK, payload);
+                    if (n == 0) {
+                        n = 1;
+                        encodeRawBatch(sampleBuf + i, n, payload);
+                    }
+                } else {
+                    n = (sampleCount - i < DELTA_SAMPLES_PER_BATCH) ? sampleCount - i : DELTA_SAMPLES_PER_BATCH;
+                    encodeDeltaQBatch(sampleBuf + i, n, lossyStep_, payload);
+                }
+                i += n;
+                batches.push_back({off, payload.size() - off, first_seq + (uint32_t)i, false});
+                bulkBytes += payload.size() - off;
+            }
+            trigger_.observeEncoded((uint32_t)sampleCount, (uint32_t)bulkBytes);
+        } else {
+            Logger::info("[Uplink] Budget used by queued events (%u bytes), skipping bulk this cycle", (unsigned)laneBytes);
         }
+    } else if (level == Fidelity::HEARTBEAT) {
+        encodeHeartbeatBatch(millis(), backlog, lost_, payload);
+        batches.push_back({0, payload.size(), cursor_, false});
     }
 
-    size_t compLen = outIdx;
-    uint32_t cpu_time = 0;
-
-    Logger::info("[Uplink] Compressed payload length: %u", (unsigned)compLen);
-
-    // Print first 24 bytes for backend cross-check
-    size_t debugLen = (compLen < 24) ? compLen : 24;
-    Logger::info("[Uplink] Compressed payload first 24 bytes: %s",
-                 bufToHex(compressed, debugLen).c_str());
-
-    // Optional: full payload hex (careful: large logs)
-    Logger::debug("Compressed payload (%u bytes): %s",
-                  static_cast<unsigned>(compLen),
-                  bufToHex(compressed, compLen).c_str());
-
-    // --- Lossless Recovery Verification ---
-    bool lossless = true;
-    for (size_t i = 0; i < sampleCount; ++i) {
-        size_t idx = i * (sizeof(uint32_t) + sizeof(uint8_t) + sizeof(float));
-        uint32_t ts;
-        uint8_t reg;
-        float val;
-        memcpy(&ts, compressed + idx, sizeof(uint32_t));
-        memcpy(&reg, compressed + idx + sizeof(uint32_t), sizeof(uint8_t));
-        memcpy(&val, compressed + idx + sizeof(uint32_t) + sizeof(uint8_t), sizeof(float));
-        if (ts != sampleBuf[i].timestamp || reg != sampleBuf[i].reg_addr || val != sampleBuf[i].value) {
-            lossless = false;
-            break;
+    Logger::info("[Uplink] fidelity=%s samples=%u batches=%u payload=%u bytes backlog=%u lost=%u",
+                 fidelityToString(level), (unsigned)sampleCount, (unsigned)batches.size(),
+                 (unsigned)payload.size(), (unsigned)backlog, (unsigned)lost_);
+    if (payload.empty()) {
+        free(sampleBuf);
+        return lanesOk;
+    }
+
+    // --- Lossless Recovery Verification (full fidelity only) ---
+    bool lossless = false;
+    if (level == Fidelity::FULL && sampleCount > 0) {
+        lossless = true;
+        size_t verified = 0;
+        for (const PendingBatch& b : batches) {
+            if (b.aggregate) continue;
+            DecodedBatch decoded;
+            size_t used = 0;
+            if (!decodeBatch(payload.data() + b.offset, b.len, decoded, used)) { lossless = false; break; }
+            for (const Sample& d : decoded.samples) {
+                const Sample& o = sampleBuf[verified++];
+                if (d.timestamp != o.timestamp || d.reg_addr != o.reg_addr || d.value != o.value) lossless = false;
+            }
         }
+        if (verified != sampleCount) lossless = false;
+        Logger::info("[Uplink] Lossless recovery verification: %s", lossless ? "PASS" : "FAIL");
     }
-    Logger::info("[Uplink] Lossless recovery verification: %s", lossless ? "PASS" : "FAIL");
 
     // --- Aggregation (min/avg/max) ---
     float minVal = 0.0f, maxVal = 0.0f, sumVal = 0.0f;
@@ -177,104 +376,80 @@ void UplinkPacketizer::uploadTask() {
 
     // --- Benchmark Metadata ---
     size_t original_size = sampleCount * sizeof(Sample);
+    size_t compLen = payload.size();
     float compression_ratio = (original_size > 0) ? (static_cast<float>(compLen) / static_cast<float>(original_size)) : 0.0f;
-    
+
     std::string benchmarkJson = "{";
-    benchmarkJson += "\"compression_method\": \"delta/time-series\",";
+    benchmarkJson += "\"compression_method\": \"" + std::string(fidelityToString(level)) + "\",";
+    benchmarkJson += "\"fidelity\": \"" + std::string(fidelityToString(level)) + "\",";
     benchmarkJson += "\"num_samples\": " + std::to_string(sampleCount) + ",";
     benchmarkJson += "\"original_size\": " + std::to_string(original_size) + ",";
     benchmarkJson += "\"compressed_size\": " + std::to_string(compLen) + ",";
     benchmarkJson += "\"compression_ratio\": " + std::to_string(compression_ratio) + ",";
-    benchmarkJson += "\"cpu_time_ms\": " + std::to_string(cpu_time) + ",";
+    benchmarkJson += "\"cpu_time_ms\": " + std::to_string((cpuClockUs() - encodeStartUs) / 1000) + ",";
     benchmarkJson += "\"lossless\": " + std::string(lossless ? "true" : "false") + ",";
+    benchmarkJson += "\"backlog\": " + std::to_string(backlog) + ",";
+    benchmarkJson += "\"lost\": " + std::to_string(lost_) + ",";
     benchmarkJson += "\"min\": " + std::to_string(minVal) + ",";
     benchmarkJson += "\"avg\": " + std::to_string(avgVal) + ",";
-    benchmarkJson += "\"max\": " + std::to_string(maxVal) + "}";
+    benchmarkJson += "\"max\": " + std::to_string(maxVal) + ",";
+    benchmarkJson += "\"lanes\": " + lanes_.statsJson() + ",";
+    cpuTasks_.sample();
+    benchmarkJson += "\"cpu\": {\"subsystems\": " + CpuAccounting::subsystemsJson() +
+                     ", \"tasks\": " + cpuTasks_.json() + "},";
+    benchmarkJson += "\"stalls\": " + StallDetector::json();
+    if (shadow_) benchmarkJson += ",\"shadow\": " + shadow_->statsJson();
+    if (secure_http_) {
+        benchmarkJson += ",\"rtt\": {\"cloud\": " + secure_http_->getHttpClient()->rttJson();
+        if (inverter_http_) benchmarkJson += ", \"inverter\": " + inverter_http_->rttJson();
+        benchmarkJson += "}";
+    }
+    if (hedge_policy_) benchmarkJson += ",\"hedge\": " + hedge_policy_->json();
+    if (fec_.enabled()) benchmarkJson += ",\"fec\": " + fec_.json();
+    benchmarkJson += "}";
     // Avoid logging full JSON to prevent stack issues
     Logger::info("[Uplink] Benchmark metadata created (%u bytes)", benchmarkJson.length());
 
-    // 3) Encrypt (stub) — keep buffer >= compLen
-    char* encrypted = static_cast<char*>(malloc(compLen));
-    if (!encrypted) {
-        Logger::warn("UplinkPacketizer: failed to allocate encrypted buffer");
-        free(sampleBuf);
-        free(compressed);
-        return;
-    }
-    size_t encLen = 0;
-    encryptData(compressed, compLen, encrypted, compLen, encLen);
-
-    // 4) MAC (stub)
-    constexpr size_t MAC_MAX = 64;
-    char* mac = static_cast<char*>(malloc(MAC_MAX));
-    if (!mac) {
-        Logger::warn("UplinkPacketizer: failed to allocate mac buffer");
-        free(sampleBuf);
-        free(compressed);
-        free(encrypted);
-        return;
-    }
-    size_t macLen = 0;
-    computeMAC(encrypted, encLen, mac, MAC_MAX, macLen);
-
-
-    // First, upload benchmark metadata as JSON (using plain HTTP, no security needed for metadata)
-    if (secure_http_ && !cloudUrl_.empty()) {
+    // First, upload benchmark metadata as JSON (using plain HTTP, no security needed for metadata).
+    // Skipped while degraded: the link is already the bottleneck.
+    if (secure_http_ && !cloudUrl_.empty() && level == Fidelity::FULL) {
         EcoHttpClient* plain_http = secure_http_->getHttpClient();
-        EcoHttpResponse metaResp = plain_http->post((cloudUrl_ + "/meta").c_str(), 
-                                                     benchmarkJson.c_str(), 
+        EcoHttpResponse metaResp = plain_http->post((cloudUrl_ + "/meta").c_str(),
+                                                     benchmarkJson.c_str(),
                                                      benchmarkJson.length(),
                                                      "application/json");
         Logger::info("[Uplink] Benchmark metadata upload status: %d", metaResp.status_code);
     }
-    // Log only first few bytes to avoid stack overflow
-    Logger::info("[Uplink] Upload payload (%u bytes): %s...",
-                 (unsigned)encLen, bufToHex(encrypted, encLen < 8 ? encLen : 8).c_str());
-    (void)chunkAndUpload(encrypted, encLen);
 
-    free(sampleBuf);
-    free(compressed);
-    free(encrypted);
-    free(mac);
-}
-
-void UplinkPacketizer::encryptData(const char* inBuf, size_t inLen,
-                                   char* outBuf, size_t outBufSize,
-                                   size_t& outLen) {
-    Logger::debug("encryptData called: inLen=%u, outBufSize=%u",
-                  (unsigned)inLen, (unsigned)outBufSize);
-
-    // Stub: copy through
-    if (outBufSize >= inLen) {
-        memcpy(outBuf, inBuf, inLen);
-        outLen = inLen;
-    } else {
-        outLen = 0;
+    bool ok = chunkAndUpload(payload.data(), batches);
+    policy_.onUploadResult(ok);
+    if (ok && sampleCount > 0) {
+        lanes_.recordBulk(millis() - sampleBuf[0].timestamp);
     }
-}
 
-void UplinkPacketizer::computeMAC(const char* /*inBuf*/, size_t inLen,
-                                  char* /*outBuf*/, size_t outBufSize,
-                                  size_t& outLen) {
-    Logger::debug("computeMAC called: inLen=%u, outBufSize=%u",
-                  (unsigned)inLen, (unsigned)outBufSize);
-    // Stub: none
-    outLen = 0;
+    free(sampleBuf);
+    return ok && lanesOk;
 }
 
-bool UplinkPacketizer::chunkAndUpload(const char* data, size_t len) {
-    Logger::debug("chunkAndUpload called: len=%u", (unsigned)len);
+// Sends whole batches packed into chunks of at most CHUNK bytes. The upload cursor
+// advances (and a delivered outage aggregate is cleared) after each acknowledged
+// chunk, so a failure part-way never re-sends or drops delivered data.
+bool UplinkPacketizer::chunkAndUpload(const uint8_t* data, const std::vector<PendingBatch>& batches) {
+    Logger::debug("chunkAndUpload called: batches=%u", (unsigned)batches.size());
 
     if (!secure_http_ || cloudUrl_.empty()) {
         Logger::warn("chunkAndUpload: secure_http_ or cloudUrl_ not set");
         return false;
     }
 
-    constexpr size_t CHUNK = 1024;
-    size_t offset = 0;
+    if (fec_.enabled()) return chunkAndUploadFec_(data, batches);
 
-    while (offset < len) {
-        size_t thisChunk = (len - offset > CHUNK) ? CHUNK : (len - offset);
+    size_t next = 0;
+    while (next < batches.size()) {
+        size_t first = next;
+        size_t offset = batches[first].offset;
+        next = packChunk_(batches, first);
+        size_t thisChunk = batches[next - 1].offset + batches[next - 1].len - offset;
 
         int attempt = 0;
         constexpr int MAX_RETRIES = 3;
@@ -283,39 +458,139 @@ bool UplinkPacketizer::chunkAndUpload(const char* data, size_t len) {
         Logger::info("[Uplink] Sending chunk: endpoint=%s, offset=%u, size=%u",
                      cloudUrl_.c_str(), (unsigned)offset, (unsigned)thisChunk);
 
+        // The chunk is referenced in place; only the envelope around it is written
+        IoChain chunk(&bufPool_);
+        chunk.append(IoBuf::wrap(data + offset, thisChunk));
+
         while (attempt < MAX_RETRIES && !success) {
-            // Convert binary chunk to string for SecureHttpClient
-            std::string chunk_data(data + offset, thisChunk);
             std::string plain_response;
-            EcoHttpResponse resp = secure_http_->securePost(cloudUrl_.c_str(), chunk_data, plain_response);
+            EcoHttpResponse resp = secure_http_->securePost(cloudUrl_.c_str(), chunk, plain_response);
             Logger::debug("[Uplink] Attempt %d: status_code=%d, success=%d",
                           attempt + 1, resp.status_code, resp.isSuccess());
             success = resp.isSuccess();
             ++attempt;
+            applyFlowHints_(resp);
+            if (!success && !flow_.canSend(millis())) break;  // server said when to come back
 
             if (!success && attempt < MAX_RETRIES && resp.status_code == 0) {
                 Logger::warn("[Uplink] Connection failure, retrying...");
-                // vTaskDelay(200); // Delay not available in this build context
             }
         }
 
         if (!success) {
             Logger::warn("UplinkPacketizer: failed to upload chunk at offset %u after %d attempts",
                          static_cast<unsigned>(offset), MAX_RETRIES);
-            return false; // abort whole upload; caller will retry later
+            return false; // undelivered batches stay behind the cursor for the next cycle
         }
 
+        delivered_(batches, first, next);
         Logger::info("[Uplink] Chunk upload OK: offset=%u, size=%u",
                      (unsigned)offset, (unsigned)thisChunk);
-        offset += thisChunk;
     }
 
-    Logger::info("[Uplink] All chunks uploaded successfully, total_len=%u", (unsigned)len);
+    const IoBufStats& bs = bufPool_.stats();
+    Logger::info("[Uplink] All chunks uploaded successfully, batches=%u, copies/byte=%.2f, pool overflow=%u",
+                 (unsigned)batches.size(), bs.bytes_sent ? (double)bs.bytes_copied / bs.bytes_sent : 0.0,
+                 (unsigned)bs.overflow);
+    return true;
+}
+
+// Consecutive batches from first that fit one chunk; returns the index after the last
+size_t UplinkPacketizer::packChunk_(const std::vector<PendingBatch>& batches, size_t first) {
+    size_t next = first;
+    size_t thisChunk = 0;
+    while (next < batches.size() && (thisChunk == 0 || thisChunk + batches[next].len <= CHUNK)) {
+        thisChunk += batches[next].len;
+        ++next;
+    }
+    return next;
+}
+
+void UplinkPacketizer::delivered_(const std::vector<PendingBatch>& batches, size_t first, size_t end) {
+    for (size_t i = first; i < end; ++i) {
+        if (batches[i].aggregate) outage_.clear();
+        if ((int32_t)(batches[i].end_seq - cursor_) > 0) cursor_ = batches[i].end_seq;
+    }
+}
+
+// Chunks go out in FEC groups, each shard sent once. The cursor advances per group,
+// once the server has reported it complete. A group that was not confirmed is resent
+// as it was, under the same group ID, before anything new.
+bool UplinkPacketizer::chunkAndUploadFec_(const uint8_t* data, const std::vector<PendingBatch>& batches) {
+    auto send = [&](const uint8_t* head, size_t head_len, const uint8_t* body, size_t body_len) {
+        IoChain shard(&bufPool_);
+        shard.append(IoBuf::wrap(head, head_len));
+        shard.append(IoBuf::wrap(body, body_len));
+        std::string plain_response;
+        EcoHttpResponse resp = secure_http_->securePost(cloudUrl_.c_str(), shard, plain_response);
+        applyFlowHints_(resp);
+        FecReply reply;
+        FecShardHeader h;
+        if (resp.isSuccess() && FecShardHeader::parse(head, head_len, h)) {
+            UplinkFec::parseReply(plain_response, h.group, reply);
+            reply.answered = true;
+        }
+        reply.stop = !flow_.canSend(millis());
+        return reply;
+    };
+
+    if (fec_.held() && cursor_ != fecHeldFrom_) fec_.dropHeld();   // folded into outage_ meanwhile
+    if (fec_.held()) {
+        if (!fec_.resendHeld(send)) {
+            Logger::warn("[Uplink] Held FEC group at seq %u still not confirmed", (unsigned)fecHeldFrom_);
+            return false;
+        }
+        if ((int32_t)(fecHeldTo_ - cursor_) > 0) cursor_ = fecHeldTo_;
+        // If more was folded since, the aggregate goes out again with it next cycle
+        if (fecHeldAggregate_ && outage_.totalSamples() == fecHeldOutage_) outage_.clear();
+        Logger::info("[Uplink] Held FEC group confirmed up to seq %u", (unsigned)cursor_);
+        // This cycle's batches were encoded from the old cursor and overlap the group;
+        // the rest is encoded again from the new cursor on the next trigger check
+        return true;
+    }
+
+    size_t next = 0;
+    while (next < batches.size()) {
+        size_t first = next;
+        const uint8_t* chunks[UplinkFec::MAX_GROUP];
+        size_t lens[UplinkFec::MAX_GROUP];
+        size_t k = 0;
+        while (next < batches.size() && k < fec_.config().group && k < UplinkFec::MAX_GROUP) {
+            size_t end = packChunk_(batches, next);
+            chunks[k] = data + batches[next].offset;
+            lens[k] = batches[end - 1].offset + batches[end - 1].len - batches[next].offset;
+            ++k;
+            next = end;
+        }
+        uint32_t parityBefore = fec_.stats().parity_sent;
+        uint32_t from = cursor_;
+        if (!fec_.sendGroup(chunks, lens, k, send)) {
+            fecHeldFrom_ = from;
+            fecHeldTo_ = from;
+            fecHeldAggregate_ = false;
+            for (size_t i = first; i < next; ++i) {
+                if ((int32_t)(batches[i].end_seq - fecHeldTo_) > 0) fecHeldTo_ = batches[i].end_seq;
+                fecHeldAggregate_ |= batches[i].aggregate;
+            }
+            fecHeldOutage_ = outage_.totalSamples();
+            Logger::warn("[Uplink] FEC group of %u chunks at offset %u not confirmed (loss %u/1000)",
+                         (unsigned)k, (unsigned)batches[first].offset, (unsigned)fec_.lossPermille());
+            return false;   // undelivered batches stay behind the cursor for the next cycle
+        }
+        delivered_(batches, first, next);
+        Logger::info("[Uplink] FEC group OK: %u chunks, %u parity", (unsigned)k,
+                     (unsigned)(fec_.stats().parity_sent - parityBefore));
+    }
     return true;
 }
 
 void UplinkPacketizer::loop() {
     if (running_) {
+        // Urgent items do not wait for the trigger check; pending events and telemetry ride along
+        uint32_t now = millis();
+        if (lanes_.hasPending(UplinkLane::URGENT) && (int32_t)(now - drainBackoffUntil_) >= 0) {
+            flushIfDue_(true);
+        }
         uploadTicker_.update();
     }
 }
@@ -0,0 +1,125 @@
+/**
+ * @file alloc_counter.hpp
+ * @brief Heap allocation counting for the allocation budget tests
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Counts heap allocations made by the calling thread while an AllocCounter is alive.
+// Other threads (a loopback server, gtest itself) are not counted.
+//
+// Replaces the global operator new/delete and, on glibc without sanitizers, also
+// interposes malloc/calloc/realloc so C allocations are seen too. Include it in exactly
+// one translation unit per test executable.
+
+struct AllocStats {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+};
+
+namespace alloc_counter_detail {
+inline thread_local AllocStats* active = nullptr;
+
+inline void count(size_t n) {
+    AllocStats* s = active;
+    if (!s) return;
+    s->allocations++;
+    s->bytes += n;
+}
+}
+
+class AllocCounter {
+public:
+    AllocCounter() : prev_(alloc_counter_detail::active) { alloc_counter_detail::active = &stats_; }
+    ~AllocCounter() { stop(); }
+    AllocCounter(const AllocCounter&) = delete;
+    AllocCounter& operator=(const AllocCounter&) = delete;
+
+    // Stops counting and returns what was seen
+    const AllocStats& stop() {
+        if (running_) {
+            alloc_counter_detail::active = prev_;
+            running_ = false;
+        }
+        return stats_;
+    }
+
+private:
+    AllocStats stats_;
+    AllocStats* prev_;
+    bool running_ = true;
+};
+
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define ALLOC_COUNTER_MALLOC 0
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define ALLOC_COUNTER_MALLOC 0
+#endif
+#endif
+#if !defined(ALLOC_COUNTER_MALLOC) && defined(__GLIBC__)
+#define ALLOC_COUNTER_MALLOC 1
+#endif
+#ifndef ALLOC_COUNTER_MALLOC
+#define ALLOC_COUNTER_MALLOC 0
+#endif
+
+#if ALLOC_COUNTER_MALLOC
+extern "C" {
+void* __libc_malloc(size_t);
+void* __libc_calloc(size_t, size_t);
+void* __libc_realloc(void*, size_t);
+
+void* malloc(size_t n) {
+    alloc_counter_detail::count(n);
+    return __libc_malloc(n);
+}
+void* calloc(size_t count, size_t n) {
+    alloc_counter_detail::count(count * n);
+    return __libc_calloc(count, n);
+}
+void* realloc(void* p, size_t n) {
+    alloc_counter_detail::count(n);
+    return __libc_realloc(p, n);
+}
+}
+// operator new goes through malloc above and is counted there
+#define ALLOC_COUNTER_NEW_COUNT(n)
+#else
+#define ALLOC_COUNTER_NEW_COUNT(n) alloc_counter_detail::count(n)
+#endif
+
+// delete hands operator new's malloc'd blocks back to free, which GCC cannot tell apart
+// from a mismatched pair once the operators are inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void* operator new(size_t n) {
+    ALLOC_COUNTER_NEW_COUNT(n);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) {
+    ALLOC_COUNTER_NEW_COUNT(n);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+    ALLOC_COUNTER_NEW_COUNT(n);
+    return std::malloc(n ? n : 1);
+}
+void* operator new[](size_t n, const std::nothrow_t&) noexcept {
+    ALLOC_COUNTER_NEW_COUNT(n);
+    return std::malloc(n ? n : 1);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+#pragma GCC diagnostic pop
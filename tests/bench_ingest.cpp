@@ -0,0 +1,92 @@
+/**
+ * @file bench_ingest.cpp
+ * @brief Decoded samples per second (per core) of the native ingest decoder (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ *
+ * Builds a corpus of secured envelopes the way the device does (DELTA_Q batches packed
+ * into 1 KB chunks, sealed with sealEnvelope) and decodes it with the pool at 1..N
+ * threads. Each run verifies the MAC, base64-decodes and decodes every batch.
+ */
+
+#include "ingest_decoder.hpp"
+#include "secure_envelope.hpp"
+#include "uplink_codec.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double nowSec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint8_t kKey[32] = {0xc4, 0x17, 0x16, 0xa1};
+
+int main(int argc, char** argv) {
+    size_t envelopes = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    unsigned max_threads = argc > 2 ? (unsigned)atoi(argv[2]) : std::thread::hardware_concurrency();
+    if (max_threads == 0) max_threads = 1;
+
+    // Device-shaped corpus: ~80-sample DELTA_Q batches, as many as fit a 1 KB chunk
+    IoBufPool pool(2048, 4);
+    HmacSha256 hmac(kKey, sizeof(kKey));
+    std::vector<std::string> bodies;
+    size_t corpus_samples = 0;
+    for (size_t e = 0; e < envelopes; ++e) {
+        std::vector<uint8_t> payload;
+        uint32_t ts = (uint32_t)e * 60000;
+        for (;;) {
+            std::vector<Sample> batch;
+            for (size_t i = 0; i < 80; ++i) {
+                batch.push_back(Sample{ts + (uint32_t)i * 250, (uint8_t)(i % 10),
+                                       230.0f + (float)((e * 7 + i * 13) % 400) * 0.05f});
+            }
+            std::vector<uint8_t> encoded;
+            encodeDeltaQBatch(batch.data(), batch.size(), 0.01f, encoded);
+            if (!payload.empty() && payload.size() + encoded.size() > 1024) break;
+            payload.insert(payload.end(), encoded.begin(), encoded.end());
+            corpus_samples += batch.size();
+            ts += 80 * 250;
+        }
+        IoChain in(&pool), out(&pool);
+        in.append(IoBuf::wrap(payload.data(), payload.size()));
+        sealEnvelope(in, (uint32_t)e + 1, ts, false, hmac, out);
+        bodies.push_back(out.toString());
+    }
+    std::vector<const char*> ptrs;
+    std::vector<size_t> lens;
+    size_t corpus_bytes = 0;
+    for (const std::string& b : bodies) {
+        ptrs.push_back(b.data());
+        lens.push_back(b.size());
+        corpus_bytes += b.size();
+    }
+    printf("%zu envelopes, %.1f MB, %zu samples (%.0f per envelope)\n", envelopes, corpus_bytes / 1e6,
+           corpus_samples, (double)corpus_samples / envelopes);
+    printf("%8s %14s %14s %10s\n", "threads", "samples/s", "per core", "MB/s");
+
+    std::vector<ew_ingest_result> results(bodies.size());
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        IngestDecoder decoder(kKey, sizeof(kKey), threads);
+        std::vector<ew_sample> samples;
+        double best = 1e9;
+        for (int round = 0; round < 3; ++round) {
+            samples.clear();
+            double t0 = nowSec();
+            decoder.decodeEnvelopes(ptrs.data(), lens.data(), ptrs.size(), samples, results.data());
+            double dt = nowSec() - t0;
+            if (dt < best) best = dt;
+        }
+        if (samples.size() != corpus_samples) {
+            fprintf(stderr, "decoded %zu of %zu samples\n", samples.size(), corpus_samples);
+            return 1;
+        }
+        double rate = corpus_samples / best;
+        printf("%8u %14.0f %14.0f %10.1f\n", threads, rate, rate / threads, corpus_bytes / best / 1e6);
+        if (threads < max_threads && threads * 2 > max_threads) threads = max_threads / 2;
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file bench_modbus_tcp.cpp
+ * @brief Modbus TCP read throughput against pipeline depth (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ *
+ * Runs the client against the loopback stand-in with a fixed per-request turnaround
+ * (default 2 ms, roughly a LAN gateway). Two workloads: a large contiguous register
+ * map read with readRange (125-register requests), and many single-register reads
+ * (sparse maps, which is how the acquisition loop polls). With depth 1 every request
+ * waits out the full turnaround; deeper pipelines overlap them.
+ */
+
+#include "modbus_tcp.hpp"
+#include "modbus_tcp_loopback.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static double nowSec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    uint32_t registers = argc > 1 ? (uint32_t)atol(argv[1]) : 8000;
+    uint32_t latency_us = argc > 2 ? (uint32_t)atol(argv[2]) : 2000;
+    if (registers == 0 || registers > 65536) registers = 8000;
+
+    LoopbackModbusServer::Options opts;
+    opts.latency_us = latency_us;
+    LoopbackModbusServer server(opts);
+
+    std::vector<uint16_t> values(registers);
+    const size_t singles = 400;
+    std::vector<uint16_t> single_values(singles);
+    std::vector<ModbusRead> reads(singles);
+    for (size_t i = 0; i < singles; ++i) {
+        reads[i].start = (uint16_t)(i * 13);
+        reads[i].values = &single_values[i];
+    }
+
+    printf("%u-register map, %zu single reads, %u us turnaround\n\n", registers, singles, latency_us);
+    printf("%6s %14s %14s %14s %10s\n", "depth", "map ms", "map regs/s", "single req/s", "speedup");
+    double base = 0;
+    for (uint8_t depth : {1, 2, 4, 8, 16}) {
+        ModbusTcpClient client("127.0.0.1", server.port(), 1, 2000, depth);
+        if (!client.connect()) {
+            fprintf(stderr, "connect failed: %s\n", client.lastError().c_str());
+            return 1;
+        }
+
+        double t0 = nowSec();
+        bool ok = client.readRange(0x03, 0, registers, values.data());
+        double map_s = nowSec() - t0;
+
+        t0 = nowSec();
+        size_t got = client.readBatch(reads.data(), reads.size());
+        double single_s = nowSec() - t0;
+
+        for (uint32_t i = 0; ok && i < registers; ++i) ok = values[i] == LoopbackModbusServer::expected((uint16_t)i);
+        if (!ok || got != singles) {
+            fprintf(stderr, "depth %u: read failed (%zu/%zu singles)\n", depth, got, singles);
+            return 1;
+        }
+        double rate = singles / single_s;
+        if (depth == 1) base = rate;
+        printf("%6u %14.1f %14.0f %14.0f %9.1fx\n", depth, map_s * 1e3, registers / map_s, rate, rate / base);
+    }
+    return 0;
+}
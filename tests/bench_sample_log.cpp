@@ -0,0 +1,96 @@
+/**
+ * @file bench_sample_log.cpp
+ * @brief Append/scan throughput of the raw sample log vs the CSV file path (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ *
+ * The raw log runs on an mmap'ed file (MappedFileRegion). The file path reproduces what
+ * DataStorage does on LittleFS: every flush rewrites the whole 512-sample ring as CSV and
+ * a time query parses the file line by line. Host numbers rank the two designs; the
+ * bytes-written column is what matters for flash wear on the device.
+ */
+
+#include "sample_log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static double nowSec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const size_t RING = 512;        // DataStorage RAM ring
+static const size_t PER_FLUSH = 60;    // samples gathered between flushes
+
+int main(int argc, char** argv) {
+    size_t total = argc > 1 ? (size_t)atol(argv[1]) : 60000;
+    std::vector<Sample> samples;
+    for (size_t i = 0; i < total; ++i) samples.push_back(Sample{(uint32_t)(i * 1000), (uint8_t)(i % 10), 230.0f + (i % 17)});
+
+    // Raw log, 256 KB like the samplelog partition
+    std::string log_path = "/tmp/bench_sample_log.bin";
+    unlink(log_path.c_str());
+    MappedFileRegion region(log_path, 64 * SampleLog::SECTOR_SIZE);
+    SampleLog log(&region);
+    if (!region.ok() || !log.begin()) {
+        fprintf(stderr, "cannot map %s\n", log_path.c_str());
+        return 1;
+    }
+    double t0 = nowSec();
+    for (size_t i = 0; i < total; i += PER_FLUSH) log.append(&samples[i], std::min(PER_FLUSH, total - i));
+    double log_append = nowSec() - t0;
+
+    // CSV rewrite of the ring on every flush
+    std::string csv_path = "/tmp/bench_sample_log.csv";
+    uint64_t csv_bytes = 0;
+    t0 = nowSec();
+    for (size_t i = 0; i < total; i += PER_FLUSH) {
+        size_t end = std::min(i + PER_FLUSH, total);
+        size_t start = end > RING ? end - RING : 0;
+        FILE* f = fopen(csv_path.c_str(), "w");
+        for (size_t k = start; k < end; ++k) {
+            csv_bytes += (uint64_t)fprintf(f, "%lu,%u,%.3f\n", (unsigned long)samples[k].timestamp,
+                                           samples[k].reg_addr, samples[k].value);
+        }
+        fclose(f);
+    }
+    double csv_append = nowSec() - t0;
+
+    // Time-range query over everything retained
+    const int queries = 200;
+    size_t hits = 0;
+    t0 = nowSec();
+    for (int q = 0; q < queries; ++q) {
+        hits += log.scan(0, 0xFFFFFFFFu, [](const SampleLogRecord&) { return true; });
+    }
+    double log_scan = nowSec() - t0;
+    size_t log_scanned = hits;
+
+    hits = 0;
+    t0 = nowSec();
+    for (int q = 0; q < queries; ++q) {
+        FILE* f = fopen(csv_path.c_str(), "r");
+        unsigned long ts;
+        unsigned reg;
+        float value;
+        while (fscanf(f, "%lu,%u,%f\n", &ts, &reg, &value) == 3) hits++;
+        fclose(f);
+    }
+    double csv_scan = nowSec() - t0;
+    size_t csv_scanned = hits;
+
+    printf("%zu samples, flush every %zu\n\n", total, PER_FLUSH);
+    printf("%-12s %14s %16s %14s %12s\n", "path", "append k/s", "bytes/sample", "scan Mrec/s", "retained");
+    printf("%-12s %14.1f %16.2f %14.2f %12zu\n", "raw log", total / log_append / 1e3,
+           (double)log.stats().bytes_written / total, log_scanned / log_scan / 1e6, log.records());
+    printf("%-12s %14.1f %16.2f %14.2f %12zu\n", "csv file", total / csv_append / 1e3,
+           (double)csv_bytes / total, csv_scanned / csv_scan / 1e6, std::min(total, RING));
+    printf("\nraw log: %s\n", log.statsJson().c_str());
+    unlink(log_path.c_str());
+    unlink(csv_path.c_str());
+    return 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file bench_sample_query.cpp
+ * @brief Predicate queries over months of sample history, zone maps vs a full decode (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ *
+ * Synthetic history: 10 registers polled once a minute (timestamps in seconds so months
+ * fit in u32). Pac (reg 9) follows the sun and is zero at night, with a 20-minute trip
+ * at noon every 9th day. Inverter temperature (reg 7) peaks in the afternoon and passes
+ * 60 degrees only on every 11th day. The log is a MappedFileRegion big enough to keep
+ * all of it; the partition on the device holds far less, but the skip rate depends
+ * on how selective the predicate is, not on the history length.
+ */
+
+#include "sample_log.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static double nowMs() {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint32_t DAY = 86400;
+static const uint8_t REG_TEMP = 7;
+static const uint8_t REG_PAC = 9;
+
+static float sun(uint32_t ts) {
+    double hour = (ts % DAY) / 3600.0;
+    return hour < 6 || hour > 18 ? 0.0f : (float)sin((hour - 6) / 12 * M_PI);
+}
+
+static float value(uint32_t ts, uint8_t reg) {
+    uint32_t day = ts / DAY;
+    double hour = (ts % DAY) / 3600.0;
+    switch (reg) {
+    case REG_PAC:
+        if (day % 9 == 4 && hour >= 12 && hour < 12 + 20 / 60.0) return 0.0f;
+        return roundf(3000 * sun(ts));
+    case REG_TEMP: {
+        double warm = hour >= 9 && hour < 19 ? sin((hour - 9) / 10 * M_PI) : 0.0;
+        return (float)(28 + (day % 11 == 5 ? 34 : 24) * warm);
+    }
+    default:
+        return 230.0f + (float)(reg * 10) * sun(ts);
+    }
+}
+
+struct Row {
+    const char* name;
+    size_t matches;
+    SampleLogQueryStats st;
+    double zone_ms;
+    double full_ms;
+};
+
+static void print(const Row& r) {
+    printf("%-30s %9zu %9u %9u %9u %10.2f %10.2f %8.1fx\n", r.name, r.matches, (unsigned)r.st.sectors_skipped,
+           (unsigned)r.st.sectors_scanned, (unsigned)r.st.sectors_summarized, r.zone_ms, r.full_ms,
+           r.full_ms / (r.zone_ms > 0 ? r.zone_ms : 1e-6));
+}
+
+static void add(SampleLogQueryStats& into, const SampleLogQueryStats& st) {
+    into.sectors_skipped += st.sectors_skipped;
+    into.sectors_scanned += st.sectors_scanned;
+    into.sectors_summarized += st.sectors_summarized;
+    into.records_decoded += st.records_decoded;
+    into.matches += st.matches;
+}
+
+int main(int argc, char** argv) {
+    uint32_t days = argc > 1 ? (uint32_t)atol(argv[1]) : 90;
+    const uint32_t poll_s = 60;
+    const uint8_t regs = 10;
+    size_t records = (size_t)days * (DAY / poll_s) * regs;
+    size_t sectors = records / SampleLog::RECORDS_PER_SECTOR + 2;
+
+    std::string path = "/tmp/bench_sample_query.bin";
+    unlink(path.c_str());
+    MappedFileRegion region(path, sectors * SampleLog::SECTOR_SIZE);
+    SampleLog log(&region);
+    if (!region.ok() || !log.begin()) {
+        fprintf(stderr, "cannot map %s\n", path.c_str());
+        return 1;
+    }
+    double t0 = nowMs();
+    std::vector<Sample> frame(regs);
+    for (uint32_t ts = 0; ts < days * DAY; ts += poll_s) {
+        for (uint8_t r = 0; r < regs; ++r) frame[r] = Sample{ts, r, value(ts, r)};
+        if (!log.append(frame.data(), frame.size())) {
+            fprintf(stderr, "append failed\n");
+            return 1;
+        }
+    }
+    double build_ms = nowMs() - t0;
+
+    // After a reboot the zone maps are built from flash by the first query
+    t0 = nowMs();
+    SampleLog reopened(&region);
+    reopened.begin();
+    double begin_ms = nowMs() - t0;
+    t0 = nowMs();
+    reopened.summarize(0, 0, 0xFFFFFFFFu);
+    double zones_ms = nowMs() - t0;
+    log.scan(0, 0xFFFFFFFFu, [](const SampleLogRecord&) { return true; });   // fault the mapping in
+
+    printf("%u days, %zu records in %zu sectors (%.1f MB), appended in %.0f ms, begin() %.1f ms, "
+           "zone maps %.1f ms\n\n",
+           days, log.records(), sectors, sectors * SampleLog::SECTOR_SIZE / 1e6, build_ms, begin_ms, zones_ms);
+    printf("%-30s %9s %9s %9s %9s %10s %10s %9s\n", "query", "matches", "skipped", "scanned", "summed",
+           "zone ms", "full ms", "speedup");
+
+    auto count = [](size_t& n) {
+        return [&n](const SampleLogRecord&) {
+            n++;
+            return true;
+        };
+    };
+    auto fullScan = [&](const SampleLogQuery& q) {
+        size_t n = 0;
+        log.scan(q.start_ts, q.end_ts, [&](const SampleLogRecord& r) {
+            if (q.matches(r)) n++;
+            return true;
+        });
+        return n;
+    };
+
+    std::vector<std::pair<const char*, SampleLogQuery>> queries = {
+        {"temperature > 60 (all)", SampleLogQuery::above(REG_TEMP, 60.0f)},
+        {"temperature > 60 (last 30 d)",
+         SampleLogQuery::above(REG_TEMP, 60.0f).during((days > 30 ? days - 30 : 0) * DAY, days * DAY)},
+        {"Pac == 0 (all)", SampleLogQuery::between(REG_PAC, 0.0f, 0.0f)},
+        {"Pac > 2900 (all)", SampleLogQuery::above(REG_PAC, 2900.0f)},
+    };
+    for (auto& item : queries) {
+        Row row{item.first, 0, {}, 0, 0};
+        size_t n = 0;
+        t0 = nowMs();
+        log.query(item.second, count(n), &row.st);
+        row.zone_ms = nowMs() - t0;
+        row.matches = n;
+        t0 = nowMs();
+        size_t full = fullScan(item.second);
+        row.full_ms = nowMs() - t0;
+        if (full != n) fprintf(stderr, "mismatch: %zu vs %zu\n", n, full);
+        print(row);
+    }
+
+    // "Pac was zero during daylight": one query per day over 08:00-16:00
+    {
+        Row row{"Pac == 0, 08-16 h, per day", 0, {}, 0, 0};
+        size_t n = 0, full = 0;
+        for (uint32_t d = 0; d < days; ++d) {
+            SampleLogQuery q = SampleLogQuery::between(REG_PAC, 0.0f, 0.0f).during(d * DAY + 8 * 3600, d * DAY + 16 * 3600);
+            SampleLogQueryStats st;
+            t0 = nowMs();
+            log.query(q, count(n), &st);
+            row.zone_ms += nowMs() - t0;
+            add(row.st, st);
+            t0 = nowMs();
+            full += fullScan(q);
+            row.full_ms += nowMs() - t0;
+        }
+        row.matches = n;
+        if (full != n) fprintf(stderr, "mismatch: %zu vs %zu\n", n, full);
+        print(row);
+    }
+
+    // Aggregate: whole sectors come from the zone maps
+    {
+        Row row{"mean temperature (last 30 d)", 0, {}, 0, 0};
+        uint32_t start = (days > 30 ? days - 30 : 0) * DAY, end = days * DAY;
+        t0 = nowMs();
+        SampleLogZone z = log.summarize(REG_TEMP, start, end, &row.st);
+        row.zone_ms = nowMs() - t0;
+        row.matches = z.count;
+        SampleLogZone brute;
+        t0 = nowMs();
+        log.scan(start, end, [&](const SampleLogRecord& r) {
+            if (r.reg == REG_TEMP) brute.add(r.value);
+            return true;
+        });
+        row.full_ms = nowMs() - t0;
+        if (brute.count != z.count) fprintf(stderr, "mismatch: %u vs %u\n", (unsigned)z.count, (unsigned)brute.count);
+        print(row);
+        printf("\nmean %.2f (full decode %.2f), min %.1f, max %.1f\n", z.mean(), brute.mean(), z.min, z.max);
+    }
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file bench_sha256.cpp
+ * @brief SHA-256 throughput per backend (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include "sha256_engine.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+
+static uint64_t nowUs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv) {
+    // Sizes: a secured message, a FOTA chunk, a bulk buffer
+    const size_t sizes[] = {256, 16384, 1 << 20};
+    const size_t total_mb = argc > 1 ? (size_t)atoi(argv[1]) : 64;
+
+    printf("%-10s %10s %10s\n", "backend", "buffer", "MB/s");
+    for (Sha256Backend b : {Sha256Backend::PORTABLE, Sha256Backend::SHA_NI, Sha256Backend::AVX2_MB,
+                            Sha256Backend::ESP32_HW}) {
+        if (!sha256BackendAvailable(b)) {
+            printf("%-10s %10s %10s\n", sha256BackendName(b), "-", "n/a");
+            continue;
+        }
+        for (size_t size : sizes) {
+            uint32_t iterations = (uint32_t)(total_mb * 1048576 / size);
+            if (iterations == 0) iterations = 1;
+            printf("%-10s %10zu %10.1f\n", sha256BackendName(b), size,
+                   sha256BenchmarkMBps(b, size, iterations, nowUs));
+        }
+    }
+    printf("best single-stream backend: %s\n", sha256BackendName(sha256BestBackend()));
+    printf("best multi-buffer backend: %s\n", sha256BackendName(sha256MultiBackend()));
+    return 0;
+}
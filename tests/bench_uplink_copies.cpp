@@ -0,0 +1,112 @@
+/**
+ * @file bench_uplink_copies.cpp
+ * @brief Bytes copied per uploaded byte: string envelope pipeline vs the IoChain path (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ *
+ * The string path replays what a 1 KB upload chunk went through before: the chunk copied
+ * into a std::string, base64 into another, that copied into SecuredMessage, again into
+ * the HMAC input, again into the JSON document, and the document serialized. The chain
+ * path is sealEnvelope() over the chunk wrapped in place. Copies are counted per byte of
+ * payload and per byte that reaches the socket.
+ */
+
+#include "io_buf.hpp"
+#include "secure_envelope.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+static double nowSec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint8_t kKey[32] = {7};
+
+static std::string base64(const std::string& in) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    for (; i + 3 <= in.size(); i += 3) {
+        uint32_t v = ((uint8_t)in[i] << 16) | ((uint8_t)in[i + 1] << 8) | (uint8_t)in[i + 2];
+        for (int k = 3; k >= 0; --k) out += b64[(v >> (6 * k)) & 0x3F];
+    }
+    if (i < in.size()) {
+        uint32_t v = (uint8_t)in[i] << 16;
+        if (i + 1 < in.size()) v |= (uint8_t)in[i + 1] << 8;
+        out += b64[v >> 18];
+        out += b64[(v >> 12) & 0x3F];
+        out += i + 1 < in.size() ? b64[(v >> 6) & 0x3F] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// Returns bytes copied; wire gets the serialized envelope length
+static uint64_t stringPipeline(const uint8_t* data, size_t len, uint32_t nonce, HmacSha256& hmac, size_t& wire) {
+    uint64_t copied = 0;
+    std::string chunk((const char*)data, len);            // uplink: chunk_data
+    copied += chunk.size();
+    std::string text = base64(chunk);                     // simulateEncryption
+    copied += text.size();
+    std::string payload = text;                           // secured_msg.payload
+    copied += payload.size();
+    std::string input = std::to_string(nonce) + std::to_string(nonce * 3) + "0" + payload;   // hmac_input
+    copied += input.size();
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    hmac.compute((const uint8_t*)input.data(), input.size(), mac);
+    char hex[2 * SHA256_DIGEST_SIZE + 1];
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; ++i) snprintf(hex + 2 * i, 3, "%02x", mac[i]);
+    std::string doc_payload = payload;                    // doc["payload"] = secured_msg.payload
+    copied += doc_payload.size();
+    std::string json = "{\"nonce\":" + std::to_string(nonce) + ",\"timestamp\":" + std::to_string(nonce * 3) +
+                       ",\"encrypted\":false,\"payload\":\"" + doc_payload + "\",\"mac\":\"" + hex + "\"}";   // serializeJson
+    copied += json.size();
+    wire = json.size();
+    return copied;
+}
+
+int main(int argc, char** argv) {
+    size_t chunks = argc > 1 ? (size_t)atol(argv[1]) : 20000;
+    const size_t CHUNK = 1024;
+    std::vector<uint8_t> data(CHUNK * 16);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (uint8_t)(i * 131 + 17);
+    HmacSha256 hmac(kKey, sizeof(kKey), Sha256Backend::PORTABLE);
+
+    uint64_t str_copied = 0, str_wire = 0;
+    double t0 = nowSec();
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t wire = 0;
+        str_copied += stringPipeline(&data[(c % 16) * CHUNK], CHUNK, (uint32_t)c, hmac, wire);
+        str_wire += wire;
+    }
+    double str_time = nowSec() - t0;
+
+    IoBufPool pool(2048, 4);
+    t0 = nowSec();
+    for (size_t c = 0; c < chunks; ++c) {
+        IoChain chunk(&pool);
+        chunk.append(IoBuf::wrap(&data[(c % 16) * CHUNK], CHUNK));
+        IoChain env(&pool);
+        if (!sealEnvelope(chunk, (uint32_t)c, (uint32_t)c * 3, false, hmac, env)) {
+            fprintf(stderr, "seal failed\n");
+            return 1;
+        }
+        pool.countSent(env.length());
+    }
+    double chain_time = nowSec() - t0;
+    const IoBufStats& s = pool.stats();
+
+    double payload_bytes = (double)chunks * CHUNK;
+    printf("%zu chunks of %zu bytes\n", chunks, CHUNK);
+    printf("%-8s %12s %14s %14s %10s\n", "path", "wire bytes", "copies/payload", "copies/wire", "MB/s");
+    printf("%-8s %12llu %14.2f %14.2f %10.1f\n", "string", (unsigned long long)str_wire,
+           str_copied / payload_bytes, (double)str_copied / str_wire, payload_bytes / str_time / 1e6);
+    printf("%-8s %12llu %14.2f %14.2f %10.1f\n", "chain", (unsigned long long)s.bytes_sent,
+           s.bytes_copied / payload_bytes, (double)s.bytes_copied / s.bytes_sent, payload_bytes / chain_time / 1e6);
+    printf("pool: %u allocations, %u overflow, peak %u blocks in use\n",
+           s.allocations, s.overflow, s.peak_in_use);
+    return 0;
+}
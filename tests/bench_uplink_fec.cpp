@@ -0,0 +1,55 @@
+/**
+ * @file bench_uplink_fec.cpp
+ * @brief Upload goodput and completion time, FEC groups vs plain retransmission on a lossy link (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ *
+ * Runs the same chunks through both senders in lossy_link.hpp at a range of request
+ * and reply loss rates, averaged over seeds. Time is simulated: 600 ms round trip,
+ * 64 kbit/s up, 2 s timeout, 60 s to the next upload cycle after a failed one.
+ * Goodput counts each chunk once, however often it reached the server.
+ */
+
+#include "lossy_link.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 400;
+    uint32_t seeds = argc > 2 ? (uint32_t)atol(argv[2]) : 20;
+    auto chunks = makeChunks(count);
+    uint64_t payload = 0;
+    for (const auto& c : chunks) payload += c.size();
+
+    printf("%zu chunks (%.0f KB), %u seeds, FEC groups of %u\n\n", count, payload / 1024.0, seeds,
+           (unsigned)FecConfig().group);
+    printf("%6s %6s | %9s %9s %7s %6s | %9s %9s %7s %6s %7s\n", "req", "reply", "retx s", "B/s", "posts", "dups",
+           "fec s", "B/s", "posts", "dups", "parity");
+    const double losses[][2] = {{0.0, 0.0}, {0.02, 0.02}, {0.05, 0.02}, {0.10, 0.02}, {0.10, 0.10},
+                                {0.20, 0.05}, {0.30, 0.10}};
+    for (const auto& loss : losses) {
+        double retx_s = 0, fec_s = 0, retx_posts = 0, fec_posts = 0, retx_dups = 0, fec_dups = 0, parity = 0;
+        for (uint32_t seed = 1; seed <= seeds; ++seed) {
+            LossyLinkOptions opts;
+            opts.request_loss = loss[0];
+            opts.response_loss = loss[1];
+            opts.seed = seed;
+            UplinkRun retx = runRetransmit(chunks, opts);
+            UplinkFec fec;
+            UplinkRun coded = runFec(chunks, opts, FecConfig(), &fec);
+            retx_s += retx.elapsed_ms / 1000.0;
+            fec_s += coded.elapsed_ms / 1000.0;
+            retx_posts += retx.posts;
+            fec_posts += coded.posts;
+            retx_dups += retx.duplicates;
+            fec_dups += coded.duplicates;
+            parity += fec.stats().parity_sent;
+        }
+        retx_s /= seeds;
+        fec_s /= seeds;
+        printf("%5.0f%% %5.0f%% | %9.0f %9.0f %7.0f %6.1f | %9.0f %9.0f %7.0f %6.1f %7.1f\n", loss[0] * 100,
+               loss[1] * 100, retx_s, payload / retx_s, retx_posts / seeds, retx_dups / seeds, fec_s,
+               payload / fec_s, fec_posts / seeds, fec_dups / seeds, parity / seeds);
+    }
+    return 0;
+}
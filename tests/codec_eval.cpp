@@ -0,0 +1,348 @@
+/**
+ * @file codec_eval.cpp
+ * @brief Runs every uplink codec configuration over recorded sample corpora (not a test; run by hand)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ *
+ * Usage: codec_eval [--batch 16,32,64] [--csv out.csv] corpus...
+ *
+ * A corpus is either a DataStorage CSV dump (ts,reg,value per line) or a binary trace:
+ * a stream of 'EW' uplink batches as captured by the cloud, or packed 9-byte
+ * [ts u32][reg u8][value f32] records. Every codec/parameter set is run at every batch
+ * size; the table (and optional CSV) reports ratio, encode/decode speed, working RAM
+ * and worst reconstruction error. cpp-esp/codec_pareto.py turns the CSV into per-batch
+ * Pareto charts.
+ */
+
+#include "uplink_codec.hpp"
+#include "log_segment.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum class Base { RAW, DELTA_Q, AGGREGATE, FRAME };
+
+struct Candidate {
+    std::string name;
+    Base base;
+    float step;          // DELTA_Q only
+    bool lzss;           // LZSS pass over the encoded batch
+};
+
+struct Result {
+    std::string corpus;
+    std::string codec;
+    size_t batch = 0;
+    size_t samples = 0;
+    size_t raw_bytes = 0;      // count x 9-byte RAW samples
+    size_t encoded_bytes = 0;
+    double encode_mbps = 0;    // of raw sample bytes
+    double decode_mbps = 0;
+    size_t enc_ram = 0;        // largest encoder working set for one batch
+    size_t dec_ram = 0;
+    double max_abs_err = 0;
+    bool summary = false;      // AGGREGATE keeps per-register statistics, not samples
+    bool ok = true;
+};
+
+double nowSec() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t getU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool loadCsv(const std::string& path, std::vector<Sample>& out) {
+    std::ifstream in(path);
+    if (!in) return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        unsigned long ts;
+        unsigned reg;
+        float value;
+        // Header or malformed lines are skipped
+        if (sscanf(line.c_str(), "%lu,%u,%f", &ts, &reg, &value) != 3) continue;
+        out.push_back(Sample{(uint32_t)ts, (uint8_t)reg, value});
+    }
+    return true;
+}
+
+bool loadBinary(const std::string& path, std::vector<Sample>& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() >= 2 && data[0] == 'E' && data[1] == 'W') {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            DecodedBatch b;
+            size_t used = 0;
+            if (!decodeBatch(data.data() + pos, data.size() - pos, b, used)) {
+                fprintf(stderr, "%s: malformed batch at offset %zu, stopping\n", path.c_str(), pos);
+                break;
+            }
+            out.insert(out.end(), b.samples.begin(), b.samples.end());
+            pos += used;
+        }
+        return true;
+    }
+    for (size_t pos = 0; pos + UPLINK_RAW_SAMPLE_SIZE <= data.size(); pos += UPLINK_RAW_SAMPLE_SIZE) {
+        Sample s;
+        s.timestamp = getU32(&data[pos]);
+        s.reg_addr = data[pos + 4];
+        uint32_t bits = getU32(&data[pos + 5]);
+        memcpy(&s.value, &bits, sizeof(s.value));
+        out.push_back(s);
+    }
+    return true;
+}
+
+bool loadCorpus(const std::string& path, std::vector<Sample>& out) {
+    bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    return csv ? loadCsv(path, out) : loadBinary(path, out);
+}
+
+std::vector<Candidate> candidates() {
+    std::vector<Candidate> out;
+    const float steps[] = {0.001f, 0.01f, 0.1f, 0.5f, 1.0f};
+    for (bool lzss : {false, true}) {
+        const char* suffix = lzss ? "+lzss" : "";
+        out.push_back({std::string("raw") + suffix, Base::RAW, 0.0f, lzss});
+        out.push_back({std::string("frame") + suffix, Base::FRAME, 0.0f, lzss});
+        for (float step : steps) {
+            char name[48];
+            snprintf(name, sizeof(name), "delta_q(%g)%s", step, suffix);
+            out.push_back({name, Base::DELTA_Q, step, lzss});
+        }
+    }
+    out.push_back({"aggregate", Base::AGGREGATE, 0.0f, false});
+    return out;
+}
+
+// LZSS frames carry the uncompressed length so the decoder knows how much to produce;
+// the top bit marks a batch stored as-is because it did not shrink
+constexpr size_t LZSS_FRAME_OVERHEAD = 2;
+constexpr uint16_t LZSS_FRAME_STORED = 0x8000;
+
+void encodeOne(const Candidate& c, const Sample* s, size_t n, LzssEncoder* lzss,
+               std::vector<uint8_t>& batch, std::vector<uint8_t>& out) {
+    batch.clear();
+    switch (c.base) {
+        case Base::RAW: encodeRawBatch(s, n, batch); break;
+        case Base::DELTA_Q: encodeDeltaQBatch(s, n, c.step, batch); break;
+        case Base::FRAME:
+            // Registers outside the frame map leave the batch short; reported as failed
+            if (encodeFrameBatch(s, n, SIZE_MAX, batch) != n) batch.clear();
+            break;
+        case Base::AGGREGATE: {
+            SampleAggregate agg;
+            for (size_t i = 0; i < n; ++i) agg.add(s[i]);
+            encodeAggregateBatch(agg, batch);
+            break;
+        }
+    }
+    if (!c.lzss) {
+        out = batch;
+        return;
+    }
+    out.clear();
+    if (batch.size() > LzssEncoder::MAX_INPUT) return;   // caller marks the run as failed
+    out.resize(LZSS_FRAME_OVERHEAD + batch.size());
+    uint16_t frame = (uint16_t)batch.size();
+    size_t z = lzss->compress(batch.data(), batch.size(), out.data() + LZSS_FRAME_OVERHEAD, batch.size() - 1);
+    if (z == 0) {
+        memcpy(out.data() + LZSS_FRAME_OVERHEAD, batch.data(), batch.size());
+        z = batch.size();
+        frame |= LZSS_FRAME_STORED;
+    }
+    out[0] = (uint8_t)(frame & 0xFF);
+    out[1] = (uint8_t)(frame >> 8);
+    out.resize(LZSS_FRAME_OVERHEAD + z);
+}
+
+bool decodeOne(const Candidate& c, const std::vector<uint8_t>& enc, std::vector<uint8_t>& scratch, DecodedBatch& out) {
+    const uint8_t* data = enc.data();
+    size_t len = enc.size();
+    if (c.lzss) {
+        if (len < LZSS_FRAME_OVERHEAD) return false;
+        uint16_t frame = (uint16_t)(enc[0] | (enc[1] << 8));
+        data += LZSS_FRAME_OVERHEAD;
+        len -= LZSS_FRAME_OVERHEAD;
+        if (!(frame & LZSS_FRAME_STORED)) {
+            size_t raw_len = frame;
+            scratch.resize(raw_len);
+            if (!lzssDecompress(data, len, scratch.data(), raw_len)) return false;
+            data = scratch.data();
+            len = raw_len;
+        }
+    }
+    size_t used = 0;
+    out = DecodedBatch();
+    return decodeBatch(data, len, out, used) && used == len;
+}
+
+Result evaluate(const std::string& corpus, const std::vector<Sample>& samples, const Candidate& c, size_t batch) {
+    Result r;
+    r.corpus = corpus;
+    r.codec = c.name;
+    r.batch = batch;
+    r.samples = samples.size();
+    r.raw_bytes = samples.size() * UPLINK_RAW_SAMPLE_SIZE;
+    r.summary = c.base == Base::AGGREGATE;
+
+    std::unique_ptr<LzssEncoder> lzss(c.lzss ? new LzssEncoder() : nullptr);
+    std::vector<uint8_t> scratch, enc;
+    std::vector<std::vector<uint8_t>> encoded;
+
+    // Correctness pass: sizes, working sets, reconstruction error
+    for (size_t i = 0; i < samples.size(); i += batch) {
+        size_t n = std::min(batch, samples.size() - i);
+        encodeOne(c, &samples[i], n, lzss.get(), scratch, enc);
+        if (enc.empty()) {
+            r.ok = false;
+            return r;
+        }
+        r.encoded_bytes += enc.size();
+        size_t enc_ram = scratch.capacity() + (c.lzss ? sizeof(LzssEncoder) + enc.capacity() : 0) +
+                         (r.summary ? sizeof(SampleAggregate) : 0);
+        r.enc_ram = std::max(r.enc_ram, enc_ram);
+
+        DecodedBatch d;
+        std::vector<uint8_t> raw;
+        if (!decodeOne(c, enc, raw, d)) {
+            r.ok = false;
+            return r;
+        }
+        size_t dec_ram = raw.capacity() + d.samples.capacity() * sizeof(Sample) +
+                         d.aggregates.capacity() * sizeof(AggregateEntry);
+        r.dec_ram = std::max(r.dec_ram, dec_ram);
+        if (!r.summary) {
+            if (d.samples.size() != n) {
+                r.ok = false;
+                return r;
+            }
+            for (size_t k = 0; k < n; ++k) {
+                const Sample& a = samples[i + k];
+                const Sample& b = d.samples[k];
+                if (a.timestamp != b.timestamp || a.reg_addr != b.reg_addr) r.ok = false;
+                r.max_abs_err = std::max(r.max_abs_err, (double)std::fabs(a.value - b.value));
+            }
+        }
+        encoded.push_back(enc);
+    }
+
+    // Timing passes: repeat until each side has run for at least 50 ms
+    const double min_time = 0.05;
+    size_t reps = 0;
+    double t0 = nowSec(), t = 0;
+    do {
+        for (size_t i = 0; i < samples.size(); i += batch) {
+            encodeOne(c, &samples[i], std::min(batch, samples.size() - i), lzss.get(), scratch, enc);
+        }
+        ++reps;
+        t = nowSec() - t0;
+    } while (t < min_time);
+    r.encode_mbps = (double)r.raw_bytes * reps / t / 1e6;
+
+    reps = 0;
+    t0 = nowSec();
+    DecodedBatch d;
+    std::vector<uint8_t> raw;
+    do {
+        for (const auto& e : encoded) decodeOne(c, e, raw, d);
+        ++reps;
+        t = nowSec() - t0;
+    } while (t < min_time);
+    r.decode_mbps = (double)r.raw_bytes * reps / t / 1e6;
+    return r;
+}
+
+std::vector<size_t> parseBatches(const char* arg) {
+    std::vector<size_t> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        long v = atol(item.c_str());
+        if (v > 0 && v <= 0xFFFF) out.push_back((size_t)v);
+    }
+    return out;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // Defaults bracket the packetizer's batch sizes (80 lossy, 113 raw per 1 KB chunk)
+    std::vector<size_t> batches = {16, 32, 64, 80, 113, 256};
+    std::string csv_path;
+    std::vector<std::string> corpora;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+            batches = parseBatches(argv[++i]);
+        } else if (!strcmp(argv[i], "--csv") && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else {
+            corpora.push_back(argv[i]);
+        }
+    }
+    if (corpora.empty() || batches.empty()) {
+        fprintf(stderr, "usage: %s [--batch 16,32,64] [--csv out.csv] corpus.csv|trace.bin...\n", argv[0]);
+        return 2;
+    }
+
+    FILE* csv = nullptr;
+    if (!csv_path.empty()) {
+        csv = fopen(csv_path.c_str(), "w");
+        if (!csv) {
+            fprintf(stderr, "cannot write %s\n", csv_path.c_str());
+            return 1;
+        }
+        fprintf(csv, "corpus,codec,batch,samples,raw_bytes,encoded_bytes,ratio,bytes_per_sample,"
+                     "encode_mbps,decode_mbps,enc_ram,dec_ram,max_abs_err,summary,ok\n");
+    }
+
+    const std::vector<Candidate> cands = candidates();
+    for (const auto& path : corpora) {
+        std::vector<Sample> samples;
+        if (!loadCorpus(path, samples) || samples.empty()) {
+            fprintf(stderr, "%s: no samples loaded\n", path.c_str());
+            continue;
+        }
+        printf("\n%s: %zu samples\n", path.c_str(), samples.size());
+        printf("%-18s %6s %7s %8s %9s %9s %8s %8s %10s\n",
+               "codec", "batch", "ratio", "B/sample", "enc MB/s", "dec MB/s", "enc RAM", "dec RAM", "max err");
+        for (size_t batch : batches) {
+            for (const auto& c : cands) {
+                Result r = evaluate(path, samples, c, batch);
+                double ratio = r.raw_bytes ? (double)r.encoded_bytes / r.raw_bytes : 0;
+                double per_sample = r.samples ? (double)r.encoded_bytes / r.samples : 0;
+                if (!r.ok) {
+                    printf("%-18s %6zu %7s\n", r.codec.c_str(), batch, "n/a");
+                } else {
+                    printf("%-18s %6zu %7.3f %8.2f %9.1f %9.1f %8zu %8zu %10s\n", r.codec.c_str(), batch, ratio,
+                           per_sample, r.encode_mbps, r.decode_mbps, r.enc_ram, r.dec_ram,
+                           r.summary ? "summary" : std::to_string(r.max_abs_err).substr(0, 10).c_str());
+                }
+                if (csv) {
+                    fprintf(csv, "%s,%s,%zu,%zu,%zu,%zu,%.5f,%.3f,%.2f,%.2f,%zu,%zu,%.6g,%d,%d\n",
+                            r.corpus.c_str(), r.codec.c_str(), batch, r.samples, r.raw_bytes, r.encoded_bytes,
+                            ratio, per_sample, r.encode_mbps, r.decode_mbps, r.enc_ram, r.dec_ram,
+                            r.max_abs_err, r.summary ? 1 : 0, r.ok ? 1 : 0);
+                }
+            }
+        }
+    }
+    if (csv) fclose(csv);
+    return 0;
+}
@@ -0,0 +1,247 @@
+#pragma once
+// Simulated stop-and-wait uplink for the FEC tests and bench_uplink_fec: each POST is
+// lost on the way out or its reply lost on the way back, independently, and costs a
+// round trip plus serialization when answered or the full timeout when not. Time is
+// simulated, so runs are fast and repeatable for a seed.
+//
+// Two senders run over it: the plain retransmission loop of chunkAndUpload (three
+// attempts per chunk, then the rest waits for the next upload cycle) and UplinkFec
+// groups. FecServerModel plays the server's side of the shards the way app.py does.
+
+#include "uplink_fec.hpp"
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+struct LossyLinkOptions {
+    double request_loss = 0.10;
+    double response_loss = 0.02;
+    uint32_t rtt_ms = 600;          // cellular backhaul
+    uint32_t timeout_ms = 2000;
+    uint32_t bytes_per_ms = 8;      // 64 kbit/s up
+    uint32_t cycle_ms = 60000;      // next upload cycle after a failed one
+    uint32_t seed = 1;
+};
+
+class LossyLink {
+public:
+    explicit LossyLink(const LossyLinkOptions& opts) : opts_(opts), rng_(opts.seed) {}
+
+    struct Outcome {
+        bool delivered;
+        bool answered;
+    };
+
+    // A secured POST of `payload` bytes: base64 plus envelope and HTTP headers
+    Outcome post(size_t payload) {
+        size_t bytes = payload * 4 / 3 + 500;
+        posts_++;
+        bytes_ += bytes;
+        Outcome o;
+        o.delivered = uniform_(rng_) >= opts_.request_loss;
+        o.answered = o.delivered && uniform_(rng_) >= opts_.response_loss;
+        elapsed_ms_ += o.answered ? opts_.rtt_ms + bytes / opts_.bytes_per_ms : opts_.timeout_ms;
+        return o;
+    }
+    void waitCycle() { elapsed_ms_ += opts_.cycle_ms; }
+
+    const LossyLinkOptions& options() const { return opts_; }
+    uint64_t elapsedMs() const { return elapsed_ms_; }
+    uint32_t posts() const { return posts_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    LossyLinkOptions opts_;
+    std::mt19937 rng_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+    uint64_t elapsed_ms_ = 0;
+    uint32_t posts_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+// Ingests data shards as they arrive and rebuilds the missing ones once any k shards
+// of a group are in. received() lists every chunk ingested, duplicates included.
+class FecServerModel {
+public:
+    FecReply receive(const uint8_t* head, size_t head_len, const uint8_t* body, size_t body_len) {
+        std::vector<uint8_t> shard(head, head + head_len);
+        shard.insert(shard.end(), body, body + body_len);
+        FecReply reply;
+        FecShardHeader h;
+        if (!FecShardHeader::parse(shard.data(), shard.size(), h)) return reply;
+        reply.answered = true;
+        Group& g = groups_[h.group];
+        if (g.done) {
+            reply.complete = true;
+            reply.have = h.k;
+            return reply;
+        }
+        if (g.shards.empty()) {
+            g.k = h.k;
+            g.len = h.shard_len;
+        }
+        std::vector<uint8_t> content(shard.begin() + FecShardHeader::SIZE, shard.end());
+        content.resize(g.len, 0);
+        if (!g.shards.count(h.index)) {
+            g.shards[h.index] = content;
+            if (h.index < g.k) ingest(content);
+        }
+        if (g.shards.size() >= g.k) rebuild(g);
+        reply.complete = g.done;
+        reply.have = (uint8_t)g.shards.size();
+        return reply;
+    }
+
+    const std::vector<std::vector<uint8_t>>& received() const { return received_; }
+    uint32_t rebuilt() const { return rebuilt_; }
+
+private:
+    struct Group {
+        uint8_t k = 0;
+        uint16_t len = 0;
+        bool done = false;
+        std::map<uint8_t, std::vector<uint8_t>> shards;
+    };
+
+    void ingest(const std::vector<uint8_t>& shard) {
+        size_t n = shard[0] | (shard[1] << 8);
+        received_.emplace_back(shard.begin() + UplinkFec::LEN_SIZE, shard.begin() + UplinkFec::LEN_SIZE + n);
+    }
+
+    void rebuild(Group& g) {
+        size_t total = 0;
+        for (auto& s : g.shards) total = (size_t)s.first + 1 > total ? (size_t)s.first + 1 : total;
+        if (total < g.k) total = g.k;
+        std::vector<std::vector<uint8_t>> bufs(total, std::vector<uint8_t>(g.len, 0));
+        std::vector<uint8_t*> ptrs(total);
+        std::unique_ptr<bool[]> present(new bool[total]());
+        for (size_t i = 0; i < total; ++i) ptrs[i] = bufs[i].data();
+        for (auto& s : g.shards) {
+            bufs[s.first] = s.second;
+            ptrs[s.first] = bufs[s.first].data();
+            present[s.first] = true;
+        }
+        if (!ReedSolomon::reconstruct(ptrs.data(), present.get(), g.k, total, g.len)) return;
+        for (size_t i = 0; i < g.k; ++i) {
+            if (present[i]) continue;
+            ingest(bufs[i]);
+            rebuilt_++;
+        }
+        g.done = true;
+        g.shards.clear();
+    }
+
+    std::map<uint32_t, Group> groups_;
+    std::vector<std::vector<uint8_t>> received_;
+    uint32_t rebuilt_ = 0;
+};
+
+struct UplinkRun {
+    uint64_t elapsed_ms = 0;
+    uint32_t posts = 0;
+    uint64_t bytes = 0;
+    size_t received = 0;      // chunks the server ingested
+    size_t duplicates = 0;    // of which already seen
+    uint32_t cycles = 1;      // upload cycles until everything was delivered
+};
+
+static inline UplinkRun summarizeRun(const LossyLink& link, const std::vector<std::vector<uint8_t>>& received,
+                                     uint32_t cycles) {
+    UplinkRun run;
+    run.elapsed_ms = link.elapsedMs();
+    run.posts = link.posts();
+    run.bytes = link.bytes();
+    run.received = received.size();
+    std::set<std::vector<uint8_t>> seen;
+    for (const auto& c : received) {
+        if (!seen.insert(c).second) run.duplicates++;
+    }
+    run.cycles = cycles;
+    return run;
+}
+
+// chunkAndUpload without FEC: each chunk until answered, three attempts, then the
+// rest of the cycle is abandoned and resumed from that chunk next cycle
+static inline UplinkRun runRetransmit(const std::vector<std::vector<uint8_t>>& chunks, const LossyLinkOptions& opts) {
+    LossyLink link(opts);
+    std::vector<std::vector<uint8_t>> received;
+    uint32_t cycles = 1;
+    size_t next = 0;
+    while (next < chunks.size()) {
+        bool ok = false;
+        for (int attempt = 0; attempt < 3 && !ok; ++attempt) {
+            LossyLink::Outcome o = link.post(chunks[next].size());
+            if (o.delivered) received.push_back(chunks[next]);
+            ok = o.answered;
+        }
+        if (ok) {
+            ++next;
+        } else {
+            link.waitCycle();
+            cycles++;
+        }
+    }
+    return summarizeRun(link, received, cycles);
+}
+
+// The same chunks in UplinkFec groups; a failed group is held and resent under the
+// same ID next cycle, as chunkAndUploadFec_ does
+static inline UplinkRun runFec(const std::vector<std::vector<uint8_t>>& chunks, const LossyLinkOptions& opts,
+                               const FecConfig& config, UplinkFec* fec_out = nullptr) {
+    LossyLink link(opts);
+    FecServerModel server;
+    UplinkFec fec(config);
+    uint32_t cycles = 1;
+    size_t next = 0;
+    auto send = [&](const uint8_t* head, size_t head_len, const uint8_t* body, size_t body_len) {
+        LossyLink::Outcome o = link.post(head_len + body_len);
+        FecReply reply;
+        if (o.delivered) reply = server.receive(head, head_len, body, body_len);
+        if (!o.answered) reply = FecReply();
+        return reply;
+    };
+    while (next < chunks.size()) {
+        size_t k = chunks.size() - next < config.group ? chunks.size() - next : config.group;
+        if (fec.held()) {
+            if (fec.resendHeld(send)) {
+                next += k;
+            } else {
+                link.waitCycle();
+                cycles++;
+            }
+            continue;
+        }
+        std::vector<const uint8_t*> ptrs;
+        std::vector<size_t> lens;
+        for (size_t i = 0; i < k; ++i) {
+            ptrs.push_back(chunks[next + i].data());
+            lens.push_back(chunks[next + i].size());
+        }
+        if (fec.sendGroup(ptrs.data(), lens.data(), k, send)) {
+            next += k;
+        } else {
+            link.waitCycle();
+            cycles++;
+        }
+    }
+    if (fec_out) *fec_out = fec;
+    return summarizeRun(link, server.received(), cycles);
+}
+
+// Distinct 1 KB-ish chunks (the last of each eight shorter, like a cycle's tail)
+static inline std::vector<std::vector<uint8_t>> makeChunks(size_t n, uint32_t seed = 7) {
+    std::mt19937 rng(seed);
+    std::vector<std::vector<uint8_t>> out;
+    for (size_t i = 0; i < n; ++i) {
+        std::vector<uint8_t> c(i % 8 == 7 ? 300 + i % 200 : 1000 + i % 24);
+        for (auto& b : c) b = (uint8_t)rng();
+        c[0] = (uint8_t)i;
+        c[1] = (uint8_t)(i >> 8);
+        out.push_back(c);
+    }
+    return out;
+}
@@ -0,0 +1,242 @@
+/**
+ * @file modbus_tcp_loopback.hpp
+ * @brief Loopback Modbus TCP stand-in shared by the Modbus TCP tests and benches
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Serves 0x03/0x04 reads, 0x06 writes and 0x17 read/writes over a 64K register file on
+// 127.0.0.1.
+// Every reply is held for latency_us after its request arrived, independently of the
+// others, like a gateway at the far end of a network round trip, so requests that
+// are pipelined overlap their waits. Several connections are served at once (a
+// client's hedge connection next to its main one).
+class LoopbackModbusServer {
+public:
+    struct Options {
+        uint32_t latency_us = 0;
+        bool reverse = false;        // send replies that are due together newest first
+        uint32_t drop_every = 0;     // never answer every Nth request
+        uint32_t close_after = 0;    // drop the connection after this many replies
+        uint32_t tail_every = 0;     // hold every Nth request's reply for tail_us more
+        uint32_t tail_us = 0;
+        bool no_read_write = false;  // answer 0x17 with exception 0x01, like gateways without it
+    };
+
+    LoopbackModbusServer() : LoopbackModbusServer(Options()) {}
+    explicit LoopbackModbusServer(const Options& opts) : opts_(opts), regs_(65536) {
+        for (size_t i = 0; i < regs_.size(); ++i) regs_[i] = expected((uint16_t)i);
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(listen_fd_, (sockaddr*)&addr, sizeof(addr));
+        listen(listen_fd_, 4);
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd_, (sockaddr*)&addr, &len);
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this] { loop(); });
+    }
+
+    ~LoopbackModbusServer() {
+        stop_ = true;
+        thread_.join();
+        for (Client& c : clients_) close(c.fd);
+        close(listen_fd_);
+    }
+
+    static uint16_t expected(uint16_t reg) { return (uint16_t)(reg * 7u + 3u); }
+
+    uint16_t port() const { return port_; }
+    uint32_t requests() const { return requests_; }
+    uint32_t connections() const { return connections_; }
+    uint16_t reg(uint16_t addr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return regs_[addr];
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Pending {
+        Clock::time_point due;
+        std::vector<uint8_t> frame;
+    };
+    struct Client {
+        int fd = -1;
+        std::vector<uint8_t> rx;
+        std::vector<Pending> pending;   // in arrival order; tails make the due times uneven
+        uint32_t replies = 0;
+    };
+
+    void loop() {
+        uint8_t buf[4096];
+        while (!stop_) {
+            fd_set rfds;
+            FD_ZERO(&rfds);
+            FD_SET(listen_fd_, &rfds);
+            int max_fd = listen_fd_;
+            auto wait = std::chrono::microseconds(20000);
+            for (Client& c : clients_) {
+                FD_SET(c.fd, &rfds);
+                max_fd = std::max(max_fd, c.fd);
+                for (const Pending& p : c.pending) {
+                    auto until = std::chrono::duration_cast<std::chrono::microseconds>(p.due - Clock::now());
+                    wait = std::max(std::chrono::microseconds(0), std::min(wait, until));
+                }
+            }
+            timeval tv;
+            tv.tv_sec = 0;
+            tv.tv_usec = (long)wait.count();
+            int rc = select(max_fd + 1, &rfds, nullptr, nullptr, &tv);
+            if (rc > 0 && FD_ISSET(listen_fd_, &rfds)) {
+                int fd = accept(listen_fd_, nullptr, nullptr);
+                if (fd >= 0) {
+                    int one = 1;
+                    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    Client c;
+                    c.fd = fd;
+                    clients_.push_back(std::move(c));
+                    connections_++;
+                }
+            }
+            for (size_t i = 0; rc > 0 && i < clients_.size(); ++i) {
+                Client& c = clients_[i];
+                if (!FD_ISSET(c.fd, &rfds)) continue;
+                ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+                if (n <= 0) {
+                    c.rx.clear();
+                    dropClient(c);
+                } else {
+                    c.rx.insert(c.rx.end(), buf, buf + n);
+                    parse(c);
+                }
+            }
+            for (Client& c : clients_) flushDue(c);
+            clients_.erase(std::remove_if(clients_.begin(), clients_.end(), [](const Client& c) { return c.fd < 0; }),
+                           clients_.end());
+        }
+    }
+
+    void dropClient(Client& c) {
+        close(c.fd);
+        c.fd = -1;
+        c.pending.clear();
+    }
+
+    void parse(Client& c) {
+        std::vector<uint8_t>& rx = c.rx;
+        size_t pos = 0;
+        while (rx.size() - pos >= 7) {
+            uint16_t length = (uint16_t)((rx[pos + 4] << 8) | rx[pos + 5]);
+            if (rx.size() - pos < 6u + length) break;
+            std::vector<uint8_t> req(rx.begin() + pos, rx.begin() + pos + 6 + length);
+            pos += 6u + length;
+            uint32_t n = ++requests_;
+            if (opts_.drop_every && n % opts_.drop_every == 0) continue;
+            uint32_t latency = opts_.latency_us;
+            if (opts_.tail_every && n % opts_.tail_every == 0) latency += opts_.tail_us;
+            Pending p;
+            p.due = Clock::now() + std::chrono::microseconds(latency);
+            p.frame = reply(req);
+            c.pending.push_back(std::move(p));
+        }
+        rx.erase(rx.begin(), rx.begin() + pos);
+    }
+
+    std::vector<uint8_t> reply(const std::vector<uint8_t>& req) {
+        std::vector<uint8_t> out(req.begin(), req.begin() + 7);
+        uint8_t fn = req[7];
+        if (req.size() < 12) return exception(out, fn, 0x01);
+        uint16_t a = (uint16_t)((req[8] << 8) | req[9]);
+        uint16_t b = (uint16_t)((req[10] << 8) | req[11]);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fn == 0x03 || fn == 0x04) {
+            if (b == 0 || b > 125) return exception(out, fn, 0x03);
+            if (a + b > 0x10000) return exception(out, fn, 0x02);
+            out.push_back(fn);
+            out.push_back((uint8_t)(b * 2));
+            for (uint16_t i = 0; i < b; ++i) {
+                out.push_back(regs_[a + i] >> 8);
+                out.push_back(regs_[a + i] & 0xFF);
+            }
+        } else if (fn == 0x06) {
+            regs_[a] = b;
+            out.insert(out.end(), req.begin() + 7, req.begin() + 12);
+        } else if (fn == 0x17 && !opts_.no_read_write) {
+            if (req.size() < 17) return exception(out, fn, 0x03);
+            uint16_t ws = (uint16_t)((req[12] << 8) | req[13]);
+            uint16_t wc = (uint16_t)((req[14] << 8) | req[15]);
+            if (b == 0 || b > 125 || wc == 0 || req.size() < 17u + 2 * wc) return exception(out, fn, 0x03);
+            if (a + b > 0x10000 || ws + wc > 0x10000) return exception(out, fn, 0x02);
+            // The write happens before the read
+            for (uint16_t i = 0; i < wc; ++i) regs_[ws + i] = (uint16_t)((req[17 + 2 * i] << 8) | req[18 + 2 * i]);
+            out.push_back(fn);
+            out.push_back((uint8_t)(b * 2));
+            for (uint16_t i = 0; i < b; ++i) {
+                out.push_back(regs_[a + i] >> 8);
+                out.push_back(regs_[a + i] & 0xFF);
+            }
+        } else {
+            return exception(out, fn, 0x01);
+        }
+        out[4] = (uint8_t)((out.size() - 6) >> 8);
+        out[5] = (uint8_t)((out.size() - 6) & 0xFF);
+        return out;
+    }
+
+    static std::vector<uint8_t> exception(std::vector<uint8_t> out, uint8_t fn, uint8_t code) {
+        out.push_back(fn | 0x80);
+        out.push_back(code);
+        out[4] = 0;
+        out[5] = 3;
+        return out;
+    }
+
+    void flushDue(Client& c) {
+        if (c.fd < 0) return;
+        auto now = Clock::now();
+        std::vector<Pending> due, later;
+        for (Pending& p : c.pending) (p.due <= now ? due : later).push_back(std::move(p));
+        c.pending.swap(later);
+        if (due.empty()) return;
+        if (opts_.reverse) std::reverse(due.begin(), due.end());
+        std::vector<uint8_t> out;
+        for (const Pending& p : due) out.insert(out.end(), p.frame.begin(), p.frame.end());
+        send(c.fd, out.data(), out.size(), MSG_NOSIGNAL);
+        c.replies += (uint32_t)due.size();
+        if (opts_.close_after && c.replies >= opts_.close_after) dropClient(c);
+    }
+
+    Options opts_;
+    std::vector<uint16_t> regs_;
+    std::mutex mutex_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+    std::vector<Client> clients_;
+    std::atomic<uint32_t> requests_{0};
+    std::atomic<uint32_t> connections_{0};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
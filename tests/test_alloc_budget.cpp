@@ -0,0 +1,217 @@
+/**
+ * @file test_alloc_budget.cpp
+ * @brief Heap allocation budgets for the firmware's steady-state hot paths
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "alloc_counter.hpp"
+#include "modbus_tcp_loopback.hpp"
+#include "frame_ring.hpp"
+#include "modbus_tcp.hpp"
+#include "secure_envelope.hpp"
+#include "sha256_engine.hpp"
+#include "uplink_codec.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+// Each path runs once to warm up (pools filled, vectors at capacity, keys absorbed),
+// then once under the counter. Budgets are the steady state today: a change that adds
+// an allocation to one of these paths fails here and has to raise the budget on purpose.
+
+static const uint8_t kPsk[32] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+                                 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32};
+
+static void fillRing(FrameRing& ring, uint32_t cycles) {
+    for (uint32_t c = 0; c < cycles; ++c) {
+        SampleFrame f;
+        f.timestamp = c * 1000;
+        for (uint8_t reg = 0; reg < 10; ++reg) f.set(reg, 230.0f + c * 0.1f + reg);
+        ring.append(f);
+    }
+}
+
+TEST(AllocBudgetTest, CounterSeesNewMallocAndOnlyThisThread) {
+    AllocCounter counter;
+    int* p = new int(7);
+    void* m = malloc(100);
+    std::thread([] { delete[] new char[1 << 20]; }).join();
+    free(m);
+    delete p;
+    const AllocStats& s = counter.stop();
+    // Starting the thread allocates on this thread; the worker's megabyte does not count
+    EXPECT_GE(s.allocations, 2u);
+    EXPECT_GE(s.bytes, sizeof(int) + 100);
+    EXPECT_LT(s.bytes, 1u << 20);
+
+    AllocCounter idle;
+    EXPECT_EQ(idle.stop().allocations, 0u);
+}
+
+// Acquisition: the Modbus TCP part of AcquisitionScheduler::pollTask, which keeps its
+// ModbusRegisterBatch between cycles and reads gains without copying register configs
+TEST(AllocBudgetTest, PollCycle) {
+    LoopbackModbusServer server;
+    ModbusTcpClient client("127.0.0.1", server.port(), 1, 1000, 4);
+    ASSERT_TRUE(client.connect());
+    FrameRing ring(6144);
+    ModbusRegisterBatch batch;
+    std::vector<uint8_t> regs = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+
+    auto cycle = [&](uint32_t ts) {
+        batch.assign(regs.data(), regs.size());
+        client.readBatch(batch.reads(), batch.size());
+        SampleFrame frame;
+        frame.timestamp = ts;
+        size_t ok = 0;
+        for (size_t i = 0; i < regs.size(); ++i) {
+            uint16_t raw = 0;
+            if (!batch.value(i, raw)) continue;
+            frame.set(regs[i], raw / 10.0f);
+            ok++;
+        }
+        ring.append(frame);
+        return ok;
+    };
+    ASSERT_EQ(cycle(0), 10u);
+
+    AllocCounter counter;
+    size_t ok = cycle(1000);
+    AllocStats s = counter.stop();
+    ASSERT_EQ(ok, 10u);
+    EXPECT_EQ(s.allocations, 0u) << s.bytes << " bytes";
+
+    // A shorter list after a config update reuses the same storage
+    regs = {0, 2, 4};
+    AllocCounter shorter;
+    ok = cycle(2000);
+    s = shorter.stop();
+    ASSERT_EQ(ok, 3u);
+    EXPECT_EQ(s.allocations, 0u) << s.bytes << " bytes";
+    uint16_t raw = 0;
+    EXPECT_FALSE(batch.value(3, raw));   // past the current list
+}
+
+// Security: sealing one encoded batch into a secured envelope
+TEST(AllocBudgetTest, SecuredMessage) {
+    FrameRing ring(6144);
+    fillRing(ring, 20);
+    std::vector<Sample> samples(ring.samples());
+    uint32_t first = 0;
+    ring.readFromSequence(0, samples.data(), samples.size(), first);
+    std::vector<uint8_t> payload;
+    encodeFrameBatch(samples.data(), samples.size(), 1024, payload);
+
+    IoBufPool pool(2048, 4);
+    HmacSha256 hmac(kPsk, sizeof(kPsk));
+    auto seal = [&](uint32_t nonce) {
+        IoChain body(&pool);
+        body.append(IoBuf::wrap(payload.data(), payload.size()));
+        IoChain envelope(&pool);
+        bool ok = sealEnvelope(body, nonce, 1700000000u + nonce, false, hmac, envelope);
+        return ok ? envelope.length() : 0;
+    };
+    ASSERT_GT(seal(1), 0u);
+
+    AllocCounter counter;
+    size_t len = seal(2);
+    AllocStats s = counter.stop();
+    ASSERT_GT(len, payload.size());
+    // One slice vector for the body chain, one for the envelope chain
+    EXPECT_LE(s.allocations, 2u) << s.bytes << " bytes";
+    EXPECT_LE(s.bytes, 256u);
+}
+
+// Uplink: pending samples read from the ring, encoded in chunk-sized FRAME batches and
+// each chunk sealed. These are the codec and envelope steps of UplinkPacketizer::uploadTask
+// and chunkAndUpload only; the sample buffer, metadata JSON and HTTP request those build
+// around them every cycle are not counted here.
+TEST(AllocBudgetTest, EncodeAndSealChunks) {
+    const size_t CHUNK = 1024;
+    FrameRing ring(6144);
+    std::vector<Sample> samples(1024);
+    std::vector<uint8_t> payload;
+    std::vector<size_t> batch_ends;
+    payload.reserve(8 * 1024);
+    batch_ends.reserve(64);
+    IoBufPool pool(2048, 4);
+    HmacSha256 hmac(kPsk, sizeof(kPsk));
+    uint32_t cursor = 0;
+    uint32_t nonce = 1;
+
+    auto upload = [&]() {
+        uint32_t first = 0;
+        size_t n = ring.readFromSequence(cursor, samples.data(), samples.size(), first);
+        payload.clear();
+        batch_ends.clear();
+        for (size_t i = 0; i < n;) {
+            size_t used = encodeFrameBatch(samples.data() + i, n - i, CHUNK, payload);
+            if (used == 0) break;
+            i += used;
+            batch_ends.push_back(payload.size());
+        }
+        size_t sent = 0, offset = 0;
+        for (size_t end : batch_ends) {
+            IoChain chunk(&pool);
+            chunk.append(IoBuf::wrap(payload.data() + offset, end - offset));
+            IoChain envelope(&pool);
+            if (!sealEnvelope(chunk, nonce++, 1700000000u, false, hmac, envelope)) return (size_t)0;
+            sent += envelope.length();
+            offset = end;
+        }
+        cursor = first + (uint32_t)n;
+        return sent;
+    };
+
+    fillRing(ring, 60);
+    ASSERT_GT(upload(), 0u);
+    fillRing(ring, 60);
+
+    AllocCounter counter;
+    size_t sent = upload();
+    AllocStats s = counter.stop();
+    ASSERT_GT(sent, 0u);
+    ASSERT_GE(batch_ends.size(), 2u);
+    // Two slice vectors per sealed chunk, nothing per sample
+    EXPECT_LE(s.allocations, 2 * batch_ends.size()) << s.bytes << " bytes";
+}
+
+// FOTA: one 16 KB chunk decoded from base64, MAC-checked and added to the image hash
+TEST(AllocBudgetTest, FotaChunk) {
+    std::vector<uint8_t> chunk(16384);
+    for (size_t i = 0; i < chunk.size(); ++i) chunk[i] = (uint8_t)(i * 31 + 7);
+    IoBufPool pool(4096, 16);
+    IoChain raw(&pool), b64(&pool);
+    raw.append(IoBuf::wrap(chunk.data(), chunk.size()));
+    base64AppendChain(raw, b64);
+    std::string text = b64.toString();
+
+    HmacSha256 hmac(kPsk, sizeof(kPsk));
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    hmac.compute(chunk.data(), chunk.size(), mac);
+    char mac_hex[2 * SHA256_DIGEST_SIZE + 1];
+    for (size_t i = 0; i < SHA256_DIGEST_SIZE; ++i) snprintf(mac_hex + 2 * i, 3, "%02X", mac[i]);
+
+    std::vector<uint8_t> decoded(20480);
+    Sha256 image;
+    auto process = [&]() {
+        size_t n = base64Decode(text.data(), text.size(), decoded.data(), decoded.size());
+        if (n != chunk.size() || !hmac.verifyHex(decoded.data(), n, mac_hex)) return false;
+        image.update(decoded.data(), n);
+        return true;
+    };
+    ASSERT_TRUE(process());
+
+    AllocCounter counter;
+    bool ok = process();
+    AllocStats s = counter.stop();
+    ASSERT_TRUE(ok);
+    EXPECT_EQ(s.allocations, 0u) << s.bytes << " bytes";
+
+    EXPECT_TRUE(memcmp(decoded.data(), chunk.data(), chunk.size()) == 0);
+    mac_hex[5] ^= 1;
+    EXPECT_FALSE(hmac.verifyHex(chunk.data(), chunk.size(), mac_hex));
+    EXPECT_EQ(base64Decode(text.data(), text.size(), decoded.data(), 100), 0u);   // does not fit
+}
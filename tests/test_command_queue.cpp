@@ -0,0 +1,138 @@
+/**
+ * @file test_command_queue.cpp
+ * @brief Tests for batched cloud command ordering, expiry and deduplication
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "command_queue.hpp"
+
+static CommandRequest command(uint32_t id, uint8_t priority = 0, uint32_t ttl_s = 0) {
+    CommandRequest c;
+    c.command_id = id;
+    c.action = "write_register";
+    c.target_register = "export_power";
+    c.value = (float)id;
+    c.timestamp = 0;
+    c.nonce = id;
+    c.priority = priority;
+    c.ttl_s = ttl_s;
+    return c;
+}
+
+TEST(CommandQueueTest, PriorityFirstThenArrivalOrder) {
+    CommandQueue q;
+    // A setpoint schedule at priority 0, then an urgent override in the same batch
+    for (uint32_t id = 1; id <= 20; ++id) ASSERT_EQ(q.push(command(id), 0), CommandAdmit::QUEUED);
+    ASSERT_EQ(q.push(command(50, 9), 0), CommandAdmit::QUEUED);
+    ASSERT_EQ(q.push(command(40, 3), 0), CommandAdmit::QUEUED);
+    EXPECT_EQ(q.size(), 22u);
+
+    CommandRequest c;
+    bool expired = true;
+    ASSERT_TRUE(q.pop(0, c, expired));
+    EXPECT_EQ(c.command_id, 50u);
+    EXPECT_FALSE(expired);
+    ASSERT_TRUE(q.pop(0, c, expired));
+    EXPECT_EQ(c.command_id, 40u);
+    for (uint32_t id = 1; id <= 20; ++id) {
+        ASSERT_TRUE(q.pop(0, c, expired));
+        EXPECT_EQ(c.command_id, id);
+    }
+    EXPECT_FALSE(q.pop(0, c, expired));
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(CommandQueueTest, ExpiresCommandsThatWaitPastTheirTtl) {
+    CommandQueue q;
+    const uint32_t now = 0xFFFFF000u;   // deadlines across the millis() wrap
+    q.push(command(1, 0, 10), now);
+    q.push(command(2, 0, 0), now);
+    q.push(command(3, 0, 60), now);
+
+    CommandRequest c;
+    bool expired = false;
+    uint32_t later = now + 30000;
+    ASSERT_TRUE(q.pop(later, c, expired));
+    EXPECT_EQ(c.command_id, 1u);
+    EXPECT_TRUE(expired);
+    ASSERT_TRUE(q.pop(later, c, expired));
+    EXPECT_EQ(c.command_id, 2u);
+    EXPECT_FALSE(expired);   // no TTL
+    ASSERT_TRUE(q.pop(later, c, expired));
+    EXPECT_EQ(c.command_id, 3u);
+    EXPECT_FALSE(expired);
+    EXPECT_EQ(q.expired(), 1u);
+}
+
+TEST(CommandQueueTest, RedeliveredBatchIsNotQueuedTwice) {
+    CommandQueue q;
+    q.push(command(1), 0);
+    q.push(command(2), 0);
+    EXPECT_EQ(q.push(command(2), 0), CommandAdmit::DUPLICATE);   // still queued
+
+    CommandRequest c;
+    bool expired = false;
+    while (q.pop(0, c, expired)) {
+    }
+    // The same batch again after its results were lost
+    EXPECT_EQ(q.push(command(1), 0), CommandAdmit::DUPLICATE);
+    EXPECT_EQ(q.push(command(2), 0), CommandAdmit::DUPLICATE);
+    EXPECT_TRUE(q.empty());
+
+    q.markDone(7);   // rejected on arrival
+    EXPECT_TRUE(q.seen(7));
+    EXPECT_EQ(q.push(command(7), 0), CommandAdmit::DUPLICATE);
+
+    // Only the most recent IDs are remembered
+    for (uint32_t id = 100; id < 100 + CommandQueue::MAX_RECENT_IDS; ++id) q.markDone(id);
+    EXPECT_FALSE(q.seen(1));
+    EXPECT_EQ(q.push(command(1), 0), CommandAdmit::QUEUED);
+}
+
+TEST(CommandQueueTest, RemembersHowARedeliveredCommandFinished) {
+    CommandQueue q;
+    q.push(command(1), 0);
+    q.push(command(2), 0);
+    CommandStatus status;
+    EXPECT_FALSE(q.finished(1, status));   // queued, not run yet
+
+    CommandRequest c;
+    bool expired = false;
+    ASSERT_TRUE(q.pop(0, c, expired));
+    ASSERT_TRUE(q.finished(c.command_id, status));
+    EXPECT_EQ(status, CommandStatus::PENDING);   // running
+    q.markDone(c.command_id, CommandStatus::SUCCESS);
+    ASSERT_TRUE(q.pop(0, c, expired));
+    q.markDone(c.command_id, CommandStatus::TIMEOUT);
+    q.markDone(9, CommandStatus::INVALID_REGISTER);   // rejected on arrival
+
+    ASSERT_TRUE(q.finished(1, status));
+    EXPECT_EQ(status, CommandStatus::SUCCESS);
+    ASSERT_TRUE(q.finished(2, status));
+    EXPECT_EQ(status, CommandStatus::TIMEOUT);
+    ASSERT_TRUE(q.finished(9, status));
+    EXPECT_EQ(status, CommandStatus::INVALID_REGISTER);
+    EXPECT_FALSE(q.finished(3, status));
+}
+
+TEST(CommandQueueTest, SpaceCountsFreeSlots) {
+    CommandQueue q;
+    EXPECT_EQ(q.space(), CommandQueue::MAX_PENDING);
+    for (uint32_t id = 0; id < CommandQueue::MAX_PENDING; ++id) q.push(command(id), 0);
+    EXPECT_EQ(q.space(), 0u);
+    CommandRequest c;
+    bool expired = false;
+    q.pop(0, c, expired);
+    EXPECT_EQ(q.space(), 1u);
+}
+
+TEST(CommandQueueTest, RejectsWhenFull) {
+    CommandQueue q;
+    for (uint32_t id = 0; id < CommandQueue::MAX_PENDING; ++id) {
+        ASSERT_EQ(q.push(command(id), 0), CommandAdmit::QUEUED);
+    }
+    EXPECT_EQ(q.push(command(1000, 255), 0), CommandAdmit::FULL);
+    EXPECT_FALSE(q.seen(1000));   // can be delivered again once there is room
+}
@@ -0,0 +1,141 @@
+/**
+ * @file test_cpu_accounting.cpp
+ * @brief Tests for per-subsystem CPU accounting and per-task run time
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "cpu_accounting.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+static void spinUs(uint64_t us) {
+    uint64_t start = cpuClockUs();
+    volatile uint64_t sink = 0;
+    while (cpuClockUs() - start < us) sink = sink + 1;
+}
+
+static TaskRuntime task(const char* name, uint32_t runtime) {
+    TaskRuntime t;
+    strncpy(t.name, name, sizeof(t.name) - 1);
+    t.runtime = runtime;
+    return t;
+}
+
+TEST(CpuAccountingTest, NestedScopesChargeExclusiveTime) {
+    CpuAccounting::reset();
+    {
+        CpuScope uplink(CpuSubsystem::UPLINK);
+        spinUs(20000);
+        {
+            CpuScope security(CpuSubsystem::SECURITY);
+            spinUs(30000);
+        }
+        {
+            CpuScope network(CpuSubsystem::NETWORK);
+            spinUs(10000);
+        }
+    }
+    CpuCounter uplink = CpuAccounting::get(CpuSubsystem::UPLINK);
+    CpuCounter security = CpuAccounting::get(CpuSubsystem::SECURITY);
+    CpuCounter network = CpuAccounting::get(CpuSubsystem::NETWORK);
+    EXPECT_EQ(uplink.calls, 1u);
+    EXPECT_EQ(security.calls, 1u);
+    EXPECT_GE(security.us, 30000u);
+    EXPECT_GE(network.us, 10000u);
+    // The parent keeps only its own 20 ms, not the 60 ms the scope was open
+    EXPECT_GE(uplink.us, 20000u);
+    EXPECT_LT(uplink.us, 30000u);
+    EXPECT_EQ(security.max_us, security.us);
+
+    std::string json = CpuAccounting::subsystemsJson();
+    EXPECT_NE(json.find("\"security\":{\"us\":"), std::string::npos);
+    EXPECT_NE(json.find("\"acquisition\":{\"us\":0,\"calls\":0"), std::string::npos);
+}
+
+TEST(CpuAccountingTest, HostClockIsThreadCpuTime) {
+    CpuAccounting::reset();
+    {
+        CpuScope json(CpuSubsystem::JSON);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));   // waiting costs no CPU
+    }
+    CpuCounter c = CpuAccounting::get(CpuSubsystem::JSON);
+    EXPECT_EQ(c.calls, 1u);
+    EXPECT_LT(c.us, 10000u);
+
+    // Scopes on another thread nest independently and add to the same counters
+    std::thread t([] {
+        CpuScope flash(CpuSubsystem::FLASH);
+        spinUs(5000);
+    });
+    {
+        CpuScope flash(CpuSubsystem::FLASH);
+        spinUs(5000);
+    }
+    t.join();
+    EXPECT_EQ(CpuAccounting::get(CpuSubsystem::FLASH).calls, 2u);
+    EXPECT_GE(CpuAccounting::get(CpuSubsystem::FLASH).us, 10000u);
+}
+
+TEST(CpuAccountingTest, TaskSharesOverTheInterval) {
+    TaskRuntimeMonitor mon;
+    TaskRuntime first[] = {task("loopTask", 100000), task("IDLE0", 500000)};
+    mon.update(first, 2, 1000000, 2);
+    ASSERT_EQ(mon.tasks(), 2u);
+    EXPECT_EQ(mon.deltaOf(0), 100000u);   // first sighting: everything so far
+
+    // One second later on two cores; the counter of one task wrapped
+    TaskRuntime second[] = {task("IDLE0", 1300000), task("loopTask", 0x100u),
+                            task("async_tcp", 200000)};
+    TaskRuntime wrapped[] = {task("loopTask", 0xFFFFF000u)};
+    mon.update(wrapped, 1, 1000000, 2);
+    mon.update(second, 3, 1000000, 2);
+    EXPECT_EQ(mon.deltaOf(0), 1300000u);            // IDLE0 was not in the previous snapshot
+    EXPECT_EQ(mon.deltaOf(1), 0x1100u);
+    EXPECT_EQ(mon.shareOf(2), 1000u);               // 0.2 s of 2 core-seconds = 10%
+    EXPECT_EQ(mon.shareOf(0), 6500u);
+
+    std::string json = mon.json();
+    EXPECT_EQ(json.find("{\"task\":\"IDLE0\",\"us\":1300000,\"pct\":65.00}"), 1u);   // busiest first
+    EXPECT_NE(json.find("\"task\":\"async_tcp\",\"us\":200000,\"pct\":10.00"), std::string::npos);
+
+    mon.update(nullptr, 0, 1000000, 2);
+    EXPECT_EQ(mon.json(), "[]");
+}
+
+TEST(CpuAccountingTest, RegisteredHostThreadsAreSampled) {
+    std::atomic<bool> stop{false};
+    std::atomic<bool> ready{false};
+    std::thread worker([&] {
+        TaskRuntimeMonitor::registerThread("worker");
+        ready = true;
+        volatile uint64_t sink = 0;
+        while (!stop) sink = sink + 1;
+    });
+    while (!ready) std::this_thread::yield();
+
+    // How much CPU the worker gets depends on the runner's load and core count, so only
+    // check that it is seen and that its run time moves forward between samples
+    TaskRuntimeMonitor mon;
+    auto advance = [&mon] {
+        for (int i = 0; i < 500; ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (mon.sample() == 1 && mon.deltaOf(0) > 0) return true;
+        }
+        return false;
+    };
+    bool seen = mon.sample() == 1 && advance();
+    uint32_t first = mon.task(0).runtime;
+    bool advanced = seen && advance();
+    stop = true;
+    worker.join();
+
+    ASSERT_TRUE(seen);
+    ASSERT_TRUE(advanced);
+    EXPECT_STREQ(mon.task(0).name, "worker");
+    EXPECT_GT(mon.deltaOf(0), 0u);
+    EXPECT_GT(mon.task(0).runtime, first);
+}
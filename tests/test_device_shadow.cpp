@@ -0,0 +1,110 @@
+/**
+ * @file test_device_shadow.cpp
+ * @brief Tests for the versioned device shadow and its delta reporting
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "device_shadow.hpp"
+
+static uint32_t bit(ShadowField f) {
+    return 1u << (unsigned)f;
+}
+
+TEST(DeviceShadowTest, OnlyChangesBumpTheVersion) {
+    DeviceShadow shadow;
+    EXPECT_TRUE(shadow.set(ShadowField::FIRMWARE, "1.4.2"));
+    EXPECT_TRUE(shadow.set(ShadowField::FOTA_CHUNKS, 0, 212));
+    EXPECT_EQ(shadow.version(), 2u);
+    EXPECT_FALSE(shadow.set(ShadowField::FIRMWARE, "1.4.2"));
+    EXPECT_FALSE(shadow.set(ShadowField::FOTA_CHUNKS, 0, 212));
+    EXPECT_EQ(shadow.version(), 2u);
+    EXPECT_EQ(shadow.dirtyMask(), bit(ShadowField::FIRMWARE) | bit(ShadowField::FOTA_CHUNKS));
+}
+
+TEST(DeviceShadowTest, FirstDeltaIsFullThenOnlyWhatChanged) {
+    DeviceShadow shadow;
+    shadow.set(ShadowField::FIRMWARE, "1.4.2");
+    shadow.set(ShadowField::CONFIG_VERSION, 57);
+    shadow.set(ShadowField::FOTA_STATE, "idle");
+    ASSERT_TRUE(shadow.due(0));
+    EXPECT_EQ(shadow.delta(0),
+              "{\"type\":\"shadow\",\"v\":3,\"full\":true,\"s\":{\"fw\":\"1.4.2\",\"cfg\":57,\"fota\":\"idle\"}}");
+    EXPECT_FALSE(shadow.due(1000));   // in flight
+
+    uint32_t v = 0;
+    ASSERT_TRUE(DeviceShadow::parseAck("{\"status\":\"success\",\"received\":1,\"shadow_ack\": 3}", v));
+    shadow.ack(v);
+    EXPECT_EQ(shadow.dirtyMask(), 0u);
+    EXPECT_FALSE(shadow.due(2000));
+
+    shadow.set(ShadowField::FOTA_STATE, "downloading");
+    shadow.set(ShadowField::FOTA_CHUNKS, 1, 212);
+    shadow.set(ShadowField::FOTA_CHUNKS, 2, 212);   // coalesced before it is sent
+    ASSERT_TRUE(shadow.due(3000));
+    EXPECT_EQ(shadow.delta(3000), "{\"type\":\"shadow\",\"v\":6,\"s\":{\"fota\":\"downloading\",\"fch\":[2,212]}}");
+    EXPECT_EQ(shadow.deltasSent(), 2u);
+}
+
+TEST(DeviceShadowTest, ChangesDuringFlightStayDirtyAfterTheAck) {
+    DeviceShadow shadow;
+    shadow.set(ShadowField::FOTA_CHUNKS, 10, 212);
+    shadow.set(ShadowField::SECURITY, 0, 0);
+    shadow.delta(0);                                  // v2 in flight
+    shadow.set(ShadowField::FOTA_CHUNKS, 11, 212);    // v3
+    shadow.ack(2);
+    EXPECT_EQ(shadow.ackedVersion(), 2u);
+    EXPECT_EQ(shadow.dirtyMask(), bit(ShadowField::FOTA_CHUNKS));
+    EXPECT_TRUE(shadow.due(10));   // v2 is settled; v3 goes now
+    EXPECT_EQ(shadow.delta(10), "{\"type\":\"shadow\",\"v\":3,\"s\":{\"fch\":[11,212]}}");
+
+    // Stale and foreign acks are ignored
+    shadow.ack(1);
+    shadow.ack(99);
+    EXPECT_EQ(shadow.ackedVersion(), 2u);
+    EXPECT_NE(shadow.dirtyMask(), 0u);
+}
+
+TEST(DeviceShadowTest, UnacknowledgedDeltaIsResent) {
+    DeviceShadow shadow;
+    shadow.set(ShadowField::BOOT_STATUS, "success");
+    std::string first = shadow.delta(1000);
+    EXPECT_FALSE(shadow.due(1000 + DeviceShadow::RESEND_MS - 1));
+    EXPECT_TRUE(shadow.due(1000 + DeviceShadow::RESEND_MS));
+    EXPECT_EQ(shadow.delta(1000 + DeviceShadow::RESEND_MS), first);
+
+    // A failed batch may go again at once
+    shadow.sendFailed();
+    EXPECT_TRUE(shadow.due(1000 + DeviceShadow::RESEND_MS));
+    uint32_t v = 0;
+    EXPECT_FALSE(DeviceShadow::parseAck("{\"status\":\"success\"}", v));
+}
+
+TEST(DeviceShadowTest, StringsAreEscapedAndDocumentHoldsEverything) {
+    DeviceShadow shadow;
+    shadow.set(ShadowField::FOTA_ERROR, "SHA-256 \"mismatch\"\n");
+    shadow.set(ShadowField::RSSI_DBM, -65);
+    shadow.ack(shadow.version());
+    shadow.set(ShadowField::RSSI_DBM, -70);
+    EXPECT_EQ(shadow.document(), "{\"v\":3,\"s\":{\"ferr\":\"SHA-256 \\\"mismatch\\\"\\u000a\",\"rssi\":-70}}");
+}
+
+TEST(DeviceShadowTest, SteadyStateCostsNothing) {
+    // An hour of FOTA-free operation: health is set every 5 s, but barely moves
+    DeviceShadow shadow;
+    shadow.set(ShadowField::FIRMWARE, "1.4.2");
+    uint32_t now = 0;
+    size_t sent = 0;
+    for (int tick = 0; tick < 720; ++tick, now += 5000) {
+        shadow.set(ShadowField::HEAP_MIN_KB, tick < 360 ? 142 : 141);
+        shadow.set(ShadowField::RSSI_DBM, -65);
+        shadow.set(ShadowField::SECURITY, 0, 0);
+        if (tick % 12 == 0 && shadow.due(now)) {   // one uplink a minute
+            sent += shadow.delta(now).size();
+            shadow.ack(shadow.version());
+        }
+    }
+    EXPECT_EQ(shadow.deltasSent(), 2u);
+    EXPECT_LT(sent, 200u);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file test_flow_control.cpp
+ * @brief Tests for fleet phase offsets and server-directed flow control
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "flow_control.hpp"
+#include <cstring>
+#include <set>
+#include <string>
+
+TEST(FleetPhaseTest, Fnv1aKnownVectors) {
+    EXPECT_EQ(fnv1a32("", 0), 0x811c9dc5u);
+    EXPECT_EQ(fnv1a32("a", 1), 0xe40c292cu);
+    EXPECT_EQ(fnv1a32("foobar", 6), 0xbf9cf968u);
+}
+
+TEST(FleetPhaseTest, OffsetIsStableAndWithinInterval) {
+    const uint32_t interval = 15000;
+    std::set<uint32_t> seconds;
+    for (int i = 0; i < 200; ++i) {
+        std::string id = "EcoWatt" + std::to_string(i);
+        uint32_t phase = fleetPhaseOffsetMs(id, interval);
+        EXPECT_LT(phase, interval);
+        EXPECT_EQ(phase, fleetPhaseOffsetMs(id, interval));
+        seconds.insert(phase / 1000);
+    }
+    // 200 devices should land in (nearly) every one-second slot of the interval
+    EXPECT_GE(seconds.size(), 14u);
+    EXPECT_EQ(fleetPhaseOffsetMs("EcoWatt001", 0), 0u);
+}
+
+TEST(FlowControlTest, ParsesRetryAfter) {
+    uint32_t ms = 0;
+    EXPECT_TRUE(parseRetryAfterMs("120", ms));
+    EXPECT_EQ(ms, 120000u);
+    EXPECT_TRUE(parseRetryAfterMs(" 0 ", ms));
+    EXPECT_EQ(ms, 0u);
+    EXPECT_FALSE(parseRetryAfterMs("", ms));
+    EXPECT_FALSE(parseRetryAfterMs("-5", ms));
+    EXPECT_FALSE(parseRetryAfterMs("Wed, 21 Oct 2015 07:28:00 GMT", ms));
+}
+
+TEST(FlowControlTest, ParsesNextInterval) {
+    uint32_t ms = 0;
+    EXPECT_TRUE(parseNextIntervalMs("30", ms));
+    EXPECT_EQ(ms, 30000u);
+    EXPECT_TRUE(parseNextIntervalMs("7.5", ms));
+    EXPECT_EQ(ms, 7500u);
+    EXPECT_FALSE(parseNextIntervalMs("0", ms));
+    EXPECT_FALSE(parseNextIntervalMs("abc", ms));
+    EXPECT_FALSE(parseNextIntervalMs("30s", ms));
+    EXPECT_FALSE(parseNextIntervalMs("100000", ms));
+}
+
+TEST(FlowControlTest, RetryAfterDefersWithBoundedJitter) {
+    FlowControl flow;
+    flow.setJitterSeed(fnv1a32("EcoWatt001", 10));
+    const uint32_t now = 1000;
+    EXPECT_TRUE(flow.canSend(now));
+
+    EXPECT_FALSE(flow.applyHints("10", "", now));
+    EXPECT_FALSE(flow.canSend(now));
+    EXPECT_EQ(flow.deferrals(), 1u);
+    uint32_t remaining = flow.deferRemainingMs(now);
+    EXPECT_GE(remaining, 10000u);
+    EXPECT_LE(remaining, 12500u);
+    EXPECT_FALSE(flow.canSend(now + 9999));
+    EXPECT_TRUE(flow.canSend(now + 12500));
+    EXPECT_EQ(flow.deferRemainingMs(now + 12500), 0u);
+}
+
+TEST(FlowControlTest, HugeRetryAfterIsCapped) {
+    uint32_t ms = 0;
+    EXPECT_TRUE(parseRetryAfterMs("4294968", ms));        // * 1000 wraps a uint32
+    EXPECT_EQ(ms, RETRY_AFTER_MAX_S * 1000u);
+    EXPECT_TRUE(parseRetryAfterMs("99999999999999999999", ms));
+    EXPECT_EQ(ms, RETRY_AFTER_MAX_S * 1000u);
+    EXPECT_TRUE(parseRetryAfterMs("000000000030", ms));
+    EXPECT_EQ(ms, 30000u);
+
+    // A deferral past 2^31 ms would read as already expired; it is held to the max interval
+    FlowControl flow(5000, 600000);
+    const uint32_t now = 0xFFFF0000u;   // just before millis() wraps
+    flow.applyHints("2000000", "", now);
+    EXPECT_FALSE(flow.canSend(now));
+    EXPECT_FALSE(flow.canSend(now + 599999));
+    EXPECT_LE(flow.deferRemainingMs(now), 750000u);
+    EXPECT_TRUE(flow.canSend(now + 750000));
+}
+
+TEST(FlowControlTest, DevicesSpreadAfterSharedRetryAfter) {
+    std::set<uint32_t> release_ms;
+    for (int i = 0; i < 50; ++i) {
+        std::string id = "EcoWatt" + std::to_string(i);
+        FlowControl flow;
+        flow.setJitterSeed(fnv1a32(id.data(), id.size()));
+        flow.applyHints("30", "", 0);
+        release_ms.insert(flow.deferRemainingMs(0));
+    }
+    EXPECT_GT(release_ms.size(), 40u);
+}
+
+TEST(FlowControlTest, NextIntervalIsClampedAndReportsChange) {
+    FlowControl flow(5000, 600000);
+    EXPECT_FALSE(flow.hasIntervalOverride());
+
+    EXPECT_TRUE(flow.applyHints("", "60", 0));
+    EXPECT_TRUE(flow.hasIntervalOverride());
+    EXPECT_EQ(flow.intervalMs(), 60000u);
+    EXPECT_FALSE(flow.applyHints("", "60", 0));   // unchanged
+
+    EXPECT_TRUE(flow.applyHints("", "1", 0));
+    EXPECT_EQ(flow.intervalMs(), 5000u);
+    EXPECT_TRUE(flow.applyHints("", "86400", 0));
+    EXPECT_EQ(flow.intervalMs(), 600000u);
+
+    // Malformed hints leave state alone
+    EXPECT_FALSE(flow.applyHints("soon", "later", 0));
+    EXPECT_TRUE(flow.canSend(0));
+    EXPECT_EQ(flow.intervalMs(), 600000u);
+}
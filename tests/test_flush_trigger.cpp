@@ -0,0 +1,201 @@
+/**
+ * @file test_flush_trigger.cpp
+ * @brief Tests for the size / age / urgent uplink flush triggers
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "flush_trigger.hpp"
+#include "flow_control.hpp"
+#include <vector>
+
+static FlushInputs pending(uint32_t samples, uint32_t age_ms) {
+    FlushInputs in;
+    in.pending_samples = samples;
+    in.oldest_age_ms = age_ms;
+    return in;
+}
+
+TEST(FlushTriggerTest, FiresOnSizeAgeAndUrgent) {
+    FlushTargets t;
+    t.target_bytes = 1000;
+    t.max_age_ms = 30000;
+    t.min_gap_ms = 0;
+    FlushTrigger trig(t);
+
+    EXPECT_EQ(trig.evaluate(FlushInputs(), 1000), FlushReason::NONE);
+    EXPECT_EQ(trig.evaluate(pending(10, 5000), 1000), FlushReason::NONE);
+    EXPECT_EQ(trig.evaluate(pending(10, 30000), 1000), FlushReason::AGE);
+    EXPECT_EQ(trig.evaluate(pending(200, 100), 1000), FlushReason::SIZE);   // 200 x ~5 bytes
+
+    FlushInputs events;
+    events.queued_bytes = 1200;
+    EXPECT_EQ(trig.evaluate(events, 1000), FlushReason::SIZE);
+
+    FlushInputs ring = pending(50, 100);
+    ring.sample_capacity = 100;
+    EXPECT_EQ(trig.evaluate(ring, 1000), FlushReason::SIZE);
+
+    FlushInputs urgent;
+    urgent.urgent = true;
+    EXPECT_EQ(trig.evaluate(urgent, 1000), FlushReason::URGENT);
+}
+
+TEST(FlushTriggerTest, SizeEstimateFollowsEncodedBytes) {
+    FlushTrigger trig;
+    EXPECT_EQ(trig.estimateBytes(1000), 5000u);
+    for (int i = 0; i < 30; ++i) trig.observeEncoded(1000, 2000);
+    EXPECT_NEAR((double)trig.estimateBytes(1000), 2000.0, 20.0);
+    trig.observeEncoded(0, 100);   // ignored
+    EXPECT_NEAR((double)trig.estimateBytes(1000), 2000.0, 20.0);
+}
+
+TEST(FlushTriggerTest, MinGapAndFailureBackoff) {
+    FlushTargets t;
+    t.target_bytes = 1000;
+    t.max_age_ms = 10000;
+    t.min_gap_ms = 2000;
+    FlushTrigger trig(t);
+
+    FlushInputs big = pending(400, 100);
+    ASSERT_EQ(trig.evaluate(big, 0), FlushReason::SIZE);
+    trig.onFlush(FlushReason::SIZE, true, 0);
+    EXPECT_EQ(trig.evaluate(big, 1000), FlushReason::NONE);    // inside the gap
+    EXPECT_EQ(trig.evaluate(big, 2000), FlushReason::SIZE);
+
+    // Failures double the wait, capped at the age bound; age cannot bypass it
+    trig.onFlush(FlushReason::SIZE, false, 2000);
+    EXPECT_EQ(trig.backoffMs(), 2000u);
+    EXPECT_EQ(trig.evaluate(pending(400, 20000), 3000), FlushReason::NONE);
+    trig.onFlush(FlushReason::AGE, false, 4000);
+    trig.onFlush(FlushReason::AGE, false, 8000);
+    trig.onFlush(FlushReason::AGE, false, 16000);
+    EXPECT_EQ(trig.backoffMs(), 10000u);
+    EXPECT_EQ(trig.evaluate(pending(400, 20000), 25000), FlushReason::NONE);
+    EXPECT_EQ(trig.evaluate(pending(400, 20000), 26000), FlushReason::AGE);
+    // Urgent items are not held back
+    FlushInputs urgent;
+    urgent.urgent = true;
+    EXPECT_EQ(trig.evaluate(urgent, 16500), FlushReason::URGENT);
+
+    trig.onFlush(FlushReason::AGE, true, 26000);
+    EXPECT_EQ(trig.backoffMs(), 0u);
+    EXPECT_EQ(trig.flushes(FlushReason::AGE), 4u);
+    EXPECT_EQ(trig.flushes(FlushReason::SIZE), 2u);
+}
+
+TEST(FlushTriggerTest, TargetsAreClamped) {
+    FlushTargets t;
+    t.target_bytes = 10;
+    t.max_age_ms = 100;
+    t.min_gap_ms = 5000;
+    FlushTrigger trig(t);
+    EXPECT_EQ(trig.targets().target_bytes, FlushTrigger::MIN_TARGET_BYTES);
+    EXPECT_EQ(trig.targets().max_age_ms, FlushTrigger::MIN_MAX_AGE_MS);
+    EXPECT_EQ(trig.targets().min_gap_ms, FlushTrigger::MIN_MAX_AGE_MS);
+    t.target_bytes = 1u << 30;
+    t.max_age_ms = 0xFFFFFFFFu;
+    trig.setTargets(t);
+    EXPECT_EQ(trig.targets().target_bytes, FlushTrigger::MAX_TARGET_BYTES);
+    EXPECT_EQ(trig.targets().max_age_ms, FlushTrigger::MAX_MAX_AGE_MS);
+}
+
+// Samples arrive at a steady rate and are delivered on every flush. Returns requests
+// per 1000 samples and the worst age of a sample when it was sent.
+struct SimResult {
+    double requests_per_k = 0;
+    uint32_t worst_age_ms = 0;
+};
+
+static SimResult simulate(double samples_per_s, FlushTrigger* trig, uint32_t fixed_interval_ms) {
+    const uint32_t chunk_bytes = 1024;
+    const double bytes_per_sample = 5.0;
+    SimResult r;
+    uint64_t requests = 0, samples = 0;
+    uint32_t pending = 0, oldest_ms = 0;
+    double acc = 0;
+    for (uint32_t now = 0; now < 3600000; now += 1000) {
+        acc += samples_per_s;
+        uint32_t arrived = (uint32_t)acc;
+        acc -= arrived;
+        if (arrived && pending == 0) oldest_ms = now;
+        pending += arrived;
+        samples += arrived;
+
+        bool flush;
+        FlushReason reason = FlushReason::NONE;
+        if (trig) {
+            FlushInputs in;
+            in.pending_samples = pending;
+            in.oldest_age_ms = pending ? now - oldest_ms : 0;
+            reason = trig->evaluate(in, now);
+            flush = reason != FlushReason::NONE;
+        } else {
+            flush = now % fixed_interval_ms == 0 && pending > 0;
+        }
+        if (!flush) continue;
+        uint32_t bytes = (uint32_t)(pending * bytes_per_sample);
+        requests += (bytes + chunk_bytes - 1) / chunk_bytes;
+        if (now - oldest_ms > r.worst_age_ms) r.worst_age_ms = now - oldest_ms;
+        if (trig) trig->onFlush(reason, true, now);
+        pending = 0;
+    }
+    r.requests_per_k = samples ? 1000.0 * requests / samples : 0;
+    return r;
+}
+
+TEST(FlushTriggerTest, FewerRequestsAtLowRatesBoundedLatencyAtHighRates) {
+    FlushTargets t;
+    t.target_bytes = 4096;
+    t.max_age_ms = 60000;
+    t.min_gap_ms = 2000;
+
+    // 10 registers every 30 s: a fixed 15 s ticker sends a near-empty request each tick
+    FlushTrigger low(t);
+    SimResult fixed_low = simulate(10.0 / 30, nullptr, 15000);
+    SimResult trig_low = simulate(10.0 / 30, &low, 0);
+    EXPECT_LT(trig_low.requests_per_k * 3, fixed_low.requests_per_k);
+    EXPECT_LE(trig_low.worst_age_ms, t.max_age_ms);
+
+    // 200 samples/s: the size target flushes long before the age bound
+    FlushTrigger high(t);
+    SimResult trig_high = simulate(200, &high, 0);
+    EXPECT_LE(trig_high.worst_age_ms, 5000u);
+    EXPECT_GT(high.flushes(FlushReason::SIZE), 0u);
+    EXPECT_EQ(high.flushes(FlushReason::AGE), 0u);
+}
+
+TEST(FlushTriggerTest, FleetPhaseStaggersAgeFlushes) {
+    // Two devices boot together with the same slow backlog
+    FlushTargets t;
+    t.max_age_ms = 60000;
+    std::vector<uint32_t> flushes[2];
+    const char* ids[2] = {"EcoWatt001", "EcoWatt002"};
+    for (int d = 0; d < 2; ++d) {
+        FlushTrigger trig(t);
+        trig.setPhase(fleetPhaseOffsetMs(ids[d], t.max_age_ms));
+        uint32_t samples = 0, oldest_ms = 0;
+        for (uint32_t now = 0; now < 600000; now += 1000) {
+            if (now % 10000 == 0) {
+                if (samples == 0) oldest_ms = now;
+                samples += 10;
+            }
+            FlushReason reason = trig.evaluate(pending(samples, now - oldest_ms), now);
+            if (reason == FlushReason::NONE) continue;
+            trig.onFlush(reason, true, now);
+            flushes[d].push_back(now);
+            samples = 0;
+        }
+    }
+    ASSERT_GT(flushes[0].size(), 5u);
+    ASSERT_GT(flushes[1].size(), 5u);
+    EXPECT_NE(flushes[0][0], flushes[1][0]);
+    // Apart on every cycle, not only the first
+    for (uint32_t a : flushes[0]) {
+        for (uint32_t b : flushes[1]) EXPECT_NE(a, b);
+    }
+    // Still within the latency bound
+    EXPECT_LE(flushes[0][0], t.max_age_ms);
+    EXPECT_LE(flushes[1][0], t.max_age_ms);
+}
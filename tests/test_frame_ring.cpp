@@ -0,0 +1,100 @@
+/**
+ * @file test_frame_ring.cpp
+ * @brief Tests for the per-cycle frame ring behind DataStorage
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "frame_ring.hpp"
+#include <vector>
+
+static SampleFrame makeFrame(uint32_t ts, uint8_t regs, uint8_t skip = 0xFF) {
+    SampleFrame f;
+    f.timestamp = ts;
+    for (uint8_t reg = 0; reg < regs; ++reg) {
+        if (reg != skip) f.set(reg, (float)ts + reg * 0.5f);
+    }
+    return f;
+}
+
+TEST(FrameRingTest, ExpandsFramesInRegisterOrderWithSequences) {
+    FrameRing ring(1024);
+    ASSERT_TRUE(ring.append(makeFrame(1000, 10)));
+    ASSERT_TRUE(ring.append(makeFrame(2000, 10, 4)));
+    EXPECT_FALSE(ring.append(SampleFrame()));
+    EXPECT_EQ(ring.frames(), 2u);
+    EXPECT_EQ(ring.samples(), 19u);
+    EXPECT_EQ(ring.nextSequence(), 19u);
+    // 6-byte header per cycle, 4 bytes per value
+    EXPECT_EQ(ring.bytesUsed(), 2 * FrameRing::RECORD_HEADER + 19 * 4);
+
+    Sample out[32];
+    uint32_t first = 0;
+    ASSERT_EQ(ring.readFromSequence(0, out, 32, first), 19u);
+    EXPECT_EQ(first, 0u);
+    EXPECT_EQ(out[0].timestamp, 1000u);
+    EXPECT_EQ(out[9].reg_addr, 9);
+    EXPECT_EQ(out[10].timestamp, 2000u);
+    EXPECT_EQ(out[14].reg_addr, 5);   // register 4 missing from the second frame
+    EXPECT_EQ(out[14].value, 2000.0f + 2.5f);
+
+    // Starting mid-frame and bounded by the output size
+    ASSERT_EQ(ring.readFromSequence(7, out, 5, first), 5u);
+    EXPECT_EQ(first, 7u);
+    EXPECT_EQ(out[0].reg_addr, 7);
+    EXPECT_EQ(out[3].timestamp, 2000u);
+    EXPECT_EQ(out[3].reg_addr, 0);
+
+    ASSERT_EQ(ring.readLast(3, out, 32), 3u);
+    EXPECT_EQ(out[0].reg_addr, 7);
+    EXPECT_EQ(out[2].reg_addr, 9);
+}
+
+TEST(FrameRingTest, WrapsAndEvictsOldestFrames) {
+    FrameRing ring(500);   // ten 46-byte frames, the eleventh wraps
+    std::vector<uint32_t> expected_ts;
+    for (uint32_t c = 0; c < 100; ++c) {
+        ASSERT_TRUE(ring.append(makeFrame(c * 1000, c % 7 == 0 ? 3 : 10)));
+        EXPECT_LE(ring.bytesUsed(), ring.capacityBytes());
+        EXPECT_EQ(ring.nextSequence() - ring.firstSequence(), ring.samples());
+    }
+    EXPECT_GE(ring.frames(), 9u);
+
+    // Everything left reads back in order, with the first sequence clamped to the oldest
+    std::vector<Sample> out(ring.samples() + 4);
+    uint32_t first = 0;
+    size_t n = ring.readFromSequence(0, out.data(), out.size(), first);
+    EXPECT_EQ(n, ring.samples());
+    EXPECT_EQ(first, ring.firstSequence());
+    for (size_t i = 1; i < n; ++i) {
+        bool same_frame = out[i].timestamp == out[i - 1].timestamp;
+        EXPECT_TRUE(same_frame ? out[i].reg_addr == out[i - 1].reg_addr + 1
+                               : out[i].timestamp == out[i - 1].timestamp + 1000);
+    }
+    EXPECT_EQ(out[n - 1].timestamp, 99000u);
+    EXPECT_EQ(ring.sampleCapacity(), 500u / 46u * 10u);
+}
+
+TEST(FrameRingTest, GroupsSamplesAndRenumbers) {
+    FrameRing ring(1024);
+    std::vector<Sample> samples = {{100, 0, 1.0f}, {100, 1, 2.0f}, {100, 1, 3.0f},
+                                   {200, 2, 4.0f}, {200, 40, 5.0f}, {200, 5, 6.0f}};
+    EXPECT_EQ(ring.appendSamples(samples.data(), samples.size()), 3u);
+    EXPECT_EQ(ring.samples(), 5u);   // register 40 is outside the frame map
+
+    // Restored samples sit below the live sequence
+    ring.setNextSequence(0);
+    EXPECT_EQ(ring.firstSequence(), (uint32_t)-5);
+    ASSERT_TRUE(ring.append(makeFrame(300, 2)));
+    Sample out[8];
+    uint32_t first = 0;
+    ASSERT_EQ(ring.readFromSequence(0, out, 8, first), 2u);
+    EXPECT_EQ(out[0].timestamp, 300u);
+
+    ring.clear();
+    EXPECT_EQ(ring.samples(), 0u);
+    EXPECT_EQ(ring.nextSequence(), 2u);
+    EXPECT_EQ(ring.readFromSequence(0, out, 8, first), 0u);
+    EXPECT_EQ(first, 2u);
+}
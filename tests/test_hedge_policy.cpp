@@ -0,0 +1,66 @@
+/**
+ * @file test_hedge_policy.cpp
+ * @brief Tests for the hedged-read policy: p95 delay and hedge budget
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "hedge_policy.hpp"
+
+TEST(HedgePolicyTest, NoHedgingUntilEnoughSamples) {
+    HedgePolicy policy;
+    for (int i = 0; i < 19; ++i) policy.onComplete(10000, false);
+    EXPECT_EQ(policy.delayUs(), 0u);
+    policy.onComplete(10000, false);
+    EXPECT_EQ(policy.delayUs(), 10000u);
+}
+
+TEST(HedgePolicyTest, DelayIsTheP95OfTheWindow) {
+    HedgePolicy policy;
+    // 62 fast reads and 2 slow ones: the 95th percentile is still fast
+    for (int i = 0; i < 62; ++i) policy.onComplete(3000 + i * 10, false);
+    for (int i = 0; i < 2; ++i) policy.onComplete(250000, false);
+    EXPECT_EQ(policy.percentileUs(50), 3310u);
+    EXPECT_EQ(policy.delayUs(), 3600u);
+    EXPECT_EQ(policy.percentileUs(99), 250000u);
+
+    // Old samples leave the window
+    for (size_t i = 0; i < HedgePolicy::WINDOW; ++i) policy.onComplete(40000, false);
+    EXPECT_EQ(policy.delayUs(), 40000u);
+}
+
+TEST(HedgePolicyTest, DelayHasAFloor) {
+    HedgeConfig config;
+    config.min_delay_us = 5000;
+    HedgePolicy policy(config);
+    for (int i = 0; i < 30; ++i) policy.onComplete(200, false);
+    EXPECT_EQ(policy.delayUs(), 5000u);
+}
+
+TEST(HedgePolicyTest, BudgetLimitsHedgesToAFewPercent) {
+    HedgePolicy policy;   // 5%
+    uint32_t granted = 0;
+    for (int i = 0; i < 1000; ++i) {
+        policy.onRead();
+        if (policy.takeHedge()) granted++;
+    }
+    EXPECT_EQ(granted, 50u);
+    EXPECT_EQ(policy.hedges(), 50u);
+    EXPECT_EQ(policy.denied(), 950u);
+}
+
+TEST(HedgePolicyTest, QuietPeriodsSaveOnlyABurst) {
+    HedgeConfig config;
+    config.burst = 3;
+    HedgePolicy policy(config);
+    for (int i = 0; i < 10000; ++i) policy.onRead();
+    EXPECT_TRUE(policy.takeHedge());
+    EXPECT_TRUE(policy.takeHedge());
+    EXPECT_TRUE(policy.takeHedge());
+    EXPECT_FALSE(policy.takeHedge());
+
+    policy.onComplete(1000, true);
+    EXPECT_EQ(policy.hedgeWins(), 1u);
+    EXPECT_NE(policy.json().find("\"hedges\":3,\"wins\":1,\"denied\":1"), std::string::npos);
+}
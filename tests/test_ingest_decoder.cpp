@@ -0,0 +1,233 @@
+/**
+ * @file test_ingest_decoder.cpp
+ * @brief Tests for the native cloud-side upload decoder and its C ABI
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "ecowatt_ingest.h"
+#include "ingest_decoder.hpp"
+#include "secure_envelope.hpp"
+#include "uplink_codec.hpp"
+#include <string>
+#include <vector>
+
+static const uint8_t kKey[32] = {0xc4, 0x17, 0x16, 0xa1, 0x34, 0x16, 0x8f, 0x52, 0xfb, 0xd4, 0xbe,
+                                 0x33, 0x02, 0xfa, 0x5a, 0x88, 0x12, 0x7d, 0xdd, 0xe7, 0x49, 0x50,
+                                 0x1a, 0x19, 0x96, 0x07, 0xb4, 0xc2, 0x86, 0xad, 0x29, 0xb3};
+
+static std::vector<Sample> makeSamples(size_t n, uint32_t t0 = 1000) {
+    std::vector<Sample> v;
+    for (size_t i = 0; i < n; ++i) v.push_back(Sample{t0 + (uint32_t)i * 500, (uint8_t)(i % 3), 230.0f + (float)(i % 7)});
+    return v;
+}
+
+// What the device sends: sealEnvelope over the encoded batches
+static std::string seal(const std::vector<uint8_t>& payload, uint32_t nonce, uint32_t ts = 4242) {
+    IoBufPool pool(2048, 4);
+    HmacSha256 hmac(kKey, sizeof(kKey));
+    IoChain in(&pool), out(&pool);
+    in.append(IoBuf::wrap(payload.data(), payload.size()));
+    EXPECT_TRUE(sealEnvelope(in, nonce, ts, false, hmac, out));
+    return out.toString();
+}
+
+TEST(IngestDecoderTest, DecodesWhatTheDeviceSeals) {
+    std::vector<Sample> samples = makeSamples(40);
+    std::vector<uint8_t> payload;
+    encodeDeltaQBatch(samples.data(), samples.size(), 0.01f, payload);
+    SampleAggregate agg;
+    for (const Sample& s : makeSamples(10, 50000)) agg.add(s);
+    encodeAggregateBatch(agg, payload);
+    encodeHeartbeatBatch(90000, 17, 3, payload);
+    std::string body = seal(payload, 12345, 777);
+
+    IngestDecoder decoder(kKey, sizeof(kKey), 1);
+    std::vector<ew_sample> out;
+    ew_ingest_result r;
+    ASSERT_EQ(decoder.decodeEnvelope(body.data(), body.size(), out, r), EW_INGEST_OK);
+    EXPECT_EQ(r.nonce, 12345u);
+    EXPECT_EQ(r.timestamp, 777u);
+    EXPECT_EQ(r.batches, 3u);
+    EXPECT_EQ(r.payload_bytes, payload.size());
+    EXPECT_EQ(r.fidelity, (uint8_t)Fidelity::HEARTBEAT);
+    ASSERT_TRUE(r.has_heartbeat);
+    EXPECT_EQ(r.heartbeat_ts, 90000u);
+    EXPECT_EQ(r.backlog, 17u);
+    EXPECT_EQ(r.lost, 3u);
+
+    ASSERT_EQ(out.size(), 40u + 3u);   // readings, then one mean per aggregated register
+    for (size_t i = 0; i < 40; ++i) {
+        EXPECT_EQ(out[i].timestamp, samples[i].timestamp);
+        EXPECT_EQ(out[i].reg_addr, samples[i].reg_addr);
+        EXPECT_NEAR(out[i].value, samples[i].value, 0.01f);
+        EXPECT_EQ(out[i].kind, EW_SAMPLE_READING);
+    }
+    EXPECT_EQ(out[40].kind, EW_SAMPLE_AGGREGATE);
+    EXPECT_EQ(out[40].timestamp, agg.endTs());
+}
+
+TEST(IngestDecoderTest, RejectsForgedOrAlteredEnvelopes) {
+    std::vector<uint8_t> payload;
+    std::vector<Sample> samples = makeSamples(5);
+    encodeRawBatch(samples.data(), samples.size(), payload);
+    std::string body = seal(payload, 9);
+    IngestDecoder decoder(kKey, sizeof(kKey), 1);
+    std::vector<ew_sample> out;
+    ew_ingest_result r;
+
+    std::string altered = body;
+    altered[altered.find("\"payload\":\"") + 12] ^= 0x01;
+    EXPECT_EQ(decoder.decodeEnvelope(altered.data(), altered.size(), out, r), EW_INGEST_BAD_MAC);
+
+    std::string replayed = body;
+    replayed.replace(replayed.find("\"nonce\":9"), 9, "\"nonce\":10");
+    EXPECT_EQ(decoder.decodeEnvelope(replayed.data(), replayed.size(), out, r), EW_INGEST_BAD_MAC);
+
+    uint8_t other_key[32] = {1};
+    IngestDecoder wrong(other_key, sizeof(other_key), 1);
+    EXPECT_EQ(wrong.decodeEnvelope(body.data(), body.size(), out, r), EW_INGEST_BAD_MAC);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(IngestDecoderTest, EnvelopeParsingFollowsThePythonServer) {
+    std::vector<uint8_t> payload;
+    std::vector<Sample> samples = makeSamples(2);
+    encodeRawBatch(samples.data(), samples.size(), payload);
+    std::string body = seal(payload, 5, 6);
+    size_t p = body.find("\"payload\":\"") + 11;
+    std::string text = body.substr(p, body.find('"', p) - p);
+    std::string mac = body.substr(body.find("\"mac\":\"") + 7, 64);
+    IngestDecoder decoder(kKey, sizeof(kKey), 1);
+    std::vector<ew_sample> out;
+    ew_ingest_result r;
+
+    // json.dumps spacing, any key order, unknown keys ignored
+    std::string reordered = "{ \"mac\": \"" + mac + "\", \"device\": \"EW-1\", \"payload\": \"" + text +
+                            "\", \"encrypted\": false, \"seq\": -1.5e3, \"timestamp\": 6, \"nonce\": 5 }\n";
+    EXPECT_EQ(decoder.decodeEnvelope(reordered.data(), reordered.size(), out, r), EW_INGEST_OK);
+
+    // A missing timestamp counts as 0, like envelope.get('timestamp', 0)
+    std::string no_ts = seal(payload, 5, 0);
+    no_ts.replace(no_ts.find(",\"timestamp\":0"), 14, "");
+    EXPECT_EQ(decoder.decodeEnvelope(no_ts.data(), no_ts.size(), out, r), EW_INGEST_OK);
+
+    for (const std::string& bad : {std::string("{\"nonce\":5,\"payload\":\"\"}"),                 // no mac
+                                   std::string("{\"nonce\":5,\"payload\":\"a\\/b\",\"mac\":\"\"}"),   // escape
+                                   std::string("{\"nonce\":5.5,\"payload\":\"\",\"mac\":\"\"}"),
+                                   std::string("{\"nonce\":99999999999,\"payload\":\"\",\"mac\":\"\"}"),
+                                   std::string("{\"nonce\":5,\"x\":{},\"payload\":\"\",\"mac\":\"\"}"),
+                                   body.substr(0, body.size() - 1)}) {
+        EXPECT_EQ(decoder.decodeEnvelope(bad.data(), bad.size(), out, r), EW_INGEST_BAD_ENVELOPE) << bad;
+    }
+}
+
+TEST(IngestDecoderTest, BadPayloadsLeaveNoSamplesBehind) {
+    IngestDecoder decoder(kKey, sizeof(kKey), 1);
+    std::vector<ew_sample> out(3);
+    ew_ingest_result r;
+
+    std::vector<uint8_t> payload;
+    std::vector<Sample> samples = makeSamples(20);
+    encodeRawBatch(samples.data(), samples.size(), payload);
+    payload.resize(payload.size() - 4);   // last sample cut short
+    EXPECT_EQ(decoder.decodePayload(payload.data(), payload.size(), out, r), EW_INGEST_BAD_BATCH);
+    EXPECT_EQ(out.size(), 3u);
+
+    std::vector<uint8_t> text_bytes = {'n', 'o', 't', '='};
+    std::string body = seal(text_bytes, 1);
+    size_t p = body.find("\"payload\":\"") + 11;
+    std::vector<uint8_t> decoded;
+    EXPECT_TRUE(base64DecodeTo(body.data() + p, body.find('"', p) - p, decoded));
+    EXPECT_EQ(decoded, text_bytes);
+    EXPECT_FALSE(base64DecodeTo("bm90PQ=", 7, decoded));
+    EXPECT_FALSE(base64DecodeTo("bm9=PQ==", 8, decoded));
+    EXPECT_FALSE(base64DecodeTo("b!90", 4, decoded));
+}
+
+TEST(IngestDecoderTest, LegacyRawRecordsWithoutBatchHeader) {
+    std::vector<uint8_t> payload;
+    std::vector<Sample> samples = makeSamples(4);
+    encodeRawBatch(samples.data(), samples.size(), payload);
+    std::vector<uint8_t> legacy(payload.begin() + UPLINK_BATCH_HEADER_SIZE, payload.end());
+    legacy.push_back(0xAA);   // trailing partial record is ignored, as in app.py
+
+    IngestDecoder decoder(kKey, sizeof(kKey), 1);
+    std::vector<ew_sample> out;
+    ew_ingest_result r;
+    ASSERT_EQ(decoder.decodePayload(legacy.data(), legacy.size(), out, r), EW_INGEST_OK);
+    EXPECT_TRUE(r.legacy);
+    ASSERT_EQ(out.size(), 4u);
+    EXPECT_EQ(out[3].timestamp, samples[3].timestamp);
+    EXPECT_FLOAT_EQ(out[3].value, samples[3].value);
+}
+
+TEST(IngestDecoderTest, PoolDecodesManyEnvelopesInOrder) {
+    std::vector<std::string> bodies;
+    for (uint32_t i = 0; i < 300; ++i) {
+        std::vector<uint8_t> payload;
+        std::vector<Sample> samples = makeSamples(1 + i % 50, i * 100000);
+        encodeDeltaQBatch(samples.data(), samples.size(), 0.1f, payload);
+        bodies.push_back(seal(payload, i + 1));
+    }
+    bodies[17][bodies[17].size() - 5] ^= 0x02;   // corrupt one MAC
+    std::vector<const char*> ptrs;
+    std::vector<size_t> lens;
+    for (const std::string& b : bodies) {
+        ptrs.push_back(b.data());
+        lens.push_back(b.size());
+    }
+
+    IngestDecoder serial(kKey, sizeof(kKey), 1);
+    IngestDecoder pooled(kKey, sizeof(kKey), 4);
+    EXPECT_EQ(pooled.threads(), 4u);
+    for (int round = 0; round < 3; ++round) {
+        std::vector<ew_sample> a, b;
+        std::vector<ew_ingest_result> ra(bodies.size()), rb(bodies.size());
+        serial.decodeEnvelopes(ptrs.data(), lens.data(), bodies.size(), a, ra.data());
+        pooled.decodeEnvelopes(ptrs.data(), lens.data(), bodies.size(), b, rb.data());
+        ASSERT_EQ(a.size(), b.size());
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            EXPECT_EQ(ra[i].status, i == 17 ? EW_INGEST_BAD_MAC : EW_INGEST_OK);
+            EXPECT_EQ(rb[i].status, ra[i].status);
+            EXPECT_EQ(rb[i].nonce, i == 17 ? 18u : i + 1);
+            EXPECT_EQ(rb[i].sample_offset, ra[i].sample_offset);
+            EXPECT_EQ(rb[i].sample_count, i == 17 ? 0u : 1 + i % 50);
+            if (rb[i].sample_count) {
+                EXPECT_EQ(b[rb[i].sample_offset].timestamp, (uint32_t)i * 100000);
+            }
+        }
+    }
+}
+
+TEST(IngestDecoderTest, CApiPlacesWholeUploadsOnly) {
+    ew_ingest* ingest = ew_ingest_create(kKey, sizeof(kKey), 2);
+    ASSERT_NE(ingest, nullptr);
+    EXPECT_EQ(ew_ingest_create(kKey, 0, 1), nullptr);
+
+    std::vector<std::string> bodies;
+    for (uint32_t i = 0; i < 3; ++i) {
+        std::vector<uint8_t> payload;
+        std::vector<Sample> samples = makeSamples(10);
+        encodeRawBatch(samples.data(), samples.size(), payload);
+        bodies.push_back(seal(payload, i + 1));
+    }
+    const char* ptrs[3] = {bodies[0].data(), bodies[1].data(), bodies[2].data()};
+    size_t lens[3] = {bodies[0].size(), bodies[1].size(), bodies[2].size()};
+    ASSERT_GE(ew_ingest_sample_bound(lens[0]), 10u);
+
+    ew_sample samples[25];
+    ew_ingest_result results[3];
+    EXPECT_EQ(ew_ingest_envelopes(ingest, ptrs, lens, 3, samples, 25, results), 20u);
+    EXPECT_EQ(results[0].status, EW_INGEST_OK);
+    EXPECT_EQ(results[1].sample_offset, 10u);
+    EXPECT_EQ(results[2].status, EW_INGEST_NO_ROOM);
+    EXPECT_EQ(results[2].sample_count, 0u);
+
+    ew_ingest_result one;
+    EXPECT_EQ(ew_ingest_envelope(ingest, ptrs[0], lens[0], samples, 9, &one), EW_INGEST_NO_ROOM);
+    EXPECT_EQ(ew_ingest_envelope(ingest, ptrs[0], lens[0], samples, 10, &one), EW_INGEST_OK);
+    EXPECT_EQ(one.sample_count, 10u);
+    ew_ingest_destroy(ingest);
+}
@@ -0,0 +1,167 @@
+/**
+ * @file test_io_buf.cpp
+ * @brief Tests for the refcounted uplink buffer chain and the envelope built on it
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "io_buf.hpp"
+#include "secure_envelope.hpp"
+#include <string>
+#include <vector>
+
+static const uint8_t kKey[32] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+                                 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32};
+
+// The string pipeline SecurityLayer used before: base64, then HMAC over the concatenation
+static std::string referenceEnvelope(const std::string& payload, uint32_t nonce, uint32_t ts, bool encrypted) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string text;
+    size_t i = 0;
+    for (; i + 3 <= payload.size(); i += 3) {
+        uint32_t v = ((uint8_t)payload[i] << 16) | ((uint8_t)payload[i + 1] << 8) | (uint8_t)payload[i + 2];
+        for (int k = 3; k >= 0; --k) text += b64[(v >> (6 * k)) & 0x3F];
+    }
+    if (payload.size() - i == 1) {
+        uint32_t v = (uint8_t)payload[i] << 16;
+        text += b64[v >> 18];
+        text += b64[(v >> 12) & 0x3F];
+        text += "==";
+    } else if (payload.size() - i == 2) {
+        uint32_t v = ((uint8_t)payload[i] << 16) | ((uint8_t)payload[i + 1] << 8);
+        text += b64[v >> 18];
+        text += b64[(v >> 12) & 0x3F];
+        text += b64[(v >> 6) & 0x3F];
+        text += '=';
+    }
+    std::string input = std::to_string(nonce) + std::to_string(ts) + (encrypted ? "1" : "0") + text;
+    HmacSha256 hmac(kKey, sizeof(kKey), Sha256Backend::PORTABLE);
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    hmac.compute((const uint8_t*)input.data(), input.size(), mac);
+    std::string hex;
+    for (uint8_t b : mac) {
+        hex += "0123456789abcdef"[b >> 4];
+        hex += "0123456789abcdef"[b & 0x0F];
+    }
+    return "{\"nonce\":" + std::to_string(nonce) + ",\"timestamp\":" + std::to_string(ts) +
+           ",\"encrypted\":" + (encrypted ? "true" : "false") + ",\"payload\":\"" + text + "\",\"mac\":\"" + hex + "\"}";
+}
+
+TEST(IoBufTest, SlicesShareBlocksAndReturnThemToThePool) {
+    IoBufPool pool(256, 2);
+    {
+        IoChain chain(&pool);
+        ASSERT_TRUE(chain.appendCopy("hello, world", 12));
+        IoChain tail = chain.slice(7, 5);
+        EXPECT_EQ(tail.toString(), "world");
+        EXPECT_EQ(tail[0].data(), chain[0].data() + 7);   // same memory, no copy
+        EXPECT_EQ(pool.stats().in_use, 1u);
+        chain.clear();
+        EXPECT_EQ(pool.stats().in_use, 1u);   // still referenced by the slice
+    }
+    EXPECT_EQ(pool.stats().in_use, 0u);
+    EXPECT_EQ(pool.stats().bytes_copied, 12u);
+}
+
+TEST(IoBufTest, HeadroomAndTailroomOnlyForTheSliceAtTheEdge) {
+    IoBufPool pool(64, 2);
+    IoChain a(&pool);
+    size_t avail = 0;
+    uint8_t* p = a.tailSpace(avail, 16);
+    ASSERT_NE(p, nullptr);
+    EXPECT_EQ(avail, 48u);
+    memcpy(p, "payload", 7);
+    a.commit(7);
+    EXPECT_EQ(a[0].headroom(), 16u);
+
+    // A slice from the middle of the block must not be able to grow over its neighbours
+    IoChain mid = a.slice(2, 3);
+    EXPECT_EQ(mid[0].headroom(), 0u);
+    EXPECT_EQ(mid[0].tailroom(), 0u);
+
+    ASSERT_TRUE(a.prependCopy("hdr:", 4));
+    ASSERT_TRUE(a.appendCopy(":mac", 4));
+    EXPECT_EQ(a.count(), 1u);
+    EXPECT_EQ(a.toString(), "hdr:payload:mac");
+    EXPECT_EQ(mid.toString(), "ylo");
+
+    // Header larger than the headroom goes in front as its own slice
+    std::string big(20, 'H');
+    ASSERT_TRUE(a.prependCopy(big.data(), big.size()));
+    EXPECT_EQ(a.count(), 2u);
+    EXPECT_EQ(a.toString(), big + "hdr:payload:mac");
+}
+
+TEST(IoBufTest, WrappedMemoryIsNeverWritten) {
+    IoBufPool pool(32, 1);
+    const uint8_t external[4] = {1, 2, 3, 4};
+    IoChain c(&pool);
+    c.append(IoBuf::wrap(external, sizeof(external)));
+    EXPECT_EQ(c[0].tailroom(), 0u);
+    ASSERT_TRUE(c.appendCopy("x", 1));
+    EXPECT_EQ(c.count(), 2u);
+    EXPECT_EQ(pool.stats().bytes_copied, 1u);
+    uint8_t out[5];
+    EXPECT_EQ(c.copyOut(0, out, sizeof(out)), 5u);
+    EXPECT_EQ(out[3], 4);
+    EXPECT_EQ(out[4], 'x');
+}
+
+TEST(IoBufTest, PoolOverflowFallsBackToTheHeap) {
+    IoBufPool pool(16, 1);
+    IoChain c(&pool);
+    std::string data(50, 'z');
+    ASSERT_TRUE(c.appendCopy(data.data(), data.size()));
+    EXPECT_EQ(c.count(), 4u);
+    EXPECT_EQ(c.toString(), data);
+    EXPECT_EQ(pool.stats().overflow, 3u);
+    c.clear();
+    EXPECT_EQ(pool.stats().in_use, 0u);
+}
+
+TEST(SecureEnvelopeTest, MatchesTheStringPipelineForEveryPaddingCase) {
+    IoBufPool pool(2048, 4);
+    HmacSha256 hmac(kKey, sizeof(kKey), Sha256Backend::PORTABLE);
+    for (size_t len : {0u, 1u, 2u, 3u, 100u, 1024u}) {
+        std::vector<uint8_t> raw(len);
+        for (size_t i = 0; i < len; ++i) raw[i] = (uint8_t)(i * 31 + 7);
+        IoChain payload(&pool);
+        payload.append(IoBuf::wrap(raw.data(), raw.size()));
+        IoChain env(&pool);
+        ASSERT_TRUE(sealEnvelope(payload, 4000000000u, 123456, len % 2 == 0, hmac, env));
+        EXPECT_EQ(env.toString(), referenceEnvelope(std::string(raw.begin(), raw.end()), 4000000000u, 123456, len % 2 == 0))
+            << "len " << len;
+    }
+}
+
+TEST(SecureEnvelopeTest, ChunkEnvelopeIsOneSliceAndCopiesOnlyWhatItSends) {
+    IoBufPool pool(2048, 4);
+    HmacSha256 hmac(kKey, sizeof(kKey), Sha256Backend::PORTABLE);
+    std::vector<uint8_t> encoded(3000, 0xA5);
+    IoChain all(&pool);
+    all.append(IoBuf::wrap(encoded.data(), encoded.size()));
+
+    // A 1 KB upload chunk cut from a payload split across two slices
+    IoChain payload = all.slice(0, 600);
+    payload.append(all.slice(600, 424));
+    ASSERT_EQ(payload.count(), 2u);
+
+    IoChain env(&pool);
+    ASSERT_TRUE(sealEnvelope(payload, 7, 8, false, hmac, env));
+    EXPECT_EQ(env.count(), 1u);   // prefix in headroom, MAC in tailroom
+    EXPECT_EQ(pool.stats().bytes_copied, env.length());
+    EXPECT_EQ(env.toString(), referenceEnvelope(payload.toString(), 7, 8, false));
+}
+
+TEST(SecureEnvelopeTest, LongPayloadSpansBlocks) {
+    IoBufPool pool(512, 2);
+    HmacSha256 hmac(kKey, sizeof(kKey), Sha256Backend::PORTABLE);
+    std::string raw(2000, 'q');
+    IoChain payload(&pool);
+    payload.append(IoBuf::wrap((const uint8_t*)raw.data(), raw.size()));
+    IoChain env(&pool);
+    ASSERT_TRUE(sealEnvelope(payload, 1, 2, true, hmac, env));
+    EXPECT_GT(env.count(), 1u);
+    EXPECT_EQ(env.toString(), referenceEnvelope(raw, 1, 2, true));
+}
@@ -0,0 +1,254 @@
+/**
+ * @file test_log_segment.cpp
+ * @brief Tests for compressed log staging and block encoding
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "log_segment.hpp"
+#include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static size_t fillStaging(LogStaging& staging, size_t max_lines) {
+    size_t n = 0;
+    char line[96];
+    while (n < max_lines) {
+        int len = snprintf(line, sizeof(line), "[Uplink] fidelity=full samples=%u batches=1 payload=%u bytes",
+                           (unsigned)(n % 40), (unsigned)(n * 9 % 1024));
+        if (!staging.append(1000 + n * 250, 1, line, (size_t)len)) break;
+        ++n;
+    }
+    return n;
+}
+
+TEST(LzssTest, RoundTripsTextAndIncompressibleData) {
+    std::unique_ptr<LzssEncoder> enc(new LzssEncoder());
+    std::string text;
+    for (int i = 0; i < 60; ++i) text += "[Modbus] Read OK slave=1 reg=" + std::to_string(i % 10) + "\n";
+    std::vector<uint8_t> out(text.size());
+    size_t n = enc->compress((const uint8_t*)text.data(), text.size(), out.data(), out.size());
+    ASSERT_GT(n, 0u);
+    EXPECT_LT(n, text.size() / 3);
+    std::vector<uint8_t> back(text.size());
+    ASSERT_TRUE(lzssDecompress(out.data(), n, back.data(), back.size()));
+    EXPECT_EQ(std::string(back.begin(), back.end()), text);
+
+    // Pseudo-random bytes do not fit in an output no larger than the input
+    std::vector<uint8_t> noise(512);
+    uint32_t x = 12345;
+    for (auto& b : noise) { x = x * 1103515245u + 12345u; b = (uint8_t)(x >> 16); }
+    std::vector<uint8_t> small(noise.size());
+    EXPECT_EQ(enc->compress(noise.data(), noise.size(), small.data(), small.size() - 1), 0u);
+}
+
+TEST(LzssTest, RejectsMalformedStreams) {
+    uint8_t out[16];
+    const uint8_t bad_offset[] = {0x01, 0x05, 0x00};   // match before any output
+    EXPECT_FALSE(lzssDecompress(bad_offset, sizeof(bad_offset), out, 4));
+    const uint8_t truncated[] = {0x00, 'a', 'b'};
+    EXPECT_FALSE(lzssDecompress(truncated, sizeof(truncated), out, 4));
+}
+
+TEST(LogStagingTest, AppendsUntilFullAndSignalsDue) {
+    LogStagingArea area;
+    LogStaging staging(&area);
+    staging.reset(3);
+    EXPECT_TRUE(staging.empty());
+    EXPECT_FALSE(staging.due(0, 60000, 3));
+
+    ASSERT_TRUE(staging.append(1000, 1, "boot", 4));
+    EXPECT_FALSE(staging.due(2000, 60000, 3));
+    EXPECT_TRUE(staging.due(61000, 60000, 3));    // oldest line too old
+    ASSERT_TRUE(staging.append(1500, 3, "error", 5));
+    EXPECT_TRUE(staging.due(1600, 60000, 3));     // severe line
+
+    staging.reset(3);
+    size_t lines = fillStaging(staging, 1000);
+    EXPECT_GT(lines, 20u);
+    EXPECT_TRUE(staging.due(0, 60000, 3));        // nearly full
+    char big[LOG_MAX_LINE];
+    memset(big, 'x', sizeof(big));
+    EXPECT_FALSE(staging.append(0, 1, big, sizeof(big)));
+    EXPECT_LE(staging.used(), LOG_STAGING_BYTES);
+}
+
+TEST(LogStagingTest, FullAreaDropsLinesAndLeavesStagedOnesAlone) {
+    LogStagingArea area;
+    LogStaging staging(&area);
+    staging.reset(3);
+    size_t lines = fillStaging(staging, 1000);   // stops at the first refused line
+    LogStagingArea before = area;
+
+    // No commit path behind append: a full area only counts what it refused
+    char big[LOG_MAX_LINE];
+    memset(big, 'x', sizeof(big));
+    for (int i = 0; i < 50; ++i) EXPECT_FALSE(staging.append(99000, 3, big, sizeof(big)));
+    EXPECT_EQ(memcmp(&area, &before, offsetof(LogStagingArea, data) + before.used), 0);
+    LogStagingCounters c = staging.counters();
+    EXPECT_EQ(c.lines, lines + 51);
+    EXPECT_EQ(c.dropped, 51u);
+}
+
+TEST(LogStagingTest, ConsumeKeepsLinesStagedAfterTheSnapshot) {
+    LogStagingArea area, snap;
+    LogStaging staging(&area);
+    staging.reset(4);
+    EXPECT_FALSE(staging.snapshot(snap));
+    ASSERT_TRUE(staging.append(100, 3, "first", 5));
+    ASSERT_TRUE(staging.append(200, 1, "second", 6));
+    ASSERT_TRUE(staging.snapshot(snap));
+    EXPECT_EQ(snap.lines, 2u);
+
+    // Logged while the block was being written
+    ASSERT_TRUE(staging.append(300, 2, "third", 5));
+    staging.consume(snap);
+    EXPECT_EQ(area.lines, 1u);
+    EXPECT_EQ(area.first_ms, 300u);
+    EXPECT_EQ(area.last_ms, 300u);
+    EXPECT_EQ(area.max_level, 2u);                // the error was committed with the snapshot
+    EXPECT_FALSE(staging.due(400, 60000, 3));
+    std::vector<LogRecord> records;
+    ASSERT_TRUE(parseLogRecords(area.data, area.used, records));
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].text, "third");
+
+    ASSERT_TRUE(staging.snapshot(snap));
+    staging.consume(snap);
+    EXPECT_TRUE(staging.empty());
+}
+
+TEST(LogStagingTest, LoggingTasksNeverWaitForTheCommit) {
+    LogStagingArea area;
+    LogStaging staging(&area);
+    staging.reset(5);
+    const int writers = 4, per_writer = 400;
+    std::atomic<bool> done{false};
+    std::atomic<uint32_t> committed{0};
+    std::atomic<long long> worst_append_us{0};
+
+    // The log task: snapshot, a slow "flash write" with no lock held, then consume
+    std::thread committer([&] {
+        LogStagingArea snap;
+        while (!done) {
+            if (!staging.snapshot(snap)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            committed += snap.lines;
+            staging.consume(snap);
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&, w] {
+            char line[64];
+            for (int i = 0; i < per_writer; ++i) {
+                int len = snprintf(line, sizeof(line), "[Task%d] line %d", w, i);
+                auto t0 = std::chrono::steady_clock::now();
+                staging.append((uint32_t)i, 1, line, (size_t)len);
+                long long us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::steady_clock::now() - t0).count();
+                long long prev = worst_append_us;
+                while (us > prev && !worst_append_us.compare_exchange_weak(prev, us)) {}
+                if (i % 16 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    done = true;
+    committer.join();
+
+    LogStagingCounters c = staging.counters();
+    EXPECT_EQ(c.lines, (uint32_t)(writers * per_writer));
+    EXPECT_EQ(committed + area.lines + c.dropped, c.lines);
+    EXPECT_GT(committed.load(), 0u);
+    // Far below the 20 ms write: an append only ever waits for another memcpy
+    EXPECT_LT(worst_append_us.load(), 10000);
+    std::vector<LogRecord> records;
+    EXPECT_TRUE(parseLogRecords(area.data, area.used, records));
+    EXPECT_EQ(records.size(), area.lines);
+}
+
+TEST(LogStagingTest, RecoversLinesLeftByPreviousBoot) {
+    LogStagingArea area;
+    memset(&area, 0xA5, sizeof(area));   // power-on garbage
+    LogStaging staging(&area);
+    uint32_t boot = 0;
+    EXPECT_FALSE(staging.recover(boot));
+
+    staging.reset(7);
+    staging.append(100, 3, "panic soon", 10);
+    LogStaging after_reset(&area);
+    ASSERT_TRUE(after_reset.recover(boot));
+    EXPECT_EQ(boot, 7u);
+
+    area.lines = 5;   // header disagrees with the records
+    EXPECT_FALSE(after_reset.recover(boot));
+}
+
+TEST(LogBlockTest, EncodeDecodeRoundTrip) {
+    LogStagingArea area;
+    LogStaging staging(&area);
+    staging.reset(2);
+    size_t lines = fillStaging(staging, 40);
+    std::unique_ptr<LzssEncoder> enc(new LzssEncoder());
+
+    std::vector<uint8_t> block;
+    ASSERT_TRUE(encodeLogBlock(area, 17, *enc, block));
+    EXPECT_LT(block.size(), staging.used() / 2);
+
+    LogBlockHeader h;
+    std::vector<uint8_t> raw;
+    ASSERT_TRUE(decodeLogBlock(block.data(), block.size(), h, raw));
+    EXPECT_EQ(h.boot, 2u);
+    EXPECT_EQ(h.seq, 17u);
+    EXPECT_EQ(h.lines, lines);
+    EXPECT_EQ(h.first_ms, 1000u);
+    EXPECT_EQ(h.blockSize(), block.size());
+    EXPECT_TRUE(h.flags & LOG_BLOCK_COMPRESSED);
+
+    std::vector<LogRecord> records;
+    ASSERT_TRUE(parseLogRecords(raw.data(), raw.size(), records));
+    ASSERT_EQ(records.size(), lines);
+    EXPECT_EQ(records[3].ms, 1750u);
+    EXPECT_EQ(records[3].text.compare(0, 8, "[Uplink]"), 0);
+
+    EXPECT_TRUE(h.overlaps(0, 1000));
+    EXPECT_FALSE(h.overlaps(h.last_ms + 1, h.last_ms + 5000));
+}
+
+TEST(LogBlockTest, CorruptionIsDetected) {
+    LogStagingArea area;
+    LogStaging staging(&area);
+    staging.reset(1);
+    fillStaging(staging, 10);
+    std::unique_ptr<LzssEncoder> enc(new LzssEncoder());
+    std::vector<uint8_t> block;
+    ASSERT_TRUE(encodeLogBlock(area, 0, *enc, block));
+
+    LogBlockHeader h;
+    std::vector<uint8_t> raw;
+    block[LOG_BLOCK_HEADER_SIZE + 3] ^= 0x40;
+    EXPECT_FALSE(decodeLogBlock(block.data(), block.size(), h, raw));
+    EXPECT_FALSE(parseLogBlockHeader(block.data(), block.size() - 1, h));
+}
+
+TEST(LogStoreStatsTest, WriteAmplificationAccounting) {
+    LogStoreStats stats;
+    stats.lines = 100;
+    stats.text_bytes = 6000;
+    stats.recordAppend(700);   // 3 data pages + 1 metadata page
+    EXPECT_EQ(stats.flash_bytes, 1024u);
+    EXPECT_EQ(stats.blocks, 1u);
+    EXPECT_NEAR(stats.writeAmplification(), 1024.0f / 6000.0f, 1e-6);
+    EXPECT_NEAR(stats.flashBytesPerLine(), 10.24f, 1e-4);
+    EXPECT_NE(stats.toJson().find("\"write_amplification\":0.171"), std::string::npos);
+}
@@ -0,0 +1,203 @@
+/**
+ * @file test_modbus_read_write.cpp
+ * @brief Tests for command writes over Modbus 0x17 (write + readback in one request) and the 0x06 + 0x03 fallback
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "modbus_frame.hpp"
+#include "modbus_tcp.hpp"
+#include "modbus_tcp_loopback.hpp"
+#include <chrono>
+#include <cstdio>
+#include <map>
+
+namespace {
+// 0x17 writing value to reg and reading reg back, as ProtocolAdapter sends it
+bool readWrite(ModbusTcpClient& client, uint16_t reg, uint16_t value, uint16_t& readback, uint8_t& exception) {
+    uint8_t pdu[12], rsp[ModbusTcpClient::MAX_PDU];
+    size_t len = modbus_read_write_pdu(pdu, reg, 1, reg, 1, &value);
+    size_t rsp_len = 0;
+    exception = 0;
+    if (!len || !client.transact(pdu, len, rsp, sizeof(rsp), rsp_len)) return false;
+    if (rsp[0] == (0x17 | 0x80)) {
+        exception = rsp[1];
+        return false;
+    }
+    return rsp[0] == 0x17 && modbus_read_values(rsp, rsp_len, 1, &readback);
+}
+
+// 0x17 writing value to reg and reading back ModbusReadback::around(reg), as CommandExecutor sends it
+bool readWriteBlock(ModbusTcpClient& client, uint16_t reg, uint16_t value, const ModbusReadback& block,
+                    uint16_t* values) {
+    uint8_t pdu[12], rsp[ModbusTcpClient::MAX_PDU];
+    size_t len = modbus_read_write_pdu(pdu, block.start, block.count, reg, 1, &value);
+    size_t rsp_len = 0;
+    if (!len || !client.transact(pdu, len, rsp, sizeof(rsp), rsp_len)) return false;
+    return rsp[0] == 0x17 && modbus_read_values(rsp, rsp_len, block.count, values);
+}
+
+// Gains from the inverter register map (ConfigManager::getRegisterGain)
+float registerGain(uint16_t reg) {
+    static const float gains[10] = {10, 10, 100, 10, 10, 10, 10, 10, 1, 1};
+    return reg < 10 ? gains[reg] : 0;
+}
+
+// The fallback: 0x06 write, then a 0x03 read to confirm it
+bool writeThenRead(ModbusTcpClient& client, uint16_t reg, uint16_t value, uint16_t& readback) {
+    uint8_t write[5] = {0x06, (uint8_t)(reg >> 8), (uint8_t)reg, (uint8_t)(value >> 8), (uint8_t)value};
+    uint8_t rsp[ModbusTcpClient::MAX_PDU];
+    size_t rsp_len = 0;
+    if (!client.transact(write, sizeof(write), rsp, sizeof(rsp), rsp_len) || rsp_len != 5) return false;
+    uint8_t read[5] = {0x03, (uint8_t)(reg >> 8), (uint8_t)reg, 0, 1};
+    if (!client.transact(read, sizeof(read), rsp, sizeof(rsp), rsp_len) || rsp[0] != 0x03) return false;
+    return modbus_read_values(rsp, rsp_len, 1, &readback);
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+}
+
+TEST(ModbusReadWriteTest, PduLayoutAndReplyParsing) {
+    const uint16_t values[2] = {0x1234, 0xABCD};
+    uint8_t pdu[14];
+    ASSERT_EQ(modbus_read_write_pdu(pdu, 0x0102, 3, 0x0A0B, 2, values), 14u);
+    const uint8_t want[14] = {0x17, 0x01, 0x02, 0x00, 0x03, 0x0A, 0x0B, 0x00, 0x02, 0x04, 0x12, 0x34, 0xAB, 0xCD};
+    for (size_t i = 0; i < sizeof(want); ++i) EXPECT_EQ(pdu[i], want[i]) << "byte " << i;
+    EXPECT_EQ(modbus_read_write_pdu(pdu, 0, 0, 0, 1, values), 0u);
+    EXPECT_EQ(modbus_read_write_pdu(pdu, 0, 126, 0, 1, values), 0u);
+    EXPECT_EQ(modbus_read_write_pdu(pdu, 0, 1, 0, 0, values), 0u);
+
+    const uint8_t reply[6] = {0x17, 0x04, 0x00, 0x2A, 0x01, 0x00};
+    uint16_t got[2] = {};
+    ASSERT_TRUE(modbus_read_values(reply, sizeof(reply), 2, got));
+    EXPECT_EQ(got[0], 42);
+    EXPECT_EQ(got[1], 256);
+    EXPECT_FALSE(modbus_read_values(reply, sizeof(reply), 3, got));   // byte count says 2
+    EXPECT_FALSE(modbus_read_values(reply, 4, 2, got));               // truncated
+}
+
+TEST(ModbusReadWriteTest, ReadbackIsTheWrittenRegister) {
+    LoopbackModbusServer server;
+    ModbusTcpClient client("127.0.0.1", server.port(), 1, 1000, 1);
+    // Any register, not only the export/output power block at 8-9
+    for (uint16_t reg : {0, 3, 8, 9, 10, 40}) {
+        uint16_t value = (uint16_t)(1000 + reg), readback = 0;
+        uint8_t exception = 0;
+        ASSERT_TRUE(readWrite(client, reg, value, readback, exception)) << "register " << reg;
+        EXPECT_EQ(readback, value) << "register " << reg;
+        EXPECT_EQ(server.reg(reg), value);
+    }
+}
+
+TEST(ModbusReadWriteTest, ReadbackBlockCoversStatusAndPower) {
+    ModbusReadback b = ModbusReadback::around(8);
+    EXPECT_EQ(b.start, 8);
+    EXPECT_EQ(b.count, 2);
+    b = ModbusReadback::around(3);
+    EXPECT_EQ(b.start, 3);
+    EXPECT_EQ(b.count, 7);
+    b = ModbusReadback::around(40);
+    EXPECT_EQ(b.start, 8);
+    EXPECT_EQ(b.count, 33);
+    EXPECT_TRUE(b.covers(8) && b.covers(9) && b.covers(40));
+    EXPECT_FALSE(b.covers(7) || b.covers(41));
+    // Too far for one read: only the written register
+    b = ModbusReadback::around(500);
+    EXPECT_EQ(b.start, 500);
+    EXPECT_EQ(b.count, 1);
+}
+
+TEST(ModbusReadWriteTest, ReadbackPublishesEveryRegisterScaled) {
+    LoopbackModbusServer server;
+    ModbusTcpClient client("127.0.0.1", server.port(), 1, 1000, 1);
+    for (uint16_t reg : {3, 8}) {
+        ModbusReadback block = ModbusReadback::around(reg);
+        uint16_t values[ModbusReadback::MAX_COUNT];
+        uint16_t value = (uint16_t)(500 + reg);
+        ASSERT_TRUE(readWriteBlock(client, reg, value, block, values)) << "register " << reg;
+        EXPECT_EQ(values[reg - block.start], value);
+
+        std::map<uint16_t, float> latest;
+        block.publish(values, registerGain, [&](uint16_t r, float v) { latest[r] = v; });
+        ASSERT_EQ(latest.size(), block.count);
+        for (uint16_t r = block.start; r < block.start + block.count; ++r) {
+            EXPECT_FLOAT_EQ(latest[r], server.reg(r) / registerGain(r)) << "register " << r;
+        }
+        EXPECT_FLOAT_EQ(latest[reg], value / registerGain(reg));
+        EXPECT_FLOAT_EQ(latest[ModbusReadback::POWER_REG], server.reg(ModbusReadback::POWER_REG));
+    }
+    // Unknown registers (gain 0) are published unscaled
+    ModbusReadback block = ModbusReadback::around(12);
+    uint16_t values[ModbusReadback::MAX_COUNT];
+    ASSERT_TRUE(readWriteBlock(client, 12, 34, block, values));
+    std::map<uint16_t, float> latest;
+    block.publish(values, registerGain, [&](uint16_t r, float v) { latest[r] = v; });
+    EXPECT_FLOAT_EQ(latest[12], 34);
+}
+
+TEST(ModbusReadWriteTest, FallsBackOnlyWhenTheFunctionIsMissing) {
+    LoopbackModbusServer::Options opts;
+    opts.no_read_write = true;
+    LoopbackModbusServer server(opts);
+    ModbusTcpClient client("127.0.0.1", server.port(), 1, 1000, 1);
+    ModbusReadWriteSupport support;
+    uint32_t now = 5000;
+
+    uint16_t readback = 0;
+    uint8_t exception = 0;
+    ASSERT_TRUE(support.usable(now));
+    EXPECT_FALSE(readWrite(client, 4, 77, readback, exception));
+    EXPECT_EQ(exception, 0x01);
+    EXPECT_TRUE(support.onFailure(exception, 0, now));
+    EXPECT_FALSE(support.usable(now + 1000));
+
+    // The command still goes through, as write + read
+    ASSERT_TRUE(writeThenRead(client, 4, 77, readback));
+    EXPECT_EQ(readback, 77);
+
+    // Tried again later; a success keeps it on
+    EXPECT_TRUE(support.usable(now + ModbusReadWriteSupport::REPROBE_MS));
+    support.onSuccess();
+    EXPECT_TRUE(support.usable(now + ModbusReadWriteSupport::REPROBE_MS + 1));
+    EXPECT_FALSE(support.disabled());
+}
+
+TEST(ModbusReadWriteTest, TransientErrorsKeepReadWrite) {
+    ModbusReadWriteSupport support;
+    for (int status : {0, 401, 403, 408, 429, 500, 502, 503}) {
+        EXPECT_FALSE(support.onFailure(0, status, 100)) << "status " << status;
+        EXPECT_TRUE(support.usable(100)) << "status " << status;
+    }
+    EXPECT_FALSE(support.onFailure(0x02, 0, 100));   // illegal address: the request, not the function
+    EXPECT_FALSE(support.onFailure(0x06, 0, 100));   // slave busy
+    EXPECT_TRUE(support.usable(100));
+    for (int status : {400, 404, 405, 501}) {
+        ModbusReadWriteSupport s;
+        EXPECT_TRUE(s.onFailure(0, status, 100)) << "status " << status;
+        EXPECT_FALSE(s.usable(101)) << "status " << status;
+    }
+}
+
+TEST(ModbusReadWriteTest, OneRoundTripInsteadOfTwo) {
+    LoopbackModbusServer::Options opts;
+    opts.latency_us = 20000;   // a gateway across the network
+    LoopbackModbusServer server(opts);
+    ModbusTcpClient client("127.0.0.1", server.port(), 1, 2000, 1);
+    ASSERT_TRUE(client.connect());
+
+    const int writes = 5;
+    uint16_t readback = 0;
+    uint8_t exception = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < writes; ++i) ASSERT_TRUE(readWrite(client, 8, (uint16_t)i, readback, exception));
+    double rw_ms = elapsedMs(t0);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < writes; ++i) ASSERT_TRUE(writeThenRead(client, 8, (uint16_t)i, readback));
+    double fallback_ms = elapsedMs(t0);
+
+    printf("  confirmed write: 0x17 %.1f ms, 0x06 + 0x03 %.1f ms\n", rw_ms / writes, fallback_ms / writes);
+    EXPECT_LT(rw_ms, fallback_ms * 0.7);
+}
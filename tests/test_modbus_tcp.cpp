@@ -0,0 +1,246 @@
+/**
+ * @file test_modbus_tcp.cpp
+ * @brief Tests for the Modbus TCP client: MBAP framing, pipelining, transaction-ID matching
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "modbus_tcp.hpp"
+#include "modbus_tcp_loopback.hpp"
+#include <vector>
+
+static LoopbackModbusServer::Options withLatency(uint32_t latency_us) {
+    LoopbackModbusServer::Options opts;
+    opts.latency_us = latency_us;
+    return opts;
+}
+
+TEST(ModbusTcpTest, ReadRangeSplitsAndPipelines) {
+    LoopbackModbusServer server;
+    ModbusTcpClient client("127.0.0.1", server.port(), 17, 1000, 4);
+    ASSERT_TRUE(client.connect());
+
+    std::vector<uint16_t> values(1000);
+    ASSERT_TRUE(client.readRange(0x03, 100, values.size(), values.data()));
+    for (size_t i = 0; i < values.size(); ++i) {
+        ASSERT_EQ(values[i], LoopbackModbusServer::expected((uint16_t)(100 + i))) << "register " << 100 + i;
+    }
+    EXPECT_EQ(client.stats().requests, 8u);   // 1000 registers in 125-register requests
+    EXPECT_EQ(client.stats().responses, 8u);
+    EXPECT_EQ(client.stats().max_in_flight_seen, 4u);
+    EXPECT_EQ(client.stats().connects, 1u);
+}
+
+TEST(ModbusTcpTest, OutOfOrderRepliesMatchedByTransactionId) {
+    LoopbackModbusServer::Options opts = withLatency(2000);
+    opts.reverse = true;
+    LoopbackModbusServer server(opts);
+    ModbusTcpClient client("127.0.0.1", server.port(), 17, 1000, 8);
+
+    std::vector<uint16_t> values(8);
+    std::vector<ModbusRead> reads(8);
+    for (size_t i = 0; i < reads.size(); ++i) {
+        reads[i].function = (i % 2) ? 0x04 : 0x03;
+        reads[i].start = (uint16_t)(i * 37);
+        reads[i].values = &values[i];
+    }
+    EXPECT_EQ(client.readBatch(reads.data(), reads.size()), reads.size());
+    for (size_t i = 0; i < reads.size(); ++i) {
+        EXPECT_TRUE(reads[i].ok);
+        EXPECT_EQ(values[i], LoopbackModbusServer::expected((uint16_t)(i * 37)));
+    }
+    EXPECT_EQ(client.stats().stray, 0u);
+}
+
+TEST(ModbusTcpTest, ExceptionReplyFailsOnlyThatRead) {
+    LoopbackModbusServer server;
+    ModbusTcpClient client("127.0.0.1", server.port(), 17, 1000, 4);
+
+    uint16_t a = 0, b[100], c = 0;
+    ModbusRead reads[3];
+    reads[0].start = 5;
+    reads[0].values = &a;
+    reads[1].start = 65500;   // runs past the end of the register file
+    reads[1].count = 100;
+    reads[1].values = b;
+    reads[2].start = 6;
+    reads[2].values = &c;
+    EXPECT_EQ(client.readBatch(reads, 3), 2u);
+    EXPECT_TRUE(reads[0].ok);
+    EXPECT_FALSE(reads[1].ok);
+    EXPECT_EQ(reads[1].exception, 0x02);
+    EXPECT_TRUE(reads[2].ok);
+    EXPECT_EQ(c, LoopbackModbusServer::expected(6));
+}
+
+TEST(ModbusTcpTest, LateReplyAfterTimeoutIsDiscarded) {
+    LoopbackModbusServer server(withLatency(150000));
+    ModbusTcpClient client("127.0.0.1", server.port(), 17, 50, 1);
+
+    uint16_t value = 0;
+    EXPECT_FALSE(client.readRange(0x03, 10, 1, &value));
+    EXPECT_EQ(client.stats().timeouts, 1u);
+
+    // The first reply arrives while this one is in flight and must not be taken for it
+    client.setTimeoutMs(1000);
+    EXPECT_TRUE(client.readRange(0x03, 20, 1, &value));
+    EXPECT_EQ(value, LoopbackModbusServer::expected(20));
+    EXPECT_EQ(client.stats().stray, 1u);
+    EXPECT_EQ(client.stats().connects, 1u);
+}
+
+TEST(ModbusTcpTest, ReconnectsOnceWhenTheServerDropsTheConnection) {
+    LoopbackModbusServer::Options opts;
+    opts.close_after = 3;
+    LoopbackModbusServer server(opts);
+    ModbusTcpClient client("127.0.0.1", server.port(), 17, 1000, 1);
+
+    std::vector<uint16_t> values(5);
+    std::vector<ModbusRead> reads(5);
+    for (size_t i = 0; i < reads.size(); ++i) {
+        reads[i].start = (uint16_t)i;
+        reads[i].values = &values[i];
+    }
+    // The read in flight when the connection went away fails; the rest go out on a new one
+    EXPECT_EQ(client.readBatch(reads.data(), reads.size()), 4u);
+    EXPECT_FALSE(reads[3].ok);
+    EXPECT_TRUE(reads[4].ok);
+    EXPECT_EQ(values[4], LoopbackModbusServer::expected(4));
+    EXPECT_EQ(client.stats().connects, 2u);
+    EXPECT_EQ(client.stats().disconnects, 1u);
+    EXPECT_EQ(server.connections(), 2u);
+}
+
+TEST(ModbusTcpTest, TransactWriteSingleRegister) {
+    LoopbackModbusServer server;
+    ModbusTcpClient client("127.0.0.1", server.port(), 17, 1000, 4);
+
+    const uint8_t pdu[] = {0x06, 0x00, 0x08, 0x00, 0x4B};
+    uint8_t reply[ModbusTcpClient::MAX_PDU];
+    size_t reply_len = 0;
+    ASSERT_TRUE(client.transact(pdu, sizeof(pdu), reply, sizeof(reply), reply_len));
+    ASSERT_EQ(reply_len, sizeof(pdu));
+    EXPECT_EQ(memcmp(reply, pdu, sizeof(pdu)), 0);
+    EXPECT_EQ(server.reg(8), 75);
+
+    // Unsupported function: transport succeeds, the reply carries the exception
+    const uint8_t bad[] = {0x2B, 0x0E, 0x01, 0x00};
+    ASSERT_TRUE(client.transact(bad, sizeof(bad), reply, sizeof(reply), reply_len));
+    ASSERT_EQ(reply_len, 2u);
+    EXPECT_EQ(reply[0], 0xAB);
+    EXPECT_EQ(reply[1], 0x01);
+}
+
+TEST(ModbusTcpTest, ConnectFailureFailsTheBatch) {
+    uint16_t port;
+    {
+        LoopbackModbusServer server;
+        port = server.port();
+    }
+    ModbusTcpClient client("127.0.0.1", port, 17, 200, 4);
+    uint16_t value = 0;
+    EXPECT_FALSE(client.readRange(0x03, 0, 1, &value));
+    EXPECT_FALSE(client.connected());
+    EXPECT_FALSE(client.lastError().empty());
+}
+
+static bool readOne(ModbusTcpClient& main, ModbusTcpClient& hedge, HedgePolicy& policy, uint16_t reg) {
+    const uint8_t pdu[] = {0x03, (uint8_t)(reg >> 8), (uint8_t)(reg & 0xFF), 0x00, 0x01};
+    uint8_t reply[ModbusTcpClient::MAX_PDU];
+    size_t reply_len = 0;
+    if (!main.hedgedTransact(hedge, policy, pdu, sizeof(pdu), reply, sizeof(reply), reply_len)) return false;
+    return reply_len == 4 && reply[0] == 0x03 && ((reply[2] << 8) | reply[3]) == LoopbackModbusServer::expected(reg);
+}
+
+TEST(ModbusTcpTest, HedgedReadCutsTheTail) {
+    // Every 25th request is held 300 ms: without hedging those reads wait it out
+    LoopbackModbusServer::Options opts = withLatency(1000);
+    opts.tail_every = 25;
+    opts.tail_us = 300000;
+    LoopbackModbusServer server(opts);
+    ModbusTcpClient main("127.0.0.1", server.port(), 17, 1000, 1);
+    ModbusTcpClient hedge("127.0.0.1", server.port(), 17, 1000, 1);
+    ASSERT_TRUE(main.connect());
+    ASSERT_TRUE(hedge.connect());
+    HedgeConfig config;
+    config.budget_pct = 20;
+    config.min_samples = 5;
+    HedgePolicy policy(config);
+
+    for (uint16_t i = 0; i < 100; ++i) ASSERT_TRUE(readOne(main, hedge, policy, i)) << "read " << i;
+    EXPECT_GT(policy.hedges(), 0u);
+    EXPECT_GT(policy.hedgeWins(), 0u);
+    EXPECT_LT(policy.percentileUs(99), 100000u);
+    // The losers' late replies were discarded, not taken for later reads
+    EXPECT_EQ(main.stats().timeouts, 0u);
+}
+
+TEST(ModbusTcpTest, HedgedBatchCutsTheTail) {
+    // The acquisition poll: 10 pipelined reads, 4 in flight, one request in 25 held 300 ms
+    LoopbackModbusServer::Options opts = withLatency(1000);
+    opts.tail_every = 25;
+    opts.tail_us = 300000;
+    LoopbackModbusServer server(opts);
+    ModbusTcpClient main("127.0.0.1", server.port(), 17, 1000, 4);
+    ModbusTcpClient hedge("127.0.0.1", server.port(), 17, 1000, 4);
+    ASSERT_TRUE(main.connect());
+    ASSERT_TRUE(hedge.connect());
+    HedgeConfig config;
+    config.budget_pct = 20;
+    config.min_samples = 5;
+    HedgePolicy policy(config);
+
+    ModbusRead reads[10];
+    uint16_t values[10];
+    for (int batch = 0; batch < 20; ++batch) {
+        for (uint16_t i = 0; i < 10; ++i) {
+            reads[i] = ModbusRead();
+            reads[i].start = (uint16_t)(batch * 10 + i);
+            reads[i].values = &values[i];
+        }
+        ASSERT_EQ(main.hedgedReadBatch(hedge, policy, reads, 10), 10u) << "batch " << batch;
+        for (uint16_t i = 0; i < 10; ++i) {
+            EXPECT_EQ(values[i], LoopbackModbusServer::expected(reads[i].start)) << "register " << reads[i].start;
+        }
+    }
+    EXPECT_GT(policy.hedges(), 0u);
+    EXPECT_GT(policy.hedgeWins(), 0u);
+    EXPECT_LT(policy.percentileUs(99), 100000u);
+    EXPECT_EQ(main.stats().timeouts, 0u);
+    EXPECT_EQ(server.requests(), 200u + policy.hedges());
+}
+
+TEST(ModbusTcpTest, HedgesStayWithinTheBudget) {
+    // One read in ten is slow: p95 hedging would duplicate about 5% of them
+    LoopbackModbusServer::Options opts = withLatency(1000);
+    opts.tail_every = 10;
+    opts.tail_us = 5000;
+    LoopbackModbusServer server(opts);
+    ModbusTcpClient main("127.0.0.1", server.port(), 17, 1000, 1);
+    ModbusTcpClient hedge("127.0.0.1", server.port(), 17, 1000, 1);
+    HedgeConfig config;
+    config.budget_pct = 1;
+    config.min_samples = 5;
+    config.min_delay_us = 100;
+    HedgePolicy policy(config);
+
+    for (uint16_t i = 0; i < 200; ++i) ASSERT_TRUE(readOne(main, hedge, policy, i));
+    EXPECT_LE(policy.hedges(), 2u);
+    EXPECT_GT(policy.denied(), 0u);
+    EXPECT_EQ(server.requests(), 200u + policy.hedges());
+}
+
+TEST(ModbusTcpTest, HedgeCoversADeadMainConnection) {
+    LoopbackModbusServer server;
+    ModbusTcpClient main("127.0.0.1", 1, 17, 200, 1);   // nothing listens on port 1
+    ModbusTcpClient hedge("127.0.0.1", server.port(), 17, 1000, 1);
+    HedgeConfig config;
+    config.burst = 1;
+    HedgePolicy policy(config);
+    for (int i = 0; i < 20; ++i) policy.onRead();   // one hedge saved up
+
+    EXPECT_TRUE(readOne(main, hedge, policy, 42));
+    EXPECT_EQ(policy.hedgeWins(), 1u);
+    EXPECT_FALSE(readOne(main, hedge, policy, 43));   // budget spent
+}
@@ -0,0 +1,93 @@
+/**
+ * @file test_nonce_resync.cpp
+ * @brief Tests for the boot-time nonce resync exchange with the server
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "nonce_resync.hpp"
+#include <cstdio>
+#include <string>
+
+namespace {
+const uint8_t PSK[32] = {0xc4, 0x17, 0x16, 0xa1, 0x34, 0x16, 0x8f, 0x52, 0xfb, 0xd4, 0xbe, 0x33, 0x02, 0xfa, 0x5a, 0x88,
+                         0x12, 0x7d, 0xdd, 0xe7, 0x49, 0x50, 0x1a, 0x19, 0x96, 0x07, 0xb4, 0xc2, 0x86, 0xad, 0x29, 0xb3};
+
+std::string hexMac(HmacSha256& hmac, const std::string& input) {
+    uint8_t mac[SHA256_DIGEST_SIZE];
+    hmac.compute((const uint8_t*)input.data(), input.size(), mac);
+    std::string out;
+    char b[3];
+    for (uint8_t v : mac) {
+        snprintf(b, sizeof(b), "%02x", v);
+        out += b;
+    }
+    return out;
+}
+
+// What /api/security/resync in app.py answers
+std::string serverReply(HmacSha256& hmac, const std::string& device, const std::string& challenge, uint32_t last) {
+    return "{\"challenge\": \"" + challenge + "\", \"last_nonce\": " + std::to_string(last) + ", \"mac\": \"" +
+           hexMac(hmac, NonceResync::replyMacInput(device, challenge, last)) + "\"}";
+}
+
+struct Fixture {
+    HmacSha256 hmac{PSK, sizeof(PSK)};
+    uint8_t challenge[NonceResync::CHALLENGE_SIZE];
+    Fixture(uint8_t seed) {
+        for (size_t i = 0; i < sizeof(challenge); ++i) challenge[i] = (uint8_t)(seed + i * 37);
+    }
+};
+}
+
+TEST(NonceResyncTest, RequestIsSignedOverDeviceAndChallenge) {
+    Fixture f(1);
+    NonceResync resync("EcoWatt-01", f.challenge);
+    EXPECT_EQ(resync.challengeHex().size(), 2 * NonceResync::CHALLENGE_SIZE);
+    std::string body = resync.request(f.hmac);
+    std::string mac = hexMac(f.hmac, NonceResync::requestMacInput("EcoWatt-01", resync.challengeHex()));
+    EXPECT_EQ(body, "{\"device\":\"EcoWatt-01\",\"challenge\":\"" + resync.challengeHex() + "\",\"mac\":\"" + mac + "\"}");
+
+    // A new challenge signs differently
+    Fixture g(2);
+    EXPECT_NE(NonceResync("EcoWatt-01", g.challenge).request(g.hmac), body);
+}
+
+TEST(NonceResyncTest, AcceptsOnlyAReplyToThisRequest) {
+    Fixture f(5);
+    NonceResync resync("EcoWatt-01", f.challenge);
+    const std::string& ch = resync.challengeHex();
+
+    uint32_t last = 0;
+    ASSERT_TRUE(resync.parseReply(serverReply(f.hmac, "EcoWatt-01", ch, 4213), f.hmac, last));
+    EXPECT_EQ(last, 4213u);
+
+    // Tampered nonce, another device's reply, a recorded reply to an older challenge
+    std::string tampered = serverReply(f.hmac, "EcoWatt-01", ch, 4213);
+    tampered.replace(tampered.find("4213"), 4, "9999");
+    uint32_t untouched = 77;
+    EXPECT_FALSE(resync.parseReply(tampered, f.hmac, untouched));
+    EXPECT_FALSE(resync.parseReply(serverReply(f.hmac, "EcoWatt-02", ch, 4213), f.hmac, untouched));
+    Fixture old(9);
+    std::string old_ch = NonceResync("EcoWatt-01", old.challenge).challengeHex();
+    EXPECT_FALSE(resync.parseReply(serverReply(f.hmac, "EcoWatt-01", old_ch, 4213), f.hmac, untouched));
+    EXPECT_EQ(untouched, 77u);
+
+    // Wrong key
+    uint8_t other_key[32] = {};
+    HmacSha256 other(other_key, sizeof(other_key));
+    EXPECT_FALSE(resync.parseReply(serverReply(other, "EcoWatt-01", ch, 4213), f.hmac, untouched));
+    EXPECT_FALSE(resync.parseReply("{\"error\":\"Unauthorized\"}", f.hmac, untouched));
+}
+
+TEST(NonceResyncTest, NextNonceJumpsPastTheServerButNeverBack) {
+    // Lost state: the device restarted from 1 (or a +50 guess) below what the server saw
+    EXPECT_EQ(NonceResync::nextNonce(1, 4213), 4214u);
+    EXPECT_EQ(NonceResync::nextNonce(51, 4213), 4214u);
+    EXPECT_EQ(NonceResync::nextNonce(4213, 4213), 4214u);
+    // Saved state ahead of the server (requests that never arrived): keep it
+    EXPECT_EQ(NonceResync::nextNonce(4300, 4213), 4300u);
+    // Server has nothing for this device
+    EXPECT_EQ(NonceResync::nextNonce(1, 0), 1u);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file test_profiler.cpp
+ * @brief Tests for the remote-triggered profiling capture
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "profiler.hpp"
+#include "cpu_accounting.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+static uint32_t u32At(const std::vector<uint8_t>& b, size_t pos) {
+    return b[pos] | (b[pos + 1] << 8) | (b[pos + 2] << 16) | ((uint32_t)b[pos + 3] << 24);
+}
+
+struct Decoded {
+    uint8_t threads = 0;
+    bool truncated = false;
+    uint32_t session = 0;
+    uint32_t length_us = 0;
+    std::vector<std::string> names;
+    std::vector<ProfileEvent> events;
+};
+
+static Decoded decode(const std::vector<uint8_t>& b) {
+    Decoded d;
+    EXPECT_EQ(memcmp(b.data(), "EWPF", 4), 0);
+    EXPECT_EQ(b[4], Profiler::FORMAT_VERSION);
+    d.threads = b[5];
+    d.truncated = b[6] & 1;
+    d.session = u32At(b, 8);
+    d.length_us = u32At(b, 12);
+    uint32_t count = u32At(b, 16);
+    size_t pos = 20;
+    for (uint8_t t = 0; t < d.threads; ++t, pos += 16) d.names.push_back((const char*)&b[pos]);
+    EXPECT_EQ(b.size(), pos + count * 12);
+    for (uint32_t i = 0; i < count; ++i, pos += 12) {
+        ProfileEvent e;
+        e.t_us = u32At(b, pos);
+        e.value = u32At(b, pos + 4);
+        e.kind = b[pos + 8];
+        e.tid = b[pos + 9];
+        e.id = (uint16_t)(b[pos + 10] | (b[pos + 11] << 8));
+        d.events.push_back(e);
+    }
+    return d;
+}
+
+class ProfilerTest : public ::testing::Test {
+protected:
+    void TearDown() override { Profiler::release(); }
+};
+
+TEST_F(ProfilerTest, DisabledHooksRecordNothing) {
+    EXPECT_EQ(Profiler::state(), ProfileState::IDLE);
+    { CpuScope scope(CpuSubsystem::UPLINK); }
+    Profiler::counter(ProfileCounter::HEAP_FREE, 1000);
+    Profiler::request(profileClockUs(), 200);
+    Profiler::loopDone(profileClockUs());
+    EXPECT_EQ(Profiler::events(), 0u);
+    std::vector<uint8_t> out;
+    EXPECT_FALSE(Profiler::serialize(out));
+}
+
+TEST_F(ProfilerTest, CapturesSpansCountersOverrunsAndRequests) {
+    ASSERT_TRUE(Profiler::start(60000, 42, 64));
+    EXPECT_FALSE(Profiler::start(1000, 43));   // one session at a time
+
+    uint64_t loop_start = profileClockUs();
+    {
+        CpuScope uplink(CpuSubsystem::UPLINK);
+        CpuScope security(CpuSubsystem::SECURITY);
+    }
+    std::thread([] { CpuScope acq(CpuSubsystem::ACQUISITION); }).join();
+    Profiler::counter(ProfileCounter::HEAP_FREE, 123456);
+    Profiler::request(profileClockUs() - 2000, -1);   // connection refused
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    Profiler::loopDone(loop_start);
+    EXPECT_EQ(Profiler::state(), ProfileState::CAPTURING);
+    Profiler::stop();
+    ASSERT_EQ(Profiler::state(), ProfileState::CAPTURED);
+    { CpuScope late(CpuSubsystem::FLASH); }   // after the end: not recorded
+
+    std::vector<uint8_t> out;
+    ASSERT_TRUE(Profiler::serialize(out));
+    Decoded d = decode(out);
+    EXPECT_EQ(d.session, 42u);
+    EXPECT_FALSE(d.truncated);
+    EXPECT_GE(d.length_us, 60000u);
+    ASSERT_EQ(d.threads, 2u);
+    EXPECT_EQ(d.names[0], "thread0");
+    ASSERT_EQ(d.events.size(), 9u);
+
+    // Nested spans close innermost first
+    EXPECT_EQ(d.events[0].kind, (uint8_t)ProfileEventKind::SPAN_BEGIN);
+    EXPECT_EQ(d.events[0].id, (uint16_t)CpuSubsystem::UPLINK);
+    EXPECT_EQ(d.events[2].kind, (uint8_t)ProfileEventKind::SPAN_END);
+    EXPECT_EQ(d.events[2].id, (uint16_t)CpuSubsystem::SECURITY);
+    EXPECT_EQ(d.events[3].id, (uint16_t)CpuSubsystem::UPLINK);
+    // The worker thread gets its own slot
+    EXPECT_EQ(d.events[4].tid, 1u);
+    EXPECT_EQ(d.events[4].id, (uint16_t)CpuSubsystem::ACQUISITION);
+    EXPECT_EQ(d.events[6].kind, (uint8_t)ProfileEventKind::COUNTER);
+    EXPECT_EQ(d.events[6].value, 123456u);
+    EXPECT_EQ(d.events[7].kind, (uint8_t)ProfileEventKind::REQUEST);
+    EXPECT_EQ((int16_t)d.events[7].id, -1);
+    EXPECT_GE(d.events[7].value, 2000u);
+    EXPECT_EQ(d.events[8].kind, (uint8_t)ProfileEventKind::LOOP_OVERRUN);
+    EXPECT_GE(d.events[8].value, 60000u);
+    // Requests and overruns are stamped with their start; the rest in recording order
+    for (size_t i = 1; i < 7; ++i) EXPECT_LE(d.events[i - 1].t_us, d.events[i].t_us);
+
+    Profiler::release();
+    EXPECT_EQ(Profiler::state(), ProfileState::IDLE);
+    EXPECT_TRUE(Profiler::start(1000, 43, 16));
+}
+
+TEST_F(ProfilerTest, FullBufferEndsTheSession) {
+    ASSERT_TRUE(Profiler::start(60000, 1, 10));
+    for (int i = 0; i < 20; ++i) CpuScope scope(CpuSubsystem::JSON);
+    EXPECT_FALSE(Profiler::active());
+    EXPECT_TRUE(Profiler::truncated());
+    EXPECT_EQ(Profiler::events(), 10u);
+    Profiler::loopDone(0);
+    ASSERT_EQ(Profiler::state(), ProfileState::CAPTURED);
+
+    std::vector<uint8_t> out;
+    ASSERT_TRUE(Profiler::serialize(out));
+    Decoded d = decode(out);
+    EXPECT_TRUE(d.truncated);
+    EXPECT_EQ(d.events.size(), 10u);
+}
+
+TEST_F(ProfilerTest, EndsWhenTheDurationIsUp) {
+    ASSERT_TRUE(Profiler::start(20, 5));
+    Profiler::loopDone(0);
+    EXPECT_EQ(Profiler::state(), ProfileState::CAPTURING);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    Profiler::loopDone(0);
+    EXPECT_EQ(Profiler::state(), ProfileState::CAPTURED);
+    EXPECT_FALSE(Profiler::active());
+}
+
+TEST_F(ProfilerTest, StopWaitsForTasksStillRecording) {
+    std::atomic<bool> done{false};
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 3; ++w) {
+        writers.emplace_back([&] {
+            while (!done) CpuScope scope(CpuSubsystem::SECURITY);
+        });
+    }
+    // Sessions started and released under the writers' feet, as a profile command ends
+    // while other tasks are busy
+    for (uint32_t session = 1; session <= 2000; ++session) {
+        ASSERT_TRUE(Profiler::start(60000, session, 256));
+        std::this_thread::yield();
+        Profiler::stop();
+        std::vector<uint8_t> out;
+        ASSERT_TRUE(Profiler::serialize(out));
+        Decoded d = decode(out);
+        for (const ProfileEvent& e : d.events) {
+            ASSERT_TRUE(e.kind == (uint8_t)ProfileEventKind::SPAN_BEGIN || e.kind == (uint8_t)ProfileEventKind::SPAN_END)
+                << "half-written event in session " << session;
+        }
+        EXPECT_EQ(Profiler::events(), d.events.size());   // nothing lands after stop()
+        Profiler::release();
+    }
+    done = true;
+    for (auto& t : writers) t.join();
+}
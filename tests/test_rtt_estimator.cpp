@@ -0,0 +1,97 @@
+/**
+ * @file test_rtt_estimator.cpp
+ * @brief Tests for the per-endpoint RTT estimator behind adaptive request timeouts
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "rtt_estimator.hpp"
+
+TEST(RttEstimatorTest, InitialTimeoutUntilTheFirstSample) {
+    RttEstimator est;
+    EXPECT_FALSE(est.hasSample());
+    EXPECT_EQ(est.timeoutMs(), 5000u);
+
+    est.onSample(400);
+    EXPECT_EQ(est.srttMs(), 400u);
+    EXPECT_EQ(est.rttvarMs(), 200u);
+    EXPECT_EQ(est.timeoutMs(), 1200u);   // SRTT + 4 RTTVAR
+}
+
+TEST(RttEstimatorTest, FollowsRfc6298Smoothing) {
+    RttEstimator est;
+    est.onSample(100);   // SRTT 100, RTTVAR 50
+    est.onSample(200);   // RTTVAR = 3/4*50 + 1/4*100 = 62.5; SRTT = 7/8*100 + 1/8*200 = 112.5
+    EXPECT_EQ(est.srttMs(), 112u);
+    EXPECT_EQ(est.rttvarMs(), 62u);
+    EXPECT_EQ(est.timeoutMs(), 112u + 250u);
+}
+
+TEST(RttEstimatorTest, HealthyFastLinkClampsToTheMinimum) {
+    RttEstimator est;
+    for (int i = 0; i < 50; ++i) est.onSample(45 + (i % 3) * 5);
+    EXPECT_NEAR((int)est.srttMs(), 50, 5);
+    EXPECT_EQ(est.timeoutMs(), 250u);
+    // A lost read is given up after a quarter second instead of five
+    RttLimits limits;
+    EXPECT_LE(est.timeoutMs() * 20, limits.initial_ms);
+}
+
+TEST(RttEstimatorTest, TimeoutsBackOffUntilTheNextSample) {
+    RttEstimator est;
+    for (int i = 0; i < 20; ++i) est.onSample(50);
+    uint32_t rto = est.timeoutMs();
+    est.onTimeout();
+    EXPECT_EQ(est.timeoutMs(), 2 * rto);
+    est.onTimeout();
+    EXPECT_EQ(est.timeoutMs(), 4 * rto);
+    for (int i = 0; i < 10; ++i) est.onTimeout();
+    EXPECT_EQ(est.timeoutMs(), 30000u);
+    EXPECT_EQ(est.timeouts(), 12u);
+
+    est.onSample(60);
+    EXPECT_EQ(est.backoff(), 0);
+    EXPECT_LT(est.timeoutMs(), 2 * rto);
+}
+
+TEST(RttEstimatorTest, SlowEndpointGetsALongTimeout) {
+    RttEstimator est;
+    for (int i = 0; i < 20; ++i) est.onSample(i % 2 ? 2600 : 3400);
+    EXPECT_GT(est.timeoutMs(), 3400u);
+    EXPECT_LE(est.timeoutMs(), 30000u);
+}
+
+TEST(EndpointRttTest, EndpointsAreKeptApart) {
+    EndpointRtt rtt;
+    EXPECT_EQ(EndpointRtt::keyFor("/api/inverter/fota/chunk?chunk_number=7"), "/api/inverter/fota/chunk");
+    EXPECT_EQ(EndpointRtt::keyFor("http://10.0.0.2:8080/api/upload/events"), "/api/upload/events");
+    EXPECT_EQ(EndpointRtt::keyFor("http://10.0.0.2:8080"), "/");
+
+    for (int i = 0; i < 10; ++i) {
+        rtt.onSample("/api/inverter/read", 50);
+        rtt.onSample("/api/inverter/fota/chunk?chunk_number=1", 3000);
+    }
+    EXPECT_EQ(rtt.timeoutMs("/api/inverter/read"), 250u);
+    EXPECT_GT(rtt.timeoutMs("/api/inverter/fota/chunk?chunk_number=2"), 3000u);
+    EXPECT_EQ(rtt.timeoutMs("/api/never/seen"), 5000u);
+
+    rtt.onTimeout("/api/inverter/read");
+    const RttEstimator* read = rtt.find("/api/inverter/read");
+    ASSERT_NE(read, nullptr);
+    EXPECT_EQ(read->timeouts(), 1u);
+    EXPECT_EQ(read->samples(), 10u);
+    EXPECT_NE(rtt.json().find("\"/api/inverter/read\":{\"srtt\":50,\"rttvar\":"), std::string::npos);
+}
+
+TEST(EndpointRttTest, LeastRecentlyUsedSlotIsReused) {
+    EndpointRtt rtt;
+    rtt.onSample("/keep", 100);
+    for (size_t i = 0; i < EndpointRtt::SLOTS; ++i) {
+        rtt.onSample(("/ep" + std::to_string(i)).c_str(), 100);
+        rtt.onSample("/keep", 100);
+    }
+    EXPECT_NE(rtt.find("/keep"), nullptr);
+    EXPECT_EQ(rtt.find("/ep0"), nullptr);
+    EXPECT_NE(rtt.find("/ep1"), nullptr);
+}
@@ -0,0 +1,361 @@
+/**
+ * @file test_sample_log.cpp
+ * @brief Tests for the raw-partition sample log: append, wrap, recovery after power loss, zone-map queries
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "sample_log.hpp"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// RAM flash with NOR semantics; write_budget simulates power loss part-way through a write
+class RamRegion : public SampleLogRegion {
+public:
+    explicit RamRegion(size_t sectors) : mem_(sectors * SampleLog::SECTOR_SIZE, 0xFF) {}
+    size_t size() const override { return mem_.size(); }
+    const uint8_t* data() const override { return mem_.data(); }
+    bool erase(size_t offset, size_t len) override {
+        memset(&mem_[offset], 0xFF, len);
+        return true;
+    }
+    bool write(size_t offset, const void* src, size_t len) override {
+        const uint8_t* s = static_cast<const uint8_t*>(src);
+        for (size_t i = 0; i < len; ++i) {
+            if (write_budget == 0) return false;
+            if (write_budget > 0) --write_budget;
+            mem_[offset + i] &= s[i];
+        }
+        return true;
+    }
+    long write_budget = -1;   // bytes left before the "power cut", -1 = unlimited
+
+private:
+    std::vector<uint8_t> mem_;
+};
+
+static std::vector<Sample> makeSamples(uint32_t first_ts, size_t n) {
+    std::vector<Sample> out;
+    for (size_t i = 0; i < n; ++i) out.push_back(Sample{first_ts + (uint32_t)i, (uint8_t)(i % 10), (float)i * 0.5f});
+    return out;
+}
+
+static std::vector<uint32_t> scanAll(const SampleLog& log) {
+    std::vector<uint32_t> ts;
+    log.scan(0, 0xFFFFFFFFu, [&](const SampleLogRecord& r) {
+        ts.push_back(r.ts);
+        return true;
+    });
+    return ts;
+}
+
+TEST(SampleLogTest, AppendScanAndReadLast) {
+    RamRegion region(4);
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    EXPECT_EQ(log.records(), 0u);
+
+    auto samples = makeSamples(1000, 500);   // spans two sectors
+    ASSERT_TRUE(log.append(samples.data(), samples.size()));
+    EXPECT_EQ(log.records(), 500u);
+    EXPECT_EQ(log.headSeq(), 2u);
+
+    std::vector<uint32_t> ts = scanAll(log);
+    ASSERT_EQ(ts.size(), 500u);
+    EXPECT_EQ(ts.front(), 1000u);
+    EXPECT_EQ(ts.back(), 1499u);
+
+    // Records handed to the visitor live in the mapped region, not in a copy
+    const SampleLogRecord* first = nullptr;
+    size_t hits = log.scan(1100, 1102, [&](const SampleLogRecord& r) {
+        if (!first) first = &r;
+        return true;
+    });
+    EXPECT_EQ(hits, 3u);
+    ASSERT_NE(first, nullptr);
+    EXPECT_GE((const uint8_t*)first, region.data());
+    EXPECT_LT((const uint8_t*)first, region.data() + region.size());
+    EXPECT_EQ(first->reg, 100 % 10);
+
+    Sample last[3];
+    ASSERT_EQ(log.readLast(3, last, 3), 3u);
+    EXPECT_EQ(last[0].timestamp, 1497u);
+    EXPECT_EQ(last[2].timestamp, 1499u);
+    EXPECT_FLOAT_EQ(last[2].value, 499 * 0.5f);
+}
+
+TEST(SampleLogTest, WrapDropsOldestSector) {
+    RamRegion region(3);
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    size_t per = SampleLog::RECORDS_PER_SECTOR;
+    auto samples = makeSamples(0, per * 3 + 10);
+    ASSERT_TRUE(log.append(samples.data(), samples.size()));
+
+    // Fourth sector reuses the first: one sector's worth is gone
+    EXPECT_EQ(log.records(), per * 2 + 10);
+    EXPECT_EQ(log.stats().records_dropped, per);
+    EXPECT_EQ(log.headSeq(), 4u);
+    std::vector<uint32_t> ts = scanAll(log);
+    ASSERT_EQ(ts.size(), per * 2 + 10);
+    EXPECT_EQ(ts.front(), per);
+    for (size_t i = 1; i < ts.size(); ++i) ASSERT_EQ(ts[i], ts[i - 1] + 1);
+
+    SampleLog again(&region);
+    ASSERT_TRUE(again.begin());
+    EXPECT_EQ(again.records(), per * 2 + 10);
+    EXPECT_EQ(scanAll(again), ts);
+}
+
+TEST(SampleLogTest, RecoversWritePositionAfterRestart) {
+    RamRegion region(4);
+    {
+        SampleLog log(&region);
+        ASSERT_TRUE(log.begin());
+        auto a = makeSamples(0, 100);
+        ASSERT_TRUE(log.append(a.data(), a.size()));
+    }
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    EXPECT_EQ(log.records(), 100u);
+    auto b = makeSamples(100, 50);
+    ASSERT_TRUE(log.append(b.data(), b.size()));
+    EXPECT_EQ(log.headSeq(), 1u);   // continued in the same sector
+    std::vector<uint32_t> ts = scanAll(log);
+    ASSERT_EQ(ts.size(), 150u);
+    for (size_t i = 0; i < ts.size(); ++i) ASSERT_EQ(ts[i], i);
+}
+
+TEST(SampleLogTest, TornRecordClosesSector) {
+    RamRegion region(4);
+    {
+        SampleLog log(&region);
+        ASSERT_TRUE(log.begin());
+        auto a = makeSamples(0, 20);
+        ASSERT_TRUE(log.append(a.data(), a.size()));
+        region.write_budget = 12 * 3 + 5;   // power fails inside the fourth record
+        auto b = makeSamples(20, 10);
+        EXPECT_FALSE(log.append(b.data(), b.size()));
+        region.write_budget = -1;
+    }
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    EXPECT_EQ(log.records(), 23u);
+    EXPECT_EQ(log.stats().torn_records, 1u);
+
+    // Nothing is written over the torn bytes; the next append opens a new sector
+    auto c = makeSamples(100, 5);
+    ASSERT_TRUE(log.append(c.data(), c.size()));
+    EXPECT_EQ(log.headSeq(), 2u);
+    std::vector<uint32_t> ts = scanAll(log);
+    ASSERT_EQ(ts.size(), 28u);
+    EXPECT_EQ(ts[22], 22u);
+    EXPECT_EQ(ts[23], 100u);
+}
+
+TEST(SampleLogTest, TornHeaderIsIgnored) {
+    RamRegion region(4);
+    {
+        SampleLog log(&region);
+        ASSERT_TRUE(log.begin());
+        auto a = makeSamples(0, SampleLog::RECORDS_PER_SECTOR);
+        ASSERT_TRUE(log.append(a.data(), a.size()));
+        region.write_budget = 7;   // sector 1 erased, header half written
+        auto b = makeSamples(1000, 1);
+        EXPECT_FALSE(log.append(b.data(), b.size()));
+        region.write_budget = -1;
+    }
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    EXPECT_EQ(log.headSeq(), 1u);
+    EXPECT_EQ(log.records(), SampleLog::RECORDS_PER_SECTOR);
+    auto c = makeSamples(2000, 1);
+    ASSERT_TRUE(log.append(c.data(), c.size()));   // erases the torn sector again
+    EXPECT_EQ(log.headSeq(), 2u);
+    EXPECT_EQ(scanAll(log).back(), 2000u);
+}
+
+TEST(SampleLogTest, MappedFileRegionPersists) {
+    char path[] = "/tmp/sample_log_testXXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    unlink(path);
+    {
+        MappedFileRegion region(path, 8 * SampleLog::SECTOR_SIZE);
+        ASSERT_TRUE(region.ok());
+        SampleLog log(&region);
+        ASSERT_TRUE(log.begin());
+        auto a = makeSamples(5000, 400);
+        ASSERT_TRUE(log.append(a.data(), a.size()));
+    }
+    {
+        MappedFileRegion region(path, 8 * SampleLog::SECTOR_SIZE);
+        ASSERT_TRUE(region.ok());
+        SampleLog log(&region);
+        ASSERT_TRUE(log.begin());
+        EXPECT_EQ(log.records(), 400u);
+        EXPECT_NE(log.statsJson().find("\"records\":400"), std::string::npos);
+    }
+    unlink(path);
+}
+
+// Temperature (reg 7) at 30 degrees, with one hot spell in the third sector
+static std::vector<Sample> temperatureHistory(size_t sectors) {
+    std::vector<Sample> out;
+    size_t per = SampleLog::RECORDS_PER_SECTOR;
+    for (size_t i = 0; i < sectors * per; ++i) {
+        float temp = (i >= 2 * per + 100 && i < 2 * per + 110) ? 65.0f : 30.0f + (float)(i % 7);
+        out.push_back(Sample{(uint32_t)i, (uint8_t)(i % 2 ? 7 : 9), i % 2 ? temp : (float)(i % 500)});
+    }
+    return out;
+}
+
+TEST(SampleLogTest, QuerySkipsSectorsTheZoneMapRulesOut) {
+    RamRegion region(6);
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    auto samples = temperatureHistory(5);
+    ASSERT_TRUE(log.append(samples.data(), samples.size()));
+
+    std::vector<uint32_t> hot;
+    SampleLogQueryStats st;
+    size_t n = log.query(SampleLogQuery::above(7, 60.0f), [&](const SampleLogRecord& r) {
+        hot.push_back(r.ts);
+        return true;
+    }, &st);
+    EXPECT_EQ(n, 5u);
+    EXPECT_EQ(st.matches, 5u);
+    EXPECT_EQ(st.sectors_scanned, 1u);
+    EXPECT_EQ(st.sectors_skipped, 4u);
+    EXPECT_EQ(st.records_decoded, SampleLog::RECORDS_PER_SECTOR);
+    ASSERT_EQ(hot.size(), 5u);
+    EXPECT_EQ(hot.front(), 2 * SampleLog::RECORDS_PER_SECTOR + 101);
+
+    // Threshold is strict, a range is inclusive
+    EXPECT_EQ(log.query(SampleLogQuery::above(7, 65.0f), [](const SampleLogRecord&) { return true; }), 0u);
+    EXPECT_EQ(log.query(SampleLogQuery::between(7, 65.0f, 70.0f), [](const SampleLogRecord&) { return true; }), 5u);
+
+    // A time window rules out sectors on its own
+    size_t per = SampleLog::RECORDS_PER_SECTOR;
+    SampleLogQuery q = SampleLogQuery::below(9, 10.0f).during(per, 2 * per - 1);
+    n = log.query(q, [&](const SampleLogRecord& r) {
+        EXPECT_LT(r.value, 10.0f);
+        EXPECT_EQ(r.reg, 9);
+        return true;
+    }, &st);
+    EXPECT_GT(n, 0u);
+    EXPECT_EQ(st.sectors_scanned, 1u);
+    EXPECT_EQ(st.sectors_skipped, 4u);
+
+    // Same answer as a full decode
+    size_t brute = 0;
+    log.scan(per, 2 * per - 1, [&](const SampleLogRecord& r) {
+        if (r.reg == 9 && r.value < 10.0f) brute++;
+        return true;
+    });
+    EXPECT_EQ(n, brute);
+}
+
+TEST(SampleLogTest, SummarizeUsesZoneMapsForWholeSectors) {
+    RamRegion region(6);
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    auto samples = temperatureHistory(5);
+    ASSERT_TRUE(log.append(samples.data(), samples.size()));
+
+    size_t per = SampleLog::RECORDS_PER_SECTOR;
+    uint32_t start = (uint32_t)(per / 2), end = (uint32_t)(4 * per + 10);
+    SampleLogZone expect;
+    for (const Sample& s : samples) {
+        if (s.reg_addr == 7 && s.timestamp >= start && s.timestamp <= end) expect.add(s.value);
+    }
+    SampleLogQueryStats st;
+    SampleLogZone got = log.summarize(7, start, end, &st);
+    EXPECT_EQ(got.count, expect.count);
+    EXPECT_FLOAT_EQ(got.min, 30.0f);
+    EXPECT_FLOAT_EQ(got.max, 65.0f);
+    EXPECT_NEAR(got.sum, expect.sum, 1.0f);
+    EXPECT_EQ(st.sectors_summarized, 3u);   // the two edge sectors are decoded
+    EXPECT_EQ(st.sectors_scanned, 2u);
+}
+
+TEST(SampleLogTest, ZoneMapsFollowWrapAndRestart) {
+    RamRegion region(3);
+    size_t per = SampleLog::RECORDS_PER_SECTOR;
+    auto samples = temperatureHistory(4);
+    {
+        SampleLog log(&region);
+        ASSERT_TRUE(log.begin());
+        ASSERT_TRUE(log.append(samples.data(), samples.size()));
+        // The hot spell was in the third sector and is still live
+        EXPECT_EQ(log.query(SampleLogQuery::above(7, 60.0f), [](const SampleLogRecord&) { return true; }), 5u);
+        // Two cool sectors wrap over the oldest and then the hot one
+        std::vector<Sample> cooler(2 * per, Sample{100000, 7, 20.0f});
+        ASSERT_TRUE(log.append(cooler.data(), cooler.size()));
+        EXPECT_EQ(log.query(SampleLogQuery::above(7, 60.0f), [](const SampleLogRecord&) { return true; }), 0u);
+    }
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    SampleLogQueryStats st;
+    EXPECT_EQ(log.query(SampleLogQuery::above(7, 60.0f), [](const SampleLogRecord&) { return true; }, &st), 0u);
+    EXPECT_EQ(st.sectors_skipped, 3u);
+    SampleLogZone all = log.summarize(7, 0, 0xFFFFFFFFu);
+    EXPECT_EQ(all.count, per / 2 + 2 * per);
+    EXPECT_FLOAT_EQ(all.min, 20.0f);
+    EXPECT_FLOAT_EQ(all.max, 36.0f);
+}
+
+TEST(SampleLogTest, ZoneMapsAreBuiltByTheFirstQuery) {
+    RamRegion region(4);
+    auto samples = temperatureHistory(2);
+    {
+        SampleLog log(&region);
+        ASSERT_TRUE(log.begin());
+        ASSERT_TRUE(log.append(samples.data(), samples.size()));
+        EXPECT_FALSE(log.zonesBuilt());
+    }
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    EXPECT_FALSE(log.zonesBuilt());   // a log nobody queries keeps no zone maps
+    SampleLogQueryStats st;
+    SampleLogZone all = log.summarize(7, 0, 0xFFFFFFFFu, &st);
+    EXPECT_TRUE(log.zonesBuilt());
+    EXPECT_EQ(st.sectors_summarized, 2u);
+    // Kept current by append once built
+    std::vector<Sample> hot(3, Sample{50000, 7, 90.0f});
+    ASSERT_TRUE(log.append(hot.data(), hot.size()));
+    EXPECT_EQ(log.summarize(7, 0, 0xFFFFFFFFu).count, all.count + 3);
+    EXPECT_EQ(log.query(SampleLogQuery::above(7, 80.0f), [](const SampleLogRecord&) { return true; }), 3u);
+}
+
+TEST(SampleLogTest, SummarizeLeavesOutNaNOnEveryPath) {
+    RamRegion region(4);
+    SampleLog log(&region);
+    ASSERT_TRUE(log.begin());
+    size_t per = SampleLog::RECORDS_PER_SECTOR;
+    std::vector<Sample> samples;
+    for (size_t i = 0; i < 2 * per; ++i) {
+        samples.push_back(Sample{(uint32_t)i, 7, i % 4 == 0 ? NAN : 10.0f});   // a failed read every fourth poll
+    }
+    ASSERT_TRUE(log.append(samples.data(), samples.size()));
+
+    // Both sectors from their zone maps, then both decoded as edges
+    SampleLogQueryStats st;
+    SampleLogZone whole = log.summarize(7, 0, 0xFFFFFFFFu, &st);
+    EXPECT_EQ(st.sectors_summarized, 2u);
+    SampleLogZone edges = log.summarize(7, 1, (uint32_t)(2 * per - 2), &st);
+    EXPECT_EQ(st.sectors_summarized, 0u);
+    EXPECT_EQ(st.sectors_scanned, 2u);
+
+    size_t valid = 2 * per - (2 * per + 3) / 4;
+    EXPECT_EQ(whole.count, valid);
+    EXPECT_FLOAT_EQ(whole.mean(), 10.0f);
+    // ts 0 is NaN, ts 2*per-1 is valid: the edge sum lost exactly one record
+    EXPECT_EQ(edges.count, valid - 1);
+    EXPECT_FLOAT_EQ(edges.mean(), 10.0f);
+}
@@ -0,0 +1,156 @@
+/**
+ * @file test_serial_tap.cpp
+ * @brief Tests for COBS framing and the binary serial telemetry tap
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "serial_tap.hpp"
+#include "modbus_frame.hpp"
+#include "uplink_codec.hpp"
+#include <cstring>
+#include <random>
+#include <vector>
+
+static std::vector<uint8_t> encode(const std::vector<uint8_t>& in) {
+    std::vector<uint8_t> out(cobsMaxEncoded(in.size()));
+    out.resize(cobsEncode(in.data(), in.size(), out.data()));
+    return out;
+}
+
+TEST(SerialTapTest, CobsRoundTripsWithoutZeroBytes) {
+    std::mt19937 rng(7);
+    std::vector<size_t> lengths = {0, 1, 2, 253, 254, 255, 256, 508, 509, 600};
+    for (size_t len : lengths) {
+        for (int zeros : {0, 1, 10, 100}) {
+            std::vector<uint8_t> in(len);
+            for (auto& b : in) b = (int)(rng() % 100) < zeros ? 0 : (uint8_t)(1 + rng() % 255);
+            std::vector<uint8_t> enc = encode(in);
+            EXPECT_LE(enc.size(), cobsMaxEncoded(len));
+            for (uint8_t b : enc) ASSERT_NE(b, 0);
+            std::vector<uint8_t> dec;
+            ASSERT_TRUE(cobsDecode(enc.data(), enc.size(), dec));
+            EXPECT_EQ(dec, in) << "len " << len << " zeros " << zeros;
+        }
+    }
+
+    // Known vectors
+    EXPECT_EQ(encode({0x00}), (std::vector<uint8_t>{0x01, 0x01}));
+    EXPECT_EQ(encode({0x11, 0x22, 0x00, 0x33}), (std::vector<uint8_t>{0x03, 0x11, 0x22, 0x02, 0x33}));
+
+    std::vector<uint8_t> dec;
+    const uint8_t truncated[] = {0x05, 0x11, 0x22};
+    EXPECT_FALSE(cobsDecode(truncated, sizeof(truncated), dec));
+    const uint8_t zero[] = {0x03, 0x11, 0x00};
+    EXPECT_FALSE(cobsDecode(zero, sizeof(zero), dec));
+}
+
+static std::vector<Sample> cycles(uint32_t n, uint8_t regs) {
+    std::vector<Sample> out;
+    for (uint32_t c = 0; c < n; ++c) {
+        for (uint8_t reg = 0; reg < regs; ++reg) out.push_back({c * 1000, reg, c + reg * 0.25f});
+    }
+    return out;
+}
+
+// Splits the byte stream on 0x00, then checks and strips COBS, CRC and the sequence
+struct HostPacket {
+    uint32_t seq;
+    std::vector<Sample> samples;
+};
+
+static std::vector<HostPacket> parseStream(const std::vector<uint8_t>& stream) {
+    std::vector<HostPacket> out;
+    std::vector<uint8_t> frame, payload;
+    for (uint8_t b : stream) {
+        if (b != 0) {
+            frame.push_back(b);
+            continue;
+        }
+        EXPECT_TRUE(cobsDecode(frame.data(), frame.size(), payload));
+        frame.clear();
+        EXPECT_GT(payload.size(), 6u);
+        uint16_t crc = (uint16_t)(payload[payload.size() - 2] | payload[payload.size() - 1] << 8);
+        EXPECT_EQ(crc, modbus_crc16(payload.data(), (uint16_t)(payload.size() - 2)));
+        HostPacket p;
+        memcpy(&p.seq, payload.data(), 4);
+        DecodedBatch batch;
+        size_t consumed = 0;
+        EXPECT_TRUE(decodeBatch(payload.data() + 4, payload.size() - 6, batch, consumed));
+        EXPECT_EQ(batch.header.codec, UplinkCodec::FRAME);
+        p.samples = batch.samples;
+        out.push_back(p);
+    }
+    EXPECT_TRUE(frame.empty());
+    return out;
+}
+
+TEST(SerialTapTest, StreamsRingSamplesThroughASmallWriteWindow) {
+    std::vector<Sample> ring = cycles(40, 10);
+    SerialTap tap;
+    EXPECT_FALSE(tap.wantsSamples());
+    tap.start(0);
+
+    // The ring hands over up to READ_SAMPLES from the cursor; the port takes 7 bytes a pass
+    std::vector<uint8_t> stream;
+    for (int pass = 0; pass < 10000 && (tap.cursor() < ring.size() || !tap.wantsSamples()); ++pass) {
+        if (tap.wantsSamples()) {
+            size_t n = std::min(SerialTap::READ_SAMPLES, ring.size() - tap.cursor());
+            ASSERT_GT(tap.feed(&ring[tap.cursor()], n, tap.cursor()), 0u);
+            EXPECT_FALSE(tap.wantsSamples());
+        }
+        size_t len = 0;
+        const uint8_t* data = tap.pending(len);
+        size_t w = len < 7 ? len : 7;
+        stream.insert(stream.end(), data, data + w);
+        tap.consume(w);
+    }
+    EXPECT_EQ(tap.cursor(), ring.size());
+    EXPECT_EQ(tap.dropped(), 0u);
+
+    std::vector<HostPacket> packets = parseStream(stream);
+    ASSERT_EQ(packets.size(), tap.packets());
+    std::vector<Sample> got;
+    for (const HostPacket& p : packets) {
+        EXPECT_EQ(p.seq, got.size());
+        got.insert(got.end(), p.samples.begin(), p.samples.end());
+    }
+    ASSERT_EQ(got.size(), ring.size());
+    for (size_t i = 0; i < got.size(); ++i) {
+        EXPECT_EQ(got[i].timestamp, ring[i].timestamp);
+        EXPECT_EQ(got[i].reg_addr, ring[i].reg_addr);
+        EXPECT_EQ(got[i].value, ring[i].value);
+    }
+    // Packets stay small enough for the UART buffer; the framing costs a few bytes each
+    EXPECT_LE(stream.size() / packets.size(), 256u);
+    EXPECT_LT(stream.size(), ring.size() * 5 + packets.size() * 20);
+}
+
+TEST(SerialTapTest, CountsSamplesTheRingOverwrote) {
+    std::vector<Sample> ring = cycles(3, 10);
+    SerialTap tap;
+    tap.start(100);
+    // The ring already moved past the cursor: the packet starts at the oldest sample
+    ASSERT_EQ(tap.feed(ring.data(), ring.size(), 150), ring.size());
+    EXPECT_EQ(tap.dropped(), 50u);
+    EXPECT_EQ(tap.cursor(), 180u);
+
+    // Nothing more until the packet is out
+    EXPECT_EQ(tap.feed(ring.data(), ring.size(), 180), 0u);
+    size_t len = 0;
+    tap.pending(len);
+    tap.consume(len);
+    EXPECT_TRUE(tap.wantsSamples());
+
+    // A register outside the frame map is skipped rather than stalling the tap
+    Sample odd = {5000, 40, 1.0f};
+    EXPECT_EQ(tap.feed(&odd, 1, 180), 1u);
+    EXPECT_EQ(tap.cursor(), 181u);
+    EXPECT_EQ(tap.dropped(), 51u);
+    EXPECT_TRUE(tap.wantsSamples());
+
+    tap.stop();
+    EXPECT_FALSE(tap.wantsSamples());
+    EXPECT_NE(tap.statsJson().find("\"packets\":1"), std::string::npos);
+}
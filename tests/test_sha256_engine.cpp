@@ -0,0 +1,164 @@
+/**
+ * @file test_sha256_engine.cpp
+ * @brief Tests for the SHA-256 engine backends, HMAC and multi-message hashing
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "sha256_engine.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static std::string toHex(const uint8_t* d, size_t n) {
+    static const char* hex = "0123456789abcdef";
+    std::string s;
+    for (size_t i = 0; i < n; ++i) {
+        s += hex[d[i] >> 4];
+        s += hex[d[i] & 0x0F];
+    }
+    return s;
+}
+
+static std::string hashHex(const std::string& msg, Sha256Backend backend) {
+    uint8_t d[SHA256_DIGEST_SIZE];
+    Sha256::hash((const uint8_t*)msg.data(), msg.size(), d, backend);
+    return toHex(d, sizeof(d));
+}
+
+static std::vector<Sha256Backend> availableBackends() {
+    std::vector<Sha256Backend> out;
+    for (Sha256Backend b : {Sha256Backend::PORTABLE, Sha256Backend::SHA_NI, Sha256Backend::AVX2_MB,
+                            Sha256Backend::ESP32_HW}) {
+        if (sha256BackendAvailable(b)) out.push_back(b);
+    }
+    return out;
+}
+
+TEST(Sha256Test, NistVectorsOnEveryBackend) {
+    const std::string million(1000000, 'a');
+    for (Sha256Backend b : availableBackends()) {
+        SCOPED_TRACE(sha256BackendName(b));
+        EXPECT_EQ(hashHex("", b), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+        EXPECT_EQ(hashHex("abc", b), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+        EXPECT_EQ(hashHex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", b),
+                  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+        EXPECT_EQ(hashHex(million, b), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+    }
+}
+
+TEST(Sha256Test, IncrementalSplitsMatchOneShot) {
+    std::vector<uint8_t> data(1000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = (uint8_t)(i * 7 + 3);
+    uint8_t expect[SHA256_DIGEST_SIZE];
+    Sha256::hash(data.data(), data.size(), expect, Sha256Backend::PORTABLE);
+
+    for (Sha256Backend b : availableBackends()) {
+        SCOPED_TRACE(sha256BackendName(b));
+        for (size_t step : {1u, 7u, 63u, 64u, 65u, 333u}) {
+            Sha256 h(b);
+            for (size_t pos = 0; pos < data.size(); pos += step) {
+                h.update(data.data() + pos, std::min(step, data.size() - pos));
+            }
+            uint8_t got[SHA256_DIGEST_SIZE];
+            h.finish(got);
+            EXPECT_EQ(toHex(got, 32), toHex(expect, 32)) << "step " << step;
+        }
+    }
+}
+
+TEST(Sha256Test, CopiedStateResumesIndependently) {
+    Sha256 prefix(sha256BestBackend());
+    prefix.update((const uint8_t*)"ab", 2);
+    Sha256 copy(prefix);
+    copy.update((const uint8_t*)"c", 1);
+    uint8_t d[SHA256_DIGEST_SIZE];
+    copy.finish(d);
+    EXPECT_EQ(toHex(d, 32), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    prefix.update((const uint8_t*)"c", 1);
+    uint8_t d2[SHA256_DIGEST_SIZE];
+    prefix.finish(d2);
+    EXPECT_EQ(toHex(d2, 32), toHex(d, 32));
+}
+
+TEST(HmacSha256Test, Rfc4231Vectors) {
+    // Test case 1
+    std::vector<uint8_t> key1(20, 0x0b);
+    std::string msg1 = "Hi There";
+    // Test case 2
+    std::string key2 = "Jefe";
+    std::string msg2 = "what do ya want for nothing?";
+    // Test case 6: key longer than a block
+    std::vector<uint8_t> key6(131, 0xaa);
+    std::string msg6 = "Test Using Larger Than Block-Size Key - Hash Key First";
+
+    for (Sha256Backend b : availableBackends()) {
+        SCOPED_TRACE(sha256BackendName(b));
+        uint8_t mac[SHA256_DIGEST_SIZE];
+        HmacSha256 h1(key1.data(), key1.size(), b);
+        h1.compute((const uint8_t*)msg1.data(), msg1.size(), mac);
+        EXPECT_EQ(toHex(mac, 32), "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+
+        HmacSha256 h2((const uint8_t*)key2.data(), key2.size(), b);
+        h2.compute((const uint8_t*)msg2.data(), msg2.size(), mac);
+        EXPECT_EQ(toHex(mac, 32), "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+        // The cached pads survive repeated use
+        h2.compute((const uint8_t*)msg2.data(), msg2.size(), mac);
+        EXPECT_EQ(toHex(mac, 32), "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+        HmacSha256 h6(key6.data(), key6.size(), b);
+        h6.begin();
+        h6.update((const uint8_t*)msg6.data(), 10);
+        h6.update((const uint8_t*)msg6.data() + 10, msg6.size() - 10);
+        h6.finish(mac);
+        EXPECT_EQ(toHex(mac, 32), "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+    }
+}
+
+TEST(Sha256MultiTest, MatchesSingleStreamForMixedLengths) {
+    std::vector<std::vector<uint8_t>> msgs;
+    for (size_t n : {0u, 1u, 55u, 56u, 63u, 64u, 65u, 119u, 120u, 500u, 4096u, 3u, 17u}) {
+        std::vector<uint8_t> m(n);
+        for (size_t i = 0; i < n; ++i) m[i] = (uint8_t)(i ^ n);
+        msgs.push_back(m);
+    }
+    std::vector<const uint8_t*> ptrs;
+    std::vector<size_t> lens;
+    for (auto& m : msgs) {
+        ptrs.push_back(m.data());
+        lens.push_back(m.size());
+    }
+
+    for (Sha256Backend b : availableBackends()) {
+        SCOPED_TRACE(sha256BackendName(b));
+        std::vector<uint8_t> out(msgs.size() * SHA256_DIGEST_SIZE);
+        sha256Multi(ptrs.data(), lens.data(), msgs.size(), (uint8_t(*)[SHA256_DIGEST_SIZE])out.data(), b);
+        for (size_t i = 0; i < msgs.size(); ++i) {
+            uint8_t expect[SHA256_DIGEST_SIZE];
+            Sha256::hash(msgs[i].data(), msgs[i].size(), expect, Sha256Backend::PORTABLE);
+            EXPECT_EQ(toHex(&out[i * SHA256_DIGEST_SIZE], 32), toHex(expect, 32)) << "message " << i;
+        }
+    }
+}
+
+TEST(Sha256Test, UnavailableBackendFallsBackToPortable) {
+    Sha256 h(Sha256Backend::ESP32_HW);
+#ifndef ESP32
+    EXPECT_EQ(h.backend(), Sha256Backend::PORTABLE);
+#endif
+    EXPECT_TRUE(sha256BackendAvailable(sha256BestBackend()));
+    EXPECT_TRUE(sha256BackendAvailable(sha256MultiBackend()));
+}
+
+TEST(Sha256Test, BestBackendIsSingleStream) {
+    // AVX2_MB only speeds up sha256Multi; a single hash on it runs the portable code
+    EXPECT_NE(sha256BestBackend(), Sha256Backend::AVX2_MB);
+    Sha256 h;
+    EXPECT_EQ(h.backend(), sha256BestBackend());
+    if (sha256BackendAvailable(Sha256Backend::AVX2_MB) && !sha256BackendAvailable(Sha256Backend::SHA_NI)) {
+        EXPECT_EQ(sha256MultiBackend(), Sha256Backend::AVX2_MB);
+    } else {
+        EXPECT_EQ(sha256MultiBackend(), sha256BestBackend());
+    }
+}
@@ -0,0 +1,140 @@
+/**
+ * @file test_stall_detector.cpp
+ * @brief Tests for attributing long loop() blocks to a subsystem and operation
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "stall_detector.hpp"
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+static void sleepMs(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+class StallDetectorTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        memset(&area_, 0, sizeof(area_));
+        StallDetector::begin(20, &area_);
+    }
+    StallArea area_;
+};
+
+TEST_F(StallDetectorTest, RecordsRegionsOverTheThreshold) {
+    { StallScope quick(CpuSubsystem::NETWORK, "http_get"); }
+    StallDetector::sample();
+    EXPECT_EQ(StallDetector::total(), 0u);
+
+    StallDetector::enter(CpuSubsystem::NETWORK, "http_post");
+    sleepMs(40);
+    StallDetector::sample();   // the monitor sees it while it is still blocked
+    StallRecord r;
+    ASSERT_TRUE(StallDetector::record(0, r));
+    EXPECT_TRUE(r.flags & StallRecord::OPEN);
+    EXPECT_STREQ(r.op, "http_post");
+    sleepMs(10);
+    StallDetector::exit();
+
+    ASSERT_TRUE(StallDetector::record(0, r));
+    EXPECT_FALSE(r.flags & StallRecord::OPEN);
+    EXPECT_EQ(r.subsystem, (uint8_t)CpuSubsystem::NETWORK);
+    EXPECT_GE(r.duration_ms, 50u);
+    EXPECT_EQ(StallDetector::total(), 1u);
+    EXPECT_EQ(StallDetector::count(CpuSubsystem::NETWORK), 1u);
+    EXPECT_GE(StallDetector::maxMs(CpuSubsystem::NETWORK), 50u);
+    EXPECT_FALSE(StallDetector::record(1, r));
+
+    // A stall that ends between two samples is still recorded on exit
+    {
+        StallScope scope(CpuSubsystem::FLASH, "log_commit");
+        sleepMs(30);
+    }
+    EXPECT_EQ(StallDetector::total(), 2u);
+    ASSERT_TRUE(StallDetector::record(0, r));
+    EXPECT_STREQ(r.op, "log_commit");
+}
+
+TEST_F(StallDetectorTest, NestedRegionsBlameTheInnermost) {
+    StallDetector::enter(CpuSubsystem::FOTA, "apply_update");
+    {
+        StallScope post(CpuSubsystem::NETWORK, "http_post");
+        sleepMs(40);
+        StallDetector::sample();
+    }
+    StallDetector::sample();
+    StallDetector::exit();   // the outer clock restarted when the inner region exited
+
+    EXPECT_EQ(StallDetector::total(), 1u);
+    EXPECT_EQ(StallDetector::count(CpuSubsystem::NETWORK), 1u);
+    EXPECT_EQ(StallDetector::count(CpuSubsystem::FOTA), 0u);
+}
+
+TEST_F(StallDetectorTest, OpenStallSurvivesAReset) {
+    StallDetector::enter(CpuSubsystem::FOTA, "update_end");
+    sleepMs(30);
+    StallDetector::sample();
+    // The watchdog fires here: no exit, the next boot finds the record open
+    EXPECT_EQ(StallDetector::begin(20, &area_), 1u);
+
+    StallRecord r;
+    ASSERT_TRUE(StallDetector::record(0, r));
+    EXPECT_FALSE(r.flags & StallRecord::OPEN);
+    EXPECT_TRUE(r.flags & StallRecord::RESET);
+    EXPECT_STREQ(r.op, "update_end");
+    EXPECT_GE(r.duration_ms, 30u);
+    EXPECT_EQ(StallDetector::boot() - r.boot, 1u);
+    EXPECT_EQ(StallDetector::count(CpuSubsystem::FOTA), 0u);   // per-boot counters start over
+
+    std::string json = StallDetector::json();
+    EXPECT_NE(json.find("\"op\":\"update_end\""), std::string::npos);
+    EXPECT_NE(json.find("\"boots_ago\":1"), std::string::npos);
+    EXPECT_NE(json.find("\"reset\":\"unknown\""), std::string::npos);
+
+    // Only once: a later reset does not close it again
+    EXPECT_EQ(StallDetector::begin(20, &area_), 0u);
+}
+
+TEST_F(StallDetectorTest, GarbageAreaIsReinitialized) {
+    memset(&area_, 0xA5, sizeof(area_));   // RTC memory after a power loss
+    EXPECT_EQ(StallDetector::begin(20, &area_), 0u);
+    StallRecord r;
+    EXPECT_FALSE(StallDetector::record(0, r));
+    EXPECT_EQ(StallDetector::total(), 0u);
+}
+
+TEST_F(StallDetectorTest, OtherTasksAreIgnoredButMaySample) {
+    std::thread([] {
+        StallScope scope(CpuSubsystem::ACQUISITION, "modbus_poll");
+        sleepMs(30);
+    }).join();
+    EXPECT_EQ(StallDetector::total(), 0u);
+
+    StallDetector::enter(CpuSubsystem::ACQUISITION, "modbus_poll");
+    sleepMs(30);
+    std::thread([] { StallDetector::sample(); }).join();   // the monitor runs elsewhere
+    StallRecord r;
+    ASSERT_TRUE(StallDetector::record(0, r));
+    EXPECT_TRUE(r.flags & StallRecord::OPEN);
+    StallDetector::exit();
+}
+
+TEST_F(StallDetectorTest, RingKeepsTheNewest) {
+    StallDetector::begin(1, &area_);
+    static const char* ops[] = {"op0", "op1", "op2", "op3", "op4", "op5", "op6", "op7", "op8", "op9"};
+    for (const char* op : ops) {
+        StallScope scope(CpuSubsystem::JSON, op);
+        sleepMs(3);
+    }
+    EXPECT_EQ(StallDetector::total(), 10u);
+    EXPECT_EQ(StallDetector::count(CpuSubsystem::JSON), 10u);
+    StallRecord r;
+    ASSERT_TRUE(StallDetector::record(0, r));
+    EXPECT_STREQ(r.op, "op9");
+    ASSERT_TRUE(StallDetector::record(StallArea::RECORDS - 1, r));
+    EXPECT_STREQ(r.op, "op2");
+    EXPECT_FALSE(StallDetector::record(StallArea::RECORDS, r));
+}
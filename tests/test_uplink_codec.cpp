@@ -0,0 +1,234 @@
+/**
+ * @file test_uplink_codec.cpp
+ * @brief Tests for uplink batch codecs and the degradation policy
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "uplink_codec.hpp"
+#include <cmath>
+#include <vector>
+
+static std::vector<Sample> makeSamples(size_t n) {
+    std::vector<Sample> out;
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t reg = (uint8_t)(i % 3);
+        float value = 230.0f + reg * 10.0f + (float)(i % 7) * 0.1f;
+        out.push_back({(uint32_t)(1000 + i * 500), reg, value});
+    }
+    return out;
+}
+
+TEST(UplinkCodecTest, RawRoundTripIsLossless) {
+    std::vector<Sample> samples = makeSamples(50);
+    std::vector<uint8_t> buf;
+    encodeRawBatch(samples.data(), samples.size(), buf);
+    EXPECT_EQ(buf.size(), UPLINK_BATCH_HEADER_SIZE + samples.size() * UPLINK_RAW_SAMPLE_SIZE);
+
+    DecodedBatch decoded;
+    size_t used = 0;
+    ASSERT_TRUE(decodeBatch(buf.data(), buf.size(), decoded, used));
+    EXPECT_EQ(used, buf.size());
+    EXPECT_EQ(decoded.header.codec, UplinkCodec::RAW);
+    EXPECT_EQ(decoded.header.fidelity, Fidelity::FULL);
+    ASSERT_EQ(decoded.samples.size(), samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(decoded.samples[i].timestamp, samples[i].timestamp);
+        EXPECT_EQ(decoded.samples[i].reg_addr, samples[i].reg_addr);
+        EXPECT_EQ(decoded.samples[i].value, samples[i].value);
+    }
+}
+
+TEST(UplinkCodecTest, DeltaQIsWithinHalfStepAndSmaller) {
+    std::vector<Sample> samples = makeSamples(80);
+    std::vector<uint8_t> raw, lossy;
+    encodeRawBatch(samples.data(), samples.size(), raw);
+    encodeDeltaQBatch(samples.data(), samples.size(), 0.5f, lossy);
+    EXPECT_LT(lossy.size(), raw.size() / 2);
+
+    DecodedBatch decoded;
+    size_t used = 0;
+    ASSERT_TRUE(decodeBatch(lossy.data(), lossy.size(), decoded, used));
+    EXPECT_EQ(decoded.header.fidelity, Fidelity::LOSSY);
+    ASSERT_EQ(decoded.samples.size(), samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(decoded.samples[i].timestamp, samples[i].timestamp);
+        EXPECT_EQ(decoded.samples[i].reg_addr, samples[i].reg_addr);
+        EXPECT_LE(std::fabs(decoded.samples[i].value - samples[i].value), 0.25f + 1e-4f);
+    }
+}
+
+TEST(UplinkCodecTest, AggregateKeepsMinMaxMean) {
+    SampleAggregate agg;
+    agg.add({100, 0, 1.0f});
+    agg.add({200, 0, 3.0f});
+    agg.add({150, 5, -2.0f});
+    EXPECT_EQ(agg.totalSamples(), 3u);
+
+    std::vector<uint8_t> buf;
+    encodeAggregateBatch(agg, buf);
+    DecodedBatch decoded;
+    size_t used = 0;
+    ASSERT_TRUE(decodeBatch(buf.data(), buf.size(), decoded, used));
+    EXPECT_EQ(decoded.header.fidelity, Fidelity::AGGREGATE);
+    EXPECT_EQ(decoded.start_ts, 100u);
+    EXPECT_EQ(decoded.end_ts, 200u);
+    ASSERT_EQ(decoded.aggregates.size(), 2u);
+    EXPECT_EQ(decoded.aggregates[0].reg_addr, 0);
+    EXPECT_EQ(decoded.aggregates[0].count, 2);
+    EXPECT_FLOAT_EQ(decoded.aggregates[0].min, 1.0f);
+    EXPECT_FLOAT_EQ(decoded.aggregates[0].max, 3.0f);
+    EXPECT_FLOAT_EQ(decoded.aggregates[0].mean, 2.0f);
+    EXPECT_EQ(decoded.aggregates[1].reg_addr, 5);
+}
+
+TEST(UplinkCodecTest, HeartbeatAndConcatenatedBatches) {
+    std::vector<Sample> samples = makeSamples(3);
+    std::vector<uint8_t> buf;
+    encodeHeartbeatBatch(5000, 420, 7, buf);
+    encodeRawBatch(samples.data(), samples.size(), buf);
+
+    DecodedBatch hb;
+    size_t used = 0;
+    ASSERT_TRUE(decodeBatch(buf.data(), buf.size(), hb, used));
+    EXPECT_EQ(hb.header.fidelity, Fidelity::HEARTBEAT);
+    EXPECT_EQ(hb.start_ts, 5000u);
+    EXPECT_EQ(hb.backlog, 420u);
+    EXPECT_EQ(hb.lost, 7u);
+
+    DecodedBatch raw;
+    size_t used2 = 0;
+    ASSERT_TRUE(decodeBatch(buf.data() + used, buf.size() - used, raw, used2));
+    EXPECT_EQ(raw.samples.size(), 3u);
+    EXPECT_EQ(used + used2, buf.size());
+}
+
+TEST(UplinkCodecTest, RejectsTruncatedAndForeignInput) {
+    std::vector<Sample> samples = makeSamples(10);
+    std::vector<uint8_t> buf;
+    encodeRawBatch(samples.data(), samples.size(), buf);
+
+    DecodedBatch decoded;
+    size_t used = 0;
+    EXPECT_FALSE(decodeBatch(buf.data(), buf.size() - 1, decoded, used));
+    buf[0] = 'X';
+    EXPECT_FALSE(decodeBatch(buf.data(), buf.size(), decoded, used));
+}
+
+// Ten registers read per cycle, with register 4 missing every third cycle
+static std::vector<Sample> makeCycles(size_t cycles) {
+    std::vector<Sample> out;
+    for (size_t c = 0; c < cycles; ++c) {
+        for (uint8_t reg = 0; reg < 10; ++reg) {
+            if (reg == 4 && c % 3 == 0) continue;
+            out.push_back({(uint32_t)(1000 + c * 1000), reg, 230.0f + reg * 10.0f + (float)c * 0.37f});
+        }
+    }
+    return out;
+}
+
+TEST(UplinkCodecTest, FrameRoundTripIsLosslessAndUnderOneBytePerValue) {
+    std::vector<Sample> samples = makeCycles(12);
+    std::vector<uint8_t> buf;
+    ASSERT_EQ(encodeFrameBatch(samples.data(), samples.size(), 4096, buf), samples.size());
+    EXPECT_EQ(buf.size(), UPLINK_BATCH_HEADER_SIZE + 12 * UPLINK_FRAME_HEADER_SIZE + samples.size() * 4);
+    // Overhead beyond the 4-byte values: 6 bytes per cycle instead of 5 per value
+    double overhead = (double)(buf.size() - UPLINK_BATCH_HEADER_SIZE - samples.size() * 4) / samples.size();
+    EXPECT_LT(overhead, 1.0);
+
+    DecodedBatch decoded;
+    size_t used = 0;
+    ASSERT_TRUE(decodeBatch(buf.data(), buf.size(), decoded, used));
+    EXPECT_EQ(used, buf.size());
+    EXPECT_EQ(decoded.header.codec, UplinkCodec::FRAME);
+    EXPECT_EQ(decoded.header.fidelity, Fidelity::FULL);
+    EXPECT_EQ(decoded.header.count, 12);
+    ASSERT_EQ(decoded.samples.size(), samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(decoded.samples[i].timestamp, samples[i].timestamp);
+        EXPECT_EQ(decoded.samples[i].reg_addr, samples[i].reg_addr);
+        EXPECT_EQ(decoded.samples[i].value, samples[i].value);
+    }
+}
+
+TEST(UplinkCodecTest, FrameKeepsOrderAndStopsAtLimits) {
+    // Same timestamp but out of register order: split into frames, order preserved
+    std::vector<Sample> samples = {{500, 3, 1.0f}, {500, 7, 2.0f}, {500, 1, 3.0f}, {600, 1, 4.0f}};
+    std::vector<uint8_t> buf;
+    ASSERT_EQ(encodeFrameBatch(samples.data(), samples.size(), 4096, buf), samples.size());
+    DecodedBatch decoded;
+    size_t used = 0;
+    ASSERT_TRUE(decodeBatch(buf.data(), buf.size(), decoded, used));
+    EXPECT_EQ(decoded.header.count, 3);
+    ASSERT_EQ(decoded.samples.size(), samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(decoded.samples[i].reg_addr, samples[i].reg_addr);
+        EXPECT_EQ(decoded.samples[i].value, samples[i].value);
+    }
+
+    // Whole frames only: a 10-value frame is 46 bytes
+    std::vector<Sample> cycles = makeCycles(6);
+    buf.clear();
+    size_t n = encodeFrameBatch(cycles.data(), cycles.size(), UPLINK_BATCH_HEADER_SIZE + 46 + 46 + 10, buf);
+    EXPECT_EQ(n, 9u + 10u);
+    EXPECT_LE(buf.size(), UPLINK_BATCH_HEADER_SIZE + 46u + 46u + 10u);
+
+    // Registers outside the bitmap cannot be framed
+    Sample wide = {700, 20, 1.0f};
+    buf.clear();
+    EXPECT_EQ(encodeFrameBatch(&wide, 1, 4096, buf), 0u);
+    EXPECT_TRUE(buf.empty());
+}
+
+TEST(UplinkCodecTest, FrameRejectsTruncatedAndEmptyFrames) {
+    std::vector<Sample> samples = makeCycles(2);
+    std::vector<uint8_t> buf;
+    encodeFrameBatch(samples.data(), samples.size(), 4096, buf);
+    DecodedBatch decoded;
+    size_t used = 0;
+    EXPECT_FALSE(decodeBatch(buf.data(), buf.size() - 1, decoded, used));
+    buf[UPLINK_BATCH_HEADER_SIZE + 4] = 0;
+    buf[UPLINK_BATCH_HEADER_SIZE + 5] = 0;
+    EXPECT_FALSE(decodeBatch(buf.data(), buf.size(), decoded, used));
+}
+
+TEST(DegradationPolicyTest, StepsDownWithBacklogAndFailures) {
+    DegradationPolicy policy;
+    EXPECT_EQ(policy.evaluate(10), Fidelity::FULL);
+    EXPECT_EQ(policy.evaluate(200), Fidelity::LOSSY);
+    EXPECT_EQ(policy.evaluate(400), Fidelity::AGGREGATE);
+
+    DegradationPolicy link;
+    for (int i = 0; i < 6; ++i) link.onUploadResult(false);
+    EXPECT_EQ(link.evaluate(0), Fidelity::HEARTBEAT);
+}
+
+TEST(DegradationPolicyTest, RecoversOneLevelAtATimeWithHysteresis) {
+    DegradationPolicy policy;
+    ASSERT_EQ(policy.evaluate(400), Fidelity::AGGREGATE);
+
+    // Backlog drops but not below the exit threshold yet (384 * 0.5)
+    policy.onUploadResult(true);
+    policy.onUploadResult(true);
+    EXPECT_EQ(policy.evaluate(250), Fidelity::AGGREGATE);
+
+    // Below the exit threshold: one level up, then needs fresh successes
+    EXPECT_EQ(policy.evaluate(100), Fidelity::LOSSY);
+    EXPECT_EQ(policy.evaluate(10), Fidelity::LOSSY);
+    policy.onUploadResult(true);
+    policy.onUploadResult(true);
+    EXPECT_EQ(policy.evaluate(10), Fidelity::FULL);
+    EXPECT_EQ(policy.transitions(), 3u);
+}
+
+TEST(DegradationPolicyTest, FailureBlocksRecovery) {
+    DegradationPolicy policy;
+    ASSERT_EQ(policy.evaluate(200), Fidelity::LOSSY);
+    policy.onUploadResult(true);
+    policy.onUploadResult(false);
+    policy.onUploadResult(true);
+    EXPECT_EQ(policy.evaluate(0), Fidelity::LOSSY);
+    policy.onUploadResult(true);
+    EXPECT_EQ(policy.evaluate(0), Fidelity::FULL);
+}
@@ -0,0 +1,223 @@
+/**
+ * @file test_uplink_fec.cpp
+ * @brief Tests for Reed-Solomon upload FEC, against plain retransmission on a simulated lossy link
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "lossy_link.hpp"
+#include "uplink_fec.hpp"
+#include <cstdint>
+#include <vector>
+
+TEST(ReedSolomonTest, AnyKShardsRebuildTheData) {
+    const size_t k = 5, r = 3, len = 37;
+    std::vector<std::vector<uint8_t>> data(k, std::vector<uint8_t>(len));
+    for (size_t i = 0; i < k; ++i) {
+        for (size_t b = 0; b < len; ++b) data[i][b] = (uint8_t)(i * 31 + b * 7 + (b * b));
+    }
+    std::vector<const uint8_t*> dptr;
+    for (auto& d : data) dptr.push_back(d.data());
+    std::vector<std::vector<uint8_t>> parity(r, std::vector<uint8_t>(len));
+    for (size_t j = 0; j < r; ++j) ReedSolomon::encode(dptr.data(), k, len, j, parity[j].data());
+
+    // Every pattern of up to r lost shards out of k + r
+    for (unsigned mask = 0; mask < (1u << (k + r)); ++mask) {
+        if (__builtin_popcount(mask) > (int)r) continue;
+        std::vector<std::vector<uint8_t>> shards(k + r);
+        std::vector<uint8_t*> ptrs(k + r);
+        bool present[k + r];
+        for (size_t s = 0; s < k + r; ++s) {
+            present[s] = !(mask & (1u << s));
+            shards[s] = present[s] ? (s < k ? data[s] : parity[s - k]) : std::vector<uint8_t>(len, 0xEE);
+            ptrs[s] = shards[s].data();
+        }
+        ASSERT_TRUE(ReedSolomon::reconstruct(ptrs.data(), present, k, k + r, len)) << "mask " << mask;
+        for (size_t i = 0; i < k; ++i) ASSERT_EQ(shards[i], data[i]) << "mask " << mask << " shard " << i;
+    }
+
+    // One too many lost
+    std::vector<uint8_t*> ptrs;
+    for (auto& d : data) ptrs.push_back(d.data());
+    bool present[k] = {true, true, false, true, true};
+    EXPECT_FALSE(ReedSolomon::reconstruct(ptrs.data(), present, k, k, len));
+}
+
+TEST(UplinkFecTest, HeaderAndReplyRoundTrip) {
+    FecShardHeader h;
+    h.group = 0xA1B2C3D4;
+    h.k = 8;
+    h.index = 10;
+    h.shard_len = 1026;
+    uint8_t buf[FecShardHeader::SIZE];
+    h.write(buf);
+    EXPECT_EQ(buf[0], 'F');
+    EXPECT_EQ(buf[1], 'C');
+    FecShardHeader back;
+    ASSERT_TRUE(FecShardHeader::parse(buf, sizeof(buf), back));
+    EXPECT_EQ(back.group, h.group);
+    EXPECT_EQ(back.k, 8);
+    EXPECT_EQ(back.index, 10);
+    EXPECT_EQ(back.shard_len, 1026);
+    buf[0] = 'E';
+    EXPECT_FALSE(FecShardHeader::parse(buf, sizeof(buf), back));
+
+    FecReply reply;
+    ASSERT_TRUE(UplinkFec::parseReply("{\"status\":\"success\",\"fec\": {\"complete\": true, \"group\": 42, \"have\": 8}}",
+                                      42, reply));
+    EXPECT_TRUE(reply.complete);
+    EXPECT_EQ(reply.have, 8);
+    FecReply other;
+    EXPECT_FALSE(UplinkFec::parseReply("{\"fec\":{\"complete\":true,\"group\":41,\"have\":8}}", 42, other));
+    FecReply partial;
+    ASSERT_TRUE(UplinkFec::parseReply("{\"fec\":{\"complete\":false,\"group\":42,\"have\":6}}", 42, partial));
+    EXPECT_FALSE(partial.complete);
+    EXPECT_EQ(partial.have, 6);
+}
+
+TEST(UplinkFecTest, ParityBudgetFollowsMeasuredLoss) {
+    UplinkFec fec;
+    for (int i = 0; i < 100; ++i) fec.onSend(true);
+    EXPECT_EQ(fec.lossPermille(), 0u);
+    EXPECT_EQ(fec.parityFor(8), 1);   // the configured minimum
+
+    uint8_t last = fec.parityFor(8);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 40; ++i) fec.onSend(i % (4 - round) != 0);   // about 25 %, 33 %, 50 % lost
+        EXPECT_GE(fec.parityFor(8), last);
+        last = fec.parityFor(8);
+    }
+    EXPECT_EQ(last, 8);   // capped at max_parity
+}
+
+TEST(UplinkFecTest, CleanLinkSendsNoParity) {
+    auto chunks = makeChunks(20);
+    LossyLinkOptions opts;
+    opts.request_loss = 0;
+    opts.response_loss = 0;
+    UplinkFec fec;
+    UplinkRun run = runFec(chunks, opts, FecConfig(), &fec);
+    EXPECT_EQ(run.posts, 20u);
+    EXPECT_EQ(run.received, 20u);
+    EXPECT_EQ(fec.stats().groups, 3u);
+    EXPECT_EQ(fec.stats().parity_sent, 0u);
+}
+
+TEST(UplinkFecTest, RebuildsLostChunksWithoutResending) {
+    auto chunks = makeChunks(24);
+    LossyLinkOptions opts;
+    opts.request_loss = 0.2;
+    opts.seed = 3;
+    LossyLink link(opts);
+    FecServerModel server;
+    UplinkFec fec;
+    auto send = [&](const uint8_t* head, size_t head_len, const uint8_t* body, size_t body_len) {
+        LossyLink::Outcome o = link.post(head_len + body_len);
+        FecReply reply;
+        if (o.delivered) reply = server.receive(head, head_len, body, body_len);
+        if (!o.answered) reply = FecReply();
+        return reply;
+    };
+    for (size_t g = 0; g < 3; ++g) {
+        std::vector<const uint8_t*> ptrs;
+        std::vector<size_t> lens;
+        for (size_t i = 0; i < 8; ++i) {
+            ptrs.push_back(chunks[g * 8 + i].data());
+            lens.push_back(chunks[g * 8 + i].size());
+        }
+        ASSERT_TRUE(fec.sendGroup(ptrs.data(), lens.data(), 8, send));
+    }
+    EXPECT_GT(server.rebuilt(), 0u);
+    EXPECT_EQ(fec.stats().data_sent, 24u);   // no data chunk went out twice
+    ASSERT_EQ(server.received().size(), 24u);
+    std::set<std::vector<uint8_t>> got(server.received().begin(), server.received().end());
+    std::set<std::vector<uint8_t>> want(chunks.begin(), chunks.end());
+    EXPECT_EQ(got, want);
+}
+
+TEST(UplinkFecTest, BeatsRetransmissionOnALossyLink) {
+    auto chunks = makeChunks(200);
+    uint64_t fec_ms = 0, retx_ms = 0;
+    size_t fec_dups = 0, retx_dups = 0;
+    for (uint32_t seed = 1; seed <= 5; ++seed) {
+        LossyLinkOptions opts;
+        opts.request_loss = 0.10;
+        opts.response_loss = 0.10;
+        opts.seed = seed;
+        UplinkRun retx = runRetransmit(chunks, opts);
+        UplinkRun fec = runFec(chunks, opts, FecConfig());
+        ASSERT_EQ(fec.received - fec.duplicates, chunks.size());
+        ASSERT_EQ(retx.received - retx.duplicates, chunks.size());
+        fec_ms += fec.elapsed_ms;
+        retx_ms += retx.elapsed_ms;
+        fec_dups += fec.duplicates;
+        retx_dups += retx.duplicates;
+    }
+    // Lost replies cost retransmission a resend and a duplicate; FEC neither
+    EXPECT_LT(fec_ms, retx_ms * 85 / 100);
+    EXPECT_EQ(fec_dups, 0u);
+    EXPECT_GT(retx_dups, 0u);
+}
+
+TEST(UplinkFecTest, FailedGroupIsResentWithoutDuplicates) {
+    auto chunks = makeChunks(8);
+    LossyLinkOptions opts;
+    opts.request_loss = 0.2;
+    opts.seed = 11;
+    LossyLink link(opts);
+    FecServerModel server;
+    FecConfig config;
+    config.max_parity = 1;
+    UplinkFec fec(config);
+    size_t cut_after = 4;   // the link goes down after this many posts
+    size_t posts = 0;
+    auto send = [&](const uint8_t* head, size_t head_len, const uint8_t* body, size_t body_len) {
+        LossyLink::Outcome o = link.post(head_len + body_len);
+        FecReply reply;
+        if (posts++ >= cut_after) return reply;
+        if (o.delivered) reply = server.receive(head, head_len, body, body_len);
+        if (!o.answered) reply = FecReply();
+        return reply;
+    };
+    std::vector<const uint8_t*> ptrs;
+    std::vector<size_t> lens;
+    for (const auto& c : chunks) {
+        ptrs.push_back(c.data());
+        lens.push_back(c.size());
+    }
+    ASSERT_FALSE(fec.sendGroup(ptrs.data(), lens.data(), 8, send));
+    ASSERT_TRUE(fec.held());
+    EXPECT_GT(server.received().size(), 0u);
+
+    // Back up on the next cycles: the same group goes again
+    cut_after = SIZE_MAX;
+    bool done = false;
+    for (int cycle = 0; cycle < 5 && !done; ++cycle) done = fec.resendHeld(send);
+    ASSERT_TRUE(done);
+    EXPECT_FALSE(fec.held());
+    EXPECT_EQ(fec.stats().groups, 1u);
+    EXPECT_GE(fec.stats().groups_resent, 1u);
+    EXPECT_EQ(summarizeRun(link, server.received(), 2).duplicates, 0u);
+    std::set<std::vector<uint8_t>> got(server.received().begin(), server.received().end());
+    EXPECT_EQ(got, std::set<std::vector<uint8_t>>(chunks.begin(), chunks.end()));
+}
+
+TEST(UplinkFecTest, RetriedGroupsIngestNoDuplicates) {
+    // Loss heavy enough that groups fail and are resent on later cycles
+    auto chunks = makeChunks(80);
+    uint32_t cycles = 0;
+    for (uint32_t seed = 1; seed <= 5; ++seed) {
+        LossyLinkOptions opts;
+        opts.request_loss = 0.35;
+        opts.response_loss = 0.10;
+        opts.seed = seed;
+        FecConfig config;
+        config.max_parity = 2;
+        UplinkRun run = runFec(chunks, opts, config);
+        EXPECT_EQ(run.duplicates, 0u) << "seed " << seed;
+        EXPECT_EQ(run.received, chunks.size()) << "seed " << seed;
+        cycles += run.cycles - 1;
+    }
+    EXPECT_GT(cycles, 0u);   // some groups did fail and come back
+}
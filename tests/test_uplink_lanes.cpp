@@ -0,0 +1,111 @@
+/**
+ * @file test_uplink_lanes.cpp
+ * @brief Tests for uplink priority lanes (ordering, weighting, bounds, delay stats)
+ * @author EcoWatt Test Team
+ * @date 2026-10-18
+ */
+
+#include <gtest/gtest.h>
+#include "uplink_lanes.hpp"
+
+TEST(UplinkLanesTest, UrgentIsStrictPriority) {
+    UplinkLanes lanes;
+    lanes.enqueue(UplinkLane::EVENT, "", "{\"e\":1}", 0);
+    lanes.enqueue(UplinkLane::BACKGROUND, "", "{\"b\":1}", 0);
+    lanes.enqueue(UplinkLane::URGENT, "/ack", "{\"u\":1}", 10);
+
+    UplinkItem item;
+    ASSERT_TRUE(lanes.pop(item));
+    EXPECT_EQ(item.lane, UplinkLane::URGENT);
+    EXPECT_EQ(item.endpoint, "/ack");
+    ASSERT_TRUE(lanes.pop(item));
+    EXPECT_EQ(item.lane, UplinkLane::EVENT);
+    ASSERT_TRUE(lanes.pop(item));
+    EXPECT_EQ(item.lane, UplinkLane::BACKGROUND);
+    EXPECT_FALSE(lanes.pop(item));
+}
+
+TEST(UplinkLanesTest, LowestLaneLimitsDrain) {
+    UplinkLanes lanes;
+    lanes.enqueue(UplinkLane::EVENT, "", "{}", 0);
+    lanes.enqueue(UplinkLane::BACKGROUND, "", "{}", 0);
+
+    UplinkItem item;
+    EXPECT_FALSE(lanes.pop(item, UplinkLane::URGENT));
+    ASSERT_TRUE(lanes.pop(item, UplinkLane::EVENT));
+    EXPECT_EQ(item.lane, UplinkLane::EVENT);
+    EXPECT_FALSE(lanes.pop(item, UplinkLane::EVENT));
+    EXPECT_EQ(lanes.pending(UplinkLane::BACKGROUND), 1u);
+}
+
+TEST(UplinkLanesTest, BackgroundIsNotStarved) {
+    UplinkLanes lanes(8, 32, 8);
+    lanes.setBackgroundWeight(2);
+    for (int i = 0; i < 6; ++i) lanes.enqueue(UplinkLane::EVENT, "", "{}", 0);
+    for (int i = 0; i < 2; ++i) lanes.enqueue(UplinkLane::BACKGROUND, "", "{}", 0);
+
+    std::string order;
+    UplinkItem item;
+    while (lanes.pop(item)) order += (item.lane == UplinkLane::EVENT) ? 'E' : 'B';
+    EXPECT_EQ(order, "EEBEEBEE");
+}
+
+TEST(UplinkLanesTest, FullLaneDropsOldest) {
+    UplinkLanes lanes(2, 2, 2);
+    lanes.enqueue(UplinkLane::URGENT, "", "1", 0);
+    lanes.enqueue(UplinkLane::URGENT, "", "2", 0);
+    lanes.enqueue(UplinkLane::URGENT, "", "3", 0);
+
+    EXPECT_EQ(lanes.pending(UplinkLane::URGENT), 2u);
+    EXPECT_EQ(lanes.stats(UplinkLane::URGENT).dropped, 1u);
+    UplinkItem item;
+    ASSERT_TRUE(lanes.pop(item));
+    EXPECT_EQ(item.body, "2");
+}
+
+TEST(UplinkLanesTest, BulkCannotBeQueued) {
+    UplinkLanes lanes;
+    EXPECT_FALSE(lanes.enqueue(UplinkLane::BULK, "", "{}", 0));
+}
+
+TEST(UplinkLanesTest, RequeueKeepsOrderAndGivesUp) {
+    UplinkLanes lanes;
+    lanes.setMaxAttempts(2);
+    lanes.enqueue(UplinkLane::EVENT, "", "a", 0);
+    lanes.enqueue(UplinkLane::EVENT, "", "b", 0);
+
+    UplinkItem a;
+    ASSERT_TRUE(lanes.pop(a));
+    lanes.requeue(a);
+    UplinkItem again;
+    ASSERT_TRUE(lanes.pop(again));
+    EXPECT_EQ(again.body, "a");
+    EXPECT_EQ(again.attempts, 1);
+
+    lanes.requeue(again);  // second failure exhausts max_attempts
+    EXPECT_EQ(lanes.pending(UplinkLane::EVENT), 1u);
+    EXPECT_EQ(lanes.stats(UplinkLane::EVENT).dropped, 1u);
+}
+
+TEST(UplinkLanesTest, RecordsQueueDelayPerLane) {
+    UplinkLanes lanes;
+    lanes.enqueue(UplinkLane::URGENT, "", "{}", 100);
+    lanes.enqueue(UplinkLane::URGENT, "", "{}", 200);
+
+    UplinkItem item;
+    lanes.pop(item);
+    lanes.recordSent(item, 150);
+    lanes.pop(item);
+    lanes.recordSent(item, 350);
+    lanes.recordBulk(15000);
+
+    const UplinkLaneStats& urgent = lanes.stats(UplinkLane::URGENT);
+    EXPECT_EQ(urgent.sent, 2u);
+    EXPECT_EQ(urgent.avgDelayMs(), 100u);
+    EXPECT_EQ(urgent.max_delay_ms, 150u);
+    EXPECT_EQ(lanes.stats(UplinkLane::BULK).last_delay_ms, 15000u);
+
+    std::string json = lanes.statsJson();
+    EXPECT_NE(json.find("\"urgent\":{\"sent\":2"), std::string::npos);
+    EXPECT_NE(json.find("\"bulk\":"), std::string::npos);
+}